@@ -1,3 +1,4 @@
+#include <stdatomic.h>
 #include <stdbool.h>
 
 #include <kernel/hal/processor.h>
@@ -25,8 +26,13 @@ static int stack_frame_validate(struct stack_frame *frame, bool kernel) {
 void proc_record_profile_stack(struct task_state *task_state) {
     struct task *current = get_current_task();
     struct process *process = current->process;
+    struct profile_buffer *buffer = current->profile_buffer;
+    if (!buffer) {
+        return;
+    }
 
     bool in_kernel = current->in_kernel;
+    bool kernel_stacks = process->profile_flags & PROFILE_KERNEL_STACKS;
 
     uintptr_t ip;
     uintptr_t bp;
@@ -48,10 +54,23 @@ void proc_record_profile_stack(struct task_state *task_state) {
         sp = get_stack_pointer();
     }
 
+    if (in_kernel && !kernel_stacks) {
+        // Attribute the sample to the user code which entered the kernel.
+        if (process->in_execve || !current->user_task_state) {
+            return;
+        }
+        in_kernel = false;
+        ip = task_get_instruction_pointer(current->user_task_state);
+        bp = task_get_base_pointer(current->user_task_state);
+        sp = task_get_stack_pointer(current->user_task_state);
+    }
+
     char raw_buffer[sizeof(struct profile_event_stack_trace) + PROFILE_MAX_STACK_FRAMES * sizeof(uintptr_t)];
     struct profile_event_stack_trace *ev = (void *) raw_buffer;
     ev->type = PEV_STACK_TRACE;
     ev->count = 0;
+    ev->tid = current->tid;
+    ev->memory_map = atomic_load(&process->profile_memory_map_generation);
 
     for (;;) {
         if (ev->count < PROFILE_MAX_STACK_FRAMES) {
@@ -89,5 +108,8 @@ void proc_record_profile_stack(struct task_state *task_state) {
         sp = task_get_stack_pointer(current->user_task_state);
     }
 
-    proc_write_profile_buffer(process, raw_buffer, PEV_STACK_TRACE_SIZE(ev));
+    // The task is the only writer of its buffer, so it only has to keep the sampling interrupt out.
+    unsigned long save = disable_interrupts_save();
+    proc_write_profile_buffer(buffer, raw_buffer, PEV_STACK_TRACE_SIZE(ev));
+    interrupts_restore(save);
 }
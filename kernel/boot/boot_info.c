@@ -42,6 +42,9 @@ static void init_command_line(const char *command_line) {
     if (strstr(s_boot_info.command_line, "poweroff_on_panic=1")) {
         s_boot_info.poweroff_on_panic = true;
     }
+    if (strstr(s_boot_info.command_line, "lossy_loopback=1")) {
+        s_boot_info.lossy_loopback = true;
+    }
 }
 
 void init_boot_info_from_multiboot2(const struct multiboot2_info *info) {
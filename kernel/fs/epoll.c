@@ -0,0 +1,343 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+
+#include <kernel/fs/epoll.h>
+#include <kernel/fs/file.h>
+#include <kernel/fs/vfs.h>
+#include <kernel/hal/output.h>
+#include <kernel/proc/process.h>
+#include <kernel/proc/task.h>
+#include <kernel/util/macros.h>
+
+// #define EPOLL_DEBUG
+
+#define EPOLL_EVENT_MASK (EPOLLIN | EPOLLRDNORM | EPOLLRDBAND | EPOLLPRI | EPOLLOUT | EPOLLWRNORM | EPOLLWRBAND | EPOLLERR | EPOLLHUP)
+
+// Held while an epoll instance or a watched file is destroyed, so that neither goes away while the other is removing
+// the items they share. The lock order is epoll_destroy_lock, then epoll->lock, then file->lock.
+static mutex_t epoll_destroy_lock = MUTEX_INITIALIZER(epoll_destroy_lock);
+
+static int epoll_close(struct file *file);
+static int epoll_poll(struct file *file, struct wait_queue_entry *entry, int mask);
+static void epoll_poll_finish(struct file *file, struct wait_queue_entry *entry);
+
+static struct file_operations epoll_f_op = {
+    .close = &epoll_close,
+    .poll = &epoll_poll,
+    .poll_finish = &epoll_poll_finish,
+};
+
+static bool fs_is_epoll(struct file *file) {
+    return file->f_op == &epoll_f_op;
+}
+
+static struct epoll *epoll_from_file(struct file *file) {
+    return file->private_data;
+}
+
+// Must be called with the ready lock held.
+static void epoll_update_state(struct epoll *epoll) {
+    fs_set_state_bit(&epoll->file_state, POLLIN, !list_is_empty(&epoll->ready));
+}
+
+// Must be called with the ready lock held.
+static void epoll_make_ready(struct epoll_item *item) {
+    if (item->ready || !(item->events & EPOLL_EVENT_MASK)) {
+        return;
+    }
+
+    item->ready = true;
+    list_append(&item->epoll->ready, &item->list_for_ready);
+    epoll_update_state(item->epoll);
+}
+
+// Called from the watched file's wait queue whenever its poll state changes. Whether the change is one the item
+// is interested in is only checked when the ready list is harvested.
+static void epoll_item_wake(struct wait_queue_entry *entry) {
+    struct epoll_item *item = container_of(entry, struct epoll_item, wq_entry);
+    struct epoll *epoll = item->epoll;
+
+    spin_lock(&epoll->ready_lock);
+    epoll_make_ready(item);
+    spin_unlock(&epoll->ready_lock);
+}
+
+static int epoll_item_poll(struct epoll_item *item) {
+    if (!(item->events & EPOLL_EVENT_MASK)) {
+        return 0;
+    }
+    return item->file->f_op->poll(item->file, NULL, (item->events & EPOLL_EVENT_MASK) | POLLERR | POLLHUP);
+}
+
+static struct epoll_item *epoll_find_item(struct epoll *epoll, int fd, struct file *file) {
+    list_for_each_entry(&epoll->items, item, struct epoll_item, list_for_epoll) {
+        if (item->fd == fd && item->file == file) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+static int epoll_add(struct epoll *epoll, int fd, struct file *file, const struct epoll_event *event) {
+    if (epoll_find_item(epoll, fd, file)) {
+        return -EEXIST;
+    }
+
+    // Epoll instances cannot watch each other, since their wake up callbacks would then nest.
+    if (fs_is_epoll(file)) {
+        return -EINVAL;
+    }
+
+    if (!file->f_op->poll) {
+        return -EPERM;
+    }
+
+    struct epoll_item *item = calloc(1, sizeof(struct epoll_item));
+    if (!item) {
+        return -ENOMEM;
+    }
+
+    item->epoll = epoll;
+    item->file = file;
+    item->fd = fd;
+    item->events = event->events;
+    item->data = event->data;
+    item->wq_entry.wake_function = &epoll_item_wake;
+
+    list_append(&epoll->items, &item->list_for_epoll);
+
+    mutex_lock(&file->lock);
+    list_append(&file->epoll_items, &item->list_for_file);
+    mutex_unlock(&file->lock);
+
+    // Polling with an empty mask always queues the entry, which then stays on the file's wait queue until the item
+    // is removed. The file is only checked afterwards, so no state change can be missed.
+    file->f_op->poll(file, &item->wq_entry, 0);
+
+    spin_lock(&epoll->ready_lock);
+    if (epoll_item_poll(item)) {
+        epoll_make_ready(item);
+    }
+    spin_unlock(&epoll->ready_lock);
+
+#ifdef EPOLL_DEBUG
+    debug_log("Added epoll item: [ %p, %d, %#X ]\n", epoll, fd, item->events);
+#endif /* EPOLL_DEBUG */
+    return 0;
+}
+
+static void epoll_remove_item(struct epoll_item *item) {
+    struct epoll *epoll = item->epoll;
+    struct file *file = item->file;
+
+    // Once the entry is off the file's wait queue, the wake up callback can no longer run.
+    file->f_op->poll_finish(file, &item->wq_entry);
+
+    spin_lock(&epoll->ready_lock);
+    if (item->ready) {
+        list_remove(&item->list_for_ready);
+        epoll_update_state(epoll);
+    }
+    spin_unlock(&epoll->ready_lock);
+
+    mutex_lock(&file->lock);
+    list_remove(&item->list_for_file);
+    mutex_unlock(&file->lock);
+
+    list_remove(&item->list_for_epoll);
+    free(item);
+}
+
+int fs_epoll_create(int flags) {
+    if (flags & ~EPOLL_CLOEXEC) {
+        return -EINVAL;
+    }
+
+    struct epoll *epoll = calloc(1, sizeof(struct epoll));
+    if (!epoll) {
+        return -ENOMEM;
+    }
+
+    init_mutex(&epoll->lock);
+    init_list(&epoll->items);
+    init_spinlock(&epoll->ready_lock);
+    init_list(&epoll->ready);
+    init_file_state(&epoll->file_state, false, false);
+
+    struct file *file = fs_create_file(NULL, 0, FS_FILE_CANT_SEEK, O_RDWR, &epoll_f_op, epoll);
+
+    struct process *process = get_current_process();
+    mutex_lock(&process->lock);
+    for (int i = 0; i < FOPEN_MAX; i++) {
+        if (process->files[i].file == NULL) {
+            process->files[i].file = file;
+            process->files[i].fd_flags = (flags & EPOLL_CLOEXEC) ? FD_CLOEXEC : 0;
+            mutex_unlock(&process->lock);
+            return i;
+        }
+    }
+    mutex_unlock(&process->lock);
+
+    fs_close(file);
+    return -EMFILE;
+}
+
+int fs_epoll_ctl(struct file *epoll_file, int op, int fd, struct file *file, const struct epoll_event *event) {
+    if (!fs_is_epoll(epoll_file) || epoll_file == file) {
+        return -EINVAL;
+    }
+
+    if ((op == EPOLL_CTL_ADD || op == EPOLL_CTL_MOD) && !event) {
+        return -EFAULT;
+    }
+
+    struct epoll *epoll = epoll_from_file(epoll_file);
+    mutex_lock(&epoll->lock);
+
+    int ret = 0;
+    struct epoll_item *item = epoll_find_item(epoll, fd, file);
+    switch (op) {
+        case EPOLL_CTL_ADD:
+            ret = epoll_add(epoll, fd, file, event);
+            break;
+        case EPOLL_CTL_DEL:
+            if (!item) {
+                ret = -ENOENT;
+                break;
+            }
+            epoll_remove_item(item);
+            break;
+        case EPOLL_CTL_MOD:
+            if (!item) {
+                ret = -ENOENT;
+                break;
+            }
+
+            // This also rearms items which fired with EPOLLONESHOT.
+            spin_lock(&epoll->ready_lock);
+            item->events = event->events;
+            item->data = event->data;
+            if (epoll_item_poll(item)) {
+                epoll_make_ready(item);
+            }
+            spin_unlock(&epoll->ready_lock);
+            break;
+        default:
+            ret = -EINVAL;
+            break;
+    }
+
+    mutex_unlock(&epoll->lock);
+    return ret;
+}
+
+// Reports the events of up to max_events ready items. Level triggered items which still have events are kept on the
+// ready list, and so are reported again by the next wait. Must be called with the epoll's lock held.
+static int epoll_harvest(struct epoll *epoll, struct epoll_event *events, int max_events) {
+    struct list_node still_ready = INIT_LIST(still_ready);
+    int count = 0;
+    while (count < max_events) {
+        spin_lock(&epoll->ready_lock);
+        struct epoll_item *item = list_first_entry(&epoll->ready, struct epoll_item, list_for_ready);
+        if (!item) {
+            spin_unlock(&epoll->ready_lock);
+            break;
+        }
+        list_remove(&item->list_for_ready);
+        item->ready = false;
+        spin_unlock(&epoll->ready_lock);
+
+        int revents = epoll_item_poll(item);
+        if (!revents) {
+            continue;
+        }
+
+        events[count].events = revents;
+        events[count].data = item->data;
+        count++;
+
+        spin_lock(&epoll->ready_lock);
+        if (item->events & EPOLLONESHOT) {
+            item->events &= ~EPOLL_EVENT_MASK;
+        } else if (!(item->events & EPOLLET) && !item->ready) {
+            item->ready = true;
+            list_append(&still_ready, &item->list_for_ready);
+        }
+        spin_unlock(&epoll->ready_lock);
+    }
+
+    spin_lock(&epoll->ready_lock);
+    list_splice_tail(&epoll->ready, &still_ready);
+    epoll_update_state(epoll);
+    spin_unlock(&epoll->ready_lock);
+    return count;
+}
+
+int fs_epoll_wait(struct file *epoll_file, struct epoll_event *events, int max_events, const struct timespec *user_timeout) {
+    if (!fs_is_epoll(epoll_file) || max_events <= 0) {
+        return -EINVAL;
+    }
+
+    struct timespec timeout_storage;
+    struct timespec *timeout = NULL;
+    if (user_timeout) {
+        timeout_storage = *user_timeout;
+        timeout = &timeout_storage;
+    }
+
+    struct epoll *epoll = epoll_from_file(epoll_file);
+    mutex_lock(&epoll->lock);
+    for (;;) {
+        int ret = fs_poll_wait(&epoll->file_state, &epoll->lock, POLLIN, timeout);
+        if (ret) {
+            // The lock is not reacquired when the wait is interrupted.
+            return ret;
+        }
+
+        // Items can be on the ready list without having any events, since they are woken up for every state change
+        // of their file. In that case, wait again.
+        int count = epoll_harvest(epoll, events, max_events);
+        if (count > 0 || (timeout && timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
+            mutex_unlock(&epoll->lock);
+            return count;
+        }
+    }
+}
+
+void fs_epoll_file_closed(struct file *file) {
+    // The file has no references left, so only the epoll instances themselves can still change its item list, and
+    // they are kept from being destroyed by the lock.
+    mutex_lock(&epoll_destroy_lock);
+    list_for_each_entry_safe(&file->epoll_items, item, struct epoll_item, list_for_file) {
+        struct epoll *epoll = item->epoll;
+        mutex_lock(&epoll->lock);
+        epoll_remove_item(item);
+        mutex_unlock(&epoll->lock);
+    }
+    mutex_unlock(&epoll_destroy_lock);
+}
+
+static int epoll_close(struct file *file) {
+    struct epoll *epoll = epoll_from_file(file);
+
+    mutex_lock(&epoll_destroy_lock);
+    mutex_lock(&epoll->lock);
+    list_for_each_entry_safe(&epoll->items, item, struct epoll_item, list_for_epoll) {
+        epoll_remove_item(item);
+    }
+    mutex_unlock(&epoll->lock);
+    mutex_unlock(&epoll_destroy_lock);
+
+    free(epoll);
+    return 0;
+}
+
+static int epoll_poll(struct file *file, struct wait_queue_entry *entry, int mask) {
+    return fs_do_poll(entry, mask, &epoll_from_file(file)->file_state);
+}
+
+static void epoll_poll_finish(struct file *file, struct wait_queue_entry *entry) {
+    fs_do_poll_finish(entry, &epoll_from_file(file)->file_state);
+}
@@ -17,6 +17,7 @@
 #include <kernel/fs/file.h>
 #include <kernel/fs/file_system.h>
 #include <kernel/fs/inode.h>
+#include <kernel/fs/page_cache.h>
 #include <kernel/fs/super_block.h>
 #include <kernel/fs/vfs.h>
 #include <kernel/hal/output.h>
@@ -122,6 +123,20 @@ static ssize_t ext2_read_blocks(struct super_block *sb, void *buffer, uint32_t b
     return __ext2_read_blocks(sb, buffer, block_offset, num_blocks);
 }
 
+/* Reads file data blocks, which are cached by the page cache, so they do not need to be in the device's cache as well */
+static ssize_t ext2_read_data_blocks(struct super_block *sb, void *buffer, uint32_t block_offset, uint64_t num_blocks) {
+    if (!sb->device->ops->read_direct) {
+        return __ext2_read_blocks(sb, buffer, block_offset, num_blocks);
+    }
+
+    if (sb->device->ops->read_direct(sb->device, sb->block_size * block_offset, buffer, num_blocks * sb->block_size) !=
+        (ssize_t) (num_blocks * sb->block_size)) {
+        return -EIO;
+    }
+
+    return num_blocks;
+}
+
 /* Writes to blocks at a given offset from buffer */
 static ssize_t ext2_write_blocks(struct super_block *sb, const void *buffer, uint32_t block_offset, uint64_t num_blocks) {
     if (sb->device->ops->write(sb->device, sb->block_size * block_offset, buffer, num_blocks * sb->block_size, false) !=
@@ -1085,7 +1100,6 @@ struct file *ext2_open(struct inode *inode, int flags, int *error) {
     return fs_create_file(inode, inode->flags, 0, flags, inode->flags & FS_DIR ? &ext2_dir_f_op : &ext2_f_op, NULL);
 }
 
-/* Should provide some sort of mechanism for caching these blocks */
 static ssize_t __ext2_read(struct inode *inode, off_t offset, void *buffer, size_t len) {
     if (offset >= (off_t) inode->size) {
         return 0;
@@ -1102,15 +1116,22 @@ static ssize_t __ext2_read(struct inode *inode, off_t offset, void *buffer, size
         return len;
     }
 
+    struct super_block *sb = inode->super_block;
     struct ext2_block_iterator iter;
     ext2_init_block_iterator(&iter, inode, false);
 
-    void *block = ext2_allocate_blocks(inode->super_block, 1);
+    void *block = ext2_allocate_blocks(sb, 1);
     uint32_t block_index;
 
+    // Whole blocks are read straight into the buffer, and runs of blocks which are contiguous on disk are read together.
+    // The bytes of the pending run are already counted in ret.
+    uint32_t run_start = 0;
+    size_t run_length = 0;
+    void *run_buffer = NULL;
+
     ssize_t ret = 0;
 
-    size_t block_offset = offset / inode->super_block->block_size;
+    size_t block_offset = offset / sb->block_size;
     int iter_set_result = ext2_block_iterator_set_block_offset(&iter, block_offset);
     if (iter_set_result <= 0) {
         ret = iter_set_result;
@@ -1126,25 +1147,53 @@ static ssize_t __ext2_read(struct inode *inode, off_t offset, void *buffer, size
             goto finish_ext2_read;
         }
 
-        ssize_t read_result = ext2_read_blocks(inode->super_block, block, block_index, 1);
-        if (read_result < 0) {
-            if (ret == 0) {
-                ret = -EIO;
+        size_t buffer_offset = offset % sb->block_size;
+        size_t to_read = MIN(sb->block_size - buffer_offset, len);
+
+        if (run_length > 0 && (to_read != sb->block_size || block_index != run_start + run_length)) {
+            ssize_t read_result = ext2_read_data_blocks(sb, run_buffer, run_start, run_length);
+            if (read_result < 0) {
+                goto finish_ext2_read;
             }
-            goto finish_ext2_read;
+            run_length = 0;
         }
 
-        size_t buffer_offset = offset % inode->super_block->block_size;
-        size_t to_read = MIN(inode->super_block->block_size - buffer_offset, len);
+        if (to_read == sb->block_size) {
+            if (run_length == 0) {
+                run_start = block_index;
+                run_buffer = buffer;
+            }
+            run_length++;
+        } else {
+            ssize_t read_result = ext2_read_data_blocks(sb, block, block_index, 1);
+            if (read_result < 0) {
+                if (ret == 0) {
+                    ret = -EIO;
+                }
+                goto finish_ext2_read;
+            }
+            memcpy(buffer, block + buffer_offset, to_read);
+        }
 
-        memcpy(buffer, block + buffer_offset, to_read);
         buffer += to_read;
         offset += to_read;
         ret += to_read;
         len -= to_read;
     }
 
+    if (run_length > 0 && ext2_read_data_blocks(sb, run_buffer, run_start, run_length) >= 0) {
+        run_length = 0;
+    }
+
 finish_ext2_read:
+    // A run which failed to be read is not counted.
+    if (run_length > 0) {
+        ret -= run_length * sb->block_size;
+        if (ret == 0) {
+            ret = -EIO;
+        }
+    }
+
     ext2_kill_block_iterator(&iter);
     ext2_free_blocks(block);
     return ret;
@@ -1374,15 +1423,22 @@ finish_extend:
 }
 
 int ext2_truncate(struct inode *inode, off_t size) {
+    // Held like for writes, so that page cache reads never see the file halfway through the change.
+    mutex_lock(&inode->lock);
+
     size_t new_size = (size_t) size;
     size_t old_size = inode->size;
 
+    int ret = 0;
     if (new_size < old_size) {
-        return ext2_shrink(inode, new_size);
+        ret = ext2_shrink(inode, new_size);
     } else if (new_size > old_size) {
-        return ext2_extend(inode, new_size);
+        ret = ext2_extend(inode, new_size);
     }
-    return 0;
+
+    page_cache_invalidate(inode, MIN(old_size, new_size), MAX(old_size, new_size) - MIN(old_size, new_size));
+    mutex_unlock(&inode->lock);
+    return ret;
 }
 
 void ext2_on_inode_destruction(struct inode *inode) {
@@ -1412,7 +1468,7 @@ ssize_t ext2_read(struct file *file, off_t offset, void *buffer, size_t len) {
     struct inode *inode = fs_file_inode(file);
     mutex_lock(&inode->lock);
 
-    ssize_t ret = __ext2_read(inode, offset, buffer, len);
+    ssize_t ret = page_cache_read(inode, buffer, len, offset);
 
     mutex_unlock(&inode->lock);
     return ret;
@@ -1423,6 +1479,9 @@ ssize_t ext2_write(struct file *file, off_t offset, const void *buffer, size_t l
     mutex_lock(&inode->lock);
 
     ssize_t ret = __ext2_write(inode, offset, buffer, len);
+    if (ret > 0) {
+        page_cache_invalidate(inode, offset, ret);
+    }
 
     mutex_unlock(&inode->lock);
     return ret;
@@ -0,0 +1,406 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <kernel/fs/inode.h>
+#include <kernel/fs/page_cache.h>
+#include <kernel/fs/vfs.h>
+#include <kernel/hal/output.h>
+#include <kernel/mem/page.h>
+#include <kernel/mem/phys_page.h>
+#include <kernel/mem/vm_allocator.h>
+#include <kernel/proc/stats.h>
+#include <kernel/proc/task.h>
+#include <kernel/proc/wait_queue.h>
+#include <kernel/sched/task_sched.h>
+#include <kernel/util/hash_map.h>
+#include <kernel/util/spinlock.h>
+
+// #define PAGE_CACHE_DEBUG
+
+// Pages are keyed by their index in the file, which is stored in the block_offset field.
+HASH_DEFINE_FUNCTIONS(cache_page, struct phys_page, off_t, block_offset)
+
+static spinlock_t cache_list_lock = SPINLOCK_INITIALIZER;
+static struct list_node cache_list = INIT_LIST(cache_list);
+
+static mutex_t readahead_queue_lock = MUTEX_INITIALIZER(readahead_queue_lock);
+static struct wait_queue readahead_wait_queue = WAIT_QUEUE_INITIALIZER(readahead_wait_queue);
+static struct list_node readahead_queue = INIT_LIST(readahead_queue);
+
+static size_t page_cache_file_pages(struct page_cache *cache) {
+    return (cache->inode->size + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+static struct page_cache *page_cache_get(struct inode *inode) {
+    struct page_cache *cache = atomic_load(&inode->page_cache);
+    if (cache) {
+        return cache;
+    }
+
+    cache = calloc(1, sizeof(struct page_cache));
+    cache->inode = inode;
+    cache->pages = hash_create_hash_map(cache_page_hash, cache_page_equals, cache_page_key);
+    init_list(&cache->lru_list);
+    init_mutex(&cache->lock);
+    cache->async_index = -1;
+
+    // Faults and reads can race to create the cache, in which case the loser's cache is thrown away.
+    struct page_cache *expected = NULL;
+    if (!atomic_compare_exchange_strong(&inode->page_cache, &expected, cache)) {
+        hash_free_hash_map(cache->pages);
+        free(cache);
+        return expected;
+    }
+
+    spin_lock(&cache_list_lock);
+    list_append(&cache_list, &cache->cache_list);
+    spin_unlock(&cache_list_lock);
+    return cache;
+}
+
+static void page_cache_remove_page(struct page_cache *cache, struct phys_page *page) {
+    hash_del(cache->pages, &page->block_offset);
+    list_remove(&page->lru_list);
+    drop_phys_page(page);
+}
+
+// Drops up to max_pages pages which nothing but the cache refers to, starting with the least recently used.
+static void page_cache_shrink(struct page_cache *cache, size_t max_pages) {
+    struct list_node *node = cache->lru_list.prev;
+    while (max_pages > 0 && node != &cache->lru_list) {
+        struct phys_page *page = list_entry(node, struct phys_page, lru_list);
+        node = node->prev;
+        if (atomic_load(&page->ref_count) == 1) {
+            page_cache_remove_page(cache, page);
+            max_pages--;
+        }
+    }
+}
+
+void page_cache_destroy(struct page_cache *cache) {
+    spin_lock(&cache_list_lock);
+    list_remove(&cache->cache_list);
+    spin_unlock(&cache_list_lock);
+
+    while (!list_is_empty(&cache->lru_list)) {
+        page_cache_remove_page(cache, list_first_entry(&cache->lru_list, struct phys_page, lru_list));
+    }
+    hash_free_hash_map(cache->pages);
+    free(cache);
+}
+
+static struct phys_page *page_cache_find_page(struct page_cache *cache, off_t index) {
+    struct phys_page *page = hash_get_entry(cache->pages, &index, struct phys_page);
+    if (page) {
+        list_remove(&page->lru_list);
+        list_prepend(&cache->lru_list, &page->lru_list);
+    }
+    return page;
+}
+
+// Less than 10% of memory is available.
+static bool page_cache_memory_low(void) {
+    return g_phys_page_stats.phys_memory_total - g_phys_page_stats.phys_memory_allocated < g_phys_page_stats.phys_memory_total / 10;
+}
+
+static void page_cache_put_page(struct page_cache *cache, struct phys_page *page) {
+    // Make room for the page instead of growing the cache when memory is low.
+    if (page_cache_memory_low()) {
+        page_cache_shrink(cache, 1);
+    }
+
+    list_prepend(&cache->lru_list, &page->lru_list);
+    hash_put(cache->pages, &page->hash);
+}
+
+static void page_cache_copy_to_page(struct phys_page *page, const char *buffer, size_t len) {
+    char *mapped_page = create_temp_phys_addr_mapping(page->phys_addr);
+    memcpy(mapped_page, buffer, len);
+    memset(mapped_page + len, 0, PAGE_SIZE - len);
+    free_temp_phys_addr_mapping(mapped_page);
+}
+
+// Reads pages [start, start + count) from the file into the given pages, which may already be in the cache. Called with
+// the cache locked. The pages past the end of the file are zeroed.
+static int page_cache_read_pages(struct page_cache *cache, struct phys_page **pages, off_t start, size_t count) {
+    char *buffer = malloc(count * PAGE_SIZE);
+    if (!buffer) {
+        return -ENOMEM;
+    }
+
+    struct inode *inode = cache->inode;
+    ssize_t read = inode->i_op->read(inode, buffer, count * PAGE_SIZE, start * PAGE_SIZE);
+    if (read < 0) {
+        debug_log("Failed to read from disk: [ %lu, %llu, %s ]\n", inode->fsid, inode->index, strerror(-read));
+        free(buffer);
+        return read;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t page_offset = i * PAGE_SIZE;
+        size_t valid = (size_t) read > page_offset ? MIN((size_t) read - page_offset, PAGE_SIZE) : 0;
+        page_cache_copy_to_page(pages[i], buffer + page_offset, valid);
+    }
+
+    free(buffer);
+    return 0;
+}
+
+// Makes sure pages [start, start + count) are in the cache, reading the runs of missing pages with one read each, of up
+// to PAGE_CACHE_READAHEAD_MAX_PAGES pages. Only the first required pages are needed by the caller; the rest are read
+// ahead, which stops early, keeping the pages read so far, once memory runs low. Called with the cache locked.
+static int page_cache_fill(struct page_cache *cache, off_t start, size_t count, size_t required) {
+    off_t end = MIN(start + (off_t) count, (off_t) page_cache_file_pages(cache));
+    off_t required_end = start + (off_t) required;
+    struct phys_page *pages[PAGE_CACHE_READAHEAD_MAX_PAGES];
+
+    for (off_t index = start; index < end;) {
+        if (hash_get(cache->pages, &index)) {
+            index++;
+            continue;
+        }
+
+        size_t run = 0;
+        while (index + (off_t) run < end && run < PAGE_CACHE_READAHEAD_MAX_PAGES &&
+               !hash_get(cache->pages, &(off_t) { index + (off_t) run })) {
+            off_t page_index = index + (off_t) run;
+            struct phys_page *page;
+            if (page_index < required_end) {
+                page = allocate_phys_page();
+            } else {
+                page = page_cache_memory_low() ? NULL : try_allocate_phys_page();
+                if (!page) {
+                    end = page_index;
+                    break;
+                }
+            }
+
+            page->block_offset = page_index;
+            pages[run++] = page;
+        }
+        if (run == 0) {
+            break;
+        }
+
+        int ret = page_cache_read_pages(cache, pages, index, run);
+        for (size_t i = 0; i < run; i++) {
+            if (ret) {
+                drop_phys_page(pages[i]);
+            } else {
+                page_cache_put_page(cache, pages[i]);
+            }
+        }
+        if (ret) {
+            return ret;
+        }
+
+#ifdef PAGE_CACHE_DEBUG
+        debug_log("Read pages: [ %lu, %llu, %ld, %lu ]\n", cache->inode->fsid, cache->inode->index, index, run);
+#endif /* PAGE_CACHE_DEBUG */
+        index += run;
+    }
+    return 0;
+}
+
+static bool page_cache_queue_readahead(struct page_cache *cache, off_t start, size_t size) {
+    if (cache->readahead_queued) {
+        return false;
+    }
+
+    cache->readahead_queued = true;
+    cache->readahead_start = start;
+    cache->readahead_size = size;
+
+    // The readahead task holds a reference to the inode until it is done, so that the cache stays around.
+    bump_inode_reference(cache->inode);
+
+    mutex_lock(&readahead_queue_lock);
+    list_append(&readahead_queue, &cache->readahead_queue);
+    wake_up_all(&readahead_wait_queue);
+    mutex_unlock(&readahead_queue_lock);
+    return true;
+}
+
+// Called with the cache locked before pages [index, index + count) are accessed, which are all read here, in as few
+// reads as possible. When the file is read sequentially, a missing page starts a new readahead window, which is read
+// right away, and reaching the async_index page of the window queues the next window to be read in the background. The
+// window only adds to the pages asked for, and never more than PAGE_CACHE_READAHEAD_MAX_PAGES pages of them.
+static void page_cache_readahead(struct page_cache *cache, off_t index, size_t count) {
+    bool sequential = index == cache->next_index || index + 1 == cache->next_index;
+    cache->next_index = index + count;
+
+    if (!sequential) {
+        cache->window_size = 0;
+        cache->async_index = -1;
+        page_cache_fill(cache, index, count, count);
+        return;
+    }
+
+    if (!hash_get(cache->pages, &index)) {
+        size_t size = cache->window_size ? cache->window_size * 2 : PAGE_CACHE_READAHEAD_MIN_PAGES;
+        size = MAX(MIN(size, PAGE_CACHE_READAHEAD_MAX_PAGES), count);
+
+        cache->window_start = index;
+        cache->window_size = size;
+        cache->async_index = (off_t) count < (off_t) size ? index + (off_t) count : -1;
+        page_cache_fill(cache, index, size, count);
+        return;
+    }
+
+    // The start of the access was read ahead, but a long access can go past the window.
+    page_cache_fill(cache, index, count, count);
+
+    if (cache->async_index >= index && cache->async_index < index + (off_t) count) {
+        off_t next_start = cache->window_start + cache->window_size;
+        size_t next_size = MIN(cache->window_size * 2, PAGE_CACHE_READAHEAD_MAX_PAGES);
+        if (next_start >= (off_t) page_cache_file_pages(cache)) {
+            cache->async_index = -1;
+            return;
+        }
+
+        if (page_cache_queue_readahead(cache, next_start, next_size)) {
+            cache->window_start = next_start;
+            cache->window_size = next_size;
+            cache->async_index = next_start;
+        }
+    }
+}
+
+// Returns the page with a reference, reading it if it is not cached. Called with the cache locked.
+static struct phys_page *page_cache_get_locked_page(struct page_cache *cache, off_t index, int *error) {
+    struct phys_page *page = page_cache_find_page(cache, index);
+    if (!page) {
+        *error = page_cache_fill(cache, index, 1, 1);
+        if (*error) {
+            return NULL;
+        }
+        page = page_cache_find_page(cache, index);
+        assert(page);
+    }
+    return bump_phys_page(page);
+}
+
+ssize_t page_cache_read(struct inode *inode, void *buffer, size_t len, off_t offset) {
+    if (offset >= (off_t) inode->size) {
+        return 0;
+    }
+    len = MIN(len, inode->size - offset);
+    if (len == 0) {
+        return 0;
+    }
+
+    struct page_cache *cache = page_cache_get(inode);
+    off_t first = offset / PAGE_SIZE;
+    off_t last = (offset + len - 1) / PAGE_SIZE;
+
+    mutex_lock(&cache->lock);
+    page_cache_readahead(cache, first, last - first + 1);
+    mutex_unlock(&cache->lock);
+
+    ssize_t ret = 0;
+    while ((size_t) ret < len) {
+        off_t index = offset / PAGE_SIZE;
+        int error = 0;
+
+        mutex_lock(&cache->lock);
+        struct phys_page *page = page_cache_get_locked_page(cache, index, &error);
+        mutex_unlock(&cache->lock);
+        if (!page) {
+            return ret ? ret : error;
+        }
+
+        // The page is copied out without the cache locked, since the buffer may be a mapping of this file, in which
+        // case copying to it could fault on a page of this cache. The page's reference keeps it alive meanwhile.
+        size_t page_offset = offset % PAGE_SIZE;
+        size_t to_copy = MIN(PAGE_SIZE - page_offset, len - ret);
+        char *mapped_page = create_temp_phys_addr_mapping(page->phys_addr);
+        memcpy(buffer + ret, mapped_page + page_offset, to_copy);
+        free_temp_phys_addr_mapping(mapped_page);
+        drop_phys_page(page);
+
+        offset += to_copy;
+        ret += to_copy;
+    }
+    return ret;
+}
+
+struct phys_page *page_cache_get_page(struct inode *inode, off_t page_index) {
+    struct page_cache *cache = page_cache_get(inode);
+    int error = 0;
+
+    mutex_lock(&cache->lock);
+    page_cache_readahead(cache, page_index, 1);
+    struct phys_page *page = page_cache_get_locked_page(cache, page_index, &error);
+    mutex_unlock(&cache->lock);
+
+    if (!page) {
+        debug_log("Failed to read page: [ %lu, %llu, %ld, %s ]\n", inode->fsid, inode->index, page_index, strerror(-error));
+    }
+    return page;
+}
+
+void page_cache_invalidate(struct inode *inode, off_t offset, size_t len) {
+    struct page_cache *cache = atomic_load(&inode->page_cache);
+    if (!cache || len == 0) {
+        return;
+    }
+
+    off_t first = offset / PAGE_SIZE;
+    off_t last = (offset + len - 1) / PAGE_SIZE;
+
+    mutex_lock(&cache->lock);
+    for (off_t index = first; index <= last; index++) {
+        struct phys_page *page = hash_get_entry(cache->pages, &index, struct phys_page);
+        if (!page) {
+            continue;
+        }
+
+        // Pages which are also mapped are read again in place, so that the mappings see the new data. The others are
+        // simply dropped.
+        if (atomic_load(&page->ref_count) == 1 || index >= (off_t) page_cache_file_pages(cache) ||
+            page_cache_read_pages(cache, &page, index, 1)) {
+            page_cache_remove_page(cache, page);
+        }
+    }
+    mutex_unlock(&cache->lock);
+}
+
+void page_cache_trim(void) {
+    spin_lock(&cache_list_lock);
+    list_for_each_entry(&cache_list, cache, struct page_cache, cache_list) {
+        // This is called by the page frame allocator, and so cannot wait for the cache lock.
+        if (mutex_trylock(&cache->lock)) {
+            page_cache_shrink(cache, 100);
+            mutex_unlock(&cache->lock);
+        }
+    }
+    spin_unlock(&cache_list_lock);
+}
+
+static void do_page_cache_readahead(void) {
+    for (;;) {
+        mutex_lock(&readahead_queue_lock);
+        wait_for_with_mutex(get_current_task(), !list_is_empty(&readahead_queue), &readahead_wait_queue, &readahead_queue_lock);
+        struct page_cache *cache = list_first_entry(&readahead_queue, struct page_cache, readahead_queue);
+        list_remove(&cache->readahead_queue);
+        mutex_unlock(&readahead_queue_lock);
+
+        // The inode is locked like for a read, so that writes and truncation can't change the file under the read. The
+        // inode lock is always taken before the cache lock.
+        struct inode *inode = cache->inode;
+        mutex_lock(&inode->lock);
+        mutex_lock(&cache->lock);
+        page_cache_fill(cache, cache->readahead_start, cache->readahead_size, 0);
+        cache->readahead_queued = false;
+        mutex_unlock(&cache->lock);
+        mutex_unlock(&inode->lock);
+
+        drop_inode_reference(cache->inode);
+    }
+}
+
+void init_page_cache_readahead_task(void) {
+    sched_add_task(load_kernel_task((uintptr_t) &do_page_cache_readahead, "readahead"));
+}
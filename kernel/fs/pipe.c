@@ -11,9 +11,12 @@
 
 #include <kernel/fs/file.h>
 #include <kernel/fs/inode.h>
+#include <kernel/fs/page_cache.h>
 #include <kernel/fs/pipe.h>
 #include <kernel/fs/vfs.h>
 #include <kernel/hal/processor.h>
+#include <kernel/mem/phys_page.h>
+#include <kernel/mem/vm_allocator.h>
 #include <kernel/proc/task.h>
 #include <kernel/sched/task_sched.h>
 #include <kernel/time/clock.h>
@@ -44,6 +47,90 @@ bool is_pipe_write_end_open(struct pipe_data *data) {
     return data->write_count > 0;
 }
 
+static size_t pipe_space(struct pipe_data *data) {
+    return data->capacity - data->size;
+}
+
+static void pipe_update_state(struct inode *inode, struct pipe_data *data) {
+    fs_set_state_bit(&inode->file_state, POLLIN, data->size != 0);
+    fs_set_state_bit(&inode->file_state, POLLOUT, data->size < data->capacity);
+}
+
+static struct pipe_buffer *pipe_append_buffer(struct pipe_data *data, struct phys_page *page, uint32_t offset, uint32_t length,
+                                              int flags) {
+    struct pipe_buffer *buffer = malloc(sizeof(struct pipe_buffer));
+    assert(buffer);
+    buffer->page = page;
+    buffer->offset = offset;
+    buffer->length = length;
+    buffer->flags = flags;
+    list_append(&data->buffers, &buffer->list);
+    data->size += length;
+    return buffer;
+}
+
+static void pipe_free_buffer(struct pipe_buffer *buffer) {
+    list_remove(&buffer->list);
+    drop_phys_page(buffer->page);
+    free(buffer);
+}
+
+// Removes len bytes from the front of the first buffer. A page the pipe owns alone is kept for the next write once
+// emptied, if it is the only one, so that a pipe which is read as fast as it is written reuses the same page.
+static void pipe_consume(struct pipe_data *data, struct pipe_buffer *buffer, size_t len) {
+    buffer->offset += len;
+    buffer->length -= len;
+    data->size -= len;
+    if (buffer->length != 0) {
+        return;
+    }
+
+    if ((buffer->flags & PIPE_BUFFER_CAN_MERGE) && buffer->page->ref_count == 1 && list_is_singular(&data->buffers)) {
+        buffer->offset = 0;
+        return;
+    }
+    pipe_free_buffer(buffer);
+}
+
+// Waits until the pipe has data, or all of its writers are gone. Returns with the inode unlocked on error.
+static int pipe_wait_for_data(struct inode *inode, struct pipe_data *data, bool nonblock) {
+    while (data->size == 0 && is_pipe_write_end_open(data)) {
+        if (nonblock) {
+            mutex_unlock(&inode->lock);
+            return -EAGAIN;
+        }
+
+        int ret = inode_poll_wait(inode, POLLIN, NULL);
+        if (ret) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+// Waits until the pipe has room. Returns with the inode unlocked on error.
+static int pipe_wait_for_space(struct inode *inode, struct pipe_data *data, bool nonblock) {
+    for (;;) {
+        if (!is_pipe_read_end_open(data)) {
+            mutex_unlock(&inode->lock);
+            signal_task(get_current_task()->process->pid, get_current_task()->tid, SIGPIPE);
+            return -EPIPE;
+        }
+        if (pipe_space(data) != 0) {
+            return 0;
+        }
+        if (nonblock) {
+            mutex_unlock(&inode->lock);
+            return -EAGAIN;
+        }
+
+        int ret = inode_poll_wait(inode, POLLOUT, NULL);
+        if (ret) {
+            return ret;
+        }
+    }
+}
+
 struct inode *pipe_new_inode() {
     spin_lock(&pipe_index_lock);
     ino_t id = pipe_index++;
@@ -65,7 +152,9 @@ struct file *pipe_open(struct inode *inode, int flags, int *error) {
     mutex_lock(&inode->lock);
     if (!data) {
         data = malloc(sizeof(struct pipe_data));
-        init_ring_buffer(&data->buffer, PIPE_DEFAULT_BUFFER_SIZE);
+        init_list(&data->buffers);
+        data->size = 0;
+        data->capacity = PIPE_DEFAULT_BUFFER_SIZE;
         init_wait_queue(&data->readers_queue);
         init_wait_queue(&data->writers_queue);
         data->read_count = 0;
@@ -74,19 +163,15 @@ struct file *pipe_open(struct inode *inode, int flags, int *error) {
     }
 
     if (file->abilities & FS_FILE_CAN_WRITE) {
-        if (ring_buffer_dead(&data->buffer)) {
-            init_ring_buffer(&data->buffer, PIPE_DEFAULT_BUFFER_SIZE);
-        }
-
         if (data->write_count++ == 0) {
-            fs_set_state_bit(&inode->file_state, POLLIN, !ring_buffer_empty(&data->buffer));
+            fs_set_state_bit(&inode->file_state, POLLIN, data->size != 0);
             wake_up_all(&data->writers_queue);
         }
     }
 
     if (file->abilities & FS_FILE_CAN_READ) {
         if (data->read_count++ == 0) {
-            fs_set_state_bit(&inode->file_state, POLLOUT, !ring_buffer_full(&data->buffer));
+            fs_set_state_bit(&inode->file_state, POLLOUT, pipe_space(data) != 0);
             wake_up_all(&data->readers_queue);
         }
     }
@@ -136,26 +221,25 @@ ssize_t pipe_read(struct file *file, off_t offset, void *buffer, size_t _len) {
     assert(data);
 
     mutex_lock(&inode->lock);
-again:;
-    size_t len = MIN(_len, ring_buffer_size(&data->buffer));
-    if (len == 0 && is_pipe_write_end_open(data)) {
-        if (file->open_flags & O_NONBLOCK) {
-            mutex_unlock(&inode->lock);
-            return -EAGAIN;
-        }
+    int ret = pipe_wait_for_data(inode, data, !!(file->open_flags & O_NONBLOCK));
+    if (ret) {
+        return ret;
+    }
 
-        int ret = inode_poll_wait(inode, POLLIN, NULL);
-        if (ret) {
-            return ret;
-        }
-        goto again;
+    // Copy out of as many buffers as needed in one go.
+    size_t len = MIN(_len, data->size);
+    for (size_t copied = 0; copied < len;) {
+        struct pipe_buffer *pipe_buffer = list_first_entry(&data->buffers, struct pipe_buffer, list);
+        size_t to_copy = MIN(pipe_buffer->length, len - copied);
+        char *mapped_page = create_temp_phys_addr_mapping(pipe_buffer->page->phys_addr);
+        memcpy(buffer + copied, mapped_page + pipe_buffer->offset, to_copy);
+        free_temp_phys_addr_mapping(mapped_page);
+        pipe_consume(data, pipe_buffer, to_copy);
+        copied += to_copy;
     }
 
     if (len != 0) {
-        ring_buffer_user_read(&data->buffer, buffer, len);
-
-        fs_trigger_state(&inode->file_state, POLLOUT);
-        fs_set_state_bit(&inode->file_state, POLLIN, !ring_buffer_empty(&data->buffer));
+        pipe_update_state(inode, data);
     }
 
     mutex_unlock(&inode->lock);
@@ -176,32 +260,32 @@ ssize_t pipe_write(struct file *file, off_t offset, const void *buffer, size_t l
 
     mutex_lock(&inode->lock);
 
-    if (!is_pipe_read_end_open(data)) {
-        mutex_unlock(&inode->lock);
-        signal_task(get_current_task()->process->pid, get_current_task()->tid, SIGPIPE);
-        return -EPIPE;
-    }
-
     size_t buffer_index = 0;
     while (buffer_index < len) {
-        size_t space_available = ring_buffer_space(&data->buffer);
-        if (!space_available) {
-            if (file->open_flags & O_NONBLOCK) {
-                mutex_unlock(&inode->lock);
-                return buffer_index == 0 ? -EAGAIN : (ssize_t) buffer_index;
-            }
-            int ret = inode_poll_wait(inode, POLLOUT, NULL);
-            if (ret) {
-                return ret;
-            }
-            continue;
+        int ret = pipe_wait_for_space(inode, data, !!(file->open_flags & O_NONBLOCK));
+        if ((ret == -EAGAIN || ret == -EPIPE) && buffer_index != 0) {
+            return buffer_index;
+        }
+        if (ret) {
+            return ret;
+        }
+
+        // Fill up the last page if the pipe owns it, and otherwise start a new one.
+        struct pipe_buffer *last = list_last_entry(&data->buffers, struct pipe_buffer, list);
+        if (!last || !(last->flags & PIPE_BUFFER_CAN_MERGE) || last->offset + last->length == PAGE_SIZE) {
+            last = pipe_append_buffer(data, allocate_phys_page(), 0, 0, PIPE_BUFFER_CAN_MERGE);
         }
 
-        size_t amount_to_write = MIN(space_available, len - buffer_index);
-        ring_buffer_user_write(&data->buffer, buffer + buffer_index, amount_to_write);
+        size_t amount_to_write = MIN(MIN(pipe_space(data), PAGE_SIZE - (last->offset + last->length)), len - buffer_index);
+        char *mapped_page = create_temp_phys_addr_mapping(last->page->phys_addr);
+        memcpy(mapped_page + last->offset + last->length, buffer + buffer_index, amount_to_write);
+        free_temp_phys_addr_mapping(mapped_page);
+        last->length += amount_to_write;
+        data->size += amount_to_write;
         buffer_index += amount_to_write;
-        fs_trigger_state(&inode->file_state, POLLIN);
-        fs_set_state_bit(&inode->file_state, POLLOUT, !ring_buffer_full(&data->buffer));
+
+        // Readers only need to be woken when the pipe stops being empty, which fs_set_state() already takes care of.
+        pipe_update_state(inode, data);
         inode->modify_time = time_read_clock(CLOCK_REALTIME);
     }
 
@@ -209,6 +293,276 @@ ssize_t pipe_write(struct file *file, off_t offset, const void *buffer, size_t l
     return buffer_index;
 }
 
+// Moves data from a file into the pipe. Pages of files in the page cache are referenced by the pipe, instead of being
+// copied. Data from other files, like sockets, is read directly into new pages.
+ssize_t pipe_splice_from_file(struct file *in, off_t *in_offset, struct file *pipe, size_t len, unsigned int flags) {
+    struct inode *inode = fs_file_inode(pipe);
+    struct pipe_data *data = inode->pipe_data;
+    struct inode *in_inode = fs_file_inode(in);
+    bool page_cached = in_inode && (in_inode->flags & FS_FILE) && in_inode->i_op->read;
+    off_t offset = in_offset ? *in_offset : in->position;
+
+    mutex_lock(&inode->lock);
+    int ret = pipe_wait_for_space(inode, data, (pipe->open_flags & O_NONBLOCK) || (flags & SPLICE_F_NONBLOCK));
+    if (ret) {
+        return ret;
+    }
+
+    len = MIN(len, pipe_space(data));
+    size_t spliced = 0;
+    if (page_cached) {
+        len = offset < (off_t) in_inode->size ? MIN(len, in_inode->size - offset) : 0;
+        while (spliced < len) {
+            struct phys_page *page = page_cache_get_page(in_inode, offset / PAGE_SIZE);
+            if (!page) {
+                ret = -EIO;
+                break;
+            }
+
+            size_t page_offset = offset % PAGE_SIZE;
+            size_t amount = MIN(PAGE_SIZE - page_offset, len - spliced);
+            pipe_append_buffer(data, page, page_offset, amount, 0);
+            offset += amount;
+            spliced += amount;
+        }
+    } else {
+        while (spliced < len) {
+            struct phys_page *page = allocate_phys_page();
+            size_t amount = MIN(PAGE_SIZE, len - spliced);
+            char *mapped_page = create_temp_phys_addr_mapping(page->phys_addr);
+            ssize_t amount_read = in_offset ? fs_pread(in, mapped_page, amount, offset) : fs_read(in, mapped_page, amount);
+            free_temp_phys_addr_mapping(mapped_page);
+            if (amount_read <= 0) {
+                drop_phys_page(page);
+                ret = amount_read;
+                break;
+            }
+
+            pipe_append_buffer(data, page, 0, amount_read, 0);
+            offset += amount_read;
+            spliced += amount_read;
+            if ((size_t) amount_read < amount) {
+                break;
+            }
+        }
+    }
+
+    if (spliced != 0) {
+        pipe_update_state(inode, data);
+        inode->modify_time = time_read_clock(CLOCK_REALTIME);
+    }
+    mutex_unlock(&inode->lock);
+
+    if (in_offset) {
+        *in_offset = offset;
+    } else if (page_cached) {
+        in->position = offset;
+    }
+    return spliced ? (ssize_t) spliced : ret;
+}
+
+// Writes data from the pipe to a file. The file's write operation copies the data out of the pipe's pages.
+ssize_t pipe_splice_to_file(struct file *pipe, struct file *out, off_t *out_offset, size_t len, unsigned int flags) {
+    struct inode *inode = fs_file_inode(pipe);
+    struct pipe_data *data = inode->pipe_data;
+
+    mutex_lock(&inode->lock);
+    ssize_t ret = pipe_wait_for_data(inode, data, (pipe->open_flags & O_NONBLOCK) || (flags & SPLICE_F_NONBLOCK));
+    if (ret) {
+        return ret;
+    }
+
+    len = MIN(len, data->size);
+    size_t spliced = 0;
+    while (spliced < len) {
+        struct pipe_buffer *pipe_buffer = list_first_entry(&data->buffers, struct pipe_buffer, list);
+        size_t amount = MIN(pipe_buffer->length, len - spliced);
+        char *mapped_page = create_temp_phys_addr_mapping(pipe_buffer->page->phys_addr);
+        ssize_t written = out_offset ? fs_pwrite(out, mapped_page + pipe_buffer->offset, amount, *out_offset)
+                                     : fs_write(out, mapped_page + pipe_buffer->offset, amount);
+        free_temp_phys_addr_mapping(mapped_page);
+        if (written <= 0) {
+            ret = written;
+            break;
+        }
+
+        pipe_consume(data, pipe_buffer, written);
+        spliced += written;
+        if (out_offset) {
+            *out_offset += written;
+        }
+        if ((size_t) written < amount) {
+            break;
+        }
+    }
+
+    if (spliced != 0) {
+        pipe_update_state(inode, data);
+    }
+    mutex_unlock(&inode->lock);
+    return spliced ? (ssize_t) spliced : ret;
+}
+
+// Both pipes are locked in a fixed order, so that two tasks splicing between the same pipes in opposite directions
+// cannot deadlock. The lock is dropped before waiting on either pipe.
+static int pipe_lock_both(struct inode *in, struct inode *out, bool nonblock, bool *done) {
+    struct pipe_data *in_data = in->pipe_data;
+    struct pipe_data *out_data = out->pipe_data;
+    for (;;) {
+        mutex_lock(in < out ? &in->lock : &out->lock);
+        mutex_lock(in < out ? &out->lock : &in->lock);
+
+        struct inode *wait_inode = NULL;
+        int wait_mask = 0;
+        if (!is_pipe_read_end_open(out_data)) {
+            mutex_unlock(&in->lock);
+            mutex_unlock(&out->lock);
+            signal_task(get_current_task()->process->pid, get_current_task()->tid, SIGPIPE);
+            return -EPIPE;
+        } else if (in_data->size == 0) {
+            if (!is_pipe_write_end_open(in_data)) {
+                *done = true;
+                return 0;
+            }
+            wait_inode = in;
+            wait_mask = POLLIN;
+        } else if (pipe_space(out_data) == 0) {
+            wait_inode = out;
+            wait_mask = POLLOUT;
+        } else {
+            return 0;
+        }
+
+        mutex_unlock(&in->lock);
+        mutex_unlock(&out->lock);
+        if (nonblock) {
+            return -EAGAIN;
+        }
+
+        mutex_lock(&wait_inode->lock);
+        int ret = inode_poll_wait(wait_inode, wait_mask, NULL);
+        if (ret) {
+            return ret;
+        }
+        mutex_unlock(&wait_inode->lock);
+    }
+}
+
+// Moves data between two pipes. Whole buffers are moved from one pipe to the other, and a buffer which is only partly
+// moved has its page shared by both.
+ssize_t pipe_splice_to_pipe(struct file *in, struct file *out, size_t len, unsigned int flags) {
+    struct inode *in_inode = fs_file_inode(in);
+    struct inode *out_inode = fs_file_inode(out);
+    struct pipe_data *in_data = in_inode->pipe_data;
+    struct pipe_data *out_data = out_inode->pipe_data;
+    if (in_inode == out_inode) {
+        return -EINVAL;
+    }
+
+    bool done = false;
+    bool nonblock = (in->open_flags & O_NONBLOCK) || (out->open_flags & O_NONBLOCK) || (flags & SPLICE_F_NONBLOCK);
+    int ret = pipe_lock_both(in_inode, out_inode, nonblock, &done);
+    if (ret) {
+        return ret;
+    }
+
+    len = done ? 0 : MIN(MIN(len, in_data->size), pipe_space(out_data));
+    size_t spliced = 0;
+    while (spliced < len) {
+        struct pipe_buffer *pipe_buffer = list_first_entry(&in_data->buffers, struct pipe_buffer, list);
+        size_t amount = MIN(pipe_buffer->length, len - spliced);
+        if (amount == pipe_buffer->length) {
+            list_remove(&pipe_buffer->list);
+            list_append(&out_data->buffers, &pipe_buffer->list);
+            in_data->size -= amount;
+            out_data->size += amount;
+        } else {
+            pipe_append_buffer(out_data, bump_phys_page(pipe_buffer->page), pipe_buffer->offset, amount, 0);
+            pipe_consume(in_data, pipe_buffer, amount);
+        }
+        spliced += amount;
+    }
+
+    if (spliced != 0) {
+        pipe_update_state(in_inode, in_data);
+        pipe_update_state(out_inode, out_data);
+        out_inode->modify_time = time_read_clock(CLOCK_REALTIME);
+    }
+    mutex_unlock(&in_inode->lock);
+    mutex_unlock(&out_inode->lock);
+    return spliced;
+}
+
+// Copies data from one pipe to another without consuming it. The pages are shared by both pipes.
+ssize_t pipe_tee(struct file *in, struct file *out, size_t len, unsigned int flags) {
+    struct inode *in_inode = fs_file_inode(in);
+    struct inode *out_inode = fs_file_inode(out);
+    struct pipe_data *in_data = in_inode->pipe_data;
+    struct pipe_data *out_data = out_inode->pipe_data;
+    if (in_inode == out_inode) {
+        return -EINVAL;
+    }
+
+    bool done = false;
+    bool nonblock = (in->open_flags & O_NONBLOCK) || (out->open_flags & O_NONBLOCK) || (flags & SPLICE_F_NONBLOCK);
+    int ret = pipe_lock_both(in_inode, out_inode, nonblock, &done);
+    if (ret) {
+        return ret;
+    }
+
+    len = done ? 0 : MIN(MIN(len, in_data->size), pipe_space(out_data));
+    size_t duplicated = 0;
+    list_for_each_entry(&in_data->buffers, pipe_buffer, struct pipe_buffer, list) {
+        if (duplicated >= len) {
+            break;
+        }
+
+        size_t amount = MIN(pipe_buffer->length, len - duplicated);
+        if (amount != 0) {
+            pipe_append_buffer(out_data, bump_phys_page(pipe_buffer->page), pipe_buffer->offset, amount, 0);
+        }
+        duplicated += amount;
+    }
+
+    if (duplicated != 0) {
+        pipe_update_state(out_inode, out_data);
+        out_inode->modify_time = time_read_clock(CLOCK_REALTIME);
+    }
+    mutex_unlock(&in_inode->lock);
+    mutex_unlock(&out_inode->lock);
+    return duplicated;
+}
+
+int pipe_get_capacity(struct inode *inode) {
+    return inode->pipe_data->capacity;
+}
+
+int pipe_set_capacity(struct inode *inode, int capacity) {
+    if (capacity < 0) {
+        return -EINVAL;
+    }
+
+    size_t pages = 1;
+    while (pages * PAGE_SIZE < (size_t) capacity) {
+        pages *= 2;
+    }
+    if (pages * PAGE_SIZE > PIPE_MAX_BUFFER_SIZE && get_current_task()->process->euid != 0) {
+        return -EPERM;
+    }
+
+    struct pipe_data *data = inode->pipe_data;
+    mutex_lock(&inode->lock);
+    if (data->size > pages * PAGE_SIZE) {
+        mutex_unlock(&inode->lock);
+        return -EBUSY;
+    }
+
+    data->capacity = pages * PAGE_SIZE;
+    pipe_update_state(inode, data);
+    mutex_unlock(&inode->lock);
+    return data->capacity;
+}
+
 static void free_pipe_data(struct inode *inode) {
 #ifdef PIPE_DEBUG
     debug_log("Destroying pipe: [ %llu ]\n", inode->index);
@@ -218,7 +572,9 @@ static void free_pipe_data(struct inode *inode) {
     inode->pipe_data = NULL;
 
     if (data) {
-        kill_ring_buffer(&data->buffer);
+        list_for_each_entry_safe(&data->buffers, buffer, struct pipe_buffer, list) {
+            pipe_free_buffer(buffer);
+        }
         free(data);
     }
 }
@@ -26,6 +26,7 @@
 #include <kernel/net/arp.h>
 #include <kernel/net/interface.h>
 #include <kernel/net/neighbor_cache.h>
+#include <kernel/net/packet.h>
 #include <kernel/net/socket.h>
 #include <kernel/proc/elf64.h>
 #include <kernel/proc/stats.h>
@@ -607,9 +608,12 @@ PROCFS_ENSURE_ALIGNMENT static struct procfs_buffer procfs_cpus(struct procfs_da
                            "LOCAL APIC ID: %u\n"
                            "ACPI ID: %u\n"
                            "ENABLED: %s\n"
-                           "IDLE TASK: %d:%d\n",
+                           "IDLE TASK: %d:%d\n"
+                           "RUN QUEUE: %d\n"
+                           "MIGRATIONS: %" PRIu64 "\n",
                            processor->id, processor->arch_processor.local_apic_id, processor->arch_processor.acpi_id,
-                           processor->enabled ? "yes" : "no", processor->idle_task->process->pid, processor->idle_task->tid);
+                           processor->enabled ? "yes" : "no", processor->idle_task->process->pid, processor->idle_task->tid,
+                           processor->sched_nr_running, processor->sched_migrations);
         processor = processor->next;
     }
 
@@ -657,21 +661,50 @@ PROCFS_ENSURE_ALIGNMENT static struct procfs_buffer procfs_interfaces(struct pro
     struct procfs_buffer buf = { buffer, 0 };
     net_for_each_interface(interface) {
         struct link_layer_address mac_address = interface->link_layer_address;
+        struct network_interface_stats *stats = &interface->stats;
+        net_interface_sample_rates(interface);
         buf.size += snprintf(buf.buffer + buf.size, buf.buffer ? PAGE_SIZE - buf.size : 0,
                              "NAME: %s\n"
                              "INTERFACE IP: %d.%d.%d.%d\n"
                              "DEFAULT GATEWAY IP: %d.%d.%d.%d\n"
                              "SUBNET MASK: %d.%d.%d.%d\n"
-                             "MAC ADDRESS: %02x:%02x:%02x:%02x:%02x:%02x\n",
+                             "MAC ADDRESS: %02x:%02x:%02x:%02x:%02x:%02x\n"
+                             "RX PACKETS: %" PRIu64 "\n"
+                             "RX BYTES: %" PRIu64 "\n"
+                             "RX BATCHES: %" PRIu64 "\n"
+                             "RX PACKETS PER SECOND: %" PRIu64 "\n"
+                             "TX PACKETS: %" PRIu64 "\n"
+                             "TX BYTES: %" PRIu64 "\n"
+                             "TX QUEUE FULL: %" PRIu64 "\n"
+                             "TX PACKETS PER SECOND: %" PRIu64 "\n"
+                             "INTERRUPTS: %" PRIu64 "\n",
                              interface->name, interface->address.addr[0], interface->address.addr[1], interface->address.addr[2],
                              interface->address.addr[3], interface->default_gateway.addr[0], interface->default_gateway.addr[1],
                              interface->default_gateway.addr[2], interface->default_gateway.addr[3], interface->mask.addr[0],
                              interface->mask.addr[1], interface->mask.addr[2], interface->mask.addr[3], mac_address.addr[0],
-                             mac_address.addr[1], mac_address.addr[2], mac_address.addr[3], mac_address.addr[4], mac_address.addr[5]);
+                             mac_address.addr[1], mac_address.addr[2], mac_address.addr[3], mac_address.addr[4], mac_address.addr[5],
+                             stats->rx_packets, stats->rx_bytes, stats->rx_batches, stats->rx_packets_per_second, stats->tx_packets,
+                             stats->tx_bytes, stats->tx_queue_full, stats->tx_packets_per_second, stats->interrupts);
     }
     return buf;
 }
 
+PROCFS_ENSURE_ALIGNMENT static struct procfs_buffer procfs_packets(struct procfs_data *data __attribute__((unused)),
+                                                                   struct process *process __attribute__((unused)), bool need_buffer) {
+    char *buffer = need_buffer ? malloc(PAGE_SIZE) : NULL;
+    struct net_packet_stats *stats = &g_net_packet_stats;
+    size_t length = snprintf(buffer, need_buffer ? PAGE_SIZE : 0,
+                             "PACKETS: %" PRIu64 "\n"
+                             "POOL ALLOCATIONS: %" PRIu64 "\n"
+                             "HEAP ALLOCATIONS: %" PRIu64 "\n"
+                             "POOL FREE: %" PRIu64 "\n"
+                             "COPIES: %" PRIu64 "\n"
+                             "BYTES COPIED: %" PRIu64 "\n",
+                             stats->packets, stats->pool_allocations, stats->heap_allocations, stats->pool_free, stats->copies,
+                             stats->bytes_copied);
+    return (struct procfs_buffer) { buffer, length };
+}
+
 PROCFS_ENSURE_ALIGNMENT static struct procfs_buffer procfs_protocols(struct procfs_data *data __attribute__((unused)),
                                                                      struct process *process __attribute__((unused)), bool need_buffer) {
     char *buffer = need_buffer ? malloc(PAGE_SIZE) : NULL;
@@ -703,6 +736,10 @@ PROCFS_ENSURE_ALIGNMENT static void procfs_create_net_directory_structure(struct
         data = interfaces_inode->private_data;
         PROCFS_MAKE_DYNAMIC(data);
 
+        struct inode *packets_inode = procfs_create_inode(PROCFS_FILE_MODE, 0, 0, NULL, procfs_packets);
+        data = packets_inode->private_data;
+        PROCFS_MAKE_DYNAMIC(data);
+
         struct inode *protocols_inode = procfs_create_inode(PROCFS_FILE_MODE, 0, 0, NULL, procfs_protocols);
         data = protocols_inode->private_data;
         PROCFS_MAKE_DYNAMIC(data);
@@ -710,6 +747,7 @@ PROCFS_ENSURE_ALIGNMENT static void procfs_create_net_directory_structure(struct
         mutex_lock(&parent->lock);
         fs_put_dirent_cache(parent->dirent_cache, arp_inode, "arp", strlen("arp"));
         fs_put_dirent_cache(parent->dirent_cache, interfaces_inode, "interfaces", strlen("interfaces"));
+        fs_put_dirent_cache(parent->dirent_cache, packets_inode, "packets", strlen("packets"));
         fs_put_dirent_cache(parent->dirent_cache, protocols_inode, "protocols", strlen("protocols"));
         mutex_unlock(&parent->lock);
     }
@@ -18,8 +18,10 @@
 
 #include <kernel/fs/cached_dirent.h>
 #include <kernel/fs/dev.h>
+#include <kernel/fs/epoll.h>
 #include <kernel/fs/file_system.h>
 #include <kernel/fs/inode.h>
+#include <kernel/fs/page_cache.h>
 #include <kernel/fs/pipe.h>
 #include <kernel/fs/vfs.h>
 #include <kernel/fs/watch.h>
@@ -79,6 +81,10 @@ void drop_inode_reference(struct inode *inode) {
             fs_destroy_dirent_cache(inode->dirent_cache);
         }
 
+        if (inode->page_cache) {
+            page_cache_destroy(inode->page_cache);
+        }
+
         free(inode);
         return;
     }
@@ -178,6 +184,7 @@ struct file *fs_create_file(struct inode *inode, int type, int abilities, int fl
     }
 
     init_mutex(&file->lock);
+    init_list(&file->epoll_items);
     file->ref_count = 1;
     file->open_flags = flags;
     file->flags = type;
@@ -708,6 +715,10 @@ int fs_close(struct file *file) {
     int fetched_ref_count = atomic_fetch_sub(&file->ref_count, 1);
     assert(fetched_ref_count > 0);
     if (fetched_ref_count == 1) {
+        if (!list_is_empty(&file->epoll_items)) {
+            fs_epoll_file_closed(file);
+        }
+
         bool all_files_closed = false;
         if (inode) {
             int old_open_file_count = atomic_fetch_sub(&inode->open_file_count, 1);
@@ -1271,6 +1282,54 @@ int fs_create_pipe(struct file *pipe_files[2]) {
     return 0;
 }
 
+static bool fs_is_pipe(struct file *file) {
+    return (file->flags & FS_FIFO) && fs_file_inode(file) && fs_file_inode(file)->pipe_data;
+}
+
+// Moves data between a pipe and another file, or between two pipes, without copying it through user space. Offsets can
+// only be given for seekable files, and are then used instead of the file's position.
+ssize_t fs_splice(struct file *in, off_t *in_offset, struct file *out, off_t *out_offset, size_t len, unsigned int flags) {
+    if (!(in->abilities & FS_FILE_CAN_READ) || !(out->abilities & FS_FILE_CAN_WRITE)) {
+        return -EBADF;
+    }
+
+    if ((in_offset && (in->abilities & FS_FILE_CANT_SEEK)) || (out_offset && (out->abilities & FS_FILE_CANT_SEEK))) {
+        return -ESPIPE;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    bool in_is_pipe = fs_is_pipe(in);
+    bool out_is_pipe = fs_is_pipe(out);
+    if (in_is_pipe && out_is_pipe) {
+        return pipe_splice_to_pipe(in, out, len, flags);
+    }
+    if (in_is_pipe) {
+        return pipe_splice_to_file(in, out, out_offset, len, flags);
+    }
+    if (out_is_pipe) {
+        return pipe_splice_from_file(in, in_offset, out, len, flags);
+    }
+    return -EINVAL;
+}
+
+ssize_t fs_tee(struct file *in, struct file *out, size_t len, unsigned int flags) {
+    if (!(in->abilities & FS_FILE_CAN_READ) || !(out->abilities & FS_FILE_CAN_WRITE)) {
+        return -EBADF;
+    }
+
+    if (!fs_is_pipe(in) || !fs_is_pipe(out)) {
+        return -EINVAL;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+    return pipe_tee(in, out, len, flags);
+}
+
 int fs_unlink(const char *path, bool ignore_permission_checks) {
     assert(path);
 
@@ -1997,6 +2056,16 @@ int fs_fcntl(struct file_descriptor *desc, int command, int arg) {
                 }
             }
             return 0;
+        case F_GETPIPE_SZ:
+            if (!fs_is_pipe(desc->file)) {
+                return -EBADF;
+            }
+            return pipe_get_capacity(fs_file_inode(desc->file));
+        case F_SETPIPE_SZ:
+            if (!fs_is_pipe(desc->file)) {
+                return -EBADF;
+            }
+            return pipe_set_capacity(fs_file_inode(desc->file), arg);
         default:
             return -EINVAL;
     }
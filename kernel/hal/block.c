@@ -13,12 +13,14 @@
 #include <kernel/proc/stats.h>
 
 static ssize_t block_read(struct fs_device *device, off_t offset, void *buf, size_t size, bool non_block);
+static ssize_t block_read_direct(struct fs_device *device, off_t offset, void *buf, size_t size);
 static ssize_t block_write(struct fs_device *device, off_t offset, const void *buf, size_t size, bool non_block);
 static uint64_t block_block_count(struct fs_device *device);
 static uint32_t block_block_size(struct fs_device *device);
 
 static struct fs_device_ops block_device_ops = {
     .read = block_read,
+    .read_direct = block_read_direct,
     .write = block_write,
     .block_count = block_block_count,
     .block_size = block_block_size,
@@ -135,6 +137,47 @@ static ssize_t block_read(struct fs_device *device, off_t offset, void *buf, siz
     return ret;
 }
 
+// Reads straight from the device into the buffer, a page at a time, without adding the blocks to the cache. Since writes
+// go through the cache to the device immediately, the device is always up to date.
+static ssize_t block_read_direct(struct fs_device *device, off_t offset, void *buf, size_t size) {
+    if (offset < 0) {
+        return -EINVAL;
+    }
+
+    struct block_device *block_device = device->private;
+    uint32_t block_size = block_device->block_size;
+    if (size % block_size != 0 || offset % block_size != 0) {
+        return -ENXIO;
+    }
+
+    uint64_t block_count = size / block_size;
+    off_t block_offset = offset / block_size;
+    if (block_count + block_offset > block_device->block_count) {
+        return -ENXIO;
+    }
+
+    uint64_t block_step = PAGE_SIZE / block_size;
+    off_t block_end = block_offset + block_count;
+    off_t block;
+
+    mutex_lock(&device->lock);
+    for (block = block_offset; block < block_end;) {
+        uint64_t blocks_to_read = MIN(block_step - block % block_step, (uint64_t) (block_end - block));
+        if (block_device->op->read(block_device, buf + (block - block_offset) * block_size, blocks_to_read, block) !=
+            (int64_t) blocks_to_read) {
+            break;
+        }
+        block += blocks_to_read;
+    }
+    mutex_unlock(&device->lock);
+
+    ssize_t ret = (block - block_offset) * block_size;
+    if (ret == 0) {
+        return -EIO;
+    }
+    return ret;
+}
+
 static ssize_t block_write(struct fs_device *device, off_t offset, const void *buf, size_t size, bool non_block) {
     (void) non_block;
     if (offset < 0) {
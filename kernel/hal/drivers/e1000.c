@@ -42,10 +42,15 @@ static bool has_eeprom(struct e1000_data *data) {
     return false;
 }
 
+static void *transmit_buffer(struct e1000_data *data, int index) {
+    return (void *) data->tx_buffers_region->start + index * E1000_TRANSMIT_BUFFER_SIZE;
+}
+
 static void init_recieve_descriptors(struct e1000_data *data) {
     for (int i = 0; i < E1000_NUM_RECIEVE_DESCS; i++) {
-        data->rx_virt_regions[i] = vm_allocate_dma_region(8192);
-        data->rx_descs[i].addr = get_phys_addr(data->rx_virt_regions[i]->start);
+        data->rx_packets[i] = net_create_pool_packet(NULL);
+        assert(data->rx_packets[i]);
+        data->rx_descs[i].addr = get_phys_addr((uintptr_t) net_packet_inline_data(data->rx_packets[i]));
         data->rx_descs[i].status = 0;
     }
 
@@ -56,18 +61,22 @@ static void init_recieve_descriptors(struct e1000_data *data) {
     write_command(data, E1000_RX_DESC_HEAD, 0);
     write_command(data, E1000_RX_DESC_TAIL, E1000_NUM_RECIEVE_DESCS - 1);
 
+    write_command(data, E1000_RDTR_REG, E1000_RX_DELAY);
+    write_command(data, E1000_RADV_REG, E1000_RX_ABSOLUTE_DELAY);
+
     write_command(data, E1000_RCTRL,
                   E1000_RCTL_EN | E1000_RCTL_SBP | E1000_RCTL_UPE | E1000_RCTL_MPE | E1000_RCTL_LBM_NONE | E1000_RTCL_RDMTS_HALF |
-                      E1000_RCTL_BAM | E1000_RCTL_SECRC | E1000_RCTL_BSIZE_8192);
+                      E1000_RCTL_BAM | E1000_RCTL_SECRC | E1000_RCTL_BSIZE_2048);
 }
 
 static void init_transmit_descriptors(struct e1000_data *data) {
+    data->tx_buffers_region = vm_allocate_dma_region(ALIGN_UP(E1000_NUM_TRANSMIT_DESCS * E1000_TRANSMIT_BUFFER_SIZE, PAGE_SIZE));
     for (int i = 0; i < E1000_NUM_TRANSMIT_DESCS; i++) {
-        data->tx_virt_regions[i] = vm_allocate_dma_region(8192);
-        data->tx_descs[i].addr = get_phys_addr((uintptr_t) data->tx_virt_regions[i]->start);
+        data->tx_descs[i].addr = get_phys_addr((uintptr_t) transmit_buffer(data, i));
         data->tx_descs[i].cmd = 0;
         data->tx_descs[i].status = E1000_TSTA_DD;
     }
+    init_spinlock(&data->tx_lock);
 
     write_command(data, E1000_TX_DESC_HI, (uint32_t) ((uint64_t) get_phys_addr((uintptr_t) data->tx_descs) >> 32));
     write_command(data, E1000_TX_DESC_LO, (uint32_t) ((uint64_t) get_phys_addr((uintptr_t) data->tx_descs) & 0xFFFFFFFF));
@@ -75,6 +84,8 @@ static void init_transmit_descriptors(struct e1000_data *data) {
     write_command(data, E1000_TX_DESC_LEN, E1000_NUM_TRANSMIT_DESCS * sizeof(struct e1000_transmit_desc));
     write_command(data, E1000_TX_DESC_HEAD, 0);
     write_command(data, E1000_TX_DESC_TAIL, 0);
+    write_command(data, E1000_TIDV_REG, E1000_TX_DELAY);
+    write_command(data, E1000_TADV_REG, E1000_TX_ABSOLUTE_DELAY);
 
     write_command(data, E1000_TCTRL, 0b0110000000000111111000011111010U);
     write_command(data, E1000_TIPG_REG, 0x0060200AU);
@@ -90,71 +101,147 @@ static uint32_t read_eeprom(struct e1000_data *data, uint8_t addr) {
     return (uint16_t) ((val >> 16) & 0xFFFF);
 }
 
+// Gives back descriptors the card has finished sending, and frees the packets which were sent from their own buffer.
+static void reclaim_transmit_descriptors(struct e1000_data *data) {
+    while (data->tx_clean != data->current_tx && (data->tx_descs[data->tx_clean].status & E1000_TSTA_DD)) {
+        if (data->tx_packets[data->tx_clean]) {
+            net_free_packet(data->tx_packets[data->tx_clean]);
+            data->tx_packets[data->tx_clean] = NULL;
+        }
+        data->tx_clean = (data->tx_clean + 1) % E1000_NUM_TRANSMIT_DESCS;
+    }
+}
+
 static int e1000_send(struct network_interface *self, struct link_layer_address dest, struct packet *packet) {
     struct e1000_data *data = self->private_data;
-    assert(sizeof(struct ethernet_frame) + packet->total_length < 8192);
+    assert(sizeof(struct ethernet_frame) + packet->total_length <= E1000_TRANSMIT_BUFFER_SIZE);
     assert(packet->header_count >= 2);
 
+    spin_lock(&data->tx_lock);
+
+    // Packets are queued without waiting for them to be sent. Only when every descriptor is in use is it necessary to
+    // wait, for the oldest one.
+    reclaim_transmit_descriptors(data);
+    if ((data->current_tx + 1) % E1000_NUM_TRANSMIT_DESCS == data->tx_clean) {
+        self->stats.tx_queue_full++;
+        while (!(data->tx_descs[data->tx_clean].status & E1000_TSTA_DD))
+            ;
+        reclaim_transmit_descriptors(data);
+    }
+
 #ifdef KERNEL_E1000_DEBUG
     debug_log("Sending over: %d\n", data->current_tx);
 #endif /* KERNEL_E1000_DEBUG */
 
-    void *send_buffer = (void *) data->tx_virt_regions[data->current_tx]->start;
-
+    // A pool packet whose headers were all written in place can be sent from its own buffer, once the ethernet header
+    // is pushed in front. Others, like the fragments of a large IP packet, are copied into the descriptor's buffer.
     struct packet_header *layer2_header = net_packet_outer_header(packet);
-    struct packet_header *ethernet_header = net_init_packet_header(packet, 0, PH_ETHERNET, send_buffer, sizeof(struct ethernet_frame));
+    uint16_t ether_type = net_packet_header_to_ether_type(layer2_header->type);
+    bool zero_copy = (packet->flags & PKT_FROM_POOL) && !(packet->flags & PKT_DONT_FREE) &&
+                     net_packet_can_push_header(packet, sizeof(struct ethernet_frame)) && net_packet_is_contiguous(packet);
+
+    struct packet_header *ethernet_header;
+    if (zero_copy) {
+        ethernet_header = net_packet_push_header(packet, PH_ETHERNET, sizeof(struct ethernet_frame));
+    } else {
+        void *send_buffer = transmit_buffer(data, data->current_tx);
+        ethernet_header = net_init_packet_header(packet, 0, PH_ETHERNET, send_buffer, sizeof(struct ethernet_frame));
+    }
     net_init_ethernet_frame(ethernet_header->raw_header, net_link_layer_address_to_mac(dest),
-                            net_link_layer_address_to_mac(self->link_layer_address), net_packet_header_to_ether_type(layer2_header->type));
-
-    net_packet_write_headers(send_buffer, packet, 1);
+                            net_link_layer_address_to_mac(self->link_layer_address), ether_type);
+
+    if (zero_copy) {
+        // The packet is freed when the card is done with it, possibly from the interrupt handler, so it should not keep
+        // anything else alive until then.
+        net_packet_drop_references(packet);
+        data->tx_packets[data->current_tx] = packet;
+    } else {
+        net_packet_write_headers(ethernet_header->raw_header, packet, 1);
+    }
 
+    // Report status is needed for the card to mark the descriptor done, and interrupt delay lets completions be
+    // reported together.
+    data->tx_descs[data->current_tx].addr = get_phys_addr((uintptr_t) ethernet_header->raw_header);
     data->tx_descs[data->current_tx].length = packet->total_length;
     data->tx_descs[data->current_tx].status = 0;
-    data->tx_descs[data->current_tx].cmd = E1000_CMD_EOP | E1000_CMD_IFCS | E1000_CMD_RS;
+    data->tx_descs[data->current_tx].cmd = E1000_CMD_EOP | E1000_CMD_IFCS | E1000_CMD_RS | E1000_CMD_IDE;
 
-    int save_current_tx = data->current_tx;
     data->current_tx = (data->current_tx + 1) % E1000_NUM_TRANSMIT_DESCS;
-
     write_command(data, E1000_TX_DESC_TAIL, data->current_tx);
 
-    while (!data->tx_descs[save_current_tx].status)
-        ;
+    self->stats.tx_packets++;
+    self->stats.tx_bytes += packet->total_length;
+    spin_unlock(&data->tx_lock);
 
-    net_free_packet(packet);
+    if (!zero_copy) {
+        net_free_packet(packet);
+    }
     return 0;
 }
 
-static void e1000_recieve() {
-    struct e1000_data *data = interface->private_data;
+// Hands every frame which has arrived to the network task together. Each frame's packet is replaced in the ring by a
+// fresh one from the packet pool, so that the frame does not need to be copied.
+static void e1000_recieve(struct e1000_data *data) {
+    struct list_node packets = INIT_LIST(packets);
+    int last_rx = -1;
+
+    while (data->rx_descs[data->current_rx].status & E1000_RSTA_DD) {
+        struct e1000_recieve_desc *desc = &data->rx_descs[data->current_rx];
+        uint16_t len = desc->length;
+
+        // Frames are never split across descriptors, since they fit in one buffer.
+        if ((desc->status & E1000_RSTA_EOP) && !desc->errors) {
+            struct packet *packet = data->rx_packets[data->current_rx];
+            struct packet *replacement = net_create_pool_packet(NULL);
+            if (replacement) {
+                net_init_incoming_ethernet_packet(packet, interface, len);
+                data->rx_packets[data->current_rx] = replacement;
+                desc->addr = get_phys_addr((uintptr_t) net_packet_inline_data(replacement));
+            } else {
+                // The pool is empty, so the frame is copied and the packet stays in the ring.
+                packet = net_create_incoming_ethernet_packet(net_packet_inline_data(packet), interface, len);
+            }
+            list_append(&packets, &packet->queue);
+            interface->stats.rx_packets++;
+            interface->stats.rx_bytes += len;
+        }
 
-    while (data->rx_descs[data->current_rx].status & 0x1) {
-        uint8_t *buf = (uint8_t *) data->rx_virt_regions[data->current_rx]->start;
-        uint16_t len = data->rx_descs[data->current_rx].length;
+        desc->status = 0;
+        last_rx = data->current_rx;
+        data->current_rx = (data->current_rx + 1) % E1000_NUM_RECIEVE_DESCS;
+    }
 
-        net_recieve_ethernet(interface, (const struct ethernet_frame *) buf, len);
+    if (last_rx == -1) {
+        return;
+    }
 
-        data->rx_descs[data->current_rx].status = 0;
+    // The buffers have all been copied, so they can be given back to the card at once.
+    write_command(data, E1000_RX_DESC_TAIL, last_rx);
 
-        int save_current_rx = data->current_rx;
-        data->current_rx = (data->current_rx + 1) % E1000_NUM_RECIEVE_DESCS;
-        write_command(data, E1000_RX_DESC_TAIL, save_current_rx);
-    }
+    interface->stats.rx_batches++;
+    net_on_incoming_packets(&packets);
 }
 
 static bool handle_interrupt(struct irq_context *context __attribute__((unused))) {
     struct e1000_data *data = interface->private_data;
 
-    write_command(data, E1000_CTRL_IMASK, 1);
+    // Reading the cause clears it, so every cause has to be handled here.
+    uint32_t cause = read_command(data, E1000_ICR_REG);
+    interface->stats.interrupts++;
 
-    uint32_t status = read_command(data, 0xc0);
-    if (status & 0x04) {
+    if (cause & E1000_ICR_LSC) {
         write_command(data, E1000_CTRL_REG, read_command(data, E1000_CTRL_REG) | E1000_ECTRL_SLU);
         debug_log("E1000 link up...\n");
-    } else if (status & 0x10) {
-        debug_log("Threshold ??\n");
-        // Threshold ??
-    } else if (status & 0x80) {
-        e1000_recieve();
+    }
+
+    if (cause & E1000_ICR_RX) {
+        e1000_recieve(data);
+    }
+
+    if (cause & E1000_ICR_TXDW) {
+        spin_lock(&data->tx_lock);
+        reclaim_transmit_descriptors(data);
+        spin_unlock(&data->tx_lock);
     }
 
     return true;
@@ -225,13 +312,16 @@ static struct pci_device *e1000_create(struct hw_device *parent, struct pci_devi
     init_recieve_descriptors(data);
     init_transmit_descriptors(data);
 
-    write_command(data, E1000_CTRL_IMASK, 0x1F6DC);
-    write_command(data, E1000_CTRL_IMASK, (1 << 2) | (1 << 7));
-    read_command(data, 0xC0);
+    // The interrupt handler uses the interface, so it is created first.
+    interface = net_create_network_interface("e1000", NETWORK_INTERFACE_ETHERNET, e1000_get_link_layer_address(data), &e1000_ops, data);
 
-    register_irq_handler(&e1000_handler, interrupt_line + EXTERNAL_IRQ_OFFSET);
+    // Interrupts are throttled to the maximum rate, in units of 256 ns between interrupts.
+    write_command(data, E1000_ITR_REG, 1000000000 / (E1000_MAX_INTERRUPT_RATE * 256));
+    write_command(data, E1000_IMC_REG, 0xFFFFFFFF);
+    write_command(data, E1000_CTRL_IMASK, E1000_ICR_LSC | E1000_ICR_RX | E1000_ICR_TXDW);
+    read_command(data, E1000_ICR_REG);
 
-    interface = net_create_network_interface("e1000", NETWORK_INTERFACE_ETHERNET, e1000_get_link_layer_address(data), &e1000_ops, data);
+    register_irq_handler(&e1000_handler, interrupt_line + EXTERNAL_IRQ_OFFSET);
     return &data->pci_device;
 }
 
@@ -53,6 +53,7 @@ struct processor *create_processor() {
     processor->self = processor;
     init_spinlock(&processor->ipi_messages_lock);
     init_list(&processor->sched_list);
+    init_list(&processor->sched_rt_list);
     init_spinlock(&processor->sched_lock);
     processor->id = num_processors++;
     return processor;
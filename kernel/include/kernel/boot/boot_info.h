@@ -20,6 +20,7 @@ struct boot_info {
     bool serial_debug;
     bool redirect_start_stdio_to_serial;
     bool poweroff_on_panic;
+    bool lossy_loopback;
     void *memory_map;
     size_t memory_map_count;
 };
@@ -20,6 +20,8 @@ struct vm_object;
 struct fs_device_ops {
     struct file *(*open)(struct fs_device *device, int flags, int *error);
     ssize_t (*read)(struct fs_device *device, off_t offset, void *buffer, size_t len, bool non_blocking);
+    // Reads without going through any cache kept by the device, for data which is cached elsewhere (like file data).
+    ssize_t (*read_direct)(struct fs_device *device, off_t offset, void *buffer, size_t len);
     ssize_t (*write)(struct fs_device *device, off_t offset, const void *buffer, size_t len, bool non_blocking);
     int (*close)(struct fs_device *device);
     void (*add)(struct fs_device *device);
@@ -0,0 +1,47 @@
+#ifndef _KERNEL_FS_EPOLL_H
+#define _KERNEL_FS_EPOLL_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#include <kernel/fs/file.h>
+#include <kernel/proc/wait_queue.h>
+#include <kernel/util/list.h>
+#include <kernel/util/mutex.h>
+#include <kernel/util/spinlock.h>
+
+struct epoll;
+
+struct epoll_item {
+    struct list_node list_for_epoll;
+    struct list_node list_for_file;
+    struct list_node list_for_ready;
+    struct wait_queue_entry wq_entry;
+    struct epoll *epoll;
+    struct file *file;
+    int fd;
+    uint32_t events;
+    epoll_data_t data;
+    bool ready;
+};
+
+struct epoll {
+    // Protects the interest list, and is held while ready items are harvested.
+    mutex_t lock;
+    struct list_node items;
+
+    // Items are made ready from wait queue callbacks, so the ready list is protected by a spin lock.
+    spinlock_t ready_lock;
+    struct list_node ready;
+
+    // POLLIN is set while the ready list is not empty.
+    struct file_state file_state;
+};
+
+int fs_epoll_create(int flags);
+int fs_epoll_ctl(struct file *epoll_file, int op, int fd, struct file *file, const struct epoll_event *event);
+int fs_epoll_wait(struct file *epoll_file, struct epoll_event *events, int max_events, const struct timespec *timeout);
+void fs_epoll_file_closed(struct file *file);
+
+#endif /* _KERNEL_FS_EPOLL_H */
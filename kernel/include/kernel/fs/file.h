@@ -6,6 +6,7 @@
 #include <sys/types.h>
 
 #include <kernel/proc/wait_queue.h>
+#include <kernel/util/list.h>
 #include <kernel/util/mutex.h>
 
 struct file;
@@ -75,6 +76,9 @@ struct file {
     struct inode *inode;
 
     void *private_data;
+
+    // Epoll instances watching this file, protected by lock.
+    struct list_node epoll_items;
 };
 
 #endif /* _KERNEL_FS_FILE_H */
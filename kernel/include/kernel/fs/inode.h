@@ -16,6 +16,7 @@
 struct fs_device;
 struct hash_map;
 struct inode;
+struct page_cache;
 struct pipe_data;
 struct timeval;
 
@@ -101,6 +102,9 @@ struct inode {
     // Should be lazily initialized
     struct vm_object *vm_object;
 
+    // Cached pages of the file's data, shared by read() and mmap(). Lazily initialized.
+    struct page_cache *page_cache;
+
     // Linked list of "dirty" inodes whose metadata must be written to disk
     struct list_node dirty_inodes;
 
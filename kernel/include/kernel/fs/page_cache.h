@@ -0,0 +1,56 @@
+#ifndef _KERNEL_FS_PAGE_CACHE_H
+#define _KERNEL_FS_PAGE_CACHE_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <kernel/util/list.h>
+#include <kernel/util/mutex.h>
+
+struct hash_map;
+struct inode;
+struct phys_page;
+
+// Once reads of a file look sequential, pages are read ahead in windows which start at the minimum size and double
+// each time the reader catches up, up to the maximum.
+#define PAGE_CACHE_READAHEAD_MIN_PAGES 4
+#define PAGE_CACHE_READAHEAD_MAX_PAGES 32
+
+// Caches the pages of a file, filled using the inode's read operation. read() copies out of these pages, and shared
+// mappings of the file map them directly, so both see the same data.
+struct page_cache {
+    struct inode *inode;
+    struct hash_map *pages;
+    struct list_node lru_list;
+    mutex_t lock;
+
+    // The page after the last one accessed, which is where the next access is if the file is read sequentially. The
+    // readahead state is kept per inode rather than per open file, so all readers of the inode share it.
+    off_t next_index;
+
+    // The window of pages most recently read ahead. When the reader gets to the async_index page, the next window is read
+    // in the background.
+    off_t window_start;
+    size_t window_size;
+    off_t async_index;
+
+    // The window waiting to be read by the readahead task, if queued is set.
+    bool readahead_queued;
+    off_t readahead_start;
+    size_t readahead_size;
+    struct list_node readahead_queue;
+
+    struct list_node cache_list;
+};
+
+void page_cache_destroy(struct page_cache *cache);
+
+ssize_t page_cache_read(struct inode *inode, void *buffer, size_t len, off_t offset);
+struct phys_page *page_cache_get_page(struct inode *inode, off_t page_index);
+void page_cache_invalidate(struct inode *inode, off_t offset, size_t len);
+
+void page_cache_trim(void);
+void init_page_cache_readahead_task(void);
+
+#endif /* _KERNEL_FS_PAGE_CACHE_H */
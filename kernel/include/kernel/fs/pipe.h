@@ -4,14 +4,33 @@
 #include <sys/types.h>
 #include <kernel/fs/file.h>
 #include <kernel/fs/inode.h>
+#include <kernel/mem/page.h>
 #include <kernel/proc/wait_queue.h>
-#include <kernel/util/ring_buffer.h>
+#include <kernel/util/list.h>
 
-#define PIPE_DEFAULT_BUFFER_SIZE 0x1000
+// A pipe holds up to its capacity in bytes, which F_SETPIPE_SZ can change. Capacities are rounded up to a power of two
+// number of pages, and only root can go beyond PIPE_MAX_BUFFER_SIZE.
+#define PIPE_DEFAULT_BUFFER_SIZE (16 * PAGE_SIZE)
+#define PIPE_MAX_BUFFER_SIZE     (1024 * 1024)
 #define PIPE_DEVICE              3
 
+struct phys_page;
+
+// Part of a page holding data in the pipe. Pages written to the pipe are owned by it, and later writes fill up the
+// rest of the last one. Pages spliced in from a file or another pipe are shared, and are never written to.
+struct pipe_buffer {
+    struct list_node list;
+    struct phys_page *page;
+    uint32_t offset;
+    uint32_t length;
+#define PIPE_BUFFER_CAN_MERGE 1
+    int flags;
+};
+
 struct pipe_data {
-    struct ring_buffer buffer;
+    struct list_node buffers;
+    size_t size;
+    size_t capacity;
     struct wait_queue readers_queue;
     struct wait_queue writers_queue;
     int read_count;
@@ -26,6 +45,12 @@ struct inode *pipe_new_inode();
 struct file *pipe_open(struct inode *inode, int flags, int *error);
 ssize_t pipe_read(struct file *file, off_t offset, void *buffer, size_t len);
 ssize_t pipe_write(struct file *file, off_t offset, const void *buffer, size_t len);
+ssize_t pipe_splice_from_file(struct file *in, off_t *in_offset, struct file *pipe, size_t len, unsigned int flags);
+ssize_t pipe_splice_to_file(struct file *pipe, struct file *out, off_t *out_offset, size_t len, unsigned int flags);
+ssize_t pipe_splice_to_pipe(struct file *in, struct file *out, size_t len, unsigned int flags);
+ssize_t pipe_tee(struct file *in, struct file *out, size_t len, unsigned int flags);
+int pipe_get_capacity(struct inode *inode);
+int pipe_set_capacity(struct inode *inode, int capacity);
 int pipe_close(struct file *file);
 void pipe_clone(struct file *file);
 void pipe_all_files_closed(struct inode *inode);
@@ -88,6 +88,8 @@ int fs_ftruncate(struct file *file, off_t length);
 struct tnode *fs_mkdir(const char *path, mode_t mode, int *error);
 struct tnode *fs_mknod(const char *path, mode_t mode, dev_t dev, int *error);
 int fs_create_pipe(struct file *pipe_files[2]);
+ssize_t fs_splice(struct file *in, off_t *in_offset, struct file *out, off_t *out_offset, size_t len, unsigned int flags);
+ssize_t fs_tee(struct file *in, struct file *out, size_t len, unsigned int flags);
 int fs_unlink(const char *path, bool ignore_permission_checks);
 int fs_rmdir(const char *path);
 int fs_fchmodat(struct tnode *base, const char *path, mode_t mode, int flags);
@@ -162,6 +164,8 @@ static inline struct inode *fs_file_inode(struct file *file) {
     return file->inode;
 }
 
+// Returns the events in mask which are set, or queues entry on the state's wait queue if there are none. An empty
+// mask always queues the entry.
 static inline int fs_do_poll(struct wait_queue_entry *entry, int mask, struct file_state *state) {
     int result = state->poll_flags & mask;
     if (result != 0) {
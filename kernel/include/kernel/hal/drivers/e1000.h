@@ -5,12 +5,17 @@
 
 #include <kernel/hal/hw_device.h>
 #include <kernel/hal/pci.h>
+#include <kernel/net/packet.h>
+#include <kernel/util/spinlock.h>
 
 #define E1000_CTRL_REG     0x0000
 #define E1000_STATUS_REG   0x0008
 #define E1000_EEPROM_REG   0x0014
 #define E1000_CTRL_EXT_REG 0x0018
+#define E1000_ICR_REG      0x00C0 // Interrupt Cause Read
+#define E1000_ITR_REG      0x00C4 // Interrupt Throttling
 #define E1000_CTRL_IMASK   0x00D0
+#define E1000_IMC_REG      0x00D8 // Interrupt Mask Clear
 
 #define E1000_TIPG_REG  0x0410 // Transmit Inter Packet Gap
 #define E1000_ECTRL_SLU 0x40   // set link up
@@ -21,6 +26,8 @@
 #define E1000_RX_DESC_LEN  0x2808
 #define E1000_RX_DESC_HEAD 0x2810
 #define E1000_RX_DESC_TAIL 0x2818
+#define E1000_RDTR_REG     0x2820 // Recieve Delay Timer
+#define E1000_RADV_REG     0x282C // Recieve Absolute Delay Timer
 
 #define E1000_TCTRL        0x0400
 #define E1000_TX_DESC_LO   0x3800
@@ -28,6 +35,8 @@
 #define E1000_TX_DESC_LEN  0x3808
 #define E1000_TX_DESC_HEAD 0x3810
 #define E1000_TX_DESC_TAIL 0x3818
+#define E1000_TIDV_REG     0x3820 // Transmit Interrupt Delay
+#define E1000_TADV_REG     0x382C // Transmit Absolute Interrupt Delay
 
 #define E1000_RCTL_EN            (1 << 1)  // Receiver Enable
 #define E1000_RCTL_SBP           (1 << 2)  // Store Bad Packets
@@ -79,8 +88,32 @@
 #define E1000_TSTA_LC (1 << 2) // Late Collision
 #define E1000_LSTA_TU (1 << 3) // Transmit Underrun
 
-#define E1000_NUM_RECIEVE_DESCS  32
-#define E1000_NUM_TRANSMIT_DESCS 8
+#define E1000_RSTA_DD  (1 << 0) // Descriptor Done
+#define E1000_RSTA_EOP (1 << 1) // End of Packet
+
+#define E1000_ICR_TXDW   (1 << 0) // Transmit Descriptor Written Back
+#define E1000_ICR_LSC    (1 << 2) // Link Status Change
+#define E1000_ICR_RXDMT0 (1 << 4) // Recieve Descriptor Minimum Threshold
+#define E1000_ICR_RXO    (1 << 6) // Recieve Overrun
+#define E1000_ICR_RXT0   (1 << 7) // Recieve Timer Interrupt
+#define E1000_ICR_RX     (E1000_ICR_RXDMT0 | E1000_ICR_RXO | E1000_ICR_RXT0)
+
+// Interrupt coalescing. The card raises at most E1000_MAX_INTERRUPT_RATE interrupts per second, and waits for the
+// delay timers (in units of 1.024 us) to expire after a packet, so that one interrupt handles many packets. The absolute
+// timers bound the latency added while packets keep arriving.
+#define E1000_MAX_INTERRUPT_RATE 8000
+#define E1000_RX_DELAY           16
+#define E1000_RX_ABSOLUTE_DELAY  64
+#define E1000_TX_DELAY           32
+#define E1000_TX_ABSOLUTE_DELAY  128
+
+#define E1000_NUM_RECIEVE_DESCS  128
+#define E1000_NUM_TRANSMIT_DESCS 64
+
+// Large enough for a full ethernet frame, since long packet reception is not enabled. Frames are recieved directly
+// into pool packets, whose inline data is this size.
+#define E1000_RECIEVE_BUFFER_SIZE  NET_PACKET_POOL_DATA_SIZE
+#define E1000_TRANSMIT_BUFFER_SIZE 2048
 
 #define E1000_DESC_MIN_ALIGN 16
 
@@ -117,11 +150,21 @@ struct e1000_data {
     struct e1000_recieve_desc *rx_descs;
     struct e1000_transmit_desc *tx_descs;
 
-    struct vm_region *rx_virt_regions[E1000_NUM_RECIEVE_DESCS];
-    struct vm_region *tx_virt_regions[E1000_NUM_TRANSMIT_DESCS];
+    // The packets the card recieves into, one per recieve descriptor.
+    struct packet *rx_packets[E1000_NUM_RECIEVE_DESCS];
+
+    // Packets are normally sent straight from their own buffer, and held in tx_packets until sent. Packets which
+    // cannot be are copied into the descriptor's buffer in tx_buffers_region instead.
+    struct vm_region *tx_buffers_region;
+    struct packet *tx_packets[E1000_NUM_TRANSMIT_DESCS];
 
     int current_rx;
+
+    // Descriptors from tx_clean up to current_tx have been handed to the card, and are reclaimed once it reports them
+    // done. The ring is full when current_tx is just behind tx_clean.
+    spinlock_t tx_lock;
     int current_tx;
+    int tx_clean;
 };
 
 #endif /* _KERNEL_HAL_X86_64_DRIVERS_E1000_H */
@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <kernel/hal/arch.h>
+#include <kernel/mem/page_frame_allocator.h>
 #include <kernel/util/list.h>
 #include <kernel/util/spinlock.h>
 
@@ -49,12 +50,27 @@ struct processor {
     spinlock_t ipi_messages_lock;
 
     struct task *current_task;
+
+    // Runnable tasks, including the current one. Real-time tasks are kept in priority order, and always run before the
+    // others, which are run round robin.
     struct list_node sched_list;
+    struct list_node sched_rt_list;
     spinlock_t sched_lock;
     bool sched_idle;
+    bool sched_need_resched;
+    int sched_nr_running;
+    unsigned int sched_balance_ticks;
+    uint64_t sched_migrations;
+
+    // The tasks this processor last switched from and to. It may still be using their stacks, so they cannot be
+    // migrated until it schedules again.
+    struct task *sched_prev_task;
+    struct task *sched_next_task;
 
     int preemption_disabled_count;
 
+    struct page_frame_cache page_frame_cache;
+
     int id;
     bool enabled;
 };
@@ -10,6 +10,7 @@ struct vm_region;
 struct inode_vm_object_data {
     struct inode *inode;
     bool owned;
+    bool shared;
     struct vm_region *kernel_region;
     size_t pages;
     struct phys_page *phys_pages[];
@@ -1,17 +1,34 @@
 #ifndef _KERNEL_MEM_PAGE_FRAME_ALLOCATOR_H
 #define _KERNEL_MEM_PAGE_FRAME_ALLOCATOR_H 1
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include <kernel/mem/page.h>
+#include <kernel/util/spinlock.h>
 
 #define PAGE_BITMAP_SIZE (PAGE_SIZE * 32)
 
+// Blocks of 2^order pages are allocated from the buddy system, up to 4 MiB.
+#define PAGE_FRAME_MAX_ORDER 10
+
+// Single pages are allocated and freed through a per processor cache, which is refilled from and drained to the buddy
+// system PAGE_FRAME_CACHE_BATCH pages at a time.
+#define PAGE_FRAME_CACHE_SIZE  64
+#define PAGE_FRAME_CACHE_BATCH 16
+
 struct process;
 
+struct page_frame_cache {
+    spinlock_t lock;
+    int count;
+    uintptr_t pages[PAGE_FRAME_CACHE_SIZE];
+};
+
 void init_page_frame_allocator();
 void mark_used(uintptr_t phys_addr_start, uintptr_t length);
 uintptr_t get_next_phys_page(struct process *process);
+uintptr_t try_get_next_phys_page(struct process *process);
 uintptr_t get_contiguous_pages(size_t pages);
 void free_phys_page(uintptr_t phys_addr, struct process *process);
 
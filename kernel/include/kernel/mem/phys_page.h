@@ -15,6 +15,9 @@ struct phys_page {
 };
 
 struct phys_page *allocate_phys_page(void);
+
+// Returns NULL instead of reclaiming memory when no page is free.
+struct phys_page *try_allocate_phys_page(void);
 struct phys_page *bump_phys_page(struct phys_page *page);
 
 void drop_phys_page(struct phys_page *page);
@@ -32,7 +32,10 @@ struct vm_region *find_first_kernel_vm_region();
 struct vm_region *find_vm_region(uint64_t type);
 struct vm_region *find_user_vm_region_by_addr(uintptr_t addr);
 struct vm_region *find_user_vm_region_in_range(uintptr_t start, uintptr_t end);
-struct vm_region *clone_process_vm();
+void clone_process_vm(struct process *child_process);
+
+void add_process_vm_region(struct process *process, struct vm_region *region);
+void remove_process_vm_region(struct process *process, struct vm_region *region);
 
 void vm_bootstrap_temp_page_mapping();
 void vm_bootstrap_temp_page_mapping_processor(struct processor *processor);
@@ -16,6 +16,7 @@
 #include <stdint.h>
 
 #include <kernel/mem/vm_object.h>
+#include <kernel/util/rb_tree.h>
 
 struct inode;
 
@@ -61,6 +62,7 @@ struct vm_region {
     uintptr_t vm_object_offset;
 
     struct vm_region *next;
+    struct rb_node tree_node;
 };
 
 struct vm_region *add_vm_region(struct vm_region *list, struct vm_region *to_add);
@@ -9,8 +9,8 @@
 #include <kernel/net/socket.h>
 #include <kernel/util/hash_map.h>
 
-struct socket_data *net_inet_create_socket_data(const struct ip_v4_packet *packet, uint16_t port_network_ordered, const void *buf,
-                                                size_t len);
+struct socket_data *net_inet_create_socket_data(struct packet *net_packet, const struct ip_v4_packet *packet, uint16_t port_network_ordered,
+                                                const void *buf, size_t len);
 
 int net_inet_bind(struct socket *socket, const struct sockaddr *addr, socklen_t addrlen);
 int net_inet_close(struct socket *socket);
@@ -3,6 +3,7 @@
 
 #include <net/if.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include <kernel/net/ip_address.h>
 #include <kernel/net/link_layer_address.h>
@@ -21,6 +22,26 @@ struct network_interface_ops {
     struct link_layer_address (*get_link_layer_broadcast_address)(struct network_interface *interface);
 };
 
+struct network_interface_stats {
+    uint64_t rx_packets;
+    uint64_t rx_bytes;
+    // The number of times recieved packets were handed to the network task. Drivers hand over every packet which
+    // arrived since the last interrupt at once.
+    uint64_t rx_batches;
+    uint64_t tx_packets;
+    uint64_t tx_bytes;
+    // The number of times a packet had to wait for the driver's transmit queue to have space.
+    uint64_t tx_queue_full;
+    uint64_t interrupts;
+
+    // Packet rates, averaged over the time between the last two samples.
+    struct timespec rate_sample_time;
+    uint64_t rate_sample_rx_packets;
+    uint64_t rate_sample_tx_packets;
+    uint64_t rx_packets_per_second;
+    uint64_t tx_packets_per_second;
+};
+
 struct network_interface {
     struct list_node interface_list;
 
@@ -41,6 +62,8 @@ struct network_interface {
 
     struct network_interface_ops *ops;
 
+    struct network_interface_stats stats;
+
     void *private_data;
 };
 
@@ -51,6 +74,7 @@ struct network_interface *net_create_network_interface(const char *name, int typ
                                                        struct network_interface_ops *ops, void *data);
 
 void net_recieve_packet(struct network_interface *interface, struct packet *packet);
+void net_interface_sample_rates(struct network_interface *interface);
 
 int net_ioctl_interface_index_for_name(struct ifreq *req);
 int net_ioctl_interface_name_for_index(struct ifreq *req);
@@ -1,4 +1,7 @@
 #ifndef _KERNEL_NET_LOOPBACK_H
 #define _KERNEL_NET_LOOPBACK_H 1
 
+// The fraction of packets dropped by the "lossy" loopback interface.
+#define LOOPBACK_LOSSY_DROP_PER_MILLE 10
+
 #endif /* _KERNEL_NET_LOOPBACK_H */
@@ -9,8 +9,11 @@ struct ethernet_frame;
 struct network_interface;
 struct packet;
 
+void net_init_incoming_ethernet_packet(struct packet *packet, struct network_interface *interface, size_t len);
+struct packet *net_create_incoming_ethernet_packet(const struct ethernet_frame *frame, struct network_interface *interface, size_t len);
 void net_on_incoming_ethernet_frame(const struct ethernet_frame *frame, struct network_interface *interface, size_t len);
 void net_on_incoming_packet(struct packet *packet);
+void net_on_incoming_packets(struct list_node *packets);
 
 void net_network_task_start();
 
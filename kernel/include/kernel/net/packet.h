@@ -1,11 +1,27 @@
 #ifndef _KERNEL_NET_PACKET_H
 #define _KERNEL_NET_PACKET_H 1
 
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <kernel/util/list.h>
 
 #define NET_PACKET_MAX_HEADERS 5
 
+// Space reserved in front of a packet's data, so that lower layers can prepend their headers in place. This covers an
+// ethernet header followed by an IP header with options.
+#define NET_PACKET_HEADROOM 80
+
+// Packets which fit are allocated from the packet pool, a fixed number of equally sized buffers in memory which devices
+// can access directly. Drivers send from and recieve into these buffers without copying.
+#define NET_PACKET_POOL_DATA_SIZE 2048
+#define NET_PACKET_POOL_BUFFERS   512
+
+// Recieved data shorter than this is copied rather than held by reference, so that a stream of tiny segments cannot pin
+// down a whole packet buffer each.
+#define NET_PACKET_COPY_BREAK 256
+
 struct destination_cache_entry;
 struct network_interface;
 struct socket;
@@ -30,26 +46,64 @@ struct packet_header {
 };
 
 struct packet {
+    // Links the packet into the network task's queue, and then into the queue of the socket which recieved it.
     struct list_node queue;
     struct network_interface *interface;
     struct socket *socket;
     struct destination_cache_entry *destination;
-#define PKT_DONT_FREE 1
+#define PKT_DONT_FREE       1
+#define PKT_FROM_POOL       2
+#define PKT_DATA_REFERENCED 4
     uint16_t flags;
     uint16_t header_count;
     uint32_t total_length;
+    int ref_count;
+
+    // The size of buffer, which holds the headroom followed by the inline data.
+    uint32_t buffer_size;
+
+    // The part of the payload not yet read, while a socket holds the packet. This belongs to the one holder returned by
+    // net_packet_reference_data(), which is why the data of a packet is only ever handed out by reference once.
+    const uint8_t *payload;
+    uint32_t payload_length;
+
     struct packet_header headers[NET_PACKET_MAX_HEADERS];
-    uint8_t inline_data[0];
+    uint8_t buffer[0];
 };
 
+// Counts where packet memory comes from and how often packet data is copied, to show the cost per packet.
+struct net_packet_stats {
+    uint64_t packets;
+    uint64_t pool_allocations;
+    uint64_t heap_allocations;
+    uint64_t copies;
+    uint64_t bytes_copied;
+    uint64_t pool_free;
+};
+
+extern struct net_packet_stats g_net_packet_stats;
+
 void net_packet_write_headers(void *buffer, struct packet *packet, uint32_t start_header);
 
 void net_free_packet(struct packet *packet);
+struct packet *net_bump_packet(struct packet *packet);
+void net_packet_drop_references(struct packet *packet);
 struct packet *net_create_packet(struct network_interface *interface, struct socket *socket, struct destination_cache_entry *destination,
                                  size_t inline_data_size);
+struct packet *net_create_pool_packet(struct network_interface *interface);
+struct packet *net_packet_reference_data(struct packet *packet, const void *data, size_t len);
 void net_packet_log(const struct packet *packet);
 const char *net_packet_header_type_to_string(enum packet_header_type type);
 
+static inline void *net_packet_inline_data(struct packet *packet) {
+    return packet->buffer + NET_PACKET_HEADROOM;
+}
+
+static inline void net_packet_count_copy(size_t bytes) {
+    g_net_packet_stats.copies++;
+    g_net_packet_stats.bytes_copied += bytes;
+}
+
 static inline uint16_t net_packet_header_index(struct packet *packet, struct packet_header *header) {
     return header - packet->headers;
 }
@@ -99,4 +153,31 @@ static inline struct packet_header *net_init_packet_header(struct packet *packet
     return header;
 }
 
+// Whether a header of the given length fits in the headroom in front of the packet's outer header. This is only the
+// case for packets whose headers all live in the packet's own buffer.
+static inline bool net_packet_can_push_header(struct packet *packet, uint16_t header_length) {
+    struct packet_header *outer_header = net_packet_outer_header(packet);
+    uint8_t *start = outer_header ? outer_header->raw_header : NULL;
+    return start >= packet->buffer + header_length && start <= packet->buffer + packet->buffer_size;
+}
+
+// Prepends a header directly in front of the packet's outer header, so that the packet's data stays contiguous.
+static inline struct packet_header *net_packet_push_header(struct packet *packet, enum packet_header_type type, uint16_t header_length) {
+    assert(net_packet_can_push_header(packet, header_length));
+    struct packet_header *outer_header = net_packet_outer_header(packet);
+    return net_init_packet_header(packet, net_packet_header_index(packet, outer_header) - 1, type,
+                                  outer_header->raw_header - header_length, header_length);
+}
+
+// Whether every header directly follows the one before it, so that the whole packet can be sent from one buffer.
+static inline bool net_packet_is_contiguous(struct packet *packet) {
+    struct packet_header *outer_header = net_packet_outer_header(packet);
+    for (uint16_t i = net_packet_header_index(packet, outer_header) + 1; i < packet->header_count; i++) {
+        if (packet->headers[i - 1].raw_header + packet->headers[i - 1].length != packet->headers[i].raw_header) {
+            return false;
+        }
+    }
+    return true;
+}
+
 #endif /* _KERNEL_NET_PACKET_H */
@@ -18,6 +18,7 @@ enum socket_state { UNBOUND = 0, BOUND, LISTENING, CONNECTED, CLOSING, CLOSED };
 
 struct network_interface;
 struct destination_cache_entry;
+struct packet;
 struct socket;
 struct tcp_control_block;
 
@@ -65,6 +66,10 @@ struct socket_data {
 
     struct socket_connection from;
 
+    // The message is either held in a recieved packet, or copied into data.
+    struct packet *packet;
+    const uint8_t *payload;
+
     size_t len;
     uint8_t data[0];
 };
@@ -105,6 +110,7 @@ struct socket {
     struct timeval recv_timeout;
     struct timeval send_timeout;
     struct network_interface *bound_interface;
+    struct tcp_congestion_ops *tcp_congestion;
 
     struct sockaddr_storage peer_address;
     struct sockaddr_storage host_address;
@@ -135,6 +141,7 @@ ssize_t net_generic_recieve_from(struct socket *socket, void *buf, size_t len, i
 struct socket_data *net_get_next_message(struct socket *socket, int *error);
 int net_get_next_connection(struct socket *socket, struct socket_connection *connection);
 ssize_t net_send_to_socket(struct socket *to_send, struct socket_data *socket_data);
+void net_free_socket_data(struct socket_data *socket_data);
 void net_socket_set_error(struct socket *socket, int error);
 
 void net_set_host_address(struct socket *socket, const void *addr, socklen_t addrlen);
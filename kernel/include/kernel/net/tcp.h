@@ -1,6 +1,7 @@
 #ifndef _KERNEL_NET_TCP_H
 #define _KERNEL_NET_TCP_H 1
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define TCP_FLAGS_FIN 1U
@@ -15,9 +16,20 @@
 #define TCP_DEFAULT_MSS     536
 #define TCP_RTO_GRANULARITY 100
 
-#define TCP_OPTION_END 0
-#define TCP_OPTION_PAD 1
-#define TCP_OPTION_MSS 2
+#define TCP_OPTION_END            0
+#define TCP_OPTION_PAD            1
+#define TCP_OPTION_MSS            2
+#define TCP_OPTION_WINDOW_SCALE   3
+#define TCP_OPTION_SACK_PERMITTED 4
+#define TCP_OPTION_SACK           5
+#define TCP_OPTION_TIMESTAMP      8
+
+#define TCP_MAX_WINDOW_SCALE 14
+
+// The timestamp option is sent padded to 12 bytes on every segment once negotiated, which leaves room for at most 3 SACK
+// blocks in the 40 bytes of option space.
+#define TCP_TIMESTAMP_OPTION_LENGTH 12
+#define TCP_MAX_SACK_BLOCKS         4
 
 struct destination_cache_entry;
 struct networK_interface;
@@ -67,6 +79,37 @@ struct tcp_option_mss {
     uint16_t mss;
 } __attribute__((packed));
 
+struct tcp_option_window_scale {
+    uint8_t type;
+    uint8_t length;
+    uint8_t shift;
+} __attribute__((packed));
+
+struct tcp_option_timestamp {
+    uint8_t type;
+    uint8_t length;
+    uint32_t value;
+    uint32_t echo;
+} __attribute__((packed));
+
+struct tcp_sack_block {
+    uint32_t start;
+    uint32_t end;
+};
+
+// The options of a recieved segment, in host byte order.
+struct tcp_parsed_options {
+    uint16_t mss;
+    uint8_t window_scale;
+    uint8_t sack_block_count;
+    bool has_window_scale : 1;
+    bool sack_permitted : 1;
+    bool has_timestamp : 1;
+    uint32_t timestamp_value;
+    uint32_t timestamp_echo;
+    struct tcp_sack_block sack_blocks[TCP_MAX_SACK_BLOCKS];
+};
+
 struct tcp_packet_options {
     uint16_t source_port;
     uint16_t dest_port;
@@ -75,6 +118,14 @@ struct tcp_packet_options {
     struct tcp_flags tcp_flags;
     uint16_t window;
     uint16_t mss;
+    uint8_t window_scale;
+    uint8_t sack_block_count;
+    bool send_window_scale : 1;
+    bool send_sack_permitted : 1;
+    bool send_timestamp : 1;
+    uint32_t timestamp_value;
+    uint32_t timestamp_echo;
+    struct tcp_sack_block sack_blocks[TCP_MAX_SACK_BLOCKS];
     uint32_t data_offset;
     uint16_t data_length;
     struct ring_buffer *data_rb;
@@ -87,6 +138,7 @@ int net_send_tcp_from_socket(struct socket *socket, uint32_t sequence_start, uin
 int net_send_tcp(struct ip_v4_address dest, struct tcp_packet_options *opts, struct timespec *send_time_ptr);
 void net_tcp_recieve(struct packet *packet);
 void net_init_tcp_packet(struct tcp_packet *packet, struct tcp_packet_options *opts);
+uint32_t tcp_time_ms(void);
 
 void net_tcp_log(struct ip_v4_address source, struct ip_v4_address destination, struct packet *net_packet);
 
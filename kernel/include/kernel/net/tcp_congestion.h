@@ -0,0 +1,55 @@
+#ifndef _KERNEL_NET_TCP_CONGESTION_H
+#define _KERNEL_NET_TCP_CONGESTION_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct socket;
+struct tcp_control_block;
+struct tcp_sack_block;
+
+#define TCP_CONGESTION_NAME_MAX 16
+
+// Fast retransmit starts after this many duplicate acknowledgements.
+#define TCP_DUPLICATE_ACK_THRESHOLD 3
+
+// The most disjoint ranges of SACKed data remembered by the sender. Once full, the highest range is forgotten, which
+// only makes the sender think more data is still in flight.
+#define TCP_MAX_SACK_SCOREBOARD 16
+
+struct tcp_congestion_ops {
+    const char *name;
+
+    // Grows the congestion window when bytes_acked new bytes are acknowledged outside of slow start and recovery.
+    void (*on_congestion_avoidance)(struct tcp_control_block *tcb, uint32_t bytes_acked);
+
+    // Records a loss, and returns the new slow start threshold.
+    uint32_t (*on_loss)(struct tcp_control_block *tcb);
+};
+
+// State kept by CUBIC (RFC 8312) between losses. Windows are measured in segments, and times in milliseconds.
+struct tcp_cubic_state {
+    uint32_t w_max;
+    uint32_t k;
+    uint32_t epoch_start;
+    uint32_t reno_window;
+    bool epoch_valid;
+};
+
+struct tcp_congestion_ops *tcp_find_congestion_ops(const char *name);
+struct tcp_congestion_ops *tcp_default_congestion_ops(void);
+
+void tcp_congestion_init(struct tcp_control_block *tcb);
+void tcp_congestion_on_timeout(struct tcp_control_block *tcb);
+ssize_t tcp_congestion_usable_window(struct tcp_control_block *tcb);
+
+void tcp_on_new_ack(struct socket *socket, uint32_t bytes_acked);
+void tcp_on_duplicate_ack(struct socket *socket);
+int tcp_retransmit_lost_segments(struct socket *socket);
+
+bool tcp_update_sack_scoreboard(struct tcp_control_block *tcb, const struct tcp_sack_block *blocks, size_t block_count);
+void tcp_trim_sack_scoreboard(struct tcp_control_block *tcb);
+
+#endif /* _KERNEL_NET_TCP_CONGESTION_H */
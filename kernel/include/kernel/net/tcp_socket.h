@@ -4,13 +4,25 @@
 #include <stdint.h>
 
 #include <kernel/net/ip.h>
+#include <kernel/net/tcp.h>
+#include <kernel/net/tcp_congestion.h>
 #include <kernel/util/hash_map.h>
 #include <kernel/util/ring_buffer.h>
 
 struct destination_cache_entry;
 struct network_interface;
+struct packet;
 struct timer;
 
+// Both the send and recieve buffers are this large. Window scaling lets the peer use all of the recieve buffer.
+#define TCP_BUFFER_SIZE (256 * 1024)
+
+// Sequence number comparisons, which work across wrap around.
+#define TCP_SEQ_LT(a, b)  ((int32_t) ((a) - (b)) < 0)
+#define TCP_SEQ_LEQ(a, b) ((int32_t) ((a) - (b)) <= 0)
+#define TCP_SEQ_GT(a, b)  ((int32_t) ((a) - (b)) > 0)
+#define TCP_SEQ_GEQ(a, b) ((int32_t) ((a) - (b)) >= 0)
+
 enum tcp_state {
     TCP_CLOSED,
     TCP_LITSEN,
@@ -38,9 +50,20 @@ struct tcp_socket_mapping {
     struct socket *socket;
 };
 
+// A segment recieved ahead of recv_next, which waits until the data before it arrives. The packet holds the segment's
+// data as its payload, and is NULL for a FIN without data.
+struct tcp_out_of_order_segment {
+    struct list_node queue;
+    uint32_t sequence_start;
+    uint32_t sequence_end;
+    bool fin;
+    struct packet *packet;
+};
+
 struct tcp_control_block {
     uint32_t send_unacknowledged;
     uint32_t send_next;
+    uint32_t send_max;
     uint32_t send_window;
     uint32_t send_window_max;
     uint32_t send_wl1;
@@ -50,8 +73,26 @@ struct tcp_control_block {
     uint32_t recv_window;
     uint32_t recv_mss;
     uint32_t time_first_sent_sequence_number;
+    uint32_t congestion_window;
+    uint32_t slow_start_threshold;
+    uint32_t bytes_acked;
+    uint32_t duplicate_acks;
+    uint32_t recover;
+    uint32_t recovery_retransmit_next;
+    uint32_t timestamp_recent;
+    uint32_t out_of_order_last_start;
+    uint8_t send_window_scale;
+    uint8_t recv_window_scale;
+    struct tcp_congestion_ops *congestion_ops;
+    struct tcp_cubic_state cubic;
+    int sack_scoreboard_count;
+    struct tcp_sack_block sack_scoreboard[TCP_MAX_SACK_SCOREBOARD];
+    struct list_node out_of_order_queue;
     struct ring_buffer send_buffer;
-    struct ring_buffer recv_buffer;
+
+    // Recieved packets whose payload has not been read yet, in order, and the total length of their payloads.
+    struct list_node recv_queue;
+    uint32_t recv_queue_length;
     struct destination_cache_entry *destination;
     struct network_interface *interface;
     struct timer *time_wait_timer;
@@ -69,13 +110,23 @@ struct tcp_control_block {
     bool reset_rto_once_established : 1;
     bool time_first_sent_valid : 1;
     bool first_rtt_sample : 1;
+    bool in_recovery : 1;
+    bool window_scale_enabled : 1;
+    bool sack_enabled : 1;
+    bool timestamps_enabled : 1;
 };
 
 struct socket *net_get_tcp_socket_by_connection_info(struct tcp_connection_info *info);
 
 bool tcp_update_recv_window(struct socket *socket);
+uint32_t tcp_segment_size(struct tcp_control_block *tcb);
+uint32_t tcp_sequence_end(struct tcp_control_block *tcb);
 int tcp_send_segments(struct socket *socket);
 struct tcp_control_block *net_allocate_tcp_control_block(struct socket *socket);
 void net_free_tcp_control_block(struct socket *socket);
 
+static inline uint32_t tcp_recv_space(const struct tcp_control_block *tcb) {
+    return TCP_BUFFER_SIZE - tcb->recv_queue_length;
+}
+
 #endif /* _KERNEL_NET_TCP_SOCKET_H */
@@ -12,6 +12,7 @@
 #include <kernel/util/hash_map.h>
 #include <kernel/util/list.h>
 #include <kernel/util/mutex.h>
+#include <kernel/util/rb_tree.h>
 #include <kernel/util/spinlock.h>
 
 // clang-format off
@@ -55,7 +56,20 @@ struct process {
     struct tnode *exe;
     struct file_descriptor files[FOPEN_MAX];
 
+    // The regions are kept both in a list sorted by start address and in a tree keyed by start address, which is used
+    // for lookups. Both are modified with the process lock held, and additionally with process_memory_lock held while
+    // links are changed, so that lookups which cannot take the process lock (like page faults) can walk the tree under
+    // the spinlock instead. The sequence count changes with every change, which invalidates the lookup caches of the
+    // tasks.
     struct vm_region *process_memory;
+    struct rb_tree process_memory_tree;
+    spinlock_t process_memory_lock;
+    unsigned int process_memory_seq;
+
+    // Anonymous mappings are placed by searching upward from free_area_cache, unless the mapping fits in the largest
+    // hole which the search has skipped below it.
+    uintptr_t free_area_cache;
+    size_t free_area_cache_hole_size;
 
     struct user_mutex *used_user_mutexes;
     spinlock_t user_mutex_lock;
@@ -107,9 +121,14 @@ struct process {
     struct rlimit limits[RLIMIT_NLIMITS];
 
     int should_profile;
-    struct vm_region *profile_buffer;
-    size_t profile_buffer_size;
+    unsigned int profile_frequency;
+    unsigned int profile_flags;
+    // Memory map events are written under the spinlock, and numbered by the generation counter.
+    struct profile_buffer *profile_memory_map_buffer;
+    unsigned int profile_memory_map_generation;
     spinlock_t profile_buffer_lock;
+    // The rings of every task which has been profiled, including exited ones which have not been drained yet.
+    struct list_node profile_buffers;
 
     bool should_trace : 1;
     bool zombie : 1;
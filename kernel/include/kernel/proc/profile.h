@@ -1,21 +1,44 @@
 #ifndef _KERNEL_PROC_PROFILE_H
 #define _KERNEL_PROC_PROFILE_H 1
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/iros.h>
 #include <sys/types.h>
 
+#include <kernel/util/list.h>
+
 struct process;
+struct task;
 struct task_state;
 
+// A ring of length prefixed profile events with a single producer and a single consumer. The producer of a task's
+// ring is that task, writing with interrupts disabled, and the producer of the memory map ring is whoever holds the
+// process's profile_buffer_lock. The consumer is proc_read_profile(), which holds the process's lock. head and tail
+// only ever increase, and are masked by the size (a power of 2) when indexing into the region.
+struct profile_buffer {
+    struct list_node list;
+    struct vm_region *region;
+    size_t size;
+    size_t head;
+    size_t tail;
+    uint32_t lost;
+    pid_t tid;
+    bool exited;
+};
+
 void proc_record_profile_stack(struct task_state *task_state);
 void proc_record_memory_map(struct process *process);
-void proc_write_profile_buffer(struct process *process, const void *buffer, size_t size);
+void proc_write_profile_buffer(struct profile_buffer *buffer, const void *event, size_t size);
+
+int proc_add_profile_buffer(struct task *task);
+void proc_reset_profile_buffers(struct process *process);
+void proc_free_profile_buffers(struct process *process);
 
-void proc_maybe_start_profile_timer(void);
+void proc_maybe_start_profile_timer(unsigned int frequency);
 void proc_maybe_stop_profile_timer(void);
 
-int proc_enable_profiling(pid_t pid);
+int proc_enable_profiling(pid_t pid, const struct profile_options *options);
 ssize_t proc_read_profile(pid_t pid, void *buffer, size_t size);
 int proc_disable_profiling(pid_t pid);
 
@@ -34,6 +34,7 @@ enum sched_state {
 struct clock;
 struct process;
 struct processor;
+struct profile_buffer;
 
 struct args_context {
     size_t prepend_argc;
@@ -69,8 +70,8 @@ struct task {
     // Inline list pointer used by process finializer
     struct task *finialize_queue_next;
 
-    // Pointer to the processor this task will run on. Currently, this will stay the same
-    // throughout the task's lifetime.
+    // Pointer to the processor this task will run on. The scheduler can migrate the task
+    // to another processor, but only while it is runnable and not running.
     struct processor *active_processor;
 
     // Pointer to the saved user task state if this task task is a user task and is
@@ -91,6 +92,13 @@ struct task {
     int tid;
     int sched_ticks_remaining;
 
+    // SCHED_OTHER, SCHED_FIFO or SCHED_RR, and the real-time priority (1 to 99) for the latter two.
+    int sched_policy;
+    int sched_rt_priority;
+
+    // Bit mask of the processor ids the task may not run on, so that zero allows any processor.
+    uint64_t sched_disallowed_processors;
+
     // Used to restart interrupted signals.
     int last_system_call;
 
@@ -107,6 +115,12 @@ struct task {
     struct clock *task_clock;
 
     struct process *process;
+    // The region found by the last user address lookup, valid while the process's sequence count is unchanged.
+    struct vm_region *vm_lookup_cache;
+    unsigned int vm_lookup_cache_seq;
+    // The ring the profiler writes this task's samples to, and its share of the profile timer's ticks.
+    struct profile_buffer *profile_buffer;
+    unsigned long profile_ticks;
     struct __locked_robust_mutex_node **locked_robust_mutex_list_head;
 
     struct arch_fpu_state fpu;
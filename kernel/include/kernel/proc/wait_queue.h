@@ -7,6 +7,9 @@
 struct wait_queue_entry {
     struct list_node list;
     struct task *task;
+
+    // If set, this is called on wake up instead of unblocking the task. It runs with the queue's lock held.
+    void (*wake_function)(struct wait_queue_entry *entry);
 };
 
 struct wait_queue {
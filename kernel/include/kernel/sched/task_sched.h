@@ -28,6 +28,12 @@ int queue_signal_process(pid_t pid, int signum, void *val);
 
 void exit_process(struct process *process, struct task *exclude);
 
+int sched_set_affinity(pid_t pid, uint64_t allowed_processors);
+int sched_get_affinity(pid_t pid, uint64_t *allowed_processors);
+int sched_set_scheduler(pid_t pid, int policy, int priority);
+int sched_get_scheduler(pid_t pid);
+int sched_get_priority(pid_t pid);
+
 uint64_t sched_idle_ticks(void);
 uint64_t sched_user_ticks(void);
 uint64_t sched_kernel_ticks(void);
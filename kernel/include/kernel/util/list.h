@@ -47,6 +47,19 @@ static inline void list_clear(struct list_node *head) {
     init_list(head);
 }
 
+// Moves every element of other to the end of head, leaving other empty.
+static inline void list_splice_tail(struct list_node *head, struct list_node *other) {
+    if (list_is_empty(other)) {
+        return;
+    }
+
+    other->next->prev = head->prev;
+    head->prev->next = other->next;
+    other->prev->next = head;
+    head->prev = other->prev;
+    init_list(other);
+}
+
 #define list_entry container_of
 
 #define list_for_each_entry(head, iter, type, member)                                    \
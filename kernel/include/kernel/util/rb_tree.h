@@ -0,0 +1,50 @@
+#ifndef _KERNEL_UTIL_RB_TREE_H
+#define _KERNEL_UTIL_RB_TREE_H 1
+
+#include <kernel/util/macros.h>
+
+// An intrusive red-black tree. The tree does not know how its entries are ordered: callers walk down from the root to
+// find where a new node belongs, link it there with rb_link_node(), and then call rb_insert_color() to rebalance.
+
+struct rb_node {
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    bool red;
+};
+
+struct rb_tree {
+    struct rb_node *root;
+};
+
+#define RB_TREE_INITIALIZER \
+    { .root = NULL }
+
+static inline void init_rb_tree(struct rb_tree *tree) {
+    tree->root = NULL;
+}
+
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent, struct rb_node **link) {
+    node->parent = parent;
+    node->left = node->right = NULL;
+    node->red = true;
+    *link = node;
+}
+
+void rb_insert_color(struct rb_tree *tree, struct rb_node *node);
+void rb_erase(struct rb_tree *tree, struct rb_node *node);
+
+struct rb_node *rb_first(struct rb_tree *tree);
+struct rb_node *rb_last(struct rb_tree *tree);
+struct rb_node *rb_next(struct rb_node *node);
+struct rb_node *rb_prev(struct rb_node *node);
+
+#define rb_entry container_of
+
+#define rb_entry_or_null(node, type, member)      \
+    ({                                            \
+        struct rb_node *__n = (node);             \
+        __n ? rb_entry(__n, type, member) : NULL; \
+    })
+
+#endif /* _KERNEL_UTIL_RB_TREE_H */
@@ -21,6 +21,7 @@
 #include <sys/utsname.h>
 #include <sys/wait.h>
 
+#include <kernel/fs/epoll.h>
 #include <kernel/fs/file.h>
 #include <kernel/fs/procfs.h>
 #include <kernel/fs/vfs.h>
@@ -317,9 +318,7 @@ SYS_CALL(exit) {
     }
 
     if (process->should_profile) {
-        spin_lock(&process->profile_buffer_lock);
         proc_record_profile_stack(NULL);
-        spin_unlock(&process->profile_buffer_lock);
     }
 
     exit_process(process, NULL);
@@ -1116,6 +1115,9 @@ SYS_CALL(create_task) {
     task->process = current->process;
     task->sig_mask = current->sig_mask;
     task->sig_pending = 0;
+    task->sched_policy = current->sched_policy;
+    task->sched_rt_priority = current->sched_rt_priority;
+    task->sched_disallowed_processors = current->sched_disallowed_processors;
     init_list(&task->queued_signals);
     init_spinlock(&task->sig_lock);
     init_spinlock(&task->unblock_lock);
@@ -1136,6 +1138,10 @@ SYS_CALL(create_task) {
 
     mutex_lock(&task->process->lock);
     list_append(&task->process->task_list, &task->process_list);
+    if (task->process->should_profile) {
+        // Without a buffer the task is simply not sampled, which is no reason to fail creating it.
+        proc_add_profile_buffer(task);
+    }
     mutex_unlock(&task->process->lock);
 
     sched_add_task(task);
@@ -1353,6 +1359,8 @@ SYS_CALL(pselect) {
 SYS_CALL(sched_yield) {
     SYS_BEGIN();
 
+    // Giving up the rest of the time slice also moves real-time tasks behind the others of the same priority.
+    get_current_task()->sched_ticks_remaining = 0;
     kernel_yield();
     SYS_RETURN(0);
 }
@@ -1930,8 +1938,9 @@ SYS_CALL(enable_profiling) {
     SYS_BEGIN();
 
     SYS_PARAM1(pid_t, pid);
+    SYS_PARAM2_VALIDATE(const struct profile_options *, options, validate_read_or_null, sizeof(struct profile_options));
 
-    SYS_RETURN(proc_enable_profiling(pid));
+    SYS_RETURN(proc_enable_profiling(pid, options));
 }
 
 SYS_CALL(read_profile) {
@@ -2069,6 +2078,136 @@ SYS_CALL(poweroff) {
     abort();
 }
 
+SYS_CALL(sched_setaffinity) {
+    SYS_BEGIN();
+
+    SYS_PARAM1(pid_t, pid);
+    SYS_PARAM2(size_t, size);
+    SYS_PARAM3_VALIDATE(const void *, mask, validate_read, size);
+
+    uint64_t allowed_processors = 0;
+    memcpy(&allowed_processors, mask, MIN(size, sizeof(allowed_processors)));
+    SYS_RETURN(sched_set_affinity(pid, allowed_processors));
+}
+
+SYS_CALL(sched_getaffinity) {
+    SYS_BEGIN();
+
+    SYS_PARAM1(pid_t, pid);
+    SYS_PARAM2(size_t, size);
+    SYS_PARAM3_VALIDATE(void *, mask, validate_write, size);
+
+    uint64_t allowed_processors;
+    int ret = sched_get_affinity(pid, &allowed_processors);
+    if (ret < 0) {
+        SYS_RETURN(ret);
+    }
+
+    memset(mask, 0, size);
+    memcpy(mask, &allowed_processors, MIN(size, sizeof(allowed_processors)));
+    SYS_RETURN(0);
+}
+
+SYS_CALL(sched_setscheduler) {
+    SYS_BEGIN();
+
+    SYS_PARAM1(pid_t, pid);
+    SYS_PARAM2(int, policy);
+    SYS_PARAM3(int, priority);
+
+    SYS_RETURN(sched_set_scheduler(pid, policy, priority));
+}
+
+SYS_CALL(sched_getscheduler) {
+    SYS_BEGIN();
+
+    SYS_PARAM1(pid_t, pid);
+
+    SYS_RETURN(sched_get_scheduler(pid));
+}
+
+SYS_CALL(sched_getparam) {
+    SYS_BEGIN();
+
+    SYS_PARAM1(pid_t, pid);
+
+    SYS_RETURN(sched_get_priority(pid));
+}
+
+SYS_CALL(splice) {
+    SYS_BEGIN();
+
+    SYS_PARAM1_TRANSFORM(struct file *, in, int, get_file);
+    SYS_PARAM2_VALIDATE(off_t *, in_offset, validate_write_or_null, sizeof(off_t));
+    SYS_PARAM3_TRANSFORM(struct file *, out, int, get_file);
+    SYS_PARAM4_VALIDATE(off_t *, out_offset, validate_write_or_null, sizeof(off_t));
+    SYS_PARAM5(size_t, len);
+    SYS_PARAM6(unsigned int, flags);
+
+    SYS_RETURN(fs_splice(in, in_offset, out, out_offset, len, flags));
+}
+
+SYS_CALL(tee) {
+    SYS_BEGIN();
+
+    SYS_PARAM1_TRANSFORM(struct file *, in, int, get_file);
+    SYS_PARAM2_TRANSFORM(struct file *, out, int, get_file);
+    SYS_PARAM3(size_t, len);
+    SYS_PARAM4(unsigned int, flags);
+
+    SYS_RETURN(fs_tee(in, out, len, flags));
+}
+
+SYS_CALL(epoll_create) {
+    SYS_BEGIN();
+
+    SYS_PARAM1(int, flags);
+
+    SYS_RETURN(fs_epoll_create(flags));
+}
+
+SYS_CALL(epoll_ctl) {
+    SYS_BEGIN();
+
+    SYS_PARAM1_TRANSFORM(struct file *, epoll_file, int, get_file);
+    SYS_PARAM2(int, op);
+    SYS_PARAM3(int, fd);
+    SYS_PARAM4_VALIDATE(const struct epoll_event *, event, validate_read_or_null, sizeof(struct epoll_event));
+
+    struct file *file;
+    int ret = get_file(fd, &file);
+    if (ret < 0) {
+        SYS_RETURN(ret);
+    }
+
+    SYS_RETURN(fs_epoll_ctl(epoll_file, op, fd, file, event));
+}
+
+SYS_CALL(epoll_pwait) {
+    SYS_BEGIN_PSELECT();
+
+    SYS_PARAM1_TRANSFORM(struct file *, epoll_file, int, get_file);
+    SYS_PARAM3_VALIDATE(int, max_events, validate_positive, 0);
+    SYS_PARAM2_VALIDATE(struct epoll_event *, events, validate_write, max_events * sizeof(struct epoll_event));
+    SYS_PARAM4_VALIDATE(const struct timespec *, timeout, validate_read_or_null, sizeof(struct timespec));
+    SYS_PARAM5_VALIDATE(const sigset_t *, sigmask, validate_read_or_null, sizeof(sigset_t));
+
+    struct task *current = get_current_task();
+    if (sigmask) {
+        memcpy(&current->saved_sig_mask, &current->sig_mask, sizeof(sigset_t));
+        memcpy(&current->sig_mask, sigmask, sizeof(sigset_t));
+        current->in_sigsuspend = true;
+    }
+
+    int count = fs_epoll_wait(epoll_file, events, max_events, timeout);
+
+    if (current->in_sigsuspend) {
+        SYS_RETURN_RESTORE_SIGMASK(count);
+    }
+
+    SYS_RETURN(count);
+}
+
 SYS_CALL(invalid_system_call) {
     SYS_BEGIN();
     SYS_RETURN(-ENOSYS);
@@ -9,6 +9,7 @@
 #include <kernel/boot/boot_info.h>
 #include <kernel/fs/dev.h>
 #include <kernel/fs/disk_sync.h>
+#include <kernel/fs/page_cache.h>
 #include <kernel/fs/vfs.h>
 #include <kernel/hal/hal.h>
 #include <kernel/hal/output.h>
@@ -43,6 +44,7 @@ void kernel_main(int boot_type, void *boot_info) {
     init_task_finalizer();
     INIT_DO_LEVEL(net);
     init_disk_sync_task();
+    init_page_cache_readahead_task();
 
     struct fs_root_desc root_desc = {
         .type = FS_ROOT_TYPE_FS_NAME,
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <sys/mman.h>
 
+#include <kernel/fs/page_cache.h>
 #include <kernel/fs/vfs.h>
 #include <kernel/hal/output.h>
 #include <kernel/hal/processor.h>
@@ -50,7 +51,9 @@ static uintptr_t inode_handle_fault(struct vm_object *self, uintptr_t offset_int
     //        to take a mutex here.
     mutex_lock(&self->lock);
     if (!data->owned) {
-        return (uintptr_t) data->phys_pages[page_index];
+        uintptr_t ret = (uintptr_t) data->phys_pages[page_index];
+        mutex_unlock(&self->lock);
+        return ret;
     }
 
     if (data->phys_pages[page_index]) {
@@ -59,28 +62,28 @@ static uintptr_t inode_handle_fault(struct vm_object *self, uintptr_t offset_int
         return ret;
     }
 
-    struct phys_page *page = allocate_phys_page();
-    data->phys_pages[page_index] = page;
-
-    uintptr_t phys_addr = page->phys_addr;
+    struct phys_page *page = page_cache_get_page(data->inode, page_index);
+    if (!page) {
+        mutex_unlock(&self->lock);
+        return 0;
+    }
 
-    // FIXME: either directly map the page into the current process's address space or
-    //        add an API to read physical pages directly, without having to create a temporary
-    //        mapping.
-    // NOTE:  a temporary physical address mapping cannot be used here, since reading from an inode
-    //        takes a mutex.
-    struct vm_region *region = vm_allocate_physically_mapped_kernel_region(phys_addr, PAGE_SIZE);
-    char *phys_page_mapping = (void *) region->start;
-
-    struct inode *inode = data->inode;
-    ssize_t read = inode->i_op->read(inode, phys_page_mapping, PAGE_SIZE, page_index * PAGE_SIZE);
-    if (read == -1) {
-        debug_log("Failed to read from disk: [ %s ]\n", strerror(-read));
-        read = 0;
+    // Shared mappings use the page cache's page, so that they see the same data as read(). Private mappings can be
+    // written to, so they get their own copy.
+    if (!data->shared) {
+        struct phys_page *cache_page = page;
+        page = allocate_phys_page();
+
+        char *cache_mapping = create_temp_phys_addr_mapping(cache_page->phys_addr);
+        char *page_mapping = create_temp_phys_addr_mapping(page->phys_addr);
+        memcpy(page_mapping, cache_mapping, PAGE_SIZE);
+        free_temp_phys_addr_mapping(page_mapping);
+        free_temp_phys_addr_mapping(cache_mapping);
+        drop_phys_page(cache_page);
     }
 
-    memset(phys_page_mapping + read, 0, PAGE_SIZE - read);
-    vm_free_physically_mapped_kernel_region(region);
+    data->phys_pages[page_index] = page;
+    uintptr_t phys_addr = page->phys_addr;
     mutex_unlock(&self->lock);
 
     *is_cow = false;
@@ -119,7 +122,7 @@ static int inode_kill(struct vm_object *self) {
 
 static struct vm_object_operations inode_ops = { .map = &inode_map, .handle_fault = &inode_handle_fault, .kill = &inode_kill };
 
-struct vm_object *vm_create_inode_object(struct inode *inode, int map_flags __attribute__((unused))) {
+struct vm_object *vm_create_inode_object(struct inode *inode, int map_flags) {
     size_t num_pages = ((inode->size + PAGE_SIZE - 1) / PAGE_SIZE);
     struct inode_vm_object_data *data = malloc(sizeof(struct inode_vm_object_data) + num_pages * sizeof(struct phys_page *));
     assert(data);
@@ -128,6 +131,7 @@ struct vm_object *vm_create_inode_object(struct inode *inode, int map_flags __at
 
     data->inode = bump_inode_reference(inode);
     data->owned = true;
+    data->shared = !!(map_flags & MAP_SHARED);
     data->pages = num_pages;
     data->kernel_region = NULL;
     memset(data->phys_pages, 0, num_pages * sizeof(struct phys_page *));
@@ -142,6 +146,7 @@ struct vm_object *vm_create_direct_inode_object(struct inode *inode, struct vm_r
 
     data->inode = bump_inode_reference(inode);
     data->owned = false;
+    data->shared = true;
     data->pages = num_pages;
     data->kernel_region = kernel_region;
 
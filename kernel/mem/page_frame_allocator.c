@@ -1,3 +1,5 @@
+#include <assert.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -8,9 +10,11 @@
 #include <kernel/boot/boot_info.h>
 #include <kernel/boot/multiboot2.h>
 #include <kernel/boot/xen.h>
+#include <kernel/fs/page_cache.h>
 #include <kernel/hal/block.h>
 #include <kernel/hal/hal.h>
 #include <kernel/hal/output.h>
+#include <kernel/hal/processor.h>
 #include <kernel/mem/kernel_vm.h>
 #include <kernel/mem/page.h>
 #include <kernel/mem/page_frame_allocator.h>
@@ -21,42 +25,272 @@
 
 // #define PAGE_FRAME_ALLOCATOR_DEBUG
 
+#define MAX_PHYS_PAGES   (PAGE_BITMAP_SIZE * CHAR_BIT)
+#define WORD_BITS        64
+#define WORDS_FOR(count) (((count) + WORD_BITS - 1) / WORD_BITS)
+
+// Upper bounds on the words needed by the free areas of every order, since each order has half the blocks of the one below.
+#define FREE_AREA_STORAGE_WORDS                                                 \
+    (2 * WORDS_FOR(MAX_PHYS_PAGES) + 2 * WORDS_FOR(WORDS_FOR(MAX_PHYS_PAGES)) + \
+     2 * WORDS_FOR(WORDS_FOR(WORDS_FOR(MAX_PHYS_PAGES))) + 3 * (PAGE_FRAME_MAX_ORDER + 1))
+
+// The free blocks of one order. Bit i of blocks is set when the block at page (i << order) is free. The summary has a bit
+// set for every non-zero word of blocks, and top has a bit set for every non-zero word of the summary, so the first free
+// block is found in a few steps.
+struct free_area {
+    uint64_t *blocks;
+    uint64_t *summary;
+    uint64_t *top;
+    size_t top_words;
+    size_t free_count;
+};
+
+// A set bit in the page bitset means the page is allocated, reserved, or sitting in a per processor cache.
 static uintptr_t page_bitset_storage[PAGE_BITMAP_SIZE / sizeof(uintptr_t)];
 static struct bitset page_bitset;
-static spinlock_t bitmap_lock = SPINLOCK_INITIALIZER;
+
+static uint64_t free_area_storage[FREE_AREA_STORAGE_WORDS];
+static struct free_area free_areas[PAGE_FRAME_MAX_ORDER + 1];
+static spinlock_t buddy_lock = SPINLOCK_INITIALIZER;
 
 struct phys_page_stats g_phys_page_stats = { 0 };
 
+static void init_free_areas(void) {
+    uint64_t *storage = free_area_storage;
+    for (int order = 0; order <= PAGE_FRAME_MAX_ORDER; order++) {
+        size_t block_words = WORDS_FOR(MAX_PHYS_PAGES >> order);
+        size_t summary_words = WORDS_FOR(block_words);
+        size_t top_words = WORDS_FOR(summary_words);
+
+        struct free_area *area = &free_areas[order];
+        area->blocks = storage;
+        area->summary = area->blocks + block_words;
+        area->top = area->summary + summary_words;
+        area->top_words = top_words;
+        area->free_count = 0;
+        storage = area->top + top_words;
+    }
+    assert(storage <= free_area_storage + FREE_AREA_STORAGE_WORDS);
+}
+
+static bool free_area_test(const struct free_area *area, size_t block) {
+    return area->blocks[block / WORD_BITS] & (1ULL << (block % WORD_BITS));
+}
+
+static void free_area_add(struct free_area *area, size_t block) {
+    size_t word = block / WORD_BITS;
+    size_t summary_word = word / WORD_BITS;
+    if (!area->blocks[word]) {
+        if (!area->summary[summary_word]) {
+            area->top[summary_word / WORD_BITS] |= 1ULL << (summary_word % WORD_BITS);
+        }
+        area->summary[summary_word] |= 1ULL << (word % WORD_BITS);
+    }
+    area->blocks[word] |= 1ULL << (block % WORD_BITS);
+    area->free_count++;
+}
+
+static void free_area_remove(struct free_area *area, size_t block) {
+    size_t word = block / WORD_BITS;
+    size_t summary_word = word / WORD_BITS;
+    area->blocks[word] &= ~(1ULL << (block % WORD_BITS));
+    if (!area->blocks[word]) {
+        area->summary[summary_word] &= ~(1ULL << (word % WORD_BITS));
+        if (!area->summary[summary_word]) {
+            area->top[summary_word / WORD_BITS] &= ~(1ULL << (summary_word % WORD_BITS));
+        }
+    }
+    area->free_count--;
+}
+
+// Returns the lowest free block, which must exist.
+static size_t free_area_first(const struct free_area *area) {
+    for (size_t i = 0; i < area->top_words; i++) {
+        if (area->top[i]) {
+            size_t summary_word = i * WORD_BITS + __builtin_ctzll(area->top[i]);
+            size_t word = summary_word * WORD_BITS + __builtin_ctzll(area->summary[summary_word]);
+            return word * WORD_BITS + __builtin_ctzll(area->blocks[word]);
+        }
+    }
+    assert(false);
+    return 0;
+}
+
+// Must be called with buddy_lock held. Returns the first page of the block, or 0 if there is none.
+static size_t buddy_allocate(int order) {
+    for (int current = order; current <= PAGE_FRAME_MAX_ORDER; current++) {
+        struct free_area *area = &free_areas[current];
+        if (!area->free_count) {
+            continue;
+        }
+
+        size_t block = free_area_first(area);
+        free_area_remove(area, block);
+
+        // Split the block, leaving the upper half free at each smaller order.
+        while (current > order) {
+            current--;
+            block <<= 1;
+            free_area_add(&free_areas[current], block + 1);
+        }
+
+        size_t page = block << order;
+        bitset_set_bit_sequence(&page_bitset, page, 1UL << order);
+        return page;
+    }
+    return 0;
+}
+
+// Must be called with buddy_lock held. The block's pages must all be allocated.
+static void buddy_free(size_t page, int order) {
+    bitset_clear_bit_sequence(&page_bitset, page, 1UL << order);
+
+    size_t block = page >> order;
+    while (order < PAGE_FRAME_MAX_ORDER && free_area_test(&free_areas[order], block ^ 1)) {
+        free_area_remove(&free_areas[order], block ^ 1);
+        block >>= 1;
+        order++;
+    }
+    free_area_add(&free_areas[order], block);
+}
+
+// Must be called with buddy_lock held. Takes a free page out of whichever free block contains it.
+static void buddy_reserve(size_t page) {
+    for (int order = 0; order <= PAGE_FRAME_MAX_ORDER; order++) {
+        size_t block = page >> order;
+        if (!free_area_test(&free_areas[order], block)) {
+            continue;
+        }
+
+        free_area_remove(&free_areas[order], block);
+        while (order > 0) {
+            order--;
+            free_area_add(&free_areas[order], (page >> order) ^ 1);
+        }
+        bitset_set_bit(&page_bitset, page);
+        return;
+    }
+    assert(false);
+}
+
+// Frees pages [start, end) as the largest aligned blocks which fit.
+static void buddy_free_range(size_t start, size_t end) {
+    while (start < end) {
+        int order = start ? __builtin_ctzl(start) : PAGE_FRAME_MAX_ORDER;
+        order = MIN(order, PAGE_FRAME_MAX_ORDER);
+        while ((1UL << order) > end - start) {
+            order--;
+        }
+        buddy_free(start, order);
+        start += 1UL << order;
+    }
+}
+
 void mark_used(uintptr_t phys_addr_start, uintptr_t length) {
     uintptr_t num_pages = NUM_PAGES(phys_addr_start, phys_addr_start + length);
-    uintptr_t bit_index_base = phys_addr_start / PAGE_SIZE;
-    bitset_set_bit_sequence(&page_bitset, bit_index_base, num_pages);
+    uintptr_t page_base = phys_addr_start / PAGE_SIZE;
+
+    spin_lock(&buddy_lock);
+    for (uintptr_t page = page_base; page < page_base + num_pages; page++) {
+        if (!bitset_get_bit(&page_bitset, page)) {
+            buddy_reserve(page);
+        }
+    }
+    spin_unlock(&buddy_lock);
 }
 
-void mark_available(uintptr_t phys_addr_start, uintptr_t length) {
+static void mark_available(uintptr_t phys_addr_start, uintptr_t length) {
     uintptr_t num_pages = NUM_PAGES(phys_addr_start, phys_addr_start + length);
-    uintptr_t bit_index_base = phys_addr_start / PAGE_SIZE;
-    bitset_clear_bit_sequence(&page_bitset, bit_index_base, num_pages);
+    uintptr_t page_base = phys_addr_start / PAGE_SIZE;
+
+    // Memory map entries can overlap, so only pages which are still reserved are freed.
+    spin_lock(&buddy_lock);
+    for (uintptr_t page = page_base; page < page_base + num_pages && page < MAX_PHYS_PAGES; page++) {
+        if (bitset_get_bit(&page_bitset, page)) {
+            buddy_free(page, 0);
+        }
+    }
+    spin_unlock(&buddy_lock);
+}
+
+// The per processor caches only exist once the boot processor is set up. Before then, pages go straight to the buddy
+// system.
+static struct page_frame_cache *current_page_frame_cache(void) {
+    if (!bsp_enabled()) {
+        return NULL;
+    }
+    return &get_current_processor()->page_frame_cache;
+}
+
+// Must be called with the cache's lock held.
+static void refill_page_frame_cache(struct page_frame_cache *cache) {
+    spin_lock(&buddy_lock);
+    while (cache->count < PAGE_FRAME_CACHE_BATCH) {
+        size_t page = buddy_allocate(0);
+        if (!page) {
+            break;
+        }
+        cache->pages[cache->count++] = page * PAGE_SIZE;
+    }
+    spin_unlock(&buddy_lock);
 }
 
-static uintptr_t try_get_next_phys_page(struct process *process) {
-    spin_lock(&bitmap_lock);
+// Must be called with the cache's lock held. Returns the oldest pages, since the newest are the most likely to be
+// in the processor's caches.
+static void drain_page_frame_cache(struct page_frame_cache *cache, int count) {
+    spin_lock(&buddy_lock);
+    for (int i = 0; i < count; i++) {
+        buddy_free(cache->pages[i] / PAGE_SIZE, 0);
+    }
+    spin_unlock(&buddy_lock);
 
-    size_t page_index;
-    if (bitset_find_first_free_bit(&page_bitset, &page_index) == 0) {
-        bitset_set_bit(&page_bitset, page_index);
-        g_phys_page_stats.phys_memory_allocated += PAGE_SIZE;
-        spin_unlock(&bitmap_lock);
+    memmove(cache->pages, cache->pages + count, (cache->count - count) * sizeof(uintptr_t));
+    cache->count -= count;
+}
 
-        process->resident_memory += PAGE_SIZE;
-#ifdef PAGE_FRAME_ALLOCATOR_DEBUG
-        debug_log("allocated: [ %#.16" PRIXPTR " ]\n", (uintptr_t) (page_index * PAGE_SIZE));
-#endif /* PAGE_FRAME_ALLOCATOR_DEBUG */
-        return page_index * PAGE_SIZE;
+static void drain_all_page_frame_caches(void) {
+    if (!bsp_enabled()) {
+        return;
     }
 
-    spin_unlock(&bitmap_lock);
-    return 0;
+    for (struct processor *processor = get_processor_list(); processor; processor = processor->next) {
+        struct page_frame_cache *cache = &processor->page_frame_cache;
+        spin_lock(&cache->lock);
+        drain_page_frame_cache(cache, cache->count);
+        spin_unlock(&cache->lock);
+    }
+}
+
+uintptr_t try_get_next_phys_page(struct process *process) {
+    uintptr_t phys_addr = 0;
+
+    // Even if this task moves to another processor after looking up the cache, the cache's lock keeps it consistent.
+    struct page_frame_cache *cache = current_page_frame_cache();
+    if (cache) {
+        spin_lock(&cache->lock);
+        if (!cache->count) {
+            refill_page_frame_cache(cache);
+        }
+        if (cache->count) {
+            phys_addr = cache->pages[--cache->count];
+        }
+        spin_unlock(&cache->lock);
+    } else {
+        spin_lock(&buddy_lock);
+        phys_addr = buddy_allocate(0) * PAGE_SIZE;
+        spin_unlock(&buddy_lock);
+    }
+
+    if (!phys_addr) {
+        return 0;
+    }
+
+    __atomic_fetch_add(&g_phys_page_stats.phys_memory_allocated, PAGE_SIZE, __ATOMIC_RELAXED);
+    process->resident_memory += PAGE_SIZE;
+#ifdef PAGE_FRAME_ALLOCATOR_DEBUG
+    debug_log("allocated: [ %#.16" PRIXPTR " ]\n", phys_addr);
+#endif /* PAGE_FRAME_ALLOCATOR_DEBUG */
+    return phys_addr;
 }
 
 uintptr_t get_next_phys_page(struct process *process) {
@@ -65,32 +299,58 @@ uintptr_t get_next_phys_page(struct process *process) {
         return try_1;
     }
 
-    // The block cache will hopefully have unused pages it can release.
-    block_trim_cache();
+    // Other processors may be holding free pages in their caches.
+    drain_all_page_frame_caches();
 
     uintptr_t try_2 = try_get_next_phys_page(process);
     if (try_2) {
         return try_2;
     }
 
+    // The block cache and the page cache will hopefully have unused pages they can release.
+    block_trim_cache();
+    page_cache_trim();
+
+    uintptr_t try_3 = try_get_next_phys_page(process);
+    if (try_3) {
+        return try_3;
+    }
+
     debug_log("Out of Physical Memory\n");
     abort();
     return 0;
 }
 
 uintptr_t get_contiguous_pages(size_t pages) {
-    uintptr_t ret = 0;
-    spin_lock(&bitmap_lock);
+    int order = 0;
+    while ((1UL << order) < pages) {
+        order++;
+    }
 
-    size_t bit_start;
-    if (bitset_find_first_free_bit_sequence(&page_bitset, pages, &bit_start) == 0) {
-        bitset_set_bit_sequence(&page_bitset, bit_start, pages);
-        ret = bit_start * PAGE_SIZE;
-        g_phys_page_stats.phys_memory_allocated += pages * PAGE_SIZE;
+    size_t page = 0;
+    spin_lock(&buddy_lock);
+    if (order <= PAGE_FRAME_MAX_ORDER) {
+        // Allocate the smallest block which fits, and give back the pages past the end of the request.
+        page = buddy_allocate(order);
+        if (page) {
+            buddy_free_range(page + pages, page + (1UL << order));
+        }
+    } else {
+        // Requests larger than the biggest block fall back to searching for a run of free pages.
+        size_t bit_start;
+        if (bitset_find_first_free_bit_sequence(&page_bitset, pages, &bit_start) == 0) {
+            for (size_t i = bit_start; i < bit_start + pages; i++) {
+                buddy_reserve(i);
+            }
+            page = bit_start;
+        }
     }
+    spin_unlock(&buddy_lock);
 
-    spin_unlock(&bitmap_lock);
-    return ret;
+    if (page) {
+        __atomic_fetch_add(&g_phys_page_stats.phys_memory_allocated, pages * PAGE_SIZE, __ATOMIC_RELAXED);
+    }
+    return page * PAGE_SIZE;
 }
 
 void free_phys_page(uintptr_t phys_addr, struct process *process) {
@@ -98,15 +358,24 @@ void free_phys_page(uintptr_t phys_addr, struct process *process) {
     debug_log("freed: [ %#.16" PRIXPTR " ]\n", phys_addr);
 #endif /* PAGE_FRAME_ALLOCATOR_DEBUG */
 
-    spin_lock(&bitmap_lock);
+    struct page_frame_cache *cache = current_page_frame_cache();
+    if (cache) {
+        spin_lock(&cache->lock);
+        if (cache->count == PAGE_FRAME_CACHE_SIZE) {
+            drain_page_frame_cache(cache, PAGE_FRAME_CACHE_BATCH);
+        }
+        cache->pages[cache->count++] = phys_addr;
+        spin_unlock(&cache->lock);
+    } else {
+        spin_lock(&buddy_lock);
+        buddy_free(phys_addr / PAGE_SIZE, 0);
+        spin_unlock(&buddy_lock);
+    }
 
-    bitset_clear_bit(&page_bitset, phys_addr / PAGE_SIZE);
     if (process && process->resident_memory >= PAGE_SIZE) {
         process->resident_memory -= PAGE_SIZE;
     }
-
-    g_phys_page_stats.phys_memory_allocated -= PAGE_SIZE;
-    spin_unlock(&bitmap_lock);
+    __atomic_fetch_sub(&g_phys_page_stats.phys_memory_allocated, PAGE_SIZE, __ATOMIC_RELAXED);
 }
 
 static void process_memory_map_region(uint64_t start, uint64_t length, uint32_t type) {
@@ -149,6 +418,7 @@ void init_page_frame_allocator() {
     // Everything starts off allocated (reserved). Only usable segments (according to the bootloader) are made available.
     memset(page_bitset_storage, 0xFF, sizeof(page_bitset_storage));
     init_bitset(&page_bitset, page_bitset_storage, sizeof(page_bitset_storage), sizeof(page_bitset_storage) * CHAR_BIT);
+    init_free_areas();
 
     struct boot_info *boot_info = boot_get_boot_info();
     switch (boot_info->boot_info_type) {
@@ -6,6 +6,23 @@
 #include <kernel/mem/phys_page.h>
 #include <kernel/proc/task.h>
 
+struct phys_page *try_allocate_phys_page(void) {
+    uintptr_t phys_addr = try_get_next_phys_page(get_current_task()->process);
+    if (!phys_addr) {
+        return NULL;
+    }
+
+    struct phys_page *page = malloc(sizeof(struct phys_page));
+    if (!page) {
+        free_phys_page(phys_addr, get_current_task()->process);
+        return NULL;
+    }
+    page->ref_count = 1;
+    page->phys_addr = phys_addr;
+
+    return page;
+}
+
 struct phys_page *allocate_phys_page(void) {
     uintptr_t phys_addr = get_next_phys_page(get_current_task()->process);
     assert(phys_addr);
@@ -1,4 +1,5 @@
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -207,11 +208,95 @@ bool vm_is_kernel_address(uintptr_t addr) {
     return addr >= find_first_kernel_vm_region()->start;
 }
 
+// Links in the region tree and list are only changed with the process memory lock held, which also keeps interrupts
+// disabled, so a page fault on this processor never waits for a change which cannot finish. The sequence count is
+// bumped by every change.
+static void begin_process_vm_change(struct process *process) {
+    spin_lock(&process->process_memory_lock);
+}
+
+static void end_process_vm_change(struct process *process) {
+    atomic_fetch_add(&process->process_memory_seq, 1);
+    spin_unlock(&process->process_memory_lock);
+}
+
+void add_process_vm_region(struct process *process, struct vm_region *region) {
+    // Regions never overlap, so ordering them by start orders them by end as well. An empty region goes before a region
+    // which starts where it does, just like add_vm_region() places it.
+    struct rb_node **link = &process->process_memory_tree.root;
+    struct rb_node *parent = NULL;
+    while (*link) {
+        parent = *link;
+        if (region->end <= rb_entry(parent, struct vm_region, tree_node)->start) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+        }
+    }
+
+    begin_process_vm_change(process);
+    rb_link_node(&region->tree_node, parent, link);
+    rb_insert_color(&process->process_memory_tree, &region->tree_node);
+
+    struct vm_region *prev = rb_entry_or_null(rb_prev(&region->tree_node), struct vm_region, tree_node);
+    struct vm_region **list_link = prev ? &prev->next : &process->process_memory;
+    region->next = *list_link;
+    *list_link = region;
+    end_process_vm_change(process);
+}
+
+void remove_process_vm_region(struct process *process, struct vm_region *region) {
+    begin_process_vm_change(process);
+    struct vm_region *prev = rb_entry_or_null(rb_prev(&region->tree_node), struct vm_region, tree_node);
+    if (prev) {
+        prev->next = region->next;
+    } else {
+        process->process_memory = region->next;
+    }
+    rb_erase(&process->process_memory_tree, &region->tree_node);
+    end_process_vm_change(process);
+}
+
+static struct vm_region *find_vm_region_containing(struct process *process, uintptr_t addr) {
+    struct rb_node *node = process->process_memory_tree.root;
+    while (node) {
+        struct vm_region *region = rb_entry(node, struct vm_region, tree_node);
+        if (addr < region->start) {
+            node = node->left;
+        } else if (addr >= region->end) {
+            node = node->right;
+        } else {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+static struct vm_region *find_first_vm_region_ending_after(struct process *process, uintptr_t addr) {
+    struct vm_region *result = NULL;
+    struct rb_node *node = process->process_memory_tree.root;
+    while (node) {
+        struct vm_region *region = rb_entry(node, struct vm_region, tree_node);
+        if (region->end > addr) {
+            result = region;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return result;
+}
+
 static int do_unmap_range(uintptr_t addr, size_t length) {
     struct process *process = get_current_task()->process;
     int thread_count = process->ref_count;
     bool broadcast_tlb_flush = thread_count > 1;
 
+    // Whatever gets unmapped leaves a hole which the placement of new mappings should consider again.
+    if (find_user_vm_region_in_range(addr, addr + length) && addr < process->free_area_cache) {
+        process->free_area_cache = addr;
+    }
+
     struct vm_region *r;
     while ((r = find_user_vm_region_in_range(addr, addr + length))) {
         if (r->start < addr && r->end > addr + length) {
@@ -233,7 +318,7 @@ static int do_unmap_range(uintptr_t addr, size_t length) {
             bump_vm_object(to_add->vm_object);
 
             r->end = addr;
-            process->process_memory = add_vm_region(process->process_memory, to_add);
+            add_process_vm_region(process, to_add);
             break;
         }
 
@@ -284,17 +369,7 @@ static int do_unmap_range(uintptr_t addr, size_t length) {
             do_unmap_page(i, !r->vm_object, true, broadcast_tlb_flush, process);
         }
 
-        if (r == process->process_memory) {
-            process->process_memory = r->next;
-        } else {
-            struct vm_region *prev = process->process_memory;
-            while (prev->next != r) {
-                prev = prev->next;
-            }
-
-            prev->next = r->next;
-        }
-
+        remove_process_vm_region(process, r);
         free(r);
 
         if (region_important_to_profiler && atomic_load(&process->should_profile)) {
@@ -324,9 +399,41 @@ int unmap_range(uintptr_t addr, size_t length) {
     return ret;
 }
 
+// Finds where to place a mapping of len bytes, above the heap and a few pages past the region before it. The search
+// starts at the free area cache, which is past the guard pages after the last mapping placed, unless the mapping could
+// fit in one of the holes skipped below it.
+static uintptr_t find_free_area(struct process *process, size_t len) {
+    struct vm_region *heap = get_vm_region(process->process_memory, VM_PROCESS_HEAP);
+    uintptr_t base = heap ? heap->end + 0x10000000 : 0x10000000;
+
+    uintptr_t to_search = base;
+    if (process->free_area_cache > base && len > process->free_area_cache_hole_size) {
+        to_search = process->free_area_cache;
+    } else {
+        process->free_area_cache_hole_size = 0;
+    }
+
+    struct vm_region *r = find_first_vm_region_ending_after(process, to_search);
+    while (r && r->start < to_search + len) {
+        if (r->end > to_search) {
+            process->free_area_cache_hole_size = MAX(process->free_area_cache_hole_size, r->start > to_search ? r->start - to_search : 0);
+            to_search = r->end + 5 * PAGE_SIZE;
+        }
+        r = r->next;
+    }
+
+    // Leave the same unmapped gap after this mapping as the search leaves after every other region.
+    process->free_area_cache = to_search + len + 5 * PAGE_SIZE;
+    return to_search;
+}
+
 struct vm_region *map_region(void *addr, size_t len, int prot, int flags, uint64_t type) {
     len = ((len + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
 
+    // The search for free space must be done with the lock held, or two tasks could be given the same space.
+    struct process *process = get_current_task()->process;
+    mutex_lock(&process->lock);
+
     if (addr != NULL && !(flags & MAP_FIXED)) {
         // Do not overwrite an already existing region
         if (find_user_vm_region_in_range((uintptr_t) addr, (uintptr_t) addr + len)) {
@@ -343,13 +450,7 @@ struct vm_region *map_region(void *addr, size_t len, int prot, int flags, uint64
             }
             addr = (void *) (to_search - len);
         } else {
-            struct vm_region *heap = find_vm_region(VM_PROCESS_HEAP);
-            uintptr_t to_search = heap ? heap->end + 0x10000000 : 0x10000000;
-            struct vm_region *r;
-            while ((r = find_user_vm_region_in_range(to_search, to_search + len))) {
-                to_search = r->end + 5 * PAGE_SIZE;
-            }
-            addr = (void *) to_search;
+            addr = (void *) find_free_area(process, len);
         }
     }
 
@@ -360,10 +461,8 @@ struct vm_region *map_region(void *addr, size_t len, int prot, int flags, uint64
     to_add->flags =
         (prot & PROT_WRITE ? VM_WRITE : 0) | (prot & PROT_EXEC ? 0 : VM_NO_EXEC) | (type == VM_TASK_STACK ? VM_STACK : 0) | VM_USER;
 
-    struct process *process = get_current_task()->process;
-    mutex_lock(&process->lock);
     do_unmap_range((uintptr_t) addr, len);
-    process->process_memory = add_vm_region(process->process_memory, to_add);
+    add_process_vm_region(process, to_add);
     mutex_unlock(&process->lock);
 
 #ifdef MMAP_DEBUG
@@ -407,7 +506,7 @@ int map_range_protections(uintptr_t addr, size_t length, int prot) {
             to_add->vm_object_offset = r->vm_object_offset;
             to_add->vm_object = r->vm_object;
             bump_vm_object(to_add->vm_object);
-            process->process_memory = add_vm_region(process->process_memory, to_add);
+            add_process_vm_region(process, to_add);
 
             for (uintptr_t i = addr; i < addr + length; i += PAGE_SIZE) {
                 map_page_flags(i, to_add->flags);
@@ -425,7 +524,7 @@ int map_range_protections(uintptr_t addr, size_t length, int prot) {
             r->vm_object_offset += r->start - to_add->start;
             r->end = addr;
 
-            process->process_memory = add_vm_region(process->process_memory, to_add_last);
+            add_process_vm_region(process, to_add_last);
             break;
         }
 
@@ -454,7 +553,7 @@ int map_range_protections(uintptr_t addr, size_t length, int prot) {
             length -= (end_save - addr);
             addr = end_save;
 
-            process->process_memory = add_vm_region(process->process_memory, to_add);
+            add_process_vm_region(process, to_add);
             continue;
         }
 
@@ -484,7 +583,7 @@ int map_range_protections(uintptr_t addr, size_t length, int prot) {
 
             r->vm_object_offset += r->start - to_add->start;
 
-            process->process_memory = add_vm_region(process->process_memory, to_add);
+            add_process_vm_region(process, to_add);
             // We are definately at the end
             break;
         }
@@ -565,16 +664,29 @@ struct vm_region *find_vm_region(uint64_t type) {
 }
 
 struct vm_region *find_user_vm_region_by_addr(uintptr_t addr) {
-    struct vm_region *region = get_current_task()->process->process_memory;
-
-    while (region) {
-        if (region->start <= addr && addr < region->end) {
-            return region;
-        }
-        region = region->next;
+    struct task *task = get_current_task();
+    struct process *process = task->process;
+
+    // The cached region is still linked into the tree as long as the sequence count is unchanged. Regions are only freed
+    // after being unlinked, which bumps the count, so the count is checked again after reading the region's bounds.
+    unsigned int seq = atomic_load(&process->process_memory_seq);
+    struct vm_region *region = task->vm_lookup_cache;
+    if (region && task->vm_lookup_cache_seq == seq && region->start <= addr && addr < region->end &&
+        atomic_load(&process->process_memory_seq) == seq) {
+        return region;
     }
 
-    return NULL;
+    // Page faults can't take the process lock, since the faulting task may already hold it, so the tree is walked with
+    // the process memory lock held instead, which keeps other processors from rotating or unlinking nodes meanwhile.
+    // The returned region stays valid only as long as no other task of the process unmaps it, as with the process lock.
+    spin_lock(&process->process_memory_lock);
+    seq = atomic_load(&process->process_memory_seq);
+    region = find_vm_region_containing(process, addr);
+    spin_unlock(&process->process_memory_lock);
+
+    task->vm_lookup_cache = region;
+    task->vm_lookup_cache_seq = seq;
+    return region;
 }
 
 struct vm_region *find_kernel_vm_region_by_addr(uintptr_t addr) {
@@ -605,26 +717,17 @@ struct vm_region *find_user_vm_region_in_range(uintptr_t start, uintptr_t end) {
         return NULL;
     }
 
-    struct vm_region *region = get_current_task()->process->process_memory;
-
-    while (region) {
-        if (((start <= region->start) && (region->end <= end)) ||  // start-end contain the region
-            ((start >= region->start) && (start < region->end)) || // region contains start
-            ((end > region->start) && (end <= region->end))        // region contains end
-        ) {
-            return region;
-        }
-        region = region->next;
+    // Returns the lowest region in the range, which callers rely on to walk through the range in order.
+    struct vm_region *region = find_first_vm_region_ending_after(get_current_task()->process, start);
+    if (region && region->start < end) {
+        return region;
     }
-
     return NULL;
 }
 
-struct vm_region *clone_process_vm() {
+void clone_process_vm(struct process *child_process) {
     struct process *process_to_clone = get_current_task()->process;
-    struct vm_region *list = process_to_clone->process_memory;
-    struct vm_region *new_list = NULL;
-    struct vm_region *region = list;
+    struct vm_region *region = process_to_clone->process_memory;
 
     // Note that process should be locked by the caller. (recursive mutexes would be nice).
     while (region != NULL) {
@@ -642,11 +745,12 @@ struct vm_region *clone_process_vm() {
             }
         }
 
-        new_list = add_vm_region(new_list, to_add);
+        add_process_vm_region(child_process, to_add);
         region = region->next;
     }
 
-    return new_list;
+    child_process->free_area_cache = process_to_clone->free_area_cache;
+    child_process->free_area_cache_hole_size = process_to_clone->free_area_cache_hole_size;
 }
 
 void dump_process_regions(struct process *process) {
@@ -79,6 +79,11 @@ int vm_handle_fault_in_region(struct vm_region *region, uintptr_t address) {
 
     bool is_cow = false;
     uintptr_t phys_address_to_map = object->ops->handle_fault(object, offset_in_object, &is_cow);
+    if (!phys_address_to_map) {
+        debug_log("vm_object failed to provide page: [ %p ]\n", (void *) address);
+        return 1;
+    }
+
     if (is_cow) {
         map_phys_page(phys_address_to_map, address, (region->flags & ~VM_WRITE) | VM_COW, process);
     } else {
@@ -91,7 +91,8 @@ struct packet *net_create_arp_packet(struct network_interface *interface, uint16
     struct packet *packet = net_create_packet(interface, NULL, NULL, arp_length);
     packet->header_count = interface->link_layer_overhead + 1;
 
-    struct packet_header *header = net_init_packet_header(packet, interface->link_layer_overhead, PH_ARP, packet->inline_data, arp_length);
+    struct packet_header *header =
+        net_init_packet_header(packet, interface->link_layer_overhead, PH_ARP, net_packet_inline_data(packet), arp_length);
     net_init_arp_packet(header->raw_header, op, s_addr, s_ip, t_addr, t_ip);
     return packet;
 }
@@ -30,7 +30,7 @@ void net_icmp_recieve(struct packet *net_packet) {
         net_for_each_socket(socket) {
             if (socket->protocol == IPPROTO_ICMP) {
                 size_t data_len = icmp_header->length;
-                struct socket_data *data = net_inet_create_socket_data(ip_packet, 0, packet, data_len);
+                struct socket_data *data = net_inet_create_socket_data(net_packet, ip_packet, 0, packet, data_len);
                 net_send_to_socket(socket, data);
             }
         }
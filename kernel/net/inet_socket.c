@@ -10,6 +10,7 @@
 #include <kernel/net/inet_socket.h>
 #include <kernel/net/interface.h>
 #include <kernel/net/ip.h>
+#include <kernel/net/packet.h>
 #include <kernel/net/port.h>
 #include <kernel/net/socket.h>
 #include <kernel/net/socket_syscalls.h>
@@ -20,13 +21,15 @@
 #include <kernel/sched/task_sched.h>
 #include <kernel/util/hash_map.h>
 
-struct socket_data *net_inet_create_socket_data(const struct ip_v4_packet *packet, uint16_t port_network_ordered, const void *buf,
-                                                size_t len) {
-    struct socket_data *data = calloc(1, sizeof(struct socket_data) + len);
+// The message refers to the data in the recieved packet, instead of copying it.
+struct socket_data *net_inet_create_socket_data(struct packet *net_packet, const struct ip_v4_packet *packet, uint16_t port_network_ordered,
+                                                const void *buf, size_t len) {
+    struct socket_data *data = calloc(1, sizeof(struct socket_data));
     assert(data);
 
+    data->packet = net_packet_reference_data(net_packet, buf, len);
+    data->payload = data->packet->payload;
     data->len = len;
-    memcpy(data->data, buf, len);
     data->from.addrlen = sizeof(struct sockaddr_in);
     data->from.addr.in.sin_family = AF_INET;
     data->from.addr.in.sin_port = port_network_ordered;
@@ -16,6 +16,7 @@
 #include <kernel/net/packet.h>
 #include <kernel/net/socket.h>
 #include <kernel/net/umessage.h>
+#include <kernel/time/clock.h>
 #include <kernel/util/init.h>
 #include <kernel/util/validators.h>
 
@@ -30,6 +31,26 @@ void net_recieve_packet(struct network_interface *interface, struct packet *pack
     net_on_incoming_packet(packet);
 }
 
+// Updates the packet rates if at least a second has passed since they were last sampled, so that reading them
+// periodically gives the current rates.
+void net_interface_sample_rates(struct network_interface *interface) {
+    struct network_interface_stats *stats = &interface->stats;
+    struct timespec now = time_read_clock(CLOCK_MONOTONIC);
+    struct timespec elapsed = time_sub(now, stats->rate_sample_time);
+    time_t elapsed_ms = elapsed.tv_sec * 1000 + elapsed.tv_nsec / 1000000;
+    if (elapsed_ms < 1000) {
+        return;
+    }
+
+    uint64_t rx_packets = stats->rx_packets;
+    uint64_t tx_packets = stats->tx_packets;
+    stats->rx_packets_per_second = (rx_packets - stats->rate_sample_rx_packets) * 1000 / elapsed_ms;
+    stats->tx_packets_per_second = (tx_packets - stats->rate_sample_tx_packets) * 1000 / elapsed_ms;
+    stats->rate_sample_rx_packets = rx_packets;
+    stats->rate_sample_tx_packets = tx_packets;
+    stats->rate_sample_time = now;
+}
+
 struct list_node *net_get_interface_list(void) {
     return &interface_list;
 }
@@ -95,6 +116,7 @@ struct network_interface *net_create_network_interface(const char *name, int typ
     assert(ops);
     interface->ops = ops;
     interface->private_data = data;
+    interface->stats.rate_sample_time = time_read_clock(CLOCK_MONOTONIC);
 
     add_interface(interface);
 
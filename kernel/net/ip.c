@@ -334,11 +334,13 @@ int net_interface_send_ip_v4(struct network_interface *self, struct link_layer_a
 
     struct destination_cache_entry *destination = packet->destination;
     struct packet_header *outer_header = net_packet_outer_header(packet);
+    uint8_t protocol = net_packet_header_to_ip_v4_type(outer_header->type);
+    uint16_t length = packet->total_length;
 
-    struct ip_v4_packet ip_packet;
-    net_init_ip_v4_packet(&ip_packet, destination->next_packet_id++, net_packet_header_to_ip_v4_type(outer_header->type), self->address,
-                          destination->destination_path.dest_ip_address, NULL, packet->total_length);
-    net_init_packet_header(packet, net_packet_header_index(packet, outer_header) - 1, PH_IP_V4, &ip_packet, sizeof(struct ip_v4_packet));
+    // The IP header is written into the packet's headroom, right in front of the data it carries.
+    struct packet_header *ip_header = net_packet_push_header(packet, PH_IP_V4, sizeof(struct ip_v4_packet));
+    net_init_ip_v4_packet(ip_header->raw_header, destination->next_packet_id++, protocol, self->address,
+                          destination->destination_path.dest_ip_address, NULL, length);
 
     return self->ops->send(self, ll_dest, packet);
 }
@@ -361,8 +363,10 @@ int net_send_ip_v4(struct socket *socket, struct network_interface *interface, u
     net_drop_destination_cache_entry(destination);
 
     struct packet_header *raw_data = net_init_packet_header(packet, interface->link_layer_overhead + 1,
-                                                            net_inet_protocol_to_packet_header_type(protocol), packet->inline_data, len);
+                                                            net_inet_protocol_to_packet_header_type(protocol),
+                                                            net_packet_inline_data(packet), len);
     memcpy(raw_data->raw_header, buf, len);
+    net_packet_count_copy(len);
 
     return interface->ops->route_ip_v4(interface, packet);
 }
@@ -1,5 +1,4 @@
-#include <stdlib.h>
-
+#include <kernel/boot/boot_info.h>
 #include <kernel/hal/output.h>
 #include <kernel/net/destination_cache.h>
 #include <kernel/net/interface.h>
@@ -7,27 +6,47 @@
 #include <kernel/net/loopback.h>
 #include <kernel/net/packet.h>
 #include <kernel/util/init.h>
+#include <kernel/util/random.h>
 
 static int loop_route_ip_v4(struct network_interface *interface, struct packet *packet) {
     struct packet_header *outer_header = net_packet_outer_header(packet);
     struct destination_cache_entry *destination = packet->destination;
+    uint8_t protocol = net_packet_header_to_ip_v4_type(outer_header->type);
+    uint16_t length = packet->total_length;
 
-    struct ip_v4_packet *ip_packet = malloc(sizeof(struct ip_v4_packet));
-    net_init_ip_v4_packet(ip_packet, destination ? destination->next_packet_id++ : 0, net_packet_header_to_ip_v4_type(outer_header->type),
-                          packet->interface->address, destination ? destination->destination_path.dest_ip_address : IP_V4_BROADCAST, NULL,
-                          packet->total_length);
-
-    struct packet_header *ip_header =
-        net_init_packet_header(packet, net_packet_header_index(packet, outer_header) - 1, PH_IP_V4, ip_packet, sizeof(struct ip_v4_packet));
-    ip_header->flags |= PHF_DYNAMICALLY_ALLOCATED;
+    struct packet_header *ip_header = net_packet_push_header(packet, PH_IP_V4, sizeof(struct ip_v4_packet));
+    net_init_ip_v4_packet(ip_header->raw_header, destination ? destination->next_packet_id++ : 0, protocol, packet->interface->address,
+                          destination ? destination->destination_path.dest_ip_address : IP_V4_BROADCAST, NULL, length);
 
+    interface->stats.tx_packets++;
+    interface->stats.tx_bytes += packet->total_length;
+    interface->stats.rx_packets++;
+    interface->stats.rx_bytes += packet->total_length;
+    interface->stats.rx_batches++;
     net_recieve_packet(interface, packet);
     return 0;
 }
 
+// The lossy interface is a loopback interface which drops some of the packets sent over it, so that loss recovery can
+// be tested without a real network. Sockets use it with SO_BINDTODEVICE. It is only created when the kernel is booted with
+// lossy_loopback=1, which the test runner passes.
+static int lossy_route_ip_v4(struct network_interface *interface, struct packet *packet) {
+    if (get_random_bytes() % 1000 < LOOPBACK_LOSSY_DROP_PER_MILLE) {
+        interface->stats.tx_packets++;
+        interface->stats.tx_bytes += packet->total_length;
+        net_free_packet(packet);
+        return 0;
+    }
+    return loop_route_ip_v4(interface, packet);
+}
+
 static struct network_interface_ops ops = { .route_ip_v4 = loop_route_ip_v4 };
+static struct network_interface_ops lossy_ops = { .route_ip_v4 = lossy_route_ip_v4 };
 
 static void init_loopback() {
     net_create_network_interface("lo", NETWORK_INTERFACE_LOOPBACK, LINK_LAYER_ADDRESS_NONE, &ops, NULL);
+    if (boot_get_boot_info()->lossy_loopback) {
+        net_create_network_interface("lossy", NETWORK_INTERFACE_LOOPBACK, LINK_LAYER_ADDRESS_NONE, &lossy_ops, NULL);
+    }
 }
 INIT_FUNCTION(init_loopback, net);
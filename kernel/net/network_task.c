@@ -27,15 +27,14 @@ static spinlock_t lock = SPINLOCK_INITIALIZER;
 
 static struct wait_queue net_wait_queue = WAIT_QUEUE_INITIALIZER(net_wait_queue);
 
-static struct packet *consume() {
+// Takes every queued packet at once, so that the lock is only taken once per batch.
+static void consume(struct list_node *packets) {
     spin_lock(&lock);
 
     wait_for_with_spinlock(get_current_task(), !list_is_empty(&recv_list), &net_wait_queue, &lock);
 
-    struct packet *packet = list_first_entry(&recv_list, struct packet, queue);
-    list_remove(&packet->queue);
+    list_splice_tail(packets, &recv_list);
     spin_unlock(&lock);
-    return packet;
 }
 
 static void enqueue_packet(struct packet *packet) {
@@ -48,10 +47,9 @@ static void enqueue_packet(struct packet *packet) {
     spin_unlock(&lock);
 }
 
-void net_on_incoming_ethernet_frame(const struct ethernet_frame *frame, struct network_interface *interface, size_t len) {
-    struct packet *packet = net_create_packet(interface, NULL, NULL, 0);
-    assert(packet);
-
+// Sets up a packet whose inline data a device has recieved an ethernet frame into.
+void net_init_incoming_ethernet_packet(struct packet *packet, struct network_interface *interface, size_t len) {
+    packet->interface = interface;
     packet->header_count = 1;
     packet->total_length = len;
 
@@ -59,14 +57,31 @@ void net_on_incoming_ethernet_frame(const struct ethernet_frame *frame, struct n
     ethernet_header->flags |= PHF_INITIALIZED;
     ethernet_header->length = len;
     ethernet_header->type = PH_ETHERNET;
+    ethernet_header->raw_header = net_packet_inline_data(packet);
+}
 
-    // For now just store a dangling pointer to the ethernet frame. Ethernet drivers
-    // have their own persistent buffers for incoming packets. This is far from ideal
-    // since the frame's lifetime is not communicated in any way (the space should be
-    // marked unusable to prevent the device from overwriting its data).
-    ethernet_header->raw_header = (void *) frame;
+struct packet *net_create_incoming_ethernet_packet(const struct ethernet_frame *frame, struct network_interface *interface, size_t len) {
+    struct packet *packet = net_create_packet(interface, NULL, NULL, len);
+    assert(packet);
 
-    enqueue_packet(packet);
+    // The frame is copied out of the driver's buffer, so that the buffer can be given back to the device right away.
+    memcpy(net_packet_inline_data(packet), frame, len);
+    net_packet_count_copy(len);
+    net_init_incoming_ethernet_packet(packet, interface, len);
+    return packet;
+}
+
+void net_on_incoming_ethernet_frame(const struct ethernet_frame *frame, struct network_interface *interface, size_t len) {
+    enqueue_packet(net_create_incoming_ethernet_packet(frame, interface, len));
+}
+
+void net_on_incoming_packets(struct list_node *packets) {
+    spin_lock(&lock);
+
+    list_splice_tail(&recv_list, packets);
+
+    wake_up_all(&net_wait_queue);
+    spin_unlock(&lock);
 }
 
 void net_on_incoming_packet(struct packet *packet) {
@@ -81,35 +96,38 @@ void net_on_incoming_packet(struct packet *packet) {
 }
 
 void net_network_task_start() {
+    struct list_node packets = INIT_LIST(packets);
     for (;;) {
-        struct packet *packet = consume();
-        assert(packet);
-
-        struct packet_header *header = net_packet_inner_header(packet);
-        switch (header->type) {
-            case PH_ETHERNET:
-                net_ethernet_recieve(packet);
-                break;
-            case PH_IP_V4:
-                net_ip_v4_recieve(packet);
-                break;
-            case PH_ARP:
-                net_arp_recieve(packet);
-                break;
-            case PH_ICMP:
-                net_icmp_recieve(packet);
-                break;
-            case PH_UDP:
-                net_udp_recieve(packet);
-                break;
-            case PH_TCP:
-                net_tcp_recieve(packet);
-                break;
-            default:
-                debug_log("Bad packet header type: [ %s ]\n", net_packet_header_type_to_string(header->type));
-                break;
+        consume(&packets);
+        list_for_each_entry_safe(&packets, packet, struct packet, queue) {
+            list_remove(&packet->queue);
+
+            struct packet_header *header = net_packet_inner_header(packet);
+            switch (header->type) {
+                case PH_ETHERNET:
+                    net_ethernet_recieve(packet);
+                    break;
+                case PH_IP_V4:
+                    net_ip_v4_recieve(packet);
+                    break;
+                case PH_ARP:
+                    net_arp_recieve(packet);
+                    break;
+                case PH_ICMP:
+                    net_icmp_recieve(packet);
+                    break;
+                case PH_UDP:
+                    net_udp_recieve(packet);
+                    break;
+                case PH_TCP:
+                    net_tcp_recieve(packet);
+                    break;
+                default:
+                    debug_log("Bad packet header type: [ %s ]\n", net_packet_header_type_to_string(header->type));
+                    break;
+            }
+            net_free_packet(packet);
         }
-        net_free_packet(packet);
     }
 }
 
@@ -1,9 +1,24 @@
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 
+#include <kernel/hal/output.h>
+#include <kernel/mem/page.h>
+#include <kernel/mem/vm_allocator.h>
+#include <kernel/mem/vm_region.h>
 #include <kernel/net/destination_cache.h>
 #include <kernel/net/packet.h>
 #include <kernel/net/socket.h>
+#include <kernel/util/init.h>
+#include <kernel/util/spinlock.h>
+
+#define NET_PACKET_POOL_BUFFER_SIZE ALIGN_UP(sizeof(struct packet) + NET_PACKET_HEADROOM + NET_PACKET_POOL_DATA_SIZE, 64)
+#define NET_PACKET_POOL_CHUNK_SIZE  (16 * PAGE_SIZE)
+
+struct net_packet_stats g_net_packet_stats;
+
+static struct list_node pool_free_list = INIT_LIST(pool_free_list);
+static spinlock_t pool_lock = SPINLOCK_INITIALIZER;
 
 void net_packet_write_headers(void *buffer, struct packet *packet, uint32_t start_header) {
     size_t offset = 0;
@@ -11,16 +26,13 @@ void net_packet_write_headers(void *buffer, struct packet *packet, uint32_t star
         struct packet_header *header = &packet->headers[i];
         if (i >= start_header) {
             memcpy(buffer + offset, header->raw_header, header->length);
+            net_packet_count_copy(header->length);
         }
         offset += header->length;
     }
 }
 
-void net_free_packet(struct packet *packet) {
-    if (packet->flags & PKT_DONT_FREE) {
-        return;
-    }
-
+void net_packet_drop_references(struct packet *packet) {
     if (packet->socket) {
         net_drop_socket(packet->socket);
         packet->socket = NULL;
@@ -30,6 +42,23 @@ void net_free_packet(struct packet *packet) {
         net_drop_destination_cache_entry(packet->destination);
         packet->destination = NULL;
     }
+}
+
+struct packet *net_bump_packet(struct packet *packet) {
+    atomic_fetch_add(&packet->ref_count, 1);
+    return packet;
+}
+
+void net_free_packet(struct packet *packet) {
+    if (packet->flags & PKT_DONT_FREE) {
+        return;
+    }
+
+    if (atomic_fetch_sub(&packet->ref_count, 1) != 1) {
+        return;
+    }
+
+    net_packet_drop_references(packet);
 
     for (uint32_t i = 0; i < packet->header_count; i++) {
         if (packet->headers[i].flags & PHF_DYNAMICALLY_ALLOCATED) {
@@ -37,20 +66,118 @@ void net_free_packet(struct packet *packet) {
         }
     }
 
+    if (packet->flags & PKT_FROM_POOL) {
+        spin_lock(&pool_lock);
+        list_prepend(&pool_free_list, &packet->queue);
+        g_net_packet_stats.pool_free++;
+        spin_unlock(&pool_lock);
+        return;
+    }
+
     free(packet);
 }
 
-struct packet *net_create_packet(struct network_interface *interface, struct socket *socket, struct destination_cache_entry *destination,
-                                 size_t inline_data_size) {
-    struct packet *packet = malloc(sizeof(struct packet) + inline_data_size);
+static struct packet *allocate_from_pool(void) {
+    spin_lock(&pool_lock);
+    struct packet *packet = list_first_entry(&pool_free_list, struct packet, queue);
+    if (packet) {
+        list_remove(&packet->queue);
+        g_net_packet_stats.pool_free--;
+    }
+    spin_unlock(&pool_lock);
+    return packet;
+}
+
+static void init_packet(struct packet *packet, struct network_interface *interface, struct socket *socket,
+                        struct destination_cache_entry *destination) {
     packet->interface = interface;
     packet->socket = socket ? net_bump_socket(socket) : NULL;
     packet->destination = destination ? net_bump_destination_cache_entry(destination) : NULL;
     packet->header_count = packet->total_length = 0;
+    packet->ref_count = 1;
+    packet->payload = NULL;
+    packet->payload_length = 0;
     memset(packet->headers, 0, sizeof(packet->headers));
+    g_net_packet_stats.packets++;
+}
+
+struct packet *net_create_packet(struct network_interface *interface, struct socket *socket, struct destination_cache_entry *destination,
+                                 size_t inline_data_size) {
+    struct packet *packet = NULL;
+    if (inline_data_size <= NET_PACKET_POOL_DATA_SIZE) {
+        packet = allocate_from_pool();
+    }
+
+    if (packet) {
+        packet->flags = PKT_FROM_POOL;
+        packet->buffer_size = NET_PACKET_POOL_BUFFER_SIZE - sizeof(struct packet);
+        g_net_packet_stats.pool_allocations++;
+    } else {
+        packet = malloc(sizeof(struct packet) + NET_PACKET_HEADROOM + inline_data_size);
+        packet->flags = 0;
+        packet->buffer_size = NET_PACKET_HEADROOM + inline_data_size;
+        g_net_packet_stats.heap_allocations++;
+    }
+
+    init_packet(packet, interface, socket, destination);
     return packet;
 }
 
+// Returns a packet whose inline data is NET_PACKET_POOL_DATA_SIZE bytes a device can write to, or NULL if the pool is
+// empty.
+struct packet *net_create_pool_packet(struct network_interface *interface) {
+    struct packet *packet = allocate_from_pool();
+    if (!packet) {
+        return NULL;
+    }
+
+    packet->flags = PKT_FROM_POOL;
+    packet->buffer_size = NET_PACKET_POOL_BUFFER_SIZE - sizeof(struct packet);
+    g_net_packet_stats.pool_allocations++;
+    init_packet(packet, interface, NULL, NULL);
+    return packet;
+}
+
+// Returns a reference to a packet holding len bytes of data from the given packet, with its payload set to the data. A
+// socket keeps this reference until the data is read. The packet itself is referenced when it can outlive the caller,
+// and otherwise, or when the data is small, the data is copied into a packet of its own. Since the payload and queue
+// node of the packet belong to the holder, a packet delivered to several sockets is only referenced by the first, and
+// copied for the rest.
+struct packet *net_packet_reference_data(struct packet *packet, const void *data, size_t len) {
+    if (!(packet->flags & (PKT_DONT_FREE | PKT_DATA_REFERENCED)) && len >= NET_PACKET_COPY_BREAK) {
+        // The packet is only needed for its data from now on.
+        net_packet_drop_references(packet);
+        net_bump_packet(packet);
+        packet->flags |= PKT_DATA_REFERENCED;
+        packet->payload = data;
+        packet->payload_length = len;
+        return packet;
+    }
+
+    struct packet *copy = net_create_packet(packet->interface, NULL, NULL, len);
+    copy->flags |= PKT_DATA_REFERENCED;
+    memcpy(net_packet_inline_data(copy), data, len);
+    net_packet_count_copy(len);
+    copy->payload = net_packet_inline_data(copy);
+    copy->payload_length = len;
+    return copy;
+}
+
+// The pool is filled before devices are enumerated, so that drivers can set up their rings with pool packets. Each
+// chunk is physically contiguous, so a buffer's physical address can be handed to a device directly.
+static void init_packet_pool(void) {
+    size_t buffers_per_chunk = NET_PACKET_POOL_CHUNK_SIZE / NET_PACKET_POOL_BUFFER_SIZE;
+    for (size_t count = 0; count < NET_PACKET_POOL_BUFFERS; count += buffers_per_chunk) {
+        struct vm_region *chunk = vm_allocate_dma_region(NET_PACKET_POOL_CHUNK_SIZE);
+        for (size_t i = 0; i < buffers_per_chunk; i++) {
+            struct packet *packet = (struct packet *) (chunk->start + i * NET_PACKET_POOL_BUFFER_SIZE);
+            list_append(&pool_free_list, &packet->queue);
+            g_net_packet_stats.pool_free++;
+        }
+    }
+}
+INIT_FUNCTION(init_packet_pool, driver);
+
 const char *net_packet_header_type_to_string(enum packet_header_type type) {
     switch (type) {
         case PH_ETHERNET:
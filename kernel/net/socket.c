@@ -15,6 +15,7 @@
 #include <kernel/hal/output.h>
 #include <kernel/hal/processor.h>
 #include <kernel/net/inet_socket.h>
+#include <kernel/net/packet.h>
 #include <kernel/net/socket.h>
 #include <kernel/net/tcp.h>
 #include <kernel/net/tcp_socket.h>
@@ -65,7 +66,7 @@ static void net_destroy_socket(struct socket *socket) {
     struct socket_data *to_remove = socket->data_head;
     while (to_remove != NULL) {
         struct socket_data *next = to_remove->next;
-        free(to_remove);
+        net_free_socket_data(to_remove);
         to_remove = next;
     }
 
@@ -186,7 +187,7 @@ ssize_t net_generic_recieve_from(struct socket *socket, void *buf, size_t len, i
     }
 
     size_t to_copy = MIN(len, data->len);
-    memcpy(buf, data->data, to_copy);
+    memcpy(buf, data->payload, to_copy);
 
     if (addr && addrlen) {
         net_copy_sockaddr_to_user(&data->from.addr, data->from.addrlen, addr, addrlen);
@@ -196,7 +197,7 @@ ssize_t net_generic_recieve_from(struct socket *socket, void *buf, size_t len, i
     debug_log("Received message: [ %lu, %lu ]\n", socket->id, to_copy);
 #endif /* SOCKET_DEBUG */
 
-    free(data);
+    net_free_socket_data(data);
     return (ssize_t) to_copy;
 }
 
@@ -411,6 +412,13 @@ ssize_t net_send_to_socket(struct socket *to_send, struct socket_data *socket_da
     return ret;
 }
 
+void net_free_socket_data(struct socket_data *socket_data) {
+    if (socket_data->packet) {
+        net_free_packet(socket_data->packet);
+    }
+    free(socket_data);
+}
+
 void net_socket_set_error(struct socket *socket, int error) {
     socket->error = error;
     fs_trigger_state(&socket->file_state, POLLERR);
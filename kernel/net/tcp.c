@@ -13,6 +13,7 @@
 #include <kernel/net/network_task.h>
 #include <kernel/net/packet.h>
 #include <kernel/net/tcp.h>
+#include <kernel/net/tcp_congestion.h>
 #include <kernel/net/tcp_socket.h>
 #include <kernel/time/clock.h>
 #include <kernel/time/timer.h>
@@ -27,6 +28,81 @@ static struct timespec time_wait_timeout = { .tv_sec = 240, .tv_nsec = 0 };
 // Hardcoded to 300 ms, should probably be based on round trip time.
 static struct timespec ack_timeout = { .tv_sec = 0, .tv_nsec = 300 * 1000000 };
 
+uint32_t tcp_time_ms(void) {
+    struct timespec now = time_read_clock(CLOCK_MONOTONIC);
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Adds a block of out of order data to the SACK option. The block holding the most recently recieved segment goes first
+// (RFC 2018), and the rest follow in sequence order.
+static void tcp_add_sack_block(struct tcp_control_block *tcb, struct tcp_packet_options *opts, struct tcp_sack_block block,
+                               size_t max_blocks) {
+    bool most_recent = TCP_SEQ_LEQ(block.start, tcb->out_of_order_last_start) && TCP_SEQ_LT(tcb->out_of_order_last_start, block.end);
+    if (!most_recent) {
+        if (opts->sack_block_count < max_blocks) {
+            opts->sack_blocks[opts->sack_block_count++] = block;
+        }
+        return;
+    }
+
+    size_t blocks_to_keep = MIN(opts->sack_block_count, max_blocks - 1);
+    memmove(&opts->sack_blocks[1], &opts->sack_blocks[0], blocks_to_keep * sizeof(struct tcp_sack_block));
+    opts->sack_blocks[0] = block;
+    opts->sack_block_count = blocks_to_keep + 1;
+}
+
+static void tcp_fill_sack_blocks(struct tcp_control_block *tcb, struct tcp_packet_options *opts) {
+    size_t max_blocks = tcb->timestamps_enabled ? TCP_MAX_SACK_BLOCKS - 1 : TCP_MAX_SACK_BLOCKS;
+    struct tcp_sack_block block = { 0, 0 };
+    list_for_each_entry(&tcb->out_of_order_queue, segment, struct tcp_out_of_order_segment, queue) {
+        if (segment->sequence_start == segment->sequence_end) {
+            continue;
+        }
+
+        if (block.start != block.end && TCP_SEQ_LEQ(segment->sequence_start, block.end)) {
+            if (TCP_SEQ_GT(segment->sequence_end, block.end)) {
+                block.end = segment->sequence_end;
+            }
+            continue;
+        }
+
+        if (block.start != block.end) {
+            tcp_add_sack_block(tcb, opts, block, max_blocks);
+        }
+        block = (struct tcp_sack_block) { .start = segment->sequence_start, .end = segment->sequence_end };
+    }
+
+    if (block.start != block.end) {
+        tcp_add_sack_block(tcb, opts, block, max_blocks);
+    }
+}
+
+// Fills in the advertised window and the negotiated options for a segment sent on a connection.
+static void tcp_set_connection_options(struct tcp_control_block *tcb, struct tcp_packet_options *opts) {
+    bool syn = opts->tcp_flags.syn;
+
+    // The window in a SYN is never scaled.
+    opts->window = MIN(syn ? tcb->recv_window : tcb->recv_window >> tcb->recv_window_scale, UINT16_MAX);
+    opts->mss = tcb->recv_mss;
+    if (syn) {
+        opts->send_window_scale = tcb->window_scale_enabled;
+        opts->window_scale = tcb->recv_window_scale;
+        opts->send_sack_permitted = tcb->sack_enabled;
+    }
+
+    if (tcb->timestamps_enabled) {
+        opts->send_timestamp = true;
+        opts->timestamp_value = tcp_time_ms();
+        opts->timestamp_echo = tcb->timestamp_recent;
+    }
+
+    // SACK blocks are only sent on segments without data, so data segments never need more option space than the
+    // timestamp, which tcp_segment_size() already accounts for.
+    if (tcb->sack_enabled && !syn && opts->data_length == 0) {
+        tcp_fill_sack_blocks(tcb, opts);
+    }
+}
+
 int net_send_tcp_from_socket(struct socket *socket, uint32_t sequence_start, uint32_t sequence_end, bool send_rst, bool is_retransmission) {
     uint16_t source_port = PORT_FROM_SOCKADDR(&socket->host_address);
     struct ip_v4_address dest_ip = IP_V4_FROM_SOCKADDR(&socket->peer_address);
@@ -43,7 +119,7 @@ int net_send_tcp_from_socket(struct socket *socket, uint32_t sequence_start, uin
 
     // Only send a SYN if this is the first pending segment, only send a FIN if this is the last pending segment.
     bool send_syn = tcb->pending_syn && sequence_start == tcb->send_unacknowledged;
-    bool send_fin = tcb->pending_fin && sequence_end == tcb->send_next;
+    bool send_fin = tcb->pending_fin && sequence_end == tcp_sequence_end(tcb);
     size_t data_to_send = sequence_end - sequence_start - send_syn - send_fin;
 
     // The only segment that doesn't have ACK set is the initial SYN.
@@ -57,8 +133,6 @@ int net_send_tcp_from_socket(struct socket *socket, uint32_t sequence_start, uin
         .dest_port = dest_port,
         .sequence_number = sequence_start,
         .ack_number = tcb->recv_next,
-        .window = tcb->recv_window,
-        .mss = tcb->recv_mss,
         .tcp_flags = {
             .ack = send_ack,
             .psh = send_psh,
@@ -73,6 +147,7 @@ int net_send_tcp_from_socket(struct socket *socket, uint32_t sequence_start, uin
         .interface = tcb->interface,
         .destination = tcb->destination,
     };
+    tcp_set_connection_options(tcb, &opts);
 
     struct timespec *send_time_ptr = NULL;
 
@@ -87,18 +162,31 @@ int net_send_tcp_from_socket(struct socket *socket, uint32_t sequence_start, uin
     return net_send_tcp(dest_ip, &opts, send_time_ptr);
 }
 
+// The options are laid out so that multi-byte fields stay aligned, and the total is always a multiple of 4 bytes.
+static size_t tcp_options_length(const struct tcp_packet_options *opts) {
+    size_t length = 0;
+    if (opts->tcp_flags.syn) {
+        length += sizeof(struct tcp_option_mss);
+        length += opts->send_window_scale ? 1 + sizeof(struct tcp_option_window_scale) : 0;
+        length += opts->send_sack_permitted && !opts->send_timestamp ? 4 : 0;
+    }
+    length += opts->send_timestamp ? TCP_TIMESTAMP_OPTION_LENGTH : 0;
+    length += opts->sack_block_count ? 4 + opts->sack_block_count * sizeof(struct tcp_sack_block) : 0;
+    return length;
+}
+
 int net_send_tcp(struct ip_v4_address dest, struct tcp_packet_options *opts, struct timespec *send_time_ptr) {
     struct network_interface *interface = opts->interface;
     assert(interface);
 
     struct destination_cache_entry *destination = opts->destination ? opts->destination : net_lookup_destination(interface, dest);
-    size_t tcp_length = sizeof(struct tcp_packet) + opts->tcp_flags.syn * sizeof(struct tcp_option_mss) + opts->data_length;
+    size_t tcp_length = sizeof(struct tcp_packet) + tcp_options_length(opts) + opts->data_length;
 
     struct packet *packet = net_create_packet(interface, opts->socket, destination, tcp_length);
     packet->header_count = interface->link_layer_overhead + 2;
 
     struct packet_header *tcp_header =
-        net_init_packet_header(packet, interface->link_layer_overhead + 1, PH_TCP, packet->inline_data, tcp_length);
+        net_init_packet_header(packet, interface->link_layer_overhead + 1, PH_TCP, net_packet_inline_data(packet), tcp_length);
     struct tcp_packet *tcp_packet = tcp_header->raw_header;
     net_init_tcp_packet(tcp_packet, opts);
 
@@ -130,35 +218,64 @@ static const void *tcp_data_start(const struct tcp_packet *packet) {
     return (const void *) packet + sizeof(uint32_t) * packet->data_offset;
 }
 
-static uint16_t tcp_mss(const struct tcp_packet *packet) {
+static void tcp_parse_options(const struct tcp_packet *packet, struct tcp_parsed_options *options) {
+    memset(options, 0, sizeof(*options));
+    options->mss = TCP_DEFAULT_MSS;
+
     size_t offset = 0;
     size_t end = sizeof(uint32_t) * packet->data_offset - sizeof(struct tcp_packet);
-    const uint8_t *raw_options = (uint8_t *) (packet + 1);
+    const uint8_t *raw_options = packet->options_and_payload;
     while (offset < end) {
-        switch (raw_options[offset]) {
-            case TCP_OPTION_END:
+        if (raw_options[offset] == TCP_OPTION_END) {
+            break;
+        }
+        if (raw_options[offset] == TCP_OPTION_PAD) {
+            offset++;
+            continue;
+        }
+
+        const struct tcp_option *option = (const struct tcp_option *) (raw_options + offset);
+        if (offset + 1 >= end || option->length < 2 || offset + option->length > end) {
+            break;
+        }
+
+        switch (option->type) {
+            case TCP_OPTION_MSS:
+                if (option->length == sizeof(struct tcp_option_mss)) {
+                    options->mss = ntohs(((const struct tcp_option_mss *) option)->mss);
+                }
                 break;
-            case TCP_OPTION_PAD:
-                offset++;
-                continue;
-            case TCP_OPTION_MSS: {
-                const struct tcp_option_mss *mss_option = (const struct tcp_option_mss *) raw_options;
-                return ntohs(mss_option->mss);
-            }
-            default: {
-                const struct tcp_option *option = (const struct tcp_option *) raw_options;
-                debug_log("Unknown TCP option type: [ %u ]\n", option->type);
-                if (option->length < 2) {
-                    break;
+            case TCP_OPTION_WINDOW_SCALE:
+                if (option->length == sizeof(struct tcp_option_window_scale)) {
+                    options->has_window_scale = true;
+                    options->window_scale = MIN(((const struct tcp_option_window_scale *) option)->shift, TCP_MAX_WINDOW_SCALE);
                 }
-                offset += option->length;
-                continue;
-            }
+                break;
+            case TCP_OPTION_SACK_PERMITTED:
+                options->sack_permitted = option->length == 2;
+                break;
+            case TCP_OPTION_TIMESTAMP:
+                if (option->length == sizeof(struct tcp_option_timestamp)) {
+                    const struct tcp_option_timestamp *timestamp = (const struct tcp_option_timestamp *) option;
+                    options->has_timestamp = true;
+                    options->timestamp_value = ntohl(timestamp->value);
+                    options->timestamp_echo = ntohl(timestamp->echo);
+                }
+                break;
+            case TCP_OPTION_SACK:
+                options->sack_block_count = MIN((option->length - 2U) / sizeof(struct tcp_sack_block), TCP_MAX_SACK_BLOCKS);
+                for (size_t i = 0; i < options->sack_block_count; i++) {
+                    uint32_t edges[2];
+                    memcpy(edges, option->data + i * sizeof(edges), sizeof(edges));
+                    options->sack_blocks[i] = (struct tcp_sack_block) { .start = ntohl(edges[0]), .end = ntohl(edges[1]) };
+                }
+                break;
+            default:
+                debug_log("Unknown TCP option type: [ %u ]\n", option->type);
+                break;
         }
-        break;
+        offset += option->length;
     }
-
-    return TCP_DEFAULT_MSS;
 }
 
 static void tcp_send_reset(struct socket *socket, struct network_interface *interface, const struct ip_v4_packet *ip_packet,
@@ -218,7 +335,6 @@ static void tcp_send_empty_ack(struct socket *socket, const struct ip_v4_packet
         .dest_port = htons(packet->source_port),
         .sequence_number = tcb->send_next,
         .ack_number = tcb->recv_next,
-        .window = tcb->recv_window,
         .tcp_flags = {
             .ack = 1,
         },
@@ -229,6 +345,7 @@ static void tcp_send_empty_ack(struct socket *socket, const struct ip_v4_packet
         .interface = tcb->interface,
         .destination = tcb->destination,
     };
+    tcp_set_connection_options(tcb, &opts);
 
     net_send_tcp(ip_packet->source, &opts, NULL);
 }
@@ -250,7 +367,6 @@ static void tcp_on_ack_timeout(struct timer *timer, void *_socket) {
         .dest_port = dest_port,
         .sequence_number = tcb->send_next,
         .ack_number = tcb->recv_next,
-        .window = tcb->recv_window,
         .tcp_flags = {
             .ack = 1,
         },
@@ -261,6 +377,7 @@ static void tcp_on_ack_timeout(struct timer *timer, void *_socket) {
         .interface = tcb->interface,
         .destination = tcb->destination,
     };
+    tcp_set_connection_options(tcb, &opts);
 
     time_cancel_kernel_callback(timer);
     tcb->send_ack_timer = NULL;
@@ -291,12 +408,26 @@ static bool tcp_segment_acceptable(struct socket *socket, const struct ip_v4_pac
 
 static void tcp_update_send_window(struct socket *socket, const struct tcp_packet *packet) {
     struct tcp_control_block *tcb = socket->private_data;
-    tcb->send_window = htons(packet->window_size);
+
+    // The window in a SYN is never scaled.
+    tcb->send_window = (uint32_t) htons(packet->window_size) << (packet->flags.syn ? 0 : tcb->send_window_scale);
     tcb->send_window_max = MAX(tcb->send_window_max, tcb->send_window);
     tcb->send_wl1 = htonl(packet->sequence_number);
     tcb->send_wl2 = htonl(packet->ack_number);
 }
 
+// Updates the send window if the segment is newer than the one which last updated it. Returns whether the window changed.
+static bool tcp_maybe_update_send_window(struct socket *socket, const struct tcp_packet *packet) {
+    struct tcp_control_block *tcb = socket->private_data;
+    if (tcb->send_wl1 < htonl(packet->sequence_number) ||
+        (tcb->send_wl1 == htonl(packet->sequence_number) && tcb->send_wl2 <= htonl(packet->ack_number))) {
+        uint32_t old_window = tcb->send_window;
+        tcp_update_send_window(socket, packet);
+        return tcb->send_window != old_window;
+    }
+    return false;
+}
+
 static void tcp_enter_established_state(struct socket *socket, const struct tcp_packet *packet) {
     struct tcp_control_block *tcb = socket->private_data;
     tcb->state = TCP_ESTABLISHED;
@@ -305,13 +436,12 @@ static void tcp_enter_established_state(struct socket *socket, const struct tcp_
     }
     socket->state = CONNECTED;
     tcp_update_send_window(socket, packet);
+    tcp_congestion_init(tcb);
     tcp_send_segments(socket);
 }
 
-static void tcp_sample_round_trip_time(struct socket *socket) {
+static void tcp_sample_round_trip_time(struct socket *socket, time_t rtt) {
     struct tcp_control_block *tcb = socket->private_data;
-    struct timespec measured_rtt = time_sub(time_read_clock(CLOCK_MONOTONIC), tcb->time_first_sent);
-    time_t rtt = measured_rtt.tv_sec * 1000 + measured_rtt.tv_nsec / 1000000;
     if (tcb->first_rtt_sample) {
         tcb->smoothed_rtt = rtt;
         tcb->rtt_variation = rtt / 2;
@@ -322,17 +452,17 @@ static void tcp_sample_round_trip_time(struct socket *socket) {
     }
     time_t new_rto_ms = MAX(1000, tcb->smoothed_rtt + MAX(TCP_RTO_GRANULARITY, 4 * tcb->rtt_variation));
     tcb->rto.tv_sec = new_rto_ms / 1000;
-    tcb->rto.tv_nsec = new_rto_ms * 1000000;
-    tcb->time_first_sent_valid = false;
+    tcb->rto.tv_nsec = new_rto_ms % 1000 * 1000000;
 
 #ifdef TCP_DEBUG
     debug_log("Took RTT sample: [ %ld, %ld, %ld, %ld ]\n", rtt, tcb->smoothed_rtt, tcb->rtt_variation, new_rto_ms);
 #endif /* TCP_DEBUG */
 }
 
-static void tcp_advance_ack_number(struct socket *socket, uint32_t ack_number) {
+static void tcp_advance_ack_number(struct socket *socket, uint32_t ack_number, const struct tcp_parsed_options *options) {
     struct tcp_control_block *tcb = socket->private_data;
-    uint32_t amount_to_advance = ack_number - tcb->send_unacknowledged;
+    uint32_t bytes_acked = ack_number - tcb->send_unacknowledged;
+    uint32_t amount_to_advance = bytes_acked;
     if (!amount_to_advance) {
         return;
     }
@@ -355,12 +485,24 @@ static void tcp_advance_ack_number(struct socket *socket, uint32_t ack_number) {
     // Otherwise, the ACK should have been ingored as invalid.
     assert(amount_to_advance == 0);
 
-    if (tcb->time_first_sent_valid && ack_number > tcb->time_first_sent_sequence_number) {
-        tcp_sample_round_trip_time(socket);
+    if (tcb->timestamps_enabled && options->has_timestamp && options->timestamp_echo != 0) {
+        // With timestamps, every ACK measures the round trip time of the segment it acknowledges (RFC 7323).
+        tcp_sample_round_trip_time(socket, (uint32_t) (tcp_time_ms() - options->timestamp_echo));
+    } else if (tcb->time_first_sent_valid && TCP_SEQ_GT(ack_number, tcb->time_first_sent_sequence_number)) {
+        struct timespec measured_rtt = time_sub(time_read_clock(CLOCK_MONOTONIC), tcb->time_first_sent);
+        tcb->time_first_sent_valid = false;
+        tcp_sample_round_trip_time(socket, measured_rtt.tv_sec * 1000 + measured_rtt.tv_nsec / 1000000);
     }
 
     tcb->send_unacknowledged = ack_number;
 
+    // After a timeout moved send_next back, data sent before the timeout can still be acknowledged.
+    if (TCP_SEQ_LT(tcb->send_next, ack_number)) {
+        tcb->send_next = ack_number;
+    }
+    tcp_trim_sack_scoreboard(tcb);
+    tcp_on_new_ack(socket, bytes_acked);
+
     if (tcb->state >= TCP_ESTABLISHED) {
         tcp_send_segments(socket);
     }
@@ -376,9 +518,118 @@ static void tcp_advance_ack_number(struct socket *socket, uint32_t ack_number) {
     fs_trigger_state(&socket->file_state, POLLOUT);
 }
 
-static void tcp_process_segment(struct socket *socket, struct network_interface *interface, const struct ip_v4_packet *ip_packet,
-                                const struct tcp_packet *packet) {
+static void tcp_negotiate_options(struct tcp_control_block *tcb, const struct tcp_parsed_options *options) {
+    tcb->send_mss = options->mss;
+
+    // Options are only used when both SYNs carry them. A passive socket sends its SYN after this, and so only repeats
+    // the options the peer offered.
+    tcb->window_scale_enabled = tcb->window_scale_enabled && options->has_window_scale;
+    tcb->send_window_scale = tcb->window_scale_enabled ? options->window_scale : 0;
+    if (!tcb->window_scale_enabled) {
+        tcb->recv_window_scale = 0;
+        tcb->recv_window = MIN(tcb->recv_window, UINT16_MAX);
+    }
+    tcb->sack_enabled = tcb->sack_enabled && options->sack_permitted;
+    tcb->timestamps_enabled = tcb->timestamps_enabled && options->has_timestamp;
+    tcb->timestamp_recent = options->timestamp_value;
+}
+
+// Adds a packet holding recieved data to the socket's recieve queue. The data is only copied when it is read.
+static void tcp_queue_recieved_data(struct socket *socket, struct packet *held) {
     struct tcp_control_block *tcb = socket->private_data;
+    list_append(&tcb->recv_queue, &held->queue);
+    tcb->recv_queue_length += held->payload_length;
+    fs_trigger_state(&socket->file_state, POLLIN);
+}
+
+// Keeps a segment which arrived ahead of recv_next until the data in front of it arrives.
+static void tcp_queue_out_of_order_segment(struct socket *socket, struct packet *net_packet, const struct ip_v4_packet *ip_packet,
+                                           const struct tcp_packet *packet) {
+    struct tcp_control_block *tcb = socket->private_data;
+    uint32_t sequence_start = htonl(packet->sequence_number);
+    size_t data_length = tcp_segment_length(ip_packet, packet) - packet->flags.syn - packet->flags.fin;
+    bool fin = packet->flags.fin;
+
+    // Only the part inside the window is kept, so that it is sure to fit in the recieve buffer once the gap is filled.
+    uint32_t window_end = tcb->recv_next + tcb->recv_window;
+    if (TCP_SEQ_GT(sequence_start + data_length, window_end)) {
+        data_length = TCP_SEQ_GT(window_end, sequence_start) ? window_end - sequence_start : 0;
+        fin = false;
+    }
+    if (data_length == 0 && !fin) {
+        return;
+    }
+
+    struct list_node *insert_before = &tcb->out_of_order_queue;
+    list_for_each_entry(&tcb->out_of_order_queue, iter, struct tcp_out_of_order_segment, queue) {
+        if (TCP_SEQ_LEQ(iter->sequence_start, sequence_start) && TCP_SEQ_GEQ(iter->sequence_end, sequence_start + data_length) &&
+            (iter->fin || !fin)) {
+            // Already recieved.
+            return;
+        }
+        if (TCP_SEQ_GT(iter->sequence_start, sequence_start)) {
+            insert_before = &iter->queue;
+            break;
+        }
+    }
+
+    struct tcp_out_of_order_segment *segment = malloc(sizeof(struct tcp_out_of_order_segment));
+    if (!segment) {
+        return;
+    }
+    segment->sequence_start = sequence_start;
+    segment->sequence_end = sequence_start + data_length;
+    segment->fin = fin;
+    segment->packet = data_length ? net_packet_reference_data(net_packet, tcp_data_start(packet) + packet->flags.syn, data_length) : NULL;
+    list_append(insert_before, &segment->queue);
+    tcb->out_of_order_last_start = sequence_start;
+}
+
+// Moves queued segments which are now in order into the recieve buffer. Returns whether the FIN was reached.
+static bool tcp_drain_out_of_order_queue(struct socket *socket) {
+    struct tcp_control_block *tcb = socket->private_data;
+    bool fin = false;
+    list_for_each_entry_safe(&tcb->out_of_order_queue, segment, struct tcp_out_of_order_segment, queue) {
+        if (TCP_SEQ_GT(segment->sequence_start, tcb->recv_next)) {
+            break;
+        }
+
+        if (TCP_SEQ_GT(segment->sequence_end, tcb->recv_next)) {
+            size_t offset = tcb->recv_next - segment->sequence_start;
+            size_t length = MIN(segment->sequence_end - tcb->recv_next, tcp_recv_space(tcb));
+            if (length != 0) {
+                // The segment's packet moves to the recieve queue, with only the new part of its data.
+                struct packet *held = segment->packet;
+                segment->packet = NULL;
+                held->payload += offset;
+                held->payload_length = length;
+                tcp_queue_recieved_data(socket, held);
+            }
+            tcb->recv_next += length;
+            tcb->recv_window -= MIN(length, tcb->recv_window);
+        }
+
+        if (segment->fin && tcb->recv_next == segment->sequence_end) {
+            tcb->recv_next++;
+            fin = true;
+        }
+
+        list_remove(&segment->queue);
+        if (segment->packet) {
+            net_free_packet(segment->packet);
+        }
+        free(segment);
+        if (fin) {
+            break;
+        }
+    }
+    return fin;
+}
+
+static void tcp_process_segment(struct socket *socket, struct packet *net_packet, const struct ip_v4_packet *ip_packet,
+                                const struct tcp_packet *packet, const struct tcp_parsed_options *options) {
+    struct tcp_control_block *tcb = socket->private_data;
+    bool fin_recieved = false;
     switch (tcb->state) {
         case TCP_SYN_SENT:
         case TCP_SYN_RECIEVED:
@@ -392,38 +643,51 @@ static void tcp_process_segment(struct socket *socket, struct network_interface
 
             if (packet->flags.syn) {
                 tcb->recv_next = htonl(packet->sequence_number);
-                tcb->send_mss = tcp_mss(packet);
+                tcp_negotiate_options(tcb, options);
             }
 
-            // Packet sent out of order, it would be best to remember it, but not for now.
-            if (htonl(packet->sequence_number) > tcb->recv_next) {
+            // The segment arrived ahead of missing data. Keep it, and send a duplicate ACK right away, which tells the
+            // sender about the gap.
+            if (TCP_SEQ_GT(htonl(packet->sequence_number), tcb->recv_next)) {
+                tcp_queue_out_of_order_segment(socket, net_packet, ip_packet, packet);
+                tcp_send_empty_ack(socket, ip_packet, packet);
                 return;
             }
 
             size_t offset = tcb->recv_next - htonl(packet->sequence_number);
             segment_length -= offset + packet->flags.syn + packet->flags.fin;
 
-            size_t available_space = ring_buffer_space(&tcb->recv_buffer);
+            size_t available_space = tcp_recv_space(tcb);
+            fin_recieved = packet->flags.fin && segment_length <= available_space;
             segment_length = MIN(available_space, segment_length);
 
-            tcb->recv_next += packet->flags.syn + packet->flags.fin + segment_length;
+            tcb->recv_next += packet->flags.syn + segment_length;
 
             if (segment_length != 0) {
                 // The socket has already been closed, send a reset since there's nowhere for the recieved data to go.
                 if (socket->state >= CLOSING) {
-                    tcp_send_reset(socket, interface, ip_packet, packet);
+                    tcp_send_reset(socket, net_packet->interface, ip_packet, packet);
                     net_free_tcp_control_block(socket);
                     return;
                 }
 
-                ring_buffer_write(&tcb->recv_buffer, tcp_data_start(packet) + offset, segment_length);
-                fs_trigger_state(&socket->file_state, POLLIN);
+                tcp_queue_recieved_data(
+                    socket, net_packet_reference_data(net_packet, tcp_data_start(packet) + packet->flags.syn + offset, segment_length));
+            }
+
+            tcb->recv_window -= MIN(segment_length, tcb->recv_window);
+
+            // The segment may have filled the gap in front of segments which arrived out of order.
+            bool gap_filled = !list_is_empty(&tcb->out_of_order_queue);
+            if (fin_recieved) {
+                tcb->recv_next++;
+            } else if (gap_filled) {
+                fin_recieved = tcp_drain_out_of_order_queue(socket);
             }
 
-            tcb->recv_window -= segment_length;
             bool window_advanced = tcp_update_recv_window(socket);
 
-            if (packet->flags.psh || (packet->flags.syn && packet->flags.ack) || packet->flags.fin || window_advanced ||
+            if (packet->flags.psh || (packet->flags.syn && packet->flags.ack) || packet->flags.fin || window_advanced || gap_filled ||
                 tcb->last_segment_unacknowledged) {
                 tcp_send_empty_ack(socket, ip_packet, packet);
                 tcb->last_segment_unacknowledged = false;
@@ -448,11 +712,7 @@ static void tcp_process_segment(struct socket *socket, struct network_interface
             assert(false);
     }
 
-    if (packet->flags.fin) {
-        if (tcb->recv_next != htonl(packet->sequence_number) + tcp_segment_length(ip_packet, packet)) {
-            return;
-        }
-
+    if (fin_recieved) {
         // All outstanding data has been recieved.
         socket->state = CLOSING;
         fs_trigger_state(&socket->file_state, POLL_HUP);
@@ -484,18 +744,18 @@ static void tcp_process_segment(struct socket *socket, struct network_interface
     }
 }
 
-static void tcp_recv_in_listen(struct socket *socket, struct network_interface *interface, const struct ip_v4_packet *ip_packet,
-                               const struct tcp_packet *packet) {
+static void tcp_recv_in_listen(struct socket *socket, struct packet *net_packet, const struct ip_v4_packet *ip_packet,
+                               const struct tcp_packet *packet, const struct tcp_parsed_options *options) {
     struct tcp_control_block *tcb = socket->private_data;
     if (packet->flags.rst) {
         return;
     } else if (packet->flags.ack) {
-        tcp_send_reset(socket, interface, ip_packet, packet);
+        tcp_send_reset(socket, net_packet->interface, ip_packet, packet);
         return;
     } else if (packet->flags.syn) {
         if (socket->num_pending >= socket->pending_length) {
             // There are too many pending connections, so refuse this one.
-            tcp_send_reset(socket, interface, ip_packet, packet);
+            tcp_send_reset(socket, net_packet->interface, ip_packet, packet);
             return;
         }
 
@@ -523,7 +783,7 @@ static void tcp_recv_in_listen(struct socket *socket, struct network_interface *
 
         // Update the TCB
         tcb->state = TCP_SYN_RECIEVED;
-        tcp_process_segment(socket, interface, ip_packet, packet);
+        tcp_process_segment(socket, net_packet, ip_packet, packet, options);
 
         // Replace the TCB with a new one, for the next incoming connection
         struct tcp_control_block *new_tcb = net_allocate_tcp_control_block(socket);
@@ -533,12 +793,12 @@ static void tcp_recv_in_listen(struct socket *socket, struct network_interface *
     }
 }
 
-static void tcp_recv_in_syn_sent(struct socket *socket, struct network_interface *interface, const struct ip_v4_packet *ip_packet,
-                                 const struct tcp_packet *packet) {
+static void tcp_recv_in_syn_sent(struct socket *socket, struct packet *net_packet, const struct ip_v4_packet *ip_packet,
+                                 const struct tcp_packet *packet, const struct tcp_parsed_options *options) {
     struct tcp_control_block *tcb = socket->private_data;
     if (packet->flags.ack) {
-        if (htonl(packet->ack_number) <= tcb->send_unacknowledged || htonl(packet->ack_number) > tcb->send_next) {
-            tcp_send_reset(socket, interface, ip_packet, packet);
+        if (htonl(packet->ack_number) <= tcb->send_unacknowledged || htonl(packet->ack_number) > tcb->send_max) {
+            tcp_send_reset(socket, net_packet->interface, ip_packet, packet);
             return;
         }
         if (packet->flags.rst) {
@@ -558,25 +818,43 @@ static void tcp_recv_in_syn_sent(struct socket *socket, struct network_interface
     // Valid SYN was sent.
     fs_trigger_state(&socket->file_state, POLLIN);
     if (packet->flags.ack) {
-        tcp_advance_ack_number(socket, htonl(packet->ack_number));
-        tcp_process_segment(socket, interface, ip_packet, packet);
+        tcp_advance_ack_number(socket, htonl(packet->ack_number), options);
+        tcp_process_segment(socket, net_packet, ip_packet, packet, options);
         tcp_enter_established_state(socket, packet);
         return;
     }
 
     tcb->state = TCP_SYN_RECIEVED;
-    tcp_process_segment(socket, interface, ip_packet, packet);
+    tcp_process_segment(socket, net_packet, ip_packet, packet, options);
     return;
 }
 
-static void tcp_recv_data(struct socket *socket, struct network_interface *interface, const struct ip_v4_packet *ip_packet,
-                          const struct tcp_packet *packet) {
+// An ACK which acknowledges nothing new, while data is outstanding, and carries no data of its own (RFC 5681). Each
+// one means a segment sent after a lost one has arrived.
+static bool tcp_is_duplicate_ack(struct socket *socket, const struct ip_v4_packet *ip_packet, const struct tcp_packet *packet) {
+    struct tcp_control_block *tcb = socket->private_data;
+    return tcb->send_max != tcb->send_unacknowledged && tcp_segment_length(ip_packet, packet) == 0;
+}
+
+static void tcp_recv_data(struct socket *socket, struct packet *net_packet, const struct ip_v4_packet *ip_packet,
+                          const struct tcp_packet *packet, const struct tcp_parsed_options *options) {
     struct tcp_control_block *tcb = socket->private_data;
     if (!tcp_segment_acceptable(socket, ip_packet, packet)) {
         tcp_send_empty_ack(socket, ip_packet, packet);
         return;
     }
 
+    if (tcb->timestamps_enabled && options->has_timestamp) {
+        // Drop old duplicates whose sequence numbers have wrapped around (PAWS, RFC 7323).
+        if (!packet->flags.rst && TCP_SEQ_LT(options->timestamp_value, tcb->timestamp_recent)) {
+            tcp_send_empty_ack(socket, ip_packet, packet);
+            return;
+        }
+        if (TCP_SEQ_LEQ(htonl(packet->sequence_number), tcb->recv_next)) {
+            tcb->timestamp_recent = options->timestamp_value;
+        }
+    }
+
     if (packet->flags.rst) {
         switch (tcb->state) {
             case TCP_SYN_RECIEVED: {
@@ -608,7 +886,7 @@ static void tcp_recv_data(struct socket *socket, struct network_interface *inter
     }
 
     if (packet->flags.syn) {
-        tcp_send_reset(socket, interface, ip_packet, packet);
+        tcp_send_reset(socket, net_packet->interface, ip_packet, packet);
         socket->error = ECONNRESET;
         socket->state = CLOSED;
         net_free_tcp_control_block(socket);
@@ -621,12 +899,12 @@ static void tcp_recv_data(struct socket *socket, struct network_interface *inter
 
     switch (tcb->state) {
         case TCP_SYN_RECIEVED:
-            if (tcb->send_unacknowledged > htonl(packet->ack_number) || htonl(packet->ack_number) > tcb->send_next) {
-                tcp_send_reset(socket, interface, ip_packet, packet);
+            if (tcb->send_unacknowledged > htonl(packet->ack_number) || htonl(packet->ack_number) > tcb->send_max) {
+                tcp_send_reset(socket, net_packet->interface, ip_packet, packet);
                 break;
             }
-            tcp_advance_ack_number(socket, htonl(packet->ack_number));
-            tcp_process_segment(socket, interface, ip_packet, packet);
+            tcp_advance_ack_number(socket, htonl(packet->ack_number), options);
+            tcp_process_segment(socket, net_packet, ip_packet, packet, options);
             tcp_enter_established_state(socket, packet);
             return;
         case TCP_ESTABLISHED:
@@ -636,19 +914,27 @@ static void tcp_recv_data(struct socket *socket, struct network_interface *inter
         case TCP_CLOSING:
         case TCP_LAST_ACK:
         case TCP_TIME_WAIT:
-            if (htonl(packet->ack_number) <= tcb->send_unacknowledged) {
-                break;
-            } else if (htonl(packet->ack_number) > tcb->send_next) {
+            if (TCP_SEQ_GT(htonl(packet->ack_number), tcb->send_max)) {
                 tcp_send_empty_ack(socket, ip_packet, packet);
                 return;
             }
 
-            tcp_advance_ack_number(socket, htonl(packet->ack_number));
-            if (tcb->send_wl1 < htonl(packet->sequence_number) ||
-                (tcb->send_wl1 == htonl(packet->sequence_number) && tcb->send_wl2 <= htonl(packet->ack_number))) {
-                tcp_update_send_window(socket, packet);
+            bool new_sack_data = tcb->sack_enabled && tcp_update_sack_scoreboard(tcb, options->sack_blocks, options->sack_block_count);
+            if (TCP_SEQ_LEQ(htonl(packet->ack_number), tcb->send_unacknowledged)) {
+                if (htonl(packet->ack_number) == tcb->send_unacknowledged) {
+                    bool window_changed = tcp_maybe_update_send_window(socket, packet);
+                    if (tcp_is_duplicate_ack(socket, ip_packet, packet) && (!window_changed || new_sack_data)) {
+                        tcp_on_duplicate_ack(socket);
+                    } else if (window_changed) {
+                        tcp_send_segments(socket);
+                    }
+                }
+                break;
             }
 
+            tcp_advance_ack_number(socket, htonl(packet->ack_number), options);
+            tcp_maybe_update_send_window(socket, packet);
+
             switch (tcb->state) {
                 case TCP_FIN_WAIT_1:
                     if (tcb->pending_fin) {
@@ -685,18 +971,18 @@ static void tcp_recv_data(struct socket *socket, struct network_interface *inter
             assert(false);
     }
 
-    tcp_process_segment(socket, interface, ip_packet, packet);
+    tcp_process_segment(socket, net_packet, ip_packet, packet, options);
 }
 
-static void tcp_recv_on_socket(struct socket *socket, struct network_interface *interface, const struct ip_v4_packet *ip_packet,
-                               const struct tcp_packet *packet) {
+static void tcp_recv_on_socket(struct socket *socket, struct packet *net_packet, const struct ip_v4_packet *ip_packet,
+                               const struct tcp_packet *packet, const struct tcp_parsed_options *options) {
     struct tcp_control_block *tcb = socket->private_data;
     switch (tcb->state) {
         case TCP_LITSEN:
-            tcp_recv_in_listen(socket, interface, ip_packet, packet);
+            tcp_recv_in_listen(socket, net_packet, ip_packet, packet, options);
             return;
         case TCP_SYN_SENT:
-            tcp_recv_in_syn_sent(socket, interface, ip_packet, packet);
+            tcp_recv_in_syn_sent(socket, net_packet, ip_packet, packet, options);
             return;
         case TCP_SYN_RECIEVED:
         case TCP_ESTABLISHED:
@@ -706,7 +992,7 @@ static void tcp_recv_on_socket(struct socket *socket, struct network_interface *
         case TCP_CLOSING:
         case TCP_LAST_ACK:
         case TCP_TIME_WAIT:
-            tcp_recv_data(socket, interface, ip_packet, packet);
+            tcp_recv_data(socket, net_packet, ip_packet, packet, options);
             return;
         default:
             assert(false);
@@ -717,7 +1003,8 @@ static void tcp_recv_on_socket(struct socket *socket, struct network_interface *
 void net_tcp_recieve(struct packet *net_packet) {
     struct packet_header *tcp_header = net_packet_inner_header(net_packet);
     struct tcp_packet *packet = tcp_header->raw_header;
-    if (tcp_header->length < sizeof(struct tcp_packet)) {
+    if (tcp_header->length < sizeof(struct tcp_packet) || sizeof(uint32_t) * packet->data_offset < sizeof(struct tcp_packet) ||
+        sizeof(uint32_t) * packet->data_offset > tcp_header->length) {
         debug_log("TCP Packet to small\n");
         return;
     }
@@ -755,9 +1042,12 @@ void net_tcp_recieve(struct packet *net_packet) {
         return;
     }
 
+    struct tcp_parsed_options options;
+    tcp_parse_options(packet, &options);
+
     net_bump_socket(socket);
     mutex_lock(&socket->lock);
-    tcp_recv_on_socket(socket, net_packet->interface, ip_packet, packet);
+    tcp_recv_on_socket(socket, net_packet, ip_packet, packet, &options);
     mutex_unlock(&socket->lock);
     net_drop_socket(socket);
 }
@@ -769,22 +1059,68 @@ void net_init_tcp_packet(struct tcp_packet *packet, struct tcp_packet_options *o
     packet->ack_number = htonl(opts->ack_number);
     packet->ns = 0;
     packet->zero = 0;
-    packet->data_offset = (sizeof(struct tcp_packet) + opts->tcp_flags.syn * sizeof(struct tcp_option_mss)) / sizeof(uint32_t);
+    packet->data_offset = (sizeof(struct tcp_packet) + tcp_options_length(opts)) / sizeof(uint32_t);
     packet->flags = opts->tcp_flags;
     packet->window_size = htons(opts->window);
     packet->check_sum = 0;
     packet->urg_pointer = 0;
 
+    uint8_t *option = packet->options_and_payload;
     if (opts->tcp_flags.syn) {
-        // Send an MSS option.
-        struct tcp_option_mss *opt = (struct tcp_option_mss *) packet->options_and_payload;
-        opt->type = TCP_OPTION_MSS;
-        opt->length = sizeof(struct tcp_option_mss);
-        opt->mss = htons(opts->mss);
+        struct tcp_option_mss *mss = (struct tcp_option_mss *) option;
+        mss->type = TCP_OPTION_MSS;
+        mss->length = sizeof(struct tcp_option_mss);
+        mss->mss = htons(opts->mss);
+        option += sizeof(struct tcp_option_mss);
+
+        if (opts->send_window_scale) {
+            *option++ = TCP_OPTION_PAD;
+            struct tcp_option_window_scale *window_scale = (struct tcp_option_window_scale *) option;
+            window_scale->type = TCP_OPTION_WINDOW_SCALE;
+            window_scale->length = sizeof(struct tcp_option_window_scale);
+            window_scale->shift = opts->window_scale;
+            option += sizeof(struct tcp_option_window_scale);
+        }
+
+        // SACK permitted takes the place of the padding in front of the timestamp when both are sent.
+        if (opts->send_sack_permitted) {
+            if (!opts->send_timestamp) {
+                *option++ = TCP_OPTION_PAD;
+                *option++ = TCP_OPTION_PAD;
+            }
+            *option++ = TCP_OPTION_SACK_PERMITTED;
+            *option++ = 2;
+        }
+    }
+
+    if (opts->send_timestamp) {
+        if (!opts->tcp_flags.syn || !opts->send_sack_permitted) {
+            *option++ = TCP_OPTION_PAD;
+            *option++ = TCP_OPTION_PAD;
+        }
+        struct tcp_option_timestamp *timestamp = (struct tcp_option_timestamp *) option;
+        timestamp->type = TCP_OPTION_TIMESTAMP;
+        timestamp->length = sizeof(struct tcp_option_timestamp);
+        timestamp->value = htonl(opts->timestamp_value);
+        timestamp->echo = htonl(opts->timestamp_echo);
+        option += sizeof(struct tcp_option_timestamp);
+    }
+
+    if (opts->sack_block_count) {
+        *option++ = TCP_OPTION_PAD;
+        *option++ = TCP_OPTION_PAD;
+        *option++ = TCP_OPTION_SACK;
+        *option++ = 2 + opts->sack_block_count * sizeof(struct tcp_sack_block);
+        for (size_t i = 0; i < opts->sack_block_count; i++) {
+            uint32_t edges[2] = { htonl(opts->sack_blocks[i].start), htonl(opts->sack_blocks[i].end) };
+            memcpy(option, edges, sizeof(edges));
+            option += sizeof(edges);
+        }
     }
 
     if (opts->data_length > 0 && opts->data_rb != NULL) {
         ring_buffer_copy(opts->data_rb, opts->data_offset, (void *) tcp_data_start(packet), opts->data_length);
+        net_packet_count_copy(opts->data_length);
     }
 }
 
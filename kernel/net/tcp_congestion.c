@@ -0,0 +1,397 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <kernel/net/ip_address.h>
+#include <kernel/net/socket.h>
+#include <kernel/net/tcp.h>
+#include <kernel/net/tcp_congestion.h>
+#include <kernel/net/tcp_socket.h>
+#include <kernel/util/macros.h>
+
+// Keeps the congestion window from overflowing when the connection is limited by the application instead of the network.
+#define TCP_MAX_CONGESTION_WINDOW (1U << 30)
+
+// CUBIC's multiplicative decrease factor, in tenths. The scaling constant C is 0.4.
+#define CUBIC_BETA_TENTHS 7
+
+static uint32_t tcp_flight_size(struct tcp_control_block *tcb) {
+    return tcb->send_max - tcb->send_unacknowledged;
+}
+
+static uint32_t reno_on_loss(struct tcp_control_block *tcb) {
+    return MAX(tcp_flight_size(tcb) / 2, 2 * tcp_segment_size(tcb));
+}
+
+static void reno_on_congestion_avoidance(struct tcp_control_block *tcb, uint32_t bytes_acked) {
+    // Grow by one segment for every window's worth of acknowledged data (RFC 5681).
+    tcb->bytes_acked += bytes_acked;
+    if (tcb->bytes_acked >= tcb->congestion_window) {
+        tcb->bytes_acked -= tcb->congestion_window;
+        tcb->congestion_window += tcp_segment_size(tcb);
+    }
+}
+
+static uint32_t cube_root(uint64_t value) {
+    uint64_t low = 0;
+    uint64_t high = 2097151;
+    while (low < high) {
+        uint64_t middle = (low + high + 1) / 2;
+        if (middle * middle * middle <= value) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return low;
+}
+
+static uint32_t cubic_on_loss(struct tcp_control_block *tcb) {
+    struct tcp_cubic_state *cubic = &tcb->cubic;
+    uint32_t segment_size = tcp_segment_size(tcb);
+    uint32_t window = MAX(tcb->congestion_window / segment_size, 1U);
+
+    // Fast convergence: a loss before the window grew back to the last maximum suggests another flow is taking a share
+    // of the link, so the maximum is lowered further to make room for it.
+    if (window < cubic->w_max) {
+        cubic->w_max = window * (10 + CUBIC_BETA_TENTHS) / 20;
+    } else {
+        cubic->w_max = window;
+    }
+    cubic->epoch_valid = false;
+
+    return MAX(tcb->congestion_window / 10 * CUBIC_BETA_TENTHS, 2 * segment_size);
+}
+
+static void cubic_on_congestion_avoidance(struct tcp_control_block *tcb, uint32_t bytes_acked) {
+    struct tcp_cubic_state *cubic = &tcb->cubic;
+    uint32_t segment_size = tcp_segment_size(tcb);
+    uint32_t window = MAX(tcb->congestion_window / segment_size, 1U);
+    uint32_t now = tcp_time_ms();
+
+    if (!cubic->epoch_valid) {
+        cubic->epoch_valid = true;
+        cubic->epoch_start = now;
+        cubic->reno_window = tcb->congestion_window;
+        if (window < cubic->w_max) {
+            // K = cbrt((W_max - cwnd) / C) seconds, computed here in milliseconds.
+            cubic->k = cube_root((uint64_t) (cubic->w_max - window) * 2500000000ULL);
+        } else {
+            cubic->k = 0;
+            cubic->w_max = window;
+        }
+    }
+
+    // W_cubic(t) = C * (t - K)^3 + W_max, evaluated one round trip ahead. With t in milliseconds, C * t^3 is 4 * t^3 / 10^10.
+    int64_t offset = (int64_t) (uint32_t) (now - cubic->epoch_start) + tcb->smoothed_rtt - cubic->k;
+    offset = MAX(MIN(offset, 1000000LL), -1000000LL);
+    int64_t target_segments = (int64_t) cubic->w_max + 4 * offset * offset * offset / 10000000000LL;
+    uint64_t target = (uint64_t) MAX(target_segments, 1LL) * segment_size;
+
+    // Never grow slower than standard TCP would in the same time (the TCP-friendly region of RFC 8312).
+    cubic->reno_window += (uint64_t) 9 * segment_size * bytes_acked / (17 * (uint64_t) tcb->congestion_window);
+    target = MAX(target, (uint64_t) cubic->reno_window);
+    target = MIN(target, (uint64_t) tcb->congestion_window * 3 / 2);
+
+    uint64_t increment;
+    if (target > tcb->congestion_window) {
+        increment = (target - tcb->congestion_window) * bytes_acked / tcb->congestion_window;
+    } else {
+        increment = (uint64_t) segment_size * bytes_acked / (100 * (uint64_t) tcb->congestion_window);
+    }
+    tcb->congestion_window += increment;
+}
+
+static struct tcp_congestion_ops congestion_ops[] = {
+    { .name = "cubic", .on_congestion_avoidance = cubic_on_congestion_avoidance, .on_loss = cubic_on_loss },
+    { .name = "reno", .on_congestion_avoidance = reno_on_congestion_avoidance, .on_loss = reno_on_loss },
+};
+
+struct tcp_congestion_ops *tcp_find_congestion_ops(const char *name) {
+    for (size_t i = 0; i < sizeof(congestion_ops) / sizeof(congestion_ops[0]); i++) {
+        if (strcmp(congestion_ops[i].name, name) == 0) {
+            return &congestion_ops[i];
+        }
+    }
+    return NULL;
+}
+
+struct tcp_congestion_ops *tcp_default_congestion_ops(void) {
+    return &congestion_ops[0];
+}
+
+void tcp_congestion_init(struct tcp_control_block *tcb) {
+    uint32_t segment_size = tcp_segment_size(tcb);
+
+    // The initial window from RFC 6928, or a single segment if the SYN had to be retransmitted.
+    if (tcb->reset_rto_once_established) {
+        tcb->congestion_window = segment_size;
+    } else {
+        tcb->congestion_window = MIN(10 * segment_size, MAX(2 * segment_size, 14600U));
+    }
+    tcb->slow_start_threshold = UINT32_MAX;
+    tcb->bytes_acked = 0;
+}
+
+void tcp_congestion_on_timeout(struct tcp_control_block *tcb) {
+    uint32_t segment_size = tcp_segment_size(tcb);
+
+    // Repeated timeouts for the same data only back off the timer, the window is already as small as it gets.
+    if (tcb->congestion_window > segment_size) {
+        tcb->slow_start_threshold = tcb->congestion_ops->on_loss(tcb);
+    }
+    tcb->congestion_window = segment_size;
+    tcb->bytes_acked = 0;
+    tcb->duplicate_acks = 0;
+    tcb->in_recovery = false;
+
+    // The peer may have discarded data it SACKed (RFC 2018 allows this), so everything is resent after a timeout.
+    tcb->sack_scoreboard_count = 0;
+}
+
+// RFC 6675's estimate of the data still in the network: everything outstanding, less what was SACKed and the holes below
+// the highest SACKed byte, which are presumed lost, plus what of those holes was already retransmitted.
+static uint32_t tcp_pipe(struct tcp_control_block *tcb) {
+    int64_t pipe = tcb->send_max - tcb->send_unacknowledged;
+    uint32_t hole_start = tcb->send_unacknowledged;
+    for (int i = 0; i < tcb->sack_scoreboard_count; i++) {
+        struct tcp_sack_block *block = &tcb->sack_scoreboard[i];
+        pipe -= block->start - hole_start;
+        if (TCP_SEQ_GT(tcb->recovery_retransmit_next, hole_start)) {
+            uint32_t retransmitted_end =
+                TCP_SEQ_LT(tcb->recovery_retransmit_next, block->start) ? tcb->recovery_retransmit_next : block->start;
+            pipe += retransmitted_end - hole_start;
+        }
+        pipe -= block->end - block->start;
+        hole_start = block->end;
+    }
+    return MAX(pipe, 0LL);
+}
+
+ssize_t tcp_congestion_usable_window(struct tcp_control_block *tcb) {
+    uint32_t segment_size = tcp_segment_size(tcb);
+    ssize_t outstanding = tcb->send_next - tcb->send_unacknowledged;
+    ssize_t peer_window = (ssize_t) tcb->send_window - outstanding;
+
+    ssize_t congestion_window;
+    if (tcb->in_recovery && tcb->sack_enabled) {
+        congestion_window = (ssize_t) tcb->congestion_window - (ssize_t) tcp_pipe(tcb);
+    } else if (tcb->in_recovery) {
+        congestion_window = (ssize_t) tcb->congestion_window - outstanding;
+    } else {
+        // Limited transmit (RFC 3042) lets a new segment out for each of the first two duplicate ACKs, so that small
+        // windows still produce enough duplicate ACKs for fast retransmit.
+        congestion_window = (ssize_t) tcb->congestion_window + MIN(tcb->duplicate_acks, 2U) * segment_size - outstanding;
+    }
+    return MIN(peer_window, congestion_window);
+}
+
+// Finds the first hole in the scoreboard which has not been retransmitted during this recovery.
+static bool tcp_next_hole(struct tcp_control_block *tcb, uint32_t *start, uint32_t *end) {
+    uint32_t hole_start = tcb->send_unacknowledged;
+    for (int i = 0; i < tcb->sack_scoreboard_count; i++) {
+        struct tcp_sack_block *block = &tcb->sack_scoreboard[i];
+        uint32_t first_unsent = TCP_SEQ_GT(tcb->recovery_retransmit_next, hole_start) ? tcb->recovery_retransmit_next : hole_start;
+        if (TCP_SEQ_LT(first_unsent, block->start)) {
+            *start = first_unsent;
+            *end = block->start;
+            return true;
+        }
+        hole_start = block->end;
+    }
+    return false;
+}
+
+static int tcp_retransmit_first_segment(struct socket *socket) {
+    struct tcp_control_block *tcb = socket->private_data;
+    uint32_t end = tcb->send_unacknowledged + MIN(tcp_flight_size(tcb), tcp_segment_size(tcb));
+    if (tcb->sack_scoreboard_count > 0 && TCP_SEQ_LT(tcb->sack_scoreboard[0].start, end)) {
+        end = tcb->sack_scoreboard[0].start;
+    }
+    if (end == tcb->send_unacknowledged) {
+        return 0;
+    }
+
+    if (TCP_SEQ_GT(end, tcb->recovery_retransmit_next)) {
+        tcb->recovery_retransmit_next = end;
+    }
+    tcb->time_first_sent_valid = false;
+    return net_send_tcp_from_socket(socket, tcb->send_unacknowledged, end, false, true);
+}
+
+int tcp_retransmit_lost_segments(struct socket *socket) {
+    struct tcp_control_block *tcb = socket->private_data;
+    uint32_t segment_size = tcp_segment_size(tcb);
+
+    int ret = 0;
+    uint32_t start;
+    uint32_t end;
+    while (ret == 0 && tcp_pipe(tcb) + segment_size <= tcb->congestion_window && tcp_next_hole(tcb, &start, &end)) {
+        if (TCP_SEQ_GT(end, start + segment_size)) {
+            end = start + segment_size;
+        }
+        tcb->recovery_retransmit_next = end;
+        tcb->time_first_sent_valid = false;
+        ret = net_send_tcp_from_socket(socket, start, end, false, true);
+    }
+    return ret;
+}
+
+static void tcp_enter_recovery(struct socket *socket) {
+    struct tcp_control_block *tcb = socket->private_data;
+    uint32_t segment_size = tcp_segment_size(tcb);
+
+    tcb->slow_start_threshold = tcb->congestion_ops->on_loss(tcb);
+    tcb->recover = tcb->send_max;
+    tcb->recovery_retransmit_next = tcb->send_unacknowledged;
+    tcb->bytes_acked = 0;
+    tcb->in_recovery = true;
+
+    // NewReno inflates the window by the three segments which the duplicate ACKs show have left the network. With SACK,
+    // the pipe estimate accounts for them instead.
+    if (tcb->sack_enabled) {
+        tcb->congestion_window = tcb->slow_start_threshold;
+    } else {
+        tcb->congestion_window = tcb->slow_start_threshold + TCP_DUPLICATE_ACK_THRESHOLD * segment_size;
+    }
+
+    tcp_retransmit_first_segment(socket);
+    tcp_send_segments(socket);
+}
+
+void tcp_on_duplicate_ack(struct socket *socket) {
+    struct tcp_control_block *tcb = socket->private_data;
+    tcb->duplicate_acks++;
+
+    if (tcb->in_recovery) {
+        if (!tcb->sack_enabled) {
+            tcb->congestion_window += tcp_segment_size(tcb);
+        }
+        tcp_send_segments(socket);
+        return;
+    }
+
+    // Losses in data sent before the last recovery started were already dealt with by it (RFC 6582).
+    if (tcb->duplicate_acks >= TCP_DUPLICATE_ACK_THRESHOLD && TCP_SEQ_GT(tcb->send_unacknowledged, tcb->recover)) {
+        tcp_enter_recovery(socket);
+        return;
+    }
+
+    tcp_send_segments(socket);
+}
+
+void tcp_on_new_ack(struct socket *socket, uint32_t bytes_acked) {
+    struct tcp_control_block *tcb = socket->private_data;
+    uint32_t segment_size = tcp_segment_size(tcb);
+
+    if (tcb->in_recovery) {
+        if (TCP_SEQ_GEQ(tcb->send_unacknowledged, tcb->recover)) {
+            // Everything outstanding when the loss was detected has arrived.
+            tcb->in_recovery = false;
+            tcb->duplicate_acks = 0;
+            if (tcb->sack_enabled) {
+                tcb->congestion_window = tcb->slow_start_threshold;
+            } else {
+                tcb->congestion_window = MIN(tcb->slow_start_threshold, MAX(tcp_flight_size(tcb), segment_size) + segment_size);
+            }
+            return;
+        }
+
+        // A partial acknowledgement, which means the data now at the front was lost as well.
+        if (TCP_SEQ_LT(tcb->recovery_retransmit_next, tcb->send_unacknowledged)) {
+            tcb->recovery_retransmit_next = tcb->send_unacknowledged;
+        }
+        if (!tcb->sack_enabled) {
+            tcp_retransmit_first_segment(socket);
+            tcb->congestion_window -= MIN(bytes_acked, tcb->congestion_window);
+            if (bytes_acked >= segment_size) {
+                tcb->congestion_window += segment_size;
+            }
+            tcb->congestion_window = MAX(tcb->congestion_window, segment_size);
+        }
+        return;
+    }
+
+    tcb->duplicate_acks = 0;
+    if (tcb->congestion_window >= TCP_MAX_CONGESTION_WINDOW) {
+        return;
+    }
+
+    if (tcb->congestion_window < tcb->slow_start_threshold) {
+        // Slow start, counting at most two segments per ACK (RFC 3465).
+        tcb->congestion_window += MIN(bytes_acked, 2 * segment_size);
+    } else {
+        tcb->congestion_ops->on_congestion_avoidance(tcb, bytes_acked);
+    }
+}
+
+static void tcp_remove_sack_block(struct tcp_control_block *tcb, int index) {
+    memmove(&tcb->sack_scoreboard[index], &tcb->sack_scoreboard[index + 1],
+            (tcb->sack_scoreboard_count - index - 1) * sizeof(struct tcp_sack_block));
+    tcb->sack_scoreboard_count--;
+}
+
+static bool tcp_insert_sack_block(struct tcp_control_block *tcb, uint32_t start, uint32_t end) {
+    for (int i = 0; i < tcb->sack_scoreboard_count; i++) {
+        struct tcp_sack_block *block = &tcb->sack_scoreboard[i];
+        if (TCP_SEQ_LEQ(block->start, start) && TCP_SEQ_GEQ(block->end, end)) {
+            return false;
+        }
+    }
+
+    // Merge the new block with any blocks it overlaps or touches.
+    for (int i = 0; i < tcb->sack_scoreboard_count;) {
+        struct tcp_sack_block *block = &tcb->sack_scoreboard[i];
+        if (TCP_SEQ_LEQ(block->start, end) && TCP_SEQ_LEQ(start, block->end)) {
+            start = TCP_SEQ_LT(block->start, start) ? block->start : start;
+            end = TCP_SEQ_GT(block->end, end) ? block->end : end;
+            tcp_remove_sack_block(tcb, i);
+            continue;
+        }
+        i++;
+    }
+
+    int index = 0;
+    while (index < tcb->sack_scoreboard_count && TCP_SEQ_LT(tcb->sack_scoreboard[index].start, start)) {
+        index++;
+    }
+
+    if (tcb->sack_scoreboard_count == TCP_MAX_SACK_SCOREBOARD) {
+        if (index == TCP_MAX_SACK_SCOREBOARD) {
+            return true;
+        }
+        tcb->sack_scoreboard_count--;
+    }
+
+    memmove(&tcb->sack_scoreboard[index + 1], &tcb->sack_scoreboard[index],
+            (tcb->sack_scoreboard_count - index) * sizeof(struct tcp_sack_block));
+    tcb->sack_scoreboard[index] = (struct tcp_sack_block) { .start = start, .end = end };
+    tcb->sack_scoreboard_count++;
+    return true;
+}
+
+bool tcp_update_sack_scoreboard(struct tcp_control_block *tcb, const struct tcp_sack_block *blocks, size_t block_count) {
+    bool updated = false;
+    for (size_t i = 0; i < block_count; i++) {
+        uint32_t start = blocks[i].start;
+        uint32_t end = blocks[i].end;
+
+        // Ignore blocks which are malformed, already acknowledged, or cover data which was never sent.
+        if (!TCP_SEQ_LT(start, end) || TCP_SEQ_LEQ(end, tcb->send_unacknowledged) || TCP_SEQ_GT(end, tcb->send_max)) {
+            continue;
+        }
+        if (TCP_SEQ_LT(start, tcb->send_unacknowledged)) {
+            start = tcb->send_unacknowledged;
+        }
+        updated |= tcp_insert_sack_block(tcb, start, end);
+    }
+    return updated;
+}
+
+void tcp_trim_sack_scoreboard(struct tcp_control_block *tcb) {
+    while (tcb->sack_scoreboard_count > 0 && TCP_SEQ_LEQ(tcb->sack_scoreboard[0].end, tcb->send_unacknowledged)) {
+        tcp_remove_sack_block(tcb, 0);
+    }
+    if (tcb->sack_scoreboard_count > 0 && TCP_SEQ_LT(tcb->sack_scoreboard[0].start, tcb->send_unacknowledged)) {
+        tcb->sack_scoreboard[0].start = tcb->send_unacknowledged;
+    }
+}
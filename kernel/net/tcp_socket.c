@@ -7,8 +7,10 @@
 #include <kernel/net/destination_cache.h>
 #include <kernel/net/inet_socket.h>
 #include <kernel/net/interface.h>
+#include <kernel/net/packet.h>
 #include <kernel/net/socket_syscalls.h>
 #include <kernel/net/tcp.h>
+#include <kernel/net/tcp_congestion.h>
 #include <kernel/net/tcp_socket.h>
 #include <kernel/proc/task.h>
 #include <kernel/time/clock.h>
@@ -124,12 +126,24 @@ struct tcp_control_block *net_allocate_tcp_control_block(struct socket *socket)
     tcb->state = TCP_CLOSED;
     tcb->send_window = 1;
     tcb->send_unacknowledged = tcb->send_next = get_random_bytes() & 0xFFFFF; // Initial sequence number
-    tcb->recv_window = 16384;                                                 // Hard coded value
+    tcb->send_max = tcb->recover = tcb->send_next;
+    tcb->recv_window = MIN(TCP_BUFFER_SIZE, UINT16_MAX);                      // The window in a SYN is never scaled
     tcb->send_mss = TCP_DEFAULT_MSS;                                          // Default MSS (can be overridden by the MSS option)
     tcb->rto = (struct timespec) { .tv_sec = 1, .tv_nsec = 0 };               // RTO starts at 1 second.
     tcb->first_rtt_sample = true;
-    init_ring_buffer(&tcb->send_buffer, 16384);
-    init_ring_buffer(&tcb->recv_buffer, tcb->recv_window);
+
+    // Offer every option. The peer's SYN turns off the ones it doesn't support.
+    tcb->window_scale_enabled = tcb->sack_enabled = tcb->timestamps_enabled = true;
+    while ((TCP_BUFFER_SIZE >> tcb->recv_window_scale) > UINT16_MAX) {
+        tcb->recv_window_scale++;
+    }
+
+    tcb->congestion_ops = socket->tcp_congestion ? socket->tcp_congestion : tcp_default_congestion_ops();
+    tcp_congestion_init(tcb);
+
+    init_list(&tcb->out_of_order_queue);
+    init_list(&tcb->recv_queue);
+    init_ring_buffer(&tcb->send_buffer, TCP_BUFFER_SIZE);
     return tcb;
 }
 
@@ -150,8 +164,18 @@ void net_free_tcp_control_block(struct socket *socket) {
     if (tcb->destination) {
         net_drop_destination_cache_entry(tcb->destination);
     }
+    list_for_each_entry_safe(&tcb->out_of_order_queue, segment, struct tcp_out_of_order_segment, queue) {
+        list_remove(&segment->queue);
+        if (segment->packet) {
+            net_free_packet(segment->packet);
+        }
+        free(segment);
+    }
+    list_for_each_entry_safe(&tcb->recv_queue, packet, struct packet, queue) {
+        list_remove(&packet->queue);
+        net_free_packet(packet);
+    }
     kill_ring_buffer(&tcb->send_buffer);
-    kill_ring_buffer(&tcb->recv_buffer);
     free(tcb);
 }
 
@@ -159,10 +183,12 @@ static void tcp_do_retransmit(struct timer *timer, void *_socket) {
     struct socket *socket = _socket;
     struct tcp_control_block *tcb = socket->private_data;
 
-    // Retransmit the earliest segment not acknowledged by the sender.
-    size_t max_data_to_retransmit = tcb->send_mss;
-    size_t data_to_retransmit = MIN(tcb->send_next - tcb->send_unacknowledged, max_data_to_retransmit);
-    net_send_tcp_from_socket(socket, tcb->send_unacknowledged, tcb->send_unacknowledged + data_to_retransmit, false, true);
+    // Everything outstanding is presumed lost. Start again from a window of one segment at the earliest unacknowledged
+    // byte, and let the ACKs for it clock out the rest.
+    tcp_congestion_on_timeout(tcb);
+    size_t data_to_retransmit = MIN(tcb->send_max - tcb->send_unacknowledged, tcp_segment_size(tcb));
+    tcb->send_next = tcb->send_unacknowledged + data_to_retransmit;
+    net_send_tcp_from_socket(socket, tcb->send_unacknowledged, tcb->send_next, false, true);
 
     // Exponential back off by doubling the next timeout.
     tcb->rto = time_add(tcb->rto, tcb->rto);
@@ -192,25 +218,39 @@ static void tcp_setup_retransmission_timer(struct socket *socket) {
 
 bool tcp_update_recv_window(struct socket *socket) {
     struct tcp_control_block *tcb = socket->private_data;
-    uint16_t recv_buffer = ring_buffer_max(&tcb->recv_buffer);
-    uint16_t recv_user = ring_buffer_size(&tcb->recv_buffer);
+    uint32_t recv_space = MIN(tcp_recv_space(tcb), (uint32_t) UINT16_MAX << tcb->recv_window_scale);
 
-    if (recv_buffer - recv_user - tcb->recv_window >= MIN(recv_buffer / 2, tcb->send_mss)) {
-        tcb->recv_window = recv_buffer - recv_user;
+    if (recv_space >= tcb->recv_window && recv_space - tcb->recv_window >= MIN(TCP_BUFFER_SIZE / 2, tcb->send_mss)) {
+        tcb->recv_window = recv_space;
         return true;
     }
 
     return false;
 }
 
+// The most data which fits in a segment along with the options sent on every segment.
+uint32_t tcp_segment_size(struct tcp_control_block *tcb) {
+    return tcb->send_mss - (tcb->timestamps_enabled ? TCP_TIMESTAMP_OPTION_LENGTH : 0);
+}
+
+// The sequence number after everything queued to be sent, including any SYN or FIN.
+uint32_t tcp_sequence_end(struct tcp_control_block *tcb) {
+    return tcb->send_unacknowledged + tcb->pending_syn + ring_buffer_size(&tcb->send_buffer) + tcb->pending_fin;
+}
+
 int tcp_send_segments(struct socket *socket) {
     struct tcp_control_block *tcb = socket->private_data;
-    size_t segment_size = tcb->send_mss;
+    size_t segment_size = tcp_segment_size(tcb);
     bool push_data = true; // Assume all data should have the PSH bit set.
 
+    // During SACK based recovery, the holes the peer reported are filled before any new data is sent.
     int ret = 0;
+    if (tcb->in_recovery && tcb->sack_enabled) {
+        ret = tcp_retransmit_lost_segments(socket);
+    }
+
     while (ret == 0) {
-        ssize_t usable_window = (ssize_t) tcb->send_unacknowledged + (ssize_t) tcb->send_window - (ssize_t) tcb->send_next;
+        ssize_t usable_window = tcp_congestion_usable_window(tcb);
         if (usable_window < 0) {
             break;
         }
@@ -233,12 +273,17 @@ int tcp_send_segments(struct socket *socket) {
             break;
         }
 
+        // After a timeout, send_next goes back over data which was already sent once.
+        uint32_t sequence_start = tcb->send_next;
+        bool is_retransmission = TCP_SEQ_LT(sequence_start, tcb->send_max);
         tcb->send_next += data_to_send;
+        if (TCP_SEQ_GT(tcb->send_next, tcb->send_max)) {
+            tcb->send_max = tcb->send_next;
+        }
 #ifdef TCP_DEBUG
-        debug_log("Sending TCP segment: [ %u, %u, %u, %u ]\n", tcb->send_unacknowledged, tcb->send_next - data_to_send, tcb->send_next,
-                  usable_window);
+        debug_log("Sending TCP segment: [ %u, %u, %u, %u ]\n", tcb->send_unacknowledged, sequence_start, tcb->send_next, usable_window);
 #endif /* TCP_DEBUG */
-        ret = net_send_tcp_from_socket(socket, tcb->send_next - data_to_send, tcb->send_next, false, false);
+        ret = net_send_tcp_from_socket(socket, sequence_start, tcb->send_next, false, is_retransmission);
         tcp_setup_retransmission_timer(socket);
     }
 
@@ -292,7 +337,7 @@ static int net_tcp_close(struct socket *socket) {
     }
 
     // If there is data the application hasn't read, a RST segment should be sent to show that data has been lost.
-    if (!ring_buffer_empty(&tcb->recv_buffer)) {
+    if (tcb->recv_queue_length != 0) {
         net_send_tcp_from_socket(socket, tcb->send_next, tcb->send_next, true, false);
         net_free_tcp_control_block(socket);
         mutex_unlock(&socket->lock);
@@ -404,6 +449,16 @@ static int net_tcp_getsockopt(struct socket *socket, int level, int optname, voi
     switch (optname) {
         case TCP_NODELAY:
             return NET_WRITE_SOCKOPT(socket->tcp_nodelay, int, optval, optlen);
+        case TCP_CONGESTION: {
+            struct tcp_control_block *tcb = socket->private_data;
+            struct tcp_congestion_ops *ops = tcb ? tcb->congestion_ops : socket->tcp_congestion;
+            if (!ops) {
+                ops = tcp_default_congestion_ops();
+            }
+            *optlen = MIN(strlen(ops->name) + 1, *optlen);
+            memcpy(optval, ops->name, *optlen);
+            return 0;
+        }
         default:
             return -ENOPROTOOPT;
     }
@@ -420,6 +475,22 @@ static int net_tcp_setsockopt(struct socket *socket, int level, int optname, con
             socket->tcp_nodelay = !!value;
             return 0;
         }
+        case TCP_CONGESTION: {
+            char name[TCP_CONGESTION_NAME_MAX] = { 0 };
+            memcpy(name, optval, MIN(optlen, sizeof(name) - 1));
+            struct tcp_congestion_ops *ops = tcp_find_congestion_ops(name);
+            if (!ops) {
+                return -ENOENT;
+            }
+
+            socket->tcp_congestion = ops;
+            struct tcp_control_block *tcb = socket->private_data;
+            if (tcb) {
+                tcb->congestion_ops = ops;
+                tcb->cubic.epoch_valid = false;
+            }
+            return 0;
+        }
         default:
             return -ENOPROTOOPT;
     }
@@ -475,7 +546,7 @@ static ssize_t net_tcp_recvfrom(struct socket *socket, void *buffer, size_t len,
                 break;
         }
 
-        size_t amount_readable = ring_buffer_size(&tcb->recv_buffer);
+        size_t amount_readable = tcb->recv_queue_length;
         if (!amount_readable) {
             fs_detrigger_state(&socket->file_state, POLLIN);
             if (tcb->state == TCP_CLOSE_WAIT) {
@@ -498,13 +569,26 @@ static ssize_t net_tcp_recvfrom(struct socket *socket, void *buffer, size_t len,
             continue;
         }
 
+        // Copy straight out of the recieved packets, freeing each one once all of its data has been read.
         size_t amount_to_read = MIN(amount_readable, len - buffer_index);
-        ring_buffer_user_read(&tcb->recv_buffer, buffer + buffer_index, amount_to_read);
+        for (size_t read = 0; read < amount_to_read;) {
+            struct packet *packet = list_first_entry(&tcb->recv_queue, struct packet, queue);
+            size_t to_copy = MIN(packet->payload_length, amount_to_read - read);
+            memcpy(buffer + buffer_index + read, packet->payload, to_copy);
+            packet->payload += to_copy;
+            packet->payload_length -= to_copy;
+            read += to_copy;
+            if (packet->payload_length == 0) {
+                list_remove(&packet->queue);
+                net_free_packet(packet);
+            }
+        }
+        tcb->recv_queue_length -= amount_to_read;
         buffer_index += amount_to_read;
         if (tcp_update_recv_window(socket)) {
             net_send_tcp_from_socket(socket, tcb->send_next, tcb->send_next, false, false);
         }
-        fs_set_state_bit(&socket->file_state, POLLIN, !ring_buffer_empty(&tcb->send_buffer));
+        fs_set_state_bit(&socket->file_state, POLLIN, tcb->recv_queue_length != 0);
 
         if (flags & MSG_WAITALL) {
             continue;
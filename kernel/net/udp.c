@@ -46,7 +46,7 @@ int net_send_udp(struct socket *socket, struct network_interface *interface, str
     net_drop_destination_cache_entry(destination);
 
     struct packet_header *udp_header =
-        net_init_packet_header(packet, interface->link_layer_overhead + 1, PH_UDP, packet->inline_data, udp_length);
+        net_init_packet_header(packet, interface->link_layer_overhead + 1, PH_UDP, net_packet_inline_data(packet), udp_length);
     struct udp_packet *udp_packet = udp_header->raw_header;
     net_init_udp_packet(udp_packet, source_port, dest_port, len, buf);
 
@@ -87,7 +87,8 @@ void net_udp_recieve(struct packet *net_packet) {
         return;
     }
 
-    struct socket_data *data = net_inet_create_socket_data(ip_packet, packet->source_port, next_header->raw_header, next_header->length);
+    struct socket_data *data = net_inet_create_socket_data(net_packet, ip_packet, packet->source_port, next_header->raw_header,
+                                                            next_header->length);
     net_send_to_socket(socket, data);
 }
 
@@ -100,6 +101,7 @@ void net_init_udp_packet(struct udp_packet *packet, uint16_t source_port, uint16
 
     if (buf) {
         memcpy(packet->payload, buf, len);
+        net_packet_count_copy(len);
     }
 
     packet->checksum = 0;
@@ -284,6 +284,8 @@ static ssize_t net_unix_sendto(struct socket *socket, const void *buf, size_t le
 
     struct socket_data *socket_data = malloc(sizeof(struct socket_data) + len);
     memcpy(socket_data->data, buf, len);
+    socket_data->packet = NULL;
+    socket_data->payload = socket_data->data;
     socket_data->len = len;
 
     // FIXME: this seems very prone to data races when connections close
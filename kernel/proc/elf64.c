@@ -278,7 +278,7 @@ void elf64_map_heap(struct task *task, struct initial_process_info *info) {
     task_heap->end = task_heap->start;
     task_heap->vm_object = vm_create_anon_object(0);
     task_heap->vm_object_offset = 0;
-    task->process->process_memory = add_vm_region(task->process->process_memory, task_heap);
+    add_process_vm_region(task->process, task_heap);
 }
 
 struct stack_frame {
@@ -11,6 +11,7 @@
 #include <kernel/mem/vm_allocator.h>
 #include <kernel/proc/elf64.h>
 #include <kernel/proc/process.h>
+#include <kernel/proc/profile.h>
 #include <kernel/proc/task.h>
 #include <kernel/sched/task_sched.h>
 #include <kernel/time/clock.h>
@@ -159,10 +160,10 @@ int proc_execve(char *path, char **argv, char **envp) {
     wait_for_with_mutex(current, process->main_tid == current->tid && list_is_singular(&process->task_list), &process->one_task_left_queue,
                         &process->lock);
 
-    // Clear the profile buffer. This is means that code that sets up profiling need not worry about collecting data
+    // Clear the profile buffers. This means that code that sets up profiling need not worry about collecting data
     // before the execve() occurs. However, this would cause issues when trying to profile a process like /bin/sh, who
     // may have a legitimate reason to call execve().
-    process->profile_buffer_size = 0;
+    proc_reset_profile_buffers(process);
     mutex_unlock(&process->lock);
 
     char *program_name = prepend_argv != NULL ? argv[0] : strdup(argv[0]);
@@ -25,6 +25,7 @@ pid_t proc_fork(void) {
     init_spinlock(&child_process->user_mutex_lock);
     init_spinlock(&child_process->children_lock);
     init_spinlock(&child_process->parent_lock);
+    init_spinlock(&child_process->process_memory_lock);
     init_list(&child_process->task_list);
     init_list(&child_process->timer_list);
     init_spinlock(&child->sig_lock);
@@ -35,7 +36,7 @@ pid_t proc_fork(void) {
     proc_add_process(child_process);
     child->sched_state = RUNNING_INTERRUPTIBLE;
     child->kernel_task = false;
-    child_process->process_memory = clone_process_vm();
+    clone_process_vm(child_process);
     child_process->tty = parent->process->tty;
     list_append(&child_process->task_list, &child->process_list);
 
@@ -63,6 +64,9 @@ pid_t proc_fork(void) {
     child->process->start_time = time_read_clock(CLOCK_REALTIME);
     child->sig_pending = 0;
     child->sig_mask = parent->sig_mask;
+    child->sched_policy = parent->sched_policy;
+    child->sched_rt_priority = parent->sched_rt_priority;
+    child->sched_disallowed_processors = parent->sched_disallowed_processors;
     child_process->exe = bump_tnode(parent->process->exe);
     child_process->name = strdup(parent->process->name);
     memcpy(child_process->limits, parent->process->limits, sizeof(child_process->limits));
@@ -49,6 +49,10 @@ static void free_process_vm(struct process *process) {
         region = temp;
     }
     process->process_memory = NULL;
+    init_rb_tree(&process->process_memory_tree);
+    atomic_fetch_add(&process->process_memory_seq, 2);
+    process->free_area_cache = 0;
+    process->free_area_cache_hole_size = 0;
 
     struct user_mutex *user_mutex = process->used_user_mutexes;
     while (user_mutex != NULL) {
@@ -87,6 +91,11 @@ void proc_drop_process(struct process *process, struct task *task, bool free_pag
         mutex_lock(&process->lock);
         list_remove(&task->process_list);
 
+        // The task's samples can still be read, after which proc_read_profile() frees its buffer.
+        if (task->profile_buffer) {
+            task->profile_buffer->exited = true;
+        }
+
         // There's only one task left, notify anyone who cares (execve does).
         if (list_is_singular(&process->task_list)) {
             wake_up_all(&process->one_task_left_queue);
@@ -207,11 +216,10 @@ void proc_drop_process(struct process *process, struct task *task, bool free_pag
 
         free_process_name_info(process);
 
-        if (process->profile_buffer) {
-            vm_free_kernel_region(process->profile_buffer);
+        if (process->should_profile) {
             proc_maybe_stop_profile_timer();
         }
-        process->profile_buffer = NULL;
+        proc_free_profile_buffers(process);
 
 #ifdef PROC_REF_COUNT_DEBUG
         debug_log("Finished destroying process: [ %d ]\n", process->pid);
@@ -363,7 +371,7 @@ uintptr_t proc_allocate_user_stack(struct process *process, struct initial_proce
     task_stack->end = task_stack->start + 2 * 1024 * 1024;
     task_stack->vm_object = stack_object;
     task_stack->vm_object_offset = PAGE_SIZE;
-    process->process_memory = add_vm_region(process->process_memory, task_stack);
+    add_process_vm_region(process, task_stack);
 
     struct vm_region *guard_page = calloc(1, sizeof(struct vm_region));
     guard_page->flags = VM_PROT_NONE | VM_NO_EXEC;
@@ -372,7 +380,7 @@ uintptr_t proc_allocate_user_stack(struct process *process, struct initial_proce
     guard_page->end = guard_page->start + PAGE_SIZE;
     guard_page->vm_object = bump_vm_object(stack_object);
     guard_page->vm_object_offset = 0;
-    process->process_memory = add_vm_region(process->process_memory, guard_page);
+    add_process_vm_region(process, guard_page);
 
     info->guard_size = PAGE_SIZE;
     info->stack_size = 2 * 1024 * 1024;
@@ -1,5 +1,6 @@
 #include <errno.h>
 #include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/param.h>
 
@@ -11,11 +12,101 @@
 #include <kernel/proc/task.h>
 #include <kernel/sched/task_sched.h>
 
-// Must be called with process->profile_lock held.
-void proc_write_profile_buffer(struct process *process, const void *buffer, size_t sz) {
-    sz = MIN(sz, process->profile_buffer->end - process->profile_buffer->start - process->profile_buffer_size);
-    memcpy((void *) process->profile_buffer->start + process->profile_buffer_size, buffer, sz);
-    process->profile_buffer_size += sz;
+// Large enough for a few hundred milliseconds of samples at the maximum frequency, which gives the reader plenty of
+// time to drain the ring before samples are lost.
+#define PROFILE_TASK_BUFFER_SIZE       (256 * 1024)
+#define PROFILE_MEMORY_MAP_BUFFER_SIZE (64 * 1024)
+
+static struct profile_buffer *create_profile_buffer(size_t size, pid_t tid) {
+    struct profile_buffer *buffer = calloc(1, sizeof(struct profile_buffer));
+    if (!buffer) {
+        return NULL;
+    }
+
+    buffer->region = vm_allocate_kernel_region(size);
+    if (!buffer->region) {
+        free(buffer);
+        return NULL;
+    }
+
+    buffer->size = size;
+    buffer->tid = tid;
+    return buffer;
+}
+
+static void free_profile_buffer(struct profile_buffer *buffer) {
+    vm_free_kernel_region(buffer->region);
+    free(buffer);
+}
+
+static void profile_buffer_copy_in(struct profile_buffer *buffer, size_t index, const void *data, size_t size) {
+    uint8_t *base = (uint8_t *) buffer->region->start;
+    size_t offset = index & (buffer->size - 1);
+    size_t first = MIN(size, buffer->size - offset);
+    memcpy(base + offset, data, first);
+    memcpy(base, (const uint8_t *) data + first, size - first);
+}
+
+static void profile_buffer_copy_out(struct profile_buffer *buffer, size_t index, void *data, size_t size) {
+    const uint8_t *base = (const uint8_t *) buffer->region->start;
+    size_t offset = index & (buffer->size - 1);
+    size_t first = MIN(size, buffer->size - offset);
+    memcpy(data, base + offset, first);
+    memcpy((uint8_t *) data + first, base, size - first);
+}
+
+static bool profile_buffer_push(struct profile_buffer *buffer, const void *event, uint16_t size) {
+    size_t head = buffer->head;
+    size_t tail = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    if (buffer->size - (head - tail) < sizeof(size) + size) {
+        return false;
+    }
+
+    profile_buffer_copy_in(buffer, head, &size, sizeof(size));
+    profile_buffer_copy_in(buffer, head + sizeof(size), event, size);
+    atomic_store_explicit(&buffer->head, head + sizeof(size) + size, memory_order_release);
+    return true;
+}
+
+// Copies whole events into the output until it is full, and returns the number of bytes copied.
+static size_t profile_buffer_drain(struct profile_buffer *buffer, void *output, size_t output_size) {
+    size_t tail = buffer->tail;
+    size_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    size_t copied = 0;
+    while (tail != head) {
+        uint16_t size;
+        profile_buffer_copy_out(buffer, tail, &size, sizeof(size));
+        if (copied + size > output_size) {
+            break;
+        }
+
+        profile_buffer_copy_out(buffer, tail + sizeof(size), (uint8_t *) output + copied, size);
+        copied += size;
+        tail += sizeof(size) + size;
+    }
+    atomic_store_explicit(&buffer->tail, tail, memory_order_release);
+    return copied;
+}
+
+static bool profile_buffer_is_empty(struct profile_buffer *buffer) {
+    return buffer->tail == atomic_load_explicit(&buffer->head, memory_order_acquire);
+}
+
+// Must be called by the buffer's producer. A full buffer drops the event, and the number of dropped events is reported
+// once there is room again.
+void proc_write_profile_buffer(struct profile_buffer *buffer, const void *event, size_t size) {
+    if (buffer->lost) {
+        struct profile_event_lost lost = { .type = PEV_LOST, .tid = buffer->tid, .count = buffer->lost };
+        if (!profile_buffer_push(buffer, &lost, sizeof(lost))) {
+            buffer->lost++;
+            return;
+        }
+        buffer->lost = 0;
+    }
+
+    if (!profile_buffer_push(buffer, event, size)) {
+        buffer->lost++;
+    }
 }
 
 void proc_record_memory_map(struct process *process) {
@@ -24,6 +115,7 @@ void proc_record_memory_map(struct process *process) {
     struct profile_event_memory_map *pev = (void *) raw_buffer;
     pev->type = PEV_MEMORY_MAP;
     pev->count = 0;
+    pev->generation = ++process->profile_memory_map_generation;
 
     for (struct vm_region *region = process->process_memory; region && pev->count < PROFILE_MAX_MEMORY_MAP; region = region->next) {
         if (region->vm_object && region->vm_object->type == VM_INODE && !(region->flags & VM_NO_EXEC)) {
@@ -36,43 +128,118 @@ void proc_record_memory_map(struct process *process) {
         }
     }
 
-    proc_write_profile_buffer(process, raw_buffer, PEV_MEMORY_MAP_SIZE(pev));
+    if (process->profile_memory_map_buffer) {
+        proc_write_profile_buffer(process->profile_memory_map_buffer, raw_buffer, PEV_MEMORY_MAP_SIZE(pev));
+    }
     spin_unlock(&process->profile_buffer_lock);
 }
 
-static int num_profiling;
+// Must be called with the task's process lock held.
+int proc_add_profile_buffer(struct task *task) {
+    if (task->profile_buffer) {
+        return 0;
+    }
 
-static void on_hw_profile_tick(struct hw_timer_channel *channel, struct irq_context *context) {
-    (void) channel;
+    struct profile_buffer *buffer = create_profile_buffer(PROFILE_TASK_BUFFER_SIZE, task->tid);
+    if (!buffer) {
+        return -ENOMEM;
+    }
+
+    list_append(&task->process->profile_buffers, &buffer->list);
+    atomic_store(&task->profile_buffer, buffer);
+    return 0;
+}
+
+// Discards everything recorded so far. Must be called with the process lock held.
+void proc_reset_profile_buffers(struct process *process) {
+    if (!process->profile_memory_map_buffer) {
+        return;
+    }
 
+    spin_lock(&process->profile_buffer_lock);
+    struct profile_buffer *map_buffer = process->profile_memory_map_buffer;
+    atomic_store_explicit(&map_buffer->tail, atomic_load(&map_buffer->head), memory_order_release);
+    spin_unlock(&process->profile_buffer_lock);
+
+    list_for_each_entry(&process->profile_buffers, buffer, struct profile_buffer, list) {
+        atomic_store_explicit(&buffer->tail, atomic_load(&buffer->head), memory_order_release);
+    }
+}
+
+// Must only be called once none of the process's tasks can run.
+void proc_free_profile_buffers(struct process *process) {
+    if (!process->profile_memory_map_buffer) {
+        return;
+    }
+
+    list_for_each_entry_safe(&process->profile_buffers, buffer, struct profile_buffer, list) {
+        list_remove(&buffer->list);
+        free_profile_buffer(buffer);
+    }
+
+    free_profile_buffer(process->profile_memory_map_buffer);
+    process->profile_memory_map_buffer = NULL;
+}
+
+static void on_hw_profile_tick(struct hw_timer_channel *channel, struct irq_context *context) {
     struct task *current = get_current_task();
-    if (atomic_load(&current->process->should_profile)) {
-        // To seriously support profiling multiple threads, the buffer and lock should be per-thread and not per-process.
-        if (spin_trylock(&current->process->profile_buffer_lock)) {
-            // Make sure not to write into a stale buffer.
-            if (current->process->profile_buffer) {
-                proc_record_profile_stack(context->task_state);
-            }
-            spin_unlock(&current->process->profile_buffer_lock);
-        }
+    struct process *process = current->process;
+    if (!atomic_load(&process->should_profile) || !atomic_load(&current->profile_buffer)) {
+        return;
+    }
+
+    // The timer runs at the highest frequency any process asked for, so each task only takes a sample on its share of
+    // the ticks.
+    unsigned long timer_frequency = channel->frequency;
+    current->profile_ticks += process->profile_frequency;
+    if (current->profile_ticks < timer_frequency) {
+        return;
     }
+    current->profile_ticks -= timer_frequency;
+    if (current->profile_ticks >= timer_frequency) {
+        current->profile_ticks = 0;
+    }
+
+    // Interrupts are disabled here, so nothing else can be writing to this task's buffer.
+    proc_record_profile_stack(context->task_state);
 }
 
-void proc_maybe_start_profile_timer(void) {
-    if (atomic_fetch_add(&num_profiling, 1) == 0) {
-        struct hw_timer *timer = hw_profile_timer();
-        timer->ops->setup_interval_timer(timer, 0, 1000, IRQ_HANDLER_ALL_CPUS, on_hw_profile_tick);
+// Protects the profile timer's frequency. The timer is only slowed down again once nothing is being profiled.
+static mutex_t profile_timer_lock = MUTEX_INITIALIZER(profile_timer_lock);
+static int num_profiling;
+static unsigned int profile_timer_frequency;
+
+void proc_maybe_start_profile_timer(unsigned int frequency) {
+    mutex_lock(&profile_timer_lock);
+    struct hw_timer *timer = hw_profile_timer();
+    if (num_profiling++ == 0) {
+        profile_timer_frequency = frequency;
+        timer->ops->setup_interval_timer(timer, 0, frequency, IRQ_HANDLER_ALL_CPUS, on_hw_profile_tick);
+    } else if (frequency > profile_timer_frequency) {
+        profile_timer_frequency = frequency;
+        timer->ops->disable_channel(timer, 0);
+        timer->ops->setup_interval_timer(timer, 0, frequency, IRQ_HANDLER_ALL_CPUS, on_hw_profile_tick);
     }
+    mutex_unlock(&profile_timer_lock);
 }
 
 void proc_maybe_stop_profile_timer(void) {
-    if (atomic_fetch_sub(&num_profiling, 1) == 1) {
+    mutex_lock(&profile_timer_lock);
+    if (--num_profiling == 0) {
         struct hw_timer *timer = hw_profile_timer();
         timer->ops->disable_channel(timer, 0);
+        profile_timer_frequency = 0;
     }
+    mutex_unlock(&profile_timer_lock);
 }
 
-int proc_enable_profiling(pid_t pid) {
+int proc_enable_profiling(pid_t pid, const struct profile_options *options) {
+    unsigned int frequency = options && options->frequency ? options->frequency : PROFILE_DEFAULT_FREQUENCY;
+    unsigned int flags = options ? options->flags : 0;
+    if (frequency > PROFILE_MAX_FREQUENCY || (flags & ~PROFILE_KERNEL_STACKS)) {
+        return -EINVAL;
+    }
+
     struct process *process = find_by_pid(pid);
     if (!process) {
         return -ESRCH;
@@ -83,23 +250,38 @@ int proc_enable_profiling(pid_t pid) {
         return -EPERM;
     }
 
+    int ret = 0;
     mutex_lock(&process->lock);
     if (!process->should_profile) {
-        struct vm_region *profile_buffer = vm_allocate_kernel_region(PROFILE_BUFFER_MAX);
-        if (!profile_buffer) {
-            mutex_unlock(&process->lock);
-            return -ENOMEM;
+        // The buffers are kept until the process is destroyed, even once profiling is disabled, so that the sampling
+        // interrupt never has to synchronize with their release.
+        if (!process->profile_memory_map_buffer) {
+            init_list(&process->profile_buffers);
+            process->profile_memory_map_buffer = create_profile_buffer(PROFILE_MEMORY_MAP_BUFFER_SIZE, 0);
+            if (!process->profile_memory_map_buffer) {
+                ret = -ENOMEM;
+                goto done;
+            }
+        }
+
+        list_for_each_entry(&process->task_list, task, struct task, process_list) {
+            ret = proc_add_profile_buffer(task);
+            if (ret) {
+                goto done;
+            }
         }
 
-        process->profile_buffer = profile_buffer;
+        process->profile_frequency = frequency;
+        process->profile_flags = flags;
         atomic_store(&process->should_profile, 1);
         proc_record_memory_map(process);
 
-        proc_maybe_start_profile_timer();
+        proc_maybe_start_profile_timer(frequency);
     }
-    mutex_unlock(&process->lock);
 
-    return 0;
+done:
+    mutex_unlock(&process->lock);
+    return ret;
 }
 
 ssize_t proc_read_profile(pid_t pid, void *buffer, size_t size) {
@@ -113,20 +295,29 @@ ssize_t proc_read_profile(pid_t pid, void *buffer, size_t size) {
         return -EPERM;
     }
 
-    ssize_t ret = 0;
     mutex_lock(&process->lock);
-    int should_profile = process->should_profile;
-    if (!should_profile) {
-        ret = -EINVAL;
-    } else {
-        spin_lock(&process->profile_buffer_lock);
-        ret = MIN(size, process->profile_buffer_size);
-        memcpy(buffer, (void *) process->profile_buffer->start, ret);
-        process->profile_buffer_size = 0;
-        spin_unlock(&process->profile_buffer_lock);
+    if (!process->profile_memory_map_buffer) {
+        mutex_unlock(&process->lock);
+        return -EINVAL;
+    }
+
+    // Memory maps come first, so that the samples which refer to them are never read before they are.
+    size_t copied = profile_buffer_drain(process->profile_memory_map_buffer, buffer, size);
+    if (profile_buffer_is_empty(process->profile_memory_map_buffer)) {
+        list_for_each_entry_safe(&process->profile_buffers, task_buffer, struct profile_buffer, list) {
+            copied += profile_buffer_drain(task_buffer, (uint8_t *) buffer + copied, size - copied);
+            if (!profile_buffer_is_empty(task_buffer)) {
+                break;
+            }
+
+            if (task_buffer->exited) {
+                list_remove(&task_buffer->list);
+                free_profile_buffer(task_buffer);
+            }
+        }
     }
     mutex_unlock(&process->lock);
-    return ret;
+    return copied;
 }
 
 int proc_disable_profiling(pid_t pid) {
@@ -142,13 +333,7 @@ int proc_disable_profiling(pid_t pid) {
 
     mutex_lock(&process->lock);
     if (process->should_profile) {
-        spin_lock(&process->profile_buffer_lock);
-        vm_free_kernel_region(process->profile_buffer);
-        process->profile_buffer = NULL;
-        process->profile_buffer_size = 0;
         atomic_store(&process->should_profile, 0);
-        spin_unlock(&process->profile_buffer_lock);
-
         proc_maybe_stop_profile_timer();
     }
     mutex_unlock(&process->lock);
@@ -217,6 +217,7 @@ void init_kernel_process(void) {
     init_spinlock(&initial_kernel_process.user_mutex_lock);
     init_spinlock(&initial_kernel_process.children_lock);
     init_spinlock(&initial_kernel_process.parent_lock);
+    init_spinlock(&initial_kernel_process.process_memory_lock);
     init_wait_queue(&initial_kernel_process.one_task_left_queue);
     init_wait_queue(&initial_kernel_process.child_wait_queue);
     init_list(&initial_kernel_process.task_list);
@@ -274,6 +275,7 @@ struct task *load_kernel_task(uintptr_t entry, const char *name) {
     init_spinlock(&process->user_mutex_lock);
     init_spinlock(&process->children_lock);
     init_spinlock(&process->parent_lock);
+    init_spinlock(&process->process_memory_lock);
     init_wait_queue(&process->one_task_left_queue);
     init_wait_queue(&process->child_wait_queue);
     init_list(&process->task_list);
@@ -795,9 +797,7 @@ void task_do_sig(struct task *task, int signum) {
             dump_process_regions(task->process);
 #ifdef __x86_64__
             if (task == get_current_task() && atomic_load(&task->process->should_profile)) {
-                spin_lock(&task->process->profile_buffer_lock);
                 proc_record_profile_stack(NULL);
-                spin_unlock(&task->process->profile_buffer_lock);
             }
 #endif
             // Fall through
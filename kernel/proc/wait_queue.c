@@ -36,6 +36,11 @@ void __wake_up_n(struct wait_queue *queue, int n, const char *func) {
             break;
         }
 
+        if (wait_queue_entry->wake_function) {
+            wait_queue_entry->wake_function(wait_queue_entry);
+            continue;
+        }
+
         if (task_unblock(wait_queue_entry->task, 0)) {
             i++;
         }
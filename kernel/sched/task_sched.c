@@ -1,9 +1,12 @@
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 
 #include <kernel/hal/hw_timer.h>
 #include <kernel/hal/output.h>
@@ -23,6 +26,11 @@
 // #define SCHED_DEBUG
 // #define SIGNAL_DEBUG
 
+#define SCHED_RR_TIMESLICE_TICKS     10
+#define SCHED_BALANCE_INTERVAL_TICKS 4
+
+static void sched_balance(struct processor *processor);
+
 void init_task_sched() {
     // This only becomes needed after scheduling is enabled
     init_processes();
@@ -52,6 +60,12 @@ static void on_hw_sched_tick(struct hw_timer_channel *channel, struct irq_contex
         time_inc_clock(current->process->process_clock, channel->interval, current->in_kernel);
     }
 
+    struct processor *processor = get_current_processor();
+    if (++processor->sched_balance_ticks >= SCHED_BALANCE_INTERVAL_TICKS) {
+        processor->sched_balance_ticks = 0;
+        sched_balance(processor);
+    }
+
     sched_tick(context->task_state);
 }
 
@@ -62,44 +76,270 @@ void init_local_sched(struct processor *processor) {
     sched_timer->ops->setup_interval_timer(sched_timer, processor->id, 1000, 0, on_hw_sched_tick);
 }
 
+static bool sched_is_rt(struct task *task) {
+    return task->sched_policy == SCHED_FIFO || task->sched_policy == SCHED_RR;
+}
+
+static bool sched_allowed_on(struct task *task, struct processor *processor) {
+    return processor->id >= 64 || !(task->sched_disallowed_processors & (UINT64_C(1) << processor->id));
+}
+
+static bool sched_task_queued(struct task *task) {
+    return task->sched_list.next && !list_is_empty(&task->sched_list);
+}
+
+static int sched_timeslice(struct task *task) {
+    if (task->sched_policy == SCHED_FIFO) {
+        return INT_MAX;
+    }
+    if (task->sched_policy == SCHED_RR) {
+        return SCHED_RR_TIMESLICE_TICKS;
+    }
+
+    // The nice value scales the time slice, from 10 ticks at -20 down to 1 tick at 19, with 5 ticks by default.
+    return MAX((PROCESS_MAX_PRIORITY + 1 - task->process->priority) / 4, 1);
+}
+
+/* Must be called with the processor's sched lock held */
+static void sched_enqueue(struct processor *processor, struct task *task, bool at_front) {
+    if (sched_is_rt(task)) {
+        // Real-time tasks go behind the others of the same priority.
+        struct list_node *position = &processor->sched_rt_list;
+        list_for_each_entry(&processor->sched_rt_list, iter, struct task, sched_list) {
+            if (iter->sched_rt_priority < task->sched_rt_priority) {
+                position = &iter->sched_list;
+                break;
+            }
+        }
+        list_append(position, &task->sched_list);
+
+        struct task *current = processor->current_task;
+        if (!current || !sched_is_rt(current) || current->sched_rt_priority < task->sched_rt_priority) {
+            processor->sched_need_resched = true;
+        }
+    } else if (at_front) {
+        list_prepend(&processor->sched_list, &task->sched_list);
+    } else {
+        list_append(&processor->sched_list, &task->sched_list);
+    }
+    processor->sched_nr_running++;
+}
+
+/* Must be called with the processor's sched lock held */
+static void sched_dequeue(struct processor *processor, struct task *task) {
+    if (sched_task_queued(task)) {
+        list_remove(&task->sched_list);
+        processor->sched_nr_running--;
+    }
+}
+
+// Locks the sched lock of the processor the task belongs to, which can change until the lock is held.
+static struct processor *sched_lock_task_processor(struct task *task) {
+    struct processor *processor = task->active_processor;
+    while (processor) {
+        spin_lock_internal(&processor->sched_lock, __func__, false);
+        if (task->active_processor == processor) {
+            break;
+        }
+        spin_unlock(&processor->sched_lock);
+        processor = task->active_processor;
+    }
+    return processor;
+}
+
+// Two sched locks are always taken in processor id order, so that processors balancing against each other cannot
+// deadlock.
+static void sched_lock_pair(struct processor *a, struct processor *b) {
+    if (a->id > b->id) {
+        struct processor *temp = a;
+        a = b;
+        b = temp;
+    }
+    spin_lock_internal(&a->sched_lock, __func__, false);
+    spin_lock_internal(&b->sched_lock, __func__, false);
+}
+
+static void sched_unlock_pair(struct processor *a, struct processor *b) {
+    if (a->id > b->id) {
+        struct processor *temp = a;
+        a = b;
+        b = temp;
+    }
+    spin_unlock(&b->sched_lock);
+    spin_unlock(&a->sched_lock);
+}
+
+// A task can be moved as long as the processor it is on is not running it, and is not in the middle of switching to or
+// from it. Must be called with both sched locks held.
+static bool sched_can_migrate(struct processor *from, struct processor *to, struct task *task) {
+    return task != from->current_task && task != from->sched_prev_task && task != from->sched_next_task && sched_allowed_on(task, to);
+}
+
+static struct task *sched_find_task_to_migrate(struct processor *from, struct processor *to) {
+    list_for_each_entry(&from->sched_list, task, struct task, sched_list) {
+        if (sched_can_migrate(from, to, task)) {
+            return task;
+        }
+    }
+    list_for_each_entry(&from->sched_rt_list, task, struct task, sched_list) {
+        if (sched_can_migrate(from, to, task)) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static void sched_migrate_task(struct processor *from, struct processor *to, struct task *task) {
+#ifdef SCHED_DEBUG
+    debug_log("Migrating task: [ %d:%d, %d, %d ]\n", task->process->pid, task->tid, from->id, to->id);
+#endif /* SCHED_DEBUG */
+
+    sched_dequeue(from, task);
+    task->active_processor = to;
+    sched_enqueue(to, task, false);
+    to->sched_migrations++;
+
+    if (get_current_processor() != to && to->sched_idle) {
+        arch_send_ipi(to);
+    }
+}
+
+// Called by a processor with nothing to run, to take a waiting task from the busiest processor.
+static void sched_steal_task(struct processor *processor) {
+    struct processor *busiest = NULL;
+    for (struct processor *iter = get_processor_list(); iter; iter = iter->next) {
+        if (iter != processor && iter->enabled && iter->sched_nr_running >= 2 &&
+            (!busiest || iter->sched_nr_running > busiest->sched_nr_running)) {
+            busiest = iter;
+        }
+    }
+    if (!busiest) {
+        return;
+    }
+
+    sched_lock_pair(processor, busiest);
+    struct task *task = sched_find_task_to_migrate(busiest, processor);
+    if (task) {
+        sched_migrate_task(busiest, processor, task);
+    }
+    sched_unlock_pair(processor, busiest);
+}
+
+static bool sched_has_disallowed_tasks(struct processor *processor) {
+    bool ret = false;
+    spin_lock_internal(&processor->sched_lock, __func__, false);
+    list_for_each_entry(&processor->sched_list, task, struct task, sched_list) {
+        ret |= !sched_allowed_on(task, processor);
+    }
+    list_for_each_entry(&processor->sched_rt_list, task, struct task, sched_list) {
+        ret |= !sched_allowed_on(task, processor);
+    }
+
+    // The current task has to be switched out before it can be moved.
+    if (!sched_allowed_on(processor->current_task, processor)) {
+        processor->sched_need_resched = true;
+    }
+    spin_unlock(&processor->sched_lock);
+    return ret;
+}
+
+static void sched_push_disallowed_list(struct processor *processor, struct processor *target, struct list_node *list) {
+    list_for_each_entry_safe(list, task, struct task, sched_list) {
+        if (!sched_allowed_on(task, processor) && sched_can_migrate(processor, target, task)) {
+            sched_migrate_task(processor, target, task);
+        }
+    }
+}
+
+static void sched_push_disallowed_tasks(struct processor *processor) {
+    for (struct processor *target = get_processor_list(); target; target = target->next) {
+        if (target == processor || !target->enabled) {
+            continue;
+        }
+
+        sched_lock_pair(processor, target);
+        sched_push_disallowed_list(processor, target, &processor->sched_list);
+        sched_push_disallowed_list(processor, target, &processor->sched_rt_list);
+        sched_unlock_pair(processor, target);
+    }
+}
+
+// Called periodically by every processor from its timer tick. Tasks which are not allowed to run on the processor are
+// moved to one they can run on, and a task is moved to the least loaded processor if it has at least two fewer runnable
+// tasks. Idle processors also steal work themselves, see sched_steal_task().
+static void sched_balance(struct processor *processor) {
+    if (processor_count() <= 1) {
+        return;
+    }
+
+    if (sched_has_disallowed_tasks(processor)) {
+        sched_push_disallowed_tasks(processor);
+    }
+
+    struct processor *idlest = NULL;
+    for (struct processor *iter = get_processor_list(); iter; iter = iter->next) {
+        if (iter != processor && iter->enabled && (!idlest || iter->sched_nr_running < idlest->sched_nr_running)) {
+            idlest = iter;
+        }
+    }
+    if (!idlest || processor->sched_nr_running - idlest->sched_nr_running < 2) {
+        return;
+    }
+
+    sched_lock_pair(processor, idlest);
+    if (processor->sched_nr_running - idlest->sched_nr_running >= 2) {
+        struct task *task = sched_find_task_to_migrate(processor, idlest);
+        if (task) {
+            sched_migrate_task(processor, idlest, task);
+        }
+    }
+    sched_unlock_pair(processor, idlest);
+}
+
 static unsigned int next_cpu_id;
 
 void sched_add_task(struct task *task) {
-    int target_cpu_id = atomic_fetch_add(&next_cpu_id, 1) % processor_count();
+    // New tasks go to the least loaded processor they may run on. The search starts at a different processor each time,
+    // so that tasks created in a burst are spread out before the processors see them.
+    int count = processor_count();
+    int start = atomic_fetch_add(&next_cpu_id, 1) % count;
+
+    struct processor *target = NULL;
+    int target_order = 0;
+    for (struct processor *processor = get_processor_list(); processor; processor = processor->next) {
+        if (!processor->enabled || !sched_allowed_on(task, processor)) {
+            continue;
+        }
 
-    struct processor *processor = get_processor_list();
-    while (processor) {
-        if (processor->id == target_cpu_id) {
-            if (!processor->enabled) {
-                processor = get_processor_list();
-                while (processor) {
-                    if (processor->enabled) {
-                        schedule_task_on_processor(task, processor);
-                        return;
-                    }
-                    processor = processor->next;
-                }
+        int order = (processor->id - start + count) % count;
+        if (!target || processor->sched_nr_running < target->sched_nr_running ||
+            (processor->sched_nr_running == target->sched_nr_running && order < target_order)) {
+            target = processor;
+            target_order = order;
+        }
+    }
+
+    if (!target) {
+        // The task's affinity only names disabled processors, so run it anywhere instead.
+        for (struct processor *processor = get_processor_list(); processor; processor = processor->next) {
+            if (processor->enabled) {
+                target = processor;
                 break;
             }
-
-            schedule_task_on_processor(task, processor);
-            return;
         }
+    }
 
-        processor = processor->next;
+    if (!target) {
+        debug_log("All CPUS disabled?");
+        assert(false);
     }
 
-    debug_log("All CPUS disabled?");
-    assert(false);
+    schedule_task_on_processor(task, target);
 }
 
 void local_sched_add_task(struct processor *processor, struct task *task) {
     spin_lock_internal(&processor->sched_lock, __func__, false);
-    if (task == processor->current_task) {
-        list_append(&processor->sched_list, &task->sched_list);
-    } else {
-        list_prepend(&processor->sched_list, &task->sched_list);
-    }
+    sched_enqueue(processor, task, task != processor->current_task);
 
     if (get_current_processor() != processor && processor->sched_idle) {
         arch_send_ipi(processor);
@@ -108,33 +348,73 @@ void local_sched_add_task(struct processor *processor, struct task *task) {
 }
 
 void local_sched_remove_task(struct processor *processor, struct task *task) {
-    spin_lock_internal(&processor->sched_lock, __func__, false);
-    list_remove(&task->sched_list);
+    (void) processor;
+
+    // The task may have been migrated since the caller looked up its processor.
+    processor = sched_lock_task_processor(task);
+    sched_dequeue(processor, task);
     spin_unlock(&processor->sched_lock);
 }
 
 void sched_maybe_yield(void) {
     struct processor *processor = get_current_processor();
     struct task *current_task = get_current_task();
-    if (current_task->sched_ticks_remaining == 0 && processor->preemption_disabled_count == 0) {
+    if ((current_task->sched_ticks_remaining == 0 || processor->sched_need_resched) && processor->preemption_disabled_count == 0) {
         sched_run_next();
     }
 }
 
+static struct task *sched_first_allowed(struct processor *processor, struct list_node *list) {
+    list_for_each_entry(list, task, struct task, sched_list) {
+        if (sched_allowed_on(task, processor)) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/* Must be called with the processor's sched lock held */
+static struct task *sched_pick_next(struct processor *processor, struct task *prev) {
+    // Tasks which are not allowed to run here anymore are skipped, and left for sched_balance() to move.
+    struct task *to_run = sched_first_allowed(processor, &processor->sched_rt_list);
+    if (to_run) {
+        // A real-time task which used up its time slice or yielded goes behind the others of the same priority.
+        if (to_run == prev && prev->sched_ticks_remaining == 0) {
+            sched_dequeue(processor, prev);
+            sched_enqueue(processor, prev, false);
+            to_run = sched_first_allowed(processor, &processor->sched_rt_list);
+        }
+        return to_run;
+    }
+
+    to_run = sched_first_allowed(processor, &processor->sched_list);
+    if (to_run) {
+        list_remove(&to_run->sched_list);
+        list_append(&processor->sched_list, &to_run->sched_list);
+    }
+    return to_run;
+}
+
 /* Must be called from unpremptable context */
 void sched_run_next() {
     struct processor *processor = get_current_processor();
+    struct task *prev = processor->current_task;
 try_again:
+    if (processor->sched_nr_running == 0 && processor_count() > 1) {
+        sched_steal_task(processor);
+    }
+
     spin_lock_internal(&processor->sched_lock, __func__, false);
-    struct task *to_run = list_first_entry(&processor->sched_list, struct task, sched_list);
+    struct task *to_run = sched_pick_next(processor, prev);
     if (to_run) {
-        list_remove(&to_run->sched_list);
-        list_append(&processor->sched_list, &to_run->sched_list);
         processor->sched_idle = false;
     } else {
         to_run = processor->idle_task;
         processor->sched_idle = true;
     }
+    processor->sched_prev_task = prev;
+    processor->sched_next_task = to_run;
+    processor->sched_need_resched = false;
     spin_unlock(&processor->sched_lock);
 
 #ifdef SCHED_DEBUG
@@ -143,7 +423,7 @@ try_again:
     }
 #endif /* SCHED_DEBUG */
 
-    to_run->sched_ticks_remaining = 5;
+    to_run->sched_ticks_remaining = sched_timeslice(to_run);
 
     assert(to_run->sched_state != WAITING && to_run->sched_state != STOPPED && to_run->sched_state != EXITING);
     int sig;
@@ -397,6 +677,136 @@ void exit_process(struct process *process, struct task *exclude) {
     }
 }
 
+static struct process *sched_find_process(pid_t pid) {
+    return pid ? find_by_pid(pid) : get_current_task()->process;
+}
+
+static bool sched_may_change(struct process *process) {
+    struct process *current = get_current_task()->process;
+    return current->euid == 0 || current->euid == process->euid;
+}
+
+static uint64_t sched_enabled_processors(void) {
+    uint64_t mask = 0;
+    for (struct processor *processor = get_processor_list(); processor; processor = processor->next) {
+        if (processor->enabled && processor->id < 64) {
+            mask |= UINT64_C(1) << processor->id;
+        }
+    }
+    return mask;
+}
+
+// Tasks which are running somewhere they are no longer allowed to are moved by sched_balance().
+int sched_set_affinity(pid_t pid, uint64_t allowed_processors) {
+    if (!(allowed_processors & sched_enabled_processors())) {
+        return -EINVAL;
+    }
+
+    struct process *process = sched_find_process(pid);
+    if (!process) {
+        return -ESRCH;
+    }
+    if (!sched_may_change(process)) {
+        return -EPERM;
+    }
+
+    mutex_lock(&process->lock);
+    list_for_each_entry(&process->task_list, task, struct task, process_list) {
+        task->sched_disallowed_processors = ~allowed_processors;
+    }
+    mutex_unlock(&process->lock);
+    return 0;
+}
+
+int sched_get_affinity(pid_t pid, uint64_t *allowed_processors) {
+    struct process *process = sched_find_process(pid);
+    if (!process) {
+        return -ESRCH;
+    }
+
+    mutex_lock(&process->lock);
+    struct task *task = list_first_entry(&process->task_list, struct task, process_list);
+    uint64_t disallowed = task ? task->sched_disallowed_processors : 0;
+    mutex_unlock(&process->lock);
+
+    uint64_t all = processor_count() >= 64 ? UINT64_MAX : (UINT64_C(1) << processor_count()) - 1;
+    *allowed_processors = ~disallowed & all;
+    return 0;
+}
+
+int sched_set_scheduler(pid_t pid, int policy, int priority) {
+    if (policy == SCHED_OTHER) {
+        if (priority != 0) {
+            return -EINVAL;
+        }
+    } else if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        if (priority < 1 || priority > 99) {
+            return -EINVAL;
+        }
+    } else {
+        return -EINVAL;
+    }
+
+    struct process *process = sched_find_process(pid);
+    if (!process) {
+        return -ESRCH;
+    }
+    if (!sched_may_change(process) || (policy != SCHED_OTHER && get_current_task()->process->euid != 0)) {
+        return -EPERM;
+    }
+
+    mutex_lock(&process->lock);
+    list_for_each_entry(&process->task_list, task, struct task, process_list) {
+        // Runnable tasks are queued again, since real-time tasks are kept in a separate list.
+        struct processor *processor = sched_lock_task_processor(task);
+        bool queued = processor && sched_task_queued(task);
+        if (queued) {
+            sched_dequeue(processor, task);
+        }
+
+        task->sched_policy = policy;
+        task->sched_rt_priority = priority;
+
+        if (queued) {
+            sched_enqueue(processor, task, false);
+        }
+        if (processor) {
+            if (task == processor->current_task) {
+                processor->sched_need_resched = true;
+            }
+            spin_unlock(&processor->sched_lock);
+        }
+    }
+    mutex_unlock(&process->lock);
+    return 0;
+}
+
+int sched_get_scheduler(pid_t pid) {
+    struct process *process = sched_find_process(pid);
+    if (!process) {
+        return -ESRCH;
+    }
+
+    mutex_lock(&process->lock);
+    struct task *task = list_first_entry(&process->task_list, struct task, process_list);
+    int policy = task ? task->sched_policy : SCHED_OTHER;
+    mutex_unlock(&process->lock);
+    return policy;
+}
+
+int sched_get_priority(pid_t pid) {
+    struct process *process = sched_find_process(pid);
+    if (!process) {
+        return -ESRCH;
+    }
+
+    mutex_lock(&process->lock);
+    struct task *task = list_first_entry(&process->task_list, struct task, process_list);
+    int priority = task ? task->sched_rt_priority : 0;
+    mutex_unlock(&process->lock);
+    return priority;
+}
+
 uint64_t idle_ticks;
 uint64_t user_ticks;
 uint64_t kernel_ticks;
@@ -0,0 +1,242 @@
+#include <stddef.h>
+
+#include <kernel/util/rb_tree.h>
+
+static void rb_replace_child(struct rb_tree *tree, struct rb_node *parent, struct rb_node *old, struct rb_node *new) {
+    if (!parent) {
+        tree->root = new;
+    } else if (parent->left == old) {
+        parent->left = new;
+    } else {
+        parent->right = new;
+    }
+}
+
+static void rb_rotate_left(struct rb_tree *tree, struct rb_node *node) {
+    struct rb_node *right = node->right;
+    node->right = right->left;
+    if (right->left) {
+        right->left->parent = node;
+    }
+    right->parent = node->parent;
+    rb_replace_child(tree, node->parent, node, right);
+    right->left = node;
+    node->parent = right;
+}
+
+static void rb_rotate_right(struct rb_tree *tree, struct rb_node *node) {
+    struct rb_node *left = node->left;
+    node->left = left->right;
+    if (left->right) {
+        left->right->parent = node;
+    }
+    left->parent = node->parent;
+    rb_replace_child(tree, node->parent, node, left);
+    left->right = node;
+    node->parent = left;
+}
+
+static bool rb_is_red(struct rb_node *node) {
+    return node && node->red;
+}
+
+void rb_insert_color(struct rb_tree *tree, struct rb_node *node) {
+    struct rb_node *parent;
+    while ((parent = node->parent) && parent->red) {
+        // The parent is red, so it is not the root and the grandparent exists.
+        struct rb_node *grandparent = parent->parent;
+        if (parent == grandparent->left) {
+            struct rb_node *uncle = grandparent->right;
+            if (rb_is_red(uncle)) {
+                parent->red = uncle->red = false;
+                grandparent->red = true;
+                node = grandparent;
+                continue;
+            }
+
+            if (node == parent->right) {
+                rb_rotate_left(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            grandparent->red = true;
+            rb_rotate_right(tree, grandparent);
+        } else {
+            struct rb_node *uncle = grandparent->left;
+            if (rb_is_red(uncle)) {
+                parent->red = uncle->red = false;
+                grandparent->red = true;
+                node = grandparent;
+                continue;
+            }
+
+            if (node == parent->left) {
+                rb_rotate_right(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            grandparent->red = true;
+            rb_rotate_left(tree, grandparent);
+        }
+    }
+    tree->root->red = false;
+}
+
+// Restores the black height after a black node was removed from below parent, on the side where node now is. Node may
+// be NULL, which is why the parent is passed separately.
+static void rb_erase_color(struct rb_tree *tree, struct rb_node *node, struct rb_node *parent) {
+    while (node != tree->root && !rb_is_red(node)) {
+        if (node == parent->left) {
+            struct rb_node *sibling = parent->right;
+            if (sibling->red) {
+                sibling->red = false;
+                parent->red = true;
+                rb_rotate_left(tree, parent);
+                sibling = parent->right;
+            }
+
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right)) {
+                sibling->red = true;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+
+            if (!rb_is_red(sibling->right)) {
+                sibling->left->red = false;
+                sibling->red = true;
+                rb_rotate_right(tree, sibling);
+                sibling = parent->right;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->right->red = false;
+            rb_rotate_left(tree, parent);
+        } else {
+            struct rb_node *sibling = parent->left;
+            if (sibling->red) {
+                sibling->red = false;
+                parent->red = true;
+                rb_rotate_right(tree, parent);
+                sibling = parent->left;
+            }
+
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right)) {
+                sibling->red = true;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+
+            if (!rb_is_red(sibling->left)) {
+                sibling->right->red = false;
+                sibling->red = true;
+                rb_rotate_left(tree, sibling);
+                sibling = parent->left;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->left->red = false;
+            rb_rotate_right(tree, parent);
+        }
+        node = tree->root;
+    }
+
+    if (node) {
+        node->red = false;
+    }
+}
+
+void rb_erase(struct rb_tree *tree, struct rb_node *node) {
+    struct rb_node *child;
+    struct rb_node *parent;
+    bool removed_red;
+
+    if (!node->left || !node->right) {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        removed_red = node->red;
+        if (child) {
+            child->parent = parent;
+        }
+        rb_replace_child(tree, parent, node, child);
+    } else {
+        // Move the successor, which has no left child, into the place of the node.
+        struct rb_node *successor = node->right;
+        while (successor->left) {
+            successor = successor->left;
+        }
+
+        child = successor->right;
+        removed_red = successor->red;
+        if (successor->parent == node) {
+            parent = successor;
+        } else {
+            parent = successor->parent;
+            parent->left = child;
+            if (child) {
+                child->parent = parent;
+            }
+            successor->right = node->right;
+            node->right->parent = successor;
+        }
+
+        successor->left = node->left;
+        node->left->parent = successor;
+        successor->parent = node->parent;
+        successor->red = node->red;
+        rb_replace_child(tree, node->parent, node, successor);
+    }
+
+    if (!removed_red) {
+        rb_erase_color(tree, child, parent);
+    }
+}
+
+struct rb_node *rb_first(struct rb_tree *tree) {
+    struct rb_node *node = tree->root;
+    while (node && node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+struct rb_node *rb_last(struct rb_tree *tree) {
+    struct rb_node *node = tree->root;
+    while (node && node->right) {
+        node = node->right;
+    }
+    return node;
+}
+
+struct rb_node *rb_next(struct rb_node *node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return node;
+    }
+
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+struct rb_node *rb_prev(struct rb_node *node) {
+    if (node->left) {
+        node = node->left;
+        while (node->right) {
+            node = node->right;
+        }
+        return node;
+    }
+
+    while (node->parent && node == node->parent->left) {
+        node = node->parent;
+    }
+    return node->parent;
+}
@@ -0,0 +1,55 @@
+#include <bits/cpu_features.h>
+#include <cpuid.h>
+#include <stdint.h>
+
+#define CPUID_ECX_OSXSAVE (1U << 27)
+#define CPUID_ECX_AVX     (1U << 28)
+#define CPUID_EDX_SSE2    (1U << 26)
+#define CPUID_EBX_AVX2    (1U << 5)
+
+#define XCR0_SSE_STATE (1U << 1)
+#define XCR0_AVX_STATE (1U << 2)
+
+// Marks the cached value as initialized, since a CPU may legitimately support none of the features.
+#define CPU_FEATURES_DETECTED (1U << 31)
+
+static unsigned int detect_cpu_features(void) {
+    unsigned int features = 0;
+
+    uint32_t a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) {
+        return features;
+    }
+
+    if (d & CPUID_EDX_SSE2) {
+        features |= __CPU_FEATURE_SSE2;
+    }
+
+    // AVX registers are only usable if the kernel saves their state on context switches,
+    // which is reported through XCR0.
+    if (!(c & CPUID_ECX_OSXSAVE) || !(c & CPUID_ECX_AVX)) {
+        return features;
+    }
+
+    uint32_t xcr0_low, xcr0_high;
+    asm volatile("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+    if ((xcr0_low & (XCR0_SSE_STATE | XCR0_AVX_STATE)) != (XCR0_SSE_STATE | XCR0_AVX_STATE)) {
+        return features;
+    }
+
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & CPUID_EBX_AVX2)) {
+        features |= __CPU_FEATURE_AVX2;
+    }
+    return features;
+}
+
+unsigned int __cpu_features(void) {
+    static unsigned int cached_features;
+
+    unsigned int features = __atomic_load_n(&cached_features, __ATOMIC_RELAXED);
+    if (!features) {
+        features = detect_cpu_features() | CPU_FEATURES_DETECTED;
+        __atomic_store_n(&cached_features, features, __ATOMIC_RELAXED);
+    }
+    return features;
+}
@@ -7,7 +7,7 @@ int fcntl(int fd, int command, ...) {
     int ret;
     va_list args;
     va_start(args, command);
-    int arg = command == F_GETFD || command == F_GETFL ? 0 : va_arg(args, int);
+    int arg = command == F_GETFD || command == F_GETFL || command == F_GETPIPE_SZ ? 0 : va_arg(args, int);
     ret = (int) syscall(SYS_fcntl, fd, command, arg);
     va_end(args);
     __SYSCALL_TO_ERRNO(ret);
@@ -0,0 +1,8 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags) {
+    ssize_t ret = (ssize_t) syscall(SYS_splice, fd_in, off_in, fd_out, off_out, len, flags);
+    __SYSCALL_TO_ERRNO(ret);
+}
@@ -0,0 +1,8 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned int flags) {
+    ssize_t ret = (ssize_t) syscall(SYS_tee, fd_in, fd_out, len, flags);
+    __SYSCALL_TO_ERRNO(ret);
+}
@@ -0,0 +1,26 @@
+#ifndef _BITS_CPU_FEATURES_H
+#define _BITS_CPU_FEATURES_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+// The kernel is built without SSE, so libk always uses the portable implementations. So does the
+// dynamic loader, which is also built without SSE, runs before it has relocated itself, and doesn't
+// link against libc's __cpu_features().
+#if !defined(__is_libk) && !defined(__is_kernel) && !defined(__is_loader) && (defined(__x86_64__) || defined(__i386__))
+#define __HAVE_CPU_DISPATCH 1
+#endif /* !__is_libk && !__is_kernel && !__is_loader && (__x86_64__ || __i386__) */
+
+#define __CPU_FEATURE_SSE2 (1U << 0)
+#define __CPU_FEATURE_AVX2 (1U << 1)
+
+#ifdef __HAVE_CPU_DISPATCH
+unsigned int __cpu_features(void);
+#endif /* __HAVE_CPU_DISPATCH */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _BITS_CPU_FEATURES_H */
@@ -16,6 +16,8 @@
 #define F_SETLKW        9
 #define F_GETOWN        10
 #define F_SETOWN        11
+#define F_GETPIPE_SZ    12
+#define F_SETPIPE_SZ    13
 
 #define FD_CLOEXEC 1
 
@@ -48,6 +50,11 @@
 
 #define AT_FDCWD -1
 
+#define SPLICE_F_MOVE     1
+#define SPLICE_F_NONBLOCK 2
+#define SPLICE_F_MORE     4
+#define SPLICE_F_GIFT     8
+
 #define AT_EACCESS          1
 #define AT_SYMLINK_NOFOLLOW 2
 #define AT_SYMLINK_FOLLOW   4
@@ -70,6 +77,8 @@ int open(const char *pathname, int flags, ...);
 int openat(int dirfd, const char *pathname, int flags, ...);
 int fcntl(int fd, int cmd, ...);
 int creat(const char *pathname, mode_t mode);
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags);
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned int flags);
 
 #ifdef __cplusplus
 }
@@ -1,6 +1,7 @@
 #ifndef _NETINET_TCP_H
 #define _NETINET_TCP_H 1
 
-#define TCP_NODELAY 1
+#define TCP_NODELAY    1
+#define TCP_CONGESTION 13
 
 #endif /* _NETINET_TCP_H */
@@ -2,6 +2,8 @@
 #define _SCHED_H 1
 
 #include <bits/__sched_param.h>
+#include <bits/pid_t.h>
+#include <bits/size_t.h>
 #include <time.h>
 
 // aligned this way for the pthread_attr_t structure
@@ -11,6 +13,19 @@
 #define SCHED_OTHER    0
 #define __SCHED_MASK   12
 
+#define CPU_SETSIZE 64
+
+typedef struct {
+    unsigned long __bits[CPU_SETSIZE / (8 * sizeof(unsigned long))];
+} cpu_set_t;
+
+#define __CPU_BITS            (8 * sizeof(unsigned long))
+#define CPU_ZERO(set)         __builtin_memset((set), 0, sizeof(cpu_set_t))
+#define CPU_SET(cpu, set)     ((set)->__bits[(cpu) / __CPU_BITS] |= (1UL << ((cpu) % __CPU_BITS)))
+#define CPU_CLR(cpu, set)     ((set)->__bits[(cpu) / __CPU_BITS] &= ~(1UL << ((cpu) % __CPU_BITS)))
+#define CPU_ISSET(cpu, set)   (!!((set)->__bits[(cpu) / __CPU_BITS] & (1UL << ((cpu) % __CPU_BITS))))
+#define CPU_COUNT(set)        __cpu_count(sizeof(cpu_set_t), (set))
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -22,6 +37,16 @@ extern "C" {
 
 #endif /* __sched_param_defined */
 
+int __cpu_count(size_t size, const cpu_set_t *set);
+
+int sched_get_priority_max(int policy);
+int sched_get_priority_min(int policy);
+int sched_getaffinity(pid_t pid, size_t size, cpu_set_t *set);
+int sched_getparam(pid_t pid, struct sched_param *param);
+int sched_getscheduler(pid_t pid);
+int sched_setaffinity(pid_t pid, size_t size, const cpu_set_t *set);
+int sched_setparam(pid_t pid, const struct sched_param *param);
+int sched_setscheduler(pid_t pid, int policy, const struct sched_param *param);
 int sched_yield(void);
 
 #ifdef __cplusplus
@@ -106,6 +106,8 @@ int posix_memalign(void **memptr, size_t alignment, size_t size);
 
 #ifdef __libc_internal
 void init_env();
+void __malloc_enable_thread_cache(void);
+void __malloc_thread_exit(void);
 #endif /* __libc_internal */
 
 #ifdef __cplusplus
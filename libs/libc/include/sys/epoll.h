@@ -0,0 +1,53 @@
+#ifndef _SYS_EPOLL_H
+#define _SYS_EPOLL_H 1
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+
+#define EPOLL_CLOEXEC O_CLOEXEC
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLLIN      POLLIN
+#define EPOLLRDNORM  POLLRDNORM
+#define EPOLLRDBAND  POLLRDBAND
+#define EPOLLPRI     POLLPRI
+#define EPOLLOUT     POLLOUT
+#define EPOLLWRNORM  POLLWRNORM
+#define EPOLLWRBAND  POLLWRBAND
+#define EPOLLERR     POLLERR
+#define EPOLLHUP     POLLHUP
+#define EPOLLONESHOT (1U << 30)
+#define EPOLLET      (1U << 31)
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef union epoll_data {
+    void *ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event {
+    uint32_t events;
+    epoll_data_t data;
+};
+
+int epoll_create(int size);
+int epoll_create1(int flags);
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout);
+int epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout, const sigset_t *sigmask);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _SYS_EPOLL_H */
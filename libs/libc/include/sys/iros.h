@@ -15,9 +15,13 @@
 
 #define ROBUST_MUTEX_IS_VALID_IF_VALUE 1
 
-#define PROFILE_BUFFER_MAX       1024 * 4096
-#define PROFILE_MAX_STACK_FRAMES 35
-#define PROFILE_MAX_MEMORY_MAP   30
+#define PROFILE_BUFFER_MAX        1024 * 4096
+#define PROFILE_MAX_STACK_FRAMES  64
+#define PROFILE_MAX_MEMORY_MAP    30
+#define PROFILE_DEFAULT_FREQUENCY 1000
+#define PROFILE_MAX_FREQUENCY     8192
+
+#define PROFILE_KERNEL_STACKS 1
 
 #ifdef __cplusplus
 extern "C" {
@@ -59,11 +63,20 @@ struct initial_process_info {
     int num_processors;
 };
 
-enum profile_event_type { PEV_STACK_TRACE, PEV_MEMORY_MAP };
+struct profile_options {
+    // Samples per second, or 0 for PROFILE_DEFAULT_FREQUENCY.
+    unsigned int frequency;
+    unsigned int flags;
+};
+
+enum profile_event_type { PEV_STACK_TRACE, PEV_MEMORY_MAP, PEV_LOST };
 
 struct profile_event_stack_trace {
     uint8_t type;
     uint8_t count;
+    pid_t tid;
+    // The generation of the memory map the frames should be resolved against.
+    uint32_t memory_map;
     uintptr_t frames[0];
 } __attribute__((packed));
 
@@ -79,9 +92,17 @@ struct profile_event_memory_object {
 struct profile_event_memory_map {
     uint8_t type;
     uint8_t count;
+    uint32_t generation;
     struct profile_event_memory_object mem[0];
 } __attribute__((packed));
 
+// Written in place of samples that were dropped because a buffer was full.
+struct profile_event_lost {
+    uint8_t type;
+    pid_t tid;
+    uint32_t count;
+} __attribute__((packed));
+
 struct profile_event {
     uint8_t type;
     uint8_t data[0];
@@ -96,7 +117,7 @@ int os_mutex(unsigned int *__protected, int op, int expected, int to_place, int
 int set_thread_self_pointer(void *p, struct __locked_robust_mutex_node **list_head);
 int tgkill(int tgid, int tid, int signum);
 int getcpuclockid(int tgid, int tid, clockid_t *clock_id);
-int enable_profiling(pid_t pid);
+int enable_profiling(pid_t pid, const struct profile_options *options);
 ssize_t read_profile(pid_t pid, void *buffer, size_t size);
 int disable_profiling(pid_t pid);
 int poweroff(void);
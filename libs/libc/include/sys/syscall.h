@@ -102,7 +102,7 @@
     __ENUMERATE_SYSCALL(setgroups, 2)               \
     __ENUMERATE_SYSCALL(mknod, 3)                   \
     __ENUMERATE_SYSCALL(ppoll, 4)                   \
-    __ENUMERATE_SYSCALL(enable_profiling, 1)        \
+    __ENUMERATE_SYSCALL(enable_profiling, 2)        \
     __ENUMERATE_SYSCALL(read_profile, 3)            \
     __ENUMERATE_SYSCALL(disable_profiling, 1)       \
     __ENUMERATE_SYSCALL(getrlimit, 2)               \
@@ -117,7 +117,17 @@
     __ENUMERATE_SYSCALL(setitimer, 3)               \
     __ENUMERATE_SYSCALL(mount, 5)                   \
     __ENUMERATE_SYSCALL(umount, 1)                  \
-    __ENUMERATE_SYSCALL(poweroff, 0)
+    __ENUMERATE_SYSCALL(poweroff, 0)                \
+    __ENUMERATE_SYSCALL(sched_setaffinity, 3)       \
+    __ENUMERATE_SYSCALL(sched_getaffinity, 3)       \
+    __ENUMERATE_SYSCALL(sched_setscheduler, 3)      \
+    __ENUMERATE_SYSCALL(sched_getscheduler, 1)      \
+    __ENUMERATE_SYSCALL(sched_getparam, 1)          \
+    __ENUMERATE_SYSCALL(splice, 6)                  \
+    __ENUMERATE_SYSCALL(tee, 4)                     \
+    __ENUMERATE_SYSCALL(epoll_create, 1)            \
+    __ENUMERATE_SYSCALL(epoll_ctl, 4)               \
+    __ENUMERATE_SYSCALL(epoll_pwait, 5)
 
 #ifdef __ASSEMBLER__
 #define SYS_SIGRETURN 27
@@ -46,6 +46,7 @@ void init_threads(void) {
     __threads->id = __initial_process_info->main_tid;
 
     set_thread_self_pointer(__threads, &__threads->locked_robust_mutex_node_list_head);
+    __malloc_enable_thread_cache();
 
     sigset_t set = { 0 };
     set |= (UINT64_C(1) << (__PTHREAD_CANCEL_SIGNAL - UINT64_C(1)));
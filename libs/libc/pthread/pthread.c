@@ -259,6 +259,10 @@ __attribute__((__noreturn__)) static void pthread_exit_after_cleanup(void *value
 
     pthread_specific_run_destructors(thread);
 
+    // Return this thread's cached free objects to the shared heap, since the cache is lost once
+    // the thread exits.
+    __malloc_thread_exit();
+
     // NOTE: calling pthread_exit while a threads owns a robust mutex might be UB,
     //       but walking the list ourselves and saying the owner died makes things
     //       much simpler, since this way we don't have to rely on the kernel to do
@@ -8,14 +8,14 @@
 #include <regex.h>
 #endif /* USERLAND_NATIVE */
 
-#include "regex_graph.h"
+#include "regex_engine.h"
 #include "regex_lexer.h"
 #include "regex_parser.h"
 #include "regex_value.h"
 
 extern "C" int regcomp(regex_t* __restrict regex, const char* __restrict str, int cflags) {
     int error = 0;
-    RegexGraph* compiled = nullptr;
+    RegexEngine* compiled = nullptr;
     RegexLexer lexer(str, cflags);
     RegexParser parser(lexer, cflags);
 
@@ -34,15 +34,15 @@ extern "C" int regcomp(regex_t* __restrict regex, const char* __restrict str, in
         goto regcomp_error;
     }
 
-    compiled = static_cast<RegexGraph*>(malloc(sizeof(RegexGraph)));
+    compiled = static_cast<RegexEngine*>(malloc(sizeof(RegexEngine)));
     if (!compiled) {
         error = REG_ESPACE;
         goto regcomp_error;
     }
 
-    new (compiled) RegexGraph(parser.result().as<ParsedRegex>(), cflags, lexer.num_sub_expressions());
-    if (!compiled->compile()) {
-        error = compiled->error_code();
+    new (compiled) RegexEngine(cflags, lexer.num_sub_expressions());
+    error = compiled->compile(parser.result().as<ParsedRegex>());
+    if (error != 0) {
         goto regcomp_error_after_allocation;
     }
 
@@ -51,7 +51,7 @@ extern "C" int regcomp(regex_t* __restrict regex, const char* __restrict str, in
     return 0;
 
 regcomp_error_after_allocation:
-    compiled->~RegexGraph();
+    compiled->~RegexEngine();
     free(compiled);
 
 regcomp_error:
@@ -0,0 +1,219 @@
+#include <ctype.h>
+#include <liim/scope_guard.h>
+
+#include "regex_dfa.h"
+
+static unsigned int hash_state(const Vector<int>& pcs, RegexContext context) {
+    unsigned int hash = 2166136261U ^ static_cast<unsigned int>(context);
+    for (int i = 0; i < pcs.size(); i++) {
+        hash = (hash ^ pcs[i]) * 16777619U;
+    }
+    return hash;
+}
+
+RegexDFA::Result RegexDFA::search(const char* str, size_t start, int eflags) {
+    // Concurrent calls to regexec() on the same regex are allowed, but the states are shared, so only one thread at a
+    // time may build them.
+    if (__atomic_test_and_set(&m_busy, __ATOMIC_ACQUIRE)) {
+        return Result::GaveUp;
+    }
+    auto guard = ScopeGuard { [&] {
+        __atomic_clear(&m_busy, __ATOMIC_RELEASE);
+    } };
+
+    auto context_at = [&](size_t position) {
+        return m_program.has_assertions() ? m_program.context_at(str, position, eflags) : RegexContext::Other;
+    };
+
+    ssize_t position = m_program.find_candidate(str, start);
+    if (position < 0) {
+        return Result::NoMatch;
+    }
+
+    int state = state_for({}, context_at(position));
+    for (;;) {
+        if (state == too_many_states) {
+            reset();
+            return Result::GaveUp;
+        }
+
+        unsigned char c = str[position];
+        if (c == '\0') {
+            return follow(*m_states[state], '\0', eflags, nullptr) ? Result::Match : Result::NoMatch;
+        }
+
+        int next = m_states[state]->transitions[c];
+        if (next == unknown_state) {
+            next = compute_transition(state, c);
+            if (next == too_many_states) {
+                reset();
+                return Result::GaveUp;
+            }
+        }
+        if (m_states[state]->matches_before[c / 32] & (1U << (c % 32))) {
+            return Result::Match;
+        }
+
+        state = next;
+        position++;
+
+        // When no thread is alive, a match can only begin where the literal prefix next occurs.
+        if (m_states[state]->pcs.empty() && !m_program.literal_prefix().empty()) {
+            position = m_program.find_candidate(str, position);
+            if (position < 0) {
+                return Result::NoMatch;
+            }
+            state = state_for({}, context_at(position));
+        }
+    }
+}
+
+RegexContext RegexDFA::context_after(unsigned char c) const {
+    if (!m_program.has_assertions()) {
+        return RegexContext::Other;
+    }
+    if (c == '\n') {
+        return RegexContext::Newline;
+    }
+    return (isalpha(c) || c == '_') ? RegexContext::Word : RegexContext::Other;
+}
+
+int RegexDFA::compute_transition(int state, unsigned char c) {
+    Vector<int> targets;
+    bool matched = follow(*m_states[state], c, 0, &targets);
+
+    // States are identified by their sorted instructions.
+    for (int i = 1; i < targets.size(); i++) {
+        for (int j = i; j > 0 && targets[j - 1] > targets[j]; j--) {
+            LIIM::swap(targets[j - 1], targets[j]);
+        }
+    }
+
+    int next = state_for(move(targets), context_after(c));
+    if (next == too_many_states) {
+        return next;
+    }
+
+    auto& from = *m_states[state];
+    from.transitions[c] = next;
+    if (matched) {
+        from.matches_before[c / 32] |= 1U << (c % 32);
+    }
+    return next;
+}
+
+bool RegexDFA::follow(const State& state, unsigned char next, int eflags, Vector<int>* targets) {
+    const auto& instructions = m_program.instructions();
+    if (m_visited.size() != instructions.size()) {
+        m_visited.resize(instructions.size());
+    }
+    if (++m_generation == 0) {
+        for (int i = 0; i < m_visited.size(); i++) {
+            m_visited[i] = 0;
+        }
+        m_generation = 1;
+    }
+
+    m_stack.clear();
+    m_stack.add(0);
+    m_stack.add(state.pcs);
+
+    bool matched = false;
+    while (!m_stack.empty()) {
+        int pc = m_stack.last();
+        m_stack.remove_last();
+        if (m_visited[pc] == m_generation) {
+            continue;
+        }
+        m_visited[pc] = m_generation;
+
+        const auto& instruction = instructions[pc];
+        switch (instruction.op) {
+            case RegexInstruction::Op::Byte:
+                if (targets && next != '\0' && m_program.byte_set(instruction.arg).contains(next)) {
+                    targets->add(pc + 1);
+                }
+                break;
+            case RegexInstruction::Op::Split:
+                m_stack.add(instruction.arg2);
+                m_stack.add(instruction.arg);
+                break;
+            case RegexInstruction::Op::Jump:
+                m_stack.add(instruction.arg);
+                break;
+            case RegexInstruction::Op::Save:
+                m_stack.add(pc + 1);
+                break;
+            case RegexInstruction::Op::AssertBeginLine:
+            case RegexInstruction::Op::AssertEndLine:
+            case RegexInstruction::Op::AssertWordBoundary:
+            case RegexInstruction::Op::AssertNotWordBoundary:
+                if (m_program.assertion_holds(instruction.op, state.context, next, eflags)) {
+                    m_stack.add(pc + 1);
+                }
+                break;
+            case RegexInstruction::Op::Match:
+                matched = true;
+                break;
+        }
+    }
+    return matched;
+}
+
+int RegexDFA::state_for(Vector<int>&& pcs, RegexContext context) {
+    if (m_table.empty()) {
+        m_table.resize(64);
+        for (int i = 0; i < m_table.size(); i++) {
+            m_table[i] = -1;
+        }
+    }
+
+    unsigned int mask = m_table.size() - 1;
+    unsigned int index = hash_state(pcs, context) & mask;
+    for (; m_table[index] != -1; index = (index + 1) & mask) {
+        const auto& state = *m_states[m_table[index]];
+        if (state.context == context && state.pcs == pcs) {
+            return m_table[index];
+        }
+    }
+
+    if (m_states.size() >= max_states) {
+        return too_many_states;
+    }
+
+    auto state = make_unique<State>();
+    state->pcs = move(pcs);
+    state->context = context;
+    for (int i = 0; i < 256; i++) {
+        state->transitions[i] = unknown_state;
+    }
+    for (int i = 0; i < 8; i++) {
+        state->matches_before[i] = 0;
+    }
+    m_table[index] = m_states.size();
+    m_states.add(move(state));
+
+    if (m_states.size() * 2 > m_table.size()) {
+        Vector<int> table;
+        table.resize(m_table.size() * 2);
+        for (int i = 0; i < table.size(); i++) {
+            table[i] = -1;
+        }
+
+        unsigned int new_mask = table.size() - 1;
+        for (int i = 0; i < m_states.size(); i++) {
+            unsigned int slot = hash_state(m_states[i]->pcs, m_states[i]->context) & new_mask;
+            while (table[slot] != -1) {
+                slot = (slot + 1) & new_mask;
+            }
+            table[slot] = i;
+        }
+        m_table = move(table);
+    }
+    return m_states.size() - 1;
+}
+
+void RegexDFA::reset() {
+    m_states.clear();
+    m_table.clear();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <liim/pointers.h>
+#include <liim/vector.h>
+
+#include "regex_program.h"
+
+// A DFA for a RegexProgram, whose states are built lazily while searching. It can only tell whether the input
+// contains a match, but it does so in a single table lookup per byte once the states it visits are built.
+//
+// A state is the set of instructions which threads will continue at after the last byte, along with the context of
+// that byte, which determines the outcome of assertions. Every state also implicitly starts a new thread, so the DFA
+// finds matches which begin anywhere in the input.
+class RegexDFA {
+public:
+    enum class Result { Match, NoMatch, GaveUp };
+
+    explicit RegexDFA(const RegexProgram& program) : m_program(program) {}
+
+    // Gives up when another thread is using the DFA, or when the regex needs too many states. The caller must then
+    // run the program instead.
+    Result search(const char* str, size_t start, int eflags);
+
+private:
+    static constexpr int max_states = 2048;
+    static constexpr int unknown_state = -1;
+    static constexpr int too_many_states = -2;
+
+    struct State {
+        Vector<int> pcs;
+        RegexContext context;
+        int transitions[256];
+        // Whether the state matches right before consuming each byte.
+        uint32_t matches_before[8];
+    };
+
+    int state_for(Vector<int>&& pcs, RegexContext context);
+    int compute_transition(int state, unsigned char c);
+    bool follow(const State& state, unsigned char next, int eflags, Vector<int>* targets);
+    RegexContext context_after(unsigned char c) const;
+    void reset();
+
+    const RegexProgram& m_program;
+    Vector<UniquePtr<State>> m_states;
+    // An open addressing table of indices into m_states, keyed by the state's instructions and context.
+    Vector<int> m_table;
+    Vector<int> m_stack;
+    Vector<unsigned int> m_visited;
+    unsigned int m_generation { 0 };
+    bool m_busy { false };
+};
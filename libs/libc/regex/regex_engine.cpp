@@ -0,0 +1,50 @@
+#include "regex_engine.h"
+
+int RegexEngine::compile(const ParsedRegex& regex) {
+    if (int error = m_program.compile(regex)) {
+        return error;
+    }
+
+    if (m_program.has_backreference()) {
+        m_graph = make_unique<RegexGraph>(regex, m_program.cflags(), m_program.num_groups());
+        if (!m_graph->compile()) {
+            return m_graph->error_code();
+        }
+    }
+    return 0;
+}
+
+int RegexEngine::execute(const char* str, size_t nmatch, regmatch_t* dest_matches, int eflags) const {
+    bool want_matches = nmatch > 0 && !(m_program.cflags() & REG_NOSUB);
+
+    Option<Vector<regmatch_t>> result;
+    if (m_graph) {
+        result = m_graph->do_match(str, eflags);
+    } else {
+        auto dfa_result = m_dfa.search(str, 0, eflags);
+        if (dfa_result == RegexDFA::Result::NoMatch) {
+            return REG_NOMATCH;
+        }
+        if (dfa_result == RegexDFA::Result::Match && !want_matches) {
+            return 0;
+        }
+        result = m_program.execute(str, 0, eflags, nmatch);
+    }
+
+    if (!result.has_value()) {
+        return REG_NOMATCH;
+    }
+    if (!want_matches) {
+        return 0;
+    }
+
+    auto& matches = result.value();
+    for (size_t i = 0; i < nmatch; i++) {
+        if (i < (size_t) matches.size()) {
+            dest_matches[i] = matches[i];
+        } else {
+            dest_matches[i] = { -1, -1 };
+        }
+    }
+    return 0;
+}
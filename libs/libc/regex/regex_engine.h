@@ -0,0 +1,26 @@
+#pragma once
+
+#include <liim/pointers.h>
+
+#include "regex_dfa.h"
+#include "regex_graph.h"
+#include "regex_program.h"
+
+// The compiled form of a regex_t. Searching first asks the lazy DFA whether there is a match at all, which is all that
+// is needed when no submatches are requested, and only then runs the program to find where the match and its
+// submatches are. Regexes with back references cannot be expressed as a program, so they use the backtracking
+// RegexGraph instead.
+class RegexEngine {
+public:
+    RegexEngine(int cflags, int num_groups) : m_program(cflags, num_groups), m_dfa(m_program) {}
+
+    // Returns 0 on success, or a REG_* error code.
+    int compile(const ParsedRegex& regex);
+
+    int execute(const char* str, size_t nmatch, regmatch_t* dest_matches, int eflags) const;
+
+private:
+    RegexProgram m_program;
+    mutable RegexDFA m_dfa;
+    UniquePtr<RegexGraph> m_graph;
+};
@@ -0,0 +1,548 @@
+#include <ctype.h>
+#include <string.h>
+
+#include "regex_program.h"
+
+// Bounds the size of programs produced by counted repetitions, like (a{100}){100}.
+static constexpr int max_instructions = 65536;
+
+static bool is_boundary_word_character(unsigned char c) {
+    return isalpha(c) || c == '_';
+}
+
+static void add_character(RegexByteSet& set, char c, int cflags) {
+    set.add(c);
+    if (cflags & REG_ICASE) {
+        set.add(tolower(c));
+        set.add(toupper(c));
+    }
+}
+
+template<typename Predicate>
+static RegexByteSet byte_set_from(Predicate predicate) {
+    RegexByteSet set;
+    for (int c = 1; c < 256; c++) {
+        if (predicate(static_cast<unsigned char>(c))) {
+            set.add(c);
+        }
+    }
+    return set;
+}
+
+static int (*character_class_function(StringView name))(int) {
+    if (name == "upper")
+        return isupper;
+    if (name == "lower")
+        return islower;
+    if (name == "alpha")
+        return isalpha;
+    if (name == "digit")
+        return isdigit;
+    if (name == "xdigit")
+        return isxdigit;
+    if (name == "alnum")
+        return isalnum;
+    if (name == "punct")
+        return ispunct;
+    if (name == "blank")
+        return isblank;
+    if (name == "space")
+        return isspace;
+    if (name == "cntrl")
+        return iscntrl;
+    if (name == "graph")
+        return isgraph;
+    if (name == "print")
+        return isprint;
+    return nullptr;
+}
+
+static int bracket_byte_set(const BracketExpression& expression, int cflags, RegexByteSet& result) {
+    RegexByteSet set;
+    for (int i = 0; i < expression.list.size(); i++) {
+        const auto& item = expression.list[i];
+        if (item.type == BracketItem::Type::RangeExpression) {
+            // FIXME: consider multi character collating sequences, and non linear collating sequences
+            const auto& range = item.expression.as<BracketRangeExpression>();
+            unsigned char min = LIIM::min(range.start.first(), range.end.first());
+            unsigned char max = LIIM::max(range.start.first(), range.end.first());
+            for (int c = 1; c < 256; c++) {
+                if ((cflags & REG_ICASE) ? (tolower(c) >= tolower(min) && tolower(c) <= tolower(max)) : (c >= min && c <= max)) {
+                    set.add(c);
+                }
+            }
+            continue;
+        }
+
+        const auto& single = item.expression.as<BracketSingleExpression>();
+        if (single.type == BracketSingleExpression::Type::CharacterClass) {
+            // FIXME: Should [:upper:] or [:lower:] always match if REG_ICASE is set?
+            auto function = character_class_function(single.expression);
+            if (!function) {
+                return REG_ECTYPE;
+            }
+            for (int c = 1; c < 256; c++) {
+                if (function(c)) {
+                    set.add(c);
+                }
+            }
+            continue;
+        }
+
+        // FIXME: equivalence classes are treated like single collating symbols.
+        add_character(set, single.expression.first(), cflags);
+    }
+
+    // The null terminator is never matched, even when the bracket expression is inverted.
+    result = byte_set_from([&](unsigned char c) {
+        return set.contains(c) != expression.inverted;
+    });
+    return 0;
+}
+
+// Returns the character matched by expression, if it only ever matches a single character.
+static Option<char> literal_character(const RegexSingleExpression& expression) {
+    if (expression.type == RegexSingleExpression::Type::OrdinaryCharacter) {
+        return expression.expression.as<char>();
+    }
+    if (expression.type != RegexSingleExpression::Type::QuotedCharacter) {
+        return {};
+    }
+
+    switch (char c = expression.expression.as<char>()) {
+        case 'd':
+        case 'D':
+        case 'w':
+        case 'W':
+        case 's':
+        case 'S':
+        case 'b':
+        case 'B':
+            return {};
+        case 'a':
+            return '\a';
+        case 'f':
+            return '\f';
+        case 'n':
+            return '\n';
+        case 'r':
+            return '\r';
+        case 't':
+            return '\t';
+        case 'v':
+            return '\v';
+        default:
+            return c;
+    }
+}
+
+int RegexProgram::emit(RegexInstruction::Op op, int arg, int arg2) {
+    m_instructions.add({ op, arg, arg2 });
+    return m_instructions.size() - 1;
+}
+
+int RegexProgram::emit_byte_set(const RegexByteSet& set) {
+    m_byte_sets.add(set);
+    return emit(RegexInstruction::Op::Byte, m_byte_sets.size() - 1);
+}
+
+int RegexProgram::compile(const ParsedRegex& regex) {
+    compute_literal_prefix(regex);
+
+    if (int error = compile_alternatives(regex)) {
+        return error;
+    }
+    emit(RegexInstruction::Op::Match);
+    return 0;
+}
+
+int RegexProgram::compile_alternatives(const ParsedRegex& regex) {
+    Vector<int> jumps_to_end;
+    for (int i = 0; i < regex.alternatives.size(); i++) {
+        bool is_last = i == regex.alternatives.size() - 1;
+        int split = is_last ? -1 : emit(RegexInstruction::Op::Split, m_instructions.size() + 1);
+
+        const auto& parts = regex.alternatives[i].parts;
+        for (int j = 0; j < parts.size(); j++) {
+            if (int error = compile_repeated(*parts[j])) {
+                return error;
+            }
+        }
+
+        if (!is_last) {
+            jumps_to_end.add(emit(RegexInstruction::Op::Jump));
+            m_instructions[split].arg2 = m_instructions.size();
+        }
+    }
+
+    for (int i = 0; i < jumps_to_end.size(); i++) {
+        m_instructions[jumps_to_end[i]].arg = m_instructions.size();
+    }
+    return 0;
+}
+
+int RegexProgram::compile_repeated(const RegexSingleExpression& expression) {
+    if (!expression.duplicate.has_value()) {
+        return compile_single(expression);
+    }
+
+    const auto& duplicate = expression.duplicate.value();
+    for (int i = 0; i < duplicate.min; i++) {
+        if (int error = compile_single(expression)) {
+            return error;
+        }
+    }
+
+    if (duplicate.type == DuplicateCount::Type::AtLeast) {
+        int loop = emit(RegexInstruction::Op::Split, m_instructions.size() + 1);
+        if (int error = compile_single(expression)) {
+            return error;
+        }
+        emit(RegexInstruction::Op::Jump, loop);
+        m_instructions[loop].arg2 = m_instructions.size();
+        return 0;
+    }
+
+    if (duplicate.type == DuplicateCount::Type::Between) {
+        // x{1,3} becomes x(x(x)?)?, where every optional copy can skip straight to the end.
+        Vector<int> splits;
+        for (int i = duplicate.min; i < duplicate.max; i++) {
+            splits.add(emit(RegexInstruction::Op::Split, m_instructions.size() + 1));
+            if (int error = compile_single(expression)) {
+                return error;
+            }
+        }
+        for (int i = 0; i < splits.size(); i++) {
+            m_instructions[splits[i]].arg2 = m_instructions.size();
+        }
+    }
+    return 0;
+}
+
+int RegexProgram::compile_single(const RegexSingleExpression& expression) {
+    if (m_instructions.size() > max_instructions) {
+        return REG_ESPACE;
+    }
+
+    if (auto character = literal_character(expression)) {
+        RegexByteSet set;
+        add_character(set, character.value(), m_cflags);
+        emit_byte_set(set);
+        return 0;
+    }
+
+    switch (expression.type) {
+        case RegexSingleExpression::Type::QuotedCharacter: {
+            char c = expression.expression.as<char>();
+            bool inverted = isupper(c);
+            switch (tolower(c)) {
+                case 'd':
+                    emit_byte_set(byte_set_from([&](unsigned char c) {
+                        return !!isdigit(c) != inverted;
+                    }));
+                    break;
+                case 'w':
+                    emit_byte_set(byte_set_from([&](unsigned char c) {
+                        return (isalnum(c) || c == '_') != inverted;
+                    }));
+                    break;
+                case 's':
+                    emit_byte_set(byte_set_from([&](unsigned char c) {
+                        return !!isspace(c) != inverted;
+                    }));
+                    break;
+                case 'b':
+                    m_has_assertions = true;
+                    emit(inverted ? RegexInstruction::Op::AssertNotWordBoundary : RegexInstruction::Op::AssertWordBoundary);
+                    break;
+            }
+            return 0;
+        }
+        case RegexSingleExpression::Type::Any:
+            emit_byte_set(byte_set_from([&](unsigned char c) {
+                return !(m_cflags & REG_NEWLINE) || c != '\n';
+            }));
+            return 0;
+        case RegexSingleExpression::Type::BracketExpression: {
+            RegexByteSet set;
+            if (int error = bracket_byte_set(expression.expression.as<BracketExpression>(), m_cflags, set)) {
+                return error;
+            }
+            emit_byte_set(set);
+            return 0;
+        }
+        case RegexSingleExpression::Type::Group: {
+            const auto& group = expression.expression.as<ParsedRegex>();
+            emit(RegexInstruction::Op::Save, 2 * group.index);
+            if (int error = compile_alternatives(group)) {
+                return error;
+            }
+            emit(RegexInstruction::Op::Save, 2 * group.index + 1);
+            return 0;
+        }
+        case RegexSingleExpression::Type::LeftAnchor:
+            m_has_assertions = true;
+            emit(RegexInstruction::Op::AssertBeginLine);
+            return 0;
+        case RegexSingleExpression::Type::RightAnchor:
+            m_has_assertions = true;
+            emit(RegexInstruction::Op::AssertEndLine);
+            return 0;
+        case RegexSingleExpression::Type::Backreference:
+            m_has_backreference = true;
+            return 0;
+        case RegexSingleExpression::Type::OrdinaryCharacter:
+            break;
+    }
+    return 0;
+}
+
+void RegexProgram::compute_literal_prefix(const ParsedRegex& regex) {
+    if ((m_cflags & REG_ICASE) || regex.alternatives.size() != 1) {
+        return;
+    }
+
+    const auto& parts = regex.alternatives.first().parts;
+    for (int i = 0; i < parts.size(); i++) {
+        const auto& part = *parts[i];
+        auto character = literal_character(part);
+        if (!character.has_value() || (part.duplicate.has_value() && part.duplicate.value().min == 0)) {
+            return;
+        }
+
+        m_literal_prefix += String(character.value());
+        if (part.duplicate.has_value()) {
+            return;
+        }
+    }
+}
+
+ssize_t RegexProgram::find_candidate(const char* str, size_t start) const {
+    if (m_literal_prefix.empty()) {
+        return start;
+    }
+
+    auto* candidate = strstr(str + start, m_literal_prefix.string());
+    if (!candidate) {
+        return -1;
+    }
+    return candidate - str;
+}
+
+RegexContext RegexProgram::context_at(const char* str, size_t index, int eflags) const {
+    if (index == 0) {
+        return (eflags & REG_NOTBOL) ? RegexContext::BeginTextNotBol : RegexContext::BeginText;
+    }
+
+    unsigned char previous = str[index - 1];
+    if (previous == '\n') {
+        return RegexContext::Newline;
+    }
+    return is_boundary_word_character(previous) ? RegexContext::Word : RegexContext::Other;
+}
+
+bool RegexProgram::assertion_holds(RegexInstruction::Op op, RegexContext context, unsigned char next, int eflags) const {
+    bool at_beginning = context == RegexContext::BeginText || context == RegexContext::BeginTextNotBol;
+    switch (op) {
+        case RegexInstruction::Op::AssertBeginLine:
+            return context == RegexContext::BeginText || ((m_cflags & REG_NEWLINE) && context == RegexContext::Newline);
+        case RegexInstruction::Op::AssertEndLine:
+            return (next == '\0' && !(eflags & REG_NOTEOL)) || ((m_cflags & REG_NEWLINE) && next == '\n');
+        case RegexInstruction::Op::AssertWordBoundary:
+            return next == '\0' || at_beginning || ((context == RegexContext::Word) != is_boundary_word_character(next));
+        case RegexInstruction::Op::AssertNotWordBoundary:
+            return next != '\0' && !at_beginning && ((context == RegexContext::Word) == is_boundary_word_character(next));
+        default:
+            return false;
+    }
+}
+
+namespace {
+// The threads alive at one position, ordered by priority, with at most one thread per instruction. Each thread has
+// its own copy of the capture slots.
+class ThreadList {
+public:
+    ThreadList(int num_instructions, int num_slots) : m_num_slots(num_slots) {
+        m_dense.resize(num_instructions);
+        m_sparse.resize(num_instructions);
+        m_slots.resize(num_instructions * num_slots);
+    }
+
+    int size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    void clear() { m_size = 0; }
+
+    bool contains(int pc) const { return m_sparse[pc] < m_size && m_dense[m_sparse[pc]] == pc; }
+
+    int add(int pc) {
+        m_sparse[pc] = m_size;
+        m_dense[m_size] = pc;
+        return m_size++;
+    }
+
+    int pc(int index) const { return m_dense[index]; }
+    regoff_t* slots(int index) { return &m_slots[index * m_num_slots]; }
+
+    void swap(ThreadList& other) {
+        m_dense.swap(other.m_dense);
+        m_sparse.swap(other.m_sparse);
+        m_slots.swap(other.m_slots);
+        LIIM::swap(m_size, other.m_size);
+    }
+
+private:
+    Vector<int> m_dense;
+    Vector<int> m_sparse;
+    Vector<regoff_t> m_slots;
+    int m_num_slots { 0 };
+    int m_size { 0 };
+};
+
+struct Frame {
+    int pc;
+    // When slot is not -1, this frame restores the slot to value instead of visiting pc.
+    int slot;
+    regoff_t value;
+};
+}
+
+Option<Vector<regmatch_t>> RegexProgram::execute(const char* str, size_t start, int eflags, int num_matches) const {
+    ssize_t candidate = find_candidate(str, start);
+    if (candidate < 0) {
+        return {};
+    }
+
+    int num_slots = 2 * LIIM::max(1, LIIM::min(num_matches, m_num_groups + 1));
+    int num_instructions = m_instructions.size();
+    ThreadList current(num_instructions, num_slots);
+    ThreadList next(num_instructions, num_slots);
+
+    Vector<regoff_t> scratch;
+    scratch.resize(num_slots);
+    Vector<regoff_t> best;
+    best.resize(num_slots);
+    bool found = false;
+
+    Vector<Frame> stack;
+    auto add_thread = [&](ThreadList& list, int start_pc, const regoff_t* slots, size_t position, RegexContext context) {
+        for (int i = 0; i < num_slots; i++) {
+            scratch[i] = slots[i];
+        }
+
+        unsigned char next_byte = str[position];
+        stack.add({ start_pc, -1, 0 });
+        while (!stack.empty()) {
+            auto frame = stack.last();
+            stack.remove_last();
+            if (frame.slot != -1) {
+                scratch[frame.slot] = frame.value;
+                continue;
+            }
+
+            int pc = frame.pc;
+            if (list.contains(pc)) {
+                continue;
+            }
+
+            int index = list.add(pc);
+            const auto& instruction = m_instructions[pc];
+            switch (instruction.op) {
+                case RegexInstruction::Op::Jump:
+                    stack.add({ instruction.arg, -1, 0 });
+                    break;
+                case RegexInstruction::Op::Split:
+                    stack.add({ instruction.arg2, -1, 0 });
+                    stack.add({ instruction.arg, -1, 0 });
+                    break;
+                case RegexInstruction::Op::Save:
+                    if (instruction.arg < num_slots) {
+                        stack.add({ 0, instruction.arg, scratch[instruction.arg] });
+                        scratch[instruction.arg] = position;
+                    }
+                    stack.add({ pc + 1, -1, 0 });
+                    break;
+                case RegexInstruction::Op::AssertBeginLine:
+                case RegexInstruction::Op::AssertEndLine:
+                case RegexInstruction::Op::AssertWordBoundary:
+                case RegexInstruction::Op::AssertNotWordBoundary:
+                    if (assertion_holds(instruction.op, context, next_byte, eflags)) {
+                        stack.add({ pc + 1, -1, 0 });
+                    }
+                    break;
+                case RegexInstruction::Op::Byte:
+                case RegexInstruction::Op::Match:
+                    for (int i = 0; i < num_slots; i++) {
+                        list.slots(index)[i] = scratch[i];
+                    }
+                    break;
+            }
+        }
+    };
+
+    Vector<regoff_t> seed;
+    seed.resize(num_slots);
+    for (size_t position = candidate;; position++) {
+        auto context = context_at(str, position, eflags);
+        if (!found) {
+            // New threads have the lowest priority, as any thread started earlier produces a match further left.
+            for (int i = 0; i < num_slots; i++) {
+                seed[i] = -1;
+            }
+            seed[0] = position;
+            add_thread(current, 0, &seed[0], position, context);
+        }
+
+        unsigned char c = str[position];
+        auto next_context = c == '\n' ? RegexContext::Newline : is_boundary_word_character(c) ? RegexContext::Word : RegexContext::Other;
+        for (int i = 0; i < current.size(); i++) {
+            auto* slots = current.slots(i);
+            const auto& instruction = m_instructions[current.pc(i)];
+            if (instruction.op == RegexInstruction::Op::Match) {
+                if (!found || slots[0] < best[0] || (slots[0] == best[0] && (regoff_t) position > best[1])) {
+                    for (int j = 0; j < num_slots; j++) {
+                        best[j] = slots[j];
+                    }
+                    best[1] = position;
+                    found = true;
+                }
+                continue;
+            }
+
+            if (instruction.op != RegexInstruction::Op::Byte || (found && slots[0] > best[0])) {
+                continue;
+            }
+            if (c != '\0' && m_byte_sets[instruction.arg].contains(c)) {
+                add_thread(next, current.pc(i) + 1, slots, position + 1, next_context);
+            }
+        }
+
+        current.swap(next);
+        next.clear();
+        if (c == '\0' || (found && current.empty())) {
+            break;
+        }
+
+        // With no threads left, skip ahead to where the next match could possibly start.
+        if (current.empty()) {
+            candidate = find_candidate(str, position + 1);
+            if (candidate < 0) {
+                break;
+            }
+            position = candidate - 1;
+        }
+    }
+
+    if (!found) {
+        return {};
+    }
+
+    Vector<regmatch_t> matches(num_slots / 2);
+    for (int i = 0; i < num_slots; i += 2) {
+        if (best[i] == -1 || best[i + 1] == -1) {
+            matches.add({ -1, -1 });
+        } else {
+            matches.add({ best[i], best[i + 1] });
+        }
+    }
+    return matches;
+}
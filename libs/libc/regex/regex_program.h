@@ -0,0 +1,97 @@
+#pragma once
+
+#include <liim/option.h>
+#include <liim/string.h>
+#include <liim/vector.h>
+#include <stdint.h>
+
+#include "regex_value.h"
+
+#ifdef USERLAND_NATIVE
+#include "../include/regex.h"
+#else
+#include <regex.h>
+#endif /* USERLAND_NATIVE */
+
+struct RegexByteSet {
+    bool contains(unsigned char c) const { return bits[c / 32] & (1U << (c % 32)); }
+    void add(unsigned char c) { bits[c / 32] |= 1U << (c % 32); }
+
+    uint32_t bits[8] {};
+};
+
+struct RegexInstruction {
+    enum class Op : uint8_t {
+        // Consumes one byte if it is in byte_sets[arg].
+        Byte,
+        // Continues at both arg and arg2, preferring arg.
+        Split,
+        Jump,
+        // Records the current position in capture slot arg.
+        Save,
+        AssertBeginLine,
+        AssertEndLine,
+        AssertWordBoundary,
+        AssertNotWordBoundary,
+        Match,
+    };
+
+    Op op;
+    int arg;
+    int arg2;
+};
+
+// The context an assertion is evaluated in, which is determined by the byte before the current position.
+enum class RegexContext : uint8_t { BeginText, BeginTextNotBol, Newline, Word, Other };
+
+// A regex compiled into a program for a Pike VM: a simulation of the NFA which advances every thread in lock step, one
+// byte at a time. Unlike backtracking, this never looks at a byte of the input more than once per instruction.
+//
+// Matches follow POSIX leftmost-longest rules: the match which starts first wins, and among those the longest one.
+// Submatches are taken from the highest priority path producing that match, where the left side of an alternation and
+// another iteration of a repetition are preferred.
+class RegexProgram {
+public:
+    RegexProgram(int cflags, int num_groups) : m_cflags(cflags), m_num_groups(num_groups) {}
+
+    // Returns 0 on success, or a REG_* error code.
+    int compile(const ParsedRegex& regex);
+
+    // Back references cannot be expressed as a program, so a regex which uses them must be matched some other way.
+    bool has_backreference() const { return m_has_backreference; }
+    bool has_assertions() const { return m_has_assertions; }
+
+    int cflags() const { return m_cflags; }
+    int num_groups() const { return m_num_groups; }
+
+    const Vector<RegexInstruction>& instructions() const { return m_instructions; }
+    const RegexByteSet& byte_set(int index) const { return m_byte_sets[index]; }
+
+    // Every match starts with this string, which allows searching for candidates with strstr().
+    const String& literal_prefix() const { return m_literal_prefix; }
+
+    // Returns the first index at or after start where a match could begin, or -1 if there cannot be a match.
+    ssize_t find_candidate(const char* str, size_t start) const;
+
+    RegexContext context_at(const char* str, size_t index, int eflags) const;
+    bool assertion_holds(RegexInstruction::Op op, RegexContext context, unsigned char next, int eflags) const;
+
+    // Searches for the leftmost-longest match starting at or after start, filling in the first num_matches submatches.
+    Option<Vector<regmatch_t>> execute(const char* str, size_t start, int eflags, int num_matches) const;
+
+private:
+    int emit(RegexInstruction::Op op, int arg = 0, int arg2 = 0);
+    int emit_byte_set(const RegexByteSet& set);
+    int compile_alternatives(const ParsedRegex& regex);
+    int compile_single(const RegexSingleExpression& expression);
+    int compile_repeated(const RegexSingleExpression& expression);
+    void compute_literal_prefix(const ParsedRegex& regex);
+
+    Vector<RegexInstruction> m_instructions;
+    Vector<RegexByteSet> m_byte_sets;
+    String m_literal_prefix;
+    int m_cflags { 0 };
+    int m_num_groups { 0 };
+    bool m_has_backreference { false };
+    bool m_has_assertions { false };
+};
@@ -6,12 +6,12 @@
 #include <regex.h>
 #endif /* USERLAND_NATIVE */
 
-#include "regex_graph.h"
+#include "regex_engine.h"
 
 extern "C" void regfree(regex_t* regex) {
     if (regex->__re_compiled_data) {
-        RegexGraph* data = reinterpret_cast<RegexGraph*>(regex->__re_compiled_data);
-        data->~RegexGraph();
+        RegexEngine* data = reinterpret_cast<RegexEngine*>(regex->__re_compiled_data);
+        data->~RegexEngine();
         free(data);
         regex->__re_compiled_data = nullptr;
     }
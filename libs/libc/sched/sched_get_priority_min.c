@@ -0,0 +1,15 @@
+#include <errno.h>
+#include <sched.h>
+
+int sched_get_priority_min(int policy) {
+    switch (policy) {
+        case SCHED_OTHER:
+            return 0;
+        case SCHED_FIFO:
+        case SCHED_RR:
+            return 1;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+}
@@ -0,0 +1,8 @@
+#include <errno.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+int sched_getaffinity(pid_t pid, size_t size, cpu_set_t *set) {
+    int ret = (int) syscall(SYS_sched_getaffinity, pid, size, set);
+    __SYSCALL_TO_ERRNO(ret);
+}
@@ -0,0 +1,14 @@
+#include <errno.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+int sched_getparam(pid_t pid, struct sched_param *param) {
+    int ret = (int) syscall(SYS_sched_getparam, pid);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    param->sched_priority = ret;
+    return 0;
+}
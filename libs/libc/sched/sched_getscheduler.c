@@ -0,0 +1,8 @@
+#include <errno.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+int sched_getscheduler(pid_t pid) {
+    int ret = (int) syscall(SYS_sched_getscheduler, pid);
+    __SYSCALL_TO_ERRNO(ret);
+}
@@ -0,0 +1,9 @@
+#include <sched.h>
+
+int sched_setparam(pid_t pid, const struct sched_param *param) {
+    int policy = sched_getscheduler(pid);
+    if (policy < 0) {
+        return -1;
+    }
+    return sched_setscheduler(pid, policy, param);
+}
@@ -0,0 +1,8 @@
+#include <errno.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+int sched_setscheduler(pid_t pid, int policy, const struct sched_param *param) {
+    int ret = (int) syscall(SYS_sched_setscheduler, pid, policy, param->sched_priority);
+    __SYSCALL_TO_ERRNO(ret);
+}
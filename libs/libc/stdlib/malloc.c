@@ -4,12 +4,15 @@
 typedef int pthread_t;
 #endif /* USERLAND_NATIVE */
 
+#define __libc_internal
+
 #ifndef __is_libk
 #define NDEBUG
 #endif /* __is_libk */
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -17,8 +20,12 @@ typedef int pthread_t;
 #include <string.h>
 #include <sys/param.h>
 
+// Define MALLOC_SCRUB to fill fresh allocations and freed objects with a recognizable
+// byte pattern. This is expensive, so it is only enabled for debugging.
+#if defined(MALLOC_SCRUB) || (defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG))
 #define MALLOC_SCRUB_FREE
 #define MALLOC_SCRUB_ALLOC
+#endif /* MALLOC_SCRUB || (__is_libk && KERNEL_MALLOC_DEBUG) */
 
 #ifdef __is_libk
 #define MALLOC_SCRUB_BITS 0x0C
@@ -28,11 +35,7 @@ typedef int pthread_t;
 #define FREE_SCRUB_BITS   0xA0
 #endif /* __is_libk */
 
-#if __x86_64__
-#define __MALLOC_MAGIG_CHECK 0x2A8F30B241BFA759UL
-#elif __i386__
-#define __MALLOC_MAGIG_CHECK 0x41BFA759UL
-#endif
+#define __MALLOC_MAGIG_CHECK 0x41BFA759U
 
 #ifdef __is_libk
 #include <kernel/hal/output.h>
@@ -53,8 +56,10 @@ void *sbrk(intptr_t increment) {
 
 #define __malloc_debug(s, ...) ((void) s)
 #else
-#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 static __attribute__((unused)) FILE *__serial_out;
 static __attribute__((unused)) int __do_logging;
@@ -85,404 +90,594 @@ static __attribute__((unused)) int __do_logging;
 #endif /* PAGE_SIZE */
 
 #include <unistd.h>
-#endif
-
-struct metadata {
-    size_t magic;
-    size_t prev_size;
-    size_t size;
-} __attribute__((packed));
-
-#define ALLOCATED              (1)
-#define SET_ALLOCATED(block)   ((block)->size |= ALLOCATED)
-#define CLEAR_ALLOCATED(block) ((block)->size &= ~ALLOCATED)
-#define IS_ALLOCATED(block)    ((block)->size & ALLOCATED)
-#define GET_SIZE(block)        ((block)->size & ~ALLOCATED)
-
-#define NUM_PAGES_IN_LENGTH(sz) (((sz) -1) / PAGE_SIZE + 1)
-#define NEW_BLOCK_SIZE(n)       (2 * sizeof(struct metadata) + (n))
-#define NEXT_BLOCK(block)       ((struct metadata *) (((uintptr_t) (block)) + sizeof(struct metadata) + GET_SIZE((block))))
-#define PREV_BLOCK(block)       ((struct metadata *) (((uintptr_t) (block)) - sizeof(struct metadata) - (block)->prev_size))
-#define GET_BLOCK(p)            ((struct metadata *) (((uintptr_t) (p)) - sizeof(struct metadata)))
-
-static struct metadata *start;
-static uintptr_t heap_end;
-static struct metadata *last_allocated;
+
+// Per-thread caches can only be used once the thread pointer is set up, since before that
+// point, TLS accesses would fault. init_threads() calls __malloc_enable_thread_cache() right
+// after set_thread_self_pointer(); __threads is assigned earlier, so it can't be used for this.
+#define MALLOC_THREAD_CACHE
+
+static bool thread_pointer_ready;
+#endif /* __is_libk */
+
+// Every allocation is preceded by one of these headers. Small objects store their size class,
+// large objects store the length of their page mapping, and over-aligned allocations store the
+// distance back to the underlying allocation they were carved out of.
+struct chunk {
+    uint32_t magic;
+    uint32_t kind;
+    size_t length;
+} __attribute__((aligned(16)));
+
+#define MALLOC_ALIGNMENT sizeof(struct chunk)
+
+#define CHUNK_LARGE   0xFFFFU
+#define CHUNK_ALIGNED 0xFFFEU
+
+#define GET_CHUNK(p)      ((struct chunk *) (((uintptr_t) (p)) - sizeof(struct chunk)))
+#define CHUNK_POINTER(c)  ((void *) ((c) + 1))
+#define IS_SMALL_CHUNK(c) ((c)->kind < MALLOC_SIZE_CLASS_COUNT)
+
+// Small size classes are spaced 16 bytes apart up to 128 bytes, and then use four steps
+// per power of two, which bounds internal fragmentation to 25%. Anything larger than the
+// biggest size class is backed directly by pages.
+#define MALLOC_SIZE_CLASS_COUNT 40
+#define MALLOC_MAX_SMALL_SIZE   32768
+
+// Spans of objects for a size class are carved out of the heap at least this many bytes at a time.
+#define MALLOC_SPAN_SIZE 0x10000
+
+struct free_object {
+    struct free_object *next;
+};
+
+static inline size_t size_to_class(size_t n) {
+    if (n <= 128) {
+        return n == 0 ? 0 : (n - 1) / 16;
+    }
+
+    size_t shift = sizeof(unsigned long) * CHAR_BIT - 1 - __builtin_clzl(n - 1);
+    size_t sub = (n - 1) >> (shift - 2);
+    return 8 + (shift - 7) * 4 + (sub - 4);
+}
+
+static inline size_t class_to_size(size_t size_class) {
+    if (size_class < 8) {
+        return (size_class + 1) * 16;
+    }
+
+    size_t group = (size_class - 8) / 4;
+    size_t step = (size_class - 8) % 4;
+    return (5 + step) << (group + 5);
+}
+
+static inline size_t class_slot_size(size_t size_class) {
+    return class_to_size(size_class) + sizeof(struct chunk);
+}
 
 #ifdef __is_libk
 #include <kernel/util/spinlock.h>
-static spinlock_t __malloc_lock;
+typedef spinlock_t malloc_lock_t;
 #define __lock   spin_lock
 #define __unlock spin_unlock
 #else
 #include <bits/lock.h>
-static struct __lock __malloc_lock;
+typedef struct __lock malloc_lock_t;
 #endif /* __is_libk */
 
-#if defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG)
-#undef calloc
-void *calloc(size_t n, size_t sz, int line, const char *func) {
-    debug_log("~Calloc: [ %s, %d ]\n", func, line);
-#else
-void *calloc(size_t n, size_t sz) {
-#endif /* __is_libk && KERNEL_MALLOC_DEBUG */
-    void *p = malloc(n * sz);
-    if (p == NULL) {
-        return p;
+// The central free list for a size class. Objects are returned here when a thread cache
+// overflows (or directly, when thread caches are not in use), and new objects are bump
+// allocated out of the current span once the free list runs dry.
+struct size_class_state {
+    malloc_lock_t lock;
+    struct free_object *free_list;
+    uintptr_t span_next;
+    uintptr_t span_end;
+};
+
+static struct size_class_state size_classes[MALLOC_SIZE_CLASS_COUNT];
+
+static inline void count_alloc(void) {
+#ifdef __is_libk
+    __atomic_fetch_add(&g_kmalloc_stats.alloc_count, 1, __ATOMIC_RELAXED);
+#endif /* __is_libk */
+}
+
+static inline void count_free(void) {
+#ifdef __is_libk
+    __atomic_fetch_add(&g_kmalloc_stats.free_count, 1, __ATOMIC_RELAXED);
+#endif /* __is_libk */
+}
+
+static inline void set_enomem(void) {
+#ifdef MALLOC_THREAD_CACHE
+    // errno lives in TLS, and so can't be touched before the thread pointer is set up.
+    if (!thread_pointer_ready) {
+        return;
     }
-    memset(p, 0, n * sz);
-    return p;
+#endif /* MALLOC_THREAD_CACHE */
+    errno = ENOMEM;
 }
 
-#if defined(__is_libk) && (defined(KERNEL_MALLOC_DEBUG) || defined(KERNEL_MEMCPY_DEBUG))
-#include <kernel/hal/output.h>
-#undef realloc
-void *realloc(void *p, size_t sz, int line, const char *func) {
-    debug_log("~Realloc: [ %s, %d ]\n", func, line);
+// Grows the heap by the specified number of pages. The memory is not shared with anything
+// else, and is never given back, since spans are recycled through the size class free lists.
+static void *allocate_heap_pages(size_t pages) {
+#ifdef __is_libk
+    return sbrk(pages);
 #else
-void *realloc(void *p, size_t sz) {
-#endif /* defined(__is_libk) && (defined(KERNEL_MALLOC_DEBUG) || defined(KERNEL_MEMCPY_DEBUG)) */
-    __malloc_debug("Realloc: [ %p, %lu ]\n", p, sz);
-
-    void *new_p = malloc(sz);
-    if (p == NULL) {
-        return new_p;
+    long ret = syscall(SYS_sbrk, pages);
+    if (ret < 0 && ret > -EMAXERRNO) {
+        return NULL;
     }
-    if (new_p == NULL) {
-        return new_p;
+    return (void *) ret;
+#endif /* __is_libk */
+}
+
+#ifdef __is_libk
+// The kernel heap can only be grown from the end, so large kernel allocations are made out of
+// runs of pages kept in an address ordered free list, where adjacent runs are coalesced.
+struct page_run {
+    size_t pages;
+    struct page_run *next;
+};
+
+static struct page_run *free_page_runs;
+static malloc_lock_t page_run_lock;
+
+static void *allocate_large_pages(size_t pages) {
+    __lock(&page_run_lock);
+    struct page_run **link = &free_page_runs;
+    for (struct page_run *run = free_page_runs; run; link = &run->next, run = run->next) {
+        if (run->pages < pages) {
+            continue;
+        }
+
+        if (run->pages == pages) {
+            *link = run->next;
+        } else {
+            struct page_run *rest = (struct page_run *) (((uintptr_t) run) + pages * PAGE_SIZE);
+            rest->pages = run->pages - pages;
+            rest->next = run->next;
+            *link = rest;
+        }
+        __unlock(&page_run_lock);
+        return run;
     }
+    __unlock(&page_run_lock);
 
-    size_t size_to_copy = MIN(GET_SIZE(GET_BLOCK(p)), sz);
-#if defined(__is_libk) && defined(KERNEL_MEMCPY_DEBUG)
-#undef memmove
-    memmove(new_p, p, size_to_copy, line, func);
-#else
-    memmove(new_p, p, size_to_copy);
-#endif /* defined(__is_libk) && defined(KERNEL_MEMCPY_DEBUG) */
-    free(p);
-    return new_p;
+    return allocate_heap_pages(pages);
 }
 
-#if defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG)
-#include <kernel/hal/output.h>
-#undef free
-void free(void *p, int line, const char *func) {
-    debug_log("~Free: [ %s, %d, %p, %p ]\n", func, line, p, GET_BLOCK(p));
+static void free_large_pages(void *base, size_t pages) {
+    struct page_run *to_free = base;
+    to_free->pages = pages;
 
-    __lock(&__malloc_lock);
-    struct metadata *_block = start;
-    while (_block != NULL && _block->size != 0) {
-        assert(_block->magic == __MALLOC_MAGIG_CHECK);
-        _block = NEXT_BLOCK(_block);
+    __lock(&page_run_lock);
+    struct page_run *prev = NULL;
+    struct page_run *next = free_page_runs;
+    while (next && next < to_free) {
+        prev = next;
+        next = next->next;
     }
 
-    if (p == NULL) {
-        __unlock(&__malloc_lock);
-        return;
+    to_free->next = next;
+    if (next && ((uintptr_t) to_free) + to_free->pages * PAGE_SIZE == (uintptr_t) next) {
+        to_free->pages += next->pages;
+        to_free->next = next->next;
+    }
+
+    if (prev && ((uintptr_t) prev) + prev->pages * PAGE_SIZE == (uintptr_t) to_free) {
+        prev->pages += to_free->pages;
+        prev->next = to_free->next;
+    } else if (prev) {
+        prev->next = to_free;
+    } else {
+        free_page_runs = to_free;
     }
+    __unlock(&page_run_lock);
+}
 #else
-void free(void *p) {
-    if (p == NULL) {
-        return;
+static void *allocate_large_pages(size_t pages) {
+    long ret = syscall(SYS_mmap, NULL, pages * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (ret < 0 && ret > -EMAXERRNO) {
+        return NULL;
     }
+    return (void *) ret;
+}
 
-    __lock(&__malloc_lock);
-#endif /* __is_libk && KERNEL_MALLOC_DEBUG */
+static void free_large_pages(void *base, size_t pages) {
+    syscall(SYS_munmap, base, pages * PAGE_SIZE);
+}
+#endif /* __is_libk */
 
-    struct metadata *block = GET_BLOCK(p);
-    if (block->magic != __MALLOC_MAGIG_CHECK) {
-#if defined(KERNEL_MALLOC_DEBUG) && defined(__is_libk)
-        debug_log("~Free detected invalid block: [ %p, %p ]\n", block, block + 1);
-#endif /* KERNEL_MALLOC_DEBUG && __is_libk */
-        assert(block->magic == __MALLOC_MAGIG_CHECK);
+// Pops up to count objects off the central list for the size class into a singly linked list.
+// Returns the number of objects actually produced, which is only 0 if the heap is exhausted.
+static size_t central_allocate_batch(size_t size_class, struct free_object **head, size_t count) {
+    struct size_class_state *state = &size_classes[size_class];
+    size_t slot_size = class_slot_size(size_class);
+
+    struct free_object *list = NULL;
+    size_t produced = 0;
+
+    __lock(&state->lock);
+    while (produced < count && state->free_list) {
+        struct free_object *object = state->free_list;
+        state->free_list = object->next;
+        object->next = list;
+        list = object;
+        produced++;
     }
-    assert(IS_ALLOCATED(block));
-    __malloc_debug("free: [ %p, %lu ]\n", p, GET_SIZE(block));
-    CLEAR_ALLOCATED(block);
-    last_allocated = NULL;
 
-#ifdef __is_libk
-    g_kmalloc_stats.free_count++;
-#endif /* __is_libk */
+    while (produced < count) {
+        if (state->span_next + slot_size > state->span_end) {
+            size_t span_length = ALIGN_UP(MAX(MALLOC_SPAN_SIZE, 8 * slot_size), PAGE_SIZE);
+            void *span = allocate_heap_pages(span_length / PAGE_SIZE);
+            if (!span) {
+                break;
+            }
+            state->span_next = (uintptr_t) span;
+            state->span_end = state->span_next + span_length;
+        }
 
-#ifdef MALLOC_SCRUB_FREE
-    memset(block + 1, FREE_SCRUB_BITS, GET_SIZE(block));
-#endif /* MALLOC_SCRUB_FREE */
+        struct chunk *chunk = (struct chunk *) state->span_next;
+        state->span_next += slot_size;
+        chunk->magic = __MALLOC_MAGIG_CHECK;
+        chunk->kind = size_class;
+        chunk->length = 0;
 
-#if defined(KERNEL_MALLOC_DEBUG) && defined(__is_libk)
-    debug_log("~Malloc block freed: [ %p ]\n", block);
-#endif /* KERNEL_MALLOC_DEBUG && __is_libk */
+        struct free_object *object = CHUNK_POINTER(chunk);
+        object->next = list;
+        list = object;
+        produced++;
+    }
+    __unlock(&state->lock);
 
-    __unlock(&__malloc_lock);
+    *head = list;
+    return produced;
 }
 
-#if defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG)
-#undef aligned_alloc
-void *aligned_alloc(size_t alignment, size_t n, int line, const char *func) {
-    debug_log("~Aligned alloc: [ %s, %d ]\n", func, line);
+static void central_free_batch(size_t size_class, struct free_object *head, struct free_object *tail) {
+    struct size_class_state *state = &size_classes[size_class];
 
-    __lock(&__malloc_lock);
-    struct metadata *_block = start;
-    while (_block != NULL && _block->size != 0) {
-        assert(_block->magic == __MALLOC_MAGIG_CHECK);
-        _block = NEXT_BLOCK(_block);
-    }
+    __lock(&state->lock);
+    tail->next = state->free_list;
+    state->free_list = head;
+    __unlock(&state->lock);
+}
 
-    // Maybe this should error instead...
-    if (alignment == 0) {
-        __unlock(&__malloc_lock);
-        return malloc(n);
-    }
+#ifdef MALLOC_THREAD_CACHE
+// Each thread keeps a bounded stack of free objects per size class, so that the common
+// malloc()/free() pair never has to take a lock. Objects move between a thread cache and
+// the central lists in batches of half the cache's capacity.
+#define MALLOC_THREAD_CACHE_BYTES 0x10000
+#define MALLOC_THREAD_CACHE_MIN   4
+#define MALLOC_THREAD_CACHE_MAX   128
+
+struct thread_cache_bin {
+    struct free_object *head;
+    size_t count;
+};
+
+static __thread struct thread_cache_bin thread_cache[MALLOC_SIZE_CLASS_COUNT];
+static __thread bool thread_cache_disabled;
+static bool thread_cache_enabled;
+
+static inline size_t thread_cache_capacity(size_t size_class) {
+    return MAX(MALLOC_THREAD_CACHE_MIN, MIN(MALLOC_THREAD_CACHE_MAX, MALLOC_THREAD_CACHE_BYTES / class_to_size(size_class)));
+}
 
-    if (n == 0) {
-        __unlock(&__malloc_lock);
-        return NULL;
-    }
+static inline bool thread_cache_usable(void) {
+    return thread_cache_enabled && !thread_cache_disabled;
+}
 
-    if ((alignment & (alignment - 1)) || (alignment % sizeof(void *) != 0)) {
-        __unlock(&__malloc_lock);
-        errno = EINVAL;
-        return NULL;
-    }
+// Setting MALLOC_NO_THREAD_CACHE makes every allocation go through the locked central lists,
+// which is useful for comparing against the cached path.
+void __malloc_enable_thread_cache(void) {
+    thread_pointer_ready = true;
+    thread_cache_enabled = getenv("MALLOC_NO_THREAD_CACHE") == NULL;
+}
 
-    n = MAX(n, 16);
-#else
-__attribute__((weak)) void *aligned_alloc(size_t alignment, size_t n) {
-    // Maybe this should error instead...
-    if (alignment == 0) {
-        return malloc(n);
+static void thread_cache_flush(size_t size_class, size_t count) {
+    struct thread_cache_bin *bin = &thread_cache[size_class];
+    if (count == 0 || !bin->head) {
+        return;
     }
 
-    if (n == 0) {
-        return NULL;
+    struct free_object *head = bin->head;
+    struct free_object *tail = head;
+    size_t moved = 1;
+    while (moved < count && tail->next) {
+        tail = tail->next;
+        moved++;
     }
 
-    if ((alignment & (alignment - 1)) || (alignment % sizeof(void *) != 0)) {
-        errno = EINVAL;
-        return NULL;
-    }
+    bin->head = tail->next;
+    bin->count -= moved;
+    central_free_batch(size_class, head, tail);
+}
 
-    if (n % sizeof(uint64_t) != 0) {
-        n = n - (n % sizeof(uint64_t)) + sizeof(uint64_t);
+void __malloc_thread_exit(void) {
+    for (size_t i = 0; i < MALLOC_SIZE_CLASS_COUNT; i++) {
+        thread_cache_flush(i, thread_cache[i].count);
     }
+    thread_cache_disabled = true;
+}
+#endif /* MALLOC_THREAD_CACHE */
+
+static void *allocate_small(size_t size_class) {
+    struct free_object *object;
+
+#ifdef MALLOC_THREAD_CACHE
+    if (thread_cache_usable()) {
+        struct thread_cache_bin *bin = &thread_cache[size_class];
+        if (!bin->head) {
+            bin->count = central_allocate_batch(size_class, &bin->head, thread_cache_capacity(size_class) / 2);
+            if (!bin->head) {
+                return NULL;
+            }
+        }
 
-    n = MAX(n, 16);
-
-    __lock(&__malloc_lock);
-#endif /* defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG) */
-
-    if (!start) {
-        start = sbrk(NUM_PAGES_IN_LENGTH(NEW_BLOCK_SIZE(n)));
-        heap_end = ((uintptr_t) start) + NUM_PAGES_IN_LENGTH(NEW_BLOCK_SIZE(n)) * PAGE_SIZE;
-        start->prev_size = 0;
-        start->size = n;
-        start->magic = __MALLOC_MAGIG_CHECK;
-
-        start = NEXT_BLOCK(start);
-        start->prev_size = n;
-        start->magic = __MALLOC_MAGIG_CHECK;
-        start = PREV_BLOCK(start);
+        object = bin->head;
+        bin->head = object->next;
+        bin->count--;
+        return object;
     }
+#endif /* MALLOC_THREAD_CACHE */
 
-    struct metadata *block = start;
-    while (block->size != 0) {
-        assert(block->magic == __MALLOC_MAGIG_CHECK);
-        if (!IS_ALLOCATED(block) && !((uintptr_t) (block + 1) % PAGE_SIZE == 0)) {
-            if (((uintptr_t) (block + 1)) % alignment == 0) {
-                if (GET_SIZE(block) >= n) {
-                    SET_ALLOCATED(block);
+    if (!central_allocate_batch(size_class, &object, 1)) {
+        return NULL;
+    }
+    return object;
+}
 
-#ifdef __is_libk
-                    g_kmalloc_stats.alloc_count++;
-#endif /* __is_libk */
+static void free_small(struct chunk *chunk) {
+    size_t size_class = chunk->kind;
+    struct free_object *object = CHUNK_POINTER(chunk);
 
-                    __unlock(&__malloc_lock);
+#ifdef MALLOC_THREAD_CACHE
+    if (thread_cache_usable()) {
+        struct thread_cache_bin *bin = &thread_cache[size_class];
+        object->next = bin->head;
+        bin->head = object;
+        bin->count++;
 
-#if defined(KERNEL_MALLOC_DEBUG) && defined(__is_libk)
-                    debug_log("~Malloc block allocated: [ %p, %d ]\n", (block + 1), __LINE__);
-#endif /* KERNEL_MALLOC_DEBUG && __is_libk */
+        size_t capacity = thread_cache_capacity(size_class);
+        if (bin->count > capacity) {
+            thread_cache_flush(size_class, capacity / 2);
+        }
+        return;
+    }
+#endif /* MALLOC_THREAD_CACHE */
 
-#ifdef MALLOC_SCRUB_ALLOC
-                    memset(block + 1, MALLOC_SCRUB_BITS, GET_SIZE(block));
-#endif /* MALLOC_SCRUB_ALLOC */
+    central_free_batch(size_class, object, object);
+}
 
-                    __malloc_debug("aligned_alloc: [ %lu, %lu, %p ]\n", alignment, n, block + 1);
-                    return block + 1;
-                }
+static void *allocate_large(size_t n) {
+    size_t length = ALIGN_UP(n + sizeof(struct chunk), PAGE_SIZE);
+    if (length < n) {
+        return NULL;
+    }
 
-                goto aligned_alloc_next;
-            }
+    struct chunk *chunk = allocate_large_pages(length / PAGE_SIZE);
+    if (!chunk) {
+        return NULL;
+    }
 
-            // FIXME: attempt to split a large block into smaller ones with alignment
-            goto aligned_alloc_next;
-        }
+    chunk->magic = __MALLOC_MAGIG_CHECK;
+    chunk->kind = CHUNK_LARGE;
+    chunk->length = length;
+    return CHUNK_POINTER(chunk);
+}
 
-    aligned_alloc_next:
-        block = NEXT_BLOCK(block);
+static size_t usable_size(struct chunk *chunk) {
+    if (IS_SMALL_CHUNK(chunk)) {
+        return class_to_size(chunk->kind);
+    }
+    if (chunk->kind == CHUNK_LARGE) {
+        return chunk->length - sizeof(struct chunk);
     }
 
-    struct metadata *new_block =
-        (struct metadata *) ((((uintptr_t) (block + 1)) + alignment - (((uintptr_t) (block + 1)) % alignment)) - sizeof(struct metadata));
-    assert(((uintptr_t) (new_block + 1)) % alignment == 0);
-    assert(new_block + 1 >= block + 1);
+    assert(chunk->kind == CHUNK_ALIGNED);
+    struct chunk *underlying = GET_CHUNK(((uintptr_t) CHUNK_POINTER(chunk)) - chunk->length);
+    return usable_size(underlying) - chunk->length;
+}
 
-    if (heap_end <= ((uintptr_t) new_block) + NEW_BLOCK_SIZE(n)) {
-        sbrk(NUM_PAGES_IN_LENGTH(((uintptr_t) new_block) + NEW_BLOCK_SIZE(n) - heap_end));
-        heap_end += NUM_PAGES_IN_LENGTH(((uintptr_t) new_block) + NEW_BLOCK_SIZE(n) - heap_end) * PAGE_SIZE;
+static void *do_malloc(size_t n) {
+    if (n == 0) {
+        return NULL;
     }
 
-    PREV_BLOCK(block)->size =
-        (((uintptr_t) new_block) - ((uintptr_t) PREV_BLOCK(block)) - sizeof(struct metadata)) | (PREV_BLOCK(block)->size & ALLOCATED);
-    assert(NEXT_BLOCK(PREV_BLOCK(block)) == new_block);
-    new_block->prev_size = PREV_BLOCK(block)->size & ~ALLOCATED;
-    new_block->magic = __MALLOC_MAGIG_CHECK;
+    void *ret = n <= MALLOC_MAX_SMALL_SIZE ? allocate_small(size_to_class(n)) : allocate_large(n);
+    if (!ret) {
+        set_enomem();
+        return NULL;
+    }
 
-    new_block->size = n;
-    SET_ALLOCATED(new_block);
+    count_alloc();
 
 #ifdef MALLOC_SCRUB_ALLOC
-    memset(new_block + 1, MALLOC_SCRUB_BITS, GET_SIZE(new_block));
+    memset(ret, MALLOC_SCRUB_BITS, usable_size(GET_CHUNK(ret)));
 #endif /* MALLOC_SCRUB_ALLOC */
 
-    struct metadata *tail = NEXT_BLOCK(new_block);
-    tail->prev_size = GET_SIZE(new_block);
-    tail->size = 0;
-    tail->magic = __MALLOC_MAGIG_CHECK;
+    return ret;
+}
 
+static void do_free(void *p) {
+    struct chunk *chunk = GET_CHUNK(p);
+    if (chunk->magic != __MALLOC_MAGIG_CHECK) {
 #if defined(KERNEL_MALLOC_DEBUG) && defined(__is_libk)
-    debug_log("~Malloc block allocated: [ %p, %d ]\n", (new_block + 1), __LINE__);
+        debug_log("~Free detected invalid block: [ %p, %p ]\n", chunk, p);
 #endif /* KERNEL_MALLOC_DEBUG && __is_libk */
+        assert(chunk->magic == __MALLOC_MAGIG_CHECK);
+    }
 
-#ifdef __is_libk
-    g_kmalloc_stats.alloc_count++;
-#endif /* __is_libk */
+    if (chunk->kind == CHUNK_ALIGNED) {
+        do_free((void *) (((uintptr_t) p) - chunk->length));
+        return;
+    }
 
-    __unlock(&__malloc_lock);
+    count_free();
 
-    __malloc_debug("aligned_alloc: [ %lu, %lu, %p ]\n", alignment, n, new_block + 1);
-    return new_block + 1;
-}
+#ifdef MALLOC_SCRUB_FREE
+    memset(p, FREE_SCRUB_BITS, usable_size(chunk));
+#endif /* MALLOC_SCRUB_FREE */
 
-#if defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG)
-#include <kernel/hal/output.h>
-#undef malloc
-void *malloc(size_t n, int line, const char *func) {
-    debug_log("~Malloc: [ %s, %d ]\n", func, line);
+    if (IS_SMALL_CHUNK(chunk)) {
+        free_small(chunk);
+        return;
+    }
 
-    __lock(&__malloc_lock);
-    struct metadata *_block = start;
-    while (_block != NULL && _block->size != 0) {
-        if (_block->magic != __MALLOC_MAGIG_CHECK) {
-            debug_log("~Error at address: [ %p ]\n", _block + 1);
-            assert(_block->magic == __MALLOC_MAGIG_CHECK);
-        }
-        _block = NEXT_BLOCK(_block);
+    assert(chunk->kind == CHUNK_LARGE);
+    free_large_pages(chunk, chunk->length / PAGE_SIZE);
+}
+
+static void *do_aligned_alloc(size_t alignment, size_t n) {
+    if (alignment <= MALLOC_ALIGNMENT) {
+        return do_malloc(n);
     }
 
-    if (n == 0) {
-        __unlock(&__malloc_lock);
+    // Over-allocate, and then place a forwarding header directly before the first suitably
+    // aligned address. Since every allocation is already MALLOC_ALIGNMENT aligned, there is
+    // always room for the extra header.
+    if (n > SIZE_MAX - alignment - sizeof(struct chunk)) {
+        set_enomem();
         return NULL;
     }
-    if (n % sizeof(uint64_t) != 0) {
-        n = n - (n % sizeof(uint64_t)) + sizeof(uint64_t);
-    }
-#else
-void *malloc(size_t n) {
-    if (n == 0) {
+
+    void *base = do_malloc(n + alignment + sizeof(struct chunk));
+    if (!base) {
         return NULL;
     }
-    if (n % sizeof(uint64_t) != 0) {
-        n = n - (n % sizeof(uint64_t)) + sizeof(uint64_t);
-    }
-
-    __lock(&__malloc_lock);
-#endif /* __is_libk && KERNEL_MALLOC_DEBUG */
 
-    if (!start) {
-        start = sbrk(NUM_PAGES_IN_LENGTH(NEW_BLOCK_SIZE(n)));
-        heap_end = ((uintptr_t) start) + NUM_PAGES_IN_LENGTH(NEW_BLOCK_SIZE(n)) * PAGE_SIZE;
-        start->prev_size = 0;
-        start->size = n;
-        SET_ALLOCATED(start);
-        start->magic = __MALLOC_MAGIG_CHECK;
+    if (((uintptr_t) base) % alignment == 0) {
+        return base;
+    }
 
-        start = NEXT_BLOCK(start);
-        start->prev_size = n;
-        start->magic = __MALLOC_MAGIG_CHECK;
-        start = PREV_BLOCK(start);
+    uintptr_t aligned = ALIGN_UP(((uintptr_t) base) + sizeof(struct chunk), alignment);
+    struct chunk *chunk = GET_CHUNK(aligned);
+    chunk->magic = __MALLOC_MAGIG_CHECK;
+    chunk->kind = CHUNK_ALIGNED;
+    chunk->length = aligned - (uintptr_t) base;
+    return (void *) aligned;
+}
 
-#ifdef __is_libk
-        g_kmalloc_stats.alloc_count++;
-#endif /* __is_libk */
+#if defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG)
+#undef calloc
+void *calloc(size_t n, size_t sz, int line, const char *func) {
+    debug_log("~Calloc: [ %s, %d ]\n", func, line);
+#else
+void *calloc(size_t n, size_t sz) {
+#endif /* __is_libk && KERNEL_MALLOC_DEBUG */
+    size_t total;
+    if (__builtin_mul_overflow(n, sz, &total)) {
+        set_enomem();
+        return NULL;
+    }
 
-        __unlock(&__malloc_lock);
+    void *p = do_malloc(total);
+    if (p == NULL) {
+        return p;
+    }
+    memset(p, 0, total);
+    return p;
+}
 
-#if defined(KERNEL_MALLOC_DEBUG) && defined(__is_libk)
-        debug_log("~Malloc block allocated: [ %p, %d ]\n", start, __LINE__);
-#endif /* KERNEL_MALLOC_DEBUG && __is_libk */
+#if defined(__is_libk) && (defined(KERNEL_MALLOC_DEBUG) || defined(KERNEL_MEMCPY_DEBUG))
+#include <kernel/hal/output.h>
+#undef realloc
+void *realloc(void *p, size_t sz, int line, const char *func) {
+    debug_log("~Realloc: [ %s, %d ]\n", func, line);
+#else
+void *realloc(void *p, size_t sz) {
+#endif /* defined(__is_libk) && (defined(KERNEL_MALLOC_DEBUG) || defined(KERNEL_MEMCPY_DEBUG)) */
+    __malloc_debug("Realloc: [ %p, %lu ]\n", p, sz);
 
-#ifdef MALLOC_SCRUB_ALLOC
-        memset(start + 1, MALLOC_SCRUB_BITS, GET_SIZE(start));
-#endif /* MALLOC_SCRUB_ALLOC */
+    if (p == NULL) {
+        return do_malloc(sz);
+    }
 
-        last_allocated = start;
-        __malloc_debug("malloc: [ %lu, %p ]\n", n, start + 1);
-        return start + 1;
+    // Shrinking (or growing within the slack of the current size class) can be done in place,
+    // as long as it doesn't leave most of a small object unused.
+    size_t old_size = usable_size(GET_CHUNK(p));
+    if (sz != 0 && sz <= old_size && (sz > MALLOC_MAX_SMALL_SIZE || sz >= old_size / 2)) {
+        return p;
     }
 
-    struct metadata *block = last_allocated ? last_allocated : start;
-    while (block->size != 0) {
-        assert(block->magic == __MALLOC_MAGIG_CHECK);
-        if (!IS_ALLOCATED(block) && GET_SIZE(block) >= n && ((uintptr_t) (block + 1)) % PAGE_SIZE != 0) {
-            SET_ALLOCATED(block);
-            last_allocated = block;
+    void *new_p = do_malloc(sz);
+    if (new_p == NULL) {
+        return new_p;
+    }
 
-#ifdef __is_libk
-            g_kmalloc_stats.alloc_count++;
-#endif /* __is_libk */
+    size_t size_to_copy = MIN(old_size, sz);
+#if defined(__is_libk) && defined(KERNEL_MEMCPY_DEBUG)
+#undef memmove
+    memmove(new_p, p, size_to_copy, line, func);
+#else
+    memmove(new_p, p, size_to_copy);
+#endif /* defined(__is_libk) && defined(KERNEL_MEMCPY_DEBUG) */
+    do_free(p);
+    return new_p;
+}
 
-            __unlock(&__malloc_lock);
+#if defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG)
+#include <kernel/hal/output.h>
+#undef free
+void free(void *p, int line, const char *func) {
+    debug_log("~Free: [ %s, %d, %p, %p ]\n", func, line, p, p ? GET_CHUNK(p) : NULL);
+#else
+void free(void *p) {
+#endif /* __is_libk && KERNEL_MALLOC_DEBUG */
+    if (p == NULL) {
+        return;
+    }
 
-#if defined(KERNEL_MALLOC_DEBUG) && defined(__is_libk)
-            debug_log("~Malloc block allocated: [ %p, %d ]\n", (block + 1), __LINE__);
-#endif /* KERNEL_MALLOC_DEBUG && __is_libk */
+    __malloc_debug("free: [ %p, %lu ]\n", p, usable_size(GET_CHUNK(p)));
+    do_free(p);
+}
 
-#ifdef MALLOC_SCRUB_ALLOC
-            memset(block + 1, MALLOC_SCRUB_BITS, GET_SIZE(block));
-#endif /* MALLOC_SCRUB_ALLOC */
+#if defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG)
+#undef aligned_alloc
+void *aligned_alloc(size_t alignment, size_t n, int line, const char *func) {
+    debug_log("~Aligned alloc: [ %s, %d ]\n", func, line);
+#else
+__attribute__((weak)) void *aligned_alloc(size_t alignment, size_t n) {
+#endif /* defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG) */
+    // Maybe this should error instead...
+    if (alignment == 0) {
+        return do_malloc(n);
+    }
 
-            __malloc_debug("malloc: [ %lu, %p ]\n", n, block + 1);
-            return block + 1;
-        }
-        block = NEXT_BLOCK(block);
+    if (n == 0) {
+        return NULL;
     }
 
-    if (((uintptr_t) block) + NEW_BLOCK_SIZE(n) > heap_end) {
-        sbrk(NUM_PAGES_IN_LENGTH(((uintptr_t) block) + NEW_BLOCK_SIZE(n) - heap_end));
-        heap_end += NUM_PAGES_IN_LENGTH(((uintptr_t) block) + NEW_BLOCK_SIZE(n) - heap_end) * PAGE_SIZE;
+    if ((alignment & (alignment - 1)) || (alignment % sizeof(void *) != 0)) {
+        errno = EINVAL;
+        return NULL;
     }
 
-    block->size = n;
-    SET_ALLOCATED(block);
-    last_allocated = block;
-    block = NEXT_BLOCK(block);
-    block->prev_size = n;
-    block->magic = __MALLOC_MAGIG_CHECK;
-    struct metadata *ret = PREV_BLOCK(block) + 1;
+    void *ret = do_aligned_alloc(alignment, n);
 
 #if defined(KERNEL_MALLOC_DEBUG) && defined(__is_libk)
-    debug_log("~Malloc block allocated: [ %p, %d ]\n", (block + 1), __LINE__);
+    debug_log("~Malloc block allocated: [ %p, %d ]\n", ret, __LINE__);
 #endif /* KERNEL_MALLOC_DEBUG && __is_libk */
 
-#ifdef __is_libk
-    g_kmalloc_stats.alloc_count++;
-#endif /* __is_libk */
+    __malloc_debug("aligned_alloc: [ %lu, %lu, %p ]\n", alignment, n, ret);
+    return ret;
+}
 
-    __unlock(&__malloc_lock);
+#if defined(__is_libk) && defined(KERNEL_MALLOC_DEBUG)
+#include <kernel/hal/output.h>
+#undef malloc
+void *malloc(size_t n, int line, const char *func) {
+    debug_log("~Malloc: [ %s, %d ]\n", func, line);
+#else
+void *malloc(size_t n) {
+#endif /* __is_libk && KERNEL_MALLOC_DEBUG */
+    void *ret = do_malloc(n);
 
-#ifdef MALLOC_SCRUB_ALLOC
-    memset(ret, MALLOC_SCRUB_BITS, GET_SIZE(ret - 1));
-#endif /* MALLOC_SCRUB_ALLOC */
+#if defined(KERNEL_MALLOC_DEBUG) && defined(__is_libk)
+    debug_log("~Malloc block allocated: [ %p, %d ]\n", ret, __LINE__);
+#endif /* KERNEL_MALLOC_DEBUG && __is_libk */
 
     __malloc_debug("malloc: [ %lu, %p ]\n", n, ret);
     return ret;
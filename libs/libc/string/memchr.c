@@ -1,14 +1,116 @@
+#include <bits/cpu_features.h>
 #include <string.h>
 
-void *memchr(const void *s, int c, size_t n) {
+#include "word.h"
+
+#ifdef __HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif /* __HAVE_CPU_DISPATCH */
+
+static void *memchr_generic(const void *s, int c, size_t n) {
     const unsigned char *buffer = (const unsigned char *) s;
     unsigned char val = (unsigned char) c;
 
-    for (size_t i = 0; i < n; i++) {
-        if (buffer[i] == val) {
-            return (char *) buffer + i;
+    for (; n > 0 && !IS_WORD_ALIGNED(buffer); n--, buffer++) {
+        if (*buffer == val) {
+            return (char *) buffer;
+        }
+    }
+
+    word_t pattern = WORD_REPEAT(val);
+    for (; n >= WORD_SIZE; n -= WORD_SIZE, buffer += WORD_SIZE) {
+        if (WORD_HAS_ZERO((load_word(buffer) ^ pattern))) {
+            break;
+        }
+    }
+
+    for (; n > 0; n--, buffer++) {
+        if (*buffer == val) {
+            return (char *) buffer;
         }
     }
 
     return NULL;
 }
+
+#ifdef __HAVE_CPU_DISPATCH
+// The vector versions only ever load aligned blocks, so they can't fault by reading past the end
+// of the buffer. Matches that lie outside the buffer are discarded by checking them against n.
+__attribute__((target("sse2"))) static void *memchr_sse2(const void *s, int c, size_t n) {
+    if (n == 0) {
+        return NULL;
+    }
+
+    const unsigned char *buffer = (const unsigned char *) s;
+    __m128i pattern = _mm_set1_epi8((char) c);
+
+    size_t misalignment = (uintptr_t) buffer % 16;
+    const unsigned char *block = buffer - misalignment;
+    unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i *) block), pattern));
+    mask >>= misalignment;
+
+    size_t offset = 0;
+    for (;;) {
+        if (mask) {
+            offset += __builtin_ctz(mask);
+            return offset < n ? (void *) (buffer + offset) : NULL;
+        }
+
+        block += 16;
+        offset = block - buffer;
+        if (offset >= n) {
+            return NULL;
+        }
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i *) block), pattern));
+    }
+}
+
+__attribute__((target("avx2"))) static void *memchr_avx2(const void *s, int c, size_t n) {
+    if (n == 0) {
+        return NULL;
+    }
+
+    const unsigned char *buffer = (const unsigned char *) s;
+    __m256i pattern = _mm256_set1_epi8((char) c);
+
+    size_t misalignment = (uintptr_t) buffer % 32;
+    const unsigned char *block = buffer - misalignment;
+    uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *) block), pattern));
+    mask >>= misalignment;
+
+    size_t offset = 0;
+    for (;;) {
+        if (mask) {
+            offset += __builtin_ctz(mask);
+            return offset < n ? (void *) (buffer + offset) : NULL;
+        }
+
+        block += 32;
+        offset = block - buffer;
+        if (offset >= n) {
+            return NULL;
+        }
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *) block), pattern));
+    }
+}
+
+static void *memchr_resolve(const void *s, int c, size_t n);
+static void *(*memchr_impl)(const void *s, int c, size_t n) = memchr_resolve;
+
+static void *memchr_resolve(const void *s, int c, size_t n) {
+    unsigned int features = __cpu_features();
+    void *(*impl)(const void *, int, size_t) = (features & __CPU_FEATURE_AVX2)   ? memchr_avx2
+                                               : (features & __CPU_FEATURE_SSE2) ? memchr_sse2
+                                                                                 : memchr_generic;
+    __atomic_store_n(&memchr_impl, impl, __ATOMIC_RELAXED);
+    return impl(s, c, n);
+}
+#endif /* __HAVE_CPU_DISPATCH */
+
+void *memchr(const void *s, int c, size_t n) {
+#ifdef __HAVE_CPU_DISPATCH
+    return __atomic_load_n(&memchr_impl, __ATOMIC_RELAXED)(s, c, n);
+#else
+    return memchr_generic(s, c, n);
+#endif /* __HAVE_CPU_DISPATCH */
+}
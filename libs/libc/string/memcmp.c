@@ -1,8 +1,13 @@
+#include <bits/cpu_features.h>
 #include <string.h>
 
-int memcmp(const void *s1, const void *s2, size_t n) {
-    const unsigned char *a = (const unsigned char *) s1;
-    const unsigned char *b = (const unsigned char *) s2;
+#include "word.h"
+
+#ifdef __HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif /* __HAVE_CPU_DISPATCH */
+
+static int memcmp_bytes(const unsigned char *a, const unsigned char *b, size_t n) {
     for (size_t i = 0; i < n; i++) {
         if (a[i] < b[i]) {
             return -1;
@@ -12,3 +17,101 @@ int memcmp(const void *s1, const void *s2, size_t n) {
     }
     return 0;
 }
+
+static int memcmp_generic(const void *s1, const void *s2, size_t n) {
+    const unsigned char *a = (const unsigned char *) s1;
+    const unsigned char *b = (const unsigned char *) s2;
+
+    // Skip over equal words, and then let the byte loop find the exact difference.
+    for (; n >= WORD_SIZE; n -= WORD_SIZE, a += WORD_SIZE, b += WORD_SIZE) {
+        if (load_word(a) != load_word(b)) {
+            break;
+        }
+    }
+    return memcmp_bytes(a, b, n);
+}
+
+#ifdef __HAVE_CPU_DISPATCH
+static inline int memcmp_difference(const unsigned char *a, const unsigned char *b, size_t index) {
+    return a[index] < b[index] ? -1 : 1;
+}
+
+__attribute__((target("sse2"))) static int memcmp_sse2(const void *s1, const void *s2, size_t n) {
+    const unsigned char *a = (const unsigned char *) s1;
+    const unsigned char *b = (const unsigned char *) s2;
+    if (n < 16) {
+        return memcmp_generic(a, b, n);
+    }
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFFU;
+        if (mask) {
+            return memcmp_difference(a, b, i + __builtin_ctz(mask));
+        }
+    }
+
+    // The final block overlaps bytes which are already known to be equal.
+    if (i < n) {
+        i = n - 16;
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFFU;
+        if (mask) {
+            return memcmp_difference(a, b, i + __builtin_ctz(mask));
+        }
+    }
+    return 0;
+}
+
+__attribute__((target("avx2"))) static int memcmp_avx2(const void *s1, const void *s2, size_t n) {
+    const unsigned char *a = (const unsigned char *) s1;
+    const unsigned char *b = (const unsigned char *) s2;
+    if (n < 32) {
+        return memcmp_sse2(a, b, n);
+    }
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (b + i));
+        uint32_t mask = ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (mask) {
+            return memcmp_difference(a, b, i + __builtin_ctz(mask));
+        }
+    }
+
+    if (i < n) {
+        i = n - 32;
+        __m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (b + i));
+        uint32_t mask = ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (mask) {
+            return memcmp_difference(a, b, i + __builtin_ctz(mask));
+        }
+    }
+    return 0;
+}
+
+static int memcmp_resolve(const void *s1, const void *s2, size_t n);
+static int (*memcmp_impl)(const void *s1, const void *s2, size_t n) = memcmp_resolve;
+
+static int memcmp_resolve(const void *s1, const void *s2, size_t n) {
+    unsigned int features = __cpu_features();
+    int (*impl)(const void *, const void *, size_t) = (features & __CPU_FEATURE_AVX2)   ? memcmp_avx2
+                                                      : (features & __CPU_FEATURE_SSE2) ? memcmp_sse2
+                                                                                        : memcmp_generic;
+    __atomic_store_n(&memcmp_impl, impl, __ATOMIC_RELAXED);
+    return impl(s1, s2, n);
+}
+#endif /* __HAVE_CPU_DISPATCH */
+
+int memcmp(const void *s1, const void *s2, size_t n) {
+#ifdef __HAVE_CPU_DISPATCH
+    return __atomic_load_n(&memcmp_impl, __ATOMIC_RELAXED)(s1, s2, n);
+#else
+    return memcmp_generic(s1, s2, n);
+#endif /* __HAVE_CPU_DISPATCH */
+}
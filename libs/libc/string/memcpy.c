@@ -1,5 +1,92 @@
+#include <bits/cpu_features.h>
 #include <string.h>
 
+#include "word.h"
+
+#ifdef __HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif /* __HAVE_CPU_DISPATCH */
+
+static void *memcpy_generic(void *__restrict dest, const void *__restrict src, size_t n) {
+    unsigned char *buffer = (unsigned char *) dest;
+    const unsigned char *source = (const unsigned char *) src;
+    if (n < 16) {
+        copy_small(buffer, source, n);
+        return dest;
+    }
+
+    // Align the destination, and then copy a word at a time. The source may still be misaligned, which load_word()
+    // allows for.
+    for (; !IS_WORD_ALIGNED(buffer); n--) {
+        *buffer++ = *source++;
+    }
+    for (; n >= WORD_SIZE; n -= WORD_SIZE, buffer += WORD_SIZE, source += WORD_SIZE) {
+        store_word(buffer, load_word(source));
+    }
+    copy_small(buffer, source, n);
+    return dest;
+}
+
+#ifdef __HAVE_CPU_DISPATCH
+__attribute__((target("sse2"))) static void *memcpy_sse2(void *__restrict dest, const void *__restrict src, size_t n) {
+    unsigned char *buffer = (unsigned char *) dest;
+    const unsigned char *source = (const unsigned char *) src;
+    if (n < 16) {
+        copy_small(buffer, source, n);
+        return dest;
+    }
+
+    // The unaligned head and tail are copied with overlapping stores, and everything in between with aligned stores.
+    __m128i head = _mm_loadu_si128((const __m128i *) source);
+    __m128i tail = _mm_loadu_si128((const __m128i *) (source + n - 16));
+    unsigned char *buffer_end = buffer + n - 16;
+
+    size_t skip = 16 - ((uintptr_t) buffer % 16);
+    _mm_storeu_si128((__m128i *) buffer, head);
+    buffer += skip;
+    source += skip;
+    for (; buffer < buffer_end; buffer += 16, source += 16) {
+        _mm_store_si128((__m128i *) buffer, _mm_loadu_si128((const __m128i *) source));
+    }
+    _mm_storeu_si128((__m128i *) buffer_end, tail);
+    return dest;
+}
+
+__attribute__((target("avx2"))) static void *memcpy_avx2(void *__restrict dest, const void *__restrict src, size_t n) {
+    unsigned char *buffer = (unsigned char *) dest;
+    const unsigned char *source = (const unsigned char *) src;
+    if (n < 32) {
+        return memcpy_sse2(dest, src, n);
+    }
+
+    __m256i head = _mm256_loadu_si256((const __m256i *) source);
+    __m256i tail = _mm256_loadu_si256((const __m256i *) (source + n - 32));
+    unsigned char *buffer_end = buffer + n - 32;
+
+    size_t skip = 32 - ((uintptr_t) buffer % 32);
+    _mm256_storeu_si256((__m256i *) buffer, head);
+    buffer += skip;
+    source += skip;
+    for (; buffer < buffer_end; buffer += 32, source += 32) {
+        _mm256_store_si256((__m256i *) buffer, _mm256_loadu_si256((const __m256i *) source));
+    }
+    _mm256_storeu_si256((__m256i *) buffer_end, tail);
+    return dest;
+}
+
+static void *memcpy_resolve(void *__restrict dest, const void *__restrict src, size_t n);
+static void *(*memcpy_impl)(void *__restrict dest, const void *__restrict src, size_t n) = memcpy_resolve;
+
+static void *memcpy_resolve(void *__restrict dest, const void *__restrict src, size_t n) {
+    unsigned int features = __cpu_features();
+    void *(*impl)(void *__restrict, const void *__restrict, size_t) = (features & __CPU_FEATURE_AVX2)   ? memcpy_avx2
+                                                                      : (features & __CPU_FEATURE_SSE2) ? memcpy_sse2
+                                                                                                        : memcpy_generic;
+    __atomic_store_n(&memcpy_impl, impl, __ATOMIC_RELAXED);
+    return impl(dest, src, n);
+}
+#endif /* __HAVE_CPU_DISPATCH */
+
 #if (defined(__is_kernel) || defined(__is_libk)) && defined(KERNEL_MEMCPY_DEBUG)
 #include <stdint.h>
 #include <kernel/hal/output.h>
@@ -10,10 +97,9 @@ void *memcpy(void *__restrict dest, const void *__restrict src, size_t n, int li
 #else
 void *memcpy(void *__restrict dest, const void *__restrict src, size_t n) {
 #endif /* (defined(__is_kernel) || defined(__is_libk)) && defined(KERNEL_MEMCPY_DEBUG) */
-    unsigned char *buffer = (unsigned char *) dest;
-    const unsigned char *source = (const unsigned char *) src;
-    for (size_t i = 0; i < n; i++) {
-        buffer[i] = source[i];
-    }
-    return buffer;
+#ifdef __HAVE_CPU_DISPATCH
+    return __atomic_load_n(&memcpy_impl, __ATOMIC_RELAXED)(dest, src, n);
+#else
+    return memcpy_generic(dest, src, n);
+#endif /* __HAVE_CPU_DISPATCH */
 }
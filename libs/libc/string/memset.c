@@ -1,9 +1,89 @@
+#include <bits/cpu_features.h>
 #include <string.h>
 
-void *memset(void *s, int c, size_t n) {
+#include "word.h"
+
+#ifdef __HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif /* __HAVE_CPU_DISPATCH */
+
+static void *memset_generic(void *s, int c, size_t n) {
     unsigned char *buffer = (unsigned char *) s;
+    if (n < WORD_SIZE * 2) {
+        for (size_t i = 0; i < n; i++) {
+            buffer[i] = (unsigned char) c;
+        }
+        return s;
+    }
+
+    for (; !IS_WORD_ALIGNED(buffer); n--) {
+        *buffer++ = (unsigned char) c;
+    }
+
+    word_t value = WORD_REPEAT(c);
+    for (; n >= WORD_SIZE; n -= WORD_SIZE, buffer += WORD_SIZE) {
+        store_word(buffer, value);
+    }
     for (size_t i = 0; i < n; i++) {
         buffer[i] = (unsigned char) c;
     }
-    return buffer;
+    return s;
+}
+
+#ifdef __HAVE_CPU_DISPATCH
+__attribute__((target("sse2"))) static void *memset_sse2(void *s, int c, size_t n) {
+    unsigned char *buffer = (unsigned char *) s;
+    if (n < 16) {
+        return memset_generic(s, c, n);
+    }
+
+    __m128i value = _mm_set1_epi8((char) c);
+    unsigned char *buffer_end = buffer + n - 16;
+
+    _mm_storeu_si128((__m128i *) buffer, value);
+    buffer += 16 - ((uintptr_t) buffer % 16);
+    for (; buffer < buffer_end; buffer += 16) {
+        _mm_store_si128((__m128i *) buffer, value);
+    }
+    _mm_storeu_si128((__m128i *) buffer_end, value);
+    return s;
+}
+
+__attribute__((target("avx2"))) static void *memset_avx2(void *s, int c, size_t n) {
+    unsigned char *buffer = (unsigned char *) s;
+    if (n < 32) {
+        return memset_sse2(s, c, n);
+    }
+
+    __m256i value = _mm256_set1_epi8((char) c);
+    unsigned char *buffer_end = buffer + n - 32;
+
+    _mm256_storeu_si256((__m256i *) buffer, value);
+    buffer += 32 - ((uintptr_t) buffer % 32);
+    for (; buffer < buffer_end; buffer += 32) {
+        _mm256_store_si256((__m256i *) buffer, value);
+    }
+    _mm256_storeu_si256((__m256i *) buffer_end, value);
+    return s;
+}
+
+static void *memset_resolve(void *s, int c, size_t n);
+static void *(*memset_impl)(void *s, int c, size_t n) = memset_resolve;
+
+static void *memset_resolve(void *s, int c, size_t n) {
+    unsigned int features = __cpu_features();
+    void *(*impl)(void *, int, size_t) = (features & __CPU_FEATURE_AVX2)   ? memset_avx2
+                                         : (features & __CPU_FEATURE_SSE2) ? memset_sse2
+                                                                           : memset_generic;
+    __atomic_store_n(&memset_impl, impl, __ATOMIC_RELAXED);
+    return impl(s, c, n);
+}
+#endif /* __HAVE_CPU_DISPATCH */
+
+void *memset(void *s, int c, size_t n) {
+#ifdef __HAVE_CPU_DISPATCH
+    return __atomic_load_n(&memset_impl, __ATOMIC_RELAXED)(s, c, n);
+#else
+    return memset_generic(s, c, n);
+#endif /* __HAVE_CPU_DISPATCH */
 }
@@ -1,14 +1,100 @@
+#include <bits/cpu_features.h>
 #include <string.h>
 
-char *strchr(const char *s, int c) {
+#include "word.h"
+
+#ifdef __HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif /* __HAVE_CPU_DISPATCH */
+
+static char *strchr_generic(const char *s, int c) {
     char val = (char) c;
 
-    size_t i;
-    for (i = 0; s[i] != '\0'; i++) {
-        if (s[i] == val) {
-            return (char *) s + i;
+    for (; !IS_WORD_ALIGNED(s); s++) {
+        if (*s == val) {
+            return (char *) s;
+        }
+        if (*s == '\0') {
+            return NULL;
+        }
+    }
+
+    word_t pattern = WORD_REPEAT(val);
+    for (;; s += WORD_SIZE) {
+        word_t word = load_word(s);
+        if (WORD_HAS_ZERO(word) || WORD_HAS_ZERO(word ^ pattern)) {
+            break;
         }
     }
 
-    return NULL;
+    for (; *s != val; s++) {
+        if (*s == '\0') {
+            return NULL;
+        }
+    }
+    return (char *) s;
+}
+
+#ifdef __HAVE_CPU_DISPATCH
+// Both the terminator and the character are searched for at once. Whichever comes first decides
+// the result, which also handles searching for the terminator itself.
+__attribute__((target("sse2"))) static char *strchr_sse2(const char *s, int c) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i pattern = _mm_set1_epi8((char) c);
+
+    size_t misalignment = (uintptr_t) s % 16;
+    const char *block = s - misalignment;
+    __m128i data = _mm_load_si128((const __m128i *) block);
+    unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(data, zero), _mm_cmpeq_epi8(data, pattern)));
+    mask = (mask >> misalignment) << misalignment;
+
+    while (!mask) {
+        block += 16;
+        data = _mm_load_si128((const __m128i *) block);
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(data, zero), _mm_cmpeq_epi8(data, pattern)));
+    }
+
+    const char *result = block + __builtin_ctz(mask);
+    return *result == (char) c ? (char *) result : NULL;
+}
+
+__attribute__((target("avx2"))) static char *strchr_avx2(const char *s, int c) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i pattern = _mm256_set1_epi8((char) c);
+
+    size_t misalignment = (uintptr_t) s % 32;
+    const char *block = s - misalignment;
+    __m256i data = _mm256_load_si256((const __m256i *) block);
+    uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(data, zero), _mm256_cmpeq_epi8(data, pattern)));
+    mask = (mask >> misalignment) << misalignment;
+
+    while (!mask) {
+        block += 32;
+        data = _mm256_load_si256((const __m256i *) block);
+        mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(data, zero), _mm256_cmpeq_epi8(data, pattern)));
+    }
+
+    const char *result = block + __builtin_ctz(mask);
+    return *result == (char) c ? (char *) result : NULL;
+}
+
+static char *strchr_resolve(const char *s, int c);
+static char *(*strchr_impl)(const char *s, int c) = strchr_resolve;
+
+static char *strchr_resolve(const char *s, int c) {
+    unsigned int features = __cpu_features();
+    char *(*impl)(const char *, int) = (features & __CPU_FEATURE_AVX2)   ? strchr_avx2
+                                       : (features & __CPU_FEATURE_SSE2) ? strchr_sse2
+                                                                         : strchr_generic;
+    __atomic_store_n(&strchr_impl, impl, __ATOMIC_RELAXED);
+    return impl(s, c);
+}
+#endif /* __HAVE_CPU_DISPATCH */
+
+char *strchr(const char *s, int c) {
+#ifdef __HAVE_CPU_DISPATCH
+    return __atomic_load_n(&strchr_impl, __ATOMIC_RELAXED)(s, c);
+#else
+    return strchr_generic(s, c);
+#endif /* __HAVE_CPU_DISPATCH */
 }
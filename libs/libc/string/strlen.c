@@ -1,9 +1,88 @@
+#include <bits/cpu_features.h>
 #include <string.h>
 
+#include "word.h"
+
+#ifdef __HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif /* __HAVE_CPU_DISPATCH */
+
+static size_t strlen_generic(const char *s) {
+    const char *iter = s;
+    for (; !IS_WORD_ALIGNED(iter); iter++) {
+        if (*iter == '\0') {
+            return iter - s;
+        }
+    }
+
+    while (!WORD_HAS_ZERO(load_word(iter))) {
+        iter += WORD_SIZE;
+    }
+
+    while (*iter != '\0') {
+        iter++;
+    }
+    return iter - s;
+}
+
+#ifdef __HAVE_CPU_DISPATCH
+__attribute__((target("sse2"))) static size_t strlen_sse2(const char *s) {
+    __m128i zero = _mm_setzero_si128();
+
+    size_t misalignment = (uintptr_t) s % 16;
+    const char *block = s - misalignment;
+    unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i *) block), zero));
+    mask >>= misalignment;
+    if (mask) {
+        return __builtin_ctz(mask);
+    }
+
+    for (;;) {
+        block += 16;
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i *) block), zero));
+        if (mask) {
+            return block - s + __builtin_ctz(mask);
+        }
+    }
+}
+
+__attribute__((target("avx2"))) static size_t strlen_avx2(const char *s) {
+    __m256i zero = _mm256_setzero_si256();
+
+    size_t misalignment = (uintptr_t) s % 32;
+    const char *block = s - misalignment;
+    uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *) block), zero));
+    mask >>= misalignment;
+    if (mask) {
+        return __builtin_ctz(mask);
+    }
+
+    for (;;) {
+        block += 32;
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *) block), zero));
+        if (mask) {
+            return block - s + __builtin_ctz(mask);
+        }
+    }
+}
+
+static size_t strlen_resolve(const char *s);
+static size_t (*strlen_impl)(const char *s) = strlen_resolve;
+
+static size_t strlen_resolve(const char *s) {
+    unsigned int features = __cpu_features();
+    size_t (*impl)(const char *) = (features & __CPU_FEATURE_AVX2)   ? strlen_avx2
+                                   : (features & __CPU_FEATURE_SSE2) ? strlen_sse2
+                                                                     : strlen_generic;
+    __atomic_store_n(&strlen_impl, impl, __ATOMIC_RELAXED);
+    return impl(s);
+}
+#endif /* __HAVE_CPU_DISPATCH */
+
 size_t strlen(const char *s) {
-    size_t i = 0;
-    while (s[i] != '\0') {
-        i++;
-    };
-    return i;
+#ifdef __HAVE_CPU_DISPATCH
+    return __atomic_load_n(&strlen_impl, __ATOMIC_RELAXED)(s);
+#else
+    return strlen_generic(s);
+#endif /* __HAVE_CPU_DISPATCH */
 }
@@ -0,0 +1,56 @@
+#ifndef _STRING_WORD_H
+#define _STRING_WORD_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Helpers for processing strings one machine word at a time. Scanning reads are always word
+// aligned, so they can never cross into an unmapped page, even when scanning past the end of a
+// string. All memory is accessed through the may_alias, byte-aligned types below, so the compiler
+// assumes neither alignment nor a particular type for the bytes being read.
+
+typedef size_t word_t;
+typedef size_t __attribute__((__may_alias__, __aligned__(1))) unaligned_word_t;
+typedef uint64_t __attribute__((__may_alias__, __aligned__(1))) unaligned_u64_t;
+typedef uint32_t __attribute__((__may_alias__, __aligned__(1))) unaligned_u32_t;
+typedef uint16_t __attribute__((__may_alias__, __aligned__(1))) unaligned_u16_t;
+
+#define WORD_SIZE       sizeof(word_t)
+#define WORD_ONES       ((word_t) -1 / 0xFF)
+#define WORD_HIGHS      (WORD_ONES * 0x80)
+#define WORD_REPEAT(c)  (WORD_ONES * (unsigned char) (c))
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+#define IS_WORD_ALIGNED(p) (((uintptr_t) (p)) % WORD_SIZE == 0)
+
+static inline word_t load_word(const void *p) {
+    return *(const unaligned_word_t *) p;
+}
+
+static inline void store_word(void *p, word_t w) {
+    *(unaligned_word_t *) p = w;
+}
+
+// Copies fewer than 16 bytes using (possibly overlapping) unaligned loads and stores.
+static inline void copy_small(unsigned char *__restrict dest, const unsigned char *__restrict src, size_t n) {
+    if (n >= 8) {
+        uint64_t head = *(const unaligned_u64_t *) src;
+        uint64_t tail = *(const unaligned_u64_t *) (src + n - 8);
+        *(unaligned_u64_t *) dest = head;
+        *(unaligned_u64_t *) (dest + n - 8) = tail;
+    } else if (n >= 4) {
+        uint32_t head = *(const unaligned_u32_t *) src;
+        uint32_t tail = *(const unaligned_u32_t *) (src + n - 4);
+        *(unaligned_u32_t *) dest = head;
+        *(unaligned_u32_t *) (dest + n - 4) = tail;
+    } else if (n >= 2) {
+        uint16_t head = *(const unaligned_u16_t *) src;
+        uint16_t tail = *(const unaligned_u16_t *) (src + n - 2);
+        *(unaligned_u16_t *) dest = head;
+        *(unaligned_u16_t *) (dest + n - 2) = tail;
+    } else if (n == 1) {
+        *dest = *src;
+    }
+}
+
+#endif /* _STRING_WORD_H */
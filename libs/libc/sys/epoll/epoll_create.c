@@ -0,0 +1,16 @@
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+int epoll_create(int size) {
+    if (size <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return epoll_create1(0);
+}
+
+int epoll_create1(int flags) {
+    int ret = (int) syscall(SYS_epoll_create, flags);
+    __SYSCALL_TO_ERRNO(ret);
+}
@@ -0,0 +1,8 @@
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+    int ret = (int) syscall(SYS_epoll_ctl, epfd, op, fd, event);
+    __SYSCALL_TO_ERRNO(ret);
+}
@@ -0,0 +1,14 @@
+#include <errno.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+int epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout, const sigset_t *sigmask) {
+    struct timespec ts = { .tv_sec = timeout / 1000, .tv_nsec = (timeout % 1000) * 1000000 };
+    int ret = (int) syscall(SYS_epoll_pwait, epfd, events, maxevents, timeout < 0 ? NULL : &ts, sigmask);
+    __SYSCALL_TO_ERRNO(ret);
+}
+
+int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+    return epoll_pwait(epfd, events, maxevents, timeout, NULL);
+}
@@ -2,7 +2,7 @@
 #include <sys/iros.h>
 #include <sys/syscall.h>
 
-int enable_profiling(pid_t pid) {
-    int ret = (int) syscall(SYS_enable_profiling, pid);
+int enable_profiling(pid_t pid, const struct profile_options *options) {
+    int ret = (int) syscall(SYS_enable_profiling, pid, options);
     __SYSCALL_TO_ERRNO(ret);
 }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <di/container/algorithm/partial_sort.h>
+#include <di/container/algorithm/sort.h>
+#include <di/container/concepts/prelude.h>
+#include <di/container/iterator/next.h>
+#include <di/container/meta/prelude.h>
+#include <di/function/compare.h>
+
+namespace di::container {
+namespace detail {
+    // This is an introselect built out of the same partitioning primitives as sort(). Only the side of
+    // the partition containing the nth element is processed, and if too many bad partitions occur the
+    // remaining range falls back to a heap based selection (partial_sort()).
+    struct NthElementFunction {
+        template<concepts::RandomAccessIterator It, concepts::SentinelFor<It> Sent, typename Comp = function::Compare,
+                 typename Proj = function::Identity>
+        requires(concepts::Sortable<It, Comp, Proj>)
+        constexpr It operator()(It first, It nth, Sent last, Comp comp = {}, Proj proj = {}) const {
+            auto last_it = container::next(first, last);
+            if (nth != last_it) {
+                impl(util::move(first), util::move(nth), last_it, comp, proj);
+            }
+            return last_it;
+        }
+
+        template<concepts::RandomAccessContainer Con, typename Comp = function::Compare, typename Proj = function::Identity>
+        requires(concepts::Sortable<meta::ContainerIterator<Con>, Comp, Proj>)
+        constexpr meta::BorrowedIterator<Con> operator()(Con&& container, meta::ContainerIterator<Con> nth, Comp comp = {},
+                                                         Proj proj = {}) const {
+            return (*this)(container::begin(container), util::move(nth), container::end(container), util::ref(comp), util::ref(proj));
+        }
+
+    private:
+        constexpr static void impl(auto first, auto nth, auto last, auto& comp, auto& proj) {
+            auto bad_partitions_allowed = decltype(last - first)(0);
+            for (auto n = last - first; n > 1; n /= 2) {
+                ++bad_partitions_allowed;
+            }
+
+            bool leftmost = true;
+            for (;;) {
+                auto size = last - first;
+                if (size < SortFunction::insertion_sort_threshold) {
+                    if (leftmost) {
+                        SortFunction::insertion_sort(first, last, comp, proj);
+                    } else {
+                        SortFunction::unguarded_insertion_sort(first, last, comp, proj);
+                    }
+                    return;
+                }
+
+                SortFunction::choose_pivot(first, last, comp, proj);
+
+                // Every element equal to the previous pivot is already in its final position.
+                if (!leftmost && !SortFunction::less(comp, proj, *(first - 1), *first)) {
+                    auto pivot_position = SortFunction::partition_left(first, last, comp, proj);
+                    if (nth <= pivot_position) {
+                        return;
+                    }
+                    first = pivot_position + 1;
+                    continue;
+                }
+
+                auto [pivot_position, already_partitioned] = SortFunction::partition_right(first, last, comp, proj);
+                (void) already_partitioned;
+
+                if (pivot_position == nth) {
+                    return;
+                }
+
+                auto left_size = pivot_position - first;
+                auto right_size = last - (pivot_position + 1);
+                if (left_size < size / 8 || right_size < size / 8) {
+                    if (--bad_partitions_allowed == 0) {
+                        if (nth < pivot_position) {
+                            last = pivot_position;
+                        } else {
+                            first = pivot_position + 1;
+                        }
+                        container::partial_sort(first, nth + 1, last, util::ref(comp), util::ref(proj));
+                        return;
+                    }
+
+                    SortFunction::break_patterns(first, pivot_position, last);
+                }
+
+                if (nth < pivot_position) {
+                    last = pivot_position;
+                } else {
+                    first = pivot_position + 1;
+                    leftmost = false;
+                }
+            }
+        }
+    };
+}
+
+constexpr inline auto nth_element = detail::NthElementFunction {};
+}
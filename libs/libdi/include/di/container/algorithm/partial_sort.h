@@ -0,0 +1,50 @@
+#pragma once
+
+#include <di/container/algorithm/make_heap.h>
+#include <di/container/algorithm/pop_heap.h>
+#include <di/container/algorithm/sort_heap.h>
+#include <di/container/concepts/prelude.h>
+#include <di/container/iterator/next.h>
+#include <di/container/meta/prelude.h>
+#include <di/function/compare.h>
+
+namespace di::container {
+namespace detail {
+    struct PartialSortFunction {
+        template<concepts::RandomAccessIterator It, concepts::SentinelFor<It> Sent, typename Comp = function::Compare,
+                 typename Proj = function::Identity>
+        requires(concepts::Sortable<It, Comp, Proj>)
+        constexpr It operator()(It first, It middle, Sent last, Comp comp = {}, Proj proj = {}) const {
+            if (first == middle) {
+                return container::next(first, last);
+            }
+
+            // Keep the smallest elements seen so far in a max heap, and replace the root whenever
+            // a smaller element is found.
+            container::make_heap(first, middle, util::ref(comp), util::ref(proj));
+
+            auto size = middle - first;
+            auto it = middle;
+            for (; it != last; ++it) {
+                if (function::invoke(comp, function::invoke(proj, *it), function::invoke(proj, *first)) < 0) {
+                    container::iterator_swap(it, first);
+                    PopHeapFunction::bubble_down(first, util::ref(comp), util::ref(proj), size, 0);
+                }
+            }
+
+            container::sort_heap(first, middle, util::ref(comp), util::ref(proj));
+            return it;
+        }
+
+        template<concepts::RandomAccessContainer Con, typename Comp = function::Compare, typename Proj = function::Identity>
+        requires(concepts::Sortable<meta::ContainerIterator<Con>, Comp, Proj>)
+        constexpr meta::BorrowedIterator<Con> operator()(Con&& container, meta::ContainerIterator<Con> middle, Comp comp = {},
+                                                         Proj proj = {}) const {
+            return (*this)(container::begin(container), util::move(middle), container::end(container), util::ref(comp),
+                           util::ref(proj));
+        }
+    };
+}
+
+constexpr inline auto partial_sort = detail::PartialSortFunction {};
+}
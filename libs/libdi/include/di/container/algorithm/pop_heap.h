@@ -25,6 +25,7 @@ namespace detail {
 
     private:
         friend struct MakeHeapFunction;
+        friend struct PartialSortFunction;
 
         constexpr static void bubble_down(auto first, auto comp, auto proj, auto size, decltype(size) index) {
             using IndexType = decltype(size);
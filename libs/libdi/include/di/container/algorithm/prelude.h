@@ -49,6 +49,8 @@
 #include <di/container/algorithm/mismatch.h>
 #include <di/container/algorithm/move_backward.h>
 #include <di/container/algorithm/none_of.h>
+#include <di/container/algorithm/nth_element.h>
+#include <di/container/algorithm/partial_sort.h>
 #include <di/container/algorithm/pop_heap.h>
 #include <di/container/algorithm/product.h>
 #include <di/container/algorithm/push_heap.h>
@@ -68,6 +70,7 @@
 #include <di/container/algorithm/shuffle.h>
 #include <di/container/algorithm/sort.h>
 #include <di/container/algorithm/sort_heap.h>
+#include <di/container/algorithm/stable_sort.h>
 #include <di/container/algorithm/starts_with.h>
 #include <di/container/algorithm/sum.h>
 #include <di/container/algorithm/swap_ranges.h>
@@ -117,6 +120,8 @@ using container::minmax;
 using container::minmax_element;
 using container::mismatch;
 using container::none_of;
+using container::nth_element;
+using container::partial_sort;
 using container::pop_heap;
 using container::product;
 using container::push_heap;
@@ -133,6 +138,7 @@ using container::search;
 using container::shuffle;
 using container::sort;
 using container::sort_heap;
+using container::stable_sort;
 using container::starts_with;
 using container::sum;
 using container::swap_ranges;
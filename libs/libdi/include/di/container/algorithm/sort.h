@@ -2,17 +2,27 @@
 
 #include <di/container/algorithm/make_heap.h>
 #include <di/container/algorithm/sort_heap.h>
+#include <di/container/concepts/prelude.h>
+#include <di/container/iterator/next.h>
+#include <di/container/meta/prelude.h>
+#include <di/function/compare.h>
+#include <di/util/move.h>
+#include <di/vocab/tuple/prelude.h>
 
 namespace di::container {
 namespace detail {
+    // This is a pattern-defeating quicksort (see https://arxiv.org/abs/2106.05123). It is an
+    // introsort which additionally detects already partitioned ranges and runs of equal elements,
+    // and shuffles elements around after a bad partition to break up adversarial patterns. If
+    // too many bad partitions occur anyway, it falls back to heap sort, keeping O(n log n).
     struct SortFunction {
         template<concepts::RandomAccessIterator It, concepts::SentinelFor<It> Sent, typename Comp = function::Compare,
                  typename Proj = function::Identity>
         requires(concepts::Sortable<It, Comp, Proj>)
         constexpr It operator()(It first, Sent last, Comp comp = {}, Proj proj = {}) const {
-            // FIXME: consider using quick sort instead of heap sort.
-            container::make_heap(first, last, util::ref(comp), util::ref(proj));
-            return container::sort_heap(first, last, util::ref(comp), util::ref(proj));
+            auto last_it = container::next(first, last);
+            impl(util::move(first), last_it, util::ref(comp), util::ref(proj));
+            return last_it;
         }
 
         template<concepts::RandomAccessContainer Con, typename Comp = function::Compare, typename Proj = function::Identity>
@@ -20,8 +30,281 @@ namespace detail {
         constexpr meta::BorrowedIterator<Con> operator()(Con&& container, Comp comp = {}, Proj proj = {}) const {
             return (*this)(container::begin(container), container::end(container), util::ref(comp), util::ref(proj));
         }
+
+    private:
+        friend struct NthElementFunction;
+        friend struct StableSortFunction;
+
+        // Ranges smaller than this are insertion sorted.
+        constexpr static auto insertion_sort_threshold = 24;
+
+        // Ranges larger than this use a pseudo-median of nine to pick their pivot.
+        constexpr static auto ninther_threshold = 128;
+
+        // Once this many elements have been moved, a partial insertion sort gives up.
+        constexpr static auto partial_insertion_sort_limit = 8;
+
+        constexpr static bool less(auto& comp, auto& proj, auto&& a, auto&& b) {
+            return function::invoke(comp, function::invoke(proj, a), function::invoke(proj, b)) < 0;
+        }
+
+        constexpr static void impl(auto first, auto last, auto comp, auto proj) {
+            auto size = last - first;
+            if (size < 2) {
+                return;
+            }
+
+            auto bad_partitions_allowed = decltype(size)(0);
+            for (auto n = size; n > 1; n /= 2) {
+                ++bad_partitions_allowed;
+            }
+            loop(util::move(first), util::move(last), comp, proj, bad_partitions_allowed, true);
+        }
+
+        constexpr static void insertion_sort(auto first, auto last, auto& comp, auto& proj) {
+            using Value = meta::IteratorValue<decltype(first)>;
+
+            if (first == last) {
+                return;
+            }
+
+            for (auto it = first + 1; it != last; ++it) {
+                auto sift = it;
+                auto sift_prev = it - 1;
+                if (less(comp, proj, *sift, *sift_prev)) {
+                    Value value = container::iterator_move(sift);
+                    do {
+                        *sift-- = container::iterator_move(sift_prev);
+                    } while (sift != first && less(comp, proj, value, *--sift_prev));
+                    *sift = util::move(value);
+                }
+            }
+        }
+
+        // Insertion sort which assumes that the element directly before first is not greater than
+        // any element in the range, which allows skipping the bounds check in the inner loop.
+        constexpr static void unguarded_insertion_sort(auto first, auto last, auto& comp, auto& proj) {
+            using Value = meta::IteratorValue<decltype(first)>;
+
+            if (first == last) {
+                return;
+            }
+
+            for (auto it = first + 1; it != last; ++it) {
+                auto sift = it;
+                auto sift_prev = it - 1;
+                if (less(comp, proj, *sift, *sift_prev)) {
+                    Value value = container::iterator_move(sift);
+                    do {
+                        *sift-- = container::iterator_move(sift_prev);
+                    } while (less(comp, proj, value, *--sift_prev));
+                    *sift = util::move(value);
+                }
+            }
+        }
+
+        // Attempts to insertion sort the range, but gives up if more than a few elements need to be
+        // moved. Returns whether or not the range was fully sorted.
+        constexpr static bool partial_insertion_sort(auto first, auto last, auto& comp, auto& proj) {
+            using Value = meta::IteratorValue<decltype(first)>;
+
+            if (first == last) {
+                return true;
+            }
+
+            auto limit = decltype(last - first)(0);
+            for (auto it = first + 1; it != last; ++it) {
+                auto sift = it;
+                auto sift_prev = it - 1;
+                if (less(comp, proj, *sift, *sift_prev)) {
+                    Value value = container::iterator_move(sift);
+                    do {
+                        *sift-- = container::iterator_move(sift_prev);
+                    } while (sift != first && less(comp, proj, value, *--sift_prev));
+                    *sift = util::move(value);
+                    limit += it - sift;
+                }
+
+                if (limit > partial_insertion_sort_limit) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        constexpr static void sort2(auto a, auto b, auto& comp, auto& proj) {
+            if (less(comp, proj, *b, *a)) {
+                container::iterator_swap(a, b);
+            }
+        }
+
+        constexpr static void sort3(auto a, auto b, auto c, auto& comp, auto& proj) {
+            sort2(a, b, comp, proj);
+            sort2(b, c, comp, proj);
+            sort2(a, b, comp, proj);
+        }
+
+        // Moves a good pivot candidate to the start of the range. This also ensures that the last
+        // element of the range is not less than the pivot, which partition_right() relies on.
+        constexpr static void choose_pivot(auto first, auto last, auto& comp, auto& proj) {
+            auto size = last - first;
+            auto half = size / 2;
+            if (size > ninther_threshold) {
+                sort3(first, first + half, last - 1, comp, proj);
+                sort3(first + 1, first + (half - 1), last - 2, comp, proj);
+                sort3(first + 2, first + (half + 1), last - 3, comp, proj);
+                sort3(first + (half - 1), first + half, first + (half + 1), comp, proj);
+                container::iterator_swap(first, first + half);
+            } else {
+                sort3(first + half, first, last - 1, comp, proj);
+            }
+        }
+
+        // Partitions [first, last) around the pivot *first, placing elements equal to the pivot on the
+        // right. Returns the final position of the pivot, and whether the range was already partitioned.
+        constexpr static auto partition_right(auto first, auto last, auto& comp, auto& proj) {
+            using Value = meta::IteratorValue<decltype(first)>;
+
+            Value pivot = container::iterator_move(first);
+
+            auto left = first;
+            auto right = last;
+
+            // There is guaranteed to be an element not less than the pivot at the end of the range.
+            while (less(comp, proj, *++left, pivot)) {}
+
+            // If this is the first element not in place, there is no element less than the pivot
+            // to stop the search on the left, so the bounds check is needed.
+            if (left - 1 == first) {
+                while (left < right && !less(comp, proj, *--right, pivot)) {}
+            } else {
+                while (!less(comp, proj, *--right, pivot)) {}
+            }
+
+            bool already_partitioned = left >= right;
+            while (left < right) {
+                container::iterator_swap(left, right);
+                while (less(comp, proj, *++left, pivot)) {}
+                while (!less(comp, proj, *--right, pivot)) {}
+            }
+
+            auto pivot_position = left - 1;
+            *first = container::iterator_move(pivot_position);
+            *pivot_position = util::move(pivot);
+            return Tuple { pivot_position, already_partitioned };
+        }
+
+        // Partitions [first, last) around the pivot *first, placing elements equal to the pivot on the
+        // left. This is only used when the element before first is equal to the pivot, in which case
+        // every element placed on the left is equal to the pivot and does not need to be sorted.
+        constexpr static auto partition_left(auto first, auto last, auto& comp, auto& proj) {
+            using Value = meta::IteratorValue<decltype(first)>;
+
+            Value pivot = container::iterator_move(first);
+
+            auto left = first;
+            auto right = last;
+
+            while (less(comp, proj, pivot, *--right)) {}
+
+            if (right + 1 == last) {
+                while (left < right && !less(comp, proj, pivot, *++left)) {}
+            } else {
+                while (!less(comp, proj, pivot, *++left)) {}
+            }
+
+            while (left < right) {
+                container::iterator_swap(left, right);
+                while (less(comp, proj, pivot, *--right)) {}
+                while (!less(comp, proj, pivot, *++left)) {}
+            }
+
+            auto pivot_position = right;
+            *first = container::iterator_move(pivot_position);
+            *pivot_position = util::move(pivot);
+            return pivot_position;
+        }
+
+        // Swaps a few elements around on both sides of a highly unbalanced partition, to break up whatever
+        // pattern in the input caused the bad pivot choice.
+        constexpr static void break_patterns(auto first, auto pivot_position, auto last) {
+            auto left_size = pivot_position - first;
+            auto right_size = last - (pivot_position + 1);
+
+            if (left_size >= insertion_sort_threshold) {
+                container::iterator_swap(first, first + left_size / 4);
+                container::iterator_swap(pivot_position - 1, pivot_position - left_size / 4);
+
+                if (left_size > ninther_threshold) {
+                    container::iterator_swap(first + 1, first + (left_size / 4 + 1));
+                    container::iterator_swap(first + 2, first + (left_size / 4 + 2));
+                    container::iterator_swap(pivot_position - 2, pivot_position - (left_size / 4 + 1));
+                    container::iterator_swap(pivot_position - 3, pivot_position - (left_size / 4 + 2));
+                }
+            }
+
+            if (right_size >= insertion_sort_threshold) {
+                container::iterator_swap(pivot_position + 1, pivot_position + (1 + right_size / 4));
+                container::iterator_swap(last - 1, last - right_size / 4);
+
+                if (right_size > ninther_threshold) {
+                    container::iterator_swap(pivot_position + 2, pivot_position + (2 + right_size / 4));
+                    container::iterator_swap(pivot_position + 3, pivot_position + (3 + right_size / 4));
+                    container::iterator_swap(last - 2, last - (1 + right_size / 4));
+                    container::iterator_swap(last - 3, last - (2 + right_size / 4));
+                }
+            }
+        }
+
+        constexpr static void loop(auto first, auto last, auto& comp, auto& proj, auto bad_partitions_allowed, bool leftmost) {
+            for (;;) {
+                auto size = last - first;
+                if (size < insertion_sort_threshold) {
+                    if (leftmost) {
+                        insertion_sort(first, last, comp, proj);
+                    } else {
+                        unguarded_insertion_sort(first, last, comp, proj);
+                    }
+                    return;
+                }
+
+                choose_pivot(first, last, comp, proj);
+
+                // If the previous pivot (which is not greater than anything in the range) is equal to this
+                // pivot, every element equal to the pivot can be placed in its final position at once.
+                if (!leftmost && !less(comp, proj, *(first - 1), *first)) {
+                    first = partition_left(first, last, comp, proj) + 1;
+                    continue;
+                }
+
+                auto [pivot_position, already_partitioned] = partition_right(first, last, comp, proj);
+
+                auto left_size = pivot_position - first;
+                auto right_size = last - (pivot_position + 1);
+                bool highly_unbalanced = left_size < size / 8 || right_size < size / 8;
+
+                if (highly_unbalanced) {
+                    if (--bad_partitions_allowed == 0) {
+                        container::make_heap(first, last, util::ref(comp), util::ref(proj));
+                        container::sort_heap(first, last, util::ref(comp), util::ref(proj));
+                        return;
+                    }
+
+                    break_patterns(first, pivot_position, last);
+                } else if (already_partitioned && partial_insertion_sort(first, pivot_position, comp, proj) &&
+                           partial_insertion_sort(pivot_position + 1, last, comp, proj)) {
+                    // A balanced partition which required no swaps usually means the input was already sorted.
+                    return;
+                }
+
+                // Recurse into the left side, and loop on the right side.
+                loop(first, pivot_position, comp, proj, bad_partitions_allowed, leftmost);
+                first = pivot_position + 1;
+                leftmost = false;
+            }
+        }
     };
 }
 
 constexpr inline auto sort = detail::SortFunction {};
-}
\ No newline at end of file
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <di/container/algorithm/rotate.h>
+#include <di/container/algorithm/sort.h>
+#include <di/container/concepts/prelude.h>
+#include <di/container/iterator/next.h>
+#include <di/container/meta/prelude.h>
+#include <di/container/vector/vector.h>
+#include <di/function/compare.h>
+#include <di/vocab/expected/prelude.h>
+
+namespace di::container {
+namespace detail {
+    // This is a top-down merge sort. Merging is done through a temporary buffer large enough to hold the
+    // left half of the range. If that buffer cannot be allocated, the merges are instead done in place
+    // using rotations, which is slower (O(n log^2 n)) but does not need any additional memory.
+    struct StableSortFunction {
+        template<concepts::RandomAccessIterator It, concepts::SentinelFor<It> Sent, typename Comp = function::Compare,
+                 typename Proj = function::Identity>
+        requires(concepts::Sortable<It, Comp, Proj>)
+        constexpr It operator()(It first, Sent last, Comp comp = {}, Proj proj = {}) const {
+            auto last_it = container::next(first, last);
+            impl(util::move(first), last_it, comp, proj);
+            return last_it;
+        }
+
+        template<concepts::RandomAccessContainer Con, typename Comp = function::Compare, typename Proj = function::Identity>
+        requires(concepts::Sortable<meta::ContainerIterator<Con>, Comp, Proj>)
+        constexpr meta::BorrowedIterator<Con> operator()(Con&& container, Comp comp = {}, Proj proj = {}) const {
+            return (*this)(container::begin(container), container::end(container), util::ref(comp), util::ref(proj));
+        }
+
+    private:
+        // Ranges smaller than this are insertion sorted, which is stable.
+        constexpr static auto insertion_sort_threshold = 16;
+
+        constexpr static void impl(auto first, auto last, auto& comp, auto& proj) {
+            using Value = meta::IteratorValue<decltype(first)>;
+
+            auto size = last - first;
+            if (size < insertion_sort_threshold) {
+                SortFunction::insertion_sort(first, last, comp, proj);
+                return;
+            }
+
+            auto buffer = Vector<Value> {};
+            auto have_buffer = invoke_as_fallible([&] {
+                                   return buffer.reserve(size_t((size + 1) / 2));
+                               }).has_value();
+            merge_sort(first, last, buffer, have_buffer, comp, proj);
+        }
+
+        constexpr static void merge_sort(auto first, auto last, auto& buffer, bool have_buffer, auto& comp, auto& proj) {
+            auto size = last - first;
+            if (size < insertion_sort_threshold) {
+                SortFunction::insertion_sort(first, last, comp, proj);
+                return;
+            }
+
+            auto middle = first + size / 2;
+            merge_sort(first, middle, buffer, have_buffer, comp, proj);
+            merge_sort(middle, last, buffer, have_buffer, comp, proj);
+
+            // The two halves are already in order, so there is nothing to merge.
+            if (!SortFunction::less(comp, proj, *middle, *(middle - 1))) {
+                return;
+            }
+
+            if (have_buffer) {
+                merge_buffered(first, middle, last, buffer, comp, proj);
+            } else {
+                merge_in_place(first, middle, last, comp, proj);
+            }
+        }
+
+        constexpr static void merge_buffered(auto first, auto middle, auto last, auto& buffer, auto& comp, auto& proj) {
+            // The buffer has enough capacity reserved up front, so this cannot fail.
+            buffer.clear();
+            for (auto it = first; it != middle; ++it) {
+                (void) buffer.emplace_back(container::iterator_move(it));
+            }
+
+            // On ties, take from the buffer first since those elements came first in the original range.
+            auto out = first;
+            auto left = buffer.begin();
+            auto left_end = buffer.end();
+            auto right = middle;
+            while (left != left_end && right != last) {
+                if (SortFunction::less(comp, proj, *right, *left)) {
+                    *out = container::iterator_move(right);
+                    ++right;
+                } else {
+                    *out = util::move(*left);
+                    ++left;
+                }
+                ++out;
+            }
+
+            // Anything left over on the right side is already in place.
+            for (; left != left_end; ++left, ++out) {
+                *out = util::move(*left);
+            }
+        }
+
+        constexpr static void merge_in_place(auto first, auto middle, auto last, auto& comp, auto& proj) {
+            auto left_size = middle - first;
+            auto right_size = last - middle;
+            if (left_size == 0 || right_size == 0) {
+                return;
+            }
+
+            if (left_size + right_size == 2) {
+                if (SortFunction::less(comp, proj, *middle, *first)) {
+                    container::iterator_swap(first, middle);
+                }
+                return;
+            }
+
+            // Split the larger half in two, find where its midpoint belongs in the other half, and then rotate
+            // the two inner pieces into place. This leaves two independent merges of roughly half the size.
+            auto left_cut = first;
+            auto right_cut = middle;
+            if (left_size >= right_size) {
+                left_cut = first + left_size / 2;
+                right_cut = partition_point(middle, last, [&](auto&& value) {
+                    return SortFunction::less(comp, proj, value, *left_cut);
+                });
+            } else {
+                right_cut = middle + right_size / 2;
+                left_cut = partition_point(first, middle, [&](auto&& value) {
+                    return !SortFunction::less(comp, proj, *right_cut, value);
+                });
+            }
+
+            auto new_middle = container::rotate(left_cut, middle, right_cut).begin();
+            merge_in_place(first, left_cut, new_middle, comp, proj);
+            merge_in_place(new_middle, right_cut, last, comp, proj);
+        }
+
+        // Returns the first element in [first, last) for which pred is false, assuming the range is partitioned by pred.
+        constexpr static auto partition_point(auto first, auto last, auto pred) {
+            auto size = last - first;
+            while (size > 0) {
+                auto half = size / 2;
+                auto middle = first + half;
+                if (pred(*middle)) {
+                    first = middle + 1;
+                    size -= half + 1;
+                } else {
+                    size = half;
+                }
+            }
+            return first;
+        }
+    };
+}
+
+constexpr inline auto stable_sort = detail::StableSortFunction {};
+}
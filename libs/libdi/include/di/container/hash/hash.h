@@ -0,0 +1,86 @@
+#pragma once
+
+#include <di/concepts/enum.h>
+#include <di/concepts/integral.h>
+#include <di/concepts/pointer.h>
+#include <di/concepts/same_as.h>
+#include <di/container/string/constant_string.h>
+#include <di/function/tag_invoke.h>
+#include <di/types/prelude.h>
+#include <di/util/to_uintptr.h>
+#include <di/util/to_underlying.h>
+
+namespace di::container {
+namespace detail {
+    // This is the finalizer of splitmix64, which has good avalanche behavior: every input bit
+    // affects every output bit. Hash tables rely on this, since they derive both the bucket
+    // index and the per-slot tag from different bits of the hash.
+    constexpr u64 hash_mix(u64 value) {
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EB;
+        value ^= value >> 31;
+        return value;
+    }
+
+    constexpr u64 hash_rotate_left(u64 value, int amount) { return (value << amount) | (value >> (64 - amount)); }
+
+    // Hashes a sequence of code units 8 bytes at a time. The code units are assembled into
+    // words one byte at a time, which keeps this usable in constant expressions while still
+    // compiling down to a single load when the code unit type is a byte.
+    template<typename T>
+    constexpr u64 hash_code_units(T const* data, size_t size) {
+        static_assert(sizeof(T) == 1, "Only byte sized code units are supported.");
+
+        constexpr auto multiplier1 = u64(0x9E3779B97F4A7C15);
+        constexpr auto multiplier2 = u64(0xC2B2AE3D27D4EB4F);
+
+        auto hash = u64(size) * multiplier1;
+        auto i = size_t(0);
+        for (; i + 8 <= size; i += 8) {
+            auto word = u64(0);
+            for (auto j = size_t(0); j < 8; j++) {
+                word |= u64(u8(data[i + j])) << (j * 8);
+            }
+            hash = hash_rotate_left(hash ^ (word * multiplier1), 29) * multiplier2;
+        }
+
+        auto tail = u64(0);
+        for (auto j = size_t(0); i + j < size; j++) {
+            tail |= u64(u8(data[i + j])) << (j * 8);
+        }
+        hash = hash_rotate_left(hash ^ (tail * multiplier1), 29) * multiplier2;
+        return hash_mix(hash);
+    }
+
+    struct HashFunction {
+        template<typename T>
+        requires(concepts::TagInvocable<HashFunction, T const&> || concepts::Integral<T> || concepts::Enum<T> ||
+                 concepts::Pointer<T> || concepts::detail::ConstantString<T>)
+        constexpr u64 operator()(T const& value) const {
+            if constexpr (concepts::TagInvocable<HashFunction, T const&>) {
+                static_assert(concepts::SameAs<meta::TagInvokeResult<HashFunction, T const&>, u64>,
+                              "Customizations of di::hash() must return a u64.");
+                return function::tag_invoke(*this, value);
+            } else if constexpr (concepts::Integral<T>) {
+                return hash_mix(u64(value));
+            } else if constexpr (concepts::Enum<T>) {
+                return hash_mix(u64(util::to_underlying(value)));
+            } else if constexpr (concepts::Pointer<T>) {
+                return hash_mix(u64(util::to_uintptr(value)));
+            } else {
+                auto span = value.span();
+                return hash_code_units(span.data(), span.size());
+            }
+        }
+    };
+}
+
+constexpr inline auto hash = detail::HashFunction {};
+}
+
+namespace di::concepts {
+template<typename T>
+concept Hashable = requires(T const& value) { container::hash(value); };
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <di/concepts/same_as.h>
+#include <di/concepts/weakly_equality_comparable_with.h>
+#include <di/container/allocator/prelude.h>
+#include <di/container/associative/map_interface.h>
+#include <di/container/concepts/prelude.h>
+#include <di/container/hash/hash_table.h>
+#include <di/container/hash/hasher.h>
+#include <di/platform/prelude.h>
+#include <di/util/deduce_create.h>
+#include <di/vocab/optional/prelude.h>
+
+namespace di::container {
+namespace detail {
+    template<typename Hasher, typename Key>
+    struct HashMapHasherAdapter {
+        [[no_unique_address]] Hasher hasher {};
+
+        template<typename V>
+        requires(concepts::Hasher<Hasher const&, Key>)
+        constexpr u64 operator()(Tuple<Key, V> const& value) const {
+            return function::invoke(hasher, util::get<0>(value));
+        }
+
+        template<typename U, typename V>
+        requires(!concepts::SameAs<U, Key> && concepts::Hasher<Hasher const&, U>)
+        constexpr u64 operator()(Tuple<U, V> const& value) const {
+            return function::invoke(hasher, util::get<0>(value));
+        }
+
+        template<typename U>
+        requires(concepts::Hasher<Hasher const&, U>)
+        constexpr u64 operator()(U const& needle) const {
+            return function::invoke(hasher, needle);
+        }
+    };
+
+    template<typename Key>
+    struct HashMapEqualAdapter {
+        template<typename V1, typename U, typename V2>
+        requires(concepts::detail::WeaklyEqualityComparableWith<Key, U>)
+        constexpr bool operator()(Tuple<Key, V1> const& a, Tuple<U, V2> const& b) const {
+            return util::get<0>(a) == util::get<0>(b);
+        }
+
+        template<typename V1, typename U>
+        requires(concepts::detail::WeaklyEqualityComparableWith<Key, U>)
+        constexpr bool operator()(Tuple<Key, V1> const& a, U const& b) const {
+            return util::get<0>(a) == b;
+        }
+    };
+
+    template<typename Key, typename Value, typename Hasher>
+    using HashMapValidForLookup =
+        HashTableValidForLookup<Tuple<Key, Value>, HashMapEqualAdapter<Key>, HashMapHasherAdapter<Hasher, Key>>;
+}
+
+template<typename Key, typename Value, concepts::Hasher<Key> Hasher = DefaultHasher,
+         concepts::AllocatorOf<HashTableChunk<Tuple<Key, Value>>> Alloc = DefaultAllocator<HashTableChunk<Tuple<Key, Value>>>>
+requires(concepts::detail::WeaklyEqualityComparableWith<Key, Key>)
+class HashMap
+    : public HashTable<Tuple<Key, Value>, detail::HashMapEqualAdapter<Key>, detail::HashMapHasherAdapter<Hasher, Key>, Alloc,
+                       MapInterface<HashMap<Key, Value, Hasher, Alloc>, Tuple<Key, Value>, HashTableIterator<Tuple<Key, Value>>,
+                                    meta::ConstIterator<HashTableIterator<Tuple<Key, Value>>>,
+                                    detail::HashMapValidForLookup<Key, Value, Hasher>::template Type, false>> {
+private:
+    using Base = HashTable<Tuple<Key, Value>, detail::HashMapEqualAdapter<Key>, detail::HashMapHasherAdapter<Hasher, Key>, Alloc,
+                           MapInterface<HashMap<Key, Value, Hasher, Alloc>, Tuple<Key, Value>, HashTableIterator<Tuple<Key, Value>>,
+                                        meta::ConstIterator<HashTableIterator<Tuple<Key, Value>>>,
+                                        detail::HashMapValidForLookup<Key, Value, Hasher>::template Type, false>>;
+
+public:
+    HashMap() = default;
+
+    constexpr explicit HashMap(Hasher const& hasher) : Base(detail::HashMapHasherAdapter<Hasher, Key> { hasher }) {}
+};
+
+template<concepts::InputContainer Con, concepts::TupleLike T = meta::ContainerValue<Con>>
+requires(meta::TupleSize<T> == 2)
+HashMap<meta::TupleElement<T, 0>, meta::TupleElement<T, 1>> tag_invoke(types::Tag<util::deduce_create>, InPlaceTemplate<HashMap>, Con&&);
+
+template<concepts::InputContainer Con, concepts::TupleLike T = meta::ContainerValue<Con>,
+         concepts::Hasher<meta::TupleElement<T, 0>> Hasher>
+requires(meta::TupleSize<T> == 2)
+HashMap<meta::TupleElement<T, 0>, meta::TupleElement<T, 1>, Hasher> tag_invoke(types::Tag<util::deduce_create>, InPlaceTemplate<HashMap>,
+                                                                               Con&&, Hasher);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <di/concepts/weakly_equality_comparable_with.h>
+#include <di/container/allocator/prelude.h>
+#include <di/container/associative/set_interface.h>
+#include <di/container/concepts/prelude.h>
+#include <di/container/hash/hash_table.h>
+#include <di/container/hash/hasher.h>
+#include <di/platform/prelude.h>
+#include <di/util/deduce_create.h>
+#include <di/vocab/optional/prelude.h>
+
+namespace di::container {
+namespace detail {
+    template<typename Value>
+    struct HashSetEqualAdapter {
+        template<typename U>
+        requires(concepts::detail::WeaklyEqualityComparableWith<Value, U>)
+        constexpr bool operator()(Value const& a, U const& b) const {
+            return a == b;
+        }
+    };
+}
+
+template<typename Value, concepts::Hasher<Value> Hasher = DefaultHasher,
+         concepts::AllocatorOf<HashTableChunk<Value>> Alloc = DefaultAllocator<HashTableChunk<Value>>>
+requires(concepts::detail::WeaklyEqualityComparableWith<Value, Value>)
+class HashSet
+    : public HashTable<Value, detail::HashSetEqualAdapter<Value>, Hasher, Alloc,
+                       SetInterface<HashSet<Value, Hasher, Alloc>, Value, HashTableIterator<Value>,
+                                    meta::ConstIterator<HashTableIterator<Value>>,
+                                    detail::HashTableValidForLookup<Value, detail::HashSetEqualAdapter<Value>, Hasher>::template Type,
+                                    false>> {
+private:
+    using Base = HashTable<Value, detail::HashSetEqualAdapter<Value>, Hasher, Alloc,
+                           SetInterface<HashSet<Value, Hasher, Alloc>, Value, HashTableIterator<Value>,
+                                        meta::ConstIterator<HashTableIterator<Value>>,
+                                        detail::HashTableValidForLookup<Value, detail::HashSetEqualAdapter<Value>, Hasher>::template Type,
+                                        false>>;
+
+public:
+    using Base::Base;
+};
+
+template<concepts::InputContainer Con, typename T = meta::ContainerValue<Con>>
+HashSet<T> tag_invoke(types::Tag<util::deduce_create>, InPlaceTemplate<HashSet>, Con&&);
+
+template<concepts::InputContainer Con, typename T = meta::ContainerValue<Con>, concepts::Hasher<T> Hasher>
+HashSet<T, Hasher> tag_invoke(types::Tag<util::deduce_create>, InPlaceTemplate<HashSet>, Con&&, Hasher);
+}
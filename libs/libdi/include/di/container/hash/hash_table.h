@@ -0,0 +1,285 @@
+#pragma once
+
+#include <di/assert/prelude.h>
+#include <di/concepts/predicate.h>
+#include <di/container/allocator/prelude.h>
+#include <di/container/concepts/prelude.h>
+#include <di/container/hash/hash_table_chunk.h>
+#include <di/container/hash/hash_table_iterator.h>
+#include <di/container/hash/hasher.h>
+#include <di/container/meta/const_iterator.h>
+#include <di/function/invoke.h>
+#include <di/util/as_const.h>
+#include <di/util/construct_at.h>
+#include <di/util/destroy_at.h>
+#include <di/util/exchange.h>
+#include <di/util/move.h>
+#include <di/vocab/tuple/prelude.h>
+
+namespace di::container {
+namespace detail {
+    template<typename Value, typename Eq, typename Hasher>
+    struct HashTableValidForLookup {
+        template<typename U>
+        struct Type {
+            constexpr static inline bool value = concepts::Hasher<Hasher, U> && concepts::Predicate<Eq const&, Value const&, U const&>;
+        };
+    };
+}
+
+// This is an open addressing hash table, in the style of Facebook's F14 (see
+// https://engineering.fb.com/2019/04/25/developer-tools/f14/). Values are stored inline in chunks of 14
+// slots, and a lookup probes whole chunks at a time, using the chunk's tag bytes to filter out almost all
+// slots which cannot contain the needle before comparing any keys. The chunk count is always a power of
+// 2, and chunks are probed using double hashing, with an odd step derived from the hash.
+//
+// Inserting may rehash the table, which invalidates all iterators. Erasing never moves other values.
+template<typename Value, typename Eq, typename Hasher, concepts::AllocatorOf<HashTableChunk<Value>> Alloc, typename Interface>
+class HashTable : public Interface {
+private:
+    using Chunk = HashTableChunk<Value>;
+    using Iterator = HashTableIterator<Value>;
+    using ConstIterator = meta::ConstIterator<Iterator>;
+
+    // The table grows once it holds more than this many values per chunk on average, which corresponds
+    // to a maximum load factor of about 0.86.
+    constexpr static auto max_values_per_chunk = 12zu;
+
+public:
+    HashTable() = default;
+    HashTable(HashTable const&) = delete;
+    HashTable& operator=(HashTable const&) = delete;
+
+    constexpr explicit HashTable(Hasher hasher) : m_hasher(hasher) {}
+
+    constexpr HashTable(HashTable&& other)
+        : m_chunks(util::exchange(other.m_chunks, nullptr))
+        , m_chunk_count(util::exchange(other.m_chunk_count, 0))
+        , m_size(util::exchange(other.m_size, 0))
+        , m_hasher(other.m_hasher)
+        , m_equal(other.m_equal) {}
+
+    constexpr HashTable& operator=(HashTable&& other) {
+        destroy();
+        m_chunks = util::exchange(other.m_chunks, nullptr);
+        m_chunk_count = util::exchange(other.m_chunk_count, 0);
+        m_size = util::exchange(other.m_size, 0);
+        m_hasher = other.m_hasher;
+        m_equal = other.m_equal;
+        return *this;
+    }
+
+    constexpr ~HashTable() { destroy(); }
+
+    constexpr size_t size() const { return m_size; }
+    constexpr size_t capacity() const { return m_chunk_count * max_values_per_chunk; }
+
+    constexpr Iterator begin() { return unconst_iterator(util::as_const(*this).begin()); }
+    constexpr ConstIterator begin() const { return Iterator::first_occupied(m_chunks, 0, m_chunks + m_chunk_count); }
+    constexpr Iterator end() { return unconst_iterator(util::as_const(*this).end()); }
+    constexpr ConstIterator end() const { return Iterator(m_chunks + m_chunk_count, 0, m_chunks + m_chunk_count); }
+
+    constexpr Iterator unconst_iterator(ConstIterator it) { return it.base(); }
+
+    // Destroys every value, but keeps the allocated chunks around for reuse.
+    constexpr void clear() {
+        for (auto* chunk = m_chunks; chunk != m_chunks + m_chunk_count; ++chunk) {
+            for (auto mask = chunk->occupied(); mask; mask &= mask - 1) {
+                chunk->erase(__builtin_ctz(mask));
+            }
+            chunk->overflow_count = 0;
+        }
+        m_size = 0;
+    }
+
+    // Ensures that at least count values can be stored without rehashing.
+    constexpr void reserve(size_t count) {
+        if (count > capacity()) {
+            rehash(chunk_count_for(count));
+        }
+    }
+
+    template<typename U, concepts::Invocable F>
+    requires(concepts::Hasher<Hasher, U> && concepts::MaybeFallible<meta::InvokeResult<F>, Value>)
+    constexpr auto insert_with_factory(U&& needle, F&& factory) {
+        auto hash = hash_of(needle);
+        if (auto existing = find_with_hash(needle, hash); existing != end()) {
+            return Tuple(existing, false);
+        }
+
+        reserve(m_size + 1);
+        auto [chunk, index] = insert_position(hash);
+        chunk->emplace(index, tag_of(hash), function::invoke(util::forward<F>(factory)));
+        ++m_size;
+        return Tuple(Iterator(chunk, index, m_chunks + m_chunk_count), true);
+    }
+
+    template<typename U, concepts::Invocable F>
+    requires(concepts::Hasher<Hasher, U> && concepts::MaybeFallible<meta::InvokeResult<F>, Value>)
+    constexpr auto insert_with_factory(ConstIterator, U&& needle, F&& factory) {
+        return util::get<0>(insert_with_factory(util::forward<U>(needle), util::forward<F>(factory)));
+    }
+
+    constexpr Iterator erase_impl(ConstIterator position) {
+        DI_ASSERT(position != end());
+
+        auto it = unconst_iterator(util::move(position));
+        auto* chunk = it.chunk();
+        auto index = it.index();
+
+        // Undo the overflow accounting done when this value was inserted, which happened for every chunk
+        // on the probe sequence before the one the value ended up in.
+        auto hash = hash_of(chunk->value(index));
+        auto step = probe_step(hash);
+        for (auto i = hash & mask(); m_chunks + i != chunk; i = (i + step) & mask()) {
+            m_chunks[i].decrement_overflow_count();
+        }
+
+        chunk->erase(index);
+        --m_size;
+        return Iterator::first_occupied(chunk, index + 1, m_chunks + m_chunk_count);
+    }
+
+    template<typename U>
+    requires(concepts::Hasher<Hasher, U> && concepts::Predicate<Eq const&, Value const&, U const&>)
+    constexpr ConstIterator find_impl(U&& needle) const {
+        return find_with_hash(needle, hash_of(needle));
+    }
+
+    constexpr void merge_impl(HashTable&& other) {
+        if (m_size == 0) {
+            *this = util::move(other);
+            return;
+        }
+
+        reserve(m_size + other.m_size);
+        for (auto* chunk = other.m_chunks; chunk != other.m_chunks + other.m_chunk_count; ++chunk) {
+            for (auto mask = chunk->occupied(); mask; mask &= mask - 1) {
+                auto& value = chunk->value(__builtin_ctz(mask));
+                insert_with_factory(value, [&] {
+                    return util::move(value);
+                });
+            }
+        }
+        other.clear();
+    }
+
+private:
+    constexpr size_t mask() const { return m_chunk_count - 1; }
+
+    template<typename U>
+    constexpr u64 hash_of(U const& value) const {
+        return function::invoke(m_hasher, value);
+    }
+
+    // The tag uses the top 7 bits of the hash, which are independent of the low bits used to pick a chunk.
+    constexpr static u8 tag_of(u64 hash) { return u8(0x80 | (hash >> 57)); }
+
+    // Any odd step visits every chunk before repeating, since the chunk count is a power of 2. Deriving the
+    // step from the tag means values which collide on their first chunk usually diverge after it.
+    constexpr static size_t probe_step(u64 hash) { return 2 * size_t(hash >> 57) + 1; }
+
+    constexpr static size_t chunk_count_for(size_t count) {
+        auto result = 1zu;
+        while (result * max_values_per_chunk < count) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    template<typename U>
+    constexpr Iterator find_with_hash(U const& needle, u64 hash) const {
+        auto last = m_chunks + m_chunk_count;
+        if (m_size == 0) {
+            return Iterator(last, 0, last);
+        }
+
+        auto tag = tag_of(hash);
+        auto step = probe_step(hash);
+        auto index = hash & mask();
+        for (auto probes = 0zu; probes < m_chunk_count; probes++) {
+            auto& chunk = m_chunks[index];
+            for (auto matches = chunk.match(tag); matches; matches &= matches - 1) {
+                auto slot = size_t(__builtin_ctz(matches));
+                if (function::invoke(m_equal, chunk.value(slot), needle)) {
+                    return Iterator(&chunk, slot, last);
+                }
+            }
+
+            if (chunk.overflow_count == 0) {
+                break;
+            }
+            index = (index + step) & mask();
+        }
+        return Iterator(last, 0, last);
+    }
+
+    // Returns the first empty slot on the probe sequence of hash, and records the overflow in each full chunk
+    // passed along the way. The caller must ensure the table has room for one more value.
+    constexpr Tuple<Chunk*, size_t> insert_position(u64 hash) {
+        auto step = probe_step(hash);
+        auto index = hash & mask();
+        for (;;) {
+            auto& chunk = m_chunks[index];
+            if (auto empty = chunk.empty()) {
+                return { &chunk, size_t(__builtin_ctz(empty)) };
+            }
+            chunk.increment_overflow_count();
+            index = (index + step) & mask();
+        }
+    }
+
+    constexpr void rehash(size_t new_chunk_count) {
+        auto old_chunks = util::exchange(m_chunks, allocate_chunks(new_chunk_count));
+        auto old_chunk_count = util::exchange(m_chunk_count, new_chunk_count);
+
+        for (auto* chunk = old_chunks; chunk != old_chunks + old_chunk_count; ++chunk) {
+            for (auto mask = chunk->occupied(); mask; mask &= mask - 1) {
+                auto index = size_t(__builtin_ctz(mask));
+                auto& value = chunk->value(index);
+                auto hash = hash_of(value);
+                auto [new_chunk, new_index] = insert_position(hash);
+                new_chunk->emplace(new_index, tag_of(hash), util::move(value));
+                chunk->erase(index);
+            }
+        }
+        deallocate_chunks(old_chunks, old_chunk_count);
+    }
+
+    constexpr Chunk* allocate_chunks(size_t count) {
+        auto [pointer, allocated_chunks] = Alloc().allocate(count);
+        (void) allocated_chunks;
+
+        for (auto i = 0zu; i < count; i++) {
+            util::construct_at(pointer + i);
+        }
+        return pointer;
+    }
+
+    constexpr void deallocate_chunks(Chunk* chunks, size_t count) {
+        if (!chunks) {
+            return;
+        }
+
+        for (auto i = 0zu; i < count; i++) {
+            util::destroy_at(chunks + i);
+        }
+        Alloc().deallocate(chunks, count);
+    }
+
+    constexpr void destroy() {
+        if (!m_chunks) {
+            return;
+        }
+
+        clear();
+        deallocate_chunks(util::exchange(m_chunks, nullptr), util::exchange(m_chunk_count, 0));
+    }
+
+    Chunk* m_chunks { nullptr };
+    size_t m_chunk_count { 0 };
+    size_t m_size { 0 };
+    [[no_unique_address]] Hasher m_hasher;
+    [[no_unique_address]] Eq m_equal;
+};
+}
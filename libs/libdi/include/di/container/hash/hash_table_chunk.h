@@ -0,0 +1,139 @@
+#pragma once
+
+#include <di/concepts/trivially_destructible.h>
+#include <di/types/prelude.h>
+#include <di/util/construct_at.h>
+#include <di/util/destroy_at.h>
+#include <di/util/forward.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace di::container {
+// A chunk is the unit of probing in a HashTable. It holds up to 14 values, along with a 16 byte
+// header containing one tag byte per slot. An empty slot has a tag of 0, and an occupied slot has
+// a tag with its high bit set, with the low 7 bits taken from the value's hash. This means a lookup
+// can check all 14 slots of a chunk with a single 16 byte SIMD comparison, and usually only has to
+// compare one key for equality.
+//
+// The remaining header byte counts the values which wanted to be placed in this chunk (or passed
+// through it while probing) but ended up in a later chunk, because this chunk was full. A lookup can
+// stop as soon as it sees a chunk with a zero overflow count, so erasing values never needs
+// tombstones. The count saturates, after which it is never decremented.
+template<typename Value>
+struct alignas(16) HashTableChunk {
+    constexpr static auto slot_count = 14zu;
+    constexpr static auto max_overflow_count = u8(255);
+
+    // A bit mask with bit i set for each slot i which matches some condition.
+    using Mask = u32;
+
+    constexpr HashTableChunk() {}
+
+    HashTableChunk(HashTableChunk const&) = delete;
+    HashTableChunk& operator=(HashTableChunk const&) = delete;
+
+    ~HashTableChunk() = default;
+
+    // Values are destroyed by the owning HashTable, which knows which slots are occupied.
+    constexpr ~HashTableChunk()
+    requires(!concepts::TriviallyDestructible<Value>)
+    {}
+
+    constexpr Mask match(u8 tag) const {
+        if consteval {
+            auto result = Mask(0);
+            for (auto i = 0zu; i < slot_count; i++) {
+                if (tags[i] == tag) {
+                    result |= Mask(1) << i;
+                }
+            }
+            return result;
+        } else {
+#ifdef __SSE2__
+            auto header = _mm_load_si128(reinterpret_cast<__m128i const*>(tags));
+            auto matches = _mm_cmpeq_epi8(header, _mm_set1_epi8(char(tag)));
+            return Mask(_mm_movemask_epi8(matches)) & full_mask;
+#else
+            auto result = Mask(0);
+            for (auto i = 0zu; i < slot_count; i++) {
+                result |= Mask(tags[i] == tag) << i;
+            }
+            return result;
+#endif
+        }
+    }
+
+    constexpr Mask occupied() const {
+        if consteval {
+            auto result = Mask(0);
+            for (auto i = 0zu; i < slot_count; i++) {
+                if (tags[i] & 0x80) {
+                    result |= Mask(1) << i;
+                }
+            }
+            return result;
+        } else {
+#ifdef __SSE2__
+            auto header = _mm_load_si128(reinterpret_cast<__m128i const*>(tags));
+            return Mask(_mm_movemask_epi8(header)) & full_mask;
+#else
+            auto result = Mask(0);
+            for (auto i = 0zu; i < slot_count; i++) {
+                result |= Mask(tags[i] >> 7) << i;
+            }
+            return result;
+#endif
+        }
+    }
+
+    constexpr Mask empty() const { return ~occupied() & full_mask; }
+
+    constexpr Value& value(size_t index) { return slots[index].value; }
+    constexpr Value const& value(size_t index) const { return slots[index].value; }
+
+    template<typename... Args>
+    constexpr Value& emplace(size_t index, u8 tag, Args&&... args) {
+        auto* result = util::construct_at(&slots[index].value, util::forward<Args>(args)...);
+        tags[index] = tag;
+        return *result;
+    }
+
+    constexpr void erase(size_t index) {
+        util::destroy_at(&slots[index].value);
+        tags[index] = 0;
+    }
+
+    constexpr void increment_overflow_count() {
+        if (overflow_count != max_overflow_count) {
+            ++overflow_count;
+        }
+    }
+
+    constexpr void decrement_overflow_count() {
+        if (overflow_count != max_overflow_count) {
+            --overflow_count;
+        }
+    }
+
+    constexpr static auto full_mask = (Mask(1) << slot_count) - 1;
+
+    u8 tags[slot_count] {};
+    u8 reserved { 0 };
+    u8 overflow_count { 0 };
+
+    union Slot {
+        constexpr Slot() {}
+
+        ~Slot() = default;
+        constexpr ~Slot()
+        requires(!concepts::TriviallyDestructible<Value>)
+        {}
+
+        Value value;
+    };
+
+    Slot slots[slot_count];
+};
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <di/assert/prelude.h>
+#include <di/container/hash/hash_table_chunk.h>
+#include <di/container/iterator/iterator_base.h>
+#include <di/types/prelude.h>
+
+namespace di::container {
+template<typename Value>
+class HashTableIterator : public IteratorBase<HashTableIterator<Value>, ForwardIteratorTag, Value, ssize_t> {
+private:
+    using Chunk = HashTableChunk<Value>;
+
+public:
+    HashTableIterator() = default;
+
+    constexpr explicit HashTableIterator(Chunk* chunk, size_t index, Chunk* last_chunk)
+        : m_chunk(chunk), m_index(index), m_last_chunk(last_chunk) {}
+
+    // Returns an iterator to the first occupied slot at or after the given position.
+    constexpr static HashTableIterator first_occupied(Chunk* chunk, size_t index, Chunk* last_chunk) {
+        for (; chunk != last_chunk; ++chunk, index = 0) {
+            auto mask = chunk->occupied() >> index;
+            if (mask) {
+                return HashTableIterator(chunk, index + __builtin_ctz(mask), last_chunk);
+            }
+        }
+        return HashTableIterator(last_chunk, 0, last_chunk);
+    }
+
+    constexpr Value& operator*() const {
+        DI_ASSERT(m_chunk != m_last_chunk);
+        return m_chunk->value(m_index);
+    }
+
+    constexpr Chunk* chunk() const { return m_chunk; }
+    constexpr size_t index() const { return m_index; }
+
+    constexpr void advance_one() { *this = first_occupied(m_chunk, m_index + 1, m_last_chunk); }
+
+private:
+    constexpr friend bool operator==(HashTableIterator const& a, HashTableIterator const& b) {
+        return a.m_chunk == b.m_chunk && a.m_index == b.m_index;
+    }
+
+    Chunk* m_chunk { nullptr };
+    size_t m_index { 0 };
+    Chunk* m_last_chunk { nullptr };
+};
+}
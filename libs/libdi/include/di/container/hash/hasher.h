@@ -0,0 +1,23 @@
+#pragma once
+
+#include <di/concepts/same_as.h>
+#include <di/container/hash/hash.h>
+#include <di/function/invoke.h>
+
+namespace di::concepts {
+// A hasher maps values to well distributed 64 bit hashes. Values which compare equal must have equal hashes,
+// including when the values have different types (for example, a String and a StringView).
+template<typename H, typename T>
+concept Hasher = requires(H const& hasher, T const& value) {
+                     { function::invoke(hasher, value) } -> SameAs<u64>;
+                 };
+}
+
+namespace di::container {
+struct DefaultHasher {
+    template<concepts::Hashable T>
+    constexpr u64 operator()(T const& value) const {
+        return container::hash(value);
+    }
+};
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <di/container/hash/hash.h>
+#include <di/container/hash/hash_map.h>
+#include <di/container/hash/hash_set.h>
+#include <di/container/hash/hasher.h>
+
+namespace di {
+using container::DefaultHasher;
+using container::hash;
+using container::HashMap;
+using container::HashSet;
+}
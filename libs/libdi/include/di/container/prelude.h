@@ -4,6 +4,7 @@
 #include <di/container/algorithm/prelude.h>
 #include <di/container/allocator/prelude.h>
 #include <di/container/concepts/prelude.h>
+#include <di/container/hash/prelude.h>
 #include <di/container/interface/prelude.h>
 #include <di/container/intrusive/prelude.h>
 #include <di/container/iterator/prelude.h>
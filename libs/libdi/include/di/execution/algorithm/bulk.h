@@ -0,0 +1,99 @@
+#pragma once
+
+#include <di/concepts/integral.h>
+#include <di/concepts/movable_value.h>
+#include <di/execution/concepts/prelude.h>
+#include <di/execution/meta/prelude.h>
+#include <di/execution/query/get_completion_scheduler.h>
+#include <di/execution/receiver/prelude.h>
+#include <di/execution/types/prelude.h>
+#include <di/function/curry_back.h>
+
+namespace di::execution {
+namespace bulk_ns {
+    template<concepts::Receiver Rec, typename Shape, typename Fun>
+    struct ReceiverT {
+        struct Type : private ReceiverAdaptor<Type, Rec> {
+        private:
+            using Base = ReceiverAdaptor<Type, Rec>;
+            friend Base;
+
+        public:
+            explicit Type(Rec receiver, Shape shape, Fun function)
+                : Base(util::move(receiver)), m_shape(shape), m_function(util::move(function)) {}
+
+        private:
+            template<typename... Args>
+            requires(concepts::Invocable<Fun&, Shape, Args&...> && concepts::ReceiverOf<Rec, CompletionSignatures<SetValue(Args...)>>)
+            void set_value(Args&&... args) && {
+                for (auto i = Shape(0); i < m_shape; i++) {
+                    function::invoke(m_function, i, args...);
+                }
+                execution::set_value(util::move(*this).base(), util::forward<Args>(args)...);
+            }
+
+            Shape m_shape;
+            [[no_unique_address]] Fun m_function;
+        };
+    };
+
+    template<typename Rec, typename Shape, typename Fun>
+    using Receiver = meta::Type<ReceiverT<meta::Decay<Rec>, Shape, meta::Decay<Fun>>>;
+
+    template<typename Send, typename Shape, typename Fun>
+    struct SenderT {
+        struct Type {
+        public:
+            [[no_unique_address]] Send sender;
+            Shape shape;
+            [[no_unique_address]] Fun function;
+
+        private:
+            template<concepts::DecaysTo<Type> Self, typename Rec>
+            requires(concepts::DecayConstructible<meta::Like<Self, Send>> &&
+                     concepts::SenderTo<meta::Like<Self, Send>, Receiver<Rec, Shape, Fun>>)
+            friend auto tag_invoke(types::Tag<connect>, Self&& self, Rec receiver) {
+                return connect(util::forward<Self>(self).sender,
+                               Receiver<Rec, Shape, Fun> { util::move(receiver), self.shape, util::forward<Self>(self).function });
+            }
+
+            template<concepts::DecaysTo<Type> Self, typename Env>
+            friend auto tag_invoke(types::Tag<get_completion_signatures>, Self&&, Env)
+                -> meta::MakeCompletionSignatures<meta::Like<Self, Send>, Env>;
+
+            template<concepts::ForwardingSenderQuery Tag, typename... Args>
+            constexpr friend auto tag_invoke(Tag tag, Type const& self, Args&&... args)
+                -> decltype(tag(self.sender, util::forward<Args>(args)...)) {
+                return tag(self.sender, util::forward<Args>(args)...);
+            }
+        };
+    };
+
+    template<typename Send, typename Shape, typename Fun>
+    using Sender = meta::Type<SenderT<meta::Decay<Send>, Shape, meta::Decay<Fun>>>;
+
+    struct Function {
+        template<concepts::Sender Send, concepts::Integral Shape, concepts::MovableValue Fun>
+        concepts::Sender auto operator()(Send&& sender, Shape shape, Fun&& function) const {
+            if constexpr (requires {
+                              function::tag_invoke(*this, get_completion_scheduler<SetValue>(sender), util::forward<Send>(sender), shape,
+                                                   util::forward<Fun>(function));
+                          }) {
+                return function::tag_invoke(*this, get_completion_scheduler<SetValue>(sender), util::forward<Send>(sender), shape,
+                                            util::forward<Fun>(function));
+            } else if constexpr (requires {
+                                     function::tag_invoke(*this, util::forward<Send>(sender), shape, util::forward<Fun>(function));
+                                 }) {
+                return function::tag_invoke(*this, util::forward<Send>(sender), shape, util::forward<Fun>(function));
+            } else {
+                return Sender<Send, Shape, Fun> { util::forward<Send>(sender), shape, util::forward<Fun>(function) };
+            }
+        }
+    };
+}
+
+// Invokes function(i, values...) for every i in [0, shape), where values are sent by the input sender, and then
+// forwards the values along. This is done sequentially by default, but schedulers which can run work in parallel
+// customize bulk to spread the invocations across their threads.
+constexpr inline auto bulk = function::curry_back(bulk_ns::Function {}, meta::size_constant<3>);
+}
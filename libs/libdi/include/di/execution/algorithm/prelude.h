@@ -1,5 +1,6 @@
 #pragma once
 
+#include <di/execution/algorithm/bulk.h>
 #include <di/execution/algorithm/into_variant.h>
 #include <di/execution/algorithm/just.h>
 #include <di/execution/algorithm/just_void_or_stopped.h>
@@ -15,6 +16,7 @@
 #include <di/execution/algorithm/then.h>
 #include <di/execution/algorithm/transfer.h>
 #include <di/execution/algorithm/transfer_just.h>
+#include <di/execution/algorithm/when_all.h>
 #include <di/execution/algorithm/with.h>
 
 namespace di {
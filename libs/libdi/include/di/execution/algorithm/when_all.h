@@ -0,0 +1,260 @@
+#pragma once
+
+#include <di/execution/concepts/prelude.h>
+#include <di/execution/meta/prelude.h>
+#include <di/execution/query/get_stop_token.h>
+#include <di/execution/receiver/prelude.h>
+#include <di/execution/types/prelude.h>
+#include <di/function/unpack.h>
+#include <di/meta/index_sequence_for.h>
+#include <di/sync/atomic.h>
+#include <di/sync/stop_token/prelude.h>
+#include <di/vocab/optional/prelude.h>
+#include <di/vocab/tuple/prelude.h>
+#include <di/vocab/variant/prelude.h>
+
+namespace di::execution {
+namespace when_all_ns {
+    // Each child may send at most one set of values. A child which never sends values, like just_error(), is treated as
+    // sending none.
+    template<typename Send, typename Env>
+    concept SingleValueSender = concepts::Sender<Send, Env> && meta::Size<meta::ValueTypesOf<Send, Env, meta::List, meta::List>> <= 1;
+
+    template<typename... Tuples>
+    using FrontOrEmpty =
+        meta::Type<meta::Conditional<sizeof...(Tuples) == 0, meta::Id<Tuple<>>, meta::Defer<meta::Front, meta::List<Tuples...>>>>;
+
+    template<typename Send, typename Env>
+    using ValueTuple = meta::ValueTypesOf<Send, Env, meta::DecayedTuple, FrontOrEmpty>;
+
+    template<typename... Values>
+    using ValueSignature = SetValue(Values...);
+
+    template<typename Error>
+    using ErrorSignature = SetError(Error);
+
+    template<typename Env, typename... Sends>
+    using Values = meta::Concat<meta::AsList<ValueTuple<Sends, Env>>...>;
+
+    template<typename Env, typename... Sends>
+    using Errors = meta::Unique<meta::Transform<meta::Concat<meta::ErrorTypesOf<Sends, Env, meta::List>...>, meta::Quote<meta::Decay>>>;
+
+    template<typename Env, typename... Sends>
+    using Completions = meta::AsTemplate<
+        CompletionSignatures, meta::Concat<meta::List<meta::AsTemplate<ValueSignature, Values<Env, Sends...>>>,
+                                           meta::Transform<Errors<Env, Sends...>, meta::Quote<ErrorSignature>>, meta::List<SetStopped()>>>;
+
+    struct OnStopRequested {
+        sync::InPlaceStopSource* stop_source;
+
+        void operator()() const { stop_source->request_stop(); }
+    };
+
+    template<typename Rec, typename... Sends>
+    struct DataT {
+        struct Type {
+        private:
+            using Env = meta::EnvOf<Rec>;
+            using ValueStorage = Tuple<Optional<ValueTuple<Sends, Env>>...>;
+            using ErrorStorage = meta::AsTemplate<Variant, meta::PushFront<Errors<Env, Sends...>, Void>>;
+            using StopCallback = meta::StopTokenOf<Rec>::template CallbackType<OnStopRequested>;
+
+            enum class State : u8 { Running, Error, Stopped };
+
+        public:
+            explicit Type(Rec out_r_) : out_r(util::move(out_r_)) {}
+
+            [[no_unique_address]] Rec out_r;
+            ValueStorage values {};
+            ErrorStorage error {};
+            sync::InPlaceStopSource stop_source;
+            Optional<StopCallback> stop_callback;
+            sync::Atomic<usize> remaining { sizeof...(Sends) };
+            sync::Atomic<State> state { State::Running };
+
+            void start() {
+                stop_callback.emplace(execution::get_stop_token(out_r), OnStopRequested { util::address_of(stop_source) });
+                if constexpr (sizeof...(Sends) == 0) {
+                    complete();
+                }
+            }
+
+            template<usize index, typename... Values>
+            void set_value(Values&&... values) {
+                util::get<index>(this->values).emplace(util::forward<Values>(values)...);
+                arrive();
+            }
+
+            template<typename Error>
+            void set_error(Error&& error) {
+                // Only the first child to fail records its error, and the rest of the children are asked to stop.
+                auto expected = State::Running;
+                if (state.compare_exchange_strong(expected, State::Error, sync::MemoryOrder::AcquireRelease)) {
+                    this->error.template emplace<meta::Decay<Error>>(util::forward<Error>(error));
+                    stop_source.request_stop();
+                }
+                arrive();
+            }
+
+            void set_stopped() {
+                auto expected = State::Running;
+                if (state.compare_exchange_strong(expected, State::Stopped, sync::MemoryOrder::AcquireRelease)) {
+                    stop_source.request_stop();
+                }
+                arrive();
+            }
+
+        private:
+            void arrive() {
+                if (remaining.fetch_sub(1, sync::MemoryOrder::AcquireRelease) == 1) {
+                    complete();
+                }
+            }
+
+            void complete() {
+                stop_callback.reset();
+
+                switch (state.load(sync::MemoryOrder::Acquire)) {
+                    case State::Running:
+                        apply(
+                            [&](auto&... values) {
+                                apply(
+                                    [&](auto&&... flattened) {
+                                        execution::set_value(util::move(out_r), util::forward<decltype(flattened)>(flattened)...);
+                                    },
+                                    tuple_cat(util::move(*values)...));
+                            },
+                            this->values);
+                        return;
+                    case State::Error:
+                        visit(
+                            [&]<typename E>(E& error) {
+                                if constexpr (!concepts::SameAs<E, Void>) {
+                                    execution::set_error(util::move(out_r), util::move(error));
+                                }
+                            },
+                            this->error);
+                        return;
+                    case State::Stopped:
+                        execution::set_stopped(util::move(out_r));
+                        return;
+                }
+            }
+        };
+    };
+
+    template<concepts::Receiver Rec, typename... Sends>
+    using Data = meta::Type<DataT<Rec, Sends...>>;
+
+    template<usize index, typename Rec, typename... Sends>
+    struct ReceiverT {
+        struct Type {
+            Data<Rec, Sends...>* data { nullptr };
+
+        private:
+            template<typename... Values>
+            friend void tag_invoke(SetValue, Type&& self, Values&&... values) {
+                self.data->template set_value<index>(util::forward<Values>(values)...);
+            }
+
+            template<typename Error>
+            friend void tag_invoke(SetError, Type&& self, Error&& error) {
+                self.data->set_error(util::forward<Error>(error));
+            }
+
+            friend void tag_invoke(SetStopped, Type&& self) { self.data->set_stopped(); }
+
+            friend auto tag_invoke(types::Tag<get_stop_token>, Type const& self) { return self.data->stop_source.get_stop_token(); }
+
+            template<concepts::ForwardingReceiverQuery Tag, typename... Args>
+            constexpr friend auto tag_invoke(Tag tag, Type const& self, Args&&... args)
+                -> decltype(tag(self.data->out_r, util::forward<Args>(args)...)) {
+                return tag(self.data->out_r, util::forward<Args>(args)...);
+            }
+        };
+    };
+
+    template<usize index, concepts::Receiver Rec, typename... Sends>
+    using Receiver = meta::Type<ReceiverT<index, Rec, Sends...>>;
+
+    // Each child operation state is held in its own base class, since they are immovable and must be constructed in
+    // place directly from the result of connect().
+    template<usize index, typename Rec, typename... Sends>
+    struct ChildOperationState {
+        using Send = meta::At<meta::List<Sends...>, index>;
+
+        template<typename S>
+        explicit ChildOperationState(S&& sender, Data<Rec, Sends...>* data)
+            : op_state(execution::connect(util::forward<S>(sender), Receiver<index, Rec, Sends...> { data })) {}
+
+        meta::ConnectResult<Send, Receiver<index, Rec, Sends...>> op_state;
+    };
+
+    template<typename Rec, typename Indices, typename... Sends>
+    struct OperationStateT;
+
+    template<typename Rec, usize... indices, typename... Sends>
+    struct OperationStateT<Rec, meta::IndexSequence<indices...>, Sends...> {
+        struct Type
+            : private Data<Rec, Sends...>
+            , private ChildOperationState<indices, Rec, Sends...>... {
+        public:
+            template<typename Tup>
+            explicit Type(Rec out_r, Tup&& senders)
+                : Data<Rec, Sends...>(util::move(out_r))
+                , ChildOperationState<indices, Rec, Sends...>(util::get<indices>(util::forward<Tup>(senders)),
+                                                              static_cast<Data<Rec, Sends...>*>(this))... {}
+
+        private:
+            friend void tag_invoke(types::Tag<start>, Type& self) {
+                static_cast<Data<Rec, Sends...>&>(self).start();
+                (execution::start(static_cast<ChildOperationState<indices, Rec, Sends...>&>(self).op_state), ...);
+            }
+        };
+    };
+
+    template<concepts::Receiver Rec, typename... Sends>
+    using OperationState = meta::Type<OperationStateT<Rec, meta::IndexSequenceFor<Sends...>, Sends...>>;
+
+    template<typename... Sends>
+    struct SenderT {
+        struct Type {
+        public:
+            [[no_unique_address]] Tuple<Sends...> senders;
+
+        private:
+            template<concepts::DecaysTo<Type> Self, typename Env>
+            friend auto tag_invoke(types::Tag<get_completion_signatures>, Self&&, Env) -> DependentCompletionSignatures<Env>;
+
+            template<concepts::DecaysTo<Type> Self, typename Env>
+            requires(SingleValueSender<meta::Like<Self, Sends>, Env> && ...)
+            friend auto tag_invoke(types::Tag<get_completion_signatures>, Self&&, Env) -> Completions<Env, meta::Like<Self, Sends>...>;
+
+            template<concepts::DecaysTo<Type> Self, concepts::Receiver Rec>
+            requires(SingleValueSender<meta::Like<Self, Sends>, meta::EnvOf<Rec>> && ...)
+            friend auto tag_invoke(types::Tag<connect>, Self&& self, Rec receiver) {
+                return OperationState<Rec, meta::Like<Self, Sends>...> { util::move(receiver), util::forward<Self>(self).senders };
+            }
+        };
+    };
+
+    template<concepts::Sender... Sends>
+    using Sender = meta::Type<SenderT<Sends...>>;
+
+    struct Function {
+        template<concepts::Sender... Sends>
+        concepts::Sender auto operator()(Sends&&... senders) const {
+            if constexpr (concepts::TagInvocable<Function, Sends...>) {
+                return function::tag_invoke(*this, util::forward<Sends>(senders)...);
+            } else {
+                return Sender<meta::Decay<Sends>...> { Tuple<meta::Decay<Sends>...>(util::forward<Sends>(senders)...) };
+            }
+        }
+    };
+}
+
+// Runs every sender concurrently, and completes once all of them have. The values sent by each sender, which must each
+// send exactly one set of values, are concatenated in order. If any sender fails or is stopped, the others are asked to
+// stop, and the first error (or the stop) is reported once every sender has completed.
+constexpr inline auto when_all = when_all_ns::Function {};
+}
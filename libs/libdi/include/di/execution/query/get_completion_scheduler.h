@@ -2,6 +2,7 @@
 
 #include <di/execution/concepts/scheduler.h>
 #include <di/execution/query/forwarding_env_query.h>
+#include <di/execution/query/forwarding_sender_query.h>
 #include <di/util/as_const.h>
 
 namespace di::execution {
@@ -14,7 +15,7 @@ struct GetCompletionScheduler {
     }
 
 private:
-    constexpr bool operator()(types::Tag<forwarding_sender_query>, GetCompletionScheduler) const { return true; }
+    constexpr friend bool tag_invoke(types::Tag<forwarding_sender_query>, GetCompletionScheduler) { return true; }
 };
 
 template<concepts::OneOf<SetValue, SetError, SetStopped> CPO>
@@ -67,14 +67,16 @@ public:
 
     bool compare_exchange_weak(T& expected, T desired, MemoryOrder order = MemoryOrder::SequentialConsistency) {
         if (order == MemoryOrder::AcquireRelease || order == MemoryOrder::Release) {
-            return compare_exchange_weak(exchange, desired, MemoryOrder::Release, MemoryOrder::Acquire);
+            auto failure = order == MemoryOrder::Release ? MemoryOrder::Relaxed : MemoryOrder::Acquire;
+            return compare_exchange_weak(expected, desired, order, failure);
         } else {
             return compare_exchange_weak(expected, desired, order, order);
         }
     }
     bool compare_exchange_weak(T& expected, T desired, MemoryOrder order = MemoryOrder::SequentialConsistency) volatile {
         if (order == MemoryOrder::AcquireRelease || order == MemoryOrder::Release) {
-            return compare_exchange_weak(exchange, desired, MemoryOrder::Release, MemoryOrder::Acquire);
+            auto failure = order == MemoryOrder::Release ? MemoryOrder::Relaxed : MemoryOrder::Acquire;
+            return compare_exchange_weak(expected, desired, order, failure);
         } else {
             return compare_exchange_weak(expected, desired, order, order);
         }
@@ -91,14 +93,16 @@ public:
 
     bool compare_exchange_strong(T& expected, T desired, MemoryOrder order = MemoryOrder::SequentialConsistency) {
         if (order == MemoryOrder::AcquireRelease || order == MemoryOrder::Release) {
-            return compare_exchange_strong(exchange, desired, MemoryOrder::Release, MemoryOrder::Acquire);
+            auto failure = order == MemoryOrder::Release ? MemoryOrder::Relaxed : MemoryOrder::Acquire;
+            return compare_exchange_strong(expected, desired, order, failure);
         } else {
             return compare_exchange_strong(expected, desired, order, order);
         }
     }
     bool compare_exchange_strong(T& expected, T desired, MemoryOrder order = MemoryOrder::SequentialConsistency) volatile {
         if (order == MemoryOrder::AcquireRelease || order == MemoryOrder::Release) {
-            return compare_exchange_strong(exchange, desired, MemoryOrder::Release, MemoryOrder::Acquire);
+            auto failure = order == MemoryOrder::Release ? MemoryOrder::Relaxed : MemoryOrder::Acquire;
+            return compare_exchange_strong(expected, desired, order, failure);
         } else {
             return compare_exchange_strong(expected, desired, order, order);
         }
@@ -109,56 +113,56 @@ public:
     constexpr T fetch_add(DeltaType delta, MemoryOrder order = MemoryOrder::SequentialConsistency)
     requires(concepts::Integral<T> || concepts::Pointer<T>)
     {
-        return __atomic_add_fetch(util::address_of(m_value), adjust_delta(delta), util::to_underlying(order));
+        return __atomic_fetch_add(util::address_of(m_value), adjust_delta(delta), util::to_underlying(order));
     }
     constexpr T fetch_add(DeltaType delta, MemoryOrder order = MemoryOrder::SequentialConsistency) DI_VOLATILE
     requires(concepts::Integral<T> || concepts::Pointer<T>)
     {
-        return __atomic_add_fetch(util::address_of(m_value), adjust_delta(delta), util::to_underlying(order));
+        return __atomic_fetch_add(util::address_of(m_value), adjust_delta(delta), util::to_underlying(order));
     }
 
     constexpr T fetch_sub(DeltaType delta, MemoryOrder order = MemoryOrder::SequentialConsistency)
     requires(concepts::Integral<T> || concepts::Pointer<T>)
     {
-        return __atomic_sub_fetch(util::address_of(m_value), adjust_delta(delta), util::to_underlying(order));
+        return __atomic_fetch_sub(util::address_of(m_value), adjust_delta(delta), util::to_underlying(order));
     }
     constexpr T fetch_sub(DeltaType delta, MemoryOrder order = MemoryOrder::SequentialConsistency) DI_VOLATILE
     requires(concepts::Integral<T> || concepts::Pointer<T>)
     {
-        return __atomic_sub_fetch(util::address_of(m_value), adjust_delta(delta), util::to_underlying(order));
+        return __atomic_fetch_sub(util::address_of(m_value), adjust_delta(delta), util::to_underlying(order));
     }
 
     constexpr T fetch_and(T value, MemoryOrder order = MemoryOrder::SequentialConsistency)
     requires(concepts::Integral<T>)
     {
-        return __atomic_and_fetch(util::address_of(m_value), value, util::to_underlying(order));
+        return __atomic_fetch_and(util::address_of(m_value), value, util::to_underlying(order));
     }
     constexpr T fetch_and(T value, MemoryOrder order = MemoryOrder::SequentialConsistency) DI_VOLATILE
     requires(concepts::Integral<T>)
     {
-        return __atomic_and_fetch(util::address_of(m_value), value, util::to_underlying(order));
+        return __atomic_fetch_and(util::address_of(m_value), value, util::to_underlying(order));
     }
 
     constexpr T fetch_or(T value, MemoryOrder order = MemoryOrder::SequentialConsistency)
     requires(concepts::Integral<T>)
     {
-        return __atomic_or_fetch(util::address_of(m_value), value, util::to_underlying(order));
+        return __atomic_fetch_or(util::address_of(m_value), value, util::to_underlying(order));
     }
     constexpr T fetch_or(T value, MemoryOrder order = MemoryOrder::SequentialConsistency) DI_VOLATILE
     requires(concepts::Integral<T>)
     {
-        return __atomic_or_fetch(util::address_of(m_value), value, util::to_underlying(order));
+        return __atomic_fetch_or(util::address_of(m_value), value, util::to_underlying(order));
     }
 
     constexpr T fetch_xor(T value, MemoryOrder order = MemoryOrder::SequentialConsistency)
     requires(concepts::Integral<T>)
     {
-        return __atomic_xor_fetch(util::address_of(m_value), value, util::to_underlying(order));
+        return __atomic_fetch_xor(util::address_of(m_value), value, util::to_underlying(order));
     }
     constexpr T fetch_xor(T value, MemoryOrder order = MemoryOrder::SequentialConsistency) DI_VOLATILE
     requires(concepts::Integral<T>)
     {
-        return __atomic_xor_fetch(util::address_of(m_value), value, util::to_underlying(order));
+        return __atomic_fetch_xor(util::address_of(m_value), value, util::to_underlying(order));
     }
 
 #undef DI_VOLATILE
@@ -0,0 +1,133 @@
+#include <di/prelude.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Reports the number of comparisons and the throughput of the sorting algorithms over
+// a few input distributions which are known to be troublesome for naive quicksorts.
+
+namespace {
+constexpr auto element_count = 1000000zu;
+constexpr auto iterations = 5;
+
+u64 comparisons = 0;
+
+struct CountingCompare {
+    template<typename T>
+    constexpr auto operator()(T const& a, T const& b) const {
+        ++comparisons;
+        return di::compare(a, b);
+    }
+};
+
+u64 now_ns() {
+    auto ts = timespec {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return u64(ts.tv_sec) * 1000000000 + u64(ts.tv_nsec);
+}
+
+u32 next_random(u32& seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+enum class Pattern { Random, FewUnique, Sorted, Reversed, OrganPipe, NearlySorted };
+
+char const* pattern_name(Pattern pattern) {
+    switch (pattern) {
+        case Pattern::Random:
+            return "random";
+        case Pattern::FewUnique:
+            return "few-unique";
+        case Pattern::Sorted:
+            return "sorted";
+        case Pattern::Reversed:
+            return "reversed";
+        case Pattern::OrganPipe:
+            return "organ-pipe";
+        case Pattern::NearlySorted:
+            return "nearly-sorted";
+    }
+    return "";
+}
+
+di::Vector<u32> make_input(Pattern pattern) {
+    auto seed = u32(0x12345678);
+    auto result = di::Vector<u32> {};
+    result.reserve(element_count);
+    for (auto i = 0zu; i < element_count; i++) {
+        if (pattern == Pattern::Random) {
+            result.push_back(next_random(seed));
+        } else if (pattern == Pattern::FewUnique) {
+            result.push_back(next_random(seed) % 16);
+        } else if (pattern == Pattern::Sorted) {
+            result.push_back(u32(i));
+        } else if (pattern == Pattern::Reversed) {
+            result.push_back(u32(element_count - i));
+        } else if (pattern == Pattern::OrganPipe) {
+            result.push_back(u32(i < element_count / 2 ? i : element_count - i));
+        } else if (pattern == Pattern::NearlySorted) {
+            result.push_back(next_random(seed) % 100 == 0 ? next_random(seed) : u32(i));
+        }
+    }
+    return result;
+}
+
+template<typename F>
+void run(char const* name, Pattern pattern, F&& function) {
+    auto input = make_input(pattern);
+
+    auto total_ns = u64(0);
+    comparisons = 0;
+    for (auto i = 0; i < iterations; i++) {
+        auto data = di::Vector<u32> {};
+        data.reserve(input.size());
+        for (auto value : input) {
+            data.push_back(value);
+        }
+
+        auto start = now_ns();
+        function(data);
+        total_ns += now_ns() - start;
+
+        if (!di::is_sorted(data | di::take(data.size() / 10))) {
+            fprintf(stderr, "%s: output is not sorted for %s\n", name, pattern_name(pattern));
+            exit(1);
+        }
+    }
+
+    auto elements_per_second = double(element_count) * iterations / (double(total_ns) / 1e9);
+    auto comparisons_per_element = double(comparisons) / iterations / element_count;
+    printf("%-14s %-14s %10.2f Melem/s %8.2f cmp/elem\n", name, pattern_name(pattern), elements_per_second / 1e6,
+           comparisons_per_element);
+}
+}
+
+int main() {
+    auto patterns = di::Array { Pattern::Random,   Pattern::FewUnique, Pattern::Sorted,
+                                Pattern::Reversed, Pattern::OrganPipe, Pattern::NearlySorted };
+
+    for (auto pattern : patterns) {
+        run("sort", pattern, [](auto& data) {
+            di::sort(data, CountingCompare {});
+        });
+        run("stable_sort", pattern, [](auto& data) {
+            di::stable_sort(data, CountingCompare {});
+        });
+        run("heap_sort", pattern, [](auto& data) {
+            di::make_heap(data, CountingCompare {});
+            di::sort_heap(data, CountingCompare {});
+        });
+        run("partial_sort", pattern, [](auto& data) {
+            di::partial_sort(data, data.begin() + data.size() / 10, CountingCompare {});
+        });
+        run("nth_element", pattern, [](auto& data) {
+            auto middle = data.begin() + data.size() / 10;
+            di::nth_element(data, middle, CountingCompare {});
+            di::sort(data.begin(), middle, CountingCompare {});
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <di/prelude.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compares the throughput of HashMap against TreeMap for inserting, looking up (both hits
+// and misses), and iterating over random integer keys.
+
+namespace {
+constexpr auto element_count = 1000000zu;
+
+u64 now_ns() {
+    auto ts = timespec {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return u64(ts.tv_sec) * 1000000000 + u64(ts.tv_nsec);
+}
+
+u64 next_random(u64& seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+di::Vector<u64> make_keys(u64 seed) {
+    auto result = di::Vector<u64> {};
+    result.reserve(element_count);
+    for (auto i = 0zu; i < element_count; i++) {
+        result.push_back(next_random(seed));
+    }
+    return result;
+}
+
+void report(char const* container, char const* operation, u64 elapsed_ns) {
+    auto operations_per_second = double(element_count) / (double(elapsed_ns) / 1e9);
+    printf("%-10s %-12s %10.2f Mop/s\n", container, operation, operations_per_second / 1e6);
+}
+
+template<typename Map>
+void run(char const* name, di::Vector<u64> const& keys, di::Vector<u64> const& missing_keys) {
+    auto map = Map {};
+
+    auto start = now_ns();
+    for (auto key : keys) {
+        map.insert_or_assign(u64(key), u64(key));
+    }
+    report(name, "insert", now_ns() - start);
+
+    auto found = 0zu;
+    start = now_ns();
+    for (auto key : keys) {
+        found += map.contains(key);
+    }
+    report(name, "lookup-hit", now_ns() - start);
+
+    start = now_ns();
+    for (auto key : missing_keys) {
+        found += map.contains(key);
+    }
+    report(name, "lookup-miss", now_ns() - start);
+
+    if (found != element_count) {
+        fprintf(stderr, "%s: expected %zu keys to be found, but found %zu\n", name, element_count, found);
+        exit(1);
+    }
+
+    auto sum = u64(0);
+    start = now_ns();
+    for (auto [key, value] : map) {
+        sum += value;
+    }
+    report(name, "iterate", now_ns() - start);
+
+    if (sum == 0) {
+        fprintf(stderr, "%s: iteration did not visit any values\n", name);
+        exit(1);
+    }
+}
+}
+
+int main() {
+    auto keys = make_keys(0x123456789abcdef);
+    auto missing_keys = make_keys(0xfedcba987654321);
+
+    run<di::HashMap<u64, u64>>("HashMap", keys, missing_keys);
+    run<di::TreeMap<u64, u64>>("TreeMap", keys, missing_keys);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <dius/prelude.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Reports how a CPU-bound sender pipeline scales with the number of threads in a StaticThreadPool, by computing a
+// checksum over a memory mapped file using execution::bulk.
+
+namespace {
+constexpr auto file_size = 256zu * 1024 * 1024;
+constexpr auto block_size = 64zu * 1024;
+constexpr auto block_count = file_size / block_size;
+constexpr auto words_per_block = block_size / sizeof(u64);
+constexpr auto pass_count = 4zu;
+
+constexpr auto path = "/tmp/bench_execution_thread_pool"_pv;
+
+u64 now_ns() {
+    auto ts = timespec {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return u64(ts.tv_sec) * 1000000000 + u64(ts.tv_nsec);
+}
+
+[[noreturn]] void fail(char const* message) {
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+template<typename T>
+T check(di::Result<T>&& result, char const* message) {
+    if (!result) {
+        fail(message);
+    }
+    if constexpr (!di::SameAs<T, void>) {
+        return di::move(result).value();
+    }
+}
+
+void create_file() {
+    auto file = check(dius::open_sync(path, dius::OpenMode::WriteClobber), "Failed to create file");
+
+    auto seed = u64(0x123456789abcdef);
+    auto buffer = di::Vector<u64> {};
+    buffer.resize(block_size / sizeof(u64));
+    for (auto offset = 0zu; offset < file_size; offset += block_size) {
+        for (auto& word : buffer) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            word = seed;
+        }
+        auto bytes = di::Span { reinterpret_cast<di::Byte const*>(buffer.data()), block_size };
+        check(file.write_exactly(bytes), "Failed to write file");
+    }
+}
+
+// A deliberately compute heavy mixing function, so that the benchmark is limited by the CPU rather than by memory
+// bandwidth.
+u64 checksum_block(di::Span<u64 const> block) {
+    auto hash = u64(0xcbf29ce484222325);
+    for (auto word : block) {
+        hash ^= word;
+        hash *= 0x100000001b3;
+        hash ^= hash >> 29;
+        hash *= 0xbf58476d1ce4e5b9;
+    }
+    return hash;
+}
+
+u64 combine(di::Vector<u64> const& checksums) {
+    auto result = u64(0);
+    for (auto checksum : checksums) {
+        result = (result ^ checksum) * 0x9e3779b97f4a7c15;
+    }
+    return result;
+}
+
+u64 run_serial(di::Span<u64 const> data, di::Vector<u64>& checksums) {
+    for (auto i = 0zu; i < block_count; i++) {
+        checksums[i] = checksum_block(*data.subspan(i * words_per_block, words_per_block));
+    }
+    return combine(checksums);
+}
+
+u64 run_parallel(dius::StaticThreadPool& pool, di::Span<u64 const> data, di::Vector<u64>& checksums) {
+    namespace ex = di::execution;
+
+    auto work = ex::schedule(pool.get_scheduler()) | ex::bulk(block_count, [&](usize i) {
+                    checksums[i] = checksum_block(*data.subspan(i * words_per_block, words_per_block));
+                }) |
+                ex::then([&] {
+                    return combine(checksums);
+                });
+    return di::get<0>(check(ex::sync_wait(di::move(work)), "Failed to run checksum"));
+}
+
+void report(char const* name, usize thread_count, u64 elapsed_ns, u64 baseline_ns) {
+    auto megabytes_per_second = double(file_size * pass_count) / (double(elapsed_ns) / 1e9) / (1024 * 1024);
+    printf("%-8s %3zu threads %10.2f MiB/s %6.2fx\n", name, thread_count, megabytes_per_second,
+           double(baseline_ns) / double(elapsed_ns));
+}
+}
+
+int main() {
+    create_file();
+
+    auto file = check(dius::open_sync(path, dius::OpenMode::Readonly), "Failed to open file");
+    auto region = check(file.map(0, file_size, dius::Protection::Readable, dius::MapFlags::Shared), "Failed to map file");
+    // The mapping is page aligned, so it can be read a word at a time.
+    auto data = di::Span { reinterpret_cast<u64 const*>(region.data()), file_size / sizeof(u64) };
+
+    auto checksums = di::Vector<u64> {};
+    checksums.resize(block_count);
+
+    // Fault the whole mapping in first, so that the serial run is not penalized for touching the pages first.
+    auto expected = run_serial(data, checksums);
+
+    auto start = now_ns();
+    for (auto i = 0zu; i < pass_count; i++) {
+        if (run_serial(data, checksums) != expected) {
+            fail("Serial checksum is not deterministic");
+        }
+    }
+    auto baseline_ns = now_ns() - start;
+    report("serial", 1, baseline_ns, baseline_ns);
+
+    auto processor_count = usize(di::max(sysconf(_SC_NPROCESSORS_ONLN), 1l));
+    auto thread_counts = di::Vector<usize> {};
+    thread_counts.push_back(1);
+    thread_counts.push_back(2);
+    thread_counts.push_back(4);
+    if (processor_count > 4) {
+        thread_counts.push_back(processor_count);
+    }
+
+    for (auto thread_count : thread_counts) {
+        auto pool = check(dius::StaticThreadPool::create(thread_count), "Failed to create thread pool");
+
+        start = now_ns();
+        for (auto i = 0zu; i < pass_count; i++) {
+            if (run_parallel(pool, data, checksums) != expected) {
+                fail("Parallel checksum does not match serial checksum");
+            }
+        }
+        report("bulk", thread_count, now_ns() - start, baseline_ns);
+    }
+    return 0;
+}
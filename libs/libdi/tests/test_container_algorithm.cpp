@@ -156,6 +156,110 @@ constexpr void sort() {
     auto s = di::Array { X { 5 }, X { 4 }, X { 2 }, X { 3 } };
     di::sort(s, di::compare, &X::a);
     ASSERT(di::is_sorted(s, di::compare, &X::a));
+
+    // Exercise the partitioning paths, which are only taken for larger inputs.
+    auto seed = 12345u;
+    auto random = [&] {
+        seed = seed * 1103515245u + 12345u;
+        return int((seed >> 16) % 1000);
+    };
+
+    auto r = di::Vector<int> {};
+    for (auto i = 0; i < 200; i++) {
+        r.push_back(random());
+    }
+    di::sort(r);
+    ASSERT(di::is_sorted(r));
+
+    auto few = di::Vector<int> {};
+    for (auto i = 0; i < 200; i++) {
+        few.push_back(random() % 4);
+    }
+    di::sort(few);
+    ASSERT(di::is_sorted(few));
+
+    auto organ_pipe = di::range(100) | di::to<di::Vector>();
+    organ_pipe.append_container(di::range(100) | di::reverse);
+    di::sort(organ_pipe, di::compare_backwards);
+    ASSERT(di::is_sorted(organ_pipe | di::reverse));
+}
+
+constexpr void stable_sort() {
+    struct X {
+        int key;
+        int index;
+    };
+
+    auto seed = 1u;
+    auto v = di::Vector<X> {};
+    for (auto i = 0; i < 150; i++) {
+        seed = seed * 1103515245u + 12345u;
+        v.push_back(X { int((seed >> 16) % 10), i });
+    }
+
+    di::stable_sort(v, di::compare, &X::key);
+    ASSERT(di::is_sorted(v, di::compare, &X::key));
+    for (auto i = 1zu; i < v.size(); i++) {
+        if (v[i - 1].key == v[i].key) {
+            ASSERT_LT(v[i - 1].index, v[i].index);
+        }
+    }
+
+    auto a = di::Array { 3, 5, 1, 2 };
+    di::stable_sort(a);
+    ASSERT_EQ(a, (di::Array { 1, 2, 3, 5 }));
+
+    auto scores = di::Array { 50, 20, 70, 20 };
+    auto data = di::Array { 37, 42, 60, 100 };
+    di::stable_sort(di::zip(scores, data), di::compare, [](auto const& x) {
+        return di::get<0>(x);
+    });
+    ASSERT_EQ(scores, (di::Array { 20, 20, 50, 70 }));
+    ASSERT_EQ(data, (di::Array { 42, 100, 37, 60 }));
+}
+
+constexpr void partial_sort() {
+    auto v = di::range(100) | di::reverse | di::to<di::Vector>();
+    di::partial_sort(v, v.begin() + 10);
+    ASSERT(di::container::equal(v | di::take(10), di::range(10)));
+
+    auto w = di::Array { 5, 3, 4, 1, 2 };
+    di::partial_sort(w, w.begin() + 2, di::compare_backwards);
+    ASSERT_EQ(w[0], 5);
+    ASSERT_EQ(w[1], 4);
+
+    auto x = di::Array { 2, 1 };
+    di::partial_sort(x, x.begin());
+    ASSERT_EQ(x, (di::Array { 2, 1 }));
+}
+
+constexpr void nth_element() {
+    auto seed = 7u;
+    auto v = di::Vector<int> {};
+    for (auto i = 0; i < 150; i++) {
+        seed = seed * 1103515245u + 12345u;
+        v.push_back(int((seed >> 16) % 50));
+    }
+
+    auto sorted = v.clone();
+    di::sort(sorted);
+
+    for (auto n : di::Array { 0, 1, 37, 75, 149 }) {
+        auto copy = v.clone();
+        auto nth = copy.begin() + n;
+        di::nth_element(copy, nth);
+        ASSERT_EQ(*nth, sorted[n]);
+        ASSERT(di::all_of(copy.begin(), nth, [&](int x) {
+            return x <= *nth;
+        }));
+        ASSERT(di::all_of(nth, copy.end(), [&](int x) {
+            return x >= *nth;
+        }));
+    }
+
+    auto a = di::Array { 3, 5, 1, 2 };
+    di::nth_element(a, a.begin() + 1);
+    ASSERT_EQ(a[1], 2);
 }
 
 TESTC(container_algorithm, minmax)
@@ -166,4 +270,7 @@ TESTC(container_algorithm, permute)
 TESTC(container_algorithm, contains)
 TESTC(container_algorithm, predicate)
 TESTC(container_algorithm, for_each)
-TESTC(container_algorithm, sort)
\ No newline at end of file
+TESTC(container_algorithm, sort)
+TESTC(container_algorithm, stable_sort)
+TESTC(container_algorithm, partial_sort)
+TESTC(container_algorithm, nth_element)
\ No newline at end of file
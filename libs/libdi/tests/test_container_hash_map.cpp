@@ -0,0 +1,104 @@
+#include <di/prelude.h>
+#include <dius/test/prelude.h>
+
+constexpr void basic() {
+    auto x = di::zip(di::range(4), di::range(4)) | di::to<di::HashMap>();
+
+    ASSERT_EQ(x.size(), 4u);
+    ASSERT_EQ(x.at(1), 1);
+    ASSERT_EQ(x.at(2), 2);
+    ASSERT_EQ(x.at(3), 3);
+    ASSERT_EQ(x.at(4), di::nullopt);
+
+    auto [it, did_insert] = x.insert_or_assign(2, 5);
+    ASSERT_EQ(*it, (di::Tuple { 2, 5 }));
+    ASSERT(!did_insert);
+
+    auto [jt, jid_insert] = x.try_emplace(4, 8);
+    ASSERT_EQ(*jt, di::make_tuple(4, 8));
+    ASSERT(jid_insert);
+
+    x[5] = 5;
+    ASSERT_EQ(x.at(5), 5);
+    ASSERT_EQ(x.size(), 6u);
+}
+
+constexpr void heterogeneous() {
+    auto x = di::HashMap<di::String, di::String> {};
+    x.try_emplace("hello"_sv, "world"_sv);
+    x.try_emplace("foo"_sv, "bar"_sv);
+
+    ASSERT_EQ(x.at("hello"_sv), "world"_sv);
+    ASSERT_EQ(x.at("foo"_sv), "bar"_sv);
+    ASSERT(!x.contains("world"_sv));
+
+    ASSERT_EQ(x.erase("foo"_sv), 1u);
+    ASSERT(!x.contains("foo"_sv));
+    ASSERT_EQ(x.size(), 1u);
+}
+
+constexpr void erase() {
+    auto x = di::zip(di::range(100), di::range(100)) | di::to<di::HashMap>();
+
+    for (auto i : di::range(100) | di::stride(2)) {
+        ASSERT_EQ(x.erase(i), 1u);
+    }
+    ASSERT_EQ(x.erase(0), 0u);
+    ASSERT_EQ(x.size(), 50u);
+
+    for (auto i : di::range(100)) {
+        ASSERT_EQ(x.contains(i), i % 2 == 1);
+    }
+    ASSERT_EQ(di::distance(x), 50);
+    ASSERT_EQ(di::sum(x | di::keys), 2500);
+
+    x.erase(x.begin(), x.end());
+    ASSERT(x.empty());
+    ASSERT_EQ(di::distance(x), 0);
+}
+
+constexpr void property() {
+    auto do_test = [](di::UniformRandomBitGenerator auto rng) {
+        auto x = di::HashMap<int, int> {};
+        auto y = di::Array<di::Optional<int>, 301> {};
+
+        auto distribution = di::UniformIntDistribution<> { 1, 300 };
+
+        auto iterations = di::is_constant_evaluated() ? 99 : 2000;
+        for (auto i : di::range(iterations)) {
+            auto value = distribution(rng);
+            if (i % 3 == 2) {
+                ASSERT_EQ(x.erase(value), y[value].has_value() ? 1u : 0u);
+                y[value] = di::nullopt;
+            } else {
+                x.insert_or_assign(int(value), int(i));
+                y[value] = i;
+            }
+            ASSERT_EQ(x.size(), usize(di::count_if(y, [](auto const& v) {
+                          return v.has_value();
+                      })));
+        }
+
+        ASSERT_EQ(di::distance(x), di::count_if(y, [](auto const& v) {
+                      return v.has_value();
+                  }));
+        for (auto key : di::range(301)) {
+            if (y[key]) {
+                ASSERT_EQ(x.at(key), *y[key]);
+            }
+        }
+    };
+
+    do_test(di::MinstdRand(1));
+
+    if (!di::is_constant_evaluated()) {
+        do_test(di::MinstdRand(2));
+        do_test(di::MinstdRand(3));
+        do_test(di::MinstdRand(4));
+    }
+}
+
+TESTC(container_hash_map, basic)
+TESTC(container_hash_map, heterogeneous)
+TESTC(container_hash_map, erase)
+TESTC(container_hash_map, property)
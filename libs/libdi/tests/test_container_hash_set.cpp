@@ -0,0 +1,87 @@
+#include <di/prelude.h>
+#include <dius/test/prelude.h>
+
+constexpr void basic() {
+    di::HashSet<int> x;
+    x.clear();
+    ASSERT_EQ(di::distance(x), 0);
+
+    x.insert_container(di::Array { 1, 2, 5, 0, 4, -6, 6, 3 });
+
+    auto [it, did_insert] = x.insert(3);
+    ASSERT_EQ(*it, 3);
+    ASSERT(!did_insert);
+
+    ASSERT_EQ(di::distance(x), 8);
+    ASSERT_EQ(di::sum(x), 15);
+}
+
+constexpr void accessors() {
+    auto x = di::range(1, 6) | di::to<di::HashSet>();
+
+    auto const& y = x;
+    ASSERT_EQ(*y.find(3), 3);
+    ASSERT_EQ(*y.at(3), 3);
+    ASSERT_EQ(y.at(6), di::nullopt);
+    ASSERT_EQ(y.count(3), 1u);
+    ASSERT_EQ(y.count(10), 0u);
+    ASSERT(y.find(10) == y.end());
+}
+
+constexpr void erase() {
+    auto x = di::to<di::HashSet>(di::range(1, 6));
+
+    x.erase(x.find(2));
+    ASSERT(!x.contains(2));
+    ASSERT_EQ(x.erase(1), 1u);
+    ASSERT_EQ(x.erase(6), 0u);
+    ASSERT_EQ(x.size(), 3u);
+}
+
+constexpr void grow() {
+    auto x = di::HashSet<unsigned int> {};
+    auto iterations = di::is_constant_evaluated() ? 200u : 100000u;
+    for (auto i : di::range(iterations)) {
+        auto [it, did_insert] = x.insert(i * 7919);
+        ASSERT(did_insert);
+    }
+    ASSERT_EQ(x.size(), iterations);
+    ASSERT_GT_EQ(x.capacity(), iterations);
+
+    for (auto i : di::range(iterations)) {
+        ASSERT(x.contains(i * 7919));
+        ASSERT(!x.contains(i * 7919 + 1));
+    }
+
+    x.clear();
+    ASSERT(x.empty());
+    ASSERT(x.begin() == x.end());
+}
+
+struct Point {
+    int x;
+    int y;
+
+    constexpr friend bool operator==(Point const&, Point const&) = default;
+
+    constexpr friend u64 tag_invoke(di::Tag<di::hash>, Point const& point) {
+        return di::hash(point.x) ^ (di::hash(point.y) * 31);
+    }
+};
+
+constexpr void custom_hash() {
+    auto x = di::HashSet<Point> {};
+    x.insert(Point { 1, 2 });
+    x.insert(Point { 2, 1 });
+    x.insert(Point { 1, 2 });
+
+    ASSERT_EQ(x.size(), 2u);
+    ASSERT(x.contains(Point { 2, 1 }));
+    ASSERT(!x.contains(Point { 2, 2 }));
+}
+
+TESTC(container_hash_set, basic)
+TESTC(container_hash_set, accessors)
+TESTC(container_hash_set, erase)
+TESTC(container_hash_set, grow)
+TESTC(container_hash_set, custom_hash)
@@ -241,6 +241,103 @@ static void with() {
     ASSERT_EQ(ex::sync_wait(di::move(w)), di::make_tuple(42));
 }
 
+static void when_all() {
+    namespace ex = di::execution;
+
+    auto w = ex::when_all(ex::just(1), ex::just(), ex::just(2, 3));
+    ASSERT_EQ(ex::sync_wait(di::move(w)), di::make_tuple(1, 2, 3));
+
+    auto v = ex::when_all();
+    ASSERT(ex::sync_wait(di::move(v)));
+
+    auto e = ex::when_all(ex::just(1), ex::just_error(di::BasicError::Invalid), ex::just(2));
+    ASSERT_EQ(ex::sync_wait(di::move(e)), di::Unexpected(di::BasicError::Invalid));
+
+    auto s = ex::when_all(ex::just(1), ex::just_stopped());
+    ASSERT_EQ(ex::sync_wait(di::move(s)), di::Unexpected(di::BasicError::Cancelled));
+
+    // Stopping one child requests a stop on the others.
+    auto c = ex::when_all(ex::just_stopped(), ex::get_stop_token());
+    ASSERT_EQ(ex::sync_wait(di::move(c)), di::Unexpected(di::BasicError::Cancelled));
+
+    auto t = ex::when_all(ex::get_stop_token());
+    ASSERT(ex::sync_wait(di::move(t)));
+}
+
+static void bulk() {
+    namespace ex = di::execution;
+
+    auto values = di::Array<int, 10> {};
+    auto w = ex::just(3) | ex::bulk(values.size(), [&](usize i, int x) {
+                 values[i] = int(i) * x;
+             });
+    ASSERT_EQ(ex::sync_wait(di::move(w)), 3);
+    for (auto i = 0zu; i < values.size(); i++) {
+        ASSERT_EQ(values[i], int(i) * 3);
+    }
+
+    auto e = ex::when_all(ex::just(1), ex::just_error(di::BasicError::Invalid)) | ex::bulk(10, [](int, int) {
+                 DI_ASSERT(false);
+             });
+    ASSERT_EQ(ex::sync_wait(di::move(e)), di::Unexpected(di::BasicError::Invalid));
+}
+
+static void static_thread_pool() {
+    namespace ex = di::execution;
+
+    auto pool = *dius::StaticThreadPool::create(4);
+    auto scheduler = pool.get_scheduler();
+
+    static_assert(di::Scheduler<decltype(scheduler)>);
+
+    auto w = ex::schedule(scheduler) | ex::then([] {
+                 return 42;
+             });
+    ASSERT_EQ(ex::sync_wait(di::move(w)), 42);
+
+    auto v = ex::on(scheduler, ex::just(42) | ex::let_value([](int x) {
+                                   return ex::just(x + 1);
+                               }));
+    ASSERT_EQ(ex::sync_wait(di::move(v)), 43);
+
+    auto t = ex::transfer_just(scheduler, 44);
+    ASSERT_EQ(ex::sync_wait(di::move(t)), 44);
+
+    // Every index is visited exactly once, even when the work is spread across the workers.
+    auto counts = di::Vector<u32> {};
+    counts.resize(10000);
+    auto b = ex::transfer_just(scheduler, 2u) | ex::bulk(counts.size(), [&](usize i, u32 x) {
+                 counts[i] += x;
+             }) |
+             ex::then([](u32 x) {
+                 return x + 1;
+             });
+    ASSERT_EQ(ex::sync_wait(di::move(b)), 3u);
+    for (auto& count : counts) {
+        ASSERT_EQ(count, 2u);
+    }
+
+    auto empty = ex::schedule(scheduler) | ex::bulk(0, [](int) {
+                     DI_ASSERT(false);
+                 });
+    ASSERT(ex::sync_wait(di::move(empty)));
+
+    // Work scheduled from within the pool is run on the pool as well.
+    auto sum = di::Atomic<u32> { 0 };
+    auto nested = ex::schedule(scheduler) | ex::let_value([&] {
+                      return ex::when_all(ex::schedule(scheduler) | ex::then([&] {
+                                              sum.fetch_add(1);
+                                              return 1;
+                                          }),
+                                          ex::schedule(scheduler) | ex::then([&] {
+                                              sum.fetch_add(2);
+                                              return 2;
+                                          }));
+                  });
+    ASSERT_EQ(ex::sync_wait(di::move(nested)), di::make_tuple(1, 2));
+    ASSERT_EQ(sum.load(), 3u);
+}
+
 TEST(execution, meta)
 TEST(execution, sync_wait)
 TEST(execution, lazy)
@@ -250,4 +347,7 @@ TEST(execution, inline_scheduler)
 TEST(execution, let)
 TEST(execution, transfer)
 TEST(execution, as)
-TEST(execution, with)
\ No newline at end of file
+TEST(execution, with)
+TEST(execution, when_all)
+TEST(execution, bulk)
+TEST(execution, static_thread_pool)
\ No newline at end of file
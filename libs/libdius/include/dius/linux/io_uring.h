@@ -26,11 +26,28 @@ namespace io_uring {
         di::Optional<SQE&> get_next_sqe();
         di::Optional<CQE&> get_next_cqe();
 
+        // Returns the number of sqes which can be queued before the submission queue must be flushed.
+        u32 sqe_space_left() const;
+
+        // Submits all queued sqes, without waiting for any of them to complete.
+        di::Result<void> submit();
         di::Result<void> submit_and_wait();
 
+        // Buffers and files registered with the kernel are referred to by their index in the registered span.
+        // Using them avoids the kernel having to map the buffer or look up the file on every operation.
+        di::Result<void> register_buffers(di::Span<di::Span<di::Byte> const> buffers);
+        di::Result<void> unregister_buffers();
+        di::Result<void> register_files(di::Span<int const> file_descriptors);
+        di::Result<void> unregister_files();
+
+        // The number of io_uring_enter() system calls made so far.
+        u64 enter_count() const { return total_enter_calls; }
+
     private:
         IoUringHandle() = default;
 
+        di::Result<void> enter(u32 min_complete);
+
         u32 sq_entry_count;
         u32 sq_mask;
         u32* sq_index_array;
@@ -54,6 +71,7 @@ namespace io_uring {
         MemoryRegion cq_region;
 
         u32 sq_pending { 0 };
+        u64 total_enter_calls { 0 };
     };
 }
 }
@@ -19,6 +19,9 @@ struct IoUringScheduler;
 template<di::concepts::Invocable<io_uring::SQE*> Fun>
 static void enqueue_io_operation(IoUringContext*, OperationStateBase* op, Fun&& function);
 
+template<di::concepts::Invocable<io_uring::SQE*>... Funs>
+static void enqueue_linked_io_operations(IoUringContext*, OperationStateBase* op, Funs&&... functions);
+
 void enqueue_operation(IoUringContext*, OperationStateBase*);
 
 IoUringScheduler get_scheduler(IoUringContext*);
@@ -29,6 +32,19 @@ public:
     virtual void did_complete(io_uring::CQE const*) {}
 };
 
+// Operation states are at least 8 byte aligned, so the low bits of an sqe's user data describe its place in a link chain.
+// Every chain produces exactly one completion carrying one of these flags, and the chain is finished once it arrives.
+namespace user_data {
+    // Set on the last sqe of a chain.
+    constexpr inline auto last_in_chain = uintptr_t(1);
+
+    // Set on an sqe flagged with IOSQE_CQE_SKIP_SUCCESS. Its completion is only posted if it fails, in which case the
+    // kernel also skips the completions of the rest of the chain.
+    constexpr inline auto skip_success = uintptr_t(2);
+
+    constexpr inline auto mask = uintptr_t(7);
+}
+
 struct ReadSomeSender {
 public:
     using CompletionSignatures = di::CompletionSignatures<di::SetValue(size_t), di::SetError(di::Error), di::SetStopped()>;
@@ -38,15 +54,22 @@ public:
     di::Span<di::Byte> buffer;
     di::Optional<u64> offset;
 
+    // When set, buffer must lie within the registered buffer with this index.
+    di::Optional<u16> buffer_index;
+    u8 sqe_flags { 0 };
+
 private:
     template<typename Rec>
     struct OperationStateT {
         struct Type : OperationStateBase {
-            explicit Type(IoUringContext* parent, int file_descriptor, di::Span<di::Byte> buffer, di::Optional<u64> offset, Rec receiver)
+            explicit Type(IoUringContext* parent, int file_descriptor, di::Span<di::Byte> buffer, di::Optional<u64> offset,
+                          di::Optional<u16> buffer_index, u8 sqe_flags, Rec receiver)
                 : m_parent(parent)
                 , m_file_descriptor(file_descriptor)
                 , m_buffer(buffer)
                 , m_offset(offset)
+                , m_buffer_index(buffer_index)
+                , m_sqe_flags(sqe_flags)
                 , m_receiver(di::move(receiver)) {}
 
             virtual void execute() override {
@@ -55,11 +78,13 @@ private:
                 } else {
                     // Enqueue io_uring sqe with the read request.
                     enqueue_io_operation(m_parent, this, [&](auto* sqe) {
-                        sqe->opcode = IORING_OP_READ;
+                        sqe->opcode = m_buffer_index ? IORING_OP_READ_FIXED : IORING_OP_READ;
+                        sqe->flags = m_sqe_flags;
                         sqe->fd = m_file_descriptor;
                         sqe->off = m_offset.value_or((u64) -1);
                         sqe->addr = reinterpret_cast<u64>(m_buffer.data());
                         sqe->len = m_buffer.size();
+                        sqe->buf_index = m_buffer_index.value_or(0);
                     });
                 }
             }
@@ -79,6 +104,8 @@ private:
             int m_file_descriptor;
             di::Span<di::Byte> m_buffer;
             di::Optional<u64> m_offset;
+            di::Optional<u16> m_buffer_index;
+            u8 m_sqe_flags;
             [[no_unique_address]] Rec m_receiver;
         };
     };
@@ -88,7 +115,9 @@ private:
 
     template<di::ReceiverOf<CompletionSignatures> Receiver>
     friend auto tag_invoke(di::Tag<di::execution::connect>, ReadSomeSender self, Receiver receiver) {
-        return OperationState<Receiver> { self.parent, self.file_descriptor, self.buffer, self.offset, di::move(receiver) };
+        return OperationState<Receiver> {
+            self.parent, self.file_descriptor, self.buffer, self.offset, self.buffer_index, self.sqe_flags, di::move(receiver)
+        };
     }
 
     template<typename CPO>
@@ -106,16 +135,22 @@ public:
     di::Span<di::Byte const> buffer;
     di::Optional<u64> offset;
 
+    // When set, buffer must lie within the registered buffer with this index.
+    di::Optional<u16> buffer_index;
+    u8 sqe_flags { 0 };
+
 private:
     template<typename Rec>
     struct OperationStateT {
         struct Type : OperationStateBase {
             explicit Type(IoUringContext* parent, int file_descriptor, di::Span<di::Byte const> buffer, di::Optional<u64> offset,
-                          Rec receiver)
+                          di::Optional<u16> buffer_index, u8 sqe_flags, Rec receiver)
                 : m_parent(parent)
                 , m_file_descriptor(file_descriptor)
                 , m_buffer(buffer)
                 , m_offset(offset)
+                , m_buffer_index(buffer_index)
+                , m_sqe_flags(sqe_flags)
                 , m_receiver(di::move(receiver)) {}
 
             virtual void execute() override {
@@ -124,11 +159,13 @@ private:
                 } else {
                     // Enqueue io_uring sqe with the write request.
                     enqueue_io_operation(m_parent, this, [&](auto* sqe) {
-                        sqe->opcode = IORING_OP_WRITE;
+                        sqe->opcode = m_buffer_index ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+                        sqe->flags = m_sqe_flags;
                         sqe->fd = m_file_descriptor;
                         sqe->off = m_offset.value_or((u64) -1);
                         sqe->addr = reinterpret_cast<u64>(m_buffer.data());
                         sqe->len = m_buffer.size();
+                        sqe->buf_index = m_buffer_index.value_or(0);
                     });
                 }
             }
@@ -148,6 +185,8 @@ private:
             int m_file_descriptor;
             di::Span<di::Byte const> m_buffer;
             di::Optional<u64> m_offset;
+            di::Optional<u16> m_buffer_index;
+            u8 m_sqe_flags;
             [[no_unique_address]] Rec m_receiver;
         };
     };
@@ -157,7 +196,9 @@ private:
 
     template<di::ReceiverOf<CompletionSignatures> Receiver>
     friend auto tag_invoke(di::Tag<di::execution::connect>, WriteSomeSender self, Receiver receiver) {
-        return OperationState<Receiver> { self.parent, self.file_descriptor, self.buffer, self.offset, di::move(receiver) };
+        return OperationState<Receiver> {
+            self.parent, self.file_descriptor, self.buffer, self.offset, self.buffer_index, self.sqe_flags, di::move(receiver)
+        };
     }
 
     template<typename CPO>
@@ -166,6 +207,143 @@ private:
     }
 };
 
+// Copies up to buffer.size() bytes from one file to another, by submitting a read into the buffer linked to a write out of
+// it. The kernel only starts the write once the read completes, and the read only posts a completion if it fails, so each
+// copy needs a single trip through the event loop instead of two. A short read cancels the linked write, in which case the
+// bytes which were read are written by a follow up operation. Completes with the number of bytes written.
+struct CopySomeSender {
+public:
+    using CompletionSignatures = di::CompletionSignatures<di::SetValue(size_t), di::SetError(di::Error), di::SetStopped()>;
+
+    IoUringContext* parent { nullptr };
+    int source_file_descriptor { -1 };
+    u64 source_offset { 0 };
+    int destination_file_descriptor { -1 };
+    u64 destination_offset { 0 };
+    di::Span<di::Byte> buffer;
+
+    // When set, buffer must lie within the registered buffer with this index.
+    di::Optional<u16> buffer_index;
+    u8 source_sqe_flags { 0 };
+    u8 destination_sqe_flags { 0 };
+
+private:
+    template<typename Rec>
+    struct OperationStateT {
+        struct Type : OperationStateBase {
+            explicit Type(IoUringContext* parent, int source_file_descriptor, u64 source_offset, int destination_file_descriptor,
+                          u64 destination_offset, di::Span<di::Byte> buffer, di::Optional<u16> buffer_index, u8 source_sqe_flags,
+                          u8 destination_sqe_flags, Rec receiver)
+                : m_parent(parent)
+                , m_source_file_descriptor(source_file_descriptor)
+                , m_source_offset(source_offset)
+                , m_destination_file_descriptor(destination_file_descriptor)
+                , m_destination_offset(destination_offset)
+                , m_buffer(buffer)
+                , m_buffer_index(buffer_index)
+                , m_source_sqe_flags(source_sqe_flags)
+                , m_destination_sqe_flags(destination_sqe_flags)
+                , m_receiver(di::move(receiver)) {}
+
+            virtual void execute() override {
+                if (di::execution::get_stop_token(m_receiver).stop_requested()) {
+                    di::execution::set_stopped(di::move(m_receiver));
+                } else {
+                    // Enqueue io_uring sqes with the read request, linked to the write request.
+                    enqueue_linked_io_operations(
+                        m_parent, this,
+                        [&](auto* sqe) {
+                            sqe->opcode = m_buffer_index ? IORING_OP_READ_FIXED : IORING_OP_READ;
+                            sqe->flags = m_source_sqe_flags | IOSQE_CQE_SKIP_SUCCESS;
+                            sqe->fd = m_source_file_descriptor;
+                            sqe->off = m_source_offset;
+                            sqe->addr = reinterpret_cast<u64>(m_buffer.data());
+                            sqe->len = m_buffer.size();
+                            sqe->buf_index = m_buffer_index.value_or(0);
+                        },
+                        [&](auto* sqe) {
+                            prepare_write(sqe, m_buffer.size());
+                        });
+                }
+            }
+
+            virtual void did_complete(io_uring::CQE const* cqe) override {
+                // The write completed, or the remaining bytes of a short read were written.
+                if (m_state == State::WritingRemainder || !(cqe->user_data & user_data::skip_success)) {
+                    return complete(cqe->res);
+                }
+
+                // Otherwise, the read failed or was short, and the linked write was cancelled.
+                if (cqe->res <= 0) {
+                    return complete(cqe->res);
+                }
+
+                m_state = State::WritingRemainder;
+                enqueue_io_operation(m_parent, this, [&](auto* sqe) {
+                    prepare_write(sqe, cqe->res);
+                });
+            }
+
+        private:
+            enum class State { Copying, WritingRemainder };
+
+            void prepare_write(io_uring::SQE* sqe, size_t count) {
+                sqe->opcode = m_buffer_index ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+                sqe->flags = m_destination_sqe_flags;
+                sqe->fd = m_destination_file_descriptor;
+                sqe->off = m_destination_offset;
+                sqe->addr = reinterpret_cast<u64>(m_buffer.data());
+                sqe->len = count;
+                sqe->buf_index = m_buffer_index.value_or(0);
+            }
+
+            void complete(int result) {
+                if (result < 0) {
+                    di::execution::set_error(di::move(m_receiver), di::Error(PosixError(-result)));
+                } else {
+                    di::execution::set_value(di::move(m_receiver), static_cast<size_t>(result));
+                }
+            }
+
+            friend void tag_invoke(di::Tag<di::execution::start>, Type& self) { enqueue_operation(self.m_parent, di::address_of(self)); }
+
+            IoUringContext* m_parent;
+            int m_source_file_descriptor;
+            u64 m_source_offset;
+            int m_destination_file_descriptor;
+            u64 m_destination_offset;
+            di::Span<di::Byte> m_buffer;
+            di::Optional<u16> m_buffer_index;
+            u8 m_source_sqe_flags;
+            u8 m_destination_sqe_flags;
+            State m_state { State::Copying };
+            [[no_unique_address]] Rec m_receiver;
+        };
+    };
+
+    template<di::ReceiverOf<CompletionSignatures> Receiver>
+    using OperationState = di::meta::Type<OperationStateT<Receiver>>;
+
+    template<di::ReceiverOf<CompletionSignatures> Receiver>
+    friend auto tag_invoke(di::Tag<di::execution::connect>, CopySomeSender self, Receiver receiver) {
+        return OperationState<Receiver> { self.parent,
+                                          self.source_file_descriptor,
+                                          self.source_offset,
+                                          self.destination_file_descriptor,
+                                          self.destination_offset,
+                                          self.buffer,
+                                          self.buffer_index,
+                                          self.source_sqe_flags,
+                                          self.destination_sqe_flags,
+                                          di::move(receiver) };
+    }
+
+    template<typename CPO>
+    constexpr friend auto tag_invoke(di::execution::GetCompletionScheduler<CPO>, CopySomeSender const& self) {
+        return get_scheduler(self.parent);
+    }
+};
+
 struct CloseSender {
 public:
     using CompletionSignatures = di::CompletionSignatures<di::SetValue(), di::SetError(di::Error), di::SetStopped()>;
@@ -183,6 +361,9 @@ private:
             virtual void execute() override {
                 if (di::execution::get_stop_token(m_receiver).stop_requested()) {
                     di::execution::set_stopped(di::move(m_receiver));
+                } else if (m_file_descriptor < 0) {
+                    // There is no file descriptor to close.
+                    di::execution::set_value(di::move(m_receiver));
                 } else {
                     // Enqueue io_uring sqe with the close request.
                     enqueue_io_operation(m_parent, this, [&](auto* sqe) {
@@ -266,6 +447,8 @@ private:
     }
 };
 
+class AsyncFile;
+
 struct IoUringContext {
 public:
     static di::Result<IoUringContext> create();
@@ -279,35 +462,73 @@ public:
     void run();
     void finish() { m_done = true; }
 
+    // Registers buffers which can then be used by fixed reads and writes, which refer to them by their index. At most one set
+    // of buffers can be registered at a time, and they must outlive every operation which uses them.
+    di::Result<void> register_buffers(di::Span<di::Span<di::Byte> const> buffers) { return m_handle.register_buffers(buffers); }
+    di::Result<void> unregister_buffers() { return m_handle.unregister_buffers(); }
+
+    // Registers files with the kernel, returning handles which refer to the registered files. Operations on these handles
+    // skip looking up the file descriptor on every request. The original files still own their file descriptors.
+    di::Result<di::Vector<AsyncFile>> register_files(di::Span<AsyncFile const> files);
+    di::Result<void> unregister_files() { return m_handle.unregister_files(); }
+
+    u64 enter_count() const { return m_handle.enter_count(); }
+
 private:
     IoUringContext(io_uring::IoUringHandle handle) : m_handle(di::move(handle)) {};
 
 public:
     io_uring::IoUringHandle m_handle;
     di::Queue<OperationStateBase, di::IntrusiveForwardList<OperationStateBase>> m_queue;
+    u32 m_in_flight { 0 }; // The number of enqueued link chains which have not finished yet.
     bool m_done { false };
 };
 
 class AsyncFile {
 public:
-    explicit AsyncFile(IoUringContext* parent, int fd) : m_parent(parent), m_fd(fd) {}
+    explicit AsyncFile(IoUringContext* parent, int fd, bool registered = false)
+        : m_parent(parent), m_fd(fd), m_registered(registered) {}
+
+    int file_descriptor() const { return m_fd; }
+    bool registered() const { return m_registered; }
+
+    // Fixed reads and writes operate on a buffer within the registered buffer with the given index.
+    ReadSomeSender async_read_fixed(u16 buffer_index, di::Span<di::Byte> buffer, di::Optional<u64> offset = {}) const {
+        return ReadSomeSender { m_parent, m_fd, buffer, offset, buffer_index, sqe_flags() };
+    }
+
+    WriteSomeSender async_write_fixed(u16 buffer_index, di::Span<di::Byte const> buffer, di::Optional<u64> offset = {}) const {
+        return WriteSomeSender { m_parent, m_fd, buffer, offset, buffer_index, sqe_flags() };
+    }
+
+    // Copies from this file into destination, using buffer as intermediate storage.
+    CopySomeSender async_copy_some(u64 offset, AsyncFile const& destination, u64 destination_offset, di::Span<di::Byte> buffer,
+                                   di::Optional<u16> buffer_index = {}) const {
+        return CopySomeSender {
+            m_parent, m_fd, offset, destination.m_fd, destination_offset, buffer, buffer_index, sqe_flags(), destination.sqe_flags()
+        };
+    }
 
 private:
+    u8 sqe_flags() const { return m_registered ? IOSQE_FIXED_FILE : 0; }
+
     friend auto tag_invoke(di::Tag<di::execution::async_read_some>, AsyncFile self, di::Span<di::Byte> buffer, di::Optional<u64> offset) {
-        return ReadSomeSender { self.m_parent, self.m_fd, buffer, offset };
+        return ReadSomeSender { self.m_parent, self.m_fd, buffer, offset, di::nullopt, self.sqe_flags() };
     }
 
     friend auto tag_invoke(di::Tag<di::execution::async_write_some>, AsyncFile self, di::Span<di::Byte const> buffer,
                            di::Optional<u64> offset) {
-        return WriteSomeSender { self.m_parent, self.m_fd, buffer, offset };
+        return WriteSomeSender { self.m_parent, self.m_fd, buffer, offset, di::nullopt, self.sqe_flags() };
     }
 
+    // A registered file does not own its file descriptor, so only close the file descriptor of an unregistered file.
     friend auto tag_invoke(di::Tag<di::execution::async_destroy_in_place>, di::InPlaceType<AsyncFile>, AsyncFile& self) {
-        return CloseSender { self.m_parent, self.m_fd };
+        return CloseSender { self.m_parent, self.m_registered ? -1 : self.m_fd };
     }
 
     IoUringContext* m_parent { nullptr };
     int m_fd { -1 };
+    bool m_registered { false };
 };
 
 struct OpenSender {
@@ -413,12 +634,34 @@ inline di::Result<IoUringContext> IoUringContext::create() {
 
 inline IoUringContext::~IoUringContext() {}
 
+inline di::Result<di::Vector<AsyncFile>> IoUringContext::register_files(di::Span<AsyncFile const> files) {
+    auto file_descriptors = di::Vector<int> {};
+    file_descriptors.reserve(files.size());
+    for (auto const& file : files) {
+        file_descriptors.push_back(file.file_descriptor());
+    }
+    TRY(m_handle.register_files(file_descriptors.span()));
+
+    auto result = di::Vector<AsyncFile> {};
+    result.reserve(files.size());
+    for (auto i = 0zu; i < files.size(); i++) {
+        result.push_back(AsyncFile(this, int(i), true));
+    }
+    return result;
+}
+
 inline void IoUringContext::run() {
     for (;;) {
         // Reap any pending completions.
-        while (auto cqe = m_handle.get_next_cqe()) {
-            auto* as_operation = reinterpret_cast<OperationStateBase*>(cqe->user_data);
-            as_operation->did_complete(cqe.data());
+        while (auto next_cqe = m_handle.get_next_cqe()) {
+            // Copy the cqe out of the ring, as completing the operation may submit more work which reuses its slot.
+            auto cqe = *next_cqe;
+            if (!(cqe.flags & IORING_CQE_F_MORE) && (cqe.user_data & (user_data::last_in_chain | user_data::skip_success))) {
+                m_in_flight--;
+            }
+
+            auto* as_operation = reinterpret_cast<OperationStateBase*>(cqe.user_data & ~user_data::mask);
+            as_operation->did_complete(&cqe);
         }
 
         // Run locally available operations.
@@ -432,18 +675,51 @@ inline void IoUringContext::run() {
             break;
         }
 
-        // Wait for some event to happen.
-        (void) m_handle.submit_and_wait();
+        // Submit every sqe queued during this iteration with a single system call. Only block waiting for a completion if
+        // there is no local work left to run.
+        if (m_queue.empty() && m_in_flight > 0) {
+            (void) m_handle.submit_and_wait();
+        } else {
+            (void) m_handle.submit();
+        }
     }
 }
 
 template<di::concepts::Invocable<io_uring::SQE*> Fun>
 static void enqueue_io_operation(IoUringContext* context, OperationStateBase* op, Fun&& function) {
-    auto sqe = context->m_handle.get_next_sqe();
-    ASSERT(sqe);
-    ::memset(sqe.data(), 0, sizeof(*sqe));
-    di::invoke(di::move(function), sqe.data());
-    sqe->user_data = reinterpret_cast<uintptr_t>(op);
+    enqueue_linked_io_operations(context, op, di::forward<Fun>(function));
+}
+
+template<di::concepts::Invocable<io_uring::SQE*>... Funs>
+static void enqueue_linked_io_operations(IoUringContext* context, OperationStateBase* op, Funs&&... functions) {
+    constexpr auto count = u32(sizeof...(Funs));
+
+    // A link chain cannot span multiple submissions, so flush the submission queue unless the whole chain fits.
+    auto& handle = context->m_handle;
+    if (handle.sqe_space_left() < count) {
+        (void) handle.submit();
+    }
+    ASSERT_GT_EQ(handle.sqe_space_left(), count);
+
+    auto index = 0u;
+    auto prepare = [&](auto&& function) {
+        auto sqe = handle.get_next_sqe();
+        ::memset(sqe.data(), 0, sizeof(*sqe));
+        di::invoke(di::forward<decltype(function)>(function), sqe.data());
+
+        sqe->user_data = reinterpret_cast<uintptr_t>(op);
+        if (sqe->flags & IOSQE_CQE_SKIP_SUCCESS) {
+            sqe->user_data |= user_data::skip_success;
+        }
+        if (++index < count) {
+            sqe->flags |= IOSQE_IO_LINK;
+        } else {
+            sqe->user_data |= user_data::last_in_chain;
+        }
+    };
+    (prepare(di::forward<Funs>(functions)), ...);
+
+    context->m_in_flight++;
 }
 
 inline void enqueue_operation(IoUringContext* context, OperationStateBase* op) {
@@ -7,4 +7,6 @@
 #include <dius/log.h>
 #include <dius/main.h>
 #include <dius/memory_region.h>
-#include <dius/system/prelude.h>
\ No newline at end of file
+#include <dius/static_thread_pool.h>
+#include <dius/system/prelude.h>
+#include <dius/thread.h>
\ No newline at end of file
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <di/prelude.h>
+#include <dius/thread.h>
+#include <pthread.h>
+
+namespace dius {
+namespace execution = di::execution;
+
+namespace static_thread_pool_ns {
+    struct TaskBase : di::IntrusiveListElement<> {
+        virtual void execute() = 0;
+    };
+
+    class State {
+    private:
+        struct Worker {
+            di::Synchronized<di::IntrusiveList<TaskBase>> tasks;
+        };
+
+    public:
+        explicit State(usize thread_count);
+
+        di::Result<void> start();
+        void stop();
+
+        usize thread_count() const { return m_workers.size(); }
+
+        // Pushes to the current worker's deque if called from within the pool, and otherwise picks a worker round-robin.
+        void push(TaskBase& task);
+        void push(TaskBase& task, usize worker_index);
+
+    private:
+        void run_worker(usize worker_index);
+        TaskBase* pop(usize worker_index);
+
+        static thread_local State* s_current_state;
+        static thread_local usize s_current_worker_index;
+
+        di::Vector<di::Box<Worker>> m_workers;
+        di::Vector<Thread> m_threads;
+        pthread_mutex_t m_mutex = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t m_condition = PTHREAD_COND_INITIALIZER;
+        di::Atomic<usize> m_pending { 0 };
+        di::Atomic<usize> m_sleepers { 0 };
+        di::Atomic<usize> m_next_worker_index { 0 };
+        bool m_stopped { false };
+    };
+
+    template<typename Send, typename Shape, typename Fun>
+    struct BulkSenderT {
+        struct Type;
+    };
+
+    template<typename Send, typename Shape, typename Fun>
+    using BulkSender = di::meta::Type<BulkSenderT<di::meta::Decay<Send>, Shape, di::meta::Decay<Fun>>>;
+
+    struct ScheduleSender;
+
+    struct Scheduler {
+    public:
+        State* state { nullptr };
+
+    private:
+        friend ScheduleSender tag_invoke(di::Tag<execution::schedule>, Scheduler const& self);
+
+        template<di::concepts::Sender Send, di::concepts::Integral Shape, di::concepts::MovableValue Fun>
+        friend auto tag_invoke(di::Tag<execution::bulk>, Scheduler const& self, Send&& sender, Shape shape, Fun&& function) {
+            return BulkSender<Send, Shape, Fun> { self.state, di::forward<Send>(sender), shape, di::forward<Fun>(function) };
+        }
+
+        constexpr friend bool operator==(Scheduler const&, Scheduler const&) = default;
+    };
+
+    struct ScheduleSender {
+    public:
+        using CompletionSignatures = di::CompletionSignatures<di::SetValue(), di::SetStopped()>;
+
+        State* state;
+
+    private:
+        template<typename Rec>
+        struct OperationStateT {
+            struct Type : TaskBase {
+            public:
+                Type(State* state, Rec&& receiver) : m_state(state), m_receiver(di::move(receiver)) {}
+
+                virtual void execute() override {
+                    if (execution::get_stop_token(m_receiver).stop_requested()) {
+                        execution::set_stopped(di::move(m_receiver));
+                    } else {
+                        execution::set_value(di::move(m_receiver));
+                    }
+                }
+
+            private:
+                friend void tag_invoke(di::Tag<execution::start>, Type& self) { self.m_state->push(self); }
+
+                State* m_state { nullptr };
+                [[no_unique_address]] Rec m_receiver;
+            };
+        };
+
+        template<di::ReceiverOf<CompletionSignatures> Rec>
+        using OperationState = di::meta::Type<OperationStateT<Rec>>;
+
+        template<di::ReceiverOf<CompletionSignatures> Rec>
+        friend auto tag_invoke(di::Tag<execution::connect>, ScheduleSender self, Rec receiver) {
+            return OperationState<Rec> { self.state, di::move(receiver) };
+        }
+
+        template<typename CPO>
+        constexpr friend auto tag_invoke(execution::GetCompletionScheduler<CPO>, ScheduleSender const& self) {
+            return Scheduler { self.state };
+        }
+    };
+
+    inline ScheduleSender tag_invoke(di::Tag<execution::schedule>, Scheduler const& self) {
+        return ScheduleSender { self.state };
+    }
+
+    template<typename Send, typename Rec, typename Shape, typename Fun>
+    struct BulkDataT {
+        struct Type {
+        private:
+            using Values = di::meta::ValueTypesOf<Send, di::meta::EnvOf<Rec>, di::meta::DecayedTuple, di::meta::List>;
+            using ValueStorage = di::meta::AsTemplate<di::Variant, di::meta::PushFront<Values, di::Void>>;
+
+            struct Chunk : TaskBase {
+                explicit Chunk(Type* data_) : data(data_) {}
+
+                // Chunks are only moved while the vector holding them is built, before they are ever pushed.
+                Chunk(Chunk&& other) : TaskBase(), data(other.data) {}
+
+                virtual void execute() override { data->run_chunk(); }
+
+                Type* data { nullptr };
+            };
+
+        public:
+            explicit Type(State* state_, Rec out_r_, Shape shape_, Fun function_)
+                : state(state_), out_r(di::move(out_r_)), shape(shape_), function(di::move(function_)) {}
+
+            State* state { nullptr };
+            [[no_unique_address]] Rec out_r;
+            Shape shape;
+            [[no_unique_address]] Fun function;
+            ValueStorage values {};
+            di::Vector<Chunk> chunks;
+            usize grain_size { 1 };
+            di::Atomic<usize> next_index { 0 };
+            di::Atomic<usize> remaining_chunks { 0 };
+
+            template<typename... Args>
+            void launch(Args&&... args) {
+                values.template emplace<di::meta::DecayedTuple<Args...>>(di::forward<Args>(args)...);
+
+                auto size = shape > Shape(0) ? usize(shape) : 0zu;
+                if (size == 0) {
+                    complete();
+                    return;
+                }
+
+                // Each worker gets one chunk, which claims batches of indices until none are left. This way, workers
+                // which finish early pick up the slack of slower ones without needing one task per index. Batches are
+                // small enough to balance the load, but large enough to keep contention on next_index low.
+                auto chunk_count = di::min(size, state->thread_count());
+                grain_size = di::max(size / (state->thread_count() * 8), 1zu);
+                remaining_chunks.store(chunk_count, di::MemoryOrder::Relaxed);
+
+                chunks.reserve(chunk_count);
+                for (auto i = 0zu; i < chunk_count; i++) {
+                    chunks.emplace_back(this);
+                }
+                for (auto i = 0zu; i < chunk_count; i++) {
+                    state->push(chunks[i], i);
+                }
+            }
+
+        private:
+            void run_chunk() {
+                auto size = usize(shape);
+                di::visit(
+                    [&]<typename T>(T& values) {
+                        if constexpr (!di::SameAs<T, di::Void>) {
+                            for (;;) {
+                                auto first = next_index.fetch_add(grain_size, di::MemoryOrder::Relaxed);
+                                if (first >= size) {
+                                    break;
+                                }
+                                auto last = di::min(first + grain_size, size);
+                                for (auto i = first; i < last; i++) {
+                                    di::apply(
+                                        [&](auto&... args) {
+                                            di::invoke(function, Shape(i), args...);
+                                        },
+                                        values);
+                                }
+                            }
+                        }
+                    },
+                    values);
+
+                if (remaining_chunks.fetch_sub(1, di::MemoryOrder::AcquireRelease) == 1) {
+                    complete();
+                }
+            }
+
+            void complete() {
+                di::visit(
+                    [&]<typename T>(T& values) {
+                        if constexpr (!di::SameAs<T, di::Void>) {
+                            di::apply(
+                                [&](auto&... args) {
+                                    execution::set_value(di::move(out_r), di::move(args)...);
+                                },
+                                values);
+                        }
+                    },
+                    values);
+            }
+        };
+    };
+
+    template<typename Send, typename Rec, typename Shape, typename Fun>
+    using BulkData = di::meta::Type<BulkDataT<Send, Rec, Shape, Fun>>;
+
+    template<typename Send, typename Rec, typename Shape, typename Fun>
+    struct BulkReceiverT {
+        struct Type : private di::ReceiverAdaptor<Type> {
+            using Base = di::ReceiverAdaptor<Type>;
+            friend Base;
+
+        public:
+            explicit Type(BulkData<Send, Rec, Shape, Fun>* data) : m_data(data) {}
+
+        private:
+            Rec const& base() const& { return m_data->out_r; }
+            Rec&& base() && { return di::move(m_data->out_r); }
+
+            template<typename... Args>
+            requires(di::concepts::Invocable<Fun&, Shape, di::meta::Decay<Args>&...>)
+            void set_value(Args&&... args) && {
+                m_data->launch(di::forward<Args>(args)...);
+            }
+
+            BulkData<Send, Rec, Shape, Fun>* m_data;
+        };
+    };
+
+    template<typename Send, di::concepts::Receiver Rec, typename Shape, typename Fun>
+    using BulkReceiver = di::meta::Type<BulkReceiverT<Send, Rec, Shape, Fun>>;
+
+    template<typename Send, typename Rec, typename Shape, typename Fun>
+    struct BulkOperationStateT {
+        struct Type {
+        public:
+            template<typename S>
+            explicit Type(State* state, Rec receiver, S&& sender, Shape shape, Fun function)
+                : m_data(state, di::move(receiver), shape, di::move(function))
+                , m_op_state(execution::connect(di::forward<S>(sender),
+                                                BulkReceiver<Send, Rec, Shape, Fun> { di::address_of(m_data) })) {}
+
+        private:
+            friend void tag_invoke(di::Tag<execution::start>, Type& self) { execution::start(self.m_op_state); }
+
+            BulkData<Send, Rec, Shape, Fun> m_data;
+            di::meta::ConnectResult<Send, BulkReceiver<Send, Rec, Shape, Fun>> m_op_state;
+        };
+    };
+
+    template<typename Send, di::concepts::Receiver Rec, typename Shape, typename Fun>
+    using BulkOperationState = di::meta::Type<BulkOperationStateT<Send, Rec, Shape, Fun>>;
+
+    template<typename Send, typename Shape, typename Fun>
+    struct BulkSenderT<Send, Shape, Fun>::Type {
+    public:
+        State* state;
+        [[no_unique_address]] Send sender;
+        Shape shape;
+        [[no_unique_address]] Fun function;
+
+    private:
+        template<di::concepts::DecaysTo<Type> Self, di::concepts::Receiver Rec>
+        requires(di::concepts::SenderTo<di::meta::Like<Self, Send>, BulkReceiver<di::meta::Like<Self, Send>, Rec, Shape, Fun>>)
+        friend auto tag_invoke(di::Tag<execution::connect>, Self&& self, Rec receiver) {
+            return BulkOperationState<di::meta::Like<Self, Send>, Rec, Shape, Fun> { self.state, di::move(receiver),
+                                                                                     di::forward<Self>(self).sender, self.shape,
+                                                                                     di::forward<Self>(self).function };
+        }
+
+        template<di::concepts::DecaysTo<Type> Self, typename Env>
+        friend auto tag_invoke(di::Tag<execution::get_completion_signatures>, Self&&, Env)
+            -> di::meta::MakeCompletionSignatures<di::meta::Like<Self, Send>, Env>;
+
+        template<typename CPO>
+        constexpr friend auto tag_invoke(execution::GetCompletionScheduler<CPO>, Type const& self) {
+            return Scheduler { self.state };
+        }
+    };
+}
+
+// An execution context backed by a fixed number of worker threads.
+//
+// Each worker owns a deque of tasks. Work scheduled from a worker thread is pushed onto the back of that worker's
+// deque, and the worker pops from the back, so a task which schedules more work usually runs that work next, while
+// its data is still in cache. A worker whose deque is empty steals the oldest task from the front of another
+// worker's deque. Work scheduled from outside the pool is spread across the workers round-robin. Idle workers
+// sleep on a condition variable instead of spinning.
+//
+// The pool's scheduler customizes execution::bulk, splitting the iteration space across every worker.
+class StaticThreadPool {
+public:
+    static di::Result<StaticThreadPool> create(usize thread_count);
+
+    StaticThreadPool(StaticThreadPool&&) = default;
+
+    // Waits for all scheduled work to finish, and then joins the worker threads.
+    ~StaticThreadPool();
+
+    static_thread_pool_ns::Scheduler get_scheduler() { return { m_state.get() }; }
+
+    usize thread_count() const { return m_state->thread_count(); }
+
+private:
+    explicit StaticThreadPool(di::Box<static_thread_pool_ns::State> state) : m_state(di::move(state)) {}
+
+    di::Box<static_thread_pool_ns::State> m_state;
+};
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <di/prelude.h>
+#include <dius/error.h>
+#include <pthread.h>
+
+namespace dius {
+class Thread {
+private:
+    template<typename Fun>
+    struct Data {
+        explicit Data(Fun function_) : function(di::move(function_)) {}
+
+        Fun function;
+    };
+
+    template<typename Fun>
+    static void* entry(void* data) {
+        auto box = di::Box<Data<Fun>>(static_cast<Data<Fun>*>(data));
+        di::invoke(di::move(box->function));
+        return nullptr;
+    }
+
+public:
+    template<di::concepts::MovableValue Fun>
+    requires(di::concepts::Invocable<di::meta::Decay<Fun>>)
+    static di::Result<Thread> create(Fun&& function) {
+        auto data = di::make_box<Data<di::meta::Decay<Fun>>>(di::forward<Fun>(function));
+
+        auto id = pthread_t {};
+        if (auto error = pthread_create(&id, nullptr, entry<di::meta::Decay<Fun>>, data.get()); error != 0) {
+            return di::Unexpected(PosixError(error));
+        }
+
+        // The thread now owns the function object, and is responsible for freeing it.
+        (void) data.release();
+        return Thread(id);
+    }
+
+    Thread(Thread&& other) : m_id(other.m_id), m_joinable(di::exchange(other.m_joinable, false)) {}
+
+    ~Thread();
+
+    Thread& operator=(Thread&&) = delete;
+
+    bool joinable() const { return m_joinable; }
+
+    di::Result<void> join();
+
+private:
+    explicit Thread(pthread_t id) : m_id(id), m_joinable(true) {}
+
+    pthread_t m_id {};
+    bool m_joinable { false };
+};
+}
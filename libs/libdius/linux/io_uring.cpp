@@ -6,6 +6,7 @@
 #include <dius/linux/io_uring.h>
 #include <dius/log.h>
 #include <dius/system/system_call.h>
+#include <linux/uio.h>
 
 namespace dius::linux::io_uring {
 di::Result<int> sys_enter(unsigned int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags, void const* arg,
@@ -23,12 +24,11 @@ di::Result<SyncFile> sys_setup(u32 entries, SetupParams* params) {
 }
 
 di::Optional<SQE&> IoUringHandle::get_next_sqe() {
-    if (sq_pending >= sq_entry_count) {
+    if (sqe_space_left() == 0) {
         return di::nullopt;
     }
 
-    auto head = sq_head->load(di::MemoryOrder::Relaxed);
-    auto tail = head + sq_pending;
+    auto tail = sq_tail->load(di::MemoryOrder::Relaxed) + sq_pending;
 
     auto& sqe = sq_array[tail & sq_mask];
     sq_index_array[tail & sq_mask] = tail & sq_mask;
@@ -36,6 +36,12 @@ di::Optional<SQE&> IoUringHandle::get_next_sqe() {
     return sqe;
 }
 
+u32 IoUringHandle::sqe_space_left() const {
+    auto head = sq_head->load(di::MemoryOrder::Acquire);
+    auto tail = sq_tail->load(di::MemoryOrder::Relaxed) + sq_pending;
+    return sq_entry_count - (tail - head);
+}
+
 di::Optional<CQE&> IoUringHandle::get_next_cqe() {
     auto tail = cq_tail->load(di::MemoryOrder::Acquire);
     auto head = cq_head->load(di::MemoryOrder::Relaxed);
@@ -49,16 +55,56 @@ di::Optional<CQE&> IoUringHandle::get_next_cqe() {
     return cqe;
 }
 
+di::Result<void> IoUringHandle::submit() {
+    if (sq_pending == 0) {
+        return {};
+    }
+    return enter(0);
+}
+
 di::Result<void> IoUringHandle::submit_and_wait() {
-    auto to_submit = sq_pending;
-    if (sq_pending > 0) {
-        sq_pending = 0;
+    return enter(1);
+}
 
+di::Result<void> IoUringHandle::enter(u32 min_complete) {
+    auto to_submit = di::exchange(sq_pending, 0u);
+    if (to_submit > 0) {
+        // Publish the new tail with release semantics, so that the kernel observes the contents of the sqes.
         auto old_tail = sq_tail->load(di::MemoryOrder::Relaxed);
-        sq_tail->store(old_tail + to_submit, di::MemoryOrder::Relaxed);
+        sq_tail->store(old_tail + to_submit, di::MemoryOrder::Release);
     }
 
-    TRY(sys_enter(fd.file_descriptor(), to_submit, 1, 0, nullptr, 0));
+    // The kernel ignores min_complete unless IORING_ENTER_GETEVENTS is passed.
+    auto flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0u;
+
+    total_enter_calls++;
+    TRY(sys_enter(fd.file_descriptor(), to_submit, min_complete, flags, nullptr, 0));
+    return {};
+}
+
+di::Result<void> IoUringHandle::register_buffers(di::Span<di::Span<di::Byte> const> buffers) {
+    auto vectors = di::Vector<iovec> {};
+    vectors.reserve(buffers.size());
+    for (auto buffer : buffers) {
+        vectors.push_back(iovec { buffer.data(), buffer.size() });
+    }
+
+    TRY(sys_register(fd.file_descriptor(), IORING_REGISTER_BUFFERS, vectors.data(), vectors.size()));
+    return {};
+}
+
+di::Result<void> IoUringHandle::unregister_buffers() {
+    TRY(sys_register(fd.file_descriptor(), IORING_UNREGISTER_BUFFERS, nullptr, 0));
+    return {};
+}
+
+di::Result<void> IoUringHandle::register_files(di::Span<int const> file_descriptors) {
+    TRY(sys_register(fd.file_descriptor(), IORING_REGISTER_FILES, const_cast<int*>(file_descriptors.data()), file_descriptors.size()));
+    return {};
+}
+
+di::Result<void> IoUringHandle::unregister_files() {
+    TRY(sys_register(fd.file_descriptor(), IORING_UNREGISTER_FILES, nullptr, 0));
     return {};
 }
 
@@ -0,0 +1,132 @@
+#include <dius/static_thread_pool.h>
+
+namespace dius {
+namespace static_thread_pool_ns {
+    thread_local State* State::s_current_state = nullptr;
+    thread_local usize State::s_current_worker_index = 0;
+
+    State::State(usize thread_count) {
+        for (auto i = 0zu; i < thread_count; i++) {
+            m_workers.push_back(di::make_box<Worker>());
+        }
+    }
+
+    di::Result<void> State::start() {
+        for (auto i = 0zu; i < thread_count(); i++) {
+            auto thread = Thread::create([this, i] {
+                run_worker(i);
+            });
+            if (!thread) {
+                stop();
+                return di::Unexpected(di::move(thread).error());
+            }
+            m_threads.push_back(di::move(thread).value());
+        }
+        return {};
+    }
+
+    void State::stop() {
+        pthread_mutex_lock(&m_mutex);
+        m_stopped = true;
+        pthread_cond_broadcast(&m_condition);
+        pthread_mutex_unlock(&m_mutex);
+
+        for (auto& thread : m_threads) {
+            (void) thread.join();
+        }
+        m_threads.clear();
+    }
+
+    void State::push(TaskBase& task) {
+        if (s_current_state == this) {
+            push(task, s_current_worker_index);
+        } else {
+            push(task, m_next_worker_index.fetch_add(1, di::MemoryOrder::Relaxed) % thread_count());
+        }
+    }
+
+    void State::push(TaskBase& task, usize worker_index) {
+        // Both m_pending and m_sleepers are sequentially consistent, so either this sees the sleeper, or the sleeper sees
+        // the new task before it waits. Taking the mutex before signalling ensures the signal cannot arrive between the
+        // sleeper checking m_pending and it starting to wait.
+        m_pending.fetch_add(1);
+        m_workers[worker_index]->tasks.with_lock([&](di::IntrusiveList<TaskBase>& tasks) {
+            tasks.push_back(task);
+        });
+
+        if (m_sleepers.load() > 0) {
+            pthread_mutex_lock(&m_mutex);
+            pthread_cond_signal(&m_condition);
+            pthread_mutex_unlock(&m_mutex);
+        }
+    }
+
+    TaskBase* State::pop(usize worker_index) {
+        auto* task = m_workers[worker_index]->tasks.with_lock([](di::IntrusiveList<TaskBase>& tasks) -> TaskBase* {
+            if (tasks.empty()) {
+                return nullptr;
+            }
+            auto& task = *tasks.back();
+            tasks.erase(task);
+            return di::address_of(task);
+        });
+
+        // Steal the oldest task of another worker, starting with the next one so that thieves spread out.
+        for (auto i = 1zu; !task && i < thread_count(); i++) {
+            auto& victim = *m_workers[(worker_index + i) % thread_count()];
+            task = victim.tasks.with_lock([](di::IntrusiveList<TaskBase>& tasks) -> TaskBase* {
+                if (tasks.empty()) {
+                    return nullptr;
+                }
+                return di::address_of(*tasks.pop_front());
+            });
+        }
+
+        if (task) {
+            m_pending.fetch_sub(1);
+        }
+        return task;
+    }
+
+    void State::run_worker(usize worker_index) {
+        s_current_state = this;
+        s_current_worker_index = worker_index;
+
+        for (;;) {
+            if (auto* task = pop(worker_index)) {
+                task->execute();
+                continue;
+            }
+
+            pthread_mutex_lock(&m_mutex);
+            m_sleepers.fetch_add(1);
+            while (m_pending.load() == 0 && !m_stopped) {
+                pthread_cond_wait(&m_condition, &m_mutex);
+            }
+            m_sleepers.fetch_sub(1);
+
+            // Any remaining work is drained before exiting, since its operation states must still be completed.
+            auto should_exit = m_stopped && m_pending.load() == 0;
+            pthread_mutex_unlock(&m_mutex);
+
+            if (should_exit) {
+                return;
+            }
+        }
+    }
+}
+
+di::Result<StaticThreadPool> StaticThreadPool::create(usize thread_count) {
+    DI_ASSERT(thread_count > 0);
+
+    auto state = di::make_box<static_thread_pool_ns::State>(thread_count);
+    DI_TRY(state->start());
+    return StaticThreadPool(di::move(state));
+}
+
+StaticThreadPool::~StaticThreadPool() {
+    if (m_state) {
+        m_state->stop();
+    }
+}
+}
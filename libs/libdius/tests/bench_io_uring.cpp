@@ -0,0 +1,179 @@
+#include <dius/prelude.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Reports the throughput and the number of io_uring_enter() calls made by the IoUringContext when reading a file and when
+// copying one file to another. Plain reads and writes are compared against registered buffers and files, and against a
+// copy which links each read to its write.
+
+namespace {
+constexpr auto file_size = 64zu * 1024 * 1024;
+constexpr auto chunk_size = 128zu * 1024;
+
+constexpr auto source_path = "/tmp/bench_io_uring_source"_pv;
+constexpr auto destination_path = "/tmp/bench_io_uring_destination"_pv;
+
+u64 now_ns() {
+    auto ts = timespec {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return u64(ts.tv_sec) * 1000000000 + u64(ts.tv_nsec);
+}
+
+[[noreturn]] void fail(char const* message) {
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+}
+
+template<typename T>
+T check(di::Result<T>&& result, char const* message) {
+    if (!result) {
+        fail(message);
+    }
+    if constexpr (!di::SameAs<T, void>) {
+        return di::move(result).value();
+    }
+}
+
+void create_source_file() {
+    auto file = check(dius::open_sync(source_path, dius::OpenMode::WriteClobber), "Failed to create source file");
+
+    auto seed = u32(0x12345678);
+    auto buffer = di::Vector<di::Byte> {};
+    buffer.resize(chunk_size);
+    for (auto offset = 0zu; offset < file_size; offset += chunk_size) {
+        for (auto& byte : buffer) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            byte = di::Byte(seed);
+        }
+        check(file.write_exactly(buffer.span()), "Failed to write source file");
+    }
+}
+
+void verify_destination_file() {
+    auto source = check(dius::open_sync(source_path, dius::OpenMode::Readonly), "Failed to open source file");
+    auto destination = check(dius::open_sync(destination_path, dius::OpenMode::Readonly), "Failed to open destination file");
+
+    auto source_buffer = di::Vector<di::Byte> {};
+    auto destination_buffer = di::Vector<di::Byte> {};
+    source_buffer.resize(chunk_size);
+    destination_buffer.resize(chunk_size);
+    for (auto offset = 0zu; offset < file_size; offset += chunk_size) {
+        check(source.read_exactly(offset, source_buffer.span()), "Failed to read source file");
+        check(destination.read_exactly(offset, destination_buffer.span()), "Failed to read destination file");
+        if (source_buffer != destination_buffer) {
+            fail("Destination file does not match source file");
+        }
+    }
+}
+
+void report(char const* name, dius::IoContext const& context, u64 start_enter_count, u64 start_ns, u64 operations) {
+    auto elapsed_ns = now_ns() - start_ns;
+    auto enter_count = context.enter_count() - start_enter_count;
+
+    auto megabytes_per_second = double(file_size) / (double(elapsed_ns) / 1e9) / (1024 * 1024);
+    printf("%-20s %10.2f MiB/s %8lu io_uring_enter() %6.2f per operation\n", name, megabytes_per_second, enter_count,
+           double(enter_count) / double(operations));
+}
+
+// Runs read_some(offset) until it reads nothing, and returns the number of operations which were performed.
+template<typename ReadSome>
+u64 read_until_end(dius::IoContext& context, ReadSome read_some) {
+    auto offset = u64(0);
+    auto operations = u64(0);
+    auto task = di::execution::just() | di::execution::let_value([&] {
+                    return read_some(offset);
+                }) |
+                di::execution::let_value([&](size_t& nread) {
+                    offset += nread;
+                    operations++;
+                    return di::execution::just_void_or_stopped(nread == 0);
+                }) |
+                di::execution::repeat_effect | di::execution::let_stopped([] {
+                    return di::execution::just();
+                });
+
+    check(di::sync_wait_on(context, di::move(task)) % di::into_void, "Failed to read file");
+    if (offset != file_size) {
+        fail("Read the wrong number of bytes");
+    }
+    return operations;
+}
+
+void bench_read(char const* name, bool use_registered) {
+    auto context = check(di::create<dius::IoContext>(), "Failed to create io context");
+    auto source = check(dius::open_sync(source_path, dius::OpenMode::Readonly), "Failed to open source file");
+    auto file = dius::linux::AsyncFile(&context, source.file_descriptor());
+
+    auto buffer = di::Vector<di::Byte> {};
+    buffer.resize(chunk_size);
+
+    auto start_enter_count = context.enter_count();
+    auto start = now_ns();
+    auto operations = u64(0);
+    if (!use_registered) {
+        operations = read_until_end(context, [&](u64 offset) {
+            return di::execution::async_read_some(file, buffer.span(), offset);
+        });
+    } else {
+        auto buffers = di::Array { buffer.span() };
+        check(context.register_buffers(buffers.span()), "Failed to register buffers");
+        auto files = check(context.register_files(di::Span { &file, 1 }), "Failed to register files");
+
+        operations = read_until_end(context, [&](u64 offset) {
+            return files[0].async_read_fixed(0, buffer.span(), offset);
+        });
+    }
+    report(name, context, start_enter_count, start, operations);
+}
+
+void bench_copy(char const* name, bool use_linked) {
+    auto context = check(di::create<dius::IoContext>(), "Failed to create io context");
+    auto source_file = check(dius::open_sync(source_path, dius::OpenMode::Readonly), "Failed to open source file");
+    auto destination_file = check(dius::open_sync(destination_path, dius::OpenMode::WriteClobber), "Failed to open destination file");
+    auto source = dius::linux::AsyncFile(&context, source_file.file_descriptor());
+    auto destination = dius::linux::AsyncFile(&context, destination_file.file_descriptor());
+
+    auto buffer = di::Vector<di::Byte> {};
+    buffer.resize(chunk_size);
+
+    auto start_enter_count = context.enter_count();
+    auto start = now_ns();
+    auto operations = u64(0);
+    if (!use_linked) {
+        operations = read_until_end(context, [&](u64 offset) {
+            return di::execution::async_read_some(source, buffer.span(), offset) | di::execution::let_value([&, offset](size_t& nread) {
+                       return di::execution::just_void_or_stopped(nread == 0) | di::execution::let_value([&, offset] {
+                                  return di::execution::async_write_exactly(destination, *buffer.span().first(nread), offset);
+                              }) |
+                              di::execution::then([&] {
+                                  return nread;
+                              });
+                   });
+        });
+    } else {
+        auto buffers = di::Array { buffer.span() };
+        check(context.register_buffers(buffers.span()), "Failed to register buffers");
+        auto files = check(context.register_files(di::Array { source, destination }.span()), "Failed to register files");
+
+        operations = read_until_end(context, [&](u64 offset) {
+            return files[0].async_copy_some(offset, files[1], offset, buffer.span(), 0);
+        });
+    }
+    report(name, context, start_enter_count, start, operations);
+
+    verify_destination_file();
+}
+}
+
+int main() {
+    create_source_file();
+
+    bench_read("read", false);
+    bench_read("read fixed", true);
+    bench_copy("copy read+write", false);
+    bench_copy("copy linked fixed", true);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#include <dius/thread.h>
+
+namespace dius {
+Thread::~Thread() {
+    // Destroying a thread which was never joined would leak its resources.
+    DI_ASSERT(!m_joinable);
+}
+
+di::Result<void> Thread::join() {
+    DI_ASSERT(m_joinable);
+    m_joinable = false;
+
+    if (auto error = pthread_join(m_id, nullptr); error != 0) {
+        return di::Unexpected(PosixError(error));
+    }
+    return {};
+}
+}
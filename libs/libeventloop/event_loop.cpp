@@ -7,7 +7,7 @@
 #include <liim/hash_map.h>
 #include <liim/vector.h>
 #include <signal.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 
 #define TIMER_SIGNAL         SIGRTMIN + 10
 #define WAKEUP_THREAD_SIGNAL SIGRTMIN + 11
@@ -29,7 +29,8 @@ struct Traits<timer_t> {
 namespace App {
 
 static EventLoop* s_the;
-static Vector<Selectable*> s_selectables;
+static HashMap<int, Selectable*> s_selectables;
+static Vector<Selectable*> s_always_ready_selectables;
 static HashMap<int, Function<void()>> s_watched_signals;
 static HashMap<timer_t, WeakPtr<Object>> s_timer_objects;
 static volatile sig_atomic_t s_signal_number;
@@ -49,12 +50,67 @@ EventLoop& EventLoop::the() {
     return *s_the;
 }
 
+static int epoll_fd() {
+    static int fd = [] {
+        int fd = epoll_create1(EPOLL_CLOEXEC);
+        assert(fd != -1);
+        return fd;
+    }();
+    return fd;
+}
+
+static bool is_registered(Selectable& selectable) {
+    auto registered = s_selectables.get(selectable.fd());
+    return registered && *registered == &selectable;
+}
+
+static epoll_event epoll_event_for(Selectable& selectable) {
+    epoll_event event {};
+    int notify_flags = selectable.selected_events();
+    if (notify_flags & NotifyWhen::Readable) {
+        event.events |= EPOLLIN;
+    }
+    if (notify_flags & NotifyWhen::Writeable) {
+        event.events |= EPOLLOUT;
+    }
+    if (notify_flags & NotifyWhen::Exceptional) {
+        event.events |= EPOLLPRI;
+    }
+    event.data.fd = selectable.fd();
+    return event;
+}
+
 void EventLoop::register_selectable(Selectable& selectable) {
-    s_selectables.add(&selectable);
+    assert(selectable.fd() != -1);
+
+    auto event = epoll_event_for(selectable);
+    if (epoll_ctl(epoll_fd(), EPOLL_CTL_ADD, selectable.fd(), &event)) {
+        // Regular files cannot be watched, but are always ready, just like select() reports them.
+        assert(errno == EPERM);
+        s_always_ready_selectables.add(&selectable);
+        return;
+    }
+    s_selectables.put(selectable.fd(), &selectable);
+}
+
+void EventLoop::update_selectable(Selectable& selectable) {
+    if (!is_registered(selectable)) {
+        return;
+    }
+
+    auto event = epoll_event_for(selectable);
+    epoll_ctl(epoll_fd(), EPOLL_CTL_MOD, selectable.fd(), &event);
 }
 
 void EventLoop::unregister_selectable(Selectable& selectable) {
-    s_selectables.remove_element(&selectable);
+    s_always_ready_selectables.remove_element(&selectable);
+    if (!is_registered(selectable)) {
+        return;
+    }
+
+    // This fails if the file was already closed, in which case the kernel has removed it on its own.
+    epoll_ctl(epoll_fd(), EPOLL_CTL_DEL, selectable.fd(), nullptr);
+    s_selectables.remove(selectable.fd());
 }
 
 void EventLoop::register_signal_handler(int signum, Function<void()> callback) {
@@ -108,29 +164,6 @@ EventLoop::~EventLoop() {
 }
 
 void EventLoop::do_select(bool block) {
-    fd_set rd_set;
-    fd_set wr_set;
-    fd_set ex_set;
-
-    FD_ZERO(&rd_set);
-    FD_ZERO(&wr_set);
-    FD_ZERO(&ex_set);
-
-    for (auto* selectable : s_selectables) {
-        int notify_flags = selectable->selected_events();
-        assert(selectable->fd() != -1);
-
-        if (notify_flags & NotifyWhen::Readable) {
-            FD_SET(selectable->fd(), &rd_set);
-        }
-        if (notify_flags & NotifyWhen::Writeable) {
-            FD_SET(selectable->fd(), &wr_set);
-        }
-        if (notify_flags & NotifyWhen::Exceptional) {
-            FD_SET(selectable->fd(), &ex_set);
-        }
-    }
-
     sigset_t sigset;
     sigprocmask(0, nullptr, &sigset);
     sigdelset(&sigset, TIMER_SIGNAL);
@@ -139,51 +172,59 @@ void EventLoop::do_select(bool block) {
         sigdelset(&sigset, signum);
     });
 
-    for (;;) {
-        timespec no_timeout { .tv_sec = 0, .tv_nsec = 0 };
-        int ret = pselect(FD_SETSIZE, &rd_set, &wr_set, &ex_set, block ? nullptr : &no_timeout, &sigset);
-        if (ret == -1) {
-            if (errno == EINTR) {
-                if (s_signal_number) {
-                    int signo = s_signal_number;
-                    s_signal_number = 0;
-
-                    auto handler = s_watched_signals.get(signo);
-                    assert(handler);
-                    (*handler)();
-                } else if (s_timer_fired_id) {
-                    timer_t timer_id = *s_timer_fired_id;
-                    s_timer_fired_id = nullptr;
-
-                    int extra_times_expired = timer_getoverrun(timer_id);
-                    assert(extra_times_expired >= 0);
-                    auto target = s_timer_objects.get(timer_id);
-                    assert(target);
-                    EventLoop::queue_event(*target, make_unique<TimerEvent>(1 + extra_times_expired));
-                }
-                return;
-            }
-            assert(false);
-        }
+    if (!s_always_ready_selectables.empty()) {
+        block = false;
+    }
 
-        if (ret == 0) {
+    epoll_event events[max_events_per_wait];
+    int ret = epoll_pwait(epoll_fd(), events, max_events_per_wait, block ? -1 : 0, &sigset);
+    if (ret == -1) {
+        if (errno == EINTR) {
+            if (s_signal_number) {
+                int signo = s_signal_number;
+                s_signal_number = 0;
+
+                auto handler = s_watched_signals.get(signo);
+                assert(handler);
+                (*handler)();
+            } else if (s_timer_fired_id) {
+                timer_t timer_id = *s_timer_fired_id;
+                s_timer_fired_id = nullptr;
+
+                int extra_times_expired = timer_getoverrun(timer_id);
+                assert(extra_times_expired >= 0);
+                auto target = s_timer_objects.get(timer_id);
+                assert(target);
+                EventLoop::queue_event(*target, make_unique<TimerEvent>(1 + extra_times_expired));
+            }
             return;
         }
-        break;
+        assert(false);
     }
 
-    s_selectables.for_each_reverse([&](auto& selectable) {
-        int fd = selectable->fd();
-        if (FD_ISSET(fd, &rd_set)) {
-            EventLoop::queue_event(selectable->weak_from_this(), make_unique<ReadableEvent>());
+    auto queue_events = [](Selectable& selectable, uint32_t events) {
+        int notify_flags = selectable.selected_events();
+        if ((notify_flags & NotifyWhen::Readable) && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+            EventLoop::queue_event(selectable.weak_from_this(), make_unique<ReadableEvent>());
         }
-        if (FD_ISSET(fd, &wr_set)) {
-            EventLoop::queue_event(selectable->weak_from_this(), make_unique<WritableEvent>());
+        if ((notify_flags & NotifyWhen::Writeable) && (events & (EPOLLOUT | EPOLLERR))) {
+            EventLoop::queue_event(selectable.weak_from_this(), make_unique<WritableEvent>());
         }
-        if (FD_ISSET(fd, &ex_set)) {
-            EventLoop::queue_event(selectable->weak_from_this(), make_unique<ExceptionalEvent>());
+        if ((notify_flags & NotifyWhen::Exceptional) && (events & EPOLLPRI)) {
+            EventLoop::queue_event(selectable.weak_from_this(), make_unique<ExceptionalEvent>());
         }
-    });
+    };
+
+    for (int i = 0; i < ret; i++) {
+        // Events for a file which was closed without being unregistered first may still arrive, and are ignored.
+        auto selectable = s_selectables.get(events[i].data.fd);
+        if (selectable) {
+            queue_events(**selectable, events[i].events);
+        }
+    }
+    for (auto* selectable : s_always_ready_selectables) {
+        queue_events(*selectable, EPOLLIN | EPOLLOUT);
+    }
 }
 
 void EventLoop::do_event_dispatch() {
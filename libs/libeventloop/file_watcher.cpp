@@ -49,6 +49,7 @@ void FileWatcher::initialize() {
 }
 
 FileWatcher::~FileWatcher() {
+    disable_notifications();
     if (valid()) {
         close(fd());
     }
@@ -152,6 +153,7 @@ void FileWatcher::initialize() {
 }
 
 FileWatcher::~FileWatcher() {
+    disable_notifications();
     if (valid()) {
         close(fd());
     }
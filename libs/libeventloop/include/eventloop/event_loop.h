@@ -17,6 +17,7 @@ public:
 
     static EventLoop& the();
     static void register_selectable(Selectable& selectable);
+    static void update_selectable(Selectable& selectable);
     static void unregister_selectable(Selectable& selectable);
     static void register_signal_handler(int signum, Function<void()> callback);
     static void unregister_signal_handler(int signum);
@@ -34,6 +35,8 @@ public:
 private:
     void do_queue_event(WeakPtr<Object> target, UniquePtr<Event> event);
 
+    static constexpr int max_events_per_wait = 32;
+
     void do_select(bool block);
     void do_event_dispatch();
     void setup_signal_handlers();
@@ -24,7 +24,7 @@ public:
     Selectable();
     virtual ~Selectable();
 
-    void set_selected_events(int events) { m_selected_events = events; }
+    void set_selected_events(int events);
     int selected_events() const { return m_selected_events; }
 
     void enable_notifications();
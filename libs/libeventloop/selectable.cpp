@@ -9,6 +9,13 @@ Selectable::~Selectable() {
     disable_notifications();
 }
 
+void Selectable::set_selected_events(int events) {
+    m_selected_events = events;
+    if (m_notifications_enabled) {
+        EventLoop::update_selectable(*this);
+    }
+}
+
 void Selectable::enable_notifications() {
     if (m_notifications_enabled) {
         return;
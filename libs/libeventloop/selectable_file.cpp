@@ -18,6 +18,7 @@ SelectableFile::SelectableFile(const String& path, int oflags, mode_t mode) {
 }
 
 SelectableFile::~SelectableFile() {
+    disable_notifications();
     if (valid()) {
         close(fd());
     }
@@ -11,6 +11,7 @@ UdpSocket::UdpSocket() {
 }
 
 UdpSocket::~UdpSocket() {
+    disable_notifications();
     if (fd() >= 0) {
         close(fd());
     }
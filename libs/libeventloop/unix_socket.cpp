@@ -35,6 +35,7 @@ UnixSocket::UnixSocket(int fd, bool nonblocking) : m_nonblocking(nonblocking) {
 }
 
 UnixSocket::~UnixSocket() {
+    disable_notifications();
     close(fd());
 }
 
@@ -31,6 +31,7 @@ SharedPtr<UnixSocket> UnixSocketServer::accept() {
 }
 
 UnixSocketServer::~UnixSocketServer() {
+    disable_notifications();
     if (fd() != -1) {
         close(fd());
     }
@@ -1,20 +1,127 @@
 #include <ext/checksum.h>
 
+#if !defined(__is_libk) && !defined(__is_kernel) && (defined(__x86_64__) || defined(__i386__))
+#define CHECKSUM_ADLER32_HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif
+
 constexpr uint16_t adler32_base = 65521U;
 
+// The largest number of bytes which can be summed before s2 must be reduced, so that it can't overflow 32 bits even if
+// every byte is 0xFF and both sums start at adler32_base - 1.
+constexpr size_t adler32_max_run = 5552;
+
+static uint32_t update_adler32_generic(uint32_t s1, uint32_t s2, const uint8_t *bytes, size_t num_bytes) {
+    while (num_bytes > 0) {
+        auto run = num_bytes < adler32_max_run ? num_bytes : adler32_max_run;
+        num_bytes -= run;
+        for (; run >= 8; run -= 8, bytes += 8) {
+            s1 += bytes[0];
+            s2 += s1;
+            s1 += bytes[1];
+            s2 += s1;
+            s1 += bytes[2];
+            s2 += s1;
+            s1 += bytes[3];
+            s2 += s1;
+            s1 += bytes[4];
+            s2 += s1;
+            s1 += bytes[5];
+            s2 += s1;
+            s1 += bytes[6];
+            s2 += s1;
+            s1 += bytes[7];
+            s2 += s1;
+        }
+        for (; run > 0; run--) {
+            s1 += *bytes++;
+            s2 += s1;
+        }
+        s1 %= adler32_base;
+        s2 %= adler32_base;
+    }
+    return (s2 << 16U) | s1;
+}
+
+#ifdef CHECKSUM_ADLER32_HAVE_CPU_DISPATCH
+// Sums 32 bytes at a time. s1 gains the sum of the bytes, and s2 gains 32 times s1 from before the block, plus each byte
+// weighted by its distance from the end of the block, which is what the byte at a time loop would add.
+__attribute__((target("ssse3"))) static uint32_t update_adler32_ssse3(uint32_t s1, uint32_t s2, const uint8_t *bytes,
+                                                                      size_t num_bytes) {
+    constexpr size_t block_size = 32;
+
+    auto weights_first = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    auto weights_second = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    auto ones = _mm_set1_epi16(1);
+    auto zero = _mm_setzero_si128();
+
+    size_t blocks = num_bytes / block_size;
+    num_bytes -= blocks * block_size;
+    while (blocks > 0) {
+        auto run = blocks < adler32_max_run / block_size ? blocks : adler32_max_run / block_size;
+        blocks -= run;
+
+        // previous_s1 accumulates s1 as of the start of each block, and is multiplied by the block size at the end.
+        auto previous_s1 = _mm_cvtsi32_si128(s1 * run);
+        auto v_s1 = zero;
+        auto v_s2 = _mm_cvtsi32_si128(s2);
+        for (; run > 0; run--, bytes += block_size) {
+            auto first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes));
+            auto second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + 16));
+
+            previous_s1 = _mm_add_epi32(previous_s1, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_add_epi32(_mm_sad_epu8(first, zero), _mm_sad_epu8(second, zero)));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(first, weights_first), ones));
+            v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(second, weights_second), ones));
+        }
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(previous_s1, 5));
+
+        v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+        v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 = (s1 + static_cast<uint32_t>(_mm_cvtsi128_si32(v_s1))) % adler32_base;
+        s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(v_s2)) % adler32_base;
+    }
+    return update_adler32_generic(s1, s2, bytes, num_bytes);
+}
+
+static uint32_t update_adler32_resolve(uint32_t s1, uint32_t s2, const uint8_t *bytes, size_t num_bytes);
+
+static uint32_t (*update_adler32_impl)(uint32_t, uint32_t, const uint8_t *, size_t) = update_adler32_resolve;
+
+static uint32_t update_adler32_resolve(uint32_t s1, uint32_t s2, const uint8_t *bytes, size_t num_bytes) {
+    __builtin_cpu_init();
+    auto impl = __builtin_cpu_supports("ssse3") ? update_adler32_ssse3 : update_adler32_generic;
+    __atomic_store_n(&update_adler32_impl, impl, __ATOMIC_RELAXED);
+    return impl(s1, s2, bytes, num_bytes);
+}
+#endif
+
 uint32_t compute_partial_adler32_checksum(const void *data, size_t num_bytes, uint32_t adler) {
     uint32_t s1 = (adler >> 0) & 0xFFFFU;
     uint32_t s2 = (adler >> 16) & 0xFFFFU;
 
     auto *bytes = (const uint8_t *) data;
-    for (size_t i = 0; i < num_bytes; i++) {
-        s1 = (s1 + bytes[i]) % adler32_base;
-        s2 = (s2 + s1) % adler32_base;
-    }
-
-    return (s2 << 16U) | s1;
+#ifdef CHECKSUM_ADLER32_HAVE_CPU_DISPATCH
+    return __atomic_load_n(&update_adler32_impl, __ATOMIC_RELAXED)(s1, s2, bytes, num_bytes);
+#else
+    return update_adler32_generic(s1, s2, bytes, num_bytes);
+#endif
 }
 
 uint32_t compute_adler32_checksum(const void *data, size_t num_bytes) {
     return compute_partial_adler32_checksum(data, num_bytes, CHECKSUM_ADLER32_INIT);
 }
+
+// Appending n bytes adds n times the first s1 to s2. The second checksum's sums both started from s1 = 1 rather than 0,
+// which added 1 to its s1 and n to its s2, so those are taken back out.
+uint32_t combine_adler32_checksums(uint32_t first_adler, uint32_t second_adler, size_t second_length) {
+    uint32_t remainder = second_length % adler32_base;
+    uint32_t s1 = first_adler & 0xFFFFU;
+    uint32_t s2 = (remainder * s1) % adler32_base;
+    s1 += (second_adler & 0xFFFFU) + adler32_base - 1;
+    s2 += ((first_adler >> 16) & 0xFFFFU) + ((second_adler >> 16) & 0xFFFFU) + adler32_base - remainder;
+    s1 %= adler32_base;
+    s2 %= adler32_base;
+    return (s2 << 16U) | s1;
+}
@@ -2,9 +2,19 @@
 #include <liim/fixed_array.h>
 #include <limits.h>
 
-static constexpr decltype(auto) build_crc32_table(uint32_t polynomial) {
-    FixedArray<uint32_t, UINT8_MAX + 1> table;
-    for (uint16_t i = 0; i < table.size(); i++) {
+// The kernel is built without SSE, so libk always uses the portable implementation.
+#if !defined(__is_libk) && !defined(__is_kernel) && (defined(__x86_64__) || defined(__i386__))
+#define CHECKSUM_CRC32_HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif
+
+constexpr size_t crc32_slice_count = 8;
+
+// Table k holds the CRC32 of each byte followed by k zero bytes, so that 8 bytes can be processed with 8 independent
+// lookups instead of a chain of 8 dependent ones.
+static constexpr decltype(auto) build_crc32_tables(uint32_t polynomial) {
+    FixedArray<uint32_t, crc32_slice_count * (UINT8_MAX + 1)> table;
+    for (uint16_t i = 0; i <= UINT8_MAX; i++) {
         uint32_t value = i;
         for (int k = 0; k < CHAR_BIT; k++) {
             if (value & 1) {
@@ -15,26 +25,158 @@ static constexpr decltype(auto) build_crc32_table(uint32_t polynomial) {
         }
         table[i] = value;
     }
+    for (size_t i = UINT8_MAX + 1; i < table.size(); i++) {
+        auto previous = table[i - (UINT8_MAX + 1)];
+        table[i] = (previous >> 8) ^ table[previous & 0xFF];
+    }
     return table;
 }
 
-static constexpr auto crc32_table = build_crc32_table(0xEDB88320U);
-static_assert(crc32_table[0] == 0);
-static_assert(crc32_table[1] == 0x77073096);
-static_assert(crc32_table[2] == 0xEE0E612C);
-static_assert(crc32_table[3] == 0x990951BA);
+static constexpr uint32_t crc32_polynomial = 0xEDB88320U;
+static constexpr auto crc32_tables = build_crc32_tables(crc32_polynomial);
+static_assert(crc32_tables[0] == 0);
+static_assert(crc32_tables[1] == 0x77073096);
+static_assert(crc32_tables[2] == 0xEE0E612C);
+static_assert(crc32_tables[3] == 0x990951BA);
 
-extern "C" {
-uint32_t compute_partial_crc32_checksum(const void* data, size_t num_bytes, uint32_t start) {
-    uint32_t sum = ~start;
+// Multiplies two polynomials modulo the CRC32 polynomial. Bit 31 holds the coefficient of x^0, matching the order in
+// which CRC32 processes bits.
+static constexpr uint32_t multiply_modulo_polynomial(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t mask = 1U << 31; mask; mask >>= 1) {
+        if (a & mask) {
+            product ^= b;
+        }
+        b = (b & 1) ? (b >> 1) ^ crc32_polynomial : b >> 1;
+    }
+    return product;
+}
+
+static constexpr decltype(auto) build_powers_of_x_table() {
+    // Entry n is x^(2^n) modulo the CRC32 polynomial, up to the largest power needed for a length in bits.
+    FixedArray<uint32_t, 3 + sizeof(size_t) * CHAR_BIT> table;
+    table[0] = 1U << 30;
+    for (size_t i = 1; i < table.size(); i++) {
+        table[i] = multiply_modulo_polynomial(table[i - 1], table[i - 1]);
+    }
+    return table;
+}
+
+static constexpr auto powers_of_x_table = build_powers_of_x_table();
+
+// These operate on the inverted CRC, and return it still inverted.
+static uint32_t update_crc32_generic(uint32_t sum, const uint8_t* bytes, size_t num_bytes) {
+    for (; num_bytes >= crc32_slice_count; bytes += crc32_slice_count, num_bytes -= crc32_slice_count) {
+        uint32_t low = sum ^ (bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t) bytes[3] << 24);
+        uint32_t high = bytes[4] | bytes[5] << 8 | bytes[6] << 16 | (uint32_t) bytes[7] << 24;
+        sum = crc32_tables[7 * 256 + (low & 0xFF)] ^ crc32_tables[6 * 256 + ((low >> 8) & 0xFF)] ^
+              crc32_tables[5 * 256 + ((low >> 16) & 0xFF)] ^ crc32_tables[4 * 256 + (low >> 24)] ^
+              crc32_tables[3 * 256 + (high & 0xFF)] ^ crc32_tables[2 * 256 + ((high >> 8) & 0xFF)] ^
+              crc32_tables[1 * 256 + ((high >> 16) & 0xFF)] ^ crc32_tables[high >> 24];
+    }
     for (size_t i = 0; i < num_bytes; i++) {
-        uint8_t index = (sum ^ ((const uint8_t*) data)[i]) & 0xFF;
-        sum = (sum >> 8) ^ crc32_table[index];
+        sum = (sum >> 8) ^ crc32_tables[(sum ^ bytes[i]) & 0xFF];
     }
-    return ~sum;
+    return sum;
+}
+
+#ifdef CHECKSUM_CRC32_HAVE_CPU_DISPATCH
+// Folds 64 bytes at a time with carry-less multiplication, then reduces to 32 bits with a Barrett reduction, as described in
+// Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction". The constants are powers of x modulo
+// the bit reflected polynomial, and num_bytes must be a multiple of 16 and at least 64.
+__attribute__((target("pclmul,sse4.1"))) static inline __m128i load(const uint8_t* bytes) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+}
+
+// Multiplies each half of x by the matching power of x in k, which moves it forward to line up with next.
+__attribute__((target("pclmul,sse4.1"))) static inline __m128i fold(__m128i x, __m128i k, __m128i next) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+}
+
+__attribute__((target("pclmul,sse4.1"))) static uint32_t update_crc32_pclmul_blocks(uint32_t sum, const uint8_t* bytes,
+                                                                                    size_t num_bytes) {
+    auto k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    auto k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    auto k5k0 = _mm_set_epi64x(0, 0x0163CD6124);
+    auto polynomial = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    auto low_mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    auto x1 = _mm_xor_si128(load(bytes), _mm_cvtsi32_si128(sum));
+    auto x2 = load(bytes + 16);
+    auto x3 = load(bytes + 32);
+    auto x4 = load(bytes + 48);
+    bytes += 64;
+    num_bytes -= 64;
+
+    for (; num_bytes >= 64; bytes += 64, num_bytes -= 64) {
+        x1 = fold(x1, k1k2, load(bytes));
+        x2 = fold(x2, k1k2, load(bytes + 16));
+        x3 = fold(x3, k1k2, load(bytes + 32));
+        x4 = fold(x4, k1k2, load(bytes + 48));
+    }
+
+    x1 = fold(x1, k3k4, x2);
+    x1 = fold(x1, k3k4, x3);
+    x1 = fold(x1, k3k4, x4);
+    for (; num_bytes >= 16; bytes += 16, num_bytes -= 16) {
+        x1 = fold(x1, k3k4, load(bytes));
+    }
+
+    // Fold 128 bits down to 64.
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, low_mask), k5k0, 0x00), x2);
+
+    // Barrett reduction down to 32 bits.
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, low_mask), polynomial, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, low_mask), polynomial, 0x00);
+    return _mm_extract_epi32(_mm_xor_si128(x1, x2), 1);
+}
+
+__attribute__((target("pclmul,sse4.1"))) static uint32_t update_crc32_pclmul(uint32_t sum, const uint8_t* bytes, size_t num_bytes) {
+    if (num_bytes >= 64) {
+        auto block_bytes = num_bytes & ~static_cast<size_t>(15);
+        sum = update_crc32_pclmul_blocks(sum, bytes, block_bytes);
+        bytes += block_bytes;
+        num_bytes -= block_bytes;
+    }
+    return update_crc32_generic(sum, bytes, num_bytes);
+}
+
+static uint32_t update_crc32_resolve(uint32_t sum, const uint8_t* bytes, size_t num_bytes);
+
+static uint32_t (*update_crc32_impl)(uint32_t, const uint8_t*, size_t) = update_crc32_resolve;
+
+static uint32_t update_crc32_resolve(uint32_t sum, const uint8_t* bytes, size_t num_bytes) {
+    __builtin_cpu_init();
+    auto impl = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1") ? update_crc32_pclmul : update_crc32_generic;
+    __atomic_store_n(&update_crc32_impl, impl, __ATOMIC_RELAXED);
+    return impl(sum, bytes, num_bytes);
+}
+#endif
+
+extern "C" {
+uint32_t compute_partial_crc32_checksum(const void* data, size_t num_bytes, uint32_t start) {
+#ifdef CHECKSUM_CRC32_HAVE_CPU_DISPATCH
+    return ~__atomic_load_n(&update_crc32_impl, __ATOMIC_RELAXED)(~start, static_cast<const uint8_t*>(data), num_bytes);
+#else
+    return ~update_crc32_generic(~start, static_cast<const uint8_t*>(data), num_bytes);
+#endif
 }
 
 uint32_t compute_crc32_checksum(const void* data, size_t num_bytes) {
     return compute_partial_crc32_checksum(data, num_bytes, CHECKSUM_CRC32_INIT);
 }
+
+// Appending n bytes to data multiplies its CRC by x^(8n), before the CRC of the appended bytes is added in.
+uint32_t combine_crc32_checksums(uint32_t first_crc, uint32_t second_crc, size_t second_length) {
+    uint32_t shift = 1U << 31;
+    for (size_t bit = 3; second_length; second_length >>= 1, bit++) {
+        if (second_length & 1) {
+            shift = multiply_modulo_polynomial(powers_of_x_table[bit], shift);
+        }
+    }
+    return multiply_modulo_polynomial(shift, first_crc) ^ second_crc;
+}
 }
@@ -1,6 +1,7 @@
 #include <ext/deflate.h>
 #include <liim/fixed_array.h>
 #include <limits.h>
+#include <string.h>
 
 // #define DEFLATE_DEBUG
 
@@ -35,327 +36,581 @@ static constexpr CompressedOffset compressed_distance_codes[DeflateDecoder::hdis
     { 4097, 11 }, { 6145, 11 }, { 8193, 12 }, { 12289, 12 }, { 16385, 13 }, { 24577, 13 }
 };
 
-static constexpr void build_huffman_tree(Symbol* symbols, size_t num_symbols, TreeNode* nodes, size_t max_nodes) {
-    FixedArray<uint16_t, DeflateDecoder::max_bits + 1> bl_count;
-    for (size_t i = 0; i < bl_count.size(); i++) {
-        bl_count[i] = 0;
+// The fast path refills the bit buffer by reading 8 bytes at once, and copies matches 8 bytes at a time when there is
+// room for the copy to overshoot.
+static constexpr size_t fast_path_input_margin = 8;
+static constexpr size_t fast_path_copy_margin = 8;
+
+static constexpr uint64_t low_bits(uint8_t count) {
+    return (static_cast<uint64_t>(1) << count) - 1;
+}
+
+static constexpr uint16_t reverse_code(uint16_t code, uint8_t length) {
+    uint16_t result = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        result = (result << 1) | (code & 1);
+        code >>= 1;
     }
+    return result;
+}
 
-    for (size_t i = 0; i < num_symbols; i++) {
-        size_t index = symbols[i].encoded_length;
-        assert(index <= DeflateDecoder::max_bits);
-        bl_count[index]++;
+// Fills in a decoding table for the given code lengths, where symbols[i] is what the table should decode symbol i to.
+// Incomplete codes are allowed, and decoding one of the missing codes produces an Invalid entry. Returns false if the
+// code lengths are over-subscribed, or if the table would not fit.
+static constexpr bool build_huffman_table(const uint8_t* lengths, size_t count, const HuffmanEntry* symbols, HuffmanEntry* table,
+                                          size_t table_size, uint8_t root_bits) {
+    uint16_t length_counts[DeflateDecoder::max_bits + 1] = {};
+    for (size_t i = 0; i < count; i++) {
+        assert(lengths[i] <= DeflateDecoder::max_bits);
+        length_counts[lengths[i]]++;
     }
+    length_counts[0] = 0;
 
-    FixedArray<uint16_t, DeflateDecoder::max_bits + 1> next_code;
+    int left = 1;
+    for (size_t bits = 1; bits <= DeflateDecoder::max_bits; bits++) {
+        left = (left << 1) - length_counts[bits];
+        if (left < 0) {
+            return false;
+        }
+    }
+
+    uint16_t first_code[DeflateDecoder::max_bits + 1] = {};
     uint16_t code = 0;
-    bl_count[0] = 0;
     for (size_t bits = 1; bits <= DeflateDecoder::max_bits; bits++) {
-        code = (code + bl_count[bits - 1]) << 1;
-        next_code[bits] = code;
+        code = (code + length_counts[bits - 1]) << 1;
+        first_code[bits] = code;
     }
 
-    for (size_t n = 0; n < num_symbols; n++) {
-        size_t len = symbols[n].encoded_length;
-        if (len != 0) {
-            symbols[n].code = next_code[len]++;
-        } else {
-            symbols[n].code = 0;
+    // Codes are packed starting with their most significant bit, so the table is indexed by the reversed code. Each
+    // second level table has to be big enough for the longest code which starts with its prefix.
+    size_t root_size = 1 << root_bits;
+    uint8_t subtable_bits[1 << DeflateDecoder::literal_root_bits] = {};
+    uint16_t next_code[DeflateDecoder::max_bits + 1] = {};
+    for (size_t bits = 0; bits <= DeflateDecoder::max_bits; bits++) {
+        next_code[bits] = first_code[bits];
+    }
+    for (size_t i = 0; i < count; i++) {
+        auto length = lengths[i];
+        if (length > root_bits) {
+            auto prefix = reverse_code(next_code[length]++, length) & (root_size - 1);
+            subtable_bits[prefix] = max<uint8_t>(subtable_bits[prefix], length - root_bits);
         }
     }
 
-    size_t node_count = 1;
-    for (size_t i = 0; i < num_symbols; i++) {
-        auto code = symbols[i].code;
-        auto len = symbols[i].encoded_length;
-        if (!len) {
+    for (size_t i = 0; i < root_size; i++) {
+        table[i] = HuffmanEntry().with_bits(root_bits);
+    }
+
+    size_t table_end = root_size;
+    for (size_t i = 0; i < count; i++) {
+        auto length = lengths[i];
+        if (!length) {
             continue;
         }
 
-        uint16_t tree_index = 0;
-        for (uint8_t bit_index = len; bit_index > 0; bit_index--) {
-            auto bit = code & (1U << (bit_index - 1U));
-            if (!nodes[tree_index].is_initialized()) {
-                nodes[tree_index].m_left = node_count;
-                nodes[tree_index].m_right = (node_count + 1) | 0x8000U;
-                node_count += 2;
-                assert(node_count <= max_nodes);
+        auto reversed = reverse_code(first_code[length]++, length);
+        if (length <= root_bits) {
+            for (size_t index = reversed; index < root_size; index += 1 << length) {
+                table[index] = symbols[i].with_bits(length);
             }
+            continue;
+        }
 
-            tree_index = bit ? nodes[tree_index].left() : nodes[tree_index].right();
+        auto prefix = reversed & (root_size - 1);
+        if (table[prefix].type() != HuffmanEntry::Subtable) {
+            auto bits = subtable_bits[prefix];
+            if (table_end + (1 << bits) > table_size) {
+                return false;
+            }
+
+            table[prefix] = HuffmanEntry(HuffmanEntry::Subtable, table_end, bits, root_bits);
+            for (size_t index = 0; index < (1U << bits); index++) {
+                table[table_end + index] = HuffmanEntry().with_bits(bits);
+            }
+            table_end += 1 << bits;
         }
 
-        nodes[tree_index].m_left = symbols[i].symbol | 0x8000U;
-        nodes[tree_index].m_right = 0x8000U;
+        auto subtable = table[prefix];
+        for (size_t index = reversed >> root_bits; index < (1U << subtable.extra_bits()); index += 1 << (length - root_bits)) {
+            table[subtable.value() + index] = symbols[i].with_bits(length - root_bits);
+        }
     }
+    return true;
 }
 
-static constexpr decltype(auto) build_static_huffman_literals() {
-    FixedArray<Symbol, DeflateDecoder::hlit_max + 2> literal_symbols;
-    for (size_t i = 0; i < literal_symbols.size(); i++) {
-        literal_symbols[i].code = 0;
-        literal_symbols[i].symbol = i;
-        literal_symbols[i].encoded_length = i <= 143 ? 8 : i <= 255 ? 9 : i <= 279 ? 7 : 8;
+static constexpr decltype(auto) build_literal_symbols() {
+    FixedArray<HuffmanEntry, DeflateDecoder::hlit_max + 2> symbols;
+    for (size_t i = 0; i < block_end_marker; i++) {
+        symbols[i] = HuffmanEntry(HuffmanEntry::Literal, i);
+    }
+    symbols[block_end_marker] = HuffmanEntry(HuffmanEntry::EndOfBlock, 0);
+    for (size_t i = 0; i < DeflateDecoder::hlit_max - DeflateDecoder::hlit_offset; i++) {
+        auto descriptor = compressed_length_codes[i];
+        symbols[DeflateDecoder::hlit_offset + i] = HuffmanEntry(HuffmanEntry::Base, descriptor.offset, descriptor.extra_bits);
     }
+    return symbols;
+}
 
-    FixedArray<TreeNode, 575> tree;
-    for (size_t i = 0; i < tree.size(); i++) {
-        tree[i].m_left = 0;
-        tree[i].m_right = 0;
+static constexpr decltype(auto) build_distance_symbols() {
+    FixedArray<HuffmanEntry, DeflateDecoder::hdist_max> symbols;
+    for (size_t i = 0; i < 30; i++) {
+        auto descriptor = compressed_distance_codes[i];
+        symbols[i] = HuffmanEntry(HuffmanEntry::Base, descriptor.offset, descriptor.extra_bits);
     }
+    return symbols;
+}
 
-    build_huffman_tree(literal_symbols.array(), literal_symbols.size(), tree.array(), tree.size());
-    return tree;
+static constexpr decltype(auto) build_code_length_symbols() {
+    FixedArray<HuffmanEntry, DeflateDecoder::hclen_max> symbols;
+    for (size_t i = 0; i < symbols.size(); i++) {
+        symbols[i] = HuffmanEntry(HuffmanEntry::Literal, i);
+    }
+    return symbols;
 }
 
-static constexpr decltype(auto) build_static_huffman_distances() {
-    FixedArray<Symbol, DeflateDecoder::hdist_max> distance_symbols;
-    for (size_t i = 0; i < distance_symbols.size(); i++) {
-        distance_symbols[i].code = 0;
-        distance_symbols[i].symbol = i;
-        distance_symbols[i].encoded_length = 5;
+constexpr auto literal_symbols = build_literal_symbols();
+constexpr auto distance_symbols = build_distance_symbols();
+constexpr auto code_length_symbols = build_code_length_symbols();
+
+static constexpr decltype(auto) build_static_literal_table() {
+    FixedArray<uint8_t, DeflateDecoder::hlit_max + 2> lengths;
+    for (size_t i = 0; i < lengths.size(); i++) {
+        lengths[i] = i <= 143 ? 8 : i <= 255 ? 9 : i <= 279 ? 7 : 8;
     }
 
-    FixedArray<TreeNode, 63> tree;
-    for (size_t i = 0; i < tree.size(); i++) {
-        tree[i].m_left = 0;
-        tree[i].m_right = 0;
+    FixedArray<HuffmanEntry, 1 << DeflateDecoder::literal_root_bits> table;
+    build_huffman_table(lengths.array(), lengths.size(), literal_symbols.array(), table.array(), table.size(),
+                        DeflateDecoder::literal_root_bits);
+    return table;
+}
+
+static constexpr decltype(auto) build_static_distance_table() {
+    FixedArray<uint8_t, DeflateDecoder::hdist_max> lengths;
+    for (size_t i = 0; i < lengths.size(); i++) {
+        lengths[i] = 5;
     }
 
-    build_huffman_tree(distance_symbols.array(), distance_symbols.size(), tree.array(), tree.size());
-    return tree;
+    FixedArray<HuffmanEntry, 1 << DeflateDecoder::distance_root_bits> table;
+    build_huffman_table(lengths.array(), lengths.size(), distance_symbols.array(), table.array(), table.size(),
+                        DeflateDecoder::distance_root_bits);
+    return table;
 }
 
-constexpr auto static_literal_table = build_static_huffman_literals();
-constexpr auto static_distance_table = build_static_huffman_distances();
+constexpr auto static_literal_table = build_static_literal_table();
+constexpr auto static_distance_table = build_static_distance_table();
 
 DeflateDecoder::DeflateDecoder() : StreamDecoder(decode()) {}
 
 DeflateDecoder::~DeflateDecoder() {}
 
-Generator<StreamResult> DeflateDecoder::decode_symbol(const TreeNode* tree, uint16_t& value) {
-    int tree_index = 0;
+void DeflateDecoder::append_to_window(const uint8_t* data, size_t size) {
+    if (size > window_size) {
+        data += size - window_size;
+        m_window_position += size - window_size;
+        size = window_size;
+    }
+
+    size_t offset = m_window_position % window_size;
+    size_t first_part = min(size, window_size - offset);
+    memcpy(m_window.array() + offset, data, first_part);
+    memcpy(m_window.array(), data + first_part, size - first_part);
+    m_window_position += size;
+}
+
+// Input is only read a byte at a time when more bits are needed, so that fewer than 8 bits are left over afterwards.
+// This keeps bytes after the end of the stream in the reader.
+Generator<StreamResult> DeflateDecoder::consume_bits(uint32_t& value, uint8_t bit_count) {
+    while (m_bit_count < bit_count) {
+        auto byte = reader().next_byte();
+        if (!byte) {
+            co_yield StreamResult::NeedsMoreInput;
+            continue;
+        }
+
+        m_bit_buffer |= static_cast<uint64_t>(*byte) << m_bit_count;
+        m_bit_count += 8;
+    }
+
+    value = m_bit_buffer & low_bits(bit_count);
+    m_bit_buffer >>= bit_count;
+    m_bit_count -= bit_count;
+}
+
+// Looks up the next symbol using the bits which are buffered, and only reads more input once the entry found needs more
+// bits than there are. Missing bits read as 0, which finds the right entry if the code is short enough.
+Generator<StreamResult> DeflateDecoder::decode_symbol(const HuffmanEntry* table, uint8_t root_bits, HuffmanEntry& entry) {
     for (;;) {
-        if (tree[tree_index].is_symbol()) {
-            value = tree[tree_index].symbol();
+        entry = table[m_bit_buffer & low_bits(root_bits)];
+        uint8_t bits = entry.bits();
+        if (entry.type() == HuffmanEntry::Subtable && bits <= m_bit_count) {
+            entry = table[entry.value() + ((m_bit_buffer >> root_bits) & low_bits(entry.extra_bits()))];
+            bits += entry.bits();
+        }
+
+        if (entry.type() != HuffmanEntry::Subtable && bits <= m_bit_count) {
+            m_bit_buffer >>= bits;
+            m_bit_count -= bits;
             co_return;
         }
 
-        auto bit = reader().next_bit();
-        if (!bit) {
+        auto byte = reader().next_byte();
+        if (!byte) {
             co_yield StreamResult::NeedsMoreInput;
             continue;
         }
 
-        tree_index = bit.value() ? tree[tree_index].left() : tree[tree_index].right();
+        m_bit_buffer |= static_cast<uint64_t>(*byte) << m_bit_count;
+        m_bit_count += 8;
     }
 }
 
+// Decodes symbols without suspending for as long as there is enough input and output space that neither can run out
+// during a symbol. Whatever it leaves in the bit buffer is consistent with the slow path.
+DeflateDecoder::FastPathResult DeflateDecoder::decode_fast() {
+    auto& reader = this->reader();
+    auto& writer = this->writer();
+    if (reader.bytes_remaining() < fast_path_input_margin || writer.full()) {
+        return FastPathResult::NeedsSlowPath;
+    }
+
+    const uint8_t* input_start = reader.data() + reader.byte_offset();
+    const uint8_t* input = input_start;
+    const uint8_t* input_end = reader.data() + reader.bytes_total() - fast_path_input_margin;
+    uint8_t* output_start = writer.data() + writer.bytes_written();
+    uint8_t* output = output_start;
+    uint8_t* output_end = writer.data() + writer.capacity();
+
+    auto* literal_table = m_literal_table;
+    auto* distance_table = m_distance_table;
+    uint64_t bit_buffer = m_bit_buffer;
+    uint8_t bit_count = m_bit_count;
+
+    auto result = FastPathResult::NeedsSlowPath;
+    while (input <= input_end && output < output_end) {
+        // Refill the bit buffer to at least 56 bits, which is enough for a length and distance with their extra bits.
+        // The bits above bit_count are the next input bytes, so ORing them in again later is harmless.
+        uint64_t word;
+        memcpy(&word, input, sizeof(word));
+        bit_buffer |= word << bit_count;
+        input += (63 - bit_count) >> 3;
+        bit_count |= 56;
+
+        // If a match turns out not to fit in the output, the slow path starts over from here.
+        auto symbol_bit_buffer = bit_buffer;
+        auto symbol_bit_count = bit_count;
+
+        auto entry = literal_table[bit_buffer & low_bits(literal_root_bits)];
+        if (entry.type() == HuffmanEntry::Subtable) {
+            bit_buffer >>= literal_root_bits;
+            bit_count -= literal_root_bits;
+            entry = literal_table[entry.value() + (bit_buffer & low_bits(entry.extra_bits()))];
+        }
+        bit_buffer >>= entry.bits();
+        bit_count -= entry.bits();
+
+        if (entry.type() == HuffmanEntry::Literal) {
+            *output++ = entry.value();
+            continue;
+        }
+
+        if (entry.type() != HuffmanEntry::Base) {
+            result = entry.type() == HuffmanEntry::EndOfBlock ? FastPathResult::EndOfBlock : FastPathResult::Error;
+            break;
+        }
+
+        size_t length = entry.value() + (bit_buffer & low_bits(entry.extra_bits()));
+        bit_buffer >>= entry.extra_bits();
+        bit_count -= entry.extra_bits();
+
+        entry = distance_table[bit_buffer & low_bits(distance_root_bits)];
+        if (entry.type() == HuffmanEntry::Subtable) {
+            bit_buffer >>= distance_root_bits;
+            bit_count -= distance_root_bits;
+            entry = distance_table[entry.value() + (bit_buffer & low_bits(entry.extra_bits()))];
+        }
+        bit_buffer >>= entry.bits();
+        bit_count -= entry.bits();
+
+        if (entry.type() != HuffmanEntry::Base) {
+            result = FastPathResult::Error;
+            break;
+        }
+
+        size_t distance = entry.value() + (bit_buffer & low_bits(entry.extra_bits()));
+        bit_buffer >>= entry.extra_bits();
+        bit_count -= entry.extra_bits();
+
+        if (length > static_cast<size_t>(output_end - output)) {
+            bit_buffer = symbol_bit_buffer;
+            bit_count = symbol_bit_count;
+            break;
+        }
+
+        size_t produced = output - output_start;
+        if (distance > m_window_position + produced) {
+            result = FastPathResult::Error;
+            break;
+        }
+
+        if (distance <= produced) {
+            const uint8_t* from = output - distance;
+            if (distance >= 8 && length + fast_path_copy_margin <= static_cast<size_t>(output_end - output)) {
+                // Each 8 byte chunk is copied from bytes which have already been written, since they are at least 8
+                // bytes back. The last chunk may write past the match, into space which isn't part of the output yet.
+                for (size_t i = 0; i < length; i += 8) {
+                    memcpy(output + i, from + i, 8);
+                }
+            } else {
+                for (size_t i = 0; i < length; i++) {
+                    output[i] = from[i];
+                }
+            }
+            output += length;
+            continue;
+        }
+
+        // The start of the match was decoded before the fast path started, so it is in the window.
+        size_t from_window = min(length, distance - produced);
+        size_t window_offset = m_window_position + produced - distance;
+        for (size_t i = 0; i < from_window; i++) {
+            output[i] = m_window[(window_offset + i) % window_size];
+        }
+        for (size_t i = from_window; i < length; i++) {
+            output[i] = output[i - distance];
+        }
+        output += length;
+    }
+
+    // Give back the whole bytes which have been read but not consumed. They all came from this input, since the bit
+    // buffer had fewer than 8 bits when the fast path started.
+    size_t unused_bytes = min<size_t>(bit_count / 8, input - input_start);
+    input -= unused_bytes;
+    bit_count -= unused_bytes * 8;
+    bit_buffer &= low_bits(bit_count);
+
+    m_bit_buffer = bit_buffer;
+    m_bit_count = bit_count;
+    reader.set_byte_offset(input - reader.data());
+    append_to_window(output_start, output - output_start);
+    writer.advance(output - output_start);
+    return result;
+}
+
 Generator<StreamResult> DeflateDecoder::decode_no_compression() {
-    uint16_t length;
-    co_yield read_bytes(as_writable_bytes(length));
+    // Stored blocks start at a byte boundary.
+    m_bit_buffer >>= m_bit_count % 8;
+    m_bit_count -= m_bit_count % 8;
 
-    uint16_t length_complement;
-    co_yield read_bytes(as_writable_bytes(length_complement));
+    uint32_t length;
+    co_yield consume_bits(length, 16);
 
-    if ((length | length_complement) != static_cast<uint16_t>(-1)) {
+    uint32_t length_complement;
+    co_yield consume_bits(length_complement, 16);
+
+    if ((length ^ length_complement) != 0xFFFFU) {
         co_yield StreamResult::Error;
         co_return;
     }
 
-    for (uint32_t i = 0; i < length; i++) {
-        uint8_t byte;
-        co_yield read_bytes(as_writable_bytes(byte));
-        co_yield write_bytes(as_readonly_bytes(byte));
-        m_previously_decoded_data.force_add(byte);
+    while (length > 0) {
+        if (writer().full()) {
+            co_yield StreamResult::NeedsMoreOutputSpace;
+            continue;
+        }
+
+        // Whole bytes can still be buffered after reading the length.
+        if (m_bit_count > 0) {
+            uint32_t byte;
+            co_yield consume_bits(byte, 8);
+            auto output_byte = static_cast<uint8_t>(byte);
+            co_yield write_bytes(as_readonly_bytes(output_byte));
+            append_to_window(&output_byte, 1);
+            length--;
+            continue;
+        }
+
+        if (reader().finished()) {
+            co_yield StreamResult::NeedsMoreInput;
+            continue;
+        }
+
+        size_t count = min<size_t>(min<size_t>(length, reader().bytes_remaining()), writer().space_available());
+        const uint8_t* input = reader().data() + reader().byte_offset();
+        memcpy(writer().data() + writer().bytes_written(), input, count);
+        append_to_window(input, count);
+        reader().advance(count);
+        writer().advance(count);
+        length -= count;
     }
 }
 
 Generator<StreamResult> DeflateDecoder::decode_dynamic_symbols() {
     uint32_t hlit;
-    co_yield read_bits(hlit, 5);
+    co_yield consume_bits(hlit, 5);
 
     uint32_t hdist;
-    co_yield read_bits(hdist, 5);
+    co_yield consume_bits(hdist, 5);
 
     uint32_t hclen;
-    co_yield read_bits(hclen, 4);
+    co_yield consume_bits(hclen, 4);
 #ifdef DEFLATE_DEBUG
     fprintf(stderr, "hlit=%lu hdist=%lu hclen=%lu\n", hlit + hlit_offset, hdist + hdist_offset, hclen + hclen_offset);
 #endif /* DEFLATE_DEBUG */
 
-    for (size_t i = 0; i < m_code_length_symbols.size(); i++) {
-        m_code_length_symbols[i].encoded_length = 0;
-        m_code_length_symbols[i].code = 0;
-        m_code_length_symbols[i].symbol = i;
+    hlit += hlit_offset;
+    hdist += hdist_offset;
+    if (hlit > hlit_max || hdist > hdist_max - 2) {
+        co_yield StreamResult::Error;
+        co_return;
     }
 
+    uint8_t code_length_lengths[hclen_max] = {};
     for (size_t i = 0; i < hclen + hclen_offset; i++) {
-        uint32_t len;
-        co_yield read_bits(len, 3);
-
-        auto index = code_length_alphabet_order_mapping[i];
-        m_code_length_symbols[index].encoded_length = len;
+        uint32_t length;
+        co_yield consume_bits(length, 3);
+        code_length_lengths[code_length_alphabet_order_mapping[i]] = length;
     }
 
 #ifdef DEFLATE_DEBUG
-    for (size_t i = 0; i < m_code_length_symbols.size(); i++) {
-        fprintf(stderr, "CLA: %3u:%u\n", m_code_length_symbols[i].symbol, m_code_length_symbols[i].encoded_length);
+    for (size_t i = 0; i < hclen_max; i++) {
+        fprintf(stderr, "CLA: %3lu:%u\n", i, code_length_lengths[i]);
     }
 #endif /* DEFLATE_DEBUG */
 
-    for (size_t i = 0; i < m_length_codes_tree.size(); i++) {
-        m_length_codes_tree[i].m_left = 0;
-        m_length_codes_tree[i].m_right = 0;
-    }
-    build_huffman_tree(m_code_length_symbols.array(), m_code_length_symbols.size(), m_length_codes_tree.array(),
-                       m_length_codes_tree.size());
-
-    m_literal_and_distance_symbols.resize(hlit + hlit_offset + hdist + hdist_offset);
-    for (size_t i = 0; i < hlit + hlit_offset; i++) {
-        m_literal_and_distance_symbols[i].symbol = i;
-    }
-    for (size_t i = 0; i < hdist + hdist_offset; i++) {
-        m_literal_and_distance_symbols[hlit + hlit_offset + i].symbol = i;
+    if (!build_huffman_table(code_length_lengths, hclen_max, code_length_symbols.array(), m_code_length_table.array(),
+                             m_code_length_table.size(), code_length_root_bits)) {
+        co_yield StreamResult::Error;
+        co_return;
     }
 
+    uint8_t lengths[hlit_max + hdist_max];
     size_t i = 0;
-    uint16_t prev_code_length = 0;
-    while (i < m_literal_and_distance_symbols.size()) {
-        uint16_t value;
-        co_yield decode_symbol(m_length_codes_tree.array(), value);
-#ifdef DEFLATE_DEBUG
-        fprintf(stderr, "DECODE: %3u (code length)\n", value);
-#endif /* DEFLATE_DEBUG */
-
-        if (value > 18) {
+    while (i < hlit + hdist) {
+        HuffmanEntry entry;
+        co_yield decode_symbol(m_code_length_table.array(), code_length_root_bits, entry);
+        if (entry.type() != HuffmanEntry::Literal) {
             co_yield StreamResult::Error;
             co_return;
         }
 
-        if (value == 16) {
-            uint32_t repetitions;
-            co_yield read_bits(repetitions, 2);
+        auto value = entry.value();
+#ifdef DEFLATE_DEBUG
+        fprintf(stderr, "DECODE: %3u (code length)\n", value);
+#endif /* DEFLATE_DEBUG */
 
-            for (size_t j = 0; j < repetitions + 3UL; j++) {
-                m_literal_and_distance_symbols[i++].encoded_length = prev_code_length;
-            }
+        if (value < 16) {
+            lengths[i++] = value;
             continue;
         }
 
-        if (value == 17) {
-            uint32_t repetitions;
-            co_yield read_bits(repetitions, 3);
-
-            for (size_t j = 0; j < repetitions + 3UL; j++) {
-                m_literal_and_distance_symbols[i++].encoded_length = 0;
+        uint32_t repetitions;
+        uint8_t repeated_length = 0;
+        if (value == 16) {
+            if (i == 0) {
+                co_yield StreamResult::Error;
+                co_return;
             }
-            prev_code_length = 0;
-            continue;
+            repeated_length = lengths[i - 1];
+            co_yield consume_bits(repetitions, 2);
+            repetitions += 3;
+        } else if (value == 17) {
+            co_yield consume_bits(repetitions, 3);
+            repetitions += 3;
+        } else {
+            co_yield consume_bits(repetitions, 7);
+            repetitions += 11;
         }
 
-        if (value == 18) {
-            uint32_t repetitions;
-            co_yield read_bits(repetitions, 7);
-
-            for (size_t j = 0; j < repetitions + 11UL; j++) {
-                m_literal_and_distance_symbols[i++].encoded_length = 0;
-            }
-            prev_code_length = 0;
-            continue;
+        if (i + repetitions > hlit + hdist) {
+            co_yield StreamResult::Error;
+            co_return;
+        }
+        for (size_t j = 0; j < repetitions; j++) {
+            lengths[i++] = repeated_length;
         }
-
-        m_literal_and_distance_symbols[i++].encoded_length = value;
-        prev_code_length = value;
-    }
-
-    if (i > m_literal_and_distance_symbols.size()) {
-        co_yield StreamResult::Error;
-        co_return;
     }
 
 #ifdef DEFLATE_DEBUG
-    for (size_t i = 0; i < hlit + hlit_offset; i++) {
-        fprintf(stderr, "LLA: %3u:%u\n", m_literal_and_distance_symbols[i].symbol, m_literal_and_distance_symbols[i].encoded_length);
+    for (size_t i = 0; i < hlit; i++) {
+        fprintf(stderr, "LLA: %3lu:%u\n", i, lengths[i]);
     }
-    for (size_t i = 0; i < hdist + hdist_offset; i++) {
-        auto index = hlit + hlit_offset + i;
-        fprintf(stderr, "DTA: %3u:%u\n", m_literal_and_distance_symbols[index].symbol,
-                m_literal_and_distance_symbols[index].encoded_length);
+    for (size_t i = 0; i < hdist; i++) {
+        fprintf(stderr, "DTA: %3lu:%u\n", i, lengths[hlit + i]);
     }
 #endif /* DEFLATE_DEBUG */
 
-    for (size_t i = 0; i < hlit + hlit_offset; i++) {
-        m_dynamic_literal_tree[i].m_left = 0;
-        m_dynamic_literal_tree[i].m_right = 0;
-    }
-    build_huffman_tree(m_literal_and_distance_symbols.array(), hlit + hlit_offset, m_dynamic_literal_tree.array(),
-                       m_dynamic_literal_tree.size());
-
-    for (size_t i = 0; i < hdist + hdist_offset; i++) {
-        m_dynamic_distance_tree[i].m_left = 0;
-        m_dynamic_distance_tree[i].m_right = 0;
+    if (!build_huffman_table(lengths, hlit, literal_symbols.array(), m_dynamic_literal_table.array(), m_dynamic_literal_table.size(),
+                             literal_root_bits) ||
+        !build_huffman_table(lengths + hlit, hdist, distance_symbols.array(), m_dynamic_distance_table.array(),
+                             m_dynamic_distance_table.size(), distance_root_bits)) {
+        co_yield StreamResult::Error;
+        co_return;
     }
-    build_huffman_tree(m_literal_and_distance_symbols.array() + hlit + hlit_offset, hdist + hdist_offset, m_dynamic_distance_tree.array(),
-                       m_dynamic_distance_tree.size());
 
-    m_literal_tree = m_dynamic_literal_tree.array();
-    m_distance_tree = m_dynamic_distance_tree.array();
+    m_literal_table = m_dynamic_literal_table.array();
+    m_distance_table = m_dynamic_distance_table.array();
 }
 
 Generator<StreamResult> DeflateDecoder::decode_with_compression() {
     for (;;) {
-        uint16_t value;
-        co_yield decode_symbol(m_literal_tree, value);
+        auto fast_path_result = decode_fast();
+        if (fast_path_result == FastPathResult::EndOfBlock) {
+            break;
+        }
+        if (fast_path_result == FastPathResult::Error) {
+            co_yield StreamResult::Error;
+            co_return;
+        }
+
+        // Near the end of the input or output, decode a single symbol in a way that can be suspended.
+        HuffmanEntry entry;
+        co_yield decode_symbol(m_literal_table, literal_root_bits, entry);
 #ifdef DEFLATE_DEBUG
-        fprintf(stderr, "DECODE: %3u ('%c')\n", value, value);
+        fprintf(stderr, "DECODE: %3u (type %u)\n", entry.value(), entry.type());
 #endif /* DEFLATE_DEBUG */
 
-        if (value == block_end_marker) {
+        if (entry.type() == HuffmanEntry::EndOfBlock) {
             break;
         }
 
-        if (value < block_end_marker) {
-            uint8_t value_byte = static_cast<uint8_t>(value);
-            co_yield write_bytes(as_readonly_bytes(value_byte));
-            m_previously_decoded_data.force_add(value_byte);
+        if (entry.type() == HuffmanEntry::Literal) {
+            auto byte = static_cast<uint8_t>(entry.value());
+            co_yield write_bytes(as_readonly_bytes(byte));
+            append_to_window(&byte, 1);
             continue;
         }
 
-        auto length_code = value - hlit_offset;
-        auto descriptor = compressed_length_codes[length_code];
-
-        uint32_t extra_data;
-        co_yield read_bits(extra_data, descriptor.extra_bits);
+        if (entry.type() != HuffmanEntry::Base) {
+            co_yield StreamResult::Error;
+            co_return;
+        }
 
-        auto length = descriptor.offset + extra_data;
+        uint32_t extra_length;
+        co_yield consume_bits(extra_length, entry.extra_bits());
+        size_t length = entry.value() + extra_length;
 
-        uint16_t distance_code;
-        co_yield decode_symbol(m_distance_tree, distance_code);
-#ifdef DEFLATE_DEBUG
-        fprintf(stderr, "DECODE: %3u (distance)\n", distance_code);
-#endif /* DEFLATE_DEBUG */
-
-        auto dst_descriptor = compressed_distance_codes[distance_code];
+        co_yield decode_symbol(m_distance_table, distance_root_bits, entry);
+        if (entry.type() != HuffmanEntry::Base) {
+            co_yield StreamResult::Error;
+            co_return;
+        }
 
         uint32_t extra_distance;
-        co_yield read_bits(extra_distance, dst_descriptor.extra_bits);
-
-        auto distance = dst_descriptor.offset + extra_distance;
+        co_yield consume_bits(extra_distance, entry.extra_bits());
+        size_t distance = entry.value() + extra_distance;
 #ifdef DEFLATE_DEBUG
-        fprintf(stderr, "length=%u distance=%u\n", length, distance);
+        fprintf(stderr, "length=%lu distance=%lu\n", length, distance);
 #endif /* DEFLATE_DEBUG */
 
-        size_t current_index = m_previously_decoded_data.size();
-        if (current_index < static_cast<size_t>(distance)) {
+        if (distance > m_window_position) {
             co_yield StreamResult::Error;
             co_return;
         }
 
         for (size_t i = 0; i < length; i++) {
-            auto byte = m_previously_decoded_data.access_from_tail(distance);
+            auto byte = m_window[(m_window_position - distance) % window_size];
             co_yield write_bytes(as_readonly_bytes(byte));
-            m_previously_decoded_data.force_add(byte);
+            append_to_window(&byte, 1);
         }
     }
 }
@@ -363,7 +618,7 @@ Generator<StreamResult> DeflateDecoder::decode_with_compression() {
 Generator<StreamResult> DeflateDecoder::decode() {
     for (;;) {
         uint32_t block_header;
-        co_yield read_bits(block_header, 3);
+        co_yield consume_bits(block_header, 3);
 
         bool is_last_block = !!(block_header & 1);
         uint8_t compression_type = block_header >> 1;
@@ -374,8 +629,8 @@ Generator<StreamResult> DeflateDecoder::decode() {
                 break;
             }
             case CompressionType::Fixed: {
-                m_literal_tree = static_literal_table.array();
-                m_distance_tree = static_distance_table.array();
+                m_literal_table = static_literal_table.array();
+                m_distance_table = static_distance_table.array();
                 co_yield decode_with_compression();
                 break;
             }
@@ -396,36 +651,764 @@ Generator<StreamResult> DeflateDecoder::decode() {
     }
 }
 
-DeflateEncoder::DeflateEncoder() : StreamEncoder(encode()) {}
+static constexpr size_t window_size = 32768;
+static constexpr size_t window_mask = window_size - 1;
+static constexpr size_t min_match = 3;
+static constexpr size_t max_match = 258;
+// Enough input to find a match of maximum length at the current position, as long as more input is coming.
+static constexpr size_t min_lookahead = max_match + min_match + 1;
+static constexpr size_t max_distance = window_size - min_lookahead;
+static constexpr size_t hash_bits = 15;
+static constexpr size_t hash_size = 1 << hash_bits;
+static constexpr size_t max_block_symbols = 16383;
+// Matches of the minimum length which are further away than this usually cost more than the literals they replace.
+static constexpr size_t too_far = 4096;
+static constexpr size_t literal_codes = 286;
+static constexpr size_t fixed_literal_codes = 288;
+static constexpr size_t distance_codes = 30;
+static constexpr size_t code_length_codes = DeflateDecoder::hclen_max;
+static constexpr uint8_t max_code_length_bits = 7;
+
+struct CompressionLevel {
+    // Search less of the hash chain once the previous match is at least this long.
+    uint16_t good_length;
+    // For lazy levels, don't look for a better match once one is at least this long. For greedy levels, only hash
+    // every position a match covers if it is at most this long.
+    uint16_t max_lazy;
+    // Stop searching once a match is at least this long.
+    uint16_t nice_length;
+    uint16_t max_chain;
+    bool lazy;
+};
 
-DeflateEncoder::~DeflateEncoder() {}
+static constexpr CompressionLevel compression_levels[DeflateEncoder::max_level + 1] = {
+    { 0, 0, 0, 0, false },        { 4, 4, 8, 4, false },        { 4, 5, 16, 8, false },         { 4, 6, 32, 32, false },
+    { 4, 4, 16, 16, true },       { 8, 16, 32, 32, true },      { 8, 16, 128, 128, true },      { 8, 32, 128, 256, true },
+    { 32, 128, 258, 1024, true }, { 32, 258, 258, 4096, true },
+};
 
-Generator<StreamResult> DeflateEncoder::encode() {
+static constexpr decltype(auto) build_length_code_table() {
+    FixedArray<uint8_t, max_match - min_match + 1> table;
+    for (size_t code = 0; code < DeflateDecoder::hlit_max - DeflateDecoder::hlit_offset; code++) {
+        auto descriptor = compressed_length_codes[code];
+        for (size_t extra = 0; extra < (1U << descriptor.extra_bits) && descriptor.offset + extra <= max_match; extra++) {
+            table[descriptor.offset + extra - min_match] = code;
+        }
+    }
+    return table;
+}
+
+// Distances up to 256 are looked up directly, and longer ones by their distance divided by 128, which works since the
+// codes for them all have at least 7 extra bits.
+static constexpr decltype(auto) build_distance_code_table() {
+    FixedArray<uint8_t, 512> table;
+    for (size_t code = 0; code < distance_codes; code++) {
+        auto descriptor = compressed_distance_codes[code];
+        for (size_t extra = 0; extra < (1U << descriptor.extra_bits); extra++) {
+            size_t distance = descriptor.offset + extra - 1;
+            table[distance < 256 ? distance : 256 + (distance >> 7)] = code;
+        }
+    }
+    return table;
+}
+
+constexpr auto length_code_table = build_length_code_table();
+constexpr auto distance_code_table = build_distance_code_table();
+
+static uint8_t distance_code(size_t distance) {
+    distance--;
+    return distance_code_table[distance < 256 ? distance : 256 + (distance >> 7)];
+}
+
+static uint16_t reverse_bits(uint16_t code, uint8_t length) {
+    uint16_t result = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        result = (result << 1) | (code & 1);
+        code >>= 1;
+    }
+    return result;
+}
+
+// Assigns canonical codes to the given code lengths, bit reversed since Huffman codes are packed starting with their most
+// significant bit.
+static void build_codes(const uint8_t* lengths, size_t count, uint16_t* codes) {
+    uint16_t bl_count[DeflateDecoder::max_bits + 1] = {};
+    for (size_t i = 0; i < count; i++) {
+        bl_count[lengths[i]]++;
+    }
+    bl_count[0] = 0;
+
+    uint16_t next_code[DeflateDecoder::max_bits + 1] = {};
+    uint16_t code = 0;
+    for (size_t bits = 1; bits <= DeflateDecoder::max_bits; bits++) {
+        code = (code + bl_count[bits - 1]) << 1;
+        next_code[bits] = code;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        codes[i] = lengths[i] ? reverse_bits(next_code[lengths[i]]++, lengths[i]) : 0;
+    }
+}
+
+// Computes Huffman code lengths of at most max_length bits for the given symbol frequencies. Unused symbols get no
+// code, but at least two symbols always do, so that the code is complete.
+static void build_code_lengths(const uint32_t* frequencies, size_t count, uint8_t* lengths, uint8_t max_length) {
+    struct Entry {
+        uint32_t frequency;
+        uint16_t symbol;
+    };
+    Entry entries[fixed_literal_codes];
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        lengths[i] = 0;
+        if (frequencies[i]) {
+            entries[used++] = { frequencies[i], static_cast<uint16_t>(i) };
+        }
+    }
+    for (size_t i = 0; used < 2 && i < count; i++) {
+        if (!frequencies[i]) {
+            entries[used++] = { 0, static_cast<uint16_t>(i) };
+        }
+    }
+
+    // Sort by increasing frequency.
+    for (size_t i = 1; i < used; i++) {
+        auto entry = entries[i];
+        size_t j = i;
+        for (; j > 0 && entries[j - 1].frequency > entry.frequency; j--) {
+            entries[j] = entries[j - 1];
+        }
+        entries[j] = entry;
+    }
+
+    // Compute the optimal code lengths in place (Moffat and Katajainen). Afterwards, depths[i] is the code length of
+    // the i-th least frequent symbol.
+    uint32_t depths[fixed_literal_codes] = {};
+    for (size_t i = 0; i < used; i++) {
+        depths[i] = entries[i].frequency;
+    }
+    int n = static_cast<int>(used);
+    depths[0] += depths[1];
+    int root = 0;
+    int leaf = 2;
+    for (int next = 1; next < n - 1; next++) {
+        if (leaf >= n || depths[root] < depths[leaf]) {
+            depths[next] = depths[root];
+            depths[root++] = next;
+        } else {
+            depths[next] = depths[leaf++];
+        }
+
+        if (leaf >= n || (root < next && depths[root] < depths[leaf])) {
+            depths[next] += depths[root];
+            depths[root++] = next;
+        } else {
+            depths[next] += depths[leaf++];
+        }
+    }
+    depths[n - 2] = 0;
+    for (int next = n - 3; next >= 0; next--) {
+        depths[next] = depths[depths[next]] + 1;
+    }
+    int available = 1;
+    int used_nodes = 0;
+    uint32_t depth = 0;
+    root = n - 2;
+    int next = n - 1;
+    while (available > 0) {
+        while (root >= 0 && depths[root] == depth) {
+            used_nodes++;
+            root--;
+        }
+        while (available > used_nodes) {
+            depths[next--] = depth;
+            available--;
+        }
+        available = 2 * used_nodes;
+        depth++;
+        used_nodes = 0;
+    }
+
+    // Limit the code lengths by moving the overlong codes up to the maximum length, and then lengthening shorter codes
+    // until the code is complete again.
+    uint32_t length_counts[32] = {};
+    for (size_t i = 0; i < used; i++) {
+        length_counts[min(depths[i], 31U)]++;
+    }
+    for (size_t i = max_length + 1; i < 32; i++) {
+        length_counts[max_length] += length_counts[i];
+        length_counts[i] = 0;
+    }
+    uint32_t total = 0;
+    for (size_t i = 1; i <= max_length; i++) {
+        total += length_counts[i] << (max_length - i);
+    }
+    while (total > (1U << max_length)) {
+        length_counts[max_length]--;
+        for (size_t i = max_length - 1; i > 0; i--) {
+            if (length_counts[i]) {
+                length_counts[i]--;
+                length_counts[i + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // The least frequent symbols get the longest codes.
+    size_t index = 0;
+    for (size_t length = max_length; length > 0; length--) {
+        for (uint32_t i = 0; i < length_counts[length]; i++) {
+            lengths[entries[index++].symbol] = length;
+        }
+    }
+}
+
+struct DeflateEncoderState {
+    size_t lookahead() const { return window_fill - position; }
+
+    void set_dictionary(Span<const uint8_t> dictionary);
+    void fill_window(ByteReader& reader);
+    void slide_window();
+    size_t insert_string(size_t index);
+    size_t longest_match(size_t chain_start, size_t best_length, const CompressionLevel& config);
+
+    bool tally_literal(uint8_t byte);
+    bool tally_match(size_t distance, size_t length);
+
+    bool compress(int level, bool flushing);
+    bool compress_stored(bool flushing);
+    bool compress_greedy(const CompressionLevel& config, bool flushing);
+    bool compress_lazy(const CompressionLevel& config, bool flushing);
+    void finish_pending_match();
+
+    void put_byte(uint8_t byte);
+    void put_bits(uint32_t bits, uint8_t count);
+    void align_to_byte();
+
+    size_t block_length() const { return position - match_available - block_start; }
+    void emit_block(int level, bool last);
+    void emit_symbols(const uint8_t* literal_lengths, const uint16_t* literal_codes, const uint8_t* distance_lengths,
+                      const uint16_t* distance_codes);
+    void emit_sync_marker();
+
+    // The window holds the last 32 KiB of input, which matches can refer back to, followed by the input which has not
+    // been compressed yet. The padding lets the match search compare past the end of the input.
+    uint8_t window[2 * window_size + max_match];
+    // The most recent position with a given hash, and for each position, the previous one with the same hash. Zero
+    // means there is none, which means that matches are never found at the very start of the window.
+    uint16_t head[hash_size];
+    uint16_t prev[window_size];
+    size_t window_fill { 0 };
+    size_t position { 0 };
+    // Where the current block starts in the window, which is negative once it has been slid out.
+    ssize_t block_start { 0 };
+
+    // The block's literals and matches. A distance of 0 means a literal, and otherwise the value is the match length
+    // minus min_match.
+    uint16_t symbol_distances[max_block_symbols];
+    uint8_t symbol_values[max_block_symbols];
+    size_t symbol_count { 0 };
+
+    // State of lazy matching, which is kept between calls.
+    size_t match_length { min_match - 1 };
+    size_t match_start { 0 };
+    size_t previous_length { min_match - 1 };
+    size_t previous_match { 0 };
+    bool match_available { false };
+
+    ByteBuffer output;
+    uint64_t bit_buffer { 0 };
+    uint8_t bit_count { 0 };
+};
+
+void DeflateEncoderState::set_dictionary(Span<const uint8_t> dictionary) {
+    assert(window_fill == 0);
+    size_t size = min(dictionary.size(), max_distance);
+    memcpy(window, dictionary.data() + dictionary.size() - size, size);
+    window_fill = size;
+    position = size;
+    block_start = size;
+    for (size_t i = 0; i + min_match <= size; i++) {
+        insert_string(i);
+    }
+}
+
+void DeflateEncoderState::fill_window(ByteReader& reader) {
+    if (position >= window_size + max_distance) {
+        slide_window();
+    }
+
+    size_t count = min(2 * window_size - window_fill, reader.bytes_remaining());
+    memcpy(window + window_fill, reader.data() + reader.byte_offset(), count);
+    reader.advance(count);
+    window_fill += count;
+}
+
+void DeflateEncoderState::slide_window() {
+    memcpy(window, window + window_size, window_size);
+    window_fill -= window_size;
+    position -= window_size;
+    block_start -= window_size;
+    match_start = match_start >= window_size ? match_start - window_size : 0;
+    previous_match = previous_match >= window_size ? previous_match - window_size : 0;
+
+    for (auto& entry : head) {
+        entry = entry >= window_size ? entry - window_size : 0;
+    }
+    for (auto& entry : prev) {
+        entry = entry >= window_size ? entry - window_size : 0;
+    }
+}
+
+// Adds the string at index to the hash chains, and returns the previous position with the same hash. There must be
+// at least min_match bytes at index.
+size_t DeflateEncoderState::insert_string(size_t index) {
+    uint32_t key = window[index] | (window[index + 1] << 8) | (window[index + 2] << 16);
+    uint32_t hash = (key * 2654435761U) >> (32 - hash_bits);
+    size_t chain_start = head[hash];
+    prev[index & window_mask] = chain_start;
+    head[hash] = index;
+    return chain_start;
+}
+
+// Searches the hash chain for the longest match at the current position which is longer than best_length, and sets
+// match_start to where it begins.
+size_t DeflateEncoderState::longest_match(size_t chain_start, size_t best_length, const CompressionLevel& config) {
+    size_t chain_length = config.max_chain;
+    if (best_length >= config.good_length) {
+        chain_length >>= 2;
+    }
+
+    size_t max_length = min(max_match, lookahead());
+    size_t nice_length = min<size_t>(config.nice_length, max_length);
+    size_t limit = position > max_distance ? position - max_distance : 0;
+    const uint8_t* scan = window + position;
+
+    size_t candidate = chain_start;
+    do {
+        const uint8_t* match = window + candidate;
+        if (match[best_length] != scan[best_length] || match[best_length - 1] != scan[best_length - 1] || match[0] != scan[0] ||
+            match[1] != scan[1]) {
+            continue;
+        }
+
+        size_t length = 2;
+        while (length < max_length && match[length] == scan[length]) {
+            length++;
+        }
+
+        if (length > best_length) {
+            match_start = candidate;
+            best_length = length;
+            if (length >= nice_length) {
+                break;
+            }
+        }
+    } while ((candidate = prev[candidate & window_mask]) > limit && --chain_length != 0);
+
+    return min(best_length, lookahead());
+}
+
+bool DeflateEncoderState::tally_literal(uint8_t byte) {
+    symbol_distances[symbol_count] = 0;
+    symbol_values[symbol_count] = byte;
+    return ++symbol_count == max_block_symbols;
+}
+
+bool DeflateEncoderState::tally_match(size_t distance, size_t length) {
+    symbol_distances[symbol_count] = distance;
+    symbol_values[symbol_count] = length - min_match;
+    return ++symbol_count == max_block_symbols;
+}
+
+// Compresses the buffered input until the block is full, in which case this returns true, or until there is too little
+// lookahead left to continue. When flushing, all of the input is compressed.
+bool DeflateEncoderState::compress(int level, bool flushing) {
+    auto& config = compression_levels[level];
+    if (level == 0) {
+        return compress_stored(flushing);
+    }
+    if (config.lazy) {
+        return compress_lazy(config, flushing);
+    }
+    return compress_greedy(config, flushing);
+}
+
+bool DeflateEncoderState::compress_stored(bool flushing) {
+    // Stored blocks copy their data out of the window, so they are ended before it would be slid out.
+    size_t end = flushing ? window_fill : window_fill - min(window_fill, min_lookahead);
+    position = max(position, min(end, block_start + max_distance));
+    return block_length() >= max_distance;
+}
+
+bool DeflateEncoderState::compress_greedy(const CompressionLevel& config, bool flushing) {
     for (;;) {
-        uint16_t byte_count = INT16_MAX;
-        uint16_t byte_count_complement = 0;
+        size_t available = lookahead();
+        if (available == 0 || (available < min_lookahead && !flushing)) {
+            return false;
+        }
 
-        bool last_block = false;
-        if (reader().bytes_remaining() <= INT16_MAX) {
-            byte_count = reader().bytes_remaining();
-            byte_count_complement = ~byte_count;
-            last_block = flush_mode() == StreamFlushMode::StreamFlush;
+        size_t chain_start = available >= min_match ? insert_string(position) : 0;
+        size_t length = 0;
+        if (chain_start && position - chain_start <= max_distance) {
+            length = longest_match(chain_start, min_match - 1, config);
         }
 
-        co_yield write_bits(last_block, 1);
-        co_yield write_bits(0b00, 2);
+        if (length < min_match) {
+            bool full = tally_literal(window[position++]);
+            if (full) {
+                return true;
+            }
+            continue;
+        }
 
-        uint16_t header[2] = { byte_count, byte_count_complement };
-        co_yield write_bytes(array_as_readonly_bytes(header, sizeof(header) / sizeof(header[0])));
+        bool full = tally_match(position - match_start, length);
+        if (length <= config.max_lazy) {
+            for (size_t i = 1; i < length && position + i + min_match <= window_fill; i++) {
+                insert_string(position + i);
+            }
+        }
+        position += length;
+        if (full) {
+            return true;
+        }
+    }
+}
+
+// Only emits a match if the match starting at the next position is not longer, in which case the current position is
+// emitted as a literal instead.
+bool DeflateEncoderState::compress_lazy(const CompressionLevel& config, bool flushing) {
+    for (;;) {
+        size_t available = lookahead();
+        if (available == 0 || (available < min_lookahead && !flushing)) {
+            return false;
+        }
 
-        co_yield write_bytes({ reader().data() + reader().byte_offset(), byte_count });
-        reader().set_byte_offset({ reader().byte_offset() + byte_count });
+        size_t chain_start = available >= min_match ? insert_string(position) : 0;
+        previous_length = match_length;
+        previous_match = match_start;
+        match_length = min_match - 1;
 
-        if (last_block) {
+        if (chain_start && previous_length < config.max_lazy && position - chain_start <= max_distance) {
+            match_length = longest_match(chain_start, previous_length, config);
+            if (match_length == min_match && position - match_start > too_far) {
+                match_length = min_match - 1;
+            }
+        }
+
+        if (previous_length >= min_match && match_length <= previous_length) {
+            bool full = tally_match(position - 1 - previous_match, previous_length);
+            for (size_t i = 1; i < previous_length - 1 && position + i + min_match <= window_fill; i++) {
+                insert_string(position + i);
+            }
+            position += previous_length - 1;
+            match_available = false;
+            match_length = min_match - 1;
+            if (full) {
+                return true;
+            }
+        } else if (match_available) {
+            bool full = tally_literal(window[position - 1]);
+            position++;
+            if (full) {
+                return true;
+            }
+        } else {
+            match_available = true;
+            position++;
+        }
+    }
+}
+
+void DeflateEncoderState::finish_pending_match() {
+    if (match_available) {
+        tally_literal(window[position - 1]);
+        match_available = false;
+    }
+    match_length = min_match - 1;
+}
+
+void DeflateEncoderState::put_byte(uint8_t byte) {
+    if (output.size() == output.capacity()) {
+        output.ensure_capacity(max<size_t>(output.capacity() * 2, 4096));
+    }
+    output.data()[output.size()] = byte;
+    output.set_size(output.size() + 1);
+}
+
+void DeflateEncoderState::put_bits(uint32_t bits, uint8_t count) {
+    bit_buffer |= static_cast<uint64_t>(bits) << bit_count;
+    bit_count += count;
+    while (bit_count >= 8) {
+        put_byte(bit_buffer & 0xFF);
+        bit_buffer >>= 8;
+        bit_count -= 8;
+    }
+}
+
+void DeflateEncoderState::align_to_byte() {
+    if (bit_count > 0) {
+        put_byte(bit_buffer & 0xFF);
+    }
+    bit_buffer = 0;
+    bit_count = 0;
+}
+
+void DeflateEncoderState::emit_symbols(const uint8_t* literal_lengths, const uint16_t* literal_codes, const uint8_t* distance_lengths,
+                                       const uint16_t* distance_codes) {
+    for (size_t i = 0; i < symbol_count; i++) {
+        size_t distance = symbol_distances[i];
+        uint8_t value = symbol_values[i];
+        if (!distance) {
+            put_bits(literal_codes[value], literal_lengths[value]);
+            continue;
+        }
+
+        auto length_code = length_code_table[value];
+        auto symbol = DeflateDecoder::hlit_offset + length_code;
+        put_bits(literal_codes[symbol], literal_lengths[symbol]);
+        auto length_descriptor = compressed_length_codes[length_code];
+        if (length_descriptor.extra_bits) {
+            put_bits(value + min_match - length_descriptor.offset, length_descriptor.extra_bits);
+        }
+
+        auto code = distance_code(distance);
+        put_bits(distance_codes[code], distance_lengths[code]);
+        auto distance_descriptor = compressed_distance_codes[code];
+        if (distance_descriptor.extra_bits) {
+            put_bits(distance - distance_descriptor.offset, distance_descriptor.extra_bits);
+        }
+    }
+    put_bits(literal_codes[block_end_marker], literal_lengths[block_end_marker]);
+}
+
+// Emits the current block using whichever of the stored, fixed and dynamic encodings is smallest.
+void DeflateEncoderState::emit_block(int level, bool last) {
+    uint32_t literal_frequencies[fixed_literal_codes] = {};
+    uint32_t distance_frequencies[distance_codes] = {};
+    size_t extra_bits = 0;
+    for (size_t i = 0; i < symbol_count; i++) {
+        if (!symbol_distances[i]) {
+            literal_frequencies[symbol_values[i]]++;
+            continue;
+        }
+
+        auto length_code = length_code_table[symbol_values[i]];
+        literal_frequencies[DeflateDecoder::hlit_offset + length_code]++;
+        auto code = distance_code(symbol_distances[i]);
+        distance_frequencies[code]++;
+        extra_bits += compressed_length_codes[length_code].extra_bits + compressed_distance_codes[code].extra_bits;
+    }
+    literal_frequencies[block_end_marker] = 1;
+
+    uint8_t fixed_literal_lengths[fixed_literal_codes];
+    for (size_t i = 0; i < fixed_literal_codes; i++) {
+        fixed_literal_lengths[i] = i <= 143 ? 8 : i <= 255 ? 9 : i <= 279 ? 7 : 8;
+    }
+    uint8_t fixed_distance_lengths[distance_codes];
+    for (auto& length : fixed_distance_lengths) {
+        length = 5;
+    }
+
+    // Both Huffman code lengths are written as a single run length encoded sequence, using the code length alphabet.
+    uint8_t lengths[literal_codes + distance_codes];
+    build_code_lengths(literal_frequencies, literal_codes, lengths, DeflateDecoder::max_bits);
+    build_code_lengths(distance_frequencies, distance_codes, lengths + literal_codes, DeflateDecoder::max_bits);
+
+    size_t hlit = literal_codes;
+    while (hlit > DeflateDecoder::hlit_offset && !lengths[hlit - 1]) {
+        hlit--;
+    }
+    size_t hdist = distance_codes;
+    while (hdist > DeflateDecoder::hdist_offset && !lengths[literal_codes + hdist - 1]) {
+        hdist--;
+    }
+
+    uint8_t sequence[literal_codes + distance_codes];
+    memcpy(sequence, lengths, hlit);
+    memcpy(sequence + hlit, lengths + literal_codes, hdist);
+    size_t sequence_length = hlit + hdist;
+
+    struct CodeLength {
+        uint8_t symbol;
+        uint8_t extra;
+    };
+    CodeLength code_lengths[literal_codes + distance_codes];
+    size_t code_length_count = 0;
+    uint32_t code_length_frequencies[code_length_codes] = {};
+    auto add_code_length = [&](uint8_t symbol, uint8_t extra) {
+        code_lengths[code_length_count++] = { symbol, extra };
+        code_length_frequencies[symbol]++;
+    };
+    for (size_t i = 0; i < sequence_length;) {
+        uint8_t length = sequence[i];
+        size_t run = 1;
+        while (i + run < sequence_length && sequence[i + run] == length) {
+            run++;
+        }
+        i += run;
+
+        if (length == 0) {
+            while (run >= 11) {
+                size_t count = min<size_t>(run, 138);
+                add_code_length(18, count - 11);
+                run -= count;
+            }
+            if (run >= 3) {
+                add_code_length(17, run - 3);
+                run = 0;
+            }
+        } else {
+            add_code_length(length, 0);
+            run--;
+            while (run >= 3) {
+                size_t count = min<size_t>(run, 6);
+                add_code_length(16, count - 3);
+                run -= count;
+            }
+        }
+        for (; run > 0; run--) {
+            add_code_length(length, 0);
+        }
+    }
+
+    uint8_t code_length_lengths[code_length_codes];
+    build_code_lengths(code_length_frequencies, code_length_codes, code_length_lengths, max_code_length_bits);
+    size_t hclen = code_length_codes;
+    while (hclen > DeflateDecoder::hclen_offset && !code_length_lengths[code_length_alphabet_order_mapping[hclen - 1]]) {
+        hclen--;
+    }
+
+    auto data_bits = [&](const uint8_t* literal_lengths, const uint8_t* distance_lengths) {
+        size_t bits = extra_bits;
+        for (size_t i = 0; i < literal_codes; i++) {
+            bits += literal_frequencies[i] * literal_lengths[i];
+        }
+        for (size_t i = 0; i < distance_codes; i++) {
+            bits += distance_frequencies[i] * distance_lengths[i];
+        }
+        return bits;
+    };
+
+    size_t dynamic_bits = 3 + 5 + 5 + 4 + 3 * hclen + data_bits(lengths, lengths + literal_codes);
+    for (size_t i = 0; i < code_length_count; i++) {
+        auto symbol = code_lengths[i].symbol;
+        dynamic_bits += code_length_lengths[symbol] + (symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0);
+    }
+    size_t fixed_bits = 3 + data_bits(fixed_literal_lengths, fixed_distance_lengths);
+
+    size_t length = block_length();
+    bool can_store = block_start >= 0 && length <= UINT16_MAX;
+    size_t stored_bits = can_store ? 3 + 7 + 32 + 8 * length : SIZE_MAX;
+
+    if (level == 0 || (can_store && stored_bits <= min(fixed_bits, dynamic_bits))) {
+        put_bits(last, 1);
+        put_bits(CompressionType::None, 2);
+        align_to_byte();
+        put_bits(length, 16);
+        put_bits(static_cast<uint16_t>(~length), 16);
+        output.append({ window + block_start, length });
+    } else if (fixed_bits <= dynamic_bits) {
+        uint16_t fixed_literal_codes_table[fixed_literal_codes];
+        build_codes(fixed_literal_lengths, fixed_literal_codes, fixed_literal_codes_table);
+        uint16_t fixed_distance_codes_table[distance_codes];
+        build_codes(fixed_distance_lengths, distance_codes, fixed_distance_codes_table);
+
+        put_bits(last, 1);
+        put_bits(CompressionType::Fixed, 2);
+        emit_symbols(fixed_literal_lengths, fixed_literal_codes_table, fixed_distance_lengths, fixed_distance_codes_table);
+    } else {
+        uint16_t literal_codes_table[literal_codes];
+        build_codes(lengths, literal_codes, literal_codes_table);
+        uint16_t distance_codes_table[distance_codes];
+        build_codes(lengths + literal_codes, distance_codes, distance_codes_table);
+        uint16_t code_length_codes_table[code_length_codes];
+        build_codes(code_length_lengths, code_length_codes, code_length_codes_table);
+
+        put_bits(last, 1);
+        put_bits(CompressionType::Dynamic, 2);
+        put_bits(hlit - DeflateDecoder::hlit_offset, 5);
+        put_bits(hdist - DeflateDecoder::hdist_offset, 5);
+        put_bits(hclen - DeflateDecoder::hclen_offset, 4);
+        for (size_t i = 0; i < hclen; i++) {
+            put_bits(code_length_lengths[code_length_alphabet_order_mapping[i]], 3);
+        }
+        for (size_t i = 0; i < code_length_count; i++) {
+            auto symbol = code_lengths[i].symbol;
+            put_bits(code_length_codes_table[symbol], code_length_lengths[symbol]);
+            if (symbol >= 16) {
+                put_bits(code_lengths[i].extra, symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+            }
+        }
+        emit_symbols(lengths, literal_codes_table, lengths + literal_codes, distance_codes_table);
+    }
+
+    symbol_count = 0;
+    block_start = position - match_available;
+}
+
+// An empty stored block, which byte aligns the output so that everything written so far can be decoded.
+void DeflateEncoderState::emit_sync_marker() {
+    put_bits(0, 1);
+    put_bits(CompressionType::None, 2);
+    align_to_byte();
+    put_bits(0, 16);
+    put_bits(0xFFFF, 16);
+}
+
+DeflateEncoder::DeflateEncoder(int level) : StreamEncoder(encode()), m_state(make_unique<DeflateEncoderState>()), m_level(level) {
+    assert(level >= min_level && level <= max_level);
+}
+
+DeflateEncoder::~DeflateEncoder() {}
+
+void DeflateEncoder::set_dictionary(Span<const uint8_t> dictionary) {
+    m_state->set_dictionary(dictionary);
+}
+
+Generator<StreamResult> DeflateEncoder::write_pending_output() {
+    co_yield write_bytes({ m_state->output.data(), m_state->output.size() });
+    m_state->output.set_size(0);
+}
+
+Generator<StreamResult> DeflateEncoder::encode() {
+    auto& state = *m_state;
+    for (;;) {
+        // Input is only compressed once enough of it is buffered to find long matches, unless the caller is flushing.
+        for (;;) {
+            state.fill_window(reader());
+            bool flushing = flush_mode() != StreamFlushMode::NoFlush && reader().finished();
+            if (state.compress(m_level, flushing)) {
+                state.emit_block(m_level, false);
+                co_yield write_pending_output();
+                continue;
+            }
+
+            if (reader().finished()) {
+                break;
+            }
+        }
+
+        if (flush_mode() == StreamFlushMode::NoFlush) {
+            co_yield StreamResult::NeedsMoreInput;
+            continue;
+        }
+
+        state.finish_pending_match();
+        if (flush_mode() == StreamFlushMode::StreamFlush) {
+            state.emit_block(m_level, true);
+            state.align_to_byte();
+            co_yield write_pending_output();
             co_yield StreamResult::Success;
             co_return;
         }
 
+        if (state.symbol_count || state.block_length()) {
+            state.emit_block(m_level, false);
+        }
+        state.emit_sync_marker();
+        co_yield write_pending_output();
         co_yield StreamResult::NeedsMoreInput;
     }
 }
@@ -98,8 +98,9 @@ bool File::write(StringView view) {
 
 bool File::read_all_streamed(ByteBuffer& buffer, Function<bool(const ByteBuffer&)> callback) {
     for (;;) {
+        // Reading nothing at the end of the file is not an error, and the callback is still told about it.
         bool read_result = read(buffer);
-        if (!read_result) {
+        if (!read_result && m_error) {
             return false;
         }
 
@@ -28,123 +28,143 @@ enum GZipFlags {
     FCOMMENT = 16,
 };
 
+ByteBuffer encode_gzip_header(const GZipData& data) {
+    uint8_t flags = (data.comment.has_value() ? GZipFlags::FCOMMENT : 0) | (data.name.has_value() ? GZipFlags::FNAME : 0);
+    GZipHeader header = {
+        .id1 = GZIP_ID1,
+        .id2 = GZIP_ID2,
+        .compression_method = GZIP_COMPRESSION_METHOD_DEFLATE,
+        .flags = flags,
+        .time_last_modified = (uint32_t) data.time_last_modified,
+        .extra_flags = 0,
+        .os_field = GZIP_OS_UNIX,
+    };
+
+    ByteBuffer buffer;
+    buffer.append(as_readonly_bytes(header));
+
+    if (flags & GZipFlags::FNAME) {
+        buffer.append({ (const uint8_t*) data.name.value().string(), data.name.value().size() + 1 });
+    }
+
+    if (flags & GZipFlags::FCOMMENT) {
+        buffer.append({ (const uint8_t*) data.comment.value().string(), data.comment.value().size() + 1 });
+    }
+    return buffer;
+}
+
+ByteBuffer encode_gzip_trailer(uint32_t crc32, size_t total_size) {
+    // The size is only stored modulo 2^32.
+    uint32_t trailer[2] = { crc32, static_cast<uint32_t>(total_size) };
+    ByteBuffer buffer;
+    buffer.append(array_as_readonly_bytes(trailer, 2));
+    return buffer;
+}
+
 GZipDecoder::GZipDecoder() : StreamDecoder(decode()) {}
 
 GZipDecoder::~GZipDecoder() {}
 
 Generator<StreamResult> GZipDecoder::decode() {
-    GZipHeader header;
-    co_yield read_bytes(as_writable_bytes(header));
+    for (;;) {
+        m_member_data = {};
+        m_deflate_decoder = make_unique<DeflateDecoder>();
 
-    if (header.id1 != GZIP_ID1 || header.id2 != GZIP_ID2 || header.compression_method != GZIP_COMPRESSION_METHOD_DEFLATE) {
-        co_yield StreamResult::Error;
-        co_return;
-    }
+        GZipHeader header;
+        co_yield read_bytes(as_writable_bytes(header));
 
-    m_member_data.time_last_modified = header.time_last_modified;
+        if (header.id1 != GZIP_ID1 || header.id2 != GZIP_ID2 || header.compression_method != GZIP_COMPRESSION_METHOD_DEFLATE) {
+            co_yield StreamResult::Error;
+            co_return;
+        }
 
-    if (header.flags & GZipFlags::FEXTRA) {
-        uint16_t extra_data_length;
-        co_yield read_bytes(as_writable_bytes(extra_data_length));
+        m_member_data.time_last_modified = header.time_last_modified;
 
-        ByteBuffer extra_data_buffer(extra_data_length);
-        extra_data_buffer.set_size(extra_data_length);
-        co_yield read_bytes(extra_data_buffer.span());
-        m_member_data.extra_data = move(extra_data_buffer);
-    }
+        if (header.flags & GZipFlags::FEXTRA) {
+            uint16_t extra_data_length;
+            co_yield read_bytes(as_writable_bytes(extra_data_length));
 
-    if (header.flags & GZipFlags::FNAME) {
-        String name;
-        co_yield read_null_terminated_string(name);
-        m_member_data.name = move(name);
-    }
+            ByteBuffer extra_data_buffer(extra_data_length);
+            extra_data_buffer.set_size(extra_data_length);
+            co_yield read_bytes(extra_data_buffer.span());
+            m_member_data.extra_data = move(extra_data_buffer);
+        }
 
-    if (header.flags & GZipFlags::FCOMMENT) {
-        String comment;
-        co_yield read_null_terminated_string(comment);
-        m_member_data.comment = move(comment);
-    }
+        if (header.flags & GZipFlags::FNAME) {
+            String name;
+            co_yield read_null_terminated_string(name);
+            m_member_data.name = move(name);
+        }
 
-    if (header.flags & GZipFlags::FHCRC) {
-        uint16_t header_crc16;
-        co_yield read_bytes(as_writable_bytes(header_crc16));
-        (void) header_crc16;
-    }
+        if (header.flags & GZipFlags::FCOMMENT) {
+            String comment;
+            co_yield read_null_terminated_string(comment);
+            m_member_data.comment = move(comment);
+        }
 
-    uint32_t computed_crc32 = CHECKSUM_CRC32_INIT;
-    uint32_t computed_total_size = 0;
-    for (;;) {
-        bool resume = false;
+        if (header.flags & GZipFlags::FHCRC) {
+            uint16_t header_crc16;
+            co_yield read_bytes(as_writable_bytes(header_crc16));
+            (void) header_crc16;
+        }
+
+        uint32_t computed_crc32 = CHECKSUM_CRC32_INIT;
+        uint32_t computed_total_size = 0;
         for (;;) {
-            m_deflate_decoder.set_output(writer().span_available());
-            auto result = resume ? m_deflate_decoder.resume() : m_deflate_decoder.stream_data(reader().span_remaining());
-            writer().advance(m_deflate_decoder.writer().bytes_written());
-            if (result == StreamResult::Error) {
-                co_yield result;
-                co_return;
-            }
+            bool resume = false;
+            for (;;) {
+                m_deflate_decoder->set_output(writer().span_available());
+                auto result = resume ? m_deflate_decoder->resume() : m_deflate_decoder->stream_data(reader().span_remaining());
+                writer().advance(m_deflate_decoder->writer().bytes_written());
+                if (result == StreamResult::Error) {
+                    co_yield result;
+                    co_return;
+                }
 
-            auto bytes_written = m_deflate_decoder.writer().bytes_written();
-            computed_total_size += bytes_written;
-            computed_crc32 = compute_partial_crc32_checksum(m_deflate_decoder.writer().data(), bytes_written, computed_crc32);
+                auto bytes_written = m_deflate_decoder->writer().bytes_written();
+                computed_total_size += bytes_written;
+                computed_crc32 = compute_partial_crc32_checksum(m_deflate_decoder->writer().data(), bytes_written, computed_crc32);
 
-            reader().advance(m_deflate_decoder.reader().byte_offset());
+                reader().advance(m_deflate_decoder->reader().byte_offset());
 
-            if (result == StreamResult::NeedsMoreInput) {
-                co_yield result;
-                break;
-            }
+                if (result == StreamResult::NeedsMoreInput) {
+                    co_yield result;
+                    break;
+                }
 
-            if (result == StreamResult::NeedsMoreOutputSpace) {
-                co_yield result;
-                resume = true;
-                m_deflate_decoder.reader().set_data(m_deflate_decoder.reader().span_remaining());
-                continue;
+                if (result == StreamResult::NeedsMoreOutputSpace) {
+                    co_yield result;
+                    resume = true;
+                    m_deflate_decoder->reader().set_data(m_deflate_decoder->reader().span_remaining());
+                    continue;
+                }
+                goto finished;
             }
-            goto finished;
         }
-    }
 
-finished:
-    uint32_t expected_crc32;
-    co_yield read_bytes(as_writable_bytes(expected_crc32));
+    finished:
+        uint32_t expected_crc32;
+        co_yield read_bytes(as_writable_bytes(expected_crc32));
 
-    uint32_t expected_total_size;
-    co_yield read_bytes(as_writable_bytes(expected_total_size));
+        uint32_t expected_total_size;
+        co_yield read_bytes(as_writable_bytes(expected_total_size));
 
-    if (expected_crc32 != computed_crc32 || expected_total_size != computed_total_size) {
-        co_yield StreamResult::Error;
-        co_return;
-    }
+        if (expected_crc32 != computed_crc32 || expected_total_size != computed_total_size) {
+            co_yield StreamResult::Error;
+            co_return;
+        }
 
-    co_yield StreamResult::Success;
+        co_yield StreamResult::Success;
+    }
 }
 
-GZipEncoder::GZipEncoder() : StreamEncoder(encode()) {}
+GZipEncoder::GZipEncoder(int level) : StreamEncoder(encode()), m_deflate_encoder(level) {}
 
 GZipEncoder::~GZipEncoder() {}
 
 Generator<StreamResult> GZipEncoder::encode() {
-    uint8_t flags = (m_gzip_data.comment.has_value() ? GZipFlags::FCOMMENT : 0) | (m_gzip_data.name.has_value() ? GZipFlags::FNAME : 0);
-    GZipHeader header = {
-        .id1 = GZIP_ID1,
-        .id2 = GZIP_ID2,
-        .compression_method = GZIP_COMPRESSION_METHOD_DEFLATE,
-        .flags = flags,
-        .time_last_modified = (uint32_t) m_gzip_data.time_last_modified,
-        .extra_flags = 0,
-        .os_field = GZIP_OS_UNIX,
-    };
-
-    co_yield write_bytes(as_readonly_bytes(header));
-
-    if (flags & GZipFlags::FNAME) {
-        co_yield write_bytes({ (const uint8_t*) m_gzip_data.name.value().string(), m_gzip_data.name.value().size() + 1 });
-    }
-
-    if (flags & GZipFlags::FCOMMENT) {
-        co_yield write_bytes({ (const uint8_t*) m_gzip_data.comment.value().string(), m_gzip_data.comment.value().size() + 1 });
-    }
+    auto header = encode_gzip_header(m_gzip_data);
+    co_yield write_bytes(header.span());
 
     uint32_t crc32 = 0;
     uint32_t total_size = 0;
@@ -177,8 +197,8 @@ Generator<StreamResult> GZipEncoder::encode() {
     }
 
 finish:
-    co_yield write_bytes(as_readonly_bytes(crc32));
-    co_yield write_bytes(as_readonly_bytes(total_size));
+    auto trailer = encode_gzip_trailer(crc32, total_size);
+    co_yield write_bytes(trailer.span());
 
     co_yield StreamResult::Success;
 }
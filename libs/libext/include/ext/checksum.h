@@ -14,9 +14,13 @@ extern "C" {
 
 uint32_t compute_partial_crc32_checksum(const void *data, size_t num_bytes, uint32_t crc);
 uint32_t compute_crc32_checksum(const void *data, size_t num_bytes);
+// Returns the CRC32 of two pieces of data, given the CRC32 of each and the length of the second.
+uint32_t combine_crc32_checksums(uint32_t first_crc, uint32_t second_crc, size_t second_length);
 
 uint32_t compute_partial_adler32_checksum(const void *data, size_t num_bytes, uint32_t adler);
 uint32_t compute_adler32_checksum(const void *data, size_t num_bytes);
+// Returns the Adler32 of two pieces of data, given the Adler32 of each and the length of the second.
+uint32_t combine_adler32_checksums(uint32_t first_adler, uint32_t second_adler, size_t second_length);
 
 uint16_t compute_partial_internet_checksum(const void *packet, size_t num_bytes, uint16_t start);
 uint16_t compute_internet_checksum(const void *data, size_t bytes);
@@ -7,33 +7,50 @@
 #include <liim/fixed_array.h>
 #include <liim/generator.h>
 #include <liim/option.h>
-#include <liim/ring_buffer.h>
+#include <liim/pointers.h>
 #include <liim/string.h>
 #include <liim/vector.h>
 #include <stdint.h>
 #include <sys/types.h>
 
 namespace Ext {
-struct Symbol {
-    uint16_t symbol;
-    uint16_t encoded_length;
-    uint16_t code;
-};
+// An entry of a Huffman decoding table, which is indexed by the next bits of input. Codes which are longer than the
+// table's index point to a second level table, which is indexed by the bits after it.
+class HuffmanEntry {
+public:
+    enum Type : uint8_t {
+        Literal,
+        // The value is the base of a length or distance, which is followed by extra bits.
+        Base,
+        EndOfBlock,
+        // The value is the index of the second level table, which is indexed by extra_bits() more bits.
+        Subtable,
+        Invalid,
+    };
 
-struct TreeNode {
-    constexpr bool is_symbol() const { return m_left & 0x8000U; }
-    constexpr bool is_initialized() const { return m_right & 0x8000U; }
+    constexpr HuffmanEntry() {}
+    constexpr HuffmanEntry(Type type, uint16_t value, uint8_t extra_bits = 0, uint8_t bits = 0)
+        : m_value(value), m_bits(bits), m_type_and_extra_bits((type << 4) | extra_bits) {}
 
-    constexpr uint16_t left() const { return m_left & 0x7FFFU; }
-    constexpr uint16_t right() const { return m_right & 0x7FFFU; }
+    constexpr Type type() const { return static_cast<Type>(m_type_and_extra_bits >> 4); }
+    constexpr uint8_t extra_bits() const { return m_type_and_extra_bits & 0xFU; }
+    constexpr uint16_t value() const { return m_value; }
+    // The number of bits of input this entry consumes.
+    constexpr uint8_t bits() const { return m_bits; }
 
-    constexpr uint16_t symbol() const { return left(); }
+    constexpr HuffmanEntry with_bits(uint8_t bits) const {
+        auto entry = *this;
+        entry.m_bits = bits;
+        return entry;
+    }
 
-    uint16_t m_left;
-    uint16_t m_right;
+private:
+    uint16_t m_value { 0 };
+    uint8_t m_bits { 0 };
+    uint8_t m_type_and_extra_bits { Invalid << 4 };
 };
 
-static_assert(sizeof(TreeNode) == 4);
+static_assert(sizeof(HuffmanEntry) == 4);
 
 class DeflateDecoder final : public StreamDecoder {
 public:
@@ -45,34 +62,79 @@ public:
     static constexpr size_t hclen_offset = 4;
     static constexpr size_t hclen_max = 19;
 
+    static constexpr size_t window_size = 32768;
+
+    // The first level tables are indexed by this many bits, and the table sizes are the most that complete codes over
+    // each alphabet can need (see zlib's enough.c).
+    static constexpr uint8_t literal_root_bits = 9;
+    static constexpr uint8_t distance_root_bits = 6;
+    static constexpr uint8_t code_length_root_bits = 7;
+    static constexpr size_t literal_table_size = 852;
+    static constexpr size_t distance_table_size = 592;
+    static constexpr size_t code_length_table_size = 1 << code_length_root_bits;
+
     DeflateDecoder();
     virtual ~DeflateDecoder() override;
 
 private:
+    enum class FastPathResult {
+        NeedsSlowPath,
+        EndOfBlock,
+        Error,
+    };
+
     Generator<StreamResult> decode();
 
-    Generator<StreamResult> decode_symbol(const TreeNode* tree, uint16_t& value);
+    Generator<StreamResult> consume_bits(uint32_t& value, uint8_t bit_count);
+    Generator<StreamResult> decode_symbol(const HuffmanEntry* table, uint8_t root_bits, HuffmanEntry& entry);
+    FastPathResult decode_fast();
+    void append_to_window(const uint8_t* data, size_t size);
 
     Generator<StreamResult> decode_no_compression();
     Generator<StreamResult> decode_with_compression();
     Generator<StreamResult> decode_dynamic_symbols();
 
-    RingBuffer<uint8_t, 32768> m_previously_decoded_data;
-    FixedArray<Symbol, hclen_max> m_code_length_symbols;
-    FixedArray<TreeNode, 128> m_length_codes_tree;
-    FixedArray<Symbol, hlit_max + hdist_max> m_literal_and_distance_symbols;
-    FixedArray<TreeNode, 8192> m_dynamic_literal_tree;
-    FixedArray<TreeNode, 512> m_dynamic_distance_tree;
-    const TreeNode* m_literal_tree;
-    const TreeNode* m_distance_tree;
+    // Decoded output, which matches can refer back to. The position is the total number of bytes decoded so far.
+    FixedArray<uint8_t, window_size> m_window;
+    uint64_t m_window_position { 0 };
+
+    // Input which has been read but not yet consumed, starting at the least significant bit. Bits above m_bit_count
+    // are always 0.
+    uint64_t m_bit_buffer { 0 };
+    uint8_t m_bit_count { 0 };
+
+    FixedArray<HuffmanEntry, code_length_table_size> m_code_length_table;
+    FixedArray<HuffmanEntry, literal_table_size> m_dynamic_literal_table;
+    FixedArray<HuffmanEntry, distance_table_size> m_dynamic_distance_table;
+    const HuffmanEntry* m_literal_table { nullptr };
+    const HuffmanEntry* m_distance_table { nullptr };
 };
 
+struct DeflateEncoderState;
+
 class DeflateEncoder final : public StreamEncoder {
 public:
-    DeflateEncoder();
+    // Level 0 only emits stored blocks. Higher levels search longer hash chains and match lazily, trading speed for a
+    // better ratio.
+    static constexpr int min_level = 0;
+    static constexpr int max_level = 9;
+    static constexpr int default_level = 6;
+
+    explicit DeflateEncoder(int level = default_level);
     virtual ~DeflateEncoder() override;
 
+    int level() const { return m_level; }
+
+    // Lets matches refer back into data which the decoder will already have seen, such as the previous piece of input
+    // when pieces are compressed separately. Only the last 32 KiB or so are used. This must be called before any input
+    // is given to the encoder.
+    void set_dictionary(Span<const uint8_t> dictionary);
+
 private:
     Generator<StreamResult> encode();
+    Generator<StreamResult> write_pending_output();
+
+    UniquePtr<DeflateEncoderState> m_state;
+    int m_level;
 };
 }
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <ext/deflate.h>
 
 namespace Ext {
@@ -8,6 +10,12 @@ struct GZipData {
     time_t time_last_modified;
 };
 
+// The header and trailer of a gzip member, for callers which produce the deflate data between them some other way.
+ByteBuffer encode_gzip_header(const GZipData& data);
+ByteBuffer encode_gzip_trailer(uint32_t crc32, size_t total_size);
+
+// A gzip file can hold several members one after another, which decode to their contents concatenated. The decoder
+// reports Success after each member, and if there is more input, resuming it continues with the next member.
 class GZipDecoder final : public StreamDecoder {
 public:
     GZipDecoder();
@@ -18,13 +26,13 @@ public:
 private:
     Generator<StreamResult> decode();
 
-    DeflateDecoder m_deflate_decoder;
+    UniquePtr<DeflateDecoder> m_deflate_decoder;
     GZipData m_member_data;
 };
 
 class GZipEncoder final : public StreamEncoder {
 public:
-    GZipEncoder();
+    explicit GZipEncoder(int level = DeflateEncoder::default_level);
     virtual ~GZipEncoder() override;
 
     void set_name(String name) { m_gzip_data.name = move(name); }
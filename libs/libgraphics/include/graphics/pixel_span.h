@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+// Kernels which operate on a horizontal run of 32 bit ARGB pixels. On x86, SSE2 and AVX2 versions are selected at
+// runtime, and every version produces exactly the same pixels.
+namespace PixelSpan {
+// Sets every pixel in dest to color.
+void fill(uint32_t* dest, uint32_t color, int count);
+
+// Blends src over dest, where dest is treated as opaque (its alpha channel is ignored, and blended pixels are opaque).
+void blend_over_opaque(uint32_t* dest, const uint32_t* src, int count);
+
+// Blends color over every pixel in dest, where dest is treated as opaque.
+void blend_color_over_opaque(uint32_t* dest, uint32_t color, int count);
+}
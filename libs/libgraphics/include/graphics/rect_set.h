@@ -9,6 +9,8 @@ public:
 
     void add(const Rect& rect);
     void subtract(const Rect& rect);
+    void subtract(const RectSet& other);
+    void intersect(const Rect& rect);
 
     Vector<Rect>::Iterator begin() { return m_rects.begin(); }
     Vector<Rect>::Iterator end() { return m_rects.end(); }
@@ -18,6 +20,12 @@ public:
 
     void clear() { m_rects.clear(); }
 
+    bool empty() const { return m_rects.empty(); }
+    int size() const { return m_rects.size(); }
+
+    // The rects in the set never overlap, so this is the number of pixels covered by the set.
+    int area() const;
+
     bool intersects(const Point& point) const;
     bool intersects(const Rect& rect) const;
 
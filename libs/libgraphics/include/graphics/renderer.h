@@ -34,6 +34,8 @@ public:
     const Bitmap& pixels() const { return m_pixels; }
 
     void set_bounding_rect(const Rect& rect);
+    // Unlike set_bounding_rect(), this restricts drawing to rect without translating coordinates.
+    void set_clip_rect(const Rect& rect);
     void set_translation(const Point& point);
 
 private:
@@ -0,0 +1,264 @@
+#include <graphics/pixel_span.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXEL_SPAN_HAVE_CPU_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace PixelSpan {
+// Exact for every x in [0, 255 * 255], which covers any sum of two products of 8 bit channels whose weights add to 255.
+static constexpr uint32_t div_255(uint32_t x) {
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+static constexpr uint32_t blend_pixel_over_opaque(uint32_t foreground, uint32_t background) {
+    auto alpha = foreground >> 24;
+    if (alpha == 0) {
+        return background;
+    }
+    if (alpha == 0xFF) {
+        return foreground;
+    }
+
+    uint32_t result = 0xFF000000U;
+    for (int shift = 0; shift < 24; shift += 8) {
+        auto fg = (foreground >> shift) & 0xFF;
+        auto bg = (background >> shift) & 0xFF;
+        result |= div_255(fg * alpha + bg * (255 - alpha)) << shift;
+    }
+    return result;
+}
+
+static void fill_generic(uint32_t* dest, uint32_t color, int count) {
+    for (int i = 0; i < count; i++) {
+        dest[i] = color;
+    }
+}
+
+static void blend_over_opaque_generic(uint32_t* dest, const uint32_t* src, int count) {
+    for (int i = 0; i < count; i++) {
+        dest[i] = blend_pixel_over_opaque(src[i], dest[i]);
+    }
+}
+
+static void blend_color_over_opaque_generic(uint32_t* dest, uint32_t color, int count) {
+    for (int i = 0; i < count; i++) {
+        dest[i] = blend_pixel_over_opaque(color, dest[i]);
+    }
+}
+
+#ifdef PIXEL_SPAN_HAVE_CPU_DISPATCH
+// The vector kernels widen each channel to 16 bits, and compute the same expression as blend_pixel_over_opaque() in
+// every lane. Lanes whose source alpha is 0 keep the destination pixel as is, including its alpha channel.
+__attribute__((target("sse2"))) static inline __m128i blend_half_sse2(__m128i src, __m128i dest) {
+    auto alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    auto sum = _mm_add_epi16(_mm_mullo_epi16(src, alpha), _mm_mullo_epi16(dest, _mm_sub_epi16(_mm_set1_epi16(255), alpha)));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(sum, _mm_set1_epi16(1)), _mm_srli_epi16(sum, 8)), 8);
+}
+
+__attribute__((target("sse2"))) static inline __m128i blend_sse2(__m128i src, __m128i dest) {
+    auto zero = _mm_setzero_si128();
+    auto alpha_mask = _mm_set1_epi32(0xFF000000);
+
+    auto low = blend_half_sse2(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dest, zero));
+    auto high = blend_half_sse2(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dest, zero));
+    auto result = _mm_or_si128(_mm_packus_epi16(low, high), alpha_mask);
+
+    auto transparent = _mm_cmpeq_epi32(_mm_and_si128(src, alpha_mask), zero);
+    return _mm_or_si128(_mm_and_si128(transparent, dest), _mm_andnot_si128(transparent, result));
+}
+
+__attribute__((target("sse2"))) static void fill_sse2(uint32_t* dest, uint32_t color, int count) {
+    auto value = _mm_set1_epi32(color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), value);
+    }
+    fill_generic(dest + i, color, count - i);
+}
+
+__attribute__((target("sse2"))) static void blend_over_opaque_sse2(uint32_t* dest, const uint32_t* src, int count) {
+    auto zero = _mm_setzero_si128();
+    auto alpha_mask = _mm_set1_epi32(0xFF000000);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        auto alpha = _mm_and_si128(source, alpha_mask);
+
+        // Most bitmaps are made up of long runs of fully opaque or fully transparent pixels.
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alpha_mask)) == 0xFFFF) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), source);
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xFFFF) {
+            continue;
+        }
+
+        auto destination = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), blend_sse2(source, destination));
+    }
+    blend_over_opaque_generic(dest + i, src + i, count - i);
+}
+
+__attribute__((target("sse2"))) static void blend_color_over_opaque_sse2(uint32_t* dest, uint32_t color, int count) {
+    auto source = _mm_set1_epi32(color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto destination = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), blend_sse2(source, destination));
+    }
+    blend_color_over_opaque_generic(dest + i, color, count - i);
+}
+
+__attribute__((target("avx2"))) static inline __m256i blend_half_avx2(__m256i src, __m256i dest) {
+    auto alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    auto sum = _mm256_add_epi16(_mm256_mullo_epi16(src, alpha), _mm256_mullo_epi16(dest, _mm256_sub_epi16(_mm256_set1_epi16(255), alpha)));
+    return _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(1)), _mm256_srli_epi16(sum, 8)), 8);
+}
+
+__attribute__((target("avx2"))) static inline __m256i blend_avx2(__m256i src, __m256i dest) {
+    auto zero = _mm256_setzero_si256();
+    auto alpha_mask = _mm256_set1_epi32(0xFF000000);
+
+    // The unpack and pack instructions work within each 128 bit lane, so the pixels end up back in their original order.
+    auto low = blend_half_avx2(_mm256_unpacklo_epi8(src, zero), _mm256_unpacklo_epi8(dest, zero));
+    auto high = blend_half_avx2(_mm256_unpackhi_epi8(src, zero), _mm256_unpackhi_epi8(dest, zero));
+    auto result = _mm256_or_si256(_mm256_packus_epi16(low, high), alpha_mask);
+
+    auto transparent = _mm256_cmpeq_epi32(_mm256_and_si256(src, alpha_mask), zero);
+    return _mm256_blendv_epi8(result, dest, transparent);
+}
+
+__attribute__((target("avx2"))) static void fill_avx2(uint32_t* dest, uint32_t color, int count) {
+    auto value = _mm256_set1_epi32(color);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), value);
+    }
+    fill_sse2(dest + i, color, count - i);
+}
+
+__attribute__((target("avx2"))) static void blend_over_opaque_avx2(uint32_t* dest, const uint32_t* src, int count) {
+    auto zero = _mm256_setzero_si256();
+    auto alpha_mask = _mm256_set1_epi32(0xFF000000);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        auto alpha = _mm256_and_si256(source, alpha_mask);
+
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alpha_mask)) == -1) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), source);
+            continue;
+        }
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, zero)) == -1) {
+            continue;
+        }
+
+        auto destination = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), blend_avx2(source, destination));
+    }
+    blend_over_opaque_sse2(dest + i, src + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void blend_color_over_opaque_avx2(uint32_t* dest, uint32_t color, int count) {
+    auto source = _mm256_set1_epi32(color);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        auto destination = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), blend_avx2(source, destination));
+    }
+    blend_color_over_opaque_sse2(dest + i, color, count - i);
+}
+
+enum class Level { Generic, SSE2, AVX2 };
+
+static Level detect_level() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Level::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return Level::SSE2;
+    }
+    return Level::Generic;
+}
+
+static Level level() {
+    static Level s_level = detect_level();
+    return s_level;
+}
+
+template<typename F>
+static F select(F generic, F sse2, F avx2) {
+    switch (level()) {
+        case Level::AVX2:
+            return avx2;
+        case Level::SSE2:
+            return sse2;
+        default:
+            return generic;
+    }
+}
+
+static void fill_resolve(uint32_t* dest, uint32_t color, int count);
+static void blend_over_opaque_resolve(uint32_t* dest, const uint32_t* src, int count);
+static void blend_color_over_opaque_resolve(uint32_t* dest, uint32_t color, int count);
+
+static void (*fill_impl)(uint32_t*, uint32_t, int) = fill_resolve;
+static void (*blend_over_opaque_impl)(uint32_t*, const uint32_t*, int) = blend_over_opaque_resolve;
+static void (*blend_color_over_opaque_impl)(uint32_t*, uint32_t, int) = blend_color_over_opaque_resolve;
+
+static void fill_resolve(uint32_t* dest, uint32_t color, int count) {
+    auto impl = select(fill_generic, fill_sse2, fill_avx2);
+    __atomic_store_n(&fill_impl, impl, __ATOMIC_RELAXED);
+    impl(dest, color, count);
+}
+
+static void blend_over_opaque_resolve(uint32_t* dest, const uint32_t* src, int count) {
+    auto impl = select(blend_over_opaque_generic, blend_over_opaque_sse2, blend_over_opaque_avx2);
+    __atomic_store_n(&blend_over_opaque_impl, impl, __ATOMIC_RELAXED);
+    impl(dest, src, count);
+}
+
+static void blend_color_over_opaque_resolve(uint32_t* dest, uint32_t color, int count) {
+    auto impl = select(blend_color_over_opaque_generic, blend_color_over_opaque_sse2, blend_color_over_opaque_avx2);
+    __atomic_store_n(&blend_color_over_opaque_impl, impl, __ATOMIC_RELAXED);
+    impl(dest, color, count);
+}
+#endif
+
+void fill(uint32_t* dest, uint32_t color, int count) {
+#ifdef PIXEL_SPAN_HAVE_CPU_DISPATCH
+    __atomic_load_n(&fill_impl, __ATOMIC_RELAXED)(dest, color, count);
+#else
+    fill_generic(dest, color, count);
+#endif
+}
+
+void blend_over_opaque(uint32_t* dest, const uint32_t* src, int count) {
+#ifdef PIXEL_SPAN_HAVE_CPU_DISPATCH
+    __atomic_load_n(&blend_over_opaque_impl, __ATOMIC_RELAXED)(dest, src, count);
+#else
+    blend_over_opaque_generic(dest, src, count);
+#endif
+}
+
+void blend_color_over_opaque(uint32_t* dest, uint32_t color, int count) {
+    auto alpha = color >> 24;
+    if (alpha == 0) {
+        return;
+    }
+    if (alpha == 0xFF) {
+        fill(dest, color, count);
+        return;
+    }
+
+#ifdef PIXEL_SPAN_HAVE_CPU_DISPATCH
+    __atomic_load_n(&blend_color_over_opaque_impl, __ATOMIC_RELAXED)(dest, color, count);
+#else
+    blend_color_over_opaque_generic(dest, color, count);
+#endif
+}
+}
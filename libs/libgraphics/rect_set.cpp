@@ -91,3 +91,31 @@ void RectSet::subtract(const Rect& rect) {
     }
     swap(output);
 }
+
+void RectSet::subtract(const RectSet& other) {
+    for (auto& rect : other) {
+        if (empty()) {
+            return;
+        }
+        subtract(rect);
+    }
+}
+
+void RectSet::intersect(const Rect& rect) {
+    auto output = Vector<Rect> {};
+    for (auto& old_rect : m_rects) {
+        auto intersection = old_rect.intersection_with(rect);
+        if (!intersection.empty()) {
+            output.add(intersection);
+        }
+    }
+    LIIM::swap(m_rects, output);
+}
+
+int RectSet::area() const {
+    int result = 0;
+    for (auto& rect : m_rects) {
+        result += rect.width() * rect.height();
+    }
+    return result;
+}
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <graphics/font.h>
+#include <graphics/pixel_span.h>
 #include <graphics/renderer.h>
 #include <liim/scope_guard.h>
 #include <liim/utf8_view.h>
@@ -46,6 +47,8 @@ static_assert(alpha_blend(Color(255, 255, 255, 200), ColorValue::Black).a() == 2
 static_assert(alpha_blend(Color(140, 0, 0, 200), ColorValue::Black) == Color(109, 0, 0, 255));
 static_assert(alpha_blend(Color(120, 0, 0, 160), Color(39, 0, 0, 40)) == Color(113, 0, 0, 174));
 static_assert(alpha_blend(ColorValue::Clear, ColorValue::Clear) == ColorValue::Clear);
+static_assert(alpha_blend(Color(140, 0, 0, 200), ColorValue::Black, true) == Color(109, 0, 0, 255));
+static_assert(alpha_blend(Color(120, 0, 0, 160), Color(39, 0, 0, 40), true) == Color(89, 0, 0, 255));
 
 void Renderer::fill_rect(int x, int y, int width, int height, Color color_object) {
     if (color_object.a() == 0) {
@@ -71,11 +74,18 @@ void Renderer::fill_rect(int x, int y, int width, int height, Color color_object
         return;
     }
 
-    bool bg_opaque = !buffer.has_alpha();
+    if (!buffer.has_alpha()) {
+        for (int y = y_start; y < y_end; y++) {
+            auto* base = buffer.pixels() + (y * buffer.width());
+            PixelSpan::blend_color_over_opaque(base + x_start, color_object.color(), x_end - x_start);
+        }
+        return;
+    }
+
     for (int y = y_start; y < y_end; y++) {
         auto* base = buffer.pixels() + (y * buffer.width());
         for (int x = x_start; x < x_end; x++) {
-            base[x] = alpha_blend(color_object, base[x], bg_opaque).color();
+            base[x] = alpha_blend(color_object, base[x]).color();
         }
     }
 }
@@ -106,9 +116,7 @@ void Renderer::clear_rect(int x, int y, int width, int height, Color color_objec
     auto color = color_object.color();
     for (int y = y_start; y < y_end; y++) {
         auto* base = buffer.pixels() + (y * buffer.width());
-        for (int x = x_start; x < x_end; x++) {
-            base[x] = color;
-        }
+        PixelSpan::fill(base + x_start, color, x_end - x_start);
     }
 }
 
@@ -200,8 +208,13 @@ void Renderer::fill_circle(int x, int y, int r, Color color) {
     auto fixed_x = constrain_x(translate_x(x));
     auto fixed_y = constrain_y(translate_y(y));
 
-    for (int a = fixed_x - r; a < fixed_x + r; a++) {
-        for (int b = fixed_y - r; b <= fixed_y + r; b++) {
+    auto a_start = max(fixed_x - r, m_bounding_rect.left());
+    auto a_end = min(fixed_x + r, m_bounding_rect.right());
+    auto b_start = max(fixed_y - r, m_bounding_rect.top());
+    auto b_end = min(fixed_y + r + 1, m_bounding_rect.bottom());
+
+    for (int a = a_start; a < a_end; a++) {
+        for (int b = b_start; b < b_end; b++) {
             int da = a - fixed_x;
             int db = b - fixed_y;
             int dd = da * da + db * db;
@@ -218,8 +231,13 @@ void Renderer::draw_circle(int x, int y, int r, Color color) {
     auto fixed_x = constrain_x(translate_x(x));
     auto fixed_y = constrain_y(translate_y(y));
 
-    for (int a = fixed_x - r; a < fixed_x + r; a++) {
-        for (int b = fixed_y - r; b <= fixed_y + r; b++) {
+    auto a_start = max(fixed_x - r, m_bounding_rect.left());
+    auto a_end = min(fixed_x + r, m_bounding_rect.right());
+    auto b_start = max(fixed_y - r, m_bounding_rect.top());
+    auto b_end = min(fixed_y + r + 1, m_bounding_rect.bottom());
+
+    for (int a = a_start; a < a_end; a++) {
+        for (int b = b_start; b < b_end; b++) {
             int da = a - fixed_x;
             int db = b - fixed_y;
             int dd = da * da + db * db;
@@ -267,16 +285,25 @@ void Renderer::draw_bitmap(const Bitmap& src, const Rect& src_rect_in, const Rec
             auto dest_y = y_offset + src_y;
             memcpy(raw_dest + dest_y * dest_width + x_offset + src_x_start, raw_src + src_y * src_width + src_x_start, row_width_in_bytes);
         }
+        return;
+    }
+
+    if (!m_pixels.has_alpha()) {
+        for (auto src_y = src_y_start; src_y < src_y_end; src_y++) {
+            auto dest_y = y_offset + src_y;
+            PixelSpan::blend_over_opaque(raw_dest + dest_y * dest_width + x_offset + src_x_start, raw_src + src_y * src_width + src_x_start,
+                                         src_x_end - src_x_start);
+        }
+        return;
     }
 
-    bool bg_opaque = !m_pixels.has_alpha();
     for (auto src_y = src_y_start; src_y < src_y_end; src_y++) {
         auto dest_y = y_offset + src_y;
         for (auto src_x = src_x_start; src_x < src_x_end; src_x++) {
             auto dest_x = x_offset + src_x;
             auto& background = raw_dest[dest_y * dest_width + dest_x];
             auto foreground = raw_src[src_y * src_width + dest_x - x_offset];
-            background = alpha_blend(foreground, background, bg_opaque).color();
+            background = alpha_blend(foreground, background).color();
         }
     }
 }
@@ -375,6 +402,10 @@ void Renderer::set_bounding_rect(const Rect& rect) {
     m_translation = m_bounding_rect.top_left();
 }
 
+void Renderer::set_clip_rect(const Rect& rect) {
+    m_bounding_rect = rect.intersection_with(m_pixels.rect());
+}
+
 void Renderer::set_translation(const Point& translation) {
     m_translation = m_translation.translated(translation);
 }
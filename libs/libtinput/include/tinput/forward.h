@@ -5,5 +5,6 @@ class IOTerminal;
 class TerminalGlyph;
 class TerminalInputParser;
 class TerminalRenderer;
+class TerminalScreen;
 struct TerminalTextStyle;
 }
@@ -4,11 +4,13 @@
 #include <ext/file.h>
 #include <graphics/point.h>
 #include <graphics/rect.h>
+#include <liim/byte_buffer.h>
 #include <liim/forward.h>
 #include <liim/function.h>
 #include <liim/pointers.h>
 #include <termios.h>
 #include <tinput/forward.h>
+#include <tinput/terminal_screen.h>
 #include <tinput/terminal_text_style.h>
 
 namespace TInput {
@@ -23,6 +25,7 @@ public:
     void set_bracketed_paste(bool b);
     void set_show_cursor(bool b);
 
+    // Draws whatever changed since the last flush, and writes everything out at once.
     void flush();
 
     void detect_cursor_position();
@@ -43,13 +46,15 @@ public:
     IOTerminal(const termios& saved_termios, const termios& current_termios, const Rect& m_terminal_rect, UniquePtr<Ext::File> file);
 
 private:
-    enum class ColorRole { Foreground, Background };
-    String color_string(Option<Color> color, ColorRole role) const;
+    // Sequences which take effect immediately have to come after the glyphs drawn before them.
+    void append_sequence(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    void write_output();
 
     UniquePtr<Ext::File> m_file;
     SharedPtr<App::FdWrapper> m_selectable;
-    TerminalTextStyle m_current_text_style;
-    Point m_cursor_position;
+    TerminalScreen m_screen;
+    TerminalScreen::TerminalState m_state;
+    ByteBuffer m_output;
     Point m_initial_cursor_position;
     Rect m_terminal_rect;
     termios m_saved_termios;
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <graphics/point.h>
+#include <liim/byte_buffer.h>
+#include <liim/option.h>
+#include <liim/string.h>
+#include <liim/vector.h>
+#include <tinput/forward.h>
+#include <tinput/terminal_text_style.h>
+
+namespace TInput {
+// Keeps two grids of cells: the front grid holds what is on the terminal, and the back grid what should be. Drawing only
+// updates the back grid, and rendering compares the two, emitting only the cells which changed, with the shortest
+// cursor movements and style changes it can find. Cells start out unknown, since the terminal may already have content
+// which this process didn't draw, and unknown cells in the back grid are never drawn.
+class TerminalScreen {
+public:
+    // The current position and style of the terminal, which rendering starts from and updates.
+    struct TerminalState {
+        Option<Point> cursor_position;
+        Option<TerminalTextStyle> text_style;
+    };
+
+    TerminalScreen(int width, int height) { resize(width, height); }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // Forgets the contents of both grids.
+    void resize(int width, int height);
+
+    // Forgets what is on the terminal, so that every known cell is drawn again.
+    void invalidate();
+
+    void put_glyph(const Point& position, const TerminalGlyph& glyph, const TerminalTextStyle& style);
+
+    // Moves the contents of both grids up, matching what the terminal does when told to scroll. The rows scrolled in at
+    // the bottom are unknown.
+    void scroll_up(int rows);
+
+    bool needs_render() const { return m_first_dirty_row <= m_last_dirty_row; }
+    void render(ByteBuffer& output, TerminalState& state);
+
+    // Appends the sequences for moving the cursor and changing the text style, which are also used for changes made
+    // outside the grid.
+    static void append_cursor_movement(ByteBuffer& output, Option<Point>& cursor_position, const Point& position);
+    static void append_style_change(ByteBuffer& output, Option<TerminalTextStyle>& current_style, const TerminalTextStyle& style);
+
+private:
+    struct Cell {
+        // A wide glyph is followed by a continuation cell, which is known and has no text and no width.
+        String text;
+        TerminalTextStyle style;
+        int width { 0 };
+        bool known { false };
+
+        bool is_continuation() const { return known && width == 0; }
+        bool operator==(const Cell& other) const {
+            return known == other.known && width == other.width && style == other.style && text == other.text;
+        }
+        bool operator!=(const Cell& other) const { return !(*this == other); }
+    };
+
+    Cell& front(int x, int y) { return m_front[y * m_width + x]; }
+    Cell& back(int x, int y) { return m_back[y * m_width + x]; }
+
+    void set_back(int x, int y, Cell cell);
+    void mark_dirty(int y);
+    void render_row(ByteBuffer& output, TerminalState& state, int y);
+    void move_cursor(ByteBuffer& output, TerminalState& state, const Point& position);
+    int erasable_run_length(int x, int y);
+
+    Vector<Cell> m_front;
+    Vector<Cell> m_back;
+    int m_first_dirty_row { 0 };
+    int m_last_dirty_row { -1 };
+    int m_width { 0 };
+    int m_height { 0 };
+
+    // Zero width glyphs, like escape sequences, are attached to the glyph which is drawn after them at the same position.
+    String m_pending_prefix;
+    Point m_pending_prefix_position;
+};
+}
@@ -1,7 +1,10 @@
+#include <errno.h>
 #include <eventloop/event_loop.h>
 #include <fcntl.h>
 #include <poll.h>
 #include <signal.h>
+#include <stdarg.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <tinput/io_terminal.h>
 #include <tinput/terminal_glyph.h>
@@ -37,6 +40,7 @@ UniquePtr<IOTerminal> IOTerminal::create(FILE* file) {
 
 IOTerminal::IOTerminal(const termios& saved_termios, const termios& current_termios, const Rect& terminal_rect, UniquePtr<Ext::File> file)
     : m_file(move(file))
+    , m_screen(terminal_rect.width(), terminal_rect.height())
     , m_terminal_rect(terminal_rect)
     , m_saved_termios(saved_termios)
     , m_current_termios(current_termios)
@@ -60,6 +64,8 @@ IOTerminal::IOTerminal(const termios& saved_termios, const termios& current_term
         ioctl(m_file->fd(), TIOCGWINSZ, &size);
 
         m_terminal_rect = { 0, 0, size.ws_col, size.ws_row };
+        m_screen.resize(size.ws_col, size.ws_row);
+        m_state.cursor_position = {};
         if (on_resize) {
             on_resize(m_terminal_rect);
         }
@@ -84,7 +90,7 @@ void IOTerminal::set_bracketed_paste(bool b) {
         return;
     }
     m_bracketed_paste = b;
-    fprintf(m_file->c_file(), "\033[?2004%c", b ? 'h' : 'l');
+    append_sequence("\033[?2004%c", b ? 'h' : 'l');
 }
 
 void IOTerminal::set_use_alternate_screen_buffer(bool b) {
@@ -92,7 +98,11 @@ void IOTerminal::set_use_alternate_screen_buffer(bool b) {
         return;
     }
     m_use_alternate_screen_buffer = b;
-    fprintf(m_file->c_file(), "\033[?1049%c", b ? 'h' : 'l');
+    append_sequence("\033[?1049%c", b ? 'h' : 'l');
+
+    // The other buffer has different contents, and the cursor and text style may have been saved and restored.
+    m_screen.invalidate();
+    m_state = {};
 }
 
 void IOTerminal::set_use_mouse(bool b) {
@@ -100,7 +110,7 @@ void IOTerminal::set_use_mouse(bool b) {
         return;
     }
     m_use_mouse = b;
-    fprintf(m_file->c_file(), "\033[?1002%c\033[?1006%c", b ? 'h' : 'l', b ? 'h' : 'l');
+    append_sequence("\033[?1002%c\033[?1006%c", b ? 'h' : 'l', b ? 'h' : 'l');
 }
 
 void IOTerminal::set_show_cursor(bool b) {
@@ -108,15 +118,16 @@ void IOTerminal::set_show_cursor(bool b) {
         return;
     }
     m_show_cursor = b;
-    fprintf(m_file->c_file(), "\033[?25%c", b ? 'h' : 'l');
+    append_sequence("\033[?25%c", b ? 'h' : 'l');
 }
 
 void IOTerminal::scroll_up(int times) {
-    fprintf(m_file->c_file(), "\033[%dS", times);
+    append_sequence("\033[%dS", times);
+    m_screen.scroll_up(times);
 }
 
 void IOTerminal::detect_cursor_position() {
-    fprintf(m_file->c_file(), "\033[6n");
+    append_sequence("\033[6n");
     flush();
 
     auto start = time(nullptr);
@@ -148,7 +159,7 @@ void IOTerminal::detect_cursor_position() {
             }
 
             m_initial_cursor_position = { col - 1, row - 1 };
-            m_cursor_position = m_initial_cursor_position;
+            m_state.cursor_position = m_initial_cursor_position;
 
             auto before_sequence = string.view().first(i);
             auto after_sequence = string.view().substring(*string.view().substring(i).index_of('R') + 1);
@@ -166,106 +177,63 @@ void IOTerminal::detect_cursor_position() {
 }
 
 void IOTerminal::reset_cursor() {
-    fprintf(m_file->c_file(), "\033[1;1H");
-    m_cursor_position = {};
+    append_sequence("\033[H");
+    m_state.cursor_position = Point {};
 }
 
 void IOTerminal::move_cursor_to(const Point& position) {
-    if (m_cursor_position == position) {
-        return;
-    }
-
-    fprintf(m_file->c_file(), "\033[%d;%dH", position.y() + 1, position.x() + 1);
-    m_cursor_position = position;
+    m_screen.render(m_output, m_state);
+    TerminalScreen::append_cursor_movement(m_output, m_state.cursor_position, position);
 }
 
-String IOTerminal::color_string(Option<Color> color, ColorRole role) const {
-    auto offset = role == ColorRole::Background ? 10 : 0;
-    if (!color) {
-        return String::format("%d", 39 + offset);
-    }
-
-    auto vga_color = color->to_vga_color();
-    if (!vga_color) {
-        // FIXME: separate the fields with ':' once its properly supported in the terminal.
-        return String::format("%d;2;%d;%d;%d", 38 + offset, color->r(), color->b(), color->g());
-    }
+void IOTerminal::put_style(const TerminalTextStyle& style) {
+    m_screen.render(m_output, m_state);
+    TerminalScreen::append_style_change(m_output, m_state.text_style, style);
+}
 
-    auto number = [&] {
-        switch (*vga_color) {
-            case VGA_COLOR_BLACK:
-                return 30;
-            case VGA_COLOR_RED:
-                return 31;
-            case VGA_COLOR_GREEN:
-                return 32;
-            case VGA_COLOR_BROWN:
-                return 33;
-            case VGA_COLOR_BLUE:
-                return 34;
-            case VGA_COLOR_MAGENTA:
-                return 35;
-            case VGA_COLOR_CYAN:
-                return 36;
-            case VGA_COLOR_LIGHT_GREY:
-                return 37;
-            case VGA_COLOR_DARK_GREY:
-                return 90;
-            case VGA_COLOR_LIGHT_RED:
-                return 91;
-            case VGA_COLOR_LIGHT_GREEN:
-                return 92;
-            case VGA_COLOR_YELLOW:
-                return 93;
-            case VGA_COLOR_LIGHT_BLUE:
-                return 94;
-            case VGA_COLOR_LIGHT_MAGENTA:
-                return 95;
-            case VGA_COLOR_LIGHT_CYAN:
-                return 96;
-            case VGA_COLOR_WHITE:
-                return 97;
-            default:
-                return 39;
-        }
-    }();
-    return String::format("%d", number + offset);
+void IOTerminal::put_glyph(const Point& position, const TerminalGlyph& glyph, const TerminalTextStyle& style) {
+    m_screen.put_glyph(position, glyph, style);
 }
 
-void IOTerminal::put_style(const TerminalTextStyle& style) {
-    if (m_current_text_style == style) {
-        return;
-    }
+void IOTerminal::append_sequence(const char* format, ...) {
+    m_screen.render(m_output, m_state);
 
-    auto string = "\033[0"s;
-    if (style.bold) {
-        string += ";1";
-    }
-    string += String::format(";%s", color_string(style.foreground, ColorRole::Foreground).string());
-    string += String::format(";%s", color_string(style.background, ColorRole::Background).string());
-    if (style.invert) {
-        string += ";7";
-    }
-    string += "m";
+    char buffer[32];
+    va_list args;
+    va_start(args, format);
+    auto length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
 
-    fputs(string.string(), m_file->c_file());
-    m_current_text_style = style;
+    auto offset = m_output.size();
+    if (m_output.capacity() < offset + length) {
+        m_output.ensure_capacity(max(m_output.capacity() * 2, offset + length));
+    }
+    m_output.set_size(offset + length);
+    memcpy(m_output.data() + offset, buffer, length);
 }
 
-void IOTerminal::put_glyph(const Point& position, const TerminalGlyph& glyph, const TerminalTextStyle& style) {
-    put_style(style);
-
-    move_cursor_to(position);
-    fwrite(glyph.text().string(), 1, glyph.text().size(), m_file->c_file());
-
-    m_cursor_position.set_x(m_cursor_position.x() + glyph.width());
-    if (m_cursor_position.x() > m_terminal_rect.width()) {
-        m_cursor_position.set_x(0);
-        m_cursor_position.set_y(min(m_cursor_position.y() + 1, m_terminal_rect.height() - 1));
+void IOTerminal::write_output() {
+    auto* data = m_output.data();
+    auto remaining = m_output.size();
+    while (remaining > 0) {
+        auto written = write(m_file->fd(), data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        data += written;
+        remaining -= written;
     }
+    m_output.set_size(0);
 }
 
 void IOTerminal::flush() {
+    m_screen.render(m_output, m_state);
+
+    // Anything written to the file directly goes out first.
     fflush(m_file->c_file());
+    write_output();
 }
 }
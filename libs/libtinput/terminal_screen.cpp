@@ -0,0 +1,403 @@
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <tinput/terminal_glyph.h>
+#include <tinput/terminal_screen.h>
+
+namespace TInput {
+// Erasing a run of blank cells takes a single sequence, but leaves the cursor at the start of the run, so it is only
+// worth it for longer runs.
+constexpr int min_erased_run = 8;
+
+// Cells between the cursor and the next changed cell are written out again instead of moving the cursor, if that is
+// shorter. Looking further than this is never shorter.
+constexpr int max_rewritten_gap = 8;
+
+static void append(ByteBuffer& output, const char* data, size_t size) {
+    auto offset = output.size();
+    if (output.capacity() < offset + size) {
+        output.ensure_capacity(max(output.capacity() * 2, offset + size));
+    }
+    output.set_size(offset + size);
+    memcpy(output.data() + offset, data, size);
+}
+
+static void append(ByteBuffer& output, const String& string) {
+    append(output, string.string(), string.size());
+}
+
+__attribute__((format(printf, 2, 3))) static void appendf(ByteBuffer& output, const char* format, ...) {
+    char buffer[64];
+    va_list args;
+    va_start(args, format);
+    auto length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    append(output, buffer, static_cast<size_t>(length));
+}
+
+enum class ColorRole { Foreground, Background };
+
+static int color_parameter(Option<Color> color, ColorRole role, char* buffer, size_t size) {
+    auto offset = role == ColorRole::Background ? 10 : 0;
+    if (!color) {
+        return snprintf(buffer, size, "%d", 39 + offset);
+    }
+
+    auto vga_color = color->to_vga_color();
+    if (!vga_color) {
+        // FIXME: separate the fields with ':' once its properly supported in the terminal.
+        return snprintf(buffer, size, "%d;2;%d;%d;%d", 38 + offset, color->r(), color->b(), color->g());
+    }
+
+    auto number = [&] {
+        switch (*vga_color) {
+            case VGA_COLOR_BLACK:
+                return 30;
+            case VGA_COLOR_RED:
+                return 31;
+            case VGA_COLOR_GREEN:
+                return 32;
+            case VGA_COLOR_BROWN:
+                return 33;
+            case VGA_COLOR_BLUE:
+                return 34;
+            case VGA_COLOR_MAGENTA:
+                return 35;
+            case VGA_COLOR_CYAN:
+                return 36;
+            case VGA_COLOR_LIGHT_GREY:
+                return 37;
+            case VGA_COLOR_DARK_GREY:
+                return 90;
+            case VGA_COLOR_LIGHT_RED:
+                return 91;
+            case VGA_COLOR_LIGHT_GREEN:
+                return 92;
+            case VGA_COLOR_YELLOW:
+                return 93;
+            case VGA_COLOR_LIGHT_BLUE:
+                return 94;
+            case VGA_COLOR_LIGHT_MAGENTA:
+                return 95;
+            case VGA_COLOR_LIGHT_CYAN:
+                return 96;
+            case VGA_COLOR_WHITE:
+                return 97;
+            default:
+                return 39;
+        }
+    }();
+    return snprintf(buffer, size, "%d", number + offset);
+}
+
+// Picks the shortest of the ways to get from one position to another. The terminal is in raw mode, so a line feed
+// moves straight down without returning to the first column.
+static int format_cursor_movement(char* buffer, size_t size, const Option<Point>& from, const Point& to) {
+    if (from == to) {
+        return 0;
+    }
+
+    char candidate[32];
+    auto length = to.x() == 0 ? snprintf(buffer, size, "\033[%dH", to.y() + 1)
+                              : snprintf(buffer, size, "\033[%d;%dH", to.y() + 1, to.x() + 1);
+    auto consider = [&](int candidate_length) {
+        if (candidate_length < length) {
+            memcpy(buffer, candidate, candidate_length);
+            length = candidate_length;
+        }
+    };
+
+    if (!from) {
+        return length;
+    }
+
+    auto dx = to.x() - from->x();
+    auto dy = to.y() - from->y();
+    if (dy == 0) {
+        if (to.x() == 0) {
+            consider(snprintf(candidate, sizeof(candidate), "\r"));
+        }
+        if (dx == -1) {
+            consider(snprintf(candidate, sizeof(candidate), "\b"));
+        }
+        consider(snprintf(candidate, sizeof(candidate), "\033[%dG", to.x() + 1));
+        if (dx > 0) {
+            consider(dx == 1 ? snprintf(candidate, sizeof(candidate), "\033[C") : snprintf(candidate, sizeof(candidate), "\033[%dC", dx));
+        } else {
+            consider(dx == -1 ? snprintf(candidate, sizeof(candidate), "\033[D") : snprintf(candidate, sizeof(candidate), "\033[%dD", -dx));
+        }
+    } else if (dx == 0) {
+        if (dy == 1) {
+            consider(snprintf(candidate, sizeof(candidate), "\n"));
+        }
+        consider(dy > 0 ? snprintf(candidate, sizeof(candidate), "\033[%dB", dy) : snprintf(candidate, sizeof(candidate), "\033[%dA", -dy));
+    } else if (to.x() == 0 && dy == 1) {
+        consider(snprintf(candidate, sizeof(candidate), "\r\n"));
+    }
+    return length;
+}
+
+void TerminalScreen::append_cursor_movement(ByteBuffer& output, Option<Point>& cursor_position, const Point& position) {
+    char buffer[32];
+    auto length = format_cursor_movement(buffer, sizeof(buffer), cursor_position, position);
+    append(output, buffer, length);
+    cursor_position = position;
+}
+
+void TerminalScreen::append_style_change(ByteBuffer& output, Option<TerminalTextStyle>& current_style, const TerminalTextStyle& style) {
+    if (current_style == style) {
+        return;
+    }
+
+    // Bold and inverted text can only be turned off by resetting everything, since the system terminal doesn't support
+    // the sequences which turn off single attributes.
+    auto reset = !current_style || (current_style->bold && !style.bold) || (current_style->invert && !style.invert);
+    auto base = reset ? TerminalTextStyle {} : *current_style;
+
+    char parameters[64];
+    size_t length = 0;
+    auto add_parameter = [&](auto&& write) {
+        if (length > 0) {
+            parameters[length++] = ';';
+        }
+        length += write(parameters + length, sizeof(parameters) - length);
+    };
+
+    if (style.bold && !base.bold) {
+        add_parameter([](char* buffer, size_t size) {
+            return snprintf(buffer, size, "1");
+        });
+    }
+    if (style.foreground != base.foreground) {
+        add_parameter([&](char* buffer, size_t size) {
+            return color_parameter(style.foreground, ColorRole::Foreground, buffer, size);
+        });
+    }
+    if (style.background != base.background) {
+        add_parameter([&](char* buffer, size_t size) {
+            return color_parameter(style.background, ColorRole::Background, buffer, size);
+        });
+    }
+    if (style.invert && !base.invert) {
+        add_parameter([](char* buffer, size_t size) {
+            return snprintf(buffer, size, "7");
+        });
+    }
+
+    // An empty parameter list resets everything by itself.
+    append(output, "\033[", 2);
+    if (reset && length > 0) {
+        append(output, "0;", 2);
+    }
+    append(output, parameters, length);
+    append(output, "m", 1);
+    current_style = style;
+}
+
+void TerminalScreen::resize(int width, int height) {
+    m_width = max(width, 0);
+    m_height = max(height, 0);
+    m_front.clear();
+    m_back.clear();
+    m_front.resize(m_width * m_height);
+    m_back.resize(m_width * m_height);
+    m_first_dirty_row = m_height;
+    m_last_dirty_row = -1;
+    m_pending_prefix.clear();
+}
+
+void TerminalScreen::invalidate() {
+    for (auto& cell : m_front) {
+        cell = {};
+    }
+    m_first_dirty_row = 0;
+    m_last_dirty_row = m_height - 1;
+}
+
+void TerminalScreen::mark_dirty(int y) {
+    m_first_dirty_row = min(m_first_dirty_row, y);
+    m_last_dirty_row = max(m_last_dirty_row, y);
+}
+
+void TerminalScreen::set_back(int x, int y, Cell cell) {
+    auto& existing = back(x, y);
+    if (existing != cell) {
+        existing = move(cell);
+        mark_dirty(y);
+    }
+}
+
+void TerminalScreen::put_glyph(const Point& position, const TerminalGlyph& glyph, const TerminalTextStyle& style) {
+    auto x = position.x();
+    auto y = position.y();
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+        return;
+    }
+
+    if (glyph.width() <= 0) {
+        if (m_pending_prefix_position != position) {
+            m_pending_prefix.clear();
+        }
+        m_pending_prefix.insert(glyph.text(), m_pending_prefix.size());
+        m_pending_prefix_position = position;
+        return;
+    }
+
+    auto text = glyph.text();
+    if (!m_pending_prefix.empty()) {
+        if (m_pending_prefix_position == position) {
+            text.insert(m_pending_prefix, 0);
+        }
+        m_pending_prefix.clear();
+    }
+
+    // Drawing over either half of a wide glyph erases all of it, on the terminal and so here.
+    if (back(x, y).is_continuation() && x > 0) {
+        set_back(x - 1, y, Cell { " ", back(x - 1, y).style, 1, true });
+    }
+
+    auto covered = min(glyph.width(), m_width - x);
+    set_back(x, y, Cell { move(text), style, glyph.width(), true });
+    for (int i = 1; i < covered; i++) {
+        set_back(x + i, y, Cell { {}, style, 0, true });
+    }
+    if (x + covered < m_width && back(x + covered, y).is_continuation()) {
+        set_back(x + covered, y, Cell { " ", back(x + covered, y).style, 1, true });
+    }
+}
+
+void TerminalScreen::scroll_up(int rows) {
+    rows = min(rows, m_height);
+    if (rows <= 0) {
+        return;
+    }
+
+    auto shift = rows * m_width;
+    for (auto* grid : { &m_front, &m_back }) {
+        for (int i = 0; i + shift < grid->size(); i++) {
+            (*grid)[i] = move((*grid)[i + shift]);
+        }
+        for (int i = grid->size() - shift; i < grid->size(); i++) {
+            (*grid)[i] = {};
+        }
+    }
+
+    m_first_dirty_row = max(m_first_dirty_row - rows, 0);
+    m_last_dirty_row -= rows;
+    if (m_last_dirty_row < m_first_dirty_row) {
+        m_first_dirty_row = m_height;
+        m_last_dirty_row = -1;
+    }
+    m_pending_prefix.clear();
+}
+
+void TerminalScreen::render(ByteBuffer& output, TerminalState& state) {
+    for (int y = m_first_dirty_row; y <= m_last_dirty_row; y++) {
+        render_row(output, state, y);
+    }
+    m_first_dirty_row = m_height;
+    m_last_dirty_row = -1;
+}
+
+// Returns the length of the run of blank cells starting at x which can be erased instead of written, up to the last one
+// which actually changed. Blanks with a background color or inverted can't be, since erasing uses the default colors.
+int TerminalScreen::erasable_run_length(int x, int y) {
+    auto is_erasable = [](const Cell& cell) {
+        return cell.known && cell.width == 1 && cell.text == " " && !cell.style.background && !cell.style.invert;
+    };
+
+    int run = 0;
+    for (int i = x; i < m_width && is_erasable(back(i, y)); i++) {
+        if (front(i, y) != back(i, y)) {
+            run = i - x + 1;
+        }
+    }
+    return run;
+}
+
+void TerminalScreen::move_cursor(ByteBuffer& output, TerminalState& state, const Point& position) {
+    auto& cursor = state.cursor_position;
+    char movement[32];
+    auto movement_length = format_cursor_movement(movement, sizeof(movement), cursor, position);
+    if (movement_length == 0) {
+        return;
+    }
+
+    // The cells the cursor would skip over are up to date, so writing them again is harmless, and shorter than moving
+    // the cursor if they are few and in the current style.
+    if (cursor && state.text_style && cursor->y() == position.y() && cursor->x() < position.x() &&
+        position.x() - cursor->x() <= max_rewritten_gap) {
+        int gap_length = 0;
+        for (int x = cursor->x(); x < position.x(); x++) {
+            auto& cell = front(x, position.y());
+            if (!cell.known || cell.width != 1 || cell.style != *state.text_style || cell != back(x, position.y())) {
+                gap_length = INT_MAX;
+                break;
+            }
+            gap_length += cell.text.size();
+        }
+
+        if (gap_length < movement_length) {
+            for (int x = cursor->x(); x < position.x(); x++) {
+                append(output, front(x, position.y()).text);
+            }
+            cursor = position;
+            return;
+        }
+    }
+
+    append(output, movement, movement_length);
+    cursor = position;
+}
+
+void TerminalScreen::render_row(ByteBuffer& output, TerminalState& state, int y) {
+    for (int x = 0; x < m_width; x++) {
+        auto& cell = back(x, y);
+        auto& on_screen = front(x, y);
+        if (!cell.known || cell.is_continuation() || cell == on_screen) {
+            continue;
+        }
+
+        if (auto run = erasable_run_length(x, y); run >= min_erased_run) {
+            move_cursor(output, state, { x, y });
+            if (!state.text_style || state.text_style->background || state.text_style->invert) {
+                append_style_change(output, state.text_style, cell.style);
+            }
+            appendf(output, "\033[%dX", run);
+            for (int i = x; i < x + run; i++) {
+                front(i, y) = back(i, y);
+            }
+            if (x + run < m_width && front(x + run, y).is_continuation()) {
+                front(x + run, y) = {};
+            }
+            x += run - 1;
+            continue;
+        }
+
+        move_cursor(output, state, { x, y });
+        append_style_change(output, state.text_style, cell.style);
+        append(output, cell.text);
+
+        // Writing over half of a wide glyph on the terminal erases the other half.
+        auto end = min(x + cell.width, m_width);
+        for (int i = x + cell.width; i < x + on_screen.width && i < m_width; i++) {
+            front(i, y) = {};
+        }
+        if (end < m_width && front(end, y).is_continuation()) {
+            front(end, y) = {};
+        }
+        for (int i = x; i < end; i++) {
+            front(i, y) = back(i, y);
+        }
+
+        // Terminals differ in where the cursor is after writing to the last column, so it is treated as unknown.
+        if (end >= m_width) {
+            state.cursor_position = {};
+        } else {
+            state.cursor_position = Point { end, y };
+        }
+        x = end - 1;
+    }
+}
+}
@@ -0,0 +1,122 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures file read throughput. A large file is written, and then read sequentially with read(), read a page at a time
+// at random offsets, and read sequentially through a shared mapping. Each pattern is run twice, the first time mostly
+// from disk and the second time mostly from the page cache.
+
+constexpr size_t default_file_size = 64 * 1024 * 1024;
+constexpr size_t chunk_size = 64 * 1024;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char* name, size_t bytes, double elapsed) {
+    printf("%-12s %12zu %12.2f %12.2f\n", name, bytes, elapsed * 1e3, bytes / elapsed / (1024 * 1024));
+}
+
+static void write_file(const char* path, size_t file_size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("bench_file_read: open");
+        exit(1);
+    }
+
+    auto* chunk = new char[chunk_size];
+    for (size_t offset = 0; offset < file_size; offset += chunk_size) {
+        for (size_t i = 0; i < chunk_size; i++) {
+            chunk[i] = static_cast<char>((offset + i) * 7);
+        }
+        if (write(fd, chunk, chunk_size) != static_cast<ssize_t>(chunk_size)) {
+            perror("bench_file_read: write");
+            exit(1);
+        }
+    }
+    delete[] chunk;
+    close(fd);
+}
+
+static void read_sequential(int fd, size_t file_size) {
+    auto* chunk = new char[chunk_size];
+    auto start = now_seconds();
+    for (size_t offset = 0; offset < file_size; offset += chunk_size) {
+        if (pread(fd, chunk, chunk_size, offset) != static_cast<ssize_t>(chunk_size)) {
+            perror("bench_file_read: pread");
+            exit(1);
+        }
+    }
+    report("sequential", file_size, now_seconds() - start);
+    delete[] chunk;
+}
+
+static void read_random(int fd, size_t file_size) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t pages = file_size / page_size;
+    auto* page = new char[page_size];
+
+    srand(1);
+    auto start = now_seconds();
+    for (size_t i = 0; i < pages; i++) {
+        off_t offset = static_cast<off_t>(rand() % pages) * page_size;
+        if (pread(fd, page, page_size, offset) != static_cast<ssize_t>(page_size)) {
+            perror("bench_file_read: pread");
+            exit(1);
+        }
+    }
+    report("random", pages * page_size, now_seconds() - start);
+    delete[] page;
+}
+
+static void read_mapped(int fd, size_t file_size) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    auto start = now_seconds();
+    auto* mapping = static_cast<volatile char*>(mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0));
+    if (mapping == MAP_FAILED) {
+        perror("bench_file_read: mmap");
+        exit(1);
+    }
+
+    char sum = 0;
+    for (size_t offset = 0; offset < file_size; offset += page_size) {
+        sum += mapping[offset];
+    }
+    munmap(const_cast<char*>(mapping), file_size);
+    report("mmap", file_size, now_seconds() - start);
+    (void) sum;
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "/tmp/bench_file_read";
+    size_t file_size = argc > 2 ? strtoul(argv[2], nullptr, 0) : default_file_size;
+    file_size -= file_size % chunk_size;
+    if (file_size == 0) {
+        fprintf(stderr, "Usage: %s [path] [file-size]\n", *argv);
+        return 2;
+    }
+
+    write_file(path, file_size);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("bench_file_read: open");
+        return 1;
+    }
+
+    printf("%-12s %12s %12s %12s\n", "pattern", "bytes", "ms", "MiB/s");
+    for (int pass = 0; pass < 2; pass++) {
+        read_sequential(fd, file_size);
+        read_random(fd, file_size);
+        read_mapped(fd, file_size);
+    }
+
+    close(fd);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures page fault throughput. Each thread repeatedly maps an anonymous region, writes to every page of it so that
+// every page faults in a fresh physical page, and unmaps it so the pages go back to the allocator. The test runs with
+// 1, 2, 4, ... threads up to the number of processors, to show how allocation scales across processors.
+
+constexpr size_t region_size = 16 * 1024 * 1024;
+constexpr int rounds = 16;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* fault_pages(void*) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    for (int round = 0; round < rounds; round++) {
+        auto* region = static_cast<volatile char*>(mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (region == MAP_FAILED) {
+            perror("bench_page_fault: mmap");
+            exit(1);
+        }
+
+        for (size_t offset = 0; offset < region_size; offset += page_size) {
+            region[offset] = 1;
+        }
+
+        if (munmap(const_cast<char*>(region), region_size)) {
+            perror("bench_page_fault: munmap");
+            exit(1);
+        }
+    }
+    return nullptr;
+}
+
+static void run(int thread_count) {
+    auto* threads = new pthread_t[thread_count];
+
+    auto start = now_seconds();
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&threads[i], nullptr, fault_pages, nullptr)) {
+            perror("bench_page_fault: pthread_create");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    auto elapsed = now_seconds() - start;
+    delete[] threads;
+
+    double faults = static_cast<double>(thread_count) * rounds * (region_size / sysconf(_SC_PAGESIZE));
+    printf("%8d %12.0f %12.2f %14.0f\n", thread_count, faults, elapsed * 1e3, faults / elapsed);
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    if (max_threads <= 0) {
+        fprintf(stderr, "Usage: %s [max-threads]\n", *argv);
+        return 2;
+    }
+
+    printf("%8s %12s %12s %14s\n", "threads", "faults", "ms", "faults/s");
+    for (int thread_count = 1; thread_count < max_threads; thread_count *= 2) {
+        run(thread_count);
+    }
+    run(max_threads);
+    return 0;
+}
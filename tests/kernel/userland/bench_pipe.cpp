@@ -0,0 +1,135 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures pipe throughput between two processes. Data is written with write() in different chunk sizes, with the
+// default pipe capacity and with a larger one set with F_SETPIPE_SZ. A file is also sent through the pipe, once by
+// reading and writing it and once by splicing it into the pipe, which does not copy the file's pages.
+
+constexpr size_t default_transfer_size = 256 * 1024 * 1024;
+constexpr size_t read_size = 256 * 1024;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char* name, int capacity, size_t chunk, size_t bytes, double elapsed) {
+    printf("%-8s %10d %10zu %12zu %12.2f %12.2f\n", name, capacity, chunk, bytes, elapsed * 1e3, bytes / elapsed / (1024 * 1024));
+}
+
+enum class Mode { Write, Copy, Splice };
+
+// Runs the producer in a child process, which sends transfer_size bytes to the pipe, and reads everything in this one.
+static void run(Mode mode, int capacity, size_t chunk_size, size_t transfer_size, const char* path) {
+    int fds[2];
+    if (pipe(fds)) {
+        perror("bench_pipe: pipe");
+        exit(1);
+    }
+    if (capacity && fcntl(fds[1], F_SETPIPE_SZ, capacity) < 0) {
+        perror("bench_pipe: F_SETPIPE_SZ");
+        exit(1);
+    }
+    capacity = fcntl(fds[1], F_GETPIPE_SZ);
+
+    auto start = now_seconds();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("bench_pipe: fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        auto* chunk = new char[chunk_size];
+        memset(chunk, 'x', chunk_size);
+        int file = mode == Mode::Write ? -1 : open(path, O_RDONLY);
+        for (size_t sent = 0; sent < transfer_size;) {
+            ssize_t ret;
+            if (mode == Mode::Splice) {
+                ret = splice(file, nullptr, fds[1], nullptr, chunk_size, 0);
+            } else {
+                ret = mode == Mode::Copy ? read(file, chunk, chunk_size) : static_cast<ssize_t>(chunk_size);
+                if (ret > 0) {
+                    for (ssize_t written = 0; written < ret;) {
+                        ssize_t amount = write(fds[1], chunk + written, ret - written);
+                        if (amount <= 0) {
+                            _exit(1);
+                        }
+                        written += amount;
+                    }
+                }
+            }
+            if (ret == 0 && mode != Mode::Write) {
+                lseek(file, 0, SEEK_SET);
+                continue;
+            }
+            if (ret < 0) {
+                perror("bench_pipe: send");
+                _exit(1);
+            }
+            sent += ret;
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    auto* buffer = new char[read_size];
+    size_t received = 0;
+    for (ssize_t ret; (ret = read(fds[0], buffer, read_size)) > 0;) {
+        received += ret;
+    }
+    auto elapsed = now_seconds() - start;
+    delete[] buffer;
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+
+    const char* names[] = { "write", "copy", "splice" };
+    report(names[static_cast<int>(mode)], capacity, chunk_size, received, elapsed);
+}
+
+int main(int argc, char** argv) {
+    size_t transfer_size = argc > 1 ? strtoul(argv[1], nullptr, 0) : default_transfer_size;
+    const char* path = argc > 2 ? argv[2] : "/tmp/bench_pipe";
+    if (transfer_size == 0) {
+        fprintf(stderr, "Usage: %s [transfer-size] [path]\n", *argv);
+        return 2;
+    }
+
+    // The file used by the copy and splice runs is read repeatedly, so it stays in the page cache.
+    constexpr size_t file_size = 4 * 1024 * 1024;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("bench_pipe: open");
+        return 1;
+    }
+    auto* data = new char[file_size];
+    memset(data, 'y', file_size);
+    if (write(fd, data, file_size) != static_cast<ssize_t>(file_size)) {
+        perror("bench_pipe: write");
+        return 1;
+    }
+    delete[] data;
+    close(fd);
+
+    printf("%-8s %10s %10s %12s %12s %12s\n", "mode", "capacity", "chunk", "bytes", "ms", "MiB/s");
+    const int capacities[] = { 0, 1024 * 1024 };
+    const size_t chunks[] = { 4096, 64 * 1024 };
+    for (auto capacity : capacities) {
+        for (auto chunk : chunks) {
+            run(Mode::Write, capacity, chunk, transfer_size, path);
+        }
+    }
+    for (auto capacity : capacities) {
+        run(Mode::Copy, capacity, 64 * 1024, transfer_size, path);
+        run(Mode::Splice, capacity, 64 * 1024, transfer_size, path);
+    }
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures how well CPU-bound processes are spread across processors. 1, 2, 4, ... processes up to twice the number of
+// processors each spin through the same amount of work, and the CPU time they used is compared to the elapsed time, to
+// show how many cores were kept busy. When available, the per-processor run queue lengths and migration counts are
+// printed at the end.
+
+constexpr unsigned long work_per_process = 400000000;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double timeval_seconds(const timeval& tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double children_cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    return timeval_seconds(usage.ru_utime) + timeval_seconds(usage.ru_stime);
+}
+
+static void spin() {
+    volatile unsigned long sum = 0;
+    for (unsigned long i = 0; i < work_per_process; i++) {
+        sum = sum + i;
+    }
+}
+
+static void run(int process_count, int processors) {
+    auto cpu_start = children_cpu_seconds();
+    auto start = now_seconds();
+    for (int i = 0; i < process_count; i++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("bench_sched: fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            spin();
+            _exit(0);
+        }
+    }
+    for (int i = 0; i < process_count; i++) {
+        wait(nullptr);
+    }
+    auto elapsed = now_seconds() - start;
+    auto cpu = children_cpu_seconds() - cpu_start;
+
+    // Utilisation is the fraction of the processors which could have been busy that were.
+    double busy_cores = cpu / elapsed;
+    double utilisation = 100 * busy_cores / (process_count < processors ? process_count : processors);
+    printf("%10d %12.2f %12.2f %12.2f %11.1f%%\n", process_count, elapsed * 1e3, cpu * 1e3, busy_cores, utilisation);
+}
+
+static void show_processors() {
+    FILE* file = fopen("/proc/cpus", "r");
+    if (!file) {
+        return;
+    }
+
+    printf("\n");
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (!strncmp(line, "ID:", 3) || !strncmp(line, "RUN QUEUE:", 10) || !strncmp(line, "MIGRATIONS:", 11)) {
+            fputs(line, stdout);
+        }
+    }
+    fclose(file);
+}
+
+int main(int argc, char** argv) {
+    int processors = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    int max_processes = argc > 1 ? atoi(argv[1]) : 2 * processors;
+    if (max_processes <= 0 || processors <= 0) {
+        fprintf(stderr, "Usage: %s [max-processes]\n", *argv);
+        return 2;
+    }
+
+    printf("%10s %12s %12s %12s %12s\n", "processes", "wall ms", "cpu ms", "busy cores", "utilisation");
+    for (int process_count = 1; process_count < max_processes; process_count *= 2) {
+        run(process_count, processors);
+    }
+    run(max_processes, processors);
+
+    show_processors();
+    return 0;
+}
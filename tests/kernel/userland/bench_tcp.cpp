@@ -0,0 +1,121 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures TCP throughput between two processes. Each congestion control algorithm is run over the plain loopback
+// interface, and over the lossy loopback interface, which drops some of its packets and so shows how well the sender
+// recovers from loss. The lossy interface only exists when the kernel is booted with lossy_loopback=1; otherwise its
+// runs are reported as skipped.
+
+constexpr size_t default_transfer_size = 64 * 1024 * 1024;
+constexpr size_t chunk_size = 64 * 1024;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int make_socket(const char* device) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("bench_tcp: socket");
+        exit(1);
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, device, strlen(device) + 1)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void run(const char* device, const char* congestion, size_t transfer_size) {
+    int listener = make_socket(device);
+    if (listener < 0) {
+        printf("%-8s %-8s %12s\n", device, congestion, "skipped");
+        return;
+    }
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_length = sizeof(addr);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) || listen(listener, 1) ||
+        getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addr_length)) {
+        perror("bench_tcp: listen");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("bench_tcp: fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        int fd = make_socket(device);
+        if (fd < 0 || setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, congestion, strlen(congestion) + 1) ||
+            connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+            perror("bench_tcp: connect");
+            _exit(1);
+        }
+
+        auto* chunk = new char[chunk_size];
+        memset(chunk, 'x', chunk_size);
+        for (size_t sent = 0; sent < transfer_size;) {
+            ssize_t ret = write(fd, chunk, chunk_size);
+            if (ret <= 0) {
+                perror("bench_tcp: write");
+                _exit(1);
+            }
+            sent += ret;
+        }
+        close(fd);
+        _exit(0);
+    }
+
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+        perror("bench_tcp: accept");
+        exit(1);
+    }
+
+    auto* chunk = new char[chunk_size];
+    size_t received = 0;
+    auto start = now_seconds();
+    for (ssize_t ret; (ret = read(fd, chunk, chunk_size)) > 0;) {
+        received += ret;
+    }
+    auto elapsed = now_seconds() - start;
+    delete[] chunk;
+
+    waitpid(pid, nullptr, 0);
+    close(fd);
+    close(listener);
+
+    printf("%-8s %-8s %12zu %12.2f %12.2f\n", device, congestion, received, elapsed * 1e3, received / elapsed / (1024 * 1024));
+}
+
+int main(int argc, char** argv) {
+    size_t transfer_size = argc > 1 ? strtoul(argv[1], nullptr, 0) : default_transfer_size;
+    if (transfer_size == 0) {
+        fprintf(stderr, "Usage: %s [transfer-size]\n", *argv);
+        return 2;
+    }
+
+    printf("%-8s %-8s %12s %12s %12s\n", "device", "cc", "bytes", "ms", "MiB/s");
+    const char* devices[] = { "lo", "lossy" };
+    const char* algorithms[] = { "cubic", "reno" };
+    for (auto* device : devices) {
+        for (auto* congestion : algorithms) {
+            run(device, congestion, transfer_size);
+        }
+    }
+    return 0;
+}
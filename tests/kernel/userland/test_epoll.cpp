@@ -0,0 +1,185 @@
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <test/test.h>
+#include <unistd.h>
+
+static int add(int epoll_fd, int fd, uint32_t events) {
+    epoll_event event {};
+    event.events = events;
+    event.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+TEST(epoll, level_triggered) {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    EXPECT(epoll_fd >= 0);
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+
+    EXPECT_EQ(add(epoll_fd, fds[0], EPOLLIN), 0);
+    EXPECT_EQ(add(epoll_fd, fds[0], EPOLLIN), -1);
+    EXPECT_EQ(errno, EEXIST);
+
+    epoll_event events[4];
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 0);
+
+    // The pipe stays readable until it is drained, and is reported every time.
+    EXPECT_EQ(write(fds[1], "ab", 2), 2);
+    for (int i = 0; i < 2; i++) {
+        EXPECT_EQ(epoll_wait(epoll_fd, events, 4, -1), 1);
+        EXPECT_EQ(events[0].data.fd, fds[0]);
+        EXPECT(events[0].events & EPOLLIN);
+    }
+
+    char buffer[2];
+    EXPECT_EQ(read(fds[0], buffer, 2), 2);
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 0);
+
+    EXPECT_EQ(epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fds[0], nullptr), 0);
+    EXPECT_EQ(epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fds[0], nullptr), -1);
+    EXPECT_EQ(errno, ENOENT);
+    EXPECT_EQ(write(fds[1], "a", 1), 1);
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    close(epoll_fd);
+}
+
+TEST(epoll, edge_triggered) {
+    int epoll_fd = epoll_create1(0);
+    EXPECT(epoll_fd >= 0);
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    EXPECT_EQ(add(epoll_fd, fds[0], EPOLLIN | EPOLLET), 0);
+
+    // The pipe is only reported once for becoming readable.
+    EXPECT_EQ(write(fds[1], "a", 1), 1);
+    epoll_event events[4];
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, -1), 1);
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 0);
+
+    char c;
+    EXPECT_EQ(read(fds[0], &c, 1), 1);
+    EXPECT_EQ(write(fds[1], "a", 1), 1);
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 1);
+
+    close(fds[0]);
+    close(fds[1]);
+    close(epoll_fd);
+}
+
+TEST(epoll, oneshot) {
+    int epoll_fd = epoll_create1(0);
+    EXPECT(epoll_fd >= 0);
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    EXPECT_EQ(add(epoll_fd, fds[0], EPOLLIN | EPOLLONESHOT), 0);
+
+    EXPECT_EQ(write(fds[1], "a", 1), 1);
+    epoll_event events[4];
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, -1), 1);
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 0);
+
+    // Modifying the item rearms it.
+    epoll_event event {};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.u32 = 42;
+    EXPECT_EQ(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fds[0], &event), 0);
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 1);
+    EXPECT_EQ(events[0].data.u32, 42u);
+
+    close(fds[0]);
+    close(fds[1]);
+    close(epoll_fd);
+}
+
+TEST(epoll, many) {
+    int epoll_fd = epoll_create1(0);
+    EXPECT(epoll_fd >= 0);
+    int fds[3][2];
+    for (auto& pipe_fds : fds) {
+        EXPECT_EQ(pipe(pipe_fds), 0);
+        EXPECT_EQ(add(epoll_fd, pipe_fds[0], EPOLLIN), 0);
+        EXPECT_EQ(add(epoll_fd, pipe_fds[1], EPOLLOUT), 0);
+    }
+
+    // Only as many events as fit are reported, and the rest are kept for the next wait.
+    epoll_event events[4];
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 2, 0), 2);
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 3);
+
+    EXPECT_EQ(write(fds[1][1], "a", 1), 1);
+    int readable = 0;
+    int writable = 0;
+    epoll_event all_events[8];
+    int count = epoll_wait(epoll_fd, all_events, 8, 0);
+    EXPECT_EQ(count, 4);
+    for (int i = 0; i < count; i++) {
+        if (all_events[i].events & EPOLLIN) {
+            EXPECT_EQ(all_events[i].data.fd, fds[1][0]);
+            readable++;
+        }
+        if (all_events[i].events & EPOLLOUT) {
+            writable++;
+        }
+    }
+    EXPECT_EQ(readable, 1);
+    EXPECT_EQ(writable, 3);
+
+    for (auto& pipe_fds : fds) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+    close(epoll_fd);
+}
+
+TEST(epoll, close_removes) {
+    int epoll_fd = epoll_create1(0);
+    EXPECT(epoll_fd >= 0);
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    EXPECT_EQ(add(epoll_fd, fds[0], EPOLLIN), 0);
+    EXPECT_EQ(write(fds[1], "a", 1), 1);
+
+    // Closing the only descriptor for a file removes it from the interest list.
+    close(fds[0]);
+    epoll_event events[4];
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 0), 0);
+    EXPECT_EQ(epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fds[0], nullptr), -1);
+    EXPECT_EQ(errno, EBADF);
+
+    close(fds[1]);
+    close(epoll_fd);
+}
+
+TEST(epoll, wait_for_child) {
+    int epoll_fd = epoll_create1(0);
+    EXPECT(epoll_fd >= 0);
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    EXPECT_EQ(add(epoll_fd, fds[0], EPOLLIN), 0);
+
+    epoll_event events[4];
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, 10), 0);
+
+    pid_t pid = fork();
+    EXPECT(pid >= 0);
+    if (pid == 0) {
+        usleep(20000);
+        _exit(write(fds[1], "a", 1) == 1 ? 0 : 1);
+    }
+
+    EXPECT_EQ(epoll_wait(epoll_fd, events, 4, -1), 1);
+    EXPECT_EQ(events[0].data.fd, fds[0]);
+
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    close(epoll_fd);
+}
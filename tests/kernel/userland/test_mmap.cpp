@@ -0,0 +1,111 @@
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <test/test.h>
+#include <unistd.h>
+
+constexpr int mapping_count = 256;
+
+static void map_anonymous(char** result, size_t size) {
+    *result = static_cast<char*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    EXPECT_NOT_EQ(*result, MAP_FAILED);
+}
+
+TEST(mmap, many_mappings) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    char* mappings[mapping_count];
+    for (int i = 0; i < mapping_count; i++) {
+        map_anonymous(&mappings[i], page_size);
+        mappings[i][0] = static_cast<char>(i);
+    }
+
+    // Unmap every other mapping, and fill the holes with new mappings, which must not overlap the remaining ones.
+    for (int i = 0; i < mapping_count; i += 2) {
+        EXPECT_EQ(munmap(mappings[i], page_size), 0);
+    }
+    for (int i = 0; i < mapping_count; i += 2) {
+        map_anonymous(&mappings[i], page_size);
+        mappings[i][0] = static_cast<char>(i);
+    }
+
+    for (int i = 0; i < mapping_count; i++) {
+        EXPECT_EQ(mappings[i][0], static_cast<char>(i));
+    }
+    for (int i = 0; i < mapping_count; i++) {
+        EXPECT_EQ(munmap(mappings[i], page_size), 0);
+    }
+}
+
+TEST(mmap, guard_gap) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    // Anonymous mappings placed by the kernel are separated by unmapped pages, so running off the end of one faults.
+    char* first;
+    char* second;
+    map_anonymous(&first, page_size);
+    map_anonymous(&second, page_size);
+    EXPECT_NOT_EQ(second, first + page_size);
+    EXPECT_NOT_EQ(first, second + page_size);
+
+    EXPECT_EQ(munmap(first, page_size), 0);
+    EXPECT_EQ(munmap(second, page_size), 0);
+}
+
+TEST(mmap, split_mapping) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    char* mapping;
+    map_anonymous(&mapping, 8 * page_size);
+    for (size_t i = 0; i < 8; i++) {
+        mapping[i * page_size] = static_cast<char>(i);
+    }
+
+    // Splits the mapping into three parts, and then the last part into two more.
+    EXPECT_EQ(munmap(mapping + 2 * page_size, page_size), 0);
+    EXPECT_EQ(mprotect(mapping + 5 * page_size, page_size, PROT_READ), 0);
+
+    for (size_t i = 0; i < 8; i++) {
+        if (i != 2) {
+            EXPECT_EQ(mapping[i * page_size], static_cast<char>(i));
+        }
+    }
+
+    auto* fixed = static_cast<char*>(mmap(mapping + 2 * page_size, page_size, PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0));
+    EXPECT_EQ(fixed, mapping + 2 * page_size);
+    EXPECT_EQ(fixed[0], 0);
+
+    EXPECT_EQ(munmap(mapping, 8 * page_size), 0);
+}
+
+TEST(mmap, fork) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    char* mappings[mapping_count];
+    for (int i = 0; i < mapping_count; i++) {
+        map_anonymous(&mappings[i], page_size);
+        mappings[i][0] = static_cast<char>(i);
+    }
+
+    pid_t pid = fork();
+    EXPECT(pid >= 0);
+    if (pid == 0) {
+        for (int i = 0; i < mapping_count; i++) {
+            if (mappings[i][0] != static_cast<char>(i)) {
+                _exit(1);
+            }
+            mappings[i][0] = 0;
+        }
+        _exit(0);
+    }
+
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    for (int i = 0; i < mapping_count; i++) {
+        EXPECT_EQ(mappings[i][0], static_cast<char>(i));
+        EXPECT_EQ(munmap(mappings[i], page_size), 0);
+    }
+}
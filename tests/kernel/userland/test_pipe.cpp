@@ -0,0 +1,126 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <test/test.h>
+#include <unistd.h>
+
+static void close_pipe(int* fds) {
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(pipe, capacity) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+
+    EXPECT(fcntl(fds[0], F_GETPIPE_SZ) >= page_size);
+    EXPECT_EQ(fcntl(fds[1], F_SETPIPE_SZ, 64 * page_size), 64 * page_size);
+    EXPECT_EQ(fcntl(fds[0], F_GETPIPE_SZ), 64 * page_size);
+
+    // Capacities are rounded up to a power of two number of pages.
+    EXPECT_EQ(fcntl(fds[1], F_SETPIPE_SZ, 3 * page_size), 4 * page_size);
+
+    // The whole capacity can be written without blocking, and no more.
+    EXPECT_EQ(fcntl(fds[1], F_SETFL, O_NONBLOCK), 0);
+    auto* page = new char[page_size];
+    memset(page, 'x', page_size);
+    long written = 0;
+    for (ssize_t ret; (ret = write(fds[1], page, page_size)) > 0;) {
+        written += ret;
+    }
+    EXPECT_EQ(errno, EAGAIN);
+    EXPECT_EQ(written, 4 * page_size);
+    delete[] page;
+
+    // The pipe cannot shrink below the data it holds.
+    EXPECT_EQ(fcntl(fds[1], F_SETPIPE_SZ, page_size), -1);
+    EXPECT_EQ(errno, EBUSY);
+
+    close_pipe(fds);
+}
+
+TEST(pipe, splice_file) {
+    const char* in_path = "/tmp/test_pipe_splice_in";
+    const char* out_path = "/tmp/test_pipe_splice_out";
+    size_t size = 3 * sysconf(_SC_PAGESIZE) + 123;
+
+    auto* data = new char[size];
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<char>(i * 7 + i / 13);
+    }
+    int in = open(in_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    EXPECT(in >= 0);
+    EXPECT_EQ(write(in, data, size), static_cast<ssize_t>(size));
+    int out = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    EXPECT(out >= 0);
+
+    // Move the file through the pipe, starting from an offset, and write it out at the same offset.
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+    off_t in_offset = 100;
+    off_t out_offset = 100;
+    while (static_cast<size_t>(in_offset) < size) {
+        ssize_t spliced = splice(in, &in_offset, fds[1], nullptr, size, 0);
+        EXPECT(spliced > 0);
+        for (ssize_t moved = 0; moved < spliced;) {
+            ssize_t ret = splice(fds[0], nullptr, out, &out_offset, spliced - moved, 0);
+            EXPECT(ret > 0);
+            moved += ret;
+        }
+    }
+    EXPECT_EQ(in_offset, static_cast<off_t>(size));
+    EXPECT_EQ(out_offset, static_cast<off_t>(size));
+
+    auto* result = new char[size];
+    EXPECT_EQ(pread(out, result, size - 100, 100), static_cast<ssize_t>(size - 100));
+    EXPECT_EQ(memcmp(result, data + 100, size - 100), 0);
+
+    delete[] data;
+    delete[] result;
+    close_pipe(fds);
+    close(in);
+    close(out);
+    unlink(in_path);
+    unlink(out_path);
+}
+
+TEST(pipe, splice_pipe) {
+    int first[2];
+    int second[2];
+    EXPECT_EQ(pipe(first), 0);
+    EXPECT_EQ(pipe(second), 0);
+
+    EXPECT_EQ(write(first[1], "hello world", 11), 11);
+    EXPECT_EQ(splice(first[0], nullptr, second[1], nullptr, 5, 0), 5);
+
+    char buffer[16] = {};
+    EXPECT_EQ(read(second[0], buffer, sizeof(buffer)), 5);
+    EXPECT_EQ(memcmp(buffer, "hello", 5), 0);
+    EXPECT_EQ(read(first[0], buffer, sizeof(buffer)), 6);
+    EXPECT_EQ(memcmp(buffer, " world", 6), 0);
+
+    close_pipe(first);
+    close_pipe(second);
+}
+
+TEST(pipe, tee) {
+    int first[2];
+    int second[2];
+    EXPECT_EQ(pipe(first), 0);
+    EXPECT_EQ(pipe(second), 0);
+
+    // The data is duplicated into the second pipe, and stays in the first.
+    EXPECT_EQ(write(first[1], "hello world", 11), 11);
+    EXPECT_EQ(tee(first[0], second[1], 64, 0), 11);
+
+    char buffer[16] = {};
+    EXPECT_EQ(read(second[0], buffer, sizeof(buffer)), 11);
+    EXPECT_EQ(memcmp(buffer, "hello world", 11), 0);
+    memset(buffer, 0, sizeof(buffer));
+    EXPECT_EQ(read(first[0], buffer, sizeof(buffer)), 11);
+    EXPECT_EQ(memcmp(buffer, "hello world", 11), 0);
+
+    close_pipe(first);
+    close_pipe(second);
+}
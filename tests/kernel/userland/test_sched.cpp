@@ -0,0 +1,55 @@
+#include <errno.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <test/test.h>
+#include <unistd.h>
+
+TEST(sched, affinity) {
+    cpu_set_t saved;
+    EXPECT_EQ(sched_getaffinity(0, sizeof(saved), &saved), 0);
+    EXPECT(CPU_ISSET(0, &saved));
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(0, &set);
+    EXPECT_EQ(sched_setaffinity(0, sizeof(set), &set), 0);
+
+    // The affinity is inherited across fork.
+    pid_t pid = fork();
+    EXPECT(pid >= 0);
+    if (pid == 0) {
+        cpu_set_t child_set;
+        if (sched_getaffinity(0, sizeof(child_set), &child_set) || CPU_COUNT(&child_set) != 1 || !CPU_ISSET(0, &child_set)) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    CPU_ZERO(&set);
+    EXPECT_EQ(sched_setaffinity(0, sizeof(set), &set), -1);
+    EXPECT_EQ(errno, EINVAL);
+
+    EXPECT_EQ(sched_setaffinity(0, sizeof(saved), &saved), 0);
+}
+
+TEST(sched, scheduler) {
+    sched_param param = {};
+    EXPECT_EQ(sched_setscheduler(0, SCHED_OTHER, &param), 0);
+    EXPECT_EQ(sched_getscheduler(0), SCHED_OTHER);
+    EXPECT_EQ(sched_getparam(0, &param), 0);
+    EXPECT_EQ(param.sched_priority, 0);
+
+    // Real-time policies need a priority in range.
+    param.sched_priority = 0;
+    EXPECT_EQ(sched_setscheduler(0, SCHED_FIFO, &param), -1);
+    EXPECT_EQ(errno, EINVAL);
+    EXPECT_EQ(sched_get_priority_min(SCHED_RR), 1);
+    EXPECT_EQ(sched_get_priority_max(SCHED_RR), 99);
+
+    EXPECT_EQ(sched_yield(), 0);
+}
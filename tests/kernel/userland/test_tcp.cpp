@@ -0,0 +1,139 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <test/test.h>
+#include <unistd.h>
+
+constexpr size_t transfer_size = 4 * 1024 * 1024;
+constexpr size_t chunk_size = 16 * 1024;
+
+static char pattern_byte(size_t offset) {
+    return static_cast<char>(offset * 13 + offset / 4096);
+}
+
+static int make_socket(const char* device) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && device && setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, device, strlen(device) + 1)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool device_exists(const char* device) {
+    int fd = make_socket(device);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+// Sends transfer_size bytes of a known pattern from a child process to this one, and checks that every byte arrives
+// in order.
+static void transfer(const char* device, const char* congestion) {
+    int listener = make_socket(device);
+    EXPECT(listener >= 0);
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    EXPECT_EQ(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    EXPECT_EQ(listen(listener, 1), 0);
+    socklen_t addr_length = sizeof(addr);
+    EXPECT_EQ(getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &addr_length), 0);
+
+    pid_t pid = fork();
+    EXPECT(pid >= 0);
+    if (pid == 0) {
+        int fd = make_socket(device);
+        if (fd < 0 || setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, congestion, strlen(congestion) + 1) ||
+            connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+            _exit(1);
+        }
+
+        char chunk[chunk_size];
+        for (size_t offset = 0; offset < transfer_size; offset += chunk_size) {
+            for (size_t i = 0; i < chunk_size; i++) {
+                chunk[i] = pattern_byte(offset + i);
+            }
+            for (size_t written = 0; written < chunk_size;) {
+                ssize_t ret = write(fd, chunk + written, chunk_size - written);
+                if (ret <= 0) {
+                    _exit(1);
+                }
+                written += ret;
+            }
+        }
+        close(fd);
+        _exit(0);
+    }
+
+    int fd = accept(listener, nullptr, nullptr);
+    EXPECT(fd >= 0);
+
+    char chunk[chunk_size];
+    size_t received = 0;
+    size_t mismatches = 0;
+    for (;;) {
+        ssize_t ret = read(fd, chunk, chunk_size);
+        EXPECT(ret >= 0);
+        if (ret == 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < ret; i++) {
+            if (chunk[i] != pattern_byte(received + i)) {
+                mismatches++;
+            }
+        }
+        received += ret;
+    }
+    EXPECT_EQ(received, transfer_size);
+    EXPECT_EQ(mismatches, 0u);
+
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    close(fd);
+    close(listener);
+}
+
+TEST(tcp, congestion_option) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    EXPECT(fd >= 0);
+
+    char name[16] = {};
+    socklen_t length = sizeof(name);
+    EXPECT_EQ(setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, "cubic", 6), 0);
+    EXPECT_EQ(getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, name, &length), 0);
+    EXPECT_EQ(strcmp(name, "cubic"), 0);
+
+    EXPECT_EQ(setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, "reno", 5), 0);
+    length = sizeof(name);
+    EXPECT_EQ(getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, name, &length), 0);
+    EXPECT_EQ(strcmp(name, "reno"), 0);
+
+    EXPECT_EQ(setsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, "unknown", 8), -1);
+    EXPECT_EQ(errno, ENOENT);
+
+    close(fd);
+}
+
+TEST(tcp, loopback_transfer) {
+    transfer(nullptr, "cubic");
+    transfer(nullptr, "reno");
+}
+
+TEST(tcp, lossy_transfer) {
+    // The lossy interface drops some packets, so the data only all arrives if loss recovery works. It only exists when the
+    // kernel is booted with lossy_loopback=1, which scripts/run-test.sh always passes.
+    EXPECT(device_exists("lossy"));
+    transfer("lossy", "cubic");
+    transfer("lossy", "reno");
+}
@@ -0,0 +1,103 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures malloc()/free() throughput for a few common allocation patterns, with an increasing
+// number of threads. Running with MALLOC_NO_THREAD_CACHE=1 (or passing -n, which re-runs this
+// program with it set) sends every allocation through the locked central lists, which shows
+// what the per-thread caches are worth.
+
+constexpr int max_thread_count = 8;
+constexpr int live_slot_count = 1024;
+
+struct Workload {
+    const char* name;
+    size_t (*pick_size)(uint32_t random);
+    int iterations;
+};
+
+static uint32_t next_random(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Workload workloads[] = {
+    { "small (16-128 B)", [](uint32_t r) -> size_t { return 16 + r % 113; }, 1000000 },
+    { "medium (128 B-4 KiB)", [](uint32_t r) -> size_t { return 128 + r % 3969; }, 500000 },
+    { "mixed (90% small, 10% up to 64 KiB)", [](uint32_t r) -> size_t { return r % 10 ? 16 + r % 241 : 1 + r % 65536; }, 250000 },
+    { "large (64 KiB-256 KiB)", [](uint32_t r) -> size_t { return 65536 + r % 196609; }, 20000 },
+};
+
+struct ThreadArgs {
+    const Workload* workload;
+    uint32_t seed;
+};
+
+static void* run_workload(void* closure) {
+    auto& args = *static_cast<ThreadArgs*>(closure);
+    auto state = args.seed;
+
+    void* slots[live_slot_count] = {};
+    for (int i = 0; i < args.workload->iterations; i++) {
+        auto random = next_random(state);
+        auto& slot = slots[random % live_slot_count];
+        free(slot);
+
+        auto size = args.workload->pick_size(next_random(state));
+        slot = malloc(size);
+        *static_cast<volatile char*>(slot) = 1;
+    }
+
+    for (auto* slot : slots) {
+        free(slot);
+    }
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "-n") == 0 && !getenv("MALLOC_NO_THREAD_CACHE")) {
+        setenv("MALLOC_NO_THREAD_CACHE", "1", 1);
+        execv(argv[0], argv);
+        perror("bench_malloc: execv");
+        return 1;
+    }
+
+    printf("thread cache: %s\n", getenv("MALLOC_NO_THREAD_CACHE") ? "disabled" : "enabled");
+    printf("%-40s %8s %12s %14s\n", "workload", "threads", "seconds", "Mops/s");
+    for (auto& workload : workloads) {
+        for (int thread_count = 1; thread_count <= max_thread_count; thread_count *= 2) {
+            pthread_t threads[max_thread_count];
+            ThreadArgs args[max_thread_count];
+
+            auto start = now_seconds();
+            for (int i = 0; i < thread_count; i++) {
+                args[i] = { &workload, 0x9E3779B9u * (i + 1) };
+                if (pthread_create(&threads[i], nullptr, run_workload, &args[i])) {
+                    perror("bench_malloc: pthread_create");
+                    return 1;
+                }
+            }
+            for (int i = 0; i < thread_count; i++) {
+                pthread_join(threads[i], nullptr);
+            }
+            auto elapsed = now_seconds() - start;
+
+            // Each iteration performs one malloc() and one free().
+            auto operations = 2.0 * workload.iterations * thread_count;
+            printf("%-40s %8d %12.3f %14.3f\n", workload.name, thread_count, elapsed, operations / elapsed / 1e6);
+        }
+    }
+    return 0;
+}
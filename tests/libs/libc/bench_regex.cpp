@@ -0,0 +1,178 @@
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Measures regexec() over two kinds of workloads. The grep-like cases search every line of a generated log, where most
+// lines do not match, and report throughput. The pathological cases are patterns which take exponential time with a
+// backtracking matcher, and report the time for a single call as the subject grows.
+
+constexpr size_t line_count = 20000;
+constexpr size_t pathological_sizes[] = { 8, 16, 24, 32, 256, 4096 };
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static regex_t compile(const char* pattern, int cflags) {
+    regex_t regex;
+    int error = regcomp(&regex, pattern, cflags);
+    if (error != 0) {
+        char message[256];
+        regerror(error, &regex, message, sizeof(message));
+        fprintf(stderr, "bench_regex: regcomp(\"%s\"): %s\n", pattern, message);
+        exit(1);
+    }
+    return regex;
+}
+
+static char** generate_lines() {
+    static const char* levels[] = { "debug", "info", "info", "info", "warning", "error" };
+    static const char* words[] = {
+        "starting", "connection", "request", "timeout", "reading", "buffer", "flushed", "client", "GET", "POST",
+    };
+
+    auto** lines = static_cast<char**>(malloc(line_count * sizeof(char*)));
+    unsigned int seed = 1;
+    for (size_t i = 0; i < line_count; i++) {
+        char line[256];
+        seed = seed * 1103515245 + 12345;
+        int length = snprintf(line, sizeof(line), "2023-01-%02u %s: %s", seed % 28 + 1, levels[(seed >> 8) % 6], words[(seed >> 12) % 10]);
+        for (int j = 0; j < 8; j++) {
+            seed = seed * 1103515245 + 12345;
+            length += snprintf(line + length, sizeof(line) - length, " %s%u", words[(seed >> 16) % 10], seed % 1000);
+        }
+        if ((seed >> 20) % 50 == 0) {
+            snprintf(line + length, sizeof(line) - length, " /index.html");
+        }
+        lines[i] = strdup(line);
+    }
+    return lines;
+}
+
+struct LineBenchmark {
+    const char* pattern;
+    int cflags;
+    size_t nmatch;
+};
+
+static LineBenchmark line_benchmarks[] = {
+    { "timeout", REG_EXTENDED, 1 },
+    { "error: .*timeout", REG_EXTENDED, 1 },
+    { "[a-z]+ing[0-9]+", REG_EXTENDED, 1 },
+    { "^2023-01-(0[1-9]) (warning|error):", REG_EXTENDED, 3 },
+    { "(GET|POST)[0-9]* .*\\.html$", REG_EXTENDED, 0 },
+    { "CLIENT[0-9]+ flushed", REG_EXTENDED | REG_ICASE, 1 },
+};
+
+static void run_line_benchmarks() {
+    auto** lines = generate_lines();
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < line_count; i++) {
+        total_bytes += strlen(lines[i]);
+    }
+
+    printf("%-40s %8s %10s %10s\n", "pattern", "matches", "ms", "MB/s");
+    for (auto& benchmark : line_benchmarks) {
+        auto regex = compile(benchmark.pattern, benchmark.cflags);
+        regmatch_t matches[4];
+
+        size_t match_count = 0;
+        auto start = now_seconds();
+        for (size_t i = 0; i < line_count; i++) {
+            if (regexec(&regex, lines[i], benchmark.nmatch, matches, 0) == 0) {
+                match_count++;
+            }
+        }
+        auto elapsed = now_seconds() - start;
+        printf("%-40s %8zu %10.2f %10.2f\n", benchmark.pattern, match_count, elapsed * 1e3, total_bytes / elapsed / 1e6);
+        regfree(&regex);
+    }
+
+    for (size_t i = 0; i < line_count; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+}
+
+struct PathologicalBenchmark {
+    const char* name;
+    // Writes the pattern and the subject for size n.
+    void (*generate)(size_t n, char* pattern, char* subject);
+};
+
+static PathologicalBenchmark pathological_benchmarks[] = {
+    { "(a*)*b",
+      [](size_t n, char* pattern, char* subject) {
+          strcpy(pattern, "(a*)*b");
+          memset(subject, 'a', n);
+          subject[n] = '\0';
+      } },
+    { "(a|aa)*c",
+      [](size_t n, char* pattern, char* subject) {
+          strcpy(pattern, "(a|aa)*c");
+          memset(subject, 'a', n);
+          subject[n] = '\0';
+      } },
+    { "(x+x+)+y",
+      [](size_t n, char* pattern, char* subject) {
+          strcpy(pattern, "(x+x+)+y");
+          memset(subject, 'x', n);
+          subject[n] = '\0';
+      } },
+    { "a?{n}a{n}",
+      [](size_t n, char* pattern, char* subject) {
+          // Counted repetitions grow the compiled regex, so cap n in the pattern.
+          size_t count = n < 32 ? n : 32;
+          char* p = pattern;
+          for (size_t i = 0; i < count; i++) {
+              p = stpcpy(p, "a?");
+          }
+          for (size_t i = 0; i < count; i++) {
+              *p++ = 'a';
+          }
+          *p = '\0';
+          memset(subject, 'a', count);
+          subject[count] = '\0';
+      } },
+};
+
+static void run_pathological_benchmarks() {
+    // Subjects long enough to take exponential time are skipped once a single call takes this long.
+    constexpr double give_up_seconds = 2.0;
+
+    auto* pattern = static_cast<char*>(malloc(256));
+    auto* subject = static_cast<char*>(malloc(pathological_sizes[sizeof(pathological_sizes) / sizeof(*pathological_sizes) - 1] + 1));
+
+    printf("\n%-40s %8s %12s\n", "pattern", "n", "us/call");
+    for (auto& benchmark : pathological_benchmarks) {
+        for (auto n : pathological_sizes) {
+            benchmark.generate(n, pattern, subject);
+            auto regex = compile(pattern, REG_EXTENDED);
+            regmatch_t matches[2];
+
+            auto start = now_seconds();
+            regexec(&regex, subject, 2, matches, 0);
+            auto elapsed = now_seconds() - start;
+            regfree(&regex);
+
+            printf("%-40s %8zu %12.2f\n", benchmark.name, n, elapsed * 1e6);
+            if (elapsed > give_up_seconds) {
+                printf("%-40s %8s\n", benchmark.name, "skipped");
+                break;
+            }
+        }
+    }
+
+    free(pattern);
+    free(subject);
+}
+
+int main() {
+    run_line_benchmarks();
+    run_pathological_benchmarks();
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Measures the throughput of the core string and memory primitives over a sweep of buffer
+// sizes and source alignments. Small sizes mostly measure call and dispatch overhead, while
+// large sizes measure the inner loops.
+
+constexpr size_t sizes[] = { 8, 16, 32, 64, 128, 256, 1024, 4096, 65536, 1048576 };
+constexpr size_t alignments[] = { 0, 1, 7, 15, 31 };
+constexpr size_t bytes_per_measurement = 64 * 1024 * 1024;
+constexpr size_t buffer_size = 1048576 + 64;
+
+static unsigned char* source;
+static unsigned char* destination;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Keeps the compiler from discarding calls whose results are otherwise unused.
+template<typename T>
+static void keep(T value) {
+    asm volatile("" : : "r"(value) : "memory");
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)(size_t alignment, size_t size);
+};
+
+static Benchmark benchmarks[] = {
+    { "memcpy", [](size_t alignment, size_t size) { keep(memcpy(destination, source + alignment, size)); } },
+    { "memset", [](size_t alignment, size_t size) { keep(memset(destination + alignment, 'a', size)); } },
+    { "memchr", [](size_t alignment, size_t size) { keep(memchr(source + alignment, '\n', size)); } },
+    { "memcmp", [](size_t alignment, size_t size) { keep(memcmp(source + alignment, destination + alignment, size)); } },
+    { "strlen",
+      [](size_t alignment, size_t size) {
+          source[alignment + size - 1] = '\0';
+          keep(strlen(reinterpret_cast<char*>(source + alignment)));
+          source[alignment + size - 1] = 'a';
+      } },
+    { "strchr",
+      [](size_t alignment, size_t size) {
+          source[alignment + size - 1] = '\0';
+          keep(strchr(reinterpret_cast<char*>(source + alignment), '\n'));
+          source[alignment + size - 1] = 'a';
+      } },
+};
+
+int main() {
+    source = static_cast<unsigned char*>(aligned_alloc(64, buffer_size));
+    destination = static_cast<unsigned char*>(aligned_alloc(64, buffer_size));
+    if (!source || !destination) {
+        perror("bench_string: aligned_alloc");
+        return 1;
+    }
+    memset(source, 'a', buffer_size);
+    memset(destination, 'a', buffer_size);
+
+    printf("%-8s %10s %6s %12s %10s\n", "function", "size", "align", "ns/call", "GB/s");
+    for (auto& benchmark : benchmarks) {
+        for (auto size : sizes) {
+            for (auto alignment : alignments) {
+                size_t iterations = bytes_per_measurement / size;
+
+                auto start = now_seconds();
+                for (size_t i = 0; i < iterations; i++) {
+                    benchmark.run(alignment, size);
+                }
+                auto elapsed = now_seconds() - start;
+
+                printf("%-8s %10zu %6zu %12.2f %10.2f\n", benchmark.name, size, alignment, elapsed / iterations * 1e9,
+                       (double) size * iterations / elapsed / 1e9);
+            }
+        }
+    }
+
+    free(source);
+    free(destination);
+    return 0;
+}
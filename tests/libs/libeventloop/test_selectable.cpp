@@ -0,0 +1,74 @@
+#include <eventloop/event_loop.h>
+#include <eventloop/selectable.h>
+#include <eventloop/timer.h>
+#include <test/test.h>
+#include <unistd.h>
+
+TEST(selectable, readable) {
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+
+    {
+        auto loop = App::EventLoop {};
+
+        auto selectable = App::FdWrapper::create(nullptr, fds[0]);
+        selectable->set_selected_events(App::NotifyWhen::Readable);
+        selectable->enable_notifications();
+
+        int count = 0;
+        selectable->on<App::ReadableEvent>({}, [&](auto&) {
+            char c;
+            EXPECT_EQ(read(fds[0], &c, 1), 1);
+            if (++count >= 3) {
+                loop.set_should_exit(true);
+                return;
+            }
+            EXPECT_EQ(write(fds[1], "a", 1), 1);
+        });
+
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        loop.enter();
+        EXPECT_EQ(count, 3);
+
+        // Once notifications are disabled, the pipe is no longer watched.
+        selectable->disable_notifications();
+        auto timer = App::Timer::create_single_shot_timer(nullptr, 50);
+        timer->on<App::TimerEvent>({}, [&](auto&) {
+            loop.set_should_exit(true);
+        });
+
+        EXPECT_EQ(write(fds[1], "a", 1), 1);
+        loop.set_should_exit(false);
+        loop.enter();
+        EXPECT_EQ(count, 3);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(selectable, writable_after_update) {
+    int fds[2];
+    EXPECT_EQ(pipe(fds), 0);
+
+    {
+        auto loop = App::EventLoop {};
+
+        auto selectable = App::FdWrapper::create(nullptr, fds[1]);
+        selectable->set_selected_events(App::NotifyWhen::Readable);
+        selectable->enable_notifications();
+
+        // Changing the selected events of a registered selectable takes effect immediately.
+        bool writable = false;
+        selectable->on<App::WritableEvent>({}, [&](auto&) {
+            writable = true;
+            loop.set_should_exit(true);
+        });
+        selectable->set_selected_events(App::NotifyWhen::Writeable);
+        loop.enter();
+        EXPECT(writable);
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+}
@@ -0,0 +1,90 @@
+#include <ext/checksum.h>
+#include <liim/vector.h>
+#include <stdio.h>
+#include <time.h>
+
+// Measures the throughput of the CRC32 and Adler32 checksums over a range of buffer sizes, since gzip and zlib checksum
+// whatever the decoder produces at once, which can be anything from a few bytes to a whole output buffer. Each result is
+// checked against a byte at a time reference, whose throughput is reported alongside.
+
+constexpr size_t buffer_sizes[] = { 16, 64, 256, 1024, 4096, 65536, 1024 * 1024 };
+constexpr size_t min_bytes_per_measurement = 256 * 1024 * 1024;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t reference_crc32(const void* data, size_t size) {
+    auto* bytes = static_cast<const uint8_t*>(data);
+    uint32_t crc = ~0U;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t reference_adler32(const void* data, size_t size) {
+    auto* bytes = static_cast<const uint8_t*>(data);
+    uint32_t s1 = 1;
+    uint32_t s2 = 0;
+    for (size_t i = 0; i < size; i++) {
+        s1 = (s1 + bytes[i]) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    return (s2 << 16) | s1;
+}
+
+// The checksums are stored here so that the calls can't be optimized away.
+static volatile uint32_t s_sink;
+
+// Returns the throughput in MB/s.
+static double measure(uint32_t (*checksum)(const void*, size_t), const uint8_t* data, size_t size, size_t total_bytes) {
+    size_t iterations = max<size_t>(1, total_bytes / size);
+    double start = now_seconds();
+    for (size_t i = 0; i < iterations; i++) {
+        s_sink = checksum(data, size);
+    }
+    double seconds = now_seconds() - start;
+    return iterations * size / (1024.0 * 1024.0) / seconds;
+}
+
+int main() {
+    size_t max_size = buffer_sizes[sizeof(buffer_sizes) / sizeof(buffer_sizes[0]) - 1];
+    Vector<uint8_t> data(max_size);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < max_size; i++) {
+        seed = seed * 1103515245 + 12345;
+        data.add(seed >> 24);
+    }
+
+    bool ok = true;
+    printf("%-8s %8s %12s %16s\n", "checksum", "size", "MB/s", "reference MB/s");
+    for (auto size : buffer_sizes) {
+        struct {
+            const char* name;
+            uint32_t (*checksum)(const void*, size_t);
+            uint32_t (*reference)(const void*, size_t);
+        } checksums[] = {
+            { "crc32", compute_crc32_checksum, reference_crc32 },
+            { "adler32", compute_adler32_checksum, reference_adler32 },
+        };
+
+        for (auto& checksum : checksums) {
+            if (checksum.checksum(data.vector(), size) != checksum.reference(data.vector(), size)) {
+                fprintf(stderr, "bench_checksum: %s of %zu bytes does not match the reference\n", checksum.name, size);
+                ok = false;
+            }
+
+            // The reference is far slower, so it gets less data to keep the run short.
+            auto speed = measure(checksum.checksum, data.vector(), size, min_bytes_per_measurement);
+            auto reference_speed = measure(checksum.reference, data.vector(), size, min_bytes_per_measurement / 16);
+            printf("%-8s %8zu %12.1f %16.1f\n", checksum.name, size, speed, reference_speed);
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+#include <ext/deflate.h>
+#include <ext/mapped_file.h>
+#include <liim/vector.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+// Measures the compression ratio and the compression and decompression throughput of every deflate level, and checks
+// that the output decompresses back to the input. The corpus is either the files named on the command line, or a set
+// of generated inputs: text-like data, binary data with some structure, and long runs.
+
+constexpr size_t generated_size = 4 * 1024 * 1024;
+constexpr size_t chunk_size = 65536;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Input {
+    const char* name;
+    Vector<uint8_t> data;
+};
+
+static uint32_t next_random(uint32_t& seed) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+static Vector<uint8_t> generate_text() {
+    static const char* words[] = { "the ",   "of ",     "and ",      "to ",    "in ",       "is ",    "that ",  "for ",
+                                   "it ",    "with ",   "as ",       "was ",   "on ",       "stream", "buffer", "deflate ",
+                                   "window", "length ", "distance ", "block ", "huffman ",  "code ",  ", ",     ".\n" };
+    Vector<uint8_t> data(generated_size);
+    uint32_t seed = 1;
+    while (static_cast<size_t>(data.size()) < generated_size) {
+        // Skew the distribution so that some words are much more common than others.
+        auto index = (next_random(seed) % 24) * (next_random(seed) % 24) / 24;
+        for (auto* c = words[index]; *c; c++) {
+            data.add(*c);
+        }
+    }
+    return data;
+}
+
+static Vector<uint8_t> generate_binary() {
+    Vector<uint8_t> data(generated_size);
+    uint32_t seed = 2;
+    uint32_t value = 0;
+    while (static_cast<size_t>(data.size()) < generated_size) {
+        // Slowly changing little endian integers, like a table of offsets.
+        value += next_random(seed) % 256;
+        for (int i = 0; i < 4; i++) {
+            data.add(value >> (8 * i));
+        }
+        if (next_random(seed) % 8 == 0) {
+            data.add(next_random(seed));
+        }
+    }
+    return data;
+}
+
+static Vector<uint8_t> generate_runs() {
+    Vector<uint8_t> data(generated_size);
+    uint32_t seed = 3;
+    while (static_cast<size_t>(data.size()) < generated_size) {
+        auto byte = next_random(seed) % 4;
+        auto length = next_random(seed) % 512;
+        for (size_t i = 0; i < length; i++) {
+            data.add(byte);
+        }
+    }
+    return data;
+}
+
+static Vector<uint8_t> compress(int level, const Vector<uint8_t>& input) {
+    Ext::DeflateEncoder encoder(level);
+    Vector<uint8_t> output(input.size() + input.size() / 8 + 1024);
+    uint8_t buffer[chunk_size];
+    encoder.set_output({ buffer, sizeof(buffer) });
+
+    auto flush_output = [&] {
+        for (size_t i = 0; i < encoder.writer().bytes_written(); i++) {
+            output.add(buffer[i]);
+        }
+        encoder.did_flush_output();
+    };
+
+    size_t input_size = input.size();
+    for (size_t offset = 0;; offset += chunk_size) {
+        auto size = offset < input_size ? min(chunk_size, input_size - offset) : 0;
+        auto flush_mode = size == 0 ? Ext::StreamFlushMode::StreamFlush : Ext::StreamFlushMode::NoFlush;
+        auto result = encoder.stream_data({ input.vector() + offset, size }, flush_mode);
+        while (result == Ext::StreamResult::NeedsMoreOutputSpace) {
+            flush_output();
+            result = encoder.resume();
+        }
+        flush_output();
+        if (size == 0) {
+            return output;
+        }
+    }
+}
+
+static bool decompress(const Vector<uint8_t>& input, const Vector<uint8_t>& expected) {
+    Ext::DeflateDecoder decoder;
+    uint8_t buffer[chunk_size];
+    decoder.set_output({ buffer, sizeof(buffer) });
+
+    size_t expected_offset = 0;
+    bool matches = true;
+    auto check_output = [&] {
+        size_t size = decoder.writer().bytes_written();
+        if (expected_offset + size > static_cast<size_t>(expected.size()) ||
+            memcmp(buffer, expected.vector() + expected_offset, size) != 0) {
+            matches = false;
+        }
+        expected_offset += size;
+        decoder.did_flush_output();
+    };
+
+    auto result = decoder.stream_data({ input.vector(), static_cast<size_t>(input.size()) });
+    while (result == Ext::StreamResult::NeedsMoreOutputSpace) {
+        check_output();
+        result = decoder.resume();
+    }
+    check_output();
+    return result == Ext::StreamResult::Success && matches && expected_offset == static_cast<size_t>(expected.size());
+}
+
+int main(int argc, char** argv) {
+    Vector<Input> inputs;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            auto file = Ext::try_map_file(argv[i], PROT_READ, MAP_PRIVATE);
+            if (!file) {
+                fprintf(stderr, "bench_deflate: failed to map `%s'\n", argv[i]);
+                return 1;
+            }
+
+            Vector<uint8_t> data(file->size());
+            for (size_t j = 0; j < file->size(); j++) {
+                data.add(file->data()[j]);
+            }
+            inputs.add({ argv[i], move(data) });
+        }
+    } else {
+        inputs.add({ "text", generate_text() });
+        inputs.add({ "binary", generate_binary() });
+        inputs.add({ "runs", generate_runs() });
+    }
+
+    bool ok = true;
+    printf("%-12s %5s %10s %8s %12s %12s\n", "input", "level", "size", "ratio", "deflate MB/s", "inflate MB/s");
+    for (auto& input : inputs) {
+        double megabytes = input.data.size() / (1024.0 * 1024.0);
+        for (int level = Ext::DeflateEncoder::min_level; level <= Ext::DeflateEncoder::max_level; level++) {
+            double start = now_seconds();
+            auto compressed = compress(level, input.data);
+            double compress_seconds = now_seconds() - start;
+
+            start = now_seconds();
+            bool round_trips = decompress(compressed, input.data);
+            double decompress_seconds = now_seconds() - start;
+
+            printf("%-12s %5d %10d %7.2f%% %12.1f %12.1f%s\n", input.name, level, compressed.size(),
+                   100.0 * compressed.size() / max(input.data.size(), 1), megabytes / compress_seconds, megabytes / decompress_seconds,
+                   round_trips ? "" : "  round trip FAILED");
+            ok &= round_trips;
+        }
+    }
+    return ok ? 0 : 1;
+}
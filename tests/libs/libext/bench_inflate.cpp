@@ -0,0 +1,178 @@
+#include <arpa/inet.h>
+#include <ext/checksum.h>
+#include <ext/deflate.h>
+#include <ext/gzip.h>
+#include <ext/mapped_file.h>
+#include <ext/zlib_stream.h>
+#include <liim/vector.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+// Measures decompression throughput of the deflate, gzip and zlib decoders. Each input is compressed at a few levels,
+// since faster levels produce more literals and shorter matches, and then decompressed with both a large and a small
+// output buffer, since small buffers force the decoder to stop and resume often. The corpus is either the files named on
+// the command line, or generated text.
+
+constexpr size_t generated_size = 8 * 1024 * 1024;
+constexpr size_t input_chunk_size = 65536;
+constexpr size_t min_bytes_per_measurement = 32 * 1024 * 1024;
+constexpr int levels[] = { 1, 6, 9 };
+constexpr size_t output_buffer_sizes[] = { 65536, 512 };
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Input {
+    const char* name;
+    Vector<uint8_t> data;
+};
+
+static Vector<uint8_t> generate_text() {
+    static const char* words[] = { "the ",   "of ",     "and ",      "to ",    "in ",      "is ",    "that ",  "for ",
+                                   "it ",    "with ",   "as ",       "was ",   "on ",      "stream", "buffer", "deflate ",
+                                   "window", "length ", "distance ", "block ", "huffman ", "code ",  ", ",     ".\n" };
+    Vector<uint8_t> data(generated_size);
+    uint32_t seed = 1;
+    auto next_random = [&] {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 16;
+    };
+    while (static_cast<size_t>(data.size()) < generated_size) {
+        auto index = (next_random() % 24) * (next_random() % 24) / 24;
+        for (auto* c = words[index]; *c; c++) {
+            data.add(*c);
+        }
+    }
+    return data;
+}
+
+static Vector<uint8_t> deflate(const Vector<uint8_t>& input, int level) {
+    Ext::DeflateEncoder encoder(level);
+    Vector<uint8_t> output(input.size());
+    uint8_t buffer[65536];
+    encoder.set_output({ buffer, sizeof(buffer) });
+
+    auto result = encoder.stream_data({ input.vector(), static_cast<size_t>(input.size()) }, Ext::StreamFlushMode::StreamFlush);
+    for (;;) {
+        for (size_t i = 0; i < encoder.writer().bytes_written(); i++) {
+            output.add(buffer[i]);
+        }
+        encoder.did_flush_output();
+        if (result != Ext::StreamResult::NeedsMoreOutputSpace) {
+            return output;
+        }
+        result = encoder.resume();
+    }
+}
+
+// There is no gzip or zlib stream encoder which takes raw deflate data, so wrap it by hand.
+static Vector<uint8_t> wrap_gzip(const Vector<uint8_t>& input, const Vector<uint8_t>& deflated) {
+    Vector<uint8_t> output(deflated.size() + 18);
+    for (uint8_t byte : { 0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03 }) {
+        output.add(byte);
+    }
+    output.add(deflated);
+    uint32_t trailer[2] = { compute_crc32_checksum(input.vector(), input.size()), static_cast<uint32_t>(input.size()) };
+    for (size_t i = 0; i < sizeof(trailer); i++) {
+        output.add(reinterpret_cast<uint8_t*>(trailer)[i]);
+    }
+    return output;
+}
+
+static Vector<uint8_t> wrap_zlib(const Vector<uint8_t>& input, const Vector<uint8_t>& deflated) {
+    Vector<uint8_t> output(deflated.size() + 6);
+    output.add(0x78);
+    output.add(0x9C);
+    output.add(deflated);
+    uint32_t adler32 = htonl(compute_adler32_checksum(input.vector(), input.size()));
+    for (size_t i = 0; i < sizeof(adler32); i++) {
+        output.add(reinterpret_cast<uint8_t*>(&adler32)[i]);
+    }
+    return output;
+}
+
+// Returns the number of bytes produced, or 0 if decoding failed.
+template<typename Decoder>
+static size_t decompress(const Vector<uint8_t>& input, uint8_t* buffer, size_t buffer_size) {
+    Decoder decoder;
+    decoder.set_output({ buffer, buffer_size });
+
+    size_t total = 0;
+    size_t input_size = input.size();
+    for (size_t offset = 0; offset < input_size; offset += input_chunk_size) {
+        auto result = decoder.stream_data({ input.vector() + offset, min(input_chunk_size, input_size - offset) });
+        for (;;) {
+            total += decoder.writer().bytes_written();
+            decoder.did_flush_output();
+            if (result != Ext::StreamResult::NeedsMoreOutputSpace) {
+                break;
+            }
+            result = decoder.resume();
+        }
+
+        if (result == Ext::StreamResult::Success) {
+            return total;
+        }
+        if (result == Ext::StreamResult::Error) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+template<typename Decoder>
+static bool measure(const char* input_name, const char* format, int level, const Vector<uint8_t>& compressed, size_t expected_size) {
+    static uint8_t buffer[65536];
+    for (auto buffer_size : output_buffer_sizes) {
+        size_t iterations = max<size_t>(1, min_bytes_per_measurement / max<size_t>(expected_size, 1));
+        double start = now_seconds();
+        for (size_t i = 0; i < iterations; i++) {
+            if (decompress<Decoder>(compressed, buffer, buffer_size) != expected_size) {
+                fprintf(stderr, "bench_inflate: failed to decompress %s (%s, level %d)\n", input_name, format, level);
+                return false;
+            }
+        }
+        double seconds = now_seconds() - start;
+        printf("%-12s %-8s %5d %8zu %12.1f\n", input_name, format, level, buffer_size,
+               iterations * expected_size / (1024.0 * 1024.0) / seconds);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Vector<Input> inputs;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            auto file = Ext::try_map_file(argv[i], PROT_READ, MAP_PRIVATE);
+            if (!file) {
+                fprintf(stderr, "bench_inflate: failed to map `%s'\n", argv[i]);
+                return 1;
+            }
+
+            Vector<uint8_t> data(file->size());
+            for (size_t j = 0; j < file->size(); j++) {
+                data.add(file->data()[j]);
+            }
+            inputs.add({ argv[i], move(data) });
+        }
+    } else {
+        inputs.add({ "text", generate_text() });
+    }
+
+    bool ok = true;
+    printf("%-12s %-8s %5s %8s %12s\n", "input", "format", "level", "buffer", "MB/s");
+    for (auto& input : inputs) {
+        for (auto level : levels) {
+            auto deflated = deflate(input.data, level);
+            ok &= measure<Ext::DeflateDecoder>(input.name, "deflate", level, deflated, input.data.size());
+            ok &= measure<Ext::GZipDecoder>(input.name, "gzip", level, wrap_gzip(input.data, deflated), input.data.size());
+            ok &= measure<Ext::ZLibStreamDecoder>(input.name, "zlib", level, wrap_zlib(input.data, deflated), input.data.size());
+        }
+    }
+    return ok ? 0 : 1;
+}
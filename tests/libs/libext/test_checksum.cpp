@@ -0,0 +1,90 @@
+#include <ext/checksum.h>
+#include <liim/vector.h>
+#include <test/test.h>
+
+// The straightforward byte at a time definitions, to check the table driven and vector versions against.
+static uint32_t reference_crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = ~0U;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t reference_adler32(const uint8_t* data, size_t size) {
+    uint32_t s1 = 1;
+    uint32_t s2 = 0;
+    for (size_t i = 0; i < size; i++) {
+        s1 = (s1 + data[i]) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+    return (s2 << 16) | s1;
+}
+
+static Vector<uint8_t> make_input(size_t size) {
+    Vector<uint8_t> input(size);
+    uint32_t seed = 54321;
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        input.add(seed >> 24);
+    }
+    return input;
+}
+
+TEST(checksum, known_values) {
+    auto* text = reinterpret_cast<const uint8_t*>("123456789");
+    EXPECT_EQ(compute_crc32_checksum(text, 9), 0xCBF43926U);
+    EXPECT_EQ(compute_adler32_checksum(text, 9), 0x091E01DEU);
+    EXPECT_EQ(compute_crc32_checksum(text, 0), 0U);
+    EXPECT_EQ(compute_adler32_checksum(text, 0), 1U);
+}
+
+TEST(checksum, lengths_and_alignments) {
+    // Cover every tail length after the vector loops, at every alignment of the start.
+    auto input = make_input(600);
+    for (size_t offset = 0; offset < 16; offset++) {
+        for (size_t size = 0; offset + size <= 600; size += offset + 1) {
+            EXPECT_EQ(compute_crc32_checksum(input.vector() + offset, size), reference_crc32(input.vector() + offset, size));
+            EXPECT_EQ(compute_adler32_checksum(input.vector() + offset, size), reference_adler32(input.vector() + offset, size));
+        }
+    }
+}
+
+TEST(checksum, large) {
+    // Runs of 0xFF make the Adler32 sums grow as fast as possible, and need reducing before they overflow.
+    auto input = make_input(100000);
+    for (size_t i = 20000; i < 80000; i++) {
+        input[i] = 0xFF;
+    }
+    EXPECT_EQ(compute_crc32_checksum(input.vector(), input.size()), reference_crc32(input.vector(), input.size()));
+    EXPECT_EQ(compute_adler32_checksum(input.vector(), input.size()), reference_adler32(input.vector(), input.size()));
+}
+
+TEST(checksum, partial) {
+    auto input = make_input(10000);
+    auto crc32 = compute_partial_crc32_checksum(input.vector() + 3333, input.size() - 3333,
+                                                compute_crc32_checksum(input.vector(), 3333));
+    auto adler32 = compute_partial_adler32_checksum(input.vector() + 3333, input.size() - 3333,
+                                                    compute_adler32_checksum(input.vector(), 3333));
+    EXPECT_EQ(crc32, compute_crc32_checksum(input.vector(), input.size()));
+    EXPECT_EQ(adler32, compute_adler32_checksum(input.vector(), input.size()));
+}
+
+TEST(checksum, combine) {
+    auto input = make_input(100000);
+    auto crc32 = compute_crc32_checksum(input.vector(), input.size());
+    auto adler32 = compute_adler32_checksum(input.vector(), input.size());
+    for (size_t split : { 0, 1, 4321, 65521, 70000, 100000 }) {
+        auto second_size = input.size() - split;
+        auto first_crc32 = compute_crc32_checksum(input.vector(), split);
+        auto second_crc32 = compute_crc32_checksum(input.vector() + split, second_size);
+        EXPECT_EQ(combine_crc32_checksums(first_crc32, second_crc32, second_size), crc32);
+
+        auto first_adler32 = compute_adler32_checksum(input.vector(), split);
+        auto second_adler32 = compute_adler32_checksum(input.vector() + split, second_size);
+        EXPECT_EQ(combine_adler32_checksums(first_adler32, second_adler32, second_size), adler32);
+    }
+}
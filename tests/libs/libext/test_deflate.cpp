@@ -0,0 +1,254 @@
+#include <ext/deflate.h>
+#include <ext/gzip.h>
+#include <liim/vector.h>
+#include <test/test.h>
+
+static Vector<uint8_t> make_input(size_t size) {
+    // Text-like data with plenty of repetition, mixed with runs of noise which can't be compressed.
+    static const char* words[] = { "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "\n" };
+    Vector<uint8_t> input;
+    uint32_t seed = 12345;
+    while (static_cast<size_t>(input.size()) < size) {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 64 == 0) {
+            for (int i = 0; i < 64 && static_cast<size_t>(input.size()) < size; i++) {
+                seed = seed * 1103515245 + 12345;
+                input.add(seed >> 24);
+            }
+            continue;
+        }
+        for (auto* c = words[(seed >> 16) % 9]; *c && static_cast<size_t>(input.size()) < size; c++) {
+            input.add(*c);
+        }
+    }
+    return input;
+}
+
+// Feeds the input to the encoder in chunks, using a small output buffer so that output space runs out often.
+static Vector<uint8_t> compress(Ext::StreamEncoder& encoder, const Vector<uint8_t>& input, size_t chunk_size,
+                                Ext::StreamFlushMode chunk_flush_mode = Ext::StreamFlushMode::NoFlush) {
+    Vector<uint8_t> output;
+    uint8_t buffer[97];
+    encoder.set_output({ buffer, sizeof(buffer) });
+
+    auto flush_output = [&] {
+        for (size_t i = 0; i < encoder.writer().bytes_written(); i++) {
+            output.add(buffer[i]);
+        }
+        encoder.did_flush_output();
+    };
+
+    size_t input_size = input.size();
+    for (size_t offset = 0;; offset += chunk_size) {
+        auto size = offset < input_size ? min(chunk_size, input_size - offset) : 0;
+        auto flush_mode = size == 0 ? Ext::StreamFlushMode::StreamFlush : chunk_flush_mode;
+        auto result = encoder.stream_data({ input.vector() + offset, size }, flush_mode);
+        while (result == Ext::StreamResult::NeedsMoreOutputSpace) {
+            flush_output();
+            result = encoder.resume();
+        }
+        flush_output();
+
+        if (flush_mode == Ext::StreamFlushMode::StreamFlush) {
+            assert(result == Ext::StreamResult::Success);
+            return output;
+        }
+        assert(result == Ext::StreamResult::NeedsMoreInput);
+    }
+}
+
+// Feeds the input to the decoder in chunks, so that it has to stop and resume at every point of the stream.
+static Vector<uint8_t> decompress(Ext::StreamDecoder& decoder, const Vector<uint8_t>& input, Ext::StreamResult& result,
+                                  size_t chunk_size = SIZE_MAX, size_t output_size = 4096) {
+    Vector<uint8_t> output;
+    uint8_t buffer[4096];
+    decoder.set_output({ buffer, min(output_size, sizeof(buffer)) });
+
+    auto flush_output = [&] {
+        for (size_t i = 0; i < decoder.writer().bytes_written(); i++) {
+            output.add(buffer[i]);
+        }
+        decoder.did_flush_output();
+    };
+
+    size_t input_size = input.size();
+    size_t offset = 0;
+    do {
+        auto size = min(chunk_size, input_size - offset);
+        result = decoder.stream_data({ input.vector() + offset, size });
+        while (result == Ext::StreamResult::NeedsMoreOutputSpace) {
+            flush_output();
+            result = decoder.resume();
+        }
+        flush_output();
+        offset += size;
+    } while (result == Ext::StreamResult::NeedsMoreInput && offset < input_size);
+    return output;
+}
+
+static bool round_trips(int level, const Vector<uint8_t>& input, size_t chunk_size) {
+    Ext::DeflateEncoder encoder(level);
+    auto compressed = compress(encoder, input, chunk_size);
+
+    Ext::DeflateDecoder decoder;
+    Ext::StreamResult result;
+    auto output = decompress(decoder, compressed, result);
+    return result == Ext::StreamResult::Success && output == input;
+}
+
+TEST(deflate, empty) {
+    for (int level = Ext::DeflateEncoder::min_level; level <= Ext::DeflateEncoder::max_level; level++) {
+        EXPECT(round_trips(level, {}, 1024));
+    }
+}
+
+TEST(deflate, levels) {
+    auto input = make_input(200000);
+    for (int level = Ext::DeflateEncoder::min_level; level <= Ext::DeflateEncoder::max_level; level++) {
+        EXPECT(round_trips(level, input, 4096));
+    }
+}
+
+TEST(deflate, small_chunks) {
+    auto input = make_input(70000);
+    EXPECT(round_trips(1, input, 7));
+    EXPECT(round_trips(6, input, 7));
+}
+
+TEST(deflate, long_runs) {
+    Vector<uint8_t> input;
+    for (size_t i = 0; i < 100000; i++) {
+        input.add(i < 50000 ? 'a' : i % 3);
+    }
+    EXPECT(round_trips(6, input, 100000));
+    EXPECT(round_trips(9, input, 1000));
+}
+
+TEST(deflate, ratio) {
+    auto input = make_input(100000);
+    Ext::DeflateEncoder stored(0);
+    auto stored_size = compress(stored, input, 100000).size();
+    Ext::DeflateEncoder fast(1);
+    auto fast_size = compress(fast, input, 100000).size();
+    Ext::DeflateEncoder best(9);
+    auto best_size = compress(best, input, 100000).size();
+
+    EXPECT(stored_size > input.size());
+    EXPECT(fast_size < input.size() / 2);
+    EXPECT(best_size <= fast_size);
+}
+
+TEST(deflate, block_flush) {
+    auto input = make_input(50000);
+    Ext::DeflateEncoder encoder;
+    auto compressed = compress(encoder, input, 1000, Ext::StreamFlushMode::BlockFlush);
+
+    Ext::DeflateDecoder decoder;
+    Ext::StreamResult result;
+    auto output = decompress(decoder, compressed, result);
+    EXPECT(result == Ext::StreamResult::Success);
+    EXPECT(output == input);
+}
+
+TEST(deflate, decode_in_pieces) {
+    auto input = make_input(20000);
+    for (int level : { 0, 1, 6 }) {
+        Ext::DeflateEncoder encoder(level);
+        auto compressed = compress(encoder, input, 20000);
+
+        for (size_t output_size : { 1, 7, 300 }) {
+            Ext::DeflateDecoder decoder;
+            Ext::StreamResult result;
+            auto output = decompress(decoder, compressed, result, 1, output_size);
+            EXPECT(result == Ext::StreamResult::Success);
+            EXPECT(output == input);
+        }
+    }
+}
+
+TEST(deflate, gzip) {
+    auto input = make_input(50000);
+    Ext::GZipEncoder encoder(9);
+    encoder.set_name("test");
+    encoder.set_time_last_modified(0);
+    auto compressed = compress(encoder, input, 8192);
+
+    Ext::GZipDecoder decoder;
+    Ext::StreamResult result;
+    auto output = decompress(decoder, compressed, result);
+    EXPECT(result == Ext::StreamResult::Success);
+    EXPECT(output == input);
+}
+
+TEST(deflate, dictionary) {
+    // Compress the two halves separately, priming the second encoder with the first half, and concatenate the results.
+    auto input = make_input(40000);
+    Span<const uint8_t> first { input.vector(), 20000 };
+    Span<const uint8_t> second { input.vector() + 20000, 20000 };
+
+    Vector<uint8_t> compressed;
+    uint8_t buffer[65536];
+    auto compress_piece = [&](Ext::DeflateEncoder& encoder, Span<const uint8_t> piece, Ext::StreamFlushMode flush_mode) {
+        encoder.set_output({ buffer, sizeof(buffer) });
+        auto result = encoder.stream_data(piece, flush_mode);
+        for (size_t i = 0; i < encoder.writer().bytes_written(); i++) {
+            compressed.add(buffer[i]);
+        }
+        return result;
+    };
+
+    Ext::DeflateEncoder first_encoder;
+    EXPECT(compress_piece(first_encoder, first, Ext::StreamFlushMode::BlockFlush) == Ext::StreamResult::NeedsMoreInput);
+    auto first_size = compressed.size();
+
+    Ext::DeflateEncoder second_encoder;
+    second_encoder.set_dictionary(first);
+    EXPECT(compress_piece(second_encoder, second, Ext::StreamFlushMode::StreamFlush) == Ext::StreamResult::Success);
+
+    Ext::DeflateEncoder unprimed_encoder;
+    auto unprimed_size = compress(unprimed_encoder, Vector<uint8_t>(second.data(), second.size()), 20000).size();
+    EXPECT(compressed.size() - first_size < unprimed_size);
+
+    Ext::DeflateDecoder decoder;
+    Ext::StreamResult result;
+    auto output = decompress(decoder, compressed, result);
+    EXPECT(result == Ext::StreamResult::Success);
+    EXPECT(output == input);
+}
+
+TEST(deflate, gzip_members) {
+    auto first = make_input(30000);
+    auto second = make_input(5000);
+    Ext::GZipEncoder first_encoder;
+    Ext::GZipEncoder second_encoder(1);
+    auto compressed = compress(first_encoder, first, 8192);
+    compressed.add(compress(second_encoder, second, 8192));
+
+    // Each member ends with Success, after which the decoder is resumed to continue with the next one.
+    Ext::GZipDecoder decoder;
+    Vector<uint8_t> output;
+    uint8_t buffer[4096];
+    decoder.set_output({ buffer, sizeof(buffer) });
+
+    int members = 0;
+    auto result = decoder.stream_data({ compressed.vector(), static_cast<size_t>(compressed.size()) });
+    for (;;) {
+        for (size_t i = 0; i < decoder.writer().bytes_written(); i++) {
+            output.add(buffer[i]);
+        }
+        decoder.did_flush_output();
+        if (result == Ext::StreamResult::Success) {
+            members++;
+        }
+        if (result != Ext::StreamResult::NeedsMoreOutputSpace && (result != Ext::StreamResult::Success || decoder.reader().finished())) {
+            break;
+        }
+        result = decoder.resume();
+    }
+
+    auto expected = first;
+    expected.add(second);
+    EXPECT(result == Ext::StreamResult::Success);
+    EXPECT_EQ(members, 2);
+    EXPECT(output == expected);
+}
@@ -0,0 +1,152 @@
+#include <graphics/bitmap.h>
+#include <graphics/pixel_span.h>
+#include <graphics/renderer.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Measures the throughput of the Renderer's fill and blit paths over common window sizes. Before timing anything, the
+// span kernels are checked against the scalar blending formula for every combination of alpha and channel values.
+
+struct Size {
+    int width;
+    int height;
+};
+
+constexpr Size sizes[] = { { 320, 240 }, { 640, 480 }, { 1024, 768 }, { 1920, 1080 } };
+constexpr uint64_t pixels_per_measurement = 256 * 1024 * 1024;
+
+static uint64_t now_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
+[[noreturn]] static void fail(const char* message, uint32_t expected, uint32_t actual) {
+    fprintf(stderr, "%s: expected %#.8x, got %#.8x\n", message, expected, actual);
+    exit(1);
+}
+
+static void check(const char* message, uint32_t expected, uint32_t actual) {
+    if (expected != actual) {
+        fail(message, expected, actual);
+    }
+}
+
+// The opaque background path of the Renderer's alpha_blend(), which every kernel must match exactly.
+static uint32_t reference_blend(uint32_t foreground, uint32_t background) {
+    auto alpha = foreground >> 24;
+    if (alpha == 0) {
+        return background;
+    }
+    if (alpha == 0xFF) {
+        return foreground;
+    }
+
+    uint32_t result = 0xFF000000U;
+    for (int shift = 0; shift < 24; shift += 8) {
+        auto fg = (foreground >> shift) & 0xFF;
+        auto bg = (background >> shift) & 0xFF;
+        result |= ((fg * alpha + bg * (255U - alpha)) / 255U) << shift;
+    }
+    return result;
+}
+
+static void verify_kernels() {
+    constexpr int count = 256 * 256;
+    auto* src = new uint32_t[count];
+    auto* dest = new uint32_t[count];
+
+    for (uint32_t alpha = 0; alpha < 256; alpha++) {
+        // Every pair of foreground and background channel values, with a different pair in each channel. The span is
+        // offset by one pixel, so that the vector loops are misaligned and finish with a scalar tail.
+        for (uint32_t i = 0; i < count; i++) {
+            auto fg = i >> 8;
+            auto bg = i & 0xFF;
+            src[i] = (alpha << 24) | (fg << 16) | (bg << 8) | (fg ^ 0x5A);
+            dest[i] = (bg << 24) | (bg << 16) | (fg << 8) | (bg ^ 0xA5);
+        }
+        PixelSpan::blend_over_opaque(dest + 1, src + 1, count - 1);
+        for (uint32_t i = 1; i < count; i++) {
+            auto bg = i & 0xFF;
+            auto fg = i >> 8;
+            check("blend_over_opaque", reference_blend(src[i], (bg << 24) | (bg << 16) | (fg << 8) | (bg ^ 0xA5)), dest[i]);
+        }
+
+        auto color = (alpha << 24) | (alpha << 16) | ((255 - alpha) << 8) | (alpha ^ 0x3C);
+        for (uint32_t i = 0; i < count; i++) {
+            dest[i] = i * 0x01000193U;
+        }
+        PixelSpan::blend_color_over_opaque(dest + 1, color, count - 1);
+        for (uint32_t i = 1; i < count; i++) {
+            check("blend_color_over_opaque", reference_blend(color, i * 0x01000193U), dest[i]);
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        dest[i] = 0;
+    }
+    PixelSpan::fill(dest + 1, 0xFF123456, count - 2);
+    for (uint32_t i = 0; i < count; i++) {
+        check("fill", i == 0 || i == count - 1 ? 0 : 0xFF123456, dest[i]);
+    }
+
+    delete[] src;
+    delete[] dest;
+}
+
+// A window-like bitmap: fully transparent corners and a translucent shadow around an opaque body.
+static void fill_window_bitmap(Bitmap& bitmap) {
+    auto* pixels = bitmap.pixels();
+    for (int y = 0; y < bitmap.height(); y++) {
+        for (int x = 0; x < bitmap.width(); x++) {
+            auto edge = x < y ? x : y;
+            auto alpha = edge < 4 ? 0U : edge < 16 ? uint32_t(edge * 16) : 0xFFU;
+            pixels[y * bitmap.width() + x] = (alpha << 24) | (uint32_t(x * 7 + y * 3) & 0xFFFFFF);
+        }
+    }
+}
+
+template<typename F>
+static void measure(const char* name, const Size& size, F operation) {
+    auto pixels_per_iteration = uint64_t(size.width) * uint64_t(size.height);
+    auto iterations = pixels_per_measurement / pixels_per_iteration;
+
+    operation();
+    auto start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        operation();
+    }
+    auto elapsed_ns = now_ns() - start;
+
+    auto megapixels_per_second = double(iterations * pixels_per_iteration) / (double(elapsed_ns) / 1e9) / 1e6;
+    printf("%-22s %4dx%-4d %10.2f Mpixel/s\n", name, size.width, size.height, megapixels_per_second);
+}
+
+int main() {
+    verify_kernels();
+
+    for (auto& size : sizes) {
+        auto target = Bitmap(size.width, size.height, false);
+        auto opaque_source = Bitmap(size.width, size.height, false);
+        auto window_source = Bitmap(size.width, size.height, true);
+        fill_window_bitmap(window_source);
+
+        auto renderer = Renderer(target);
+        auto rect = target.rect();
+        measure("clear_rect", size, [&] {
+            renderer.clear_rect(rect, ColorValue::DarkGray);
+        });
+        measure("fill_rect translucent", size, [&] {
+            renderer.fill_rect(rect, Color(40, 80, 160, 100));
+        });
+        measure("draw_bitmap opaque", size, [&] {
+            renderer.draw_bitmap(opaque_source, rect, rect);
+        });
+        measure("draw_bitmap alpha", size, [&] {
+            renderer.draw_bitmap(window_source, rect, rect);
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,357 @@
+#include <liim/byte_buffer.h>
+#include <liim/vector.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <tinput/terminal_glyph.h>
+#include <tinput/terminal_screen.h>
+
+// Measures how many bytes a frame takes to send to the terminal, for a few typical ways the TUI applications redraw the
+// whole screen every frame. The screen's output is compared against sending every cell the way IOTerminal used to,
+// and is fed through a small model of the terminal to check that it draws the right thing.
+
+using namespace TInput;
+
+constexpr int width = 120;
+constexpr int height = 40;
+constexpr int frame_count = 500;
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Canvas {
+    char text[height][width];
+    TerminalTextStyle style[height][width];
+
+    void fill(int y, const TerminalTextStyle& cell_style) {
+        for (int x = 0; x < width; x++) {
+            text[y][x] = ' ';
+            style[y][x] = cell_style;
+        }
+    }
+
+    void put(int x, int y, const char* string, const TerminalTextStyle& cell_style) {
+        for (; *string && x < width; string++, x++) {
+            text[y][x] = *string;
+            style[y][x] = cell_style;
+        }
+    }
+};
+
+static const TerminalTextStyle plain {};
+static const TerminalTextStyle status_bar { {}, {}, false, true };
+static const TerminalTextStyle header { Color { VGA_COLOR_BLACK }, Color { VGA_COLOR_CYAN }, true, false };
+static const TerminalTextStyle keyword { Color { VGA_COLOR_LIGHT_BLUE }, {}, true, false };
+static const TerminalTextStyle comment { Color { VGA_COLOR_DARK_GREY }, {}, false, false };
+static const TerminalTextStyle number { Color { VGA_COLOR_GREEN }, {}, false, false };
+
+static void draw_source_line(Canvas& canvas, int y, int line, int inserted) {
+    canvas.fill(y, plain);
+    char buffer[width + 1];
+    snprintf(buffer, sizeof(buffer), "%4d ", line + 1);
+    canvas.put(0, y, buffer, comment);
+    if (line % 7 == 0) {
+        canvas.put(5, y, "// Explains what the next few lines are doing, at some length.", comment);
+        return;
+    }
+    canvas.put(5 + (line % 3) * 4, y, "auto", keyword);
+    snprintf(buffer, sizeof(buffer), "value_%d = compute(%d, %.*s);", line, line * 31, inserted, "abcdefghijklmnopqrstuvwxyz");
+    canvas.put(10 + (line % 3) * 4, y, buffer, plain);
+}
+
+static void draw_status_bar(Canvas& canvas, int line, int column) {
+    canvas.fill(height - 1, status_bar);
+    char buffer[width + 1];
+    snprintf(buffer, sizeof(buffer), " main.cpp [+]    line %d, column %d", line + 1, column + 1);
+    canvas.put(0, height - 1, buffer, status_bar);
+}
+
+// Typing into the middle of a file: one line and the status bar change.
+static void draw_editor_typing(Canvas& canvas, int frame) {
+    for (int y = 0; y < height - 1; y++) {
+        draw_source_line(canvas, y, y, y == 12 ? frame % 26 : 0);
+    }
+    draw_status_bar(canvas, 12, frame % 26);
+}
+
+// Scrolling through a file a line at a time: every line moves.
+static void draw_editor_scrolling(Canvas& canvas, int frame) {
+    for (int y = 0; y < height - 1; y++) {
+        draw_source_line(canvas, y, y + frame, 0);
+    }
+    draw_status_bar(canvas, frame, 0);
+}
+
+// A process table where a few columns change every refresh.
+static void draw_process_table(Canvas& canvas, int frame) {
+    char buffer[width + 1];
+    canvas.fill(0, plain);
+    snprintf(buffer, sizeof(buffer), "uptime %d:%02d  load %d.%02d", frame / 60, frame % 60, frame % 4, (frame * 7) % 100);
+    canvas.put(0, 0, buffer, plain);
+    canvas.fill(1, header);
+    canvas.put(0, 1, "  PID  USER      STATE     CPU%   MEMORY   NAME", header);
+    for (int y = 2; y < height; y++) {
+        canvas.fill(y, plain);
+        auto pid = y * 13;
+        auto cpu = (pid * 7 + frame * (y % 5 == 0 ? 3 : 0)) % 100;
+        snprintf(buffer, sizeof(buffer), "%5d  root      %-8s", pid, y % 3 ? "sleeping" : "running");
+        canvas.put(0, y, buffer, plain);
+        snprintf(buffer, sizeof(buffer), "%5d%%   %6dK", cpu, pid * 40 + (y % 9 == 0 ? frame : 0));
+        canvas.put(26, y, buffer, number);
+        snprintf(buffer, sizeof(buffer), "process_%d", pid);
+        canvas.put(46, y, buffer, plain);
+    }
+}
+
+// Nothing changes, like a terminal application redrawing on a timer.
+static void draw_idle(Canvas& canvas, int) {
+    draw_editor_typing(canvas, 0);
+}
+
+// Sends every cell, the way IOTerminal did before it kept a copy of the screen. Inlining this into main() makes gcc warn
+// about comparing the styles.
+__attribute__((noinline)) static void emit_every_cell(ByteBuffer& output, Option<Point>& cursor, TerminalTextStyle& current_style,
+                                                      const Canvas& canvas) {
+    char buffer[32];
+    auto append = [&](const char* data, size_t size) {
+        auto offset = output.size();
+        output.ensure_capacity(max(output.capacity(), offset + size));
+        output.set_size(offset + size);
+        memcpy(output.data() + offset, data, size);
+    };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            // Every change wrote out the whole style, starting with a reset.
+            if (current_style != canvas.style[y][x]) {
+                Option<TerminalTextStyle> unknown;
+                TerminalScreen::append_style_change(output, unknown, canvas.style[y][x]);
+                current_style = canvas.style[y][x];
+            }
+            if (cursor != Point { x, y }) {
+                append(buffer, snprintf(buffer, sizeof(buffer), "\033[%d;%dH", y + 1, x + 1));
+            }
+            append(&canvas.text[y][x], 1);
+            cursor = Point { x + 1, y };
+        }
+    }
+}
+
+// Just enough of a terminal to follow what the screen sends. Colors are only checked for being the default or not.
+class TerminalModel {
+public:
+    TerminalModel() {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                m_text[y][x] = '?';
+            }
+        }
+    }
+
+    bool matches(const Canvas& canvas) const {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                auto& style = canvas.style[y][x];
+                auto& cell = m_cells[y][x];
+                // Only the background shows on blank cells.
+                auto blank = canvas.text[y][x] == ' ';
+                if (m_text[y][x] != canvas.text[y][x] || cell.invert != style.invert || cell.background != style.background.has_value() ||
+                    (!blank && (cell.bold != style.bold || cell.foreground != style.foreground.has_value()))) {
+                    fprintf(stderr, "bench_terminal_screen: cell %d, %d is wrong\n", x, y);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void process(const ByteBuffer& output) {
+        auto* data = reinterpret_cast<const char*>(output.data());
+        auto* end = data + output.size();
+        while (data < end) {
+            auto c = *data++;
+            if (c == '\r') {
+                m_x = 0;
+            } else if (c == '\n') {
+                m_y = min(m_y + 1, height - 1);
+            } else if (c == '\b') {
+                m_x = max(min(m_x, width - 1) - 1, 0);
+            } else if (c == '\033') {
+                data = process_sequence(data + 1, end);
+            } else {
+                if (m_x >= width) {
+                    m_x = 0;
+                    m_y = min(m_y + 1, height - 1);
+                }
+                m_text[m_y][m_x] = c;
+                m_cells[m_y][m_x] = m_style;
+                m_x++;
+            }
+        }
+    }
+
+private:
+    struct Style {
+        bool foreground { false };
+        bool background { false };
+        bool bold { false };
+        bool invert { false };
+    };
+
+    const char* process_sequence(const char* data, const char* end) {
+        int parameters[16] = {};
+        int count = 0;
+        bool have_parameter = false;
+        for (; data < end; data++) {
+            if (*data >= '0' && *data <= '9') {
+                parameters[count] = parameters[count] * 10 + *data - '0';
+                have_parameter = true;
+            } else if (*data == ';') {
+                count++;
+            } else {
+                break;
+            }
+        }
+        if (have_parameter || count > 0) {
+            count++;
+        }
+        auto first = count > 0 && parameters[0] > 0 ? parameters[0] : 1;
+        switch (*data) {
+            case 'H':
+                m_y = first - 1;
+                m_x = count > 1 ? parameters[1] - 1 : 0;
+                break;
+            case 'G':
+                m_x = first - 1;
+                break;
+            case 'A':
+                m_y -= first;
+                break;
+            case 'B':
+                m_y += first;
+                break;
+            case 'C':
+                m_x = min(m_x, width - 1) + first;
+                break;
+            case 'D':
+                m_x = min(m_x, width - 1) - first;
+                break;
+            case 'X':
+                for (int i = m_x; i < m_x + first && i < width; i++) {
+                    m_text[m_y][i] = ' ';
+                    m_cells[m_y][i] = { false, m_style.background, false, false };
+                }
+                break;
+            case 'm':
+                process_style(parameters, count);
+                break;
+            default:
+                fprintf(stderr, "bench_terminal_screen: unexpected sequence ending in '%c'\n", *data);
+                exit(1);
+        }
+        return data + 1;
+    }
+
+    void process_style(const int* parameters, int count) {
+        if (count == 0) {
+            m_style = {};
+        }
+        for (int i = 0; i < count; i++) {
+            auto parameter = parameters[i];
+            if (parameter == 0) {
+                m_style = {};
+            } else if (parameter == 1) {
+                m_style.bold = true;
+            } else if (parameter == 7) {
+                m_style.invert = true;
+            } else if (parameter == 39) {
+                m_style.foreground = false;
+            } else if (parameter == 49) {
+                m_style.background = false;
+            } else if (parameter == 38 || parameter == 48) {
+                (parameter == 38 ? m_style.foreground : m_style.background) = true;
+                i += 4;
+            } else if ((parameter >= 30 && parameter <= 37) || (parameter >= 90 && parameter <= 97)) {
+                m_style.foreground = true;
+            } else if ((parameter >= 40 && parameter <= 47) || (parameter >= 100 && parameter <= 107)) {
+                m_style.background = true;
+            }
+        }
+    }
+
+    char m_text[height][width];
+    Style m_cells[height][width];
+    Style m_style;
+    int m_x { 0 };
+    int m_y { 0 };
+};
+
+int main() {
+    struct {
+        const char* name;
+        void (*draw)(Canvas&, int);
+    } scenarios[] = {
+        { "editor typing", draw_editor_typing },
+        { "editor scrolling", draw_editor_scrolling },
+        { "process table", draw_process_table },
+        { "idle", draw_idle },
+    };
+
+    bool ok = true;
+    auto* canvas = new Canvas;
+    auto* model = new TerminalModel;
+    printf("%-18s %16s %16s %12s\n", "scenario", "every cell B/f", "diffed B/f", "render us/f");
+    for (auto& scenario : scenarios) {
+        *model = {};
+        TerminalScreen screen(width, height);
+        TerminalScreen::TerminalState state;
+        Option<Point> old_cursor;
+        TerminalTextStyle old_style;
+        ByteBuffer output;
+        size_t old_bytes = 0;
+        size_t new_bytes = 0;
+        double render_seconds = 0;
+
+        // The first frame draws everything either way, so it is left out of the averages.
+        for (int frame = 0; frame <= frame_count; frame++) {
+            scenario.draw(*canvas, frame);
+
+            output.set_size(0);
+            emit_every_cell(output, old_cursor, old_style, *canvas);
+            if (frame > 0) {
+                old_bytes += output.size();
+            }
+
+            output.set_size(0);
+            auto start = now_seconds();
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    screen.put_glyph({ x, y }, TerminalGlyph { String { canvas->text[y][x] }, 1 }, canvas->style[y][x]);
+                }
+            }
+            screen.render(output, state);
+            if (frame > 0) {
+                render_seconds += now_seconds() - start;
+                new_bytes += output.size();
+            }
+
+            model->process(output);
+            if (!model->matches(*canvas)) {
+                fprintf(stderr, "bench_terminal_screen: %s frame %d was drawn incorrectly\n", scenario.name, frame);
+                ok = false;
+                break;
+            }
+        }
+
+        auto old_average = static_cast<double>(old_bytes) / frame_count;
+        auto new_average = static_cast<double>(new_bytes) / frame_count;
+        printf("%-18s %16.1f %16.1f %12.1f\n", scenario.name, old_average, new_average, render_seconds / frame_count * 1e6);
+    }
+
+    delete model;
+    delete canvas;
+    return ok ? 0 : 1;
+}
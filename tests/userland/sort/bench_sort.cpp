@@ -0,0 +1,191 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures the sort utility over a generated input which is larger than its memory budget, so that every run spills
+// sorted runs to temporary files and merges them. Each line looks like "key,number,word", so that the cases can sort
+// by the whole line, by a numeric field, and by a field after a separator. The output of each run is checked to be in
+// order for the whole line case.
+
+static double now_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void generate_input(const char* path, size_t size) {
+    static const char* words[] = { "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel" };
+
+    auto* file = fopen(path, "w");
+    if (!file) {
+        perror("bench_sort: fopen");
+        exit(1);
+    }
+
+    unsigned long long seed = 1;
+    size_t written = 0;
+    while (written < size) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        int length = fprintf(file, "%012llx,%llu,%s\n", seed >> 16, (seed >> 20) % 1000000, words[(seed >> 40) % 8]);
+        if (length < 0) {
+            perror("bench_sort: fprintf");
+            exit(1);
+        }
+        written += length;
+    }
+
+    if (fclose(file)) {
+        perror("bench_sort: fclose");
+        exit(1);
+    }
+}
+
+static double run_sort(const char* sort_path, const char* const* options, const char* input, const char* output) {
+    const char* argv[16];
+    int argc = 0;
+    argv[argc++] = sort_path;
+    for (; *options; options++) {
+        argv[argc++] = *options;
+    }
+    argv[argc++] = input;
+    argv[argc] = nullptr;
+
+    auto start = now_seconds();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("bench_sort: fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0) {
+            _exit(127);
+        }
+        execvp(sort_path, const_cast<char**>(argv));
+        _exit(127);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("bench_sort: waitpid");
+        exit(1);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "bench_sort: %s failed\n", sort_path);
+        exit(1);
+    }
+    return now_seconds() - start;
+}
+
+static bool is_sorted(const char* path) {
+    auto* file = fopen(path, "r");
+    if (!file) {
+        perror("bench_sort: fopen");
+        exit(1);
+    }
+
+    char* previous = nullptr;
+    size_t previous_max = 0;
+    ssize_t previous_length = -1;
+    char* line = nullptr;
+    size_t line_max = 0;
+    ssize_t line_length;
+    bool sorted = true;
+    while (sorted && (line_length = getline(&line, &line_max, file)) != -1) {
+        if (previous_length >= 0) {
+            size_t length = previous_length < line_length ? previous_length : line_length;
+            int result = memcmp(previous, line, length);
+            sorted = result < 0 || (result == 0 && previous_length <= line_length);
+        }
+
+        // Keep this line as the previous one, and reuse the previous buffer for the next line.
+        auto* buffer = previous;
+        auto buffer_max = previous_max;
+        previous = line;
+        previous_max = line_max;
+        previous_length = line_length;
+        line = buffer;
+        line_max = buffer_max;
+    }
+
+    free(previous);
+    free(line);
+    fclose(file);
+    return sorted;
+}
+
+struct Case {
+    const char* name;
+    const char* options[4];
+    bool check_order;
+};
+
+static Case cases[] = {
+    { "whole line", { nullptr }, true },
+    { "-t, -k2n", { "-t,", "-k2n", nullptr }, false },
+    { "-t, -k3,3 -u", { "-t,", "-k3,3", "-u", nullptr }, false },
+};
+
+static void print_usage_and_exit(const char* s) {
+    fprintf(stderr, "Usage: %s [-s input-mib] [-S sort-memory] [-d dir] [sort-path]\n", s);
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    size_t input_mib = 2048;
+    const char* memory = "256M";
+    const char* directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+
+    int opt;
+    while ((opt = getopt(argc, argv, ":s:S:d:")) != -1) {
+        switch (opt) {
+            case 's':
+                input_mib = strtoul(optarg, nullptr, 10);
+                break;
+            case 'S':
+                memory = optarg;
+                break;
+            case 'd':
+                directory = optarg;
+                break;
+            case ':':
+            case '?':
+                print_usage_and_exit(*argv);
+                break;
+        }
+    }
+    const char* sort_path = optind < argc ? argv[optind] : "sort";
+
+    char input[256];
+    char output[256];
+    snprintf(input, sizeof(input), "%s/bench_sort_input", directory);
+    snprintf(output, sizeof(output), "%s/bench_sort_output", directory);
+
+    auto start = now_seconds();
+    generate_input(input, input_mib * 1024 * 1024);
+    printf("generated %zu MiB in %.2f s\n\n", input_mib, now_seconds() - start);
+
+    printf("%-24s %10s %10s %8s\n", "case", "s", "MB/s", "sorted");
+    for (auto& test_case : cases) {
+        const char* options[8];
+        int count = 0;
+        options[count++] = "-S";
+        options[count++] = memory;
+        for (auto* option = test_case.options; *option; option++) {
+            options[count++] = *option;
+        }
+        options[count] = nullptr;
+
+        auto elapsed = run_sort(sort_path, options, input, output);
+        const char* sorted = test_case.check_order ? (is_sorted(output) ? "yes" : "NO") : "-";
+        printf("%-24s %10.2f %10.2f %8s\n", test_case.name, elapsed, input_mib * 1024 * 1024 / elapsed / 1e6, sorted);
+    }
+
+    unlink(input);
+    unlink(output);
+    return 0;
+}
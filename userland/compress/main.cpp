@@ -9,15 +9,77 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include "parallel_compressor.h"
+
+constexpr size_t default_block_size = 128 * 1024;
+
 void print_usage_and_exit(const char* s) {
-    fprintf(stderr, "Usage: %s <path>\n", s);
+    fprintf(stderr, "Usage: %s [-0123456789] [-j threads] [-b block-size] <path>\n", s);
     exit(1);
 }
 
+// Compresses a file which can be mapped into memory with several threads. Returns false if the file can't be mapped, in
+// which case it should be streamed instead.
+static bool try_compress_in_parallel(const String& path, int level, size_t block_size, int thread_count) {
+    auto input = Ext::try_map_file(path, PROT_READ, MAP_SHARED);
+    if (!input) {
+        return false;
+    }
+
+    Ext::GZipData gzip_data;
+    gzip_data.name = path;
+    gzip_data.time_last_modified = 0;
+
+    auto output_file = make_unique<Ext::File>(stdout);
+    ParallelCompressor compressor({ input->data(), input->size() }, level, block_size, thread_count);
+    bool ok = compressor.compress(gzip_data, [&](ByteBuffer& buffer) {
+        if (!output_file->write(buffer)) {
+            fprintf(stderr, "compress: failed to write to file `%s': %s\n", "stdout", strerror(output_file->error()));
+            exit(1);
+        }
+        return true;
+    });
+    if (!ok) {
+        fprintf(stderr, "compress: failed to compress `%s'\n", path.string());
+        exit(1);
+    }
+    return true;
+}
+
 int main(int argc, char** argv) {
+    int level = Ext::DeflateEncoder::default_level;
+    int thread_count = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    size_t block_size = default_block_size;
+
     int opt;
-    while ((opt = getopt(argc, argv, ":")) != -1) {
+    while ((opt = getopt(argc, argv, ":0123456789b:j:")) != -1) {
         switch (opt) {
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9':
+                level = opt - '0';
+                break;
+            case 'b': {
+                char* end;
+                block_size = strtoul(optarg, &end, 10);
+                if (*end != '\0' || block_size == 0) {
+                    print_usage_and_exit(*argv);
+                }
+                break;
+            }
+            case 'j':
+                thread_count = atoi(optarg);
+                if (thread_count < 1) {
+                    print_usage_and_exit(*argv);
+                }
+                break;
             case ':':
             case '?':
                 print_usage_and_exit(*argv);
@@ -30,9 +92,12 @@ int main(int argc, char** argv) {
     }
 
     String path = argv[optind];
+    if (thread_count > 1 && try_compress_in_parallel(path, level, block_size, thread_count)) {
+        return 0;
+    }
 
     ByteBuffer output_buffer(BUFSIZ);
-    Ext::GZipEncoder encoder;
+    Ext::GZipEncoder encoder(level);
 
     output_buffer.set_size(output_buffer.capacity());
     encoder.set_output(output_buffer.span());
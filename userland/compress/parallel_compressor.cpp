@@ -0,0 +1,139 @@
+#include <ext/checksum.h>
+
+#include "parallel_compressor.h"
+
+// Deflate distances reach back at most 32 KiB, so there is no use priming an encoder with more than this.
+constexpr size_t dictionary_size = 32768;
+
+ParallelCompressor::ParallelCompressor(Span<const uint8_t> input, int level, size_t block_size, int thread_count)
+    : m_input(input)
+    , m_level(level)
+    , m_block_size(block_size)
+    , m_block_count(max<size_t>((input.size() + block_size - 1) / block_size, 1))
+    , m_thread_count(thread_count) {
+    m_slots.resize(2 * thread_count);
+    pthread_mutex_init(&m_lock, nullptr);
+    pthread_cond_init(&m_block_done, nullptr);
+    pthread_cond_init(&m_slot_free, nullptr);
+}
+
+ParallelCompressor::~ParallelCompressor() {
+    pthread_cond_destroy(&m_slot_free);
+    pthread_cond_destroy(&m_block_done);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void* ParallelCompressor::run_worker(void* compressor) {
+    static_cast<ParallelCompressor*>(compressor)->work();
+    return nullptr;
+}
+
+void ParallelCompressor::work() {
+    pthread_mutex_lock(&m_lock);
+    for (;;) {
+        while (m_next_block < m_block_count && m_next_block >= m_next_block_to_write + m_slots.size()) {
+            pthread_cond_wait(&m_slot_free, &m_lock);
+        }
+        if (m_next_block >= m_block_count) {
+            break;
+        }
+
+        auto index = m_next_block++;
+        auto& block = slot_for(index);
+        pthread_mutex_unlock(&m_lock);
+
+        compress_block(index, block);
+
+        pthread_mutex_lock(&m_lock);
+        block.done = true;
+        pthread_cond_broadcast(&m_block_done);
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void ParallelCompressor::compress_block(size_t index, Block& block) {
+    size_t start = index * m_block_size;
+    auto input = m_input.subspan(start, min(m_block_size, m_input.size() - start));
+    bool last = index == m_block_count - 1;
+
+    Ext::DeflateEncoder encoder(m_level);
+    if (start > 0) {
+        auto size = min(start, dictionary_size);
+        encoder.set_dictionary(m_input.subspan(start - size, size));
+    }
+
+    // Compressed data is very rarely much larger than its input, so the output buffer almost never has to grow.
+    auto& output = block.output;
+    output.ensure_capacity(input.size() + input.size() / 8 + 1024);
+    output.set_size(output.capacity());
+    encoder.set_output(output.span());
+
+    // A block flush ends the block with an empty stored block, which leaves the output on a byte boundary.
+    auto result = encoder.stream_data(input, last ? Ext::StreamFlushMode::StreamFlush : Ext::StreamFlushMode::BlockFlush);
+    while (result == Ext::StreamResult::NeedsMoreOutputSpace) {
+        output.ensure_capacity(output.capacity() * 2);
+        output.set_size(output.capacity());
+        encoder.extend_output(output.span());
+        result = encoder.resume();
+    }
+    output.set_size(encoder.writer().bytes_written());
+
+    block.crc32 = compute_crc32_checksum(input.data(), input.size());
+    block.failed = result != (last ? Ext::StreamResult::Success : Ext::StreamResult::NeedsMoreInput);
+}
+
+bool ParallelCompressor::compress(const Ext::GZipData& gzip_data, Function<bool(ByteBuffer&)> write_output) {
+    auto header = Ext::encode_gzip_header(gzip_data);
+    if (!write_output(header)) {
+        return false;
+    }
+
+    // If no thread can be created, each block is compressed here just before it is written.
+    Vector<pthread_t> threads;
+    for (int i = 0; i < m_thread_count; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, run_worker, this) != 0) {
+            break;
+        }
+        threads.add(thread);
+    }
+
+    bool ok = true;
+    uint32_t crc32 = 0;
+    for (size_t i = 0; ok && i < m_block_count; i++) {
+        auto& block = slot_for(i);
+        if (threads.empty()) {
+            compress_block(i, block);
+        } else {
+            pthread_mutex_lock(&m_lock);
+            while (!block.done) {
+                pthread_cond_wait(&m_block_done, &m_lock);
+            }
+            pthread_mutex_unlock(&m_lock);
+        }
+
+        ok = !block.failed && write_output(block.output);
+        crc32 = combine_crc32_checksums(crc32, block.crc32, min(m_block_size, m_input.size() - i * m_block_size));
+
+        pthread_mutex_lock(&m_lock);
+        block.done = false;
+        m_next_block_to_write++;
+        if (!ok) {
+            // Stop handing out blocks, so that the workers finish.
+            m_next_block = m_block_count;
+        }
+        pthread_cond_broadcast(&m_slot_free);
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    for (auto thread : threads) {
+        pthread_join(thread, nullptr);
+    }
+
+    if (!ok) {
+        return false;
+    }
+
+    auto trailer = Ext::encode_gzip_trailer(crc32, m_input.size());
+    return write_output(trailer);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <ext/gzip.h>
+#include <liim/function.h>
+#include <liim/span.h>
+#include <liim/vector.h>
+#include <pthread.h>
+
+// Compresses input which is entirely in memory into a single gzip member, using several threads. The input is split into
+// blocks which are compressed independently, each with its encoder primed with the 32 KiB of input before it, so that
+// matches can still reach across block boundaries. Every block but the last ends on a byte boundary, so the compressed
+// blocks can simply be concatenated in order. Their CRCs are combined for the trailer.
+class ParallelCompressor {
+public:
+    ParallelCompressor(Span<const uint8_t> input, int level, size_t block_size, int thread_count);
+    ~ParallelCompressor();
+
+    // Passes the header, each compressed block and the trailer to write_output in order. Returns false if compressing a
+    // block or writing fails.
+    bool compress(const Ext::GZipData& gzip_data, Function<bool(ByteBuffer&)> write_output);
+
+private:
+    struct Block {
+        ByteBuffer output;
+        uint32_t crc32 { 0 };
+        bool done { false };
+        bool failed { false };
+    };
+
+    static void* run_worker(void* compressor);
+
+    void work();
+    void compress_block(size_t index, Block& block);
+    Block& slot_for(size_t index) { return m_slots[index % m_slots.size()]; }
+
+    Span<const uint8_t> m_input;
+    int m_level;
+    size_t m_block_size;
+    size_t m_block_count;
+    int m_thread_count;
+
+    // Blocks are compressed into a ring of slots, so at most m_slots.size() compressed blocks are held at once.
+    Vector<Block> m_slots;
+    size_t m_next_block { 0 };
+    size_t m_next_block_to_write { 0 };
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_block_done;
+    pthread_cond_t m_slot_free;
+};
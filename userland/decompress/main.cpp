@@ -1,21 +1,57 @@
 #include <errno.h>
 #include <ext/file.h>
 #include <ext/gzip.h>
+#include <ext/mapped_file.h>
 #include <liim/function.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
+#include "parallel_decompressor.h"
+
 void print_usage_and_exit(const char* s) {
-    fprintf(stderr, "Usage: %s <path>\n", s);
+    fprintf(stderr, "Usage: %s [-j threads] <path>\n", s);
     exit(1);
 }
 
+// Decompresses a file which can be mapped into memory with several threads. Returns false if the file can't be mapped,
+// in which case it should be streamed instead.
+static bool try_decompress_in_parallel(const String& path, int thread_count) {
+    auto input = Ext::try_map_file(path, PROT_READ, MAP_SHARED);
+    if (!input) {
+        return false;
+    }
+
+    auto output_file = make_unique<Ext::File>(stdout);
+    ParallelDecompressor decompressor({ input->data(), input->size() }, thread_count);
+    bool ok = decompressor.decompress([&](ByteBuffer& buffer) {
+        if (!output_file->write(buffer)) {
+            fprintf(stderr, "decompress: failed to write to file `%s': %s\n", "stdout", strerror(output_file->error()));
+            exit(1);
+        }
+        return true;
+    });
+    if (!ok) {
+        fprintf(stderr, "decompress: failed to decompress `%s'\n", path.string());
+        exit(1);
+    }
+    return true;
+}
+
 int main(int argc, char** argv) {
+    int thread_count = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+
     int opt;
-    while ((opt = getopt(argc, argv, ":")) != -1) {
+    while ((opt = getopt(argc, argv, ":j:")) != -1) {
         switch (opt) {
+            case 'j':
+                thread_count = atoi(optarg);
+                if (thread_count < 1) {
+                    print_usage_and_exit(*argv);
+                }
+                break;
             case ':':
             case '?':
                 print_usage_and_exit(*argv);
@@ -28,6 +64,10 @@ int main(int argc, char** argv) {
     }
 
     String path = argv[optind];
+    if (thread_count > 1 && try_decompress_in_parallel(path, thread_count)) {
+        return 0;
+    }
+
     auto file = Ext::File::create(path, "r");
     if (!file) {
         fprintf(stderr, "decompress: failed to open file `%s': %s\n", path.string(), strerror(errno));
@@ -52,9 +92,20 @@ int main(int argc, char** argv) {
         output_buffer.set_size(output_buffer.capacity());
     };
 
+    // The file may hold several members. The decoder stops at the end of each one, and continues with the next when resumed.
+    auto result = Ext::StreamResult::NeedsMoreInput;
     auto stream_data = [&](const ByteBuffer& buffer) -> bool {
-        auto result = decoder.stream_data(buffer.span());
-        while (result == Ext::StreamResult::NeedsMoreOutputSpace) {
+        if (buffer.empty()) {
+            if (result != Ext::StreamResult::Success) {
+                fprintf(stderr, "decompress: unexpected end of file `%s'\n", path.string());
+                exit(1);
+            }
+            return false;
+        }
+
+        result = decoder.stream_data(buffer.span());
+        while (result == Ext::StreamResult::NeedsMoreOutputSpace ||
+               (result == Ext::StreamResult::Success && !decoder.reader().finished())) {
             flush_output_buffer();
             result = decoder.resume();
         }
@@ -65,10 +116,6 @@ int main(int argc, char** argv) {
         }
 
         flush_output_buffer();
-        if (result == Ext::StreamResult::Success) {
-            return false;
-        }
-
         return true;
     };
 
@@ -0,0 +1,127 @@
+#include <ext/gzip.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "parallel_decompressor.h"
+
+constexpr size_t output_buffer_size = 65536;
+
+ParallelDecompressor::ParallelDecompressor(Span<const uint8_t> input, int thread_count)
+    : m_input(input), m_thread_count(thread_count) {}
+
+Option<size_t> ParallelDecompressor::decode_member(Span<const uint8_t> input, Function<bool(ByteBuffer&)>& write_output) {
+    ByteBuffer buffer(output_buffer_size);
+    Ext::GZipDecoder decoder;
+
+    buffer.set_size(buffer.capacity());
+    decoder.set_output(buffer.span());
+
+    auto result = decoder.stream_data(input);
+    for (;;) {
+        buffer.set_size(decoder.writer().bytes_written());
+        if (!write_output(buffer)) {
+            return {};
+        }
+        decoder.did_flush_output();
+        buffer.set_size(buffer.capacity());
+
+        if (result != Ext::StreamResult::NeedsMoreOutputSpace) {
+            break;
+        }
+        result = decoder.resume();
+    }
+
+    // The decoder stops reading at the end of the member, so whatever it has read is the member's length.
+    if (result != Ext::StreamResult::Success) {
+        return {};
+    }
+    return decoder.reader().byte_offset();
+}
+
+void* ParallelDecompressor::run_speculative_decode(void* argument) {
+    auto& member = *static_cast<Member*>(argument);
+    Function<bool(ByteBuffer&)> append_output = [&](ByteBuffer& buffer) {
+        auto size = member.output.size();
+        if (size + buffer.size() > max_speculative_output) {
+            return false;
+        }
+        if (member.output.capacity() < size + buffer.size()) {
+            member.output.ensure_capacity(max(member.output.capacity() * 2, size + buffer.size()));
+        }
+        member.output.set_size(size + buffer.size());
+        memcpy(member.output.data() + size, buffer.data(), buffer.size());
+        return true;
+    };
+    member.length = decode_member(member.input, append_output);
+    return nullptr;
+}
+
+void ParallelDecompressor::find_candidates() {
+    // A member header starts with the two magic bytes and the deflate compression method, and the reserved flag bits are
+    // clear. Compressed data can contain these bytes too, which is why candidates are only decoded speculatively.
+    auto* data = m_input.data();
+    auto size = m_input.size();
+    for (size_t offset = 1; offset + 4 <= size; offset++) {
+        auto* id = static_cast<const uint8_t*>(memchr(data + offset, 0x1F, size - offset - 3));
+        if (!id) {
+            break;
+        }
+        offset = id - data;
+        if (id[1] == 0x8B && id[2] == 8 && (id[3] & 0xE0) == 0) {
+            m_candidates.add(offset);
+        }
+    }
+}
+
+bool ParallelDecompressor::decompress(Function<bool(ByteBuffer&)> write_output) {
+    find_candidates();
+
+    size_t offset = 0;
+    int next_candidate = 0;
+    while (offset < m_input.size()) {
+        while (next_candidate < m_candidates.size() && m_candidates[next_candidate] <= offset) {
+            next_candidate++;
+        }
+
+        // If a thread cannot be created, the members after it are simply left for the calling thread.
+        Vector<Member> members;
+        members.resize(min(m_thread_count - 1, m_candidates.size() - next_candidate));
+        Vector<pthread_t> threads;
+        for (int i = 0; i < members.size(); i++) {
+            members[i].input = m_input.subspan(m_candidates[next_candidate + i]);
+
+            pthread_t thread;
+            if (pthread_create(&thread, nullptr, run_speculative_decode, &members[i]) != 0) {
+                members.resize(i);
+                break;
+            }
+            threads.add(thread);
+        }
+
+        auto length = decode_member(m_input.subspan(offset), write_output);
+        for (auto thread : threads) {
+            pthread_join(thread, nullptr);
+        }
+        if (!length.has_value()) {
+            return false;
+        }
+        offset += length.value();
+
+        // Follow the chain of members which start where the previous one ended. Candidates inside a member are skipped,
+        // and the chain stops at the first one which was not decoded, for the next round to decode it directly.
+        for (auto& member : members) {
+            auto start = static_cast<size_t>(member.input.data() - m_input.data());
+            if (start < offset) {
+                continue;
+            }
+            if (start > offset || !member.length.has_value()) {
+                break;
+            }
+            if (!write_output(member.output)) {
+                return false;
+            }
+            offset += member.length.value();
+        }
+    }
+    return true;
+}
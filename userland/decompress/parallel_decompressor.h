@@ -0,0 +1,42 @@
+#pragma once
+
+#include <liim/byte_buffer.h>
+#include <liim/function.h>
+#include <liim/option.h>
+#include <liim/span.h>
+#include <liim/vector.h>
+
+// Decompresses a gzip file which is entirely in memory and may hold several members, using several threads. Where the
+// members start is only known once the member before is decoded, so the file is scanned for byte sequences which look
+// like member headers. While the calling thread decodes the current member straight to the output, the other threads
+// speculatively decode the members at the next few candidates into memory. Those that turn out to start exactly where
+// the current member ends are then written out in order, and the rest are discarded.
+class ParallelDecompressor {
+public:
+    // A speculatively decoded member which would produce more than this is left for the calling thread to decode.
+    static constexpr size_t max_speculative_output = 64 * 1024 * 1024;
+
+    ParallelDecompressor(Span<const uint8_t> input, int thread_count);
+
+    // Passes the decompressed data to write_output in order. Returns false if the input is invalid or writing fails.
+    bool decompress(Function<bool(ByteBuffer&)> write_output);
+
+    // Decodes the member at the start of input, passing the output to write_output one buffer at a time. Returns the length
+    // of the member, or nothing if it is invalid, truncated or write_output fails.
+    static Option<size_t> decode_member(Span<const uint8_t> input, Function<bool(ByteBuffer&)>& write_output);
+
+private:
+    struct Member {
+        Span<const uint8_t> input;
+        ByteBuffer output;
+        Option<size_t> length;
+    };
+
+    static void* run_speculative_decode(void* member);
+
+    void find_candidates();
+
+    Span<const uint8_t> m_input;
+    int m_thread_count;
+    Vector<size_t> m_candidates;
+};
@@ -1,5 +1,6 @@
 #include <dirent.h>
 #include <elf.h>
+#include <liim/container/container.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 
@@ -111,6 +112,19 @@ ElfFile::ElfFile(FileId file_id, UniquePtr<ByteBuffer> file, String path) : m_fi
             m_symbol_table = &shdr;
         }
     }
+
+    if (m_symbol_table) {
+        size_t symbol_count = m_symbol_table->sh_size / sizeof(ElfW(Sym));
+        auto* symbols = (const ElfW(Sym)*) offset_in_memory(m_symbol_table->sh_offset);
+        for (size_t i = 0; i < symbol_count; i++) {
+            if (symbols[i].st_size) {
+                m_sorted_symbols.add(&symbols[i]);
+            }
+        }
+        Alg::sort(m_sorted_symbols, CompareThreeWay {}, [](auto* symbol) {
+            return symbol->st_value;
+        });
+    }
 }
 
 ElfFile::~ElfFile() {
@@ -118,18 +132,34 @@ ElfFile::~ElfFile() {
 }
 
 Option<ElfFile::LookupResult> ElfFile::lookup_symbol(uintptr_t addr) const {
-    if (!m_string_table || !m_symbol_table) {
+    if (!m_string_table || m_sorted_symbols.empty()) {
         return {};
     }
 
-    size_t symbol_count = m_symbol_table->sh_size / sizeof(ElfW(Sym));
-    auto* symbols = (const ElfW(Sym)*) offset_in_memory(m_symbol_table->sh_offset);
-    for (size_t i = 0; i < symbol_count; i++) {
-        auto& sym = symbols[i];
-        if (sym.st_size && sym.st_value <= addr && addr <= sym.st_value + sym.st_size) {
-            return { { string_at(sym.st_name), addr - sym.st_value } };
+    if (auto cached = m_symbol_cache.get(addr)) {
+        return *cached;
+    }
+
+    // Find the last symbol which starts at or before addr.
+    size_t low = 0;
+    size_t high = m_sorted_symbols.size();
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (m_sorted_symbols[mid]->st_value <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    Option<LookupResult> result;
+    if (low > 0) {
+        auto& sym = *m_sorted_symbols[low - 1];
+        if (addr <= sym.st_value + sym.st_size) {
+            result = LookupResult { string_at(sym.st_name), addr - sym.st_value };
         }
     }
 
-    return {};
+    m_symbol_cache.put(addr, result);
+    return result;
 }
@@ -4,6 +4,7 @@
 #include <liim/option.h>
 #include <liim/pointers.h>
 #include <liim/string.h>
+#include <liim/vector.h>
 #include <sys/types.h>
 
 struct FileId {
@@ -63,10 +64,12 @@ public:
     const ElfW(Shdr) * shdr_at(size_t i) { return (const ElfW(Shdr)*) offset_in_memory(elf_header()->e_shoff + shdr_size() * i); }
 
     struct LookupResult {
-        String name;
+        const char* name;
         uintptr_t offset;
     };
 
+    // Symbols are found by a binary search over the symbol table sorted by address, and the results are cached, since
+    // profiles hit the same few addresses over and over.
     Option<LookupResult> lookup_symbol(uintptr_t offset) const;
     bool relocatable() const { return elf_header()->e_type == ET_DYN; }
 
@@ -78,5 +81,7 @@ private:
     String m_path;
     const ElfW(Shdr) * m_string_table { nullptr };
     const ElfW(Shdr) * m_symbol_table { nullptr };
+    Vector<const ElfW(Sym)*> m_sorted_symbols;
+    mutable HashMap<uintptr_t, Option<LookupResult>> m_symbol_cache;
     mutable WeakPtr<ElfFile> m_weak_this;
 };
@@ -1,4 +1,7 @@
+#include <errno.h>
 #include <eventloop/event_loop.h>
+#include <eventloop/selectable.h>
+#include <eventloop/timer.h>
 #include <limits.h>
 #include <signal.h>
 #include <stdio.h>
@@ -14,68 +17,109 @@
 enum Flags {
     Disable = 1,
     Wait = 2,
-    Invert = 4,
-    Quiet = 8,
+    Quiet = 4,
 };
 
-static void build_and_view_profile(pid_t pid, const char* output_path, int flags) {
-    void* buffer = mmap(0, PROFILE_BUFFER_MAX, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
-    if (buffer == MAP_FAILED) {
-        fprintf(stderr, "profile: mmap: %m\n");
-        exit(1);
-    }
+// How often the kernel's buffers are drained into the output file while the process runs.
+constexpr time_t drain_interval_ms = 50;
+
+// Streams the samples of a profiled process into the output file as they are taken, so that the kernel only has to
+// buffer what arrives between two reads.
+class ProfileWriter {
+public:
+    static UniquePtr<ProfileWriter> create(pid_t pid, const char* output_path) {
+        void* buffer = mmap(0, PROFILE_BUFFER_MAX, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+        if (buffer == MAP_FAILED) {
+            fprintf(stderr, "profile: mmap: %m\n");
+            exit(1);
+        }
 
-    char name_buffer[PATH_MAX];
-    memset(name_buffer, 0, sizeof(name_buffer));
-    ssize_t ret = readlink(String::format("/proc/%d/exe", pid).string(), name_buffer, sizeof(name_buffer) - 1);
-    if (ret < 0) {
-        fprintf(stderr, "profile: readlink: %m\n");
-        exit(1);
+        FILE* output_file = fopen(output_path, "w");
+        if (!output_file) {
+            fprintf(stderr, "profile: fopen: %m\n");
+            exit(1);
+        }
+
+        return make_unique<ProfileWriter>(pid, output_path, output_file, buffer);
     }
-    size_t name_size = ALIGN_UP(ret + 1, sizeof(size_t));
 
-    ret = read_profile(pid, buffer, PROFILE_BUFFER_MAX);
-    if (ret < 0) {
-        fprintf(stderr, "profile: read_profile: %m\n");
-        exit(1);
+    ProfileWriter(pid_t pid, const char* output_path, FILE* output_file, void* buffer)
+        : m_pid(pid), m_output_path(output_path), m_output_file(output_file), m_buffer(buffer) {}
+
+    ~ProfileWriter() { munmap(m_buffer, PROFILE_BUFFER_MAX); }
+
+    const char* output_path() const { return m_output_path; }
+
+    void drain() {
+        for (;;) {
+            ssize_t ret = read_profile(m_pid, m_buffer, PROFILE_BUFFER_MAX);
+            if (ret < 0 && errno == EINVAL) {
+                // A forked child only enables profiling once it starts running.
+                return;
+            }
+            if (ret < 0) {
+                fprintf(stderr, "profile: read_profile: %m\n");
+                exit(1);
+            }
+            if (ret == 0) {
+                return;
+            }
+
+            if (fwrite(m_buffer, 1, ret, m_output_file) != static_cast<size_t>(ret)) {
+                fprintf(stderr, "profile: fwrite: %m\n");
+                exit(1);
+            }
+        }
     }
 
-    if (flags & Flags::Disable) {
-        if (disable_profiling(pid)) {
-            fprintf(stderr, "profile: disable_profiling: %m\n");
+    // Writes out the remaining samples, followed by the executable's name and the size of the name.
+    void finish(int flags) {
+        char name_buffer[PATH_MAX];
+        memset(name_buffer, 0, sizeof(name_buffer));
+        ssize_t ret = readlink(String::format("/proc/%d/exe", m_pid).string(), name_buffer, sizeof(name_buffer) - 1);
+        if (ret < 0) {
+            fprintf(stderr, "profile: readlink: %m\n");
             exit(1);
         }
-    }
+        size_t name_size = ALIGN_UP(ret + 1, sizeof(size_t));
 
-    FILE* output_file = fopen(output_path, "w");
-    if (!output_file) {
-        fprintf(stderr, "profile: fopen: %m\n");
-        exit(1);
-    }
+        drain();
 
-    if (fwrite(&name_size, sizeof(size_t), 1, output_file) != 1) {
-        fprintf(stderr, "profile: fwrite: %m\n");
-        exit(1);
-    }
+        if (flags & Flags::Disable) {
+            if (disable_profiling(m_pid)) {
+                fprintf(stderr, "profile: disable_profiling: %m\n");
+                exit(1);
+            }
+        }
 
-    if (fwrite(name_buffer, 1, name_size, output_file) != name_size) {
-        fprintf(stderr, "profile: fprintf: %m\n");
-        exit(1);
-    }
+        if (fwrite(name_buffer, 1, name_size, m_output_file) != name_size) {
+            fprintf(stderr, "profile: fwrite: %m\n");
+            exit(1);
+        }
 
-    if (fwrite(buffer, 1, ret, output_file) != static_cast<size_t>(ret)) {
-        fprintf(stderr, "profile: fwrite: %m\n");
-        exit(1);
-    }
+        if (fwrite(&name_size, sizeof(size_t), 1, m_output_file) != 1) {
+            fprintf(stderr, "profile: fwrite: %m\n");
+            exit(1);
+        }
+
+        if (fclose(m_output_file) == EOF) {
+            fprintf(stderr, "profile: fclose: %m\n");
+            exit(1);
+        }
+        m_output_file = nullptr;
 
-    if (fclose(output_file) == EOF) {
-        fprintf(stderr, "profile: fclose: %m\n");
-        exit(1);
+        printf("Wrote profile of `%s' to `%s'\n", name_buffer, m_output_path);
     }
 
-    printf("Wrote profile of `%s' to `%s'\n", name_buffer, output_path);
+private:
+    pid_t m_pid;
+    const char* m_output_path;
+    FILE* m_output_file;
+    void* m_buffer;
+};
 
-    munmap(buffer, PROFILE_BUFFER_MAX);
+static void finish_and_view_profile(ProfileWriter& writer, pid_t pid, int flags, const ViewOptions& view_options) {
+    writer.finish(flags);
 
     if (flags & Flags::Wait) {
         pid_t wait_result = waitpid(pid, NULL, WNOHANG);
@@ -89,12 +133,12 @@ static void build_and_view_profile(pid_t pid, const char* output_path, int flags
     }
 
     if (!(flags & Flags::Quiet)) {
-        view_profile(output_path, !!(flags & Flags::Invert));
+        view_profile(writer.output_path(), view_options);
     }
 }
 
 void print_usage_and_exit(const char* s) {
-    fprintf(stderr, "Usage: %s [-i] [-o output] [-p pid] [-q] [-v file] [command...]\n", s);
+    fprintf(stderr, "Usage: %s [-ikqt] [-f folded-output] [-F frequency] [-o output] [-p pid] [-v file] [command...]\n", s);
     exit(2);
 }
 
@@ -103,14 +147,31 @@ int main(int argc, char** argv) {
     const char* to_view = nullptr;
     pid_t pid_to_profile = 0;
     int flags = Flags::Wait;
+    ViewOptions view_options;
+    profile_options options = { PROFILE_DEFAULT_FREQUENCY, 0 };
 
     signal(SIGWINCH, SIG_IGN);
 
     int opt;
-    while ((opt = getopt(argc, argv, ":io:p:qv:")) != -1) {
+    while ((opt = getopt(argc, argv, ":f:F:iko:p:qtv:")) != -1) {
         switch (opt) {
+            case 'f':
+                view_options.folded_output_path = optarg;
+                break;
+            case 'F': {
+                char* end;
+                long frequency = strtol(optarg, &end, 10);
+                if (!end || *end || frequency <= 0 || frequency > PROFILE_MAX_FREQUENCY) {
+                    print_usage_and_exit(*argv);
+                }
+                options.frequency = frequency;
+                break;
+            }
             case 'i':
-                flags |= Flags::Invert;
+                view_options.invert = true;
+                break;
+            case 'k':
+                options.flags |= PROFILE_KERNEL_STACKS;
                 break;
             case 'o':
                 output_path = optarg;
@@ -128,6 +189,9 @@ int main(int argc, char** argv) {
             case 'q':
                 flags |= Flags::Quiet;
                 break;
+            case 't':
+                view_options.per_thread = true;
+                break;
             case 'v':
                 to_view = optarg;
                 flags &= ~Flags::Wait;
@@ -140,51 +204,68 @@ int main(int argc, char** argv) {
     }
 
     if (to_view) {
-        view_profile(to_view, !!(flags & Flags::Invert));
+        view_profile(to_view, view_options);
         return 0;
     }
 
+    pid_t pid = pid_to_profile;
     if (pid_to_profile) {
-        if (enable_profiling(pid_to_profile)) {
+        if (enable_profiling(pid_to_profile, &options)) {
             fprintf(stderr, "profile: enable_profiling: %m\n");
             return 1;
         }
+    } else {
+        if (optind == argc) {
+            print_usage_and_exit(*argv);
+        }
 
-        printf("Press any key to stop profiling...");
-        fflush(stdout);
-        fgetc(stdin);
-
-        build_and_view_profile(pid_to_profile, output_path, flags);
-        return 0;
-    }
-
-    if (optind == argc) {
-        print_usage_and_exit(*argv);
-    }
-
-    pid_t pid = fork();
-    if (pid == 0) {
-        if (enable_profiling(getpid())) {
-            fprintf(stderr, "profile: start_profiling: %m\n");
-            _exit(1);
+        pid = fork();
+        if (pid == 0) {
+            if (enable_profiling(getpid(), &options)) {
+                fprintf(stderr, "profile: enable_profiling: %m\n");
+                _exit(1);
+            }
+            execvp(argv[optind], argv + optind);
+            fprintf(stderr, "profile: execv: %m\n");
+            _exit(127);
+        } else if (pid < 0) {
+            fprintf(stderr, "profile: fork: %m\n");
+            return 1;
         }
-        execvp(argv[optind], argv + optind);
-        fprintf(stderr, "profile: execv: %m\n");
-        _exit(127);
-    } else if (pid < 0) {
-        fprintf(stderr, "profile: fork: %m\n");
-        return 1;
     }
 
     App::EventLoop loop;
-    App::EventLoop::register_signal_handler(SIGCHLD, [&] {
-        build_and_view_profile(pid, output_path, flags);
-        loop.set_should_exit(true);
+    auto writer = ProfileWriter::create(pid, output_path);
+
+    auto drain_timer = App::Timer::create_interval_timer(nullptr, drain_interval_ms);
+    drain_timer->on<App::TimerEvent>({}, [&](auto&) {
+        writer->drain();
     });
+
+    SharedPtr<App::FdWrapper> input;
+    if (pid_to_profile) {
+        printf("Press any key to stop profiling...");
+        fflush(stdout);
+
+        input = App::FdWrapper::create(nullptr, STDIN_FILENO);
+        input->set_selected_events(App::NotifyWhen::Readable);
+        input->enable_notifications();
+        input->on<App::ReadableEvent>({}, [&](auto&) {
+            input->disable_notifications();
+            finish_and_view_profile(*writer, pid, flags, view_options);
+            loop.set_should_exit(true);
+        });
+    } else {
+        App::EventLoop::register_signal_handler(SIGCHLD, [&] {
+            finish_and_view_profile(*writer, pid, flags, view_options);
+            loop.set_should_exit(true);
+        });
+    }
+
     App::EventLoop::register_signal_handler(SIGINT, [&] {
         flags &= ~Flags::Wait;
         flags |= Flags::Disable | Flags::Quiet;
-        build_and_view_profile(pid, output_path, flags);
+        finish_and_view_profile(*writer, pid, flags, view_options);
         loop.set_should_exit(true);
     });
 
@@ -3,6 +3,7 @@
 #include <liim/hash_map.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/iros.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -42,64 +43,144 @@ private:
     Vector<MemoryObject> m_objects;
 };
 
-UniquePtr<Profile> Profile::create(const String& path, bool invert_profile) {
+// Returns the size of the event at offset, or 0 if it is malformed or runs past the end.
+static size_t event_size(const uint8_t* data, size_t offset, size_t end) {
+    auto* pev = PEV_AT_OFFSET(data, offset);
+    switch (pev->type) {
+        case PEV_STACK_TRACE: {
+            auto* ev = (const profile_event_stack_trace*) pev;
+            if (offset + sizeof(*ev) > end) {
+                return 0;
+            }
+            return PEV_STACK_TRACE_SIZE(ev);
+        }
+        case PEV_MEMORY_MAP: {
+            auto* ev = (const profile_event_memory_map*) pev;
+            if (offset + sizeof(*ev) > end) {
+                return 0;
+            }
+            return PEV_MEMORY_MAP_SIZE(ev);
+        }
+        case PEV_LOST:
+            return sizeof(profile_event_lost);
+        default:
+            fprintf(stderr, "profile: unknown profile event: %d\n", pev->type);
+            return 0;
+    }
+}
+
+UniquePtr<Profile> Profile::create(const String& path, const ViewOptions& options) {
     auto file = Ext::try_map_file(path, PROT_READ, MAP_SHARED);
-    if (!file) {
+    if (!file || file->size() < sizeof(size_t)) {
         return nullptr;
     }
 
-    size_t exec_name_length = *((size_t*) file->data());
-    auto exec_name = String((char*) (file->data() + sizeof(size_t)));
-    SharedPtr<ElfFile> executable = ElfFile::create(exec_name);
+    // The events are followed by the executable's name, since it is only known once the process has stopped.
+    size_t trailer_offset = file->size() - sizeof(size_t);
+    size_t exec_name_length;
+    memcpy(&exec_name_length, file->data() + trailer_offset, sizeof(size_t));
+    if (exec_name_length > trailer_offset) {
+        return nullptr;
+    }
+    size_t events_end = trailer_offset - exec_name_length;
+    auto exec_name = String((const char*) (file->data() + events_end));
+
+    Vector<SharedPtr<ElfFile>> objects;
+    auto keep_object = [&](const SharedPtr<ElfFile>& object) {
+        if (object && !objects.first_match([&](auto& o) {
+                return o.get() == object.get();
+            })) {
+            objects.add(object);
+        }
+    };
+
     SharedPtr<ElfFile> kernel_object = ElfFile::create("/boot/kernel");
-    ProfileNode root(exec_name, exec_name, 0);
+    keep_object(kernel_object);
+    keep_object(ElfFile::create(exec_name));
 
-    MemoryMap current_memory_map;
-    auto add_kernel_object = [&] {
+    auto add_kernel_object = [&](MemoryMap& memory_map) {
 #ifdef __x86_64__
-        current_memory_map.add({ 0xFFFFFF0000000000, 0xFFFFFFFFFFFFFFFF, kernel_object });
+        memory_map.add({ 0xFFFFFF0000000000, 0xFFFFFFFFFFFFFFFF, kernel_object });
 #else
-        current_memory_map.add({ 0xC0000000, 0xFFFFFFFF, kernel_object });
+        memory_map.add({ 0xC0000000, 0xFFFFFFFF, kernel_object });
 #endif
     };
-    add_kernel_object();
+
+    // Samples from different threads are interleaved with each other, so first collect every memory map, and then
+    // resolve each sample against the map it names.
+    HashMap<uint32_t, MemoryMap> memory_maps;
+    for (size_t offset = 0; offset < events_end;) {
+        size_t size = event_size(file->data(), offset, events_end);
+        if (!size || offset + size > events_end) {
+            return nullptr;
+        }
+
+        auto* pev = PEV_AT_OFFSET(file->data(), offset);
+        if (pev->type == PEV_MEMORY_MAP) {
+            auto* ev = (const profile_event_memory_map*) pev;
+            MemoryMap memory_map;
+            for (size_t i = 0; i < ev->count; i++) {
+                auto& raw_object = ev->mem[i];
+                auto object = ElfFile::find_or_create({ raw_object.inode_id, raw_object.fs_id });
+                keep_object(object);
+                memory_map.add({ raw_object.start, raw_object.end, move(object) });
+            }
+            add_kernel_object(memory_map);
+            memory_maps.put(ev->generation, move(memory_map));
+        }
+        offset += size;
+    }
+
+    MemoryMap kernel_only_map;
+    add_kernel_object(kernel_only_map);
+
+    auto resolve = [&](const MemoryMap& memory_map, uintptr_t addr) -> Symbol {
+        auto* memory_object = memory_map.find_by_addr(addr);
+        if (memory_object && memory_object->file) {
+            uintptr_t offset = addr;
+            if (memory_object->file->relocatable()) {
+                offset -= memory_object->start;
+            }
+            auto result = memory_object->file->lookup_symbol(offset);
+            if (result.has_value()) {
+                return { result.value().name, memory_object->file.get(), addr - result.value().offset, 0 };
+            }
+        }
+        return { nullptr, nullptr, addr, 0 };
+    };
+
+    ProfileNode root { Symbol {} };
+    size_t lost_samples = 0;
 
     auto process_stack_trace = [&](const profile_event_stack_trace* ev) {
         if (ev->count == 0) {
             return;
         }
 
+        auto memory_map = memory_maps.get(ev->memory_map);
+        const MemoryMap& current_memory_map = memory_map ? *memory_map : kernel_only_map;
+
         auto* current_node = &root;
+        if (options.per_thread) {
+            current_node->bump_total_count();
+            current_node = current_node->link({ nullptr, nullptr, 0, ev->tid });
+        }
+
+        bool invert_profile = options.invert;
         for (size_t i = invert_profile ? 1 : ev->count; invert_profile ? i <= ev->count : i > 0; invert_profile ? i++ : i--) {
-            auto addr = ev->frames[i - 1];
-
-            String symbol_name = "??";
-            String object_path = "??";
-            auto* memory_object = current_memory_map.find_by_addr(addr);
-            if (memory_object && memory_object->file) {
-                uintptr_t offset = addr;
-                if (memory_object->file->relocatable()) {
-                    offset -= memory_object->start;
-                }
-                auto result = memory_object->file->lookup_symbol(offset);
-                if (result.has_value()) {
-                    symbol_name = result.value().name;
-                    addr -= result.value().offset;
-                    object_path = memory_object->file->path();
-                }
-            }
+            auto symbol = resolve(current_memory_map, ev->frames[i - 1]);
 
             if (!invert_profile || i != 2) {
                 current_node->bump_total_count();
             }
 
-            current_node = current_node->link(symbol_name, object_path, addr);
+            current_node = current_node->link(symbol);
             if (invert_profile && i == 1) {
                 current_node->bump_self_count();
             }
 
 #ifdef PROFILE_DEBUG
-            printf("Symbol: [ %#.16lX, %s ]\n", addr, symbol_name.string());
+            printf("Symbol: [ %#.16lX, %s ]\n", symbol.address, current_node->name().string());
 #endif /* PROFILE_DEBUG */
         }
 
@@ -114,56 +195,43 @@ UniquePtr<Profile> Profile::create(const String& path, bool invert_profile) {
 #endif /* PROFILE_DEBUG */
     };
 
-    auto process_memory_map = [&](const profile_event_memory_map* ev) {
-        MemoryMap new_memory_map;
-        for (size_t i = 0; i < ev->count; i++) {
-            auto& raw_object = ev->mem[i];
-            new_memory_map.add({ raw_object.start, raw_object.end, ElfFile::find_or_create({ raw_object.inode_id, raw_object.fs_id }) });
-        }
-        current_memory_map.objects() = move(new_memory_map.objects());
-        add_kernel_object();
-    };
-
-    size_t offset = sizeof(size_t) + exec_name_length;
-    while (offset < file->size()) {
+    for (size_t offset = 0; offset < events_end;) {
         auto* pev = PEV_AT_OFFSET(file->data(), offset);
-        switch (pev->type) {
-            case PEV_STACK_TRACE: {
-                auto* ev = (const profile_event_stack_trace*) pev;
-                process_stack_trace(ev);
-                offset += PEV_STACK_TRACE_SIZE(ev);
-                break;
-            }
-            case PEV_MEMORY_MAP: {
-                auto* ev = (const profile_event_memory_map*) pev;
-                process_memory_map(ev);
-                offset += PEV_MEMORY_MAP_SIZE(ev);
-                break;
-            }
-            default:
-                fprintf(stderr, "profile: unknown profile event: %d\n", pev->type);
-                return nullptr;
+        if (pev->type == PEV_STACK_TRACE) {
+            process_stack_trace((const profile_event_stack_trace*) pev);
+        } else if (pev->type == PEV_LOST) {
+            lost_samples += ((const profile_event_lost*) pev)->count;
         }
+        offset += event_size(file->data(), offset, events_end);
     }
 
-#ifdef PROFILE_DEBUG
-    for (auto& object : current_memory_map.objects()) {
-        fprintf(stderr, "Object: [ %#.16lX, %#.16lX, %s ]\n", object.start, object.end, object.file ? object.file->path().string() : "??");
-    }
-#endif /* PROFILE_DEBUG */
-
     root.sort();
 
-    return make_unique<Profile>(move(root));
+    return make_unique<Profile>(move(exec_name), move(root), move(objects), lost_samples);
+}
+
+Profile::Profile(String name, ProfileNode root, Vector<SharedPtr<ElfFile>> objects, size_t lost_samples)
+    : m_name(move(name)), m_root(move(root)), m_objects(move(objects)), m_lost_samples(lost_samples) {
+    m_root.set_symbol({ m_name.string(), nullptr, 0, 0 });
+}
+
+String ProfileNode::name() const {
+    if (m_symbol.name) {
+        return m_symbol.name;
+    }
+    if (m_symbol.tid) {
+        return String::format("[thread %d]", m_symbol.tid);
+    }
+    return "??";
 }
 
-ProfileNode* ProfileNode::link(const String& name, const String& object_path, uintptr_t address) {
+ProfileNode* ProfileNode::link(const Symbol& symbol) {
     auto* node = m_nodes.first_match([&](auto& n) {
-        return n.name() == name && n.address() == address && n.object_path() == object_path;
+        return n.symbol() == symbol;
     });
 
     if (!node) {
-        m_nodes.add(ProfileNode(name, object_path, address));
+        m_nodes.add(ProfileNode(symbol));
         node = &m_nodes.last();
     }
 
@@ -171,12 +239,25 @@ ProfileNode* ProfileNode::link(const String& name, const String& object_path, ui
 }
 
 void ProfileNode::dump(int level) const {
-    printf("%*s ( %lu / %lu )\n", static_cast<int>(m_name.size()) + level, m_name.string(), m_self_count, m_total_count);
+    auto name = this->name();
+    printf("%*s ( %lu / %lu )\n", static_cast<int>(name.size()) + level, name.string(), m_self_count, m_total_count);
     for (auto& child : m_nodes) {
         child.dump(level + 1);
     }
 }
 
+// Writes one line per distinct stack, in the folded format read by flame graph tools: the frames from the root down,
+// separated by semicolons, followed by the number of samples which ended there.
+void ProfileNode::dump_folded(FILE* file, const String& prefix) const {
+    auto stack = prefix.empty() ? name() : String::format("%s;%s", prefix.string(), name().string());
+    if (m_self_count) {
+        fprintf(file, "%s %lu\n", stack.string(), m_self_count);
+    }
+    for (auto& child : m_nodes) {
+        child.dump_folded(file, stack);
+    }
+}
+
 void ProfileNode::sort() {
     Alg::sort(m_nodes, CompareThreeWayBackwards {}, &ProfileNode::total_count);
 
@@ -189,12 +270,34 @@ void Profile::dump() const {
     m_root.dump(0);
 }
 
-void view_profile(const String& path, bool invert_profile) {
-    auto profile = Profile::create(path, invert_profile);
+bool Profile::dump_folded(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    m_root.dump_folded(file, "");
+    return fclose(file) == 0;
+}
+
+void view_profile(const String& path, const ViewOptions& options) {
+    auto profile = Profile::create(path, options);
     if (!profile) {
         fprintf(stderr, "profile: failed to read profile file `%s'\n", path.string());
         exit(1);
     }
 
+    if (profile->lost_samples()) {
+        fprintf(stderr, "profile: %lu samples were lost\n", profile->lost_samples());
+    }
+
+    if (options.folded_output_path) {
+        if (!profile->dump_folded(options.folded_output_path)) {
+            fprintf(stderr, "profile: failed to write `%s': %m\n", options.folded_output_path);
+            exit(1);
+        }
+        return;
+    }
+
     profile->dump();
 }
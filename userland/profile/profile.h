@@ -2,16 +2,35 @@
 
 #include <liim/pointers.h>
 #include <liim/string.h>
+#include <liim/vector.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+class ElfFile;
+
+// Identifies a node without copying anything: names point into the symbol tables of the profile's ELF files, which
+// are kept mapped for as long as the profile exists. Nodes for per-thread roots have a tid and no name.
+struct Symbol {
+    const char* name { nullptr };
+    const ElfFile* object { nullptr };
+    uintptr_t address { 0 };
+    pid_t tid { 0 };
+
+    bool operator==(const Symbol& other) const {
+        return name == other.name && object == other.object && address == other.address && tid == other.tid;
+    }
+    bool operator!=(const Symbol& other) const { return !(*this == other); }
+};
 
 class ProfileNode {
 public:
-    ProfileNode(String name, String object_path, uintptr_t address)
-        : m_name(move(name)), m_object_path(move(object_path)), m_address(address) {}
+    explicit ProfileNode(Symbol symbol) : m_symbol(symbol) {}
 
     const Vector<ProfileNode>& nodes() const { return m_nodes; }
 
-    const String& name() const { return m_name; }
-    const String& object_path() const { return m_object_path; }
+    const Symbol& symbol() const { return m_symbol; }
+    void set_symbol(Symbol symbol) { m_symbol = symbol; }
+    String name() const;
 
     void bump_total_count() { m_total_count++; }
     size_t total_count() const { return m_total_count; }
@@ -22,31 +41,40 @@ public:
     }
     size_t self_count() const { return m_self_count; }
 
-    uintptr_t address() const { return m_address; }
-
-    ProfileNode* link(const String& name, const String& object_path, uintptr_t address);
+    ProfileNode* link(const Symbol& symbol);
     void dump(int level) const;
+    void dump_folded(FILE* file, const String& prefix) const;
     void sort();
 
 private:
     Vector<ProfileNode> m_nodes;
-    String m_name;
-    String m_object_path;
+    Symbol m_symbol;
     size_t m_total_count { 0 };
     size_t m_self_count { 0 };
-    uintptr_t m_address { 0 };
+};
+
+struct ViewOptions {
+    bool invert { false };
+    bool per_thread { false };
+    const char* folded_output_path { nullptr };
 };
 
 class Profile {
 public:
-    static UniquePtr<Profile> create(const String& path, bool invert_profile);
+    static UniquePtr<Profile> create(const String& path, const ViewOptions& options);
 
-    Profile(ProfileNode root) : m_root(move(root)) {}
+    Profile(String name, ProfileNode root, Vector<SharedPtr<ElfFile>> objects, size_t lost_samples);
 
     void dump() const;
+    bool dump_folded(const char* path) const;
+
+    size_t lost_samples() const { return m_lost_samples; }
 
 private:
+    String m_name;
     ProfileNode m_root;
+    Vector<SharedPtr<ElfFile>> m_objects;
+    size_t m_lost_samples { 0 };
 };
 
-void view_profile(const String& path, bool invert_profile);
+void view_profile(const String& path, const ViewOptions& options);
@@ -0,0 +1,250 @@
+#include <string.h>
+
+#include "line_comparator.h"
+
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static const char* skip_blanks(const char* s, const char* end) {
+    while (s < end && is_blank(*s)) {
+        s++;
+    }
+    return s;
+}
+
+static const char* parse_decimal(const char* s, int& value) {
+    if (*s < '0' || *s > '9') {
+        return nullptr;
+    }
+
+    value = 0;
+    for (; *s >= '0' && *s <= '9'; s++) {
+        value = value * 10 + (*s - '0');
+        if (value > 100000000) {
+            return nullptr;
+        }
+    }
+    return s;
+}
+
+static const char* parse_position(const char* s, KeyPosition& position, SortKey& key, bool is_end) {
+    if (!(s = parse_decimal(s, position.field)) || position.field == 0) {
+        return nullptr;
+    }
+
+    position.character = is_end ? 0 : 1;
+    if (*s == '.') {
+        if (!(s = parse_decimal(s + 1, position.character)) || (!is_end && position.character == 0)) {
+            return nullptr;
+        }
+    }
+
+    for (;; s++) {
+        switch (*s) {
+            case 'b':
+                (is_end ? key.skip_end_blanks : key.skip_start_blanks) = true;
+                break;
+            case 'n':
+                key.numeric = true;
+                break;
+            case 'r':
+                key.reverse = true;
+                break;
+            default:
+                return s;
+        }
+        key.has_flags = true;
+    }
+}
+
+Option<SortKey> parse_sort_key(const char* spec) {
+    SortKey key;
+    if (!(spec = parse_position(spec, key.start, key, false))) {
+        return {};
+    }
+
+    if (*spec == ',') {
+        KeyPosition end;
+        if (!(spec = parse_position(spec + 1, end, key, true))) {
+            return {};
+        }
+        key.end = end;
+    }
+
+    if (*spec != '\0') {
+        return {};
+    }
+    return key;
+}
+
+static int compare_bytes(StringView a, StringView b) {
+    size_t length = a.size() < b.size() ? a.size() : b.size();
+    if (int result = memcmp(a.data(), b.data(), length)) {
+        return result;
+    }
+    if (a.size() == b.size()) {
+        return 0;
+    }
+    return a.size() < b.size() ? -1 : 1;
+}
+
+namespace {
+struct Number {
+    bool negative { false };
+    StringView integer;
+    StringView fraction;
+};
+}
+
+// Numbers are compared digit by digit rather than converted, so that they can have any number of digits. Anything
+// which does not start with a number compares as zero.
+static Number parse_numeric_key(StringView s) {
+    auto* p = skip_blanks(s.data(), s.data() + s.size());
+    auto* end = s.data() + s.size();
+
+    Number number;
+    if (p < end && *p == '-') {
+        number.negative = true;
+        p++;
+    }
+    while (p < end && *p == '0') {
+        p++;
+    }
+
+    auto* integer = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        p++;
+    }
+    number.integer = StringView(integer, p);
+
+    if (p < end && *p == '.') {
+        auto* fraction = ++p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            p++;
+        }
+        while (p > fraction && p[-1] == '0') {
+            p--;
+        }
+        number.fraction = StringView(fraction, p);
+    }
+
+    if (number.integer.size() == 0 && number.fraction.size() == 0) {
+        number.negative = false;
+    }
+    return number;
+}
+
+static int compare_numbers(StringView a, StringView b) {
+    auto x = parse_numeric_key(a);
+    auto y = parse_numeric_key(b);
+    if (x.negative != y.negative) {
+        return x.negative ? -1 : 1;
+    }
+
+    int result;
+    if (x.integer.size() != y.integer.size()) {
+        result = x.integer.size() < y.integer.size() ? -1 : 1;
+    } else if (!(result = memcmp(x.integer.data(), y.integer.data(), x.integer.size()))) {
+        result = compare_bytes(x.fraction, y.fraction);
+    }
+    return x.negative ? -result : result;
+}
+
+LineComparator::LineComparator(Vector<SortKey> keys, Option<char> separator, bool numeric, bool reverse, bool skip_blanks,
+                               bool unique)
+    : m_keys(move(keys)), m_separator(separator), m_reverse(reverse), m_unique(unique) {
+    if (m_keys.empty()) {
+        m_keys.add(SortKey {});
+    }
+
+    for (auto& key : m_keys) {
+        if (!key.has_flags) {
+            key.numeric = numeric;
+            key.reverse = reverse;
+            key.skip_start_blanks = skip_blanks;
+            key.skip_end_blanks = skip_blanks;
+        }
+    }
+}
+
+// Without a separator, a field is a run of blanks followed by a run of non-blanks, so fields include their leading
+// blanks unless the key skips them.
+const char* LineComparator::field_start(StringView line, int field) const {
+    auto* p = line.data();
+    auto* end = line.data() + line.size();
+    for (int i = 1; i < field && p < end; i++) {
+        if (m_separator) {
+            auto* separator = static_cast<const char*>(memchr(p, *m_separator, end - p));
+            p = separator ? separator + 1 : end;
+        } else {
+            p = skip_blanks(p, end);
+            while (p < end && !is_blank(*p)) {
+                p++;
+            }
+        }
+    }
+    return p;
+}
+
+const char* LineComparator::field_end(StringView line, const char* start) const {
+    auto* end = line.data() + line.size();
+    if (m_separator) {
+        auto* separator = static_cast<const char*>(memchr(start, *m_separator, end - start));
+        return separator ? separator : end;
+    }
+
+    auto* p = skip_blanks(start, end);
+    while (p < end && !is_blank(*p)) {
+        p++;
+    }
+    return p;
+}
+
+StringView LineComparator::key(const SortKey& key, StringView line) const {
+    auto* line_end = line.data() + line.size();
+
+    auto* start = field_start(line, key.start.field);
+    if (key.skip_start_blanks) {
+        start = skip_blanks(start, line_end);
+    }
+    start += min<size_t>(key.start.character - 1, line_end - start);
+
+    auto* end = line_end;
+    if (key.end) {
+        end = field_start(line, key.end->field);
+        if (key.end->character == 0) {
+            end = field_end(line, end);
+        } else {
+            if (key.skip_end_blanks) {
+                end = skip_blanks(end, line_end);
+            }
+            end += min<size_t>(key.end->character, line_end - end);
+        }
+    }
+
+    if (end < start) {
+        end = start;
+    }
+    return StringView(start, end);
+}
+
+int LineComparator::compare(StringView a, StringView a_first_key, StringView b, StringView b_first_key) const {
+    for (int i = 0; i < m_keys.size(); i++) {
+        auto& sort_key = m_keys[i];
+        auto a_key = i == 0 ? a_first_key : key(sort_key, a);
+        auto b_key = i == 0 ? b_first_key : key(sort_key, b);
+
+        int result = sort_key.numeric ? compare_numbers(a_key, b_key) : compare_bytes(a_key, b_key);
+        if (result != 0) {
+            return sort_key.reverse ? -result : result;
+        }
+    }
+
+    if (m_unique) {
+        return 0;
+    }
+
+    int result = compare_bytes(a, b);
+    return m_reverse ? -result : result;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <liim/option.h>
+#include <liim/string_view.h>
+#include <liim/vector.h>
+
+struct KeyPosition {
+    // Both are 1-based. A character of 0 in the end position means the end of the field.
+    int field { 1 };
+    int character { 1 };
+};
+
+struct SortKey {
+    KeyPosition start;
+    Option<KeyPosition> end;
+    bool numeric { false };
+    bool reverse { false };
+    // Given separately for the start and end positions.
+    bool skip_start_blanks { false };
+    bool skip_end_blanks { false };
+    // Whether any of the flags above were given with the key, in which case the global flags do not apply to it.
+    bool has_flags { false };
+};
+
+// Parses a -k argument of the form F[.C][OPTS][,F[.C][OPTS]].
+Option<SortKey> parse_sort_key(const char* spec);
+
+class LineComparator {
+public:
+    // With no keys, the whole line is the key. The global flags apply to every key which has none of its own.
+    LineComparator(Vector<SortKey> keys, Option<char> separator, bool numeric, bool reverse, bool skip_blanks, bool unique);
+
+    // Returns where the first key is in the line. The sorter stores this beside each line, since the first key
+    // usually decides the comparison.
+    StringView first_key(StringView line) const { return key(m_keys[0], line); }
+
+    // Orders lines by their keys. Lines with equal keys are then ordered by their bytes, unless -u was given, in which
+    // case they compare equal and only the first is output.
+    int compare(StringView a, StringView a_first_key, StringView b, StringView b_first_key) const;
+
+    bool unique() const { return m_unique; }
+
+private:
+    StringView key(const SortKey& key, StringView line) const;
+    const char* field_start(StringView line, int field) const;
+    const char* field_end(StringView line, const char* start) const;
+
+    Vector<SortKey> m_keys;
+    Option<char> m_separator;
+    bool m_reverse { false };
+    bool m_unique { false };
+};
@@ -1,4 +1,6 @@
-#include <liim/container/algorithm/sort.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <liim/option.h>
 #include <liim/string.h>
 #include <liim/vector.h>
 #include <stdio.h>
@@ -6,57 +8,140 @@
 #include <string.h>
 #include <unistd.h>
 
-int read_all_path(const char* path, Vector<String>& lines) {
-    FILE* file;
-    if (strcmp(path, "-") == 0) {
-        file = stdin;
-    } else {
-        file = fopen(path, "r");
-        if (!file) {
-            perror("sort: fopen");
-            return 1;
-        }
-    }
+#include "line_comparator.h"
+#include "sorter.h"
 
-    char* line = nullptr;
-    size_t line_max = 0;
-    ssize_t line_length;
-    while ((line_length = getline(&line, &line_max, file)) != -1) {
-        char* trailing_newline = strchr(line, '\n');
-        if (trailing_newline) {
-            *trailing_newline = '\0';
-        }
+static constexpr size_t default_memory_budget = 256 * 1024 * 1024;
+static constexpr size_t min_memory_budget = 1024 * 1024;
+static constexpr int max_threads = 64;
 
-        lines.add(String(line));
+static int read_path(Sorter& sorter, const char* path) {
+    int fd = 0;
+    if (strcmp(path, "-") != 0) {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            perror("sort: open");
+            return 1;
+        }
     }
 
-    free(line);
-
-    int ret = 0;
-    if (ferror(file)) {
-        perror("sort: getline");
+    int ret = sorter.read(fd) ? 0 : 1;
+    if (fd != 0 && close(fd)) {
+        perror("sort: close");
         ret = 1;
     }
+    return ret;
+}
 
-    if (file == stdin) {
-        clearerr(stdin);
-    } else if (fclose(file)) {
-        perror("sort: fclose");
-        ret = 1;
+// Parses a -S argument, which is a number of kibibytes unless it ends in b, K, M, G or T.
+static Option<size_t> parse_memory_size(const char* s) {
+    char* end;
+    unsigned long long value = strtoull(s, &end, 10);
+    if (end == s) {
+        return {};
     }
 
-    return ret;
+    int shift;
+    switch (*end) {
+        case 'b':
+            shift = 0;
+            break;
+        case '\0':
+        case 'K':
+        case 'k':
+            shift = 10;
+            break;
+        case 'M':
+        case 'm':
+            shift = 20;
+            break;
+        case 'G':
+        case 'g':
+            shift = 30;
+            break;
+        case 'T':
+        case 't':
+            shift = 40;
+            break;
+        default:
+            return {};
+    }
+    if (*end && end[1] != '\0') {
+        return {};
+    }
+    return static_cast<size_t>(value) << shift;
 }
 
 void print_usage_and_exit(const char* s) {
-    fprintf(stderr, "Usage: %s [files...]\n", s);
+    fprintf(stderr, "Usage: %s [-bnru] [-k key]... [-t char] [-S size] [-T dir] [--parallel=n] [files...]\n", s);
     exit(3);
 }
 
 int main(int argc, char** argv) {
+    Vector<SortKey> keys;
+    const char* separator = nullptr;
+    bool numeric = false;
+    bool reverse = false;
+    bool skip_blanks = false;
+    bool unique = false;
+    size_t memory_budget = default_memory_budget;
+    String temporary_directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    int thread_count = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+
+    static const option long_options[] = {
+        { "parallel", required_argument, nullptr, 'P' },
+        { nullptr, 0, nullptr, 0 },
+    };
+
     int opt;
-    while ((opt = getopt(argc, argv, ":")) != -1) {
+    while ((opt = getopt_long(argc, argv, ":bk:nrS:t:T:u", long_options, nullptr)) != -1) {
         switch (opt) {
+            case 'b':
+                skip_blanks = true;
+                break;
+            case 'k': {
+                auto key = parse_sort_key(optarg);
+                if (!key) {
+                    fprintf(stderr, "sort: invalid key `%s'\n", optarg);
+                    print_usage_and_exit(*argv);
+                }
+                keys.add(*key);
+                break;
+            }
+            case 'n':
+                numeric = true;
+                break;
+            case 'P':
+                thread_count = atoi(optarg);
+                if (thread_count <= 0) {
+                    print_usage_and_exit(*argv);
+                }
+                break;
+            case 'r':
+                reverse = true;
+                break;
+            case 'S': {
+                auto size = parse_memory_size(optarg);
+                if (!size) {
+                    fprintf(stderr, "sort: invalid memory size `%s'\n", optarg);
+                    print_usage_and_exit(*argv);
+                }
+                memory_budget = max(*size, min_memory_budget);
+                break;
+            }
+            case 't':
+                if (optarg[0] == '\0' || optarg[1] != '\0') {
+                    fprintf(stderr, "sort: separator must be a single character\n");
+                    print_usage_and_exit(*argv);
+                }
+                separator = optarg;
+                break;
+            case 'T':
+                temporary_directory = optarg;
+                break;
+            case 'u':
+                unique = true;
+                break;
             case ':':
             case '?':
                 print_usage_and_exit(*argv);
@@ -68,17 +153,19 @@ int main(int argc, char** argv) {
         argv[argc++] = const_cast<char*>("-");
     }
 
-    Vector<String> lines;
+    thread_count = max(1, min(thread_count, max_threads));
+
+    auto separator_char = separator ? Option<char>(*separator) : Option<char>();
+    LineComparator comparator(move(keys), separator_char, numeric, reverse, skip_blanks, unique);
+    Sorter sorter(comparator, memory_budget, thread_count, move(temporary_directory));
     for (; optind < argc; optind++) {
-        if (read_all_path(argv[optind], lines)) {
+        if (read_path(sorter, argv[optind])) {
             return 1;
         }
     }
 
-    Alg::sort(lines);
-    lines.for_each([&](auto& s) {
-        puts(s.string());
-    });
-
+    if (!sorter.finish(STDOUT_FILENO)) {
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,558 @@
+#include <errno.h>
+#include <liim/pointers.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sorter.h"
+
+namespace {
+constexpr size_t read_size = 1024 * 1024;
+constexpr size_t output_buffer_size = 1024 * 1024;
+constexpr size_t min_run_buffer_size = 64 * 1024;
+// Below this many lines per thread, starting the threads costs more than it saves.
+constexpr int min_lines_per_thread = 16384;
+constexpr int insertion_sort_width = 16;
+
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd) : m_fd(fd), m_buffer(static_cast<char*>(malloc(output_buffer_size))) {}
+    ~OutputBuffer() { free(m_buffer); }
+
+    bool write_line(StringView line) {
+        if (m_size + line.size() + 1 > output_buffer_size) {
+            if (!flush()) {
+                return false;
+            }
+            if (line.size() + 1 > output_buffer_size) {
+                return write_all(line.data(), line.size()) && write_all("\n", 1);
+            }
+        }
+
+        memcpy(m_buffer + m_size, line.data(), line.size());
+        m_buffer[m_size + line.size()] = '\n';
+        m_size += line.size() + 1;
+        return true;
+    }
+
+    bool flush() {
+        bool ret = write_all(m_buffer, m_size);
+        m_size = 0;
+        return ret;
+    }
+
+private:
+    bool write_all(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t written = write(m_fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("sort: write");
+                return false;
+            }
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    int m_fd;
+    char* m_buffer;
+    size_t m_size { 0 };
+};
+
+// Reads back the lines of a sorted run, which all end in a newline.
+class RunReader {
+public:
+    RunReader(const LineComparator& comparator, int fd, size_t buffer_size)
+        : m_comparator(comparator), m_fd(fd), m_buffer(static_cast<char*>(malloc(buffer_size))), m_capacity(buffer_size) {}
+    ~RunReader() { free(m_buffer); }
+
+    bool start() {
+        if (lseek(m_fd, 0, SEEK_SET) < 0) {
+            perror("sort: lseek");
+            return false;
+        }
+        return advance();
+    }
+
+    bool has_line() const { return m_has_line; }
+    const Sorter::Line& line() const { return m_line; }
+
+    // The previous line is invalid once this is called.
+    bool advance() {
+        for (;;) {
+            auto* start = m_buffer + m_position;
+            auto* end = m_buffer + m_size;
+            if (auto* newline = static_cast<char*>(memchr(start, '\n', end - start))) {
+                auto text = StringView(start, newline);
+                m_line = { text, m_comparator.first_key(text) };
+                m_position = newline + 1 - m_buffer;
+                return true;
+            }
+
+            if (m_eof) {
+                m_has_line = false;
+                return true;
+            }
+
+            memmove(m_buffer, start, end - start);
+            m_size = end - start;
+            m_position = 0;
+            if (m_size == m_capacity) {
+                auto* buffer = static_cast<char*>(realloc(m_buffer, m_capacity * 2));
+                if (!buffer) {
+                    perror("sort: realloc");
+                    return false;
+                }
+                m_buffer = buffer;
+                m_capacity *= 2;
+            }
+
+            ssize_t count = ::read(m_fd, m_buffer + m_size, m_capacity - m_size);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("sort: read");
+                return false;
+            }
+            m_eof = count == 0;
+            m_size += count;
+        }
+    }
+
+private:
+    const LineComparator& m_comparator;
+    int m_fd;
+    char* m_buffer;
+    size_t m_capacity;
+    size_t m_size { 0 };
+    size_t m_position { 0 };
+    Sorter::Line m_line;
+    bool m_has_line { true };
+    bool m_eof { false };
+};
+
+// A slice of lines sorted in memory.
+class SliceReader {
+public:
+    SliceReader(const Sorter::Line* start, const Sorter::Line* end) : m_next(start), m_end(end) {}
+
+    bool has_line() const { return m_next < m_end; }
+    const Sorter::Line& line() const { return *m_next; }
+    bool advance() {
+        m_next++;
+        return true;
+    }
+
+private:
+    const Sorter::Line* m_next;
+    const Sorter::Line* m_end;
+};
+
+// A binary heap of the readers which still have lines, ordered by their current line. Ties go to the reader which
+// came first, so that merging is stable and -u keeps the first of several equal lines.
+template<typename Reader>
+class MergeQueue {
+public:
+    MergeQueue(const Sorter& sorter, Vector<Reader*> readers) : m_sorter(sorter) {
+        for (int i = 0; i < readers.size(); i++) {
+            if (readers[i]->has_line()) {
+                m_heap.add({ readers[i], i });
+            }
+        }
+        for (int i = m_heap.size() / 2 - 1; i >= 0; i--) {
+            sift_down(i);
+        }
+    }
+
+    bool empty() const { return m_heap.empty(); }
+    Reader& top() { return *m_heap[0].reader; }
+
+    // Called after the top reader advanced.
+    void update() {
+        if (!m_heap[0].reader->has_line()) {
+            m_heap[0] = m_heap.last();
+            m_heap.remove_last();
+        }
+        if (!m_heap.empty()) {
+            sift_down(0);
+        }
+    }
+
+private:
+    struct Entry {
+        Reader* reader;
+        int order;
+    };
+
+    bool less(const Entry& a, const Entry& b) const {
+        int result = m_sorter.compare(a.reader->line(), b.reader->line());
+        return result < 0 || (result == 0 && a.order < b.order);
+    }
+
+    void sift_down(int index) {
+        for (;;) {
+            int smallest = index;
+            int left = 2 * index + 1;
+            int right = left + 1;
+            if (left < m_heap.size() && less(m_heap[left], m_heap[smallest])) {
+                smallest = left;
+            }
+            if (right < m_heap.size() && less(m_heap[right], m_heap[smallest])) {
+                smallest = right;
+            }
+            if (smallest == index) {
+                return;
+            }
+            LIIM::swap(m_heap[index], m_heap[smallest]);
+            index = smallest;
+        }
+    }
+
+    const Sorter& m_sorter;
+    Vector<Entry> m_heap;
+};
+
+template<typename Reader>
+bool merge(const Sorter& sorter, Vector<Reader*> readers, OutputBuffer& output) {
+    MergeQueue<Reader> queue(sorter, move(readers));
+
+    // With -u, the last line written is kept so that later lines with the same keys can be dropped. It is copied,
+    // since a run reader may reuse its buffer.
+    bool unique = sorter.comparator().unique();
+    Vector<char> previous_text;
+    Sorter::Line previous;
+    bool has_previous = false;
+
+    while (!queue.empty()) {
+        auto& reader = queue.top();
+        auto& line = reader.line();
+        if (!unique || !has_previous || sorter.compare(previous, line) != 0) {
+            if (!output.write_line(line.text)) {
+                return false;
+            }
+
+            if (unique) {
+                previous_text.resize(line.text.size());
+                memcpy(previous_text.vector(), line.text.data(), line.text.size());
+                auto text = StringView(previous_text.vector(), line.text.size());
+                previous = { text, sorter.comparator().first_key(text) };
+                has_previous = true;
+            }
+        }
+
+        if (!reader.advance()) {
+            return false;
+        }
+        queue.update();
+    }
+    return output.flush();
+}
+
+struct SortTask {
+    const Sorter* sorter;
+    Sorter::Line* lines;
+    Sorter::Line* scratch;
+    int count;
+};
+
+// A bottom up merge sort, which is stable and never degrades on inputs with many equal lines.
+void merge_sort(const Sorter& sorter, Sorter::Line* lines, Sorter::Line* scratch, int count) {
+    for (int start = 0; start < count; start += insertion_sort_width) {
+        int end = min(start + insertion_sort_width, count);
+        for (int i = start + 1; i < end; i++) {
+            auto line = lines[i];
+            int j = i;
+            for (; j > start && sorter.compare(line, lines[j - 1]) < 0; j--) {
+                lines[j] = lines[j - 1];
+            }
+            lines[j] = line;
+        }
+    }
+
+    auto* from = lines;
+    auto* to = scratch;
+    for (int width = insertion_sort_width; width < count; width *= 2) {
+        for (int start = 0; start < count; start += 2 * width) {
+            int middle = min(start + width, count);
+            int end = min(start + 2 * width, count);
+            int left = start;
+            int right = middle;
+            int out = start;
+            while (left < middle && right < end) {
+                if (sorter.compare(from[right], from[left]) < 0) {
+                    to[out++] = from[right++];
+                } else {
+                    to[out++] = from[left++];
+                }
+            }
+            while (left < middle) {
+                to[out++] = from[left++];
+            }
+            while (right < end) {
+                to[out++] = from[right++];
+            }
+        }
+        LIIM::swap(from, to);
+    }
+
+    if (from != lines) {
+        for (int i = 0; i < count; i++) {
+            lines[i] = from[i];
+        }
+    }
+}
+
+void* run_sort_task(void* closure) {
+    auto& task = *static_cast<SortTask*>(closure);
+    merge_sort(*task.sorter, task.lines, task.scratch, task.count);
+    return nullptr;
+}
+}
+
+Sorter::Sorter(const LineComparator& comparator, size_t memory_budget, int thread_count, String temporary_directory)
+    : m_comparator(comparator)
+    , m_memory_budget(memory_budget)
+    , m_thread_count(thread_count)
+    , m_temporary_directory(move(temporary_directory)) {}
+
+Sorter::~Sorter() {
+    free(m_arena);
+    for (auto fd : m_runs) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void Sorter::add_line(const char* start, const char* end) {
+    auto text = StringView(start, end);
+    m_lines.add({ text, m_comparator.first_key(text) });
+}
+
+bool Sorter::read(int fd) {
+    if (!m_arena) {
+        // The arena is only touched as it fills, so most of it is never paged in for small inputs.
+        m_arena_capacity = m_memory_budget;
+        m_arena = static_cast<char*>(malloc(m_arena_capacity));
+        if (!m_arena) {
+            perror("sort: malloc");
+            return false;
+        }
+    }
+
+    for (;;) {
+        if (m_arena_size == m_arena_capacity || (!m_lines.empty() && memory_used() >= m_memory_budget)) {
+            if (!make_room()) {
+                return false;
+            }
+        }
+
+        ssize_t count = ::read(fd, m_arena + m_arena_size, min(read_size, m_arena_capacity - m_arena_size));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("sort: read");
+            return false;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        auto* p = m_arena + m_arena_size;
+        auto* end = p + count;
+        while (auto* newline = static_cast<char*>(memchr(p, '\n', end - p))) {
+            add_line(m_arena + m_partial_line, newline);
+            p = newline + 1;
+            m_partial_line = p - m_arena;
+        }
+        m_arena_size += count;
+    }
+
+    // The last line of a file need not end in a newline.
+    if (m_partial_line < m_arena_size) {
+        add_line(m_arena + m_partial_line, m_arena + m_arena_size);
+        m_partial_line = m_arena_size;
+    }
+    return true;
+}
+
+bool Sorter::make_room() {
+    // A single line fills the whole arena, so it must grow. Nothing points into it yet.
+    if (m_lines.empty()) {
+        auto* arena = static_cast<char*>(realloc(m_arena, m_arena_capacity * 2));
+        if (!arena) {
+            perror("sort: realloc");
+            return false;
+        }
+        m_arena = arena;
+        m_arena_capacity *= 2;
+        return true;
+    }
+
+    if (!spill()) {
+        return false;
+    }
+
+    size_t partial_size = m_arena_size - m_partial_line;
+    memmove(m_arena, m_arena + m_partial_line, partial_size);
+    m_arena_size = partial_size;
+    m_partial_line = 0;
+    return true;
+}
+
+void Sorter::sort_lines() {
+    int count = m_lines.size();
+    int slice_count = max(1, min(m_thread_count, count / min_lines_per_thread));
+    m_scratch.resize(count);
+
+    m_slices.clear();
+    for (int i = 0; i <= slice_count; i++) {
+        m_slices.add(static_cast<int>(static_cast<long>(count) * i / slice_count));
+    }
+
+    Vector<SortTask> tasks;
+    for (int i = 0; i < slice_count; i++) {
+        int start = m_slices[i];
+        tasks.add({ this, m_lines.vector() + start, m_scratch.vector() + start, m_slices[i + 1] - start });
+    }
+
+    // The calling thread sorts the first slice itself. If a thread cannot be created, its slice is sorted here too.
+    Vector<pthread_t> threads;
+    for (int i = 1; i < slice_count; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, run_sort_task, &tasks[i]) == 0) {
+            threads.add(thread);
+        } else {
+            run_sort_task(&tasks[i]);
+        }
+    }
+    run_sort_task(&tasks[0]);
+    for (auto thread : threads) {
+        pthread_join(thread, nullptr);
+    }
+}
+
+bool Sorter::write_sorted_lines(int fd) {
+    Vector<SliceReader> slices;
+    for (int i = 0; i + 1 < m_slices.size(); i++) {
+        slices.add({ m_lines.vector() + m_slices[i], m_lines.vector() + m_slices[i + 1] });
+    }
+
+    Vector<SliceReader*> readers;
+    for (auto& slice : slices) {
+        readers.add(&slice);
+    }
+
+    OutputBuffer output(fd);
+    return merge(*this, move(readers), output);
+}
+
+bool Sorter::spill() {
+    sort_lines();
+
+    int fd = create_temporary_file();
+    if (fd < 0) {
+        return false;
+    }
+    m_runs.add(fd);
+
+    if (!write_sorted_lines(fd)) {
+        return false;
+    }
+    m_lines.clear();
+    return true;
+}
+
+int Sorter::create_temporary_file() {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/sortXXXXXX", m_temporary_directory.string());
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("sort: mkstemp");
+        return -1;
+    }
+
+    // The file is only reached through its descriptor, so it disappears even if sort is killed.
+    unlink(path);
+    return fd;
+}
+
+bool Sorter::merge_runs(const Vector<int>& runs, int output_fd) {
+    size_t buffer_size = max(min_run_buffer_size, m_memory_budget / (runs.size() + 1));
+
+    Vector<UniquePtr<RunReader>> run_readers;
+    Vector<RunReader*> readers;
+    for (auto fd : runs) {
+        run_readers.add(make_unique<RunReader>(m_comparator, fd, buffer_size));
+        if (!run_readers.last()->start()) {
+            return false;
+        }
+        readers.add(run_readers.last().get());
+    }
+
+    OutputBuffer output(output_fd);
+    return merge(*this, move(readers), output);
+}
+
+bool Sorter::finish(int output_fd) {
+    if (m_runs.empty()) {
+        sort_lines();
+        return write_sorted_lines(output_fd);
+    }
+
+    if (!m_lines.empty() && !spill()) {
+        return false;
+    }
+
+    // Reading is over, so the merge buffers can have all of the memory.
+    free(m_arena);
+    m_arena = nullptr;
+    m_lines.clear();
+    m_scratch.clear();
+
+    // Runs are merged in groups of neighbours, so that earlier input still comes first among equal lines. The merged
+    // runs replace their groups at the front of m_runs.
+    while (m_runs.size() > max_merge_width) {
+        int merged_count = 0;
+        for (int i = 0; i < m_runs.size(); i += max_merge_width) {
+            int group_end = min(i + max_merge_width, m_runs.size());
+            if (group_end - i == 1) {
+                m_runs[merged_count++] = m_runs[i];
+                continue;
+            }
+
+            Vector<int> group;
+            for (int j = i; j < group_end; j++) {
+                group.add(m_runs[j]);
+            }
+
+            int fd = create_temporary_file();
+            if (fd < 0) {
+                return false;
+            }
+            if (!merge_runs(group, fd)) {
+                close(fd);
+                return false;
+            }
+
+            for (int j = i; j < group_end; j++) {
+                close(m_runs[j]);
+                m_runs[j] = -1;
+            }
+            m_runs[merged_count++] = fd;
+        }
+        m_runs.resize(merged_count);
+    }
+
+    return merge_runs(m_runs, output_fd);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <liim/string.h>
+#include <liim/string_view.h>
+#include <liim/vector.h>
+
+#include "line_comparator.h"
+
+// Sorts input which need not fit in memory. Lines are read into a single arena, and recorded as views into it. When
+// the arena and the records reach the memory budget, the records are split into slices which are sorted by separate
+// threads, and then merged into a temporary file as a sorted run. Finishing merges the runs into the output, at most
+// max_merge_width at a time, with the memory budget shared between their read buffers.
+class Sorter {
+public:
+    struct Line {
+        StringView text;
+        StringView key;
+    };
+
+    Sorter(const LineComparator& comparator, size_t memory_budget, int thread_count, String temporary_directory);
+    ~Sorter();
+
+    // Both print an error and return false on failure.
+    bool read(int fd);
+    bool finish(int output_fd);
+
+    int compare(const Line& a, const Line& b) const { return m_comparator.compare(a.text, a.key, b.text, b.key); }
+    const LineComparator& comparator() const { return m_comparator; }
+
+private:
+    static constexpr int max_merge_width = 32;
+
+    size_t memory_used() const { return m_arena_size + m_lines.size() * 2 * sizeof(Line); }
+
+    void add_line(const char* start, const char* end);
+    bool make_room();
+    void sort_lines();
+    bool spill();
+    bool write_sorted_lines(int fd);
+    bool merge_runs(const Vector<int>& runs, int output_fd);
+    int create_temporary_file();
+
+    const LineComparator& m_comparator;
+    size_t m_memory_budget { 0 };
+    int m_thread_count { 1 };
+    String m_temporary_directory;
+
+    char* m_arena { nullptr };
+    size_t m_arena_capacity { 0 };
+    size_t m_arena_size { 0 };
+    // The start of the line being read, which is not yet in m_lines.
+    size_t m_partial_line { 0 };
+
+    Vector<Line> m_lines;
+    Vector<Line> m_scratch;
+    // The boundaries of the slices of m_lines which were sorted by each thread.
+    Vector<int> m_slices;
+    // Temporary files holding sorted runs, in the order they were written.
+    Vector<int> m_runs;
+};
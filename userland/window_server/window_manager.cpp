@@ -2,7 +2,9 @@
 #include <fcntl.h>
 #include <graphics/bitmap.h>
 #include <graphics/renderer.h>
+#include <inttypes.h>
 #include <sys/ioctl.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "window_manager.h"
@@ -177,58 +179,122 @@ void WindowManager::remove_windows_of_client(SharedPtr<IPC::Endpoint> client) {
     }
 }
 
-void WindowManager::draw() {
-    m_drawing = true;
+static uint64_t monotonic_ns() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
 
-#ifdef WM_DRAW_DEBUG
-    timespec start;
-    clock_gettime(CLOCK_MONOTONIC, &start);
-#endif /* WM_DRAW_DEBUG */
+// The part of the content rect backed by the window's buffer. These differ while a resize is in progress.
+static Rect content_bounds(const Window& window) {
+    auto& content_rect = window.content_rect();
+    auto buffer_rect = Rect { content_rect.x(), content_rect.y(), window.buffer()->width(), window.buffer()->height() };
+    return buffer_rect.intersection_with(content_rect);
+}
 
-    Renderer renderer(*m_back_buffer);
+// The part of the window which is guaranteed to be covered by fully opaque pixels. Window decorations are drawn using
+// palette colors which may be translucent, so only the content is considered.
+static Rect opaque_rect(const Window& window) {
+    if (window.has_alpha()) {
+        return {};
+    }
+    return content_bounds(window);
+}
 
-    Function<void(SharedPtr<Window>&)> render_window = [&](auto& window) {
-        if (!window->visible()) {
-            return;
-        }
+Rect WindowManager::cursor_rect() const {
+    return { m_mouse_x, m_mouse_y, cursor_width, cursor_height };
+}
+
+void WindowManager::collect_visible_windows(Window& window, Vector<Window*>& windows) {
+    if (!window.visible()) {
+        return;
+    }
 
-        if (window->type() == WindowServer::WindowType::Application) {
-            auto title_bar_rect = Rect { window->rect().x() + 1, window->rect().y() + 1, window->rect().width() - 1, 20 };
-            renderer.fill_rect(title_bar_rect, palette()->color(Palette::WindowTitlebarBackground));
-            renderer.render_text(window->title(), title_bar_rect.adjusted(-4, 0), palette()->color(Palette::Text), TextAlign::CenterLeft,
-                                 m_active_window.get() == window.get() ? *Font::bold_font() : *Font::default_font());
+    windows.add(&window);
+    for (auto& child : window.children()) {
+        collect_visible_windows(*child, windows);
+    }
+}
 
-            renderer.draw_rect(window->rect(), palette()->color(Palette::WindowOutline));
-            renderer.draw_line({ window->rect().x(), window->rect().y() + 21 },
-                               { window->rect().x() + window->rect().width() - 1, window->rect().y() + 21 },
+void WindowManager::draw_window(Renderer& renderer, Window& window, const RectSet& region) {
+    auto bounds = content_bounds(window);
+    for (auto& rect : region) {
+        renderer.set_clip_rect(rect);
+
+        if (window.type() == WindowServer::WindowType::Application) {
+            auto title_bar_rect = Rect { window.rect().x() + 1, window.rect().y() + 1, window.rect().width() - 1, 20 };
+            if (title_bar_rect.intersects(rect)) {
+                renderer.fill_rect(title_bar_rect, palette()->color(Palette::WindowTitlebarBackground));
+                renderer.render_text(window.title(), title_bar_rect.adjusted(-4, 0), palette()->color(Palette::Text),
+                                     TextAlign::CenterLeft,
+                                     m_active_window.get() == &window ? *Font::bold_font() : *Font::default_font());
+                renderer.fill_circle(window.close_button_x(), window.close_button_y(), window.close_button_radius(),
+                                     palette()->color(Palette::Text));
+            }
+
+            renderer.draw_rect(window.rect(), palette()->color(Palette::WindowOutline));
+            renderer.draw_line({ window.rect().x(), window.rect().y() + 21 },
+                               { window.rect().x() + window.rect().width() - 1, window.rect().y() + 21 },
                                palette()->color(Palette::WindowOutline));
-            renderer.fill_circle(window->close_button_x(), window->close_button_y(), window->close_button_radius(),
-                                 palette()->color(Palette::Text));
+        }
 
-            invalidate_rect({ window->rect().x(), window->rect().y(), window->rect().width(), 22 });
-            invalidate_rect({ window->rect().x(), window->rect().y() + 22, 1, window->rect().height() });
-            invalidate_rect({ window->rect().x(), window->rect().y() + window->rect().height() - 1, window->rect().width(), 1 });
-            invalidate_rect({ window->rect().x() + window->rect().width() - 1, window->rect().y() + 22, 1, window->rect().height() });
+        auto dest_rect = bounds.intersection_with(rect);
+        if (dest_rect.empty()) {
+            continue;
         }
 
-        for (auto& r : m_dirty_rects) {
-            auto dest_rect = window->content_rect().intersection_with(r);
-            if (dest_rect == Rect()) {
-                continue;
-            }
+        auto src_rect = dest_rect;
+        src_rect.set_x(src_rect.x() - window.content_rect().x());
+        src_rect.set_y(src_rect.y() - window.content_rect().y());
+        renderer.draw_bitmap(*window.buffer(), src_rect, dest_rect);
+    }
+}
 
-            auto src_rect = dest_rect;
-            src_rect.set_x(src_rect.x() - window->content_rect().x());
-            src_rect.set_y(src_rect.y() - window->content_rect().y());
-            renderer.draw_bitmap(*window->buffer(), src_rect, dest_rect);
-        }
+void WindowManager::draw() {
+    m_drawing = true;
+
+    auto frame_start = monotonic_ns();
+
+    // The cursor is drawn over everything on every frame, so the area beneath it is always treated as damaged. This
+    // keeps every pixel written this frame inside the damaged area, which is all that swap_buffers() copies.
+    m_dirty_rects.add(cursor_rect());
+    m_dirty_rects.intersect(screen_rect());
 
-        for (auto& child : window->children()) {
-            render_window(child);
+    Vector<Window*> windows;
+    for (auto& window : m_window_stack) {
+        collect_visible_windows(*window, windows);
+    }
+
+    // Walk the windows from front to back, so that each window only paints the damaged area which is not covered by
+    // an opaque window above it. Windows with alpha never occlude what is below them.
+    Vector<RectSet> regions;
+    regions.resize(windows.size());
+    RectSet covered;
+    int occluded_pixels = 0;
+    int painted_pixels = 0;
+    for (int i = windows.size(); i > 0; i--) {
+        auto& window = *windows[i - 1];
+        auto& region = regions[i - 1];
+
+        region = m_dirty_rects;
+        region.intersect(window.rect());
+        auto exposed_pixels = region.area();
+        region.subtract(covered);
+        occluded_pixels += exposed_pixels - region.area();
+        painted_pixels += region.area();
+
+        auto opaque = opaque_rect(window);
+        if (!opaque.empty()) {
+            covered.add(opaque);
         }
-    };
+    }
 
-    for (auto& rect : m_dirty_rects) {
+    auto background_region = m_dirty_rects;
+    background_region.subtract(covered);
+    painted_pixels += background_region.area();
+
+    Renderer renderer(*m_back_buffer);
+    for (auto& rect : background_region) {
         if (m_desktop_background) {
             renderer.draw_bitmap(*m_desktop_background, rect, rect);
         } else {
@@ -236,8 +302,10 @@ void WindowManager::draw() {
         }
     }
 
-    for (auto& window : m_window_stack) {
-        render_window(window);
+    for (int i = 0; i < windows.size(); i++) {
+        if (!regions[i].empty()) {
+            draw_window(renderer, *windows[i], regions[i]);
+        }
     }
 
     for (int y = 0; y < cursor_height; y++) {
@@ -249,17 +317,28 @@ void WindowManager::draw() {
         }
     }
 
+    auto composite_end = monotonic_ns();
     swap_buffers();
+    auto frame_end = monotonic_ns();
+
+    m_frame_stats.frame_count++;
+    m_frame_stats.composite_ns = composite_end - frame_start;
+    m_frame_stats.swap_ns = frame_end - composite_end;
+    m_frame_stats.max_frame_ns = max(m_frame_stats.max_frame_ns, frame_end - frame_start);
+    m_frame_stats.total_frame_ns += frame_end - frame_start;
+    m_frame_stats.damaged_pixels = m_dirty_rects.area();
+    m_frame_stats.painted_pixels = painted_pixels;
+    m_frame_stats.occluded_pixels = occluded_pixels;
+
     m_dirty_rects.clear();
 
 #ifdef WM_DRAW_DEBUG
-    timespec end;
-    clock_gettime(CLOCK_MONOTONIC, &end);
-
-    long delta_seconds = end.tv_sec - start.tv_sec;
-    long delta_nano_seconds = end.tv_nsec - start.tv_nsec;
-    time_t delta_milli_seconds = delta_seconds * 1000 + delta_nano_seconds / 1000000;
-    fprintf(stderr, "WindowManager::draw() took %lu ms\n", delta_milli_seconds);
+    auto& stats = m_frame_stats;
+    fprintf(stderr,
+            "WindowManager::draw() frame %" PRIu64 ": composite %" PRIu64 " us, swap %" PRIu64 " us (avg %" PRIu64 " us, max %" PRIu64
+            " us); %d damaged, %d painted, %d occluded pixels; %d bytes copied\n",
+            stats.frame_count, stats.composite_ns / 1000, stats.swap_ns / 1000, stats.total_frame_ns / stats.frame_count / 1000,
+            stats.max_frame_ns / 1000, stats.damaged_pixels, stats.painted_pixels, stats.occluded_pixels, stats.copied_bytes);
 #endif /* WM_DRAW_DEBUG */
 
     m_drawing = false;
@@ -271,7 +350,20 @@ void WindowManager::swap_buffers() {
     m_front_buffer = temp;
 
     ioctl(m_fb, SSWAPBUF, m_front_buffer->pixels());
-    memcpy(m_back_buffer->pixels(), m_front_buffer->pixels(), m_front_buffer->size_in_bytes());
+
+    // The new back buffer holds the previous frame, which only differs from the new front buffer in the damaged area.
+    auto* src = m_front_buffer->pixels();
+    auto* dest = m_back_buffer->pixels();
+    auto width = m_front_buffer->width();
+    int copied_bytes = 0;
+    for (auto& rect : m_dirty_rects) {
+        auto row_size_in_bytes = rect.width() * sizeof(uint32_t);
+        for (int y = rect.top(); y < rect.bottom(); y++) {
+            memcpy(dest + y * width + rect.x(), src + y * width + rect.x(), row_size_in_bytes);
+        }
+        copied_bytes += rect.height() * row_size_in_bytes;
+    }
+    m_frame_stats.copied_bytes = copied_bytes;
 }
 
 SharedPtr<Window> WindowManager::find_by_wid(wid_t id) {
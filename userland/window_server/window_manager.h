@@ -5,6 +5,7 @@
 #include <graphics/bitmap.h>
 #include <graphics/palette.h>
 #include <graphics/rect_set.h>
+#include <graphics/renderer.h>
 #include <liim/function.h>
 #include <liim/hash_map.h>
 #include <liim/pointers.h>
@@ -31,6 +32,18 @@ public:
         Left,
     };
 
+    struct FrameStats {
+        uint64_t frame_count { 0 };
+        uint64_t composite_ns { 0 };
+        uint64_t swap_ns { 0 };
+        uint64_t max_frame_ns { 0 };
+        uint64_t total_frame_ns { 0 };
+        int damaged_pixels { 0 };
+        int painted_pixels { 0 };
+        int occluded_pixels { 0 };
+        int copied_bytes { 0 };
+    };
+
     WindowManager(int fb, SharedPtr<Bitmap> front_buffer, SharedPtr<Bitmap> back_buffer);
     ~WindowManager();
 
@@ -69,6 +82,9 @@ public:
 
     bool drawing() const { return m_drawing; }
 
+    // Timings and pixel counts of the most recent frame, along with running totals across all frames.
+    const FrameStats& frame_stats() const { return m_frame_stats; }
+
     bool window_exactly_at(Point p) const;
 
     Rect screen_rect() const { return { 0, 0, m_front_buffer->width(), m_front_buffer->height() }; }
@@ -85,7 +101,10 @@ public:
 private:
     void cleanup_active_window_state(SharedPtr<Window> window);
 
+    void collect_visible_windows(Window& window, Vector<Window*>& windows);
+    void draw_window(Renderer& renderer, Window& window, const RectSet& region);
     void swap_buffers();
+    Rect cursor_rect() const;
     void set_mouse_coordinates(int x, int y);
 
     int m_fb { -1 };
@@ -110,5 +129,7 @@ private:
 
     SharedPtr<Bitmap> m_desktop_background;
 
+    FrameStats m_frame_stats;
+
     bool m_drawing { false };
 };